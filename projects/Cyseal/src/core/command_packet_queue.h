@@ -0,0 +1,303 @@
+#pragma once
+
+#include "int_types.h"
+#include "assertion.h"
+#include "spin_lock.h"
+#include "memory/custom_new_delete.h"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Multi-producer single-consumer queue of type-erased commands that take an ArgType.
+// - Callables are placement-new'd into packets of 64 KiB segments, so enqueue() doesn't
+//   touch the heap unless the callable is larger than MAX_INLINE_SIZE or over-aligned.
+// - Producers reserve packets with an atomic add, so any thread can enqueue().
+// - Only one thread may call execute() at a time.
+// Commands run in the order their packets were reserved, thus commands from one thread
+// run in the order they were enqueued. execute() stops at the first packet that
+// is still being written and resumes from there in the next call.
+template<typename ArgType>
+class CommandPacketQueue
+{
+public:
+	static constexpr uint32 SEGMENT_SIZE = 64 * 1024;
+	static constexpr uint32 MAX_INLINE_SIZE = 256;
+
+	explicit CommandPacketQueue(EMemoryTag inMemoryTag = EMemoryTag::Renderer)
+		: memoryTag(inMemoryTag)
+	{
+		Segment* segment = allocateSegment();
+		head = segment;
+		tail.store(segment);
+	}
+
+	// Pending commands are destroyed without being executed.
+	// No thread should be enqueueing at this point.
+	~CommandPacketQueue()
+	{
+		while (PacketHeader* header = peekPacket())
+		{
+			header->ops->destroy(header + 1);
+			readOffset += header->size;
+		}
+		for (Segment* segment = head; segment != nullptr; )
+		{
+			Segment* next = segment->next.load();
+			::operator delete(segment);
+			segment = next;
+		}
+		for (Segment* segment : retiredSegments) ::operator delete(segment);
+		for (Segment* segment = freeSegments; segment != nullptr; )
+		{
+			Segment* next = segment->next.load();
+			::operator delete(segment);
+			segment = next;
+		}
+	}
+
+	CommandPacketQueue(const CommandPacketQueue&) = delete;
+	CommandPacketQueue& operator=(const CommandPacketQueue&) = delete;
+
+	template<typename Fn>
+	void enqueue(Fn&& fn)
+	{
+		using FnType = std::decay_t<Fn>;
+		if constexpr (sizeof(FnType) <= MAX_INLINE_SIZE && alignof(FnType) <= PACKET_ALIGNMENT)
+		{
+			PacketHeader* header = reservePacket(sizeof(FnType));
+			new(header + 1) FnType(std::forward<Fn>(fn));
+			commitPacket(header, &InlineOps<FnType>::ops);
+		}
+		else
+		{
+			FnType* heapFn = new(memoryTag) FnType(std::forward<Fn>(fn));
+			PacketHeader* header = reservePacket(sizeof(FnType*));
+			new(header + 1) FnType*(heapFn);
+			commitPacket(header, &HeapOps<FnType>::ops);
+		}
+	}
+
+	// Runs committed commands in order and returns how many were executed.
+	// Runs at most as many commands as were committed when called,
+	// so commands enqueued by the commands being executed run in the next call.
+	uint32 execute(ArgType arg)
+	{
+		const uint64 budget = numCommitted.load(std::memory_order_acquire) - numExecuted;
+		uint32 count = 0;
+		while (count < budget)
+		{
+			PacketHeader* header = peekPacket();
+			if (header == nullptr) break;
+
+			header->ops->execute(header + 1, arg);
+			header->ops->destroy(header + 1);
+			readOffset += header->size;
+			++count;
+		}
+		numExecuted += count;
+
+		recycleRetiredSegments();
+		return count;
+	}
+
+private:
+	static constexpr uint32 PACKET_ALIGNMENT = 16;
+
+	enum : uint32
+	{
+		PACKET_PENDING = 0, // Reserved but still being written. Segments are zero-filled.
+		PACKET_READY   = 1,
+		PACKET_SKIP    = 2, // Rest of the segment is unused.
+	};
+
+	struct PacketOps
+	{
+		void(*execute)(void* payload, ArgType arg);
+		void(*destroy)(void* payload);
+	};
+
+	template<typename FnType>
+	struct InlineOps
+	{
+		static void execute(void* payload, ArgType arg) { (*static_cast<FnType*>(payload))(arg); }
+		static void destroy(void* payload) { static_cast<FnType*>(payload)->~FnType(); }
+		static constexpr PacketOps ops{ &execute, &destroy };
+	};
+
+	template<typename FnType>
+	struct HeapOps
+	{
+		static void execute(void* payload, ArgType arg) { (**static_cast<FnType**>(payload))(arg); }
+		static void destroy(void* payload) { delete *static_cast<FnType**>(payload); }
+		static constexpr PacketOps ops{ &execute, &destroy };
+	};
+
+	struct alignas(PACKET_ALIGNMENT) PacketHeader
+	{
+		uint32              size; // Including this header
+		std::atomic<uint32> state;
+		const PacketOps*    ops;
+	};
+	static_assert(sizeof(PacketHeader) == PACKET_ALIGNMENT);
+
+	struct alignas(PACKET_ALIGNMENT) Segment
+	{
+		static constexpr uint32 CAPACITY = SEGMENT_SIZE - 64;
+
+		std::atomic<uint32>   reserved; // Can exceed CAPACITY when producers race at the end.
+		std::atomic<Segment*> next;
+
+		inline uint8* getData() { return reinterpret_cast<uint8*>(this) + 64; }
+	};
+	static_assert(sizeof(Segment) <= 64);
+
+	PacketHeader* reservePacket(uint32 payloadSize)
+	{
+		const uint32 packetSize = (uint32)sizeof(PacketHeader) + ((payloadSize + PACKET_ALIGNMENT - 1) & ~(PACKET_ALIGNMENT - 1));
+
+		// Segments are recycled only while no producer is in here. See recycleRetiredSegments().
+		numActiveProducers.fetch_add(1);
+		while (true)
+		{
+			Segment* segment = tail.load();
+			const uint32 offset = segment->reserved.fetch_add(packetSize, std::memory_order_relaxed);
+			if (offset + packetSize <= Segment::CAPACITY)
+			{
+				PacketHeader* header = reinterpret_cast<PacketHeader*>(segment->getData() + offset);
+				header->size = packetSize;
+				return header;
+			}
+			if (offset < Segment::CAPACITY)
+			{
+				// This producer crossed the end. Let the consumer skip the rest.
+				PacketHeader* header = reinterpret_cast<PacketHeader*>(segment->getData() + offset);
+				header->state.store(PACKET_SKIP, std::memory_order_release);
+			}
+			advanceTail(segment);
+		}
+	}
+
+	void commitPacket(PacketHeader* header, const PacketOps* ops)
+	{
+		header->ops = ops;
+		header->state.store(PACKET_READY, std::memory_order_release);
+		numActiveProducers.fetch_sub(1);
+		numCommitted.fetch_add(1, std::memory_order_release);
+	}
+
+	void advanceTail(Segment* segment)
+	{
+		Segment* next = segment->next.load(std::memory_order_acquire);
+		if (next == nullptr)
+		{
+			Segment* newSegment = allocateSegment();
+			if (segment->next.compare_exchange_strong(next, newSegment, std::memory_order_acq_rel))
+			{
+				next = newSegment;
+			}
+			else
+			{
+				releaseSegment(newSegment);
+			}
+		}
+		tail.compare_exchange_strong(segment, next);
+	}
+
+	// @return Next committed packet or nullptr.
+	PacketHeader* peekPacket()
+	{
+		while (true)
+		{
+			if (readOffset < Segment::CAPACITY)
+			{
+				if (readOffset >= head->reserved.load(std::memory_order_acquire))
+				{
+					return nullptr;
+				}
+				PacketHeader* header = reinterpret_cast<PacketHeader*>(head->getData() + readOffset);
+				const uint32 state = header->state.load(std::memory_order_acquire);
+				if (state == PACKET_READY) return header;
+				if (state == PACKET_PENDING) return nullptr;
+			}
+			// Reached the end of the segment.
+			Segment* next = head->next.load(std::memory_order_acquire);
+			if (next == nullptr)
+			{
+				return nullptr;
+			}
+			retiredSegments.push_back(head);
+			head = next;
+			readOffset = 0;
+		}
+	}
+
+	// A producer might have loaded a retired segment as tail and be about to reserve from it.
+	// Such a producer is counted in numActiveProducers before loading tail, and tail only moves forward,
+	// so a retired segment is safe to reuse if tail has moved past it and no producer is active.
+	void recycleRetiredSegments()
+	{
+		if (retiredSegments.empty()) return;
+
+		const Segment* currentTail = tail.load();
+		for (const Segment* segment : retiredSegments)
+		{
+			if (segment == currentTail) return;
+		}
+		if (numActiveProducers.load() != 0) return;
+
+		for (Segment* segment : retiredSegments)
+		{
+			releaseSegment(segment);
+		}
+		retiredSegments.clear();
+	}
+
+	Segment* allocateSegment()
+	{
+		Segment* segment = nullptr;
+		{
+			std::lock_guard<SpinLock> guard(freeSegmentLock);
+			if (freeSegments != nullptr)
+			{
+				segment = freeSegments;
+				freeSegments = segment->next.load(std::memory_order_relaxed);
+			}
+		}
+		if (segment == nullptr)
+		{
+			segment = static_cast<Segment*>(::operator new(SEGMENT_SIZE, memoryTag));
+		}
+		std::memset(static_cast<void*>(segment), 0, SEGMENT_SIZE);
+		new(segment) Segment{};
+		return segment;
+	}
+
+	void releaseSegment(Segment* segment)
+	{
+		std::lock_guard<SpinLock> guard(freeSegmentLock);
+		segment->next.store(freeSegments, std::memory_order_relaxed);
+		freeSegments = segment;
+	}
+
+private:
+	EMemoryTag            memoryTag;
+
+	// Producers
+	std::atomic<Segment*> tail;
+	std::atomic<uint32>   numActiveProducers = 0;
+	std::atomic<uint64>   numCommitted = 0;
+
+	// Consumer
+	Segment*              head = nullptr;
+	uint32                readOffset = 0;
+	uint64                numExecuted = 0;
+	std::vector<Segment*> retiredSegments;
+
+	SpinLock              freeSegmentLock;
+	Segment*              freeSegments = nullptr;
+};
@@ -1,6 +1,7 @@
 #include "engine.h"
 #include "platform.h"
 #include "assertion.h"
+#include "thread_pool.h"
 #include "memory/custom_new_delete.h"
 #include "memory/memory_tracker.h"
 
@@ -9,9 +10,14 @@
 
 #include "rhi/global_descriptor_heaps.h"
 #include "rhi/texture_manager.h"
+#include "rhi/upload_batcher.h"
 #include "rhi/vertex_buffer_pool.h"
 #include "render/null_renderer.h"
 #include "render/scene_renderer.h"
+#include "render/render_thread.h"
+#include "render/texture_streamer.h"
+#include "render/imgui_draw_data_snapshot.h"
+#include "world/scene_proxy.h"
 #include "material/material_database.h"
 
 #include "imgui.h"
@@ -36,12 +42,7 @@ DEFINE_LOG_CATEGORY(LogEngine);
 CysealEngine* gEngine = nullptr;
 
 // ---------------------------------------------------------------------
-// EnqueueCustomRenderCommand
-
-EnqueueCustomRenderCommand::EnqueueCustomRenderCommand(RenderCommandList::CustomCommandType inLambda)
-{
-	gEngine->enqueueCustomRenderCommand(inLambda);
-}
+// FlushRenderCommands
 
 #if 0
 FlushRenderCommands::FlushRenderCommands()
@@ -86,6 +87,21 @@ void CysealEngine::startup(const CysealEngineCreateParams& inCreateParams)
 	ResourceFinder::get().addBaseDirectory(L"../../external/");
 
 	// Core
+	{
+		const uint32 numWorkers = (createParams.numWorkerThreads >= 0)
+			? (uint32)createParams.numWorkerThreads
+			: ThreadPool::getDefaultNumWorkers();
+		threadPool = new(EMemoryTag::Etc) ThreadPool(numWorkers);
+
+		// The main thread and the render thread run parallel loops at the same time, so they can't share a pool.
+		if (createParams.bUseRenderThread)
+		{
+			const uint32 numRenderWorkers = (createParams.numRenderWorkerThreads >= 0)
+				? (uint32)createParams.numRenderWorkerThreads
+				: ThreadPool::getDefaultNumWorkers() / 2;
+			renderThreadPool = new(EMemoryTag::Etc) ThreadPool(numRenderWorkers);
+		}
+	}
 	createRenderDevice(createParams.renderDevice); // gRenderDevice is now available.
 
 	// #todo: Ideally do this at the end so that subsystems do not access gEngine at their initialization,
@@ -105,6 +121,12 @@ void CysealEngine::startup(const CysealEngineCreateParams& inCreateParams)
 
 		gTextureManager = new(EMemoryTag::RHI) TextureManager;
 		gTextureManager->initialize();
+
+		gUploadBatcher = new(EMemoryTag::RHI) UploadBatcher;
+		gUploadBatcher->initialize(gRenderDevice);
+
+		gTextureStreamer = new(EMemoryTag::RHI) TextureStreamer;
+		gTextureStreamer->initialize();
 	}
 
 	MaterialShaderDatabase::get().compileMaterials(gRenderDevice);
@@ -114,6 +136,14 @@ void CysealEngine::startup(const CysealEngineCreateParams& inCreateParams)
 
 	CYLOG(LogEngine, Log, TEXT("Renderer has been initialized."));
 
+	if (createParams.bUseRenderThread)
+	{
+		renderThread = new(EMemoryTag::Renderer) RenderThread;
+		renderThread->start(renderer, createParams.maxPendingRenderFrames);
+
+		CYLOG(LogEngine, Log, TEXT("Render thread has been started."));
+	}
+
 	// Dear IMGUI
 	if (renderDevice->isHeadless() == false)
 	{
@@ -142,6 +172,21 @@ void CysealEngine::shutdown()
 
 	CYLOG(LogEngine, Log, TEXT("Start engine termination."));
 
+	if (renderThread != nullptr)
+	{
+		renderThread->stop();
+		delete renderThread;
+		renderThread = nullptr;
+	}
+	// All frames are rendered.
+	for (const SubmittedImguiDrawData& submitted : submittedImguiDrawData)
+	{
+		delete submitted.drawData;
+	}
+	submittedImguiDrawData.clear();
+	delete imguiDrawData;
+	imguiDrawData = nullptr;
+
 	// Ensure no GPU commands in flight.
 	renderDevice->flushCommandQueue();
 
@@ -172,6 +217,15 @@ void CysealEngine::shutdown()
 		gTextureManager->destroy();
 		delete gTextureManager;
 		gTextureManager = nullptr;
+
+		// Uploads mips through gUploadBatcher until destroyed.
+		gTextureStreamer->destroy();
+		delete gTextureStreamer;
+		gTextureStreamer = nullptr;
+
+		gUploadBatcher->destroy();
+		delete gUploadBatcher;
+		gUploadBatcher = nullptr;
 	}
 
 	// Rendering
@@ -190,6 +244,12 @@ void CysealEngine::shutdown()
 	delete renderDevice;
 	gRenderDevice = nullptr;
 
+	delete renderThreadPool;
+	renderThreadPool = nullptr;
+
+	delete threadPool;
+	threadPool = nullptr;
+
 	// Shutdown is finished.
 	state = EEngineState::SHUTDOWN;
 
@@ -204,6 +264,7 @@ void CysealEngine::beginImguiNewFrame()
 
 	if (renderDevice->isHeadless()) return;
 
+	// No need to wait for the render thread, as it draws copies of draw data.
 	renderDevice->beginDearImguiNewFrame();
 
 #if PLATFORM_WINDOWS
@@ -222,26 +283,92 @@ void CysealEngine::renderImgui()
 	if (renderDevice->isHeadless()) return;
 
 	ImGui::Render();
+
+	// Replaces draw data that was never rendered.
+	delete imguiDrawData;
+	imguiDrawData = ImguiDrawDataSnapshot::capture();
 }
 
 void CysealEngine::renderScene(SceneProxy* sceneProxy, Camera* camera, const RendererOptions& rendererOptions)
 {
 	CHECK(state == EEngineState::RUNNING);
 
-	renderer->enqueueCustomCommands(std::move(customRenderCommands));
-	customRenderCommands.clear();
+	flushRendering();
+	releaseImguiDrawData();
+
+	renderer->setImguiDrawData(imguiDrawData != nullptr ? imguiDrawData->getDrawData() : nullptr);
 	renderer->render(sceneProxy, camera, rendererOptions);
+	renderer->setImguiDrawData(nullptr);
+
+	delete imguiDrawData;
+	imguiDrawData = nullptr;
 }
 
-void CysealEngine::enqueueCustomRenderCommand(RenderCommandList::CustomCommandType inLambda)
+uint64 CysealEngine::submitSceneFrame(SceneProxy* sceneProxy, const Camera& camera, const RendererOptions& rendererOptions)
 {
-	customRenderCommands.push_back(inLambda);
+	CHECK(state == EEngineState::RUNNING);
+
+	if (renderThread != nullptr)
+	{
+		numSubmittedFrames = renderThread->submit(RenderFrameSnapshot{
+			.sceneProxy      = sceneProxy,
+			.camera          = camera,
+			.rendererOptions = rendererOptions,
+			.imguiDrawData   = (imguiDrawData != nullptr) ? imguiDrawData->getDrawData() : nullptr,
+		});
+		if (imguiDrawData != nullptr)
+		{
+			submittedImguiDrawData.push_back(SubmittedImguiDrawData{ numSubmittedFrames, imguiDrawData });
+			imguiDrawData = nullptr;
+		}
+		releaseImguiDrawData();
+	}
+	else
+	{
+		renderer->setImguiDrawData(imguiDrawData != nullptr ? imguiDrawData->getDrawData() : nullptr);
+		renderer->render(sceneProxy, &camera, rendererOptions);
+		renderer->setImguiDrawData(nullptr);
+		delete sceneProxy;
+		numSubmittedFrames += 1;
+
+		delete imguiDrawData;
+		imguiDrawData = nullptr;
+	}
+	return numSubmittedFrames;
+}
+
+void CysealEngine::waitForRenderFrame(uint64 frameNumber)
+{
+	if (renderThread != nullptr)
+	{
+		renderThread->waitForFrame(frameNumber);
+	}
+}
+
+void CysealEngine::flushRendering()
+{
+	if (renderThread != nullptr)
+	{
+		renderThread->flush();
+	}
+}
+
+void CysealEngine::releaseImguiDrawData()
+{
+	const uint64 numCompletedFrames = (renderThread != nullptr) ? renderThread->getNumCompletedFrames() : numSubmittedFrames;
+	while (!submittedImguiDrawData.empty() && submittedImguiDrawData.front().frameNumber <= numCompletedFrames)
+	{
+		delete submittedImguiDrawData.front().drawData;
+		submittedImguiDrawData.pop_front();
+	}
 }
 
 void CysealEngine::setRenderResolution(uint32 newWidth, uint32 newHeight)
 {
 	CHECK(state == EEngineState::RUNNING);
 
+	flushRendering();
+
 	renderer->recreateSceneTextures(newWidth, newHeight);
 }
 
@@ -251,6 +378,8 @@ bool CysealEngine::setDisplayResolution(uint32 newWidth, uint32 newHeight)
 
 	if (renderDevice->isHeadless()) return false;
 
+	flushRendering();
+
 	void* hwnd = createParams.renderDevice.swapChainParams.nativeWindowHandle;
 	renderDevice->recreateSwapChain(hwnd, newWidth, newHeight);
 
@@ -303,6 +432,8 @@ void CysealEngine::createRenderer(ERendererType rendererType)
 	}
 
 	renderer->initialize(renderDevice);
+	renderer->setCustomCommandQueue(&customRenderCommands);
+	renderer->setThreadPool(renderThreadPool != nullptr ? renderThreadPool : threadPool);
 }
 
 void CysealEngine::createDearImgui(void* nativeWindowHandle)
@@ -6,8 +6,13 @@
 #include "core/int_types.h"
 #include "util/logging.h"
 
+#include <deque>
+
 class SceneProxy;
 class Camera;
+class RenderThread;
+class ThreadPool;
+class ImguiDrawDataSnapshot;
 
 DECLARE_LOG_CATEGORY(LogEngine);
 
@@ -22,20 +27,21 @@ struct CysealEngineCreateParams
 {
 	RenderDeviceCreateParams renderDevice;
 	ERendererType rendererType;
-};
 
-// #todo-renderer: Currently every custom commands are executed prior to whole internal rendering pipeline.
-// Needs a lambda wrapper for each internal command for perfect queueing.
-struct EnqueueCustomRenderCommand
-{
-	EnqueueCustomRenderCommand(RenderCommandList::CustomCommandType inLambda);
+	// If true, submitSceneFrame() renders on a dedicated thread while the caller prepares the next frame.
+	bool bUseRenderThread = false;
+	// Max frames submitted to the render thread but not rendered yet.
+	uint32 maxPendingRenderFrames = 2;
+
+	// Worker threads for data-parallel work of the main thread. (e.g., Scene::createProxy)
+	// Negative value means one less than hardware threads.
+	int32 numWorkerThreads = -1;
+	// Worker threads for data-parallel work of the render thread. (e.g., indirect draw arguments)
+	// Only if bUseRenderThread, otherwise the renderer shares the main thread's workers.
+	// Negative value means half of the default main thread workers.
+	int32 numRenderWorkerThreads = -1;
 };
 
-// Enqueues custom render commands that will be executed at next frame rendering.
-// Search for executeCustomCommands() from SceneRenderer or NullRenderer.
-// Only works if render device is not headless and renderer is running.
-#define ENQUEUE_RENDER_COMMAND(CommandName) EnqueueCustomRenderCommand CommandName
-
 #if 0
 // #todo-rendercommand: Resets the list and only executes custom commands registered so far.
 // Just a hack due to incomplete render command list support.
@@ -90,17 +96,46 @@ public:
 	bool setRenderAndDisplayResolution(uint32 newWidth, uint32 newHeight);
 
 	void beginImguiNewFrame();
+	// Draw data is copied, and rendered with the next renderScene() or submitSceneFrame().
 	void renderImgui();
 
+	// Renders on the caller's thread. Waits for the render thread first if it's running.
+	// The caller still owns sceneProxy.
 	void renderScene(SceneProxy* sceneProxy, Camera* camera, const RendererOptions& rendererOptions);
 
+	/// <summary>
+	/// Submit a frame to render. The engine takes ownership of sceneProxy and copies the camera and options.
+	/// With the render thread, this returns as soon as the frame is queued (blocks only if too many frames are pending).
+	/// Without it, the frame is rendered immediately.
+	/// The render thread may read meshes, materials and GPU resources referenced by the proxy,
+	/// so call flushRendering() before destroying or modifying them on the main thread.
+	/// </summary>
+	/// <returns>Frame number to pass to waitForRenderFrame().</returns>
+	uint64 submitSceneFrame(SceneProxy* sceneProxy, const Camera& camera, const RendererOptions& rendererOptions);
+
+	// Blocks until the given frame is rendered. No-op without the render thread.
+	void waitForRenderFrame(uint64 frameNumber);
+
+	// Blocks until all submitted frames are rendered. No-op without the render thread.
+	void flushRendering();
+
+	// Shared by main thread systems for parallel loops. Not for the render thread.
+	inline ThreadPool* getThreadPool() const { return threadPool; }
+
 	// Enqueue a command that will be executed in the next execution of the renderer.
-	void enqueueCustomRenderCommand(RenderCommandList::CustomCommandType inLambda);
+	// Safe to call from any thread.
+	template<typename Fn>
+	void enqueueCustomRenderCommand(Fn&& fn)
+	{
+		customRenderCommands.enqueue(std::forward<Fn>(fn));
+	}
 
 private:
 	void createRenderDevice(const RenderDeviceCreateParams& createParams);
 	void createRenderer(ERendererType rendererType);
 	void createDearImgui(void* nativeWindowHandle);
+	// Deletes draw data of frames that the render thread completed.
+	void releaseImguiDrawData();
 
 private:
 	CysealEngineCreateParams createParams;
@@ -108,8 +143,36 @@ private:
 
 	RenderDevice* renderDevice = nullptr;
 	Renderer* renderer = nullptr;
-
-	std::vector<RenderCommandList::CustomCommandType> customRenderCommands;
+	RenderThread* renderThread = nullptr; // Only if bUseRenderThread
+	uint64 numSubmittedFrames = 0;
+	ThreadPool* threadPool = nullptr;
+	ThreadPool* renderThreadPool = nullptr; // Only if bUseRenderThread
+
+	CustomRenderCommandQueue customRenderCommands;
+
+	struct SubmittedImguiDrawData
+	{
+		uint64                 frameNumber;
+		ImguiDrawDataSnapshot* drawData;
+	};
+	ImguiDrawDataSnapshot*             imguiDrawData = nullptr; // Captured by renderImgui(), not rendered yet.
+	std::deque<SubmittedImguiDrawData> submittedImguiDrawData;  // In use by the render thread.
 };
 
 extern CysealEngine* gEngine;
+
+// #todo-renderer: Currently every custom commands are executed prior to whole internal rendering pipeline.
+// Needs a lambda wrapper for each internal command for perfect queueing.
+struct EnqueueCustomRenderCommand
+{
+	template<typename Fn>
+	EnqueueCustomRenderCommand(Fn&& fn)
+	{
+		gEngine->enqueueCustomRenderCommand(std::forward<Fn>(fn));
+	}
+};
+
+// Enqueues custom render commands that will be executed at next frame rendering.
+// Search for executeCustomCommands() from SceneRenderer or NullRenderer.
+// Only works if render device is not headless and renderer is running.
+#define ENQUEUE_RENDER_COMMAND(CommandName) EnqueueCustomRenderCommand CommandName
@@ -0,0 +1,58 @@
+#include "half_float.h"
+
+#include <emmintrin.h>
+
+// Branchless version of floatToHalf() for 4 floats. Each lane holds a half in its low 16 bits,
+// sign extended, so that _mm_packs_epi32() packs them without saturation.
+static inline __m128i floatToHalf4(__m128 value)
+{
+	const __m128i signMask      = _mm_set1_epi32((int32)0x80000000u);
+	const __m128i f16Max        = _mm_set1_epi32((127 + 16) << 23);
+	const __m128i nanBit        = _mm_set1_epi32(0x200);
+	const __m128i halfInfinity  = _mm_set1_epi32(0x7c00);
+	const __m128i minNormal     = _mm_set1_epi32((127 - 14) << 23);
+	const __m128i denormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+	const __m128i normalBias    = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+	const __m128  sign     = _mm_and_ps(_mm_castsi128_ps(signMask), value);
+	const __m128  absValue = _mm_xor_ps(value, sign);
+	const __m128i absBits  = _mm_castps_si128(absValue);
+
+	const __m128i bIsNaN      = _mm_castps_si128(_mm_cmpunord_ps(absValue, absValue));
+	const __m128i bIsRegular  = _mm_cmpgt_epi32(f16Max, absBits);
+	const __m128i bIsDenormal = _mm_cmpgt_epi32(minNormal, absBits);
+	const __m128i infOrNaN    = _mm_or_si128(_mm_and_si128(bIsNaN, nanBit), halfInfinity);
+
+	const __m128  denormalSum = _mm_add_ps(absValue, _mm_castsi128_ps(denormalMagic));
+	const __m128i denormal    = _mm_sub_epi32(_mm_castps_si128(denormalSum), denormalMagic);
+
+	const __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absBits, 31 - 13), 31); // -1 if odd
+	const __m128i normal      = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absBits, normalBias), mantissaOdd), 13);
+
+	const __m128i finite = _mm_or_si128(_mm_and_si128(bIsDenormal, denormal), _mm_andnot_si128(bIsDenormal, normal));
+	const __m128i joined = _mm_or_si128(_mm_and_si128(bIsRegular, finite), _mm_andnot_si128(bIsRegular, infOrNaN));
+	return _mm_or_si128(joined, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+
+void convertFloatToHalf(const float* src, uint16* dst, uint64 count)
+{
+	uint64 i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i lo = floatToHalf4(_mm_loadu_ps(src + i));
+		const __m128i hi = floatToHalf4(_mm_loadu_ps(src + i + 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+	}
+	for (; i < count; ++i)
+	{
+		dst[i] = floatToHalf(src[i]);
+	}
+}
+
+void convertHalfToFloat(const uint16* src, float* dst, uint64 count)
+{
+	for (uint64 i = 0; i < count; ++i)
+	{
+		dst[i] = halfToFloat(src[i]);
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "int_types.h"
+
+#include <cstring>
+
+// IEEE 754 binary16 conversions, for R16G16B16A16_FLOAT and other half float textures.
+// float to half rounds to nearest even. Values larger than the half range become infinity,
+// and NaNs stay NaNs (quiet, without payloads).
+
+inline uint16 floatToHalf(float value)
+{
+	constexpr uint32 f32Infinity   = 255u << 23;
+	constexpr uint32 f16Max        = (127u + 16u) << 23;  // All floats >= this round to infinity.
+	constexpr uint32 minNormal     = (127u - 14u) << 23;  // Smallest float that becomes a normalized half.
+	constexpr uint32 denormalMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+	uint32 bits;
+	::memcpy(&bits, &value, 4);
+	const uint32 sign = bits & 0x80000000u;
+	bits ^= sign;
+
+	uint32 half;
+	if (bits >= f16Max)
+	{
+		half = (bits > f32Infinity) ? 0x7e00 : 0x7c00;
+	}
+	else if (bits < minNormal)
+	{
+		// Let the float adder round the mantissa into place.
+		float magic, sum;
+		::memcpy(&magic, &denormalMagic, 4);
+		::memcpy(&sum, &bits, 4);
+		sum += magic;
+		::memcpy(&half, &sum, 4);
+		half -= denormalMagic;
+	}
+	else
+	{
+		const uint32 mantissaOdd = (bits >> 13) & 1;
+		bits += (uint32(15 - 127) << 23) + 0xfff + mantissaOdd;
+		half = bits >> 13;
+	}
+	return (uint16)(half | (sign >> 16));
+}
+
+inline float halfToFloat(uint16 value)
+{
+	constexpr uint32 shiftedExponent = 0x7c00u << 13;
+	const float denormalMagic = 6.10351562e-05f; // 2^-14, (113 << 23) as float.
+
+	uint32 bits = uint32(value & 0x7fff) << 13;
+	const uint32 exponent = bits & shiftedExponent;
+	bits += uint32(127 - 15) << 23;
+
+	float result;
+	if (exponent == shiftedExponent)
+	{
+		bits += uint32(128 - 16) << 23; // Infinity or NaN
+		::memcpy(&result, &bits, 4);
+	}
+	else if (exponent == 0)
+	{
+		bits += 1u << 23;
+		::memcpy(&result, &bits, 4);
+		result -= denormalMagic;
+	}
+	else
+	{
+		::memcpy(&result, &bits, 4);
+	}
+
+	uint32 resultBits;
+	::memcpy(&resultBits, &result, 4);
+	resultBits |= uint32(value & 0x8000) << 16;
+	::memcpy(&result, &resultBits, 4);
+	return result;
+}
+
+// Converts count floats with SSE2, 8 at a time. Same results as floatToHalf().
+void convertFloatToHalf(const float* src, uint16* dst, uint64 count);
+
+void convertHalfToFloat(const uint16* src, float* dst, uint64 count);
@@ -0,0 +1,166 @@
+// Generational slot map for objects that are frequently added and removed.
+// - Handles stay valid until the object is removed, regardless of other insertions and removals.
+// - A stale handle (its object was removed) is detected by generation mismatch, even if the slot is reused.
+// - Insertion, removal, and lookup are O(1). Values are stored densely for cache-friendly iteration.
+
+#pragma once
+
+#include "core/int_types.h"
+#include "core/assertion.h"
+
+#include <vector>
+#include <utility>
+
+struct SlotHandle
+{
+	static constexpr uint32 INVALID_INDEX = 0xffffffff;
+
+	uint32 index      = INVALID_INDEX;
+	uint32 generation = 0;
+
+	inline bool isValid() const { return index != INVALID_INDEX; }
+	inline bool operator==(const SlotHandle& other) const { return index == other.index && generation == other.generation; }
+	inline bool operator!=(const SlotHandle& other) const { return !(*this == other); }
+};
+
+template<typename T>
+class SlotMap
+{
+	struct Slot
+	{
+		// Index into dense arrays if the slot is alive, otherwise next free slot.
+		uint32 denseIndexOrNextFree;
+		// Odd if alive, even if free. Incremented on every insertion and removal.
+		uint32 generation;
+	};
+	static constexpr uint32 END_OF_FREE_LIST = 0xffffffff;
+
+public:
+	using iterator       = typename std::vector<T>::iterator;
+	using const_iterator = typename std::vector<T>::const_iterator;
+
+	SlotHandle insert(const T& value)
+	{
+		return emplaceInternal(value);
+	}
+	SlotHandle insert(T&& value)
+	{
+		return emplaceInternal(std::move(value));
+	}
+
+	// @return true if the handle was valid and its value was removed.
+	bool remove(SlotHandle handle)
+	{
+		if (!contains(handle))
+		{
+			return false;
+		}
+		Slot& slot = slots[handle.index];
+		const uint32 denseIx = slot.denseIndexOrNextFree;
+		const uint32 lastIx = (uint32)(values.size() - 1);
+
+		// Swap-remove to keep dense arrays packed.
+		if (denseIx != lastIx)
+		{
+			values[denseIx] = std::move(values[lastIx]);
+			denseToSlot[denseIx] = denseToSlot[lastIx];
+			slots[denseToSlot[denseIx]].denseIndexOrNextFree = denseIx;
+		}
+		values.pop_back();
+		denseToSlot.pop_back();
+
+		slot.generation += 1;
+		slot.denseIndexOrNextFree = freeHead;
+		freeHead = handle.index;
+		return true;
+	}
+
+	inline bool contains(SlotHandle handle) const
+	{
+		return handle.index < slots.size() && slots[handle.index].generation == handle.generation;
+	}
+
+	// @return nullptr if the handle is stale.
+	inline T* find(SlotHandle handle)
+	{
+		return contains(handle) ? &(values[slots[handle.index].denseIndexOrNextFree]) : nullptr;
+	}
+	inline const T* find(SlotHandle handle) const
+	{
+		return contains(handle) ? &(values[slots[handle.index].denseIndexOrNextFree]) : nullptr;
+	}
+
+	// Handle of the value at the given dense position.
+	inline SlotHandle getHandle(size_t denseIndex) const
+	{
+		CHECK(denseIndex < values.size());
+		const uint32 slotIx = denseToSlot[denseIndex];
+		return SlotHandle{ slotIx, slots[slotIx].generation };
+	}
+
+	void reserve(size_t n)
+	{
+		values.reserve(n);
+		denseToSlot.reserve(n);
+		slots.reserve(n);
+	}
+
+	// Invalidates all handles.
+	void clear()
+	{
+		for (uint32 slotIx : denseToSlot)
+		{
+			Slot& slot = slots[slotIx];
+			slot.generation += 1;
+			slot.denseIndexOrNextFree = freeHead;
+			freeHead = slotIx;
+		}
+		values.clear();
+		denseToSlot.clear();
+	}
+
+	inline size_t size() const { return values.size(); }
+	inline bool empty() const { return values.empty(); }
+
+	inline T& operator[](size_t denseIndex) { return values[denseIndex]; }
+	inline const T& operator[](size_t denseIndex) const { return values[denseIndex]; }
+
+	// Dense iteration. Order is not stable across removals.
+	inline iterator begin() { return values.begin(); }
+	inline iterator end() { return values.end(); }
+	inline const_iterator begin() const { return values.begin(); }
+	inline const_iterator end() const { return values.end(); }
+
+private:
+	template<typename U>
+	SlotHandle emplaceInternal(U&& value)
+	{
+		uint32 slotIx;
+		if (freeHead != END_OF_FREE_LIST)
+		{
+			slotIx = freeHead;
+			freeHead = slots[slotIx].denseIndexOrNextFree;
+		}
+		else
+		{
+			CHECK(slots.size() < (size_t)END_OF_FREE_LIST);
+			slotIx = (uint32)slots.size();
+			slots.push_back(Slot{ 0, 0 });
+		}
+
+		Slot& slot = slots[slotIx];
+		slot.generation += 1;
+		slot.denseIndexOrNextFree = (uint32)values.size();
+
+		values.emplace_back(std::forward<U>(value));
+		denseToSlot.push_back(slotIx);
+
+		return SlotHandle{ slotIx, slot.generation };
+	}
+
+private:
+	std::vector<T>      values;
+	std::vector<uint32> denseToSlot;
+	std::vector<Slot>   slots;
+	uint32              freeHead = END_OF_FREE_LIST;
+};
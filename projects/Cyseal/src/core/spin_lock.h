@@ -0,0 +1,37 @@
+#pragma once
+
+#include "int_types.h"
+
+#include <atomic>
+#include <thread>
+
+// Minimal spin lock for very short critical sections.
+// Constant-initialized, so it's usable in allocators before static initialization.
+// Satisfies BasicLockable, so works with std::lock_guard.
+class SpinLock
+{
+public:
+	void lock()
+	{
+		uint32 spins = 0;
+		while (flag.exchange(true, std::memory_order_acquire))
+		{
+			while (flag.load(std::memory_order_relaxed))
+			{
+				if (++spins >= 64)
+				{
+					std::this_thread::yield();
+					spins = 0;
+				}
+			}
+		}
+	}
+
+	void unlock()
+	{
+		flag.store(false, std::memory_order_release);
+	}
+
+private:
+	std::atomic<bool> flag = false;
+};
@@ -0,0 +1,108 @@
+#include "thread_pool.h"
+
+uint32 ThreadPool::getDefaultNumWorkers()
+{
+	const uint32 numHardwareThreads = std::thread::hardware_concurrency();
+	return (numHardwareThreads > 1) ? (numHardwareThreads - 1) : 0;
+}
+
+ThreadPool::ThreadPool(uint32 numWorkers)
+{
+	workers.reserve(numWorkers);
+	for (uint32 i = 0; i < numWorkers; ++i)
+	{
+		workers.emplace_back([this]() { workerMain(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bStopRequested = true;
+	}
+	jobStarted.notify_all();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::runJob(uint32 numChunks, JobFunc func, void* context)
+{
+	if (numChunks == 0)
+	{
+		return;
+	}
+	if (workers.empty() || numChunks == 1)
+	{
+		for (uint32 i = 0; i < numChunks; ++i)
+		{
+			func(context, i);
+		}
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		// A worker that woke up late for the previous job might still be leaving.
+		workersIdle.wait(lock, [this]() { return numActiveWorkers == 0; });
+		jobFunc = func;
+		jobContext = context;
+		jobNumChunks = numChunks;
+		nextChunk.store(0, std::memory_order_relaxed);
+		++jobGeneration;
+	}
+	jobStarted.notify_all();
+
+	processChunks();
+
+	// All chunks are claimed. Wait for workers still processing theirs.
+	std::unique_lock<std::mutex> lock(mutex);
+	workersIdle.wait(lock, [this]() { return numActiveWorkers == 0; });
+}
+
+void ThreadPool::processChunks()
+{
+	while (true)
+	{
+		const uint32 chunkIx = nextChunk.fetch_add(1, std::memory_order_relaxed);
+		if (chunkIx >= jobNumChunks)
+		{
+			break;
+		}
+		jobFunc(jobContext, chunkIx);
+	}
+}
+
+void ThreadPool::workerMain()
+{
+	uint64 lastGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobStarted.wait(lock, [this, lastGeneration]() {
+				return bStopRequested || jobGeneration != lastGeneration;
+			});
+			if (bStopRequested)
+			{
+				break;
+			}
+			lastGeneration = jobGeneration;
+			++numActiveWorkers;
+		}
+
+		processChunks();
+
+		bool bLastWorker;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			bLastWorker = (--numActiveWorkers == 0);
+		}
+		if (bLastWorker)
+		{
+			workersIdle.notify_all();
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "int_types.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+// Fixed set of worker threads for data-parallel loops.
+// The calling thread also processes chunks, so a pool without workers runs everything inline.
+class ThreadPool
+{
+public:
+	// One less than hardware threads, as the calling thread also works.
+	static uint32 getDefaultNumWorkers();
+
+	static inline uint32 getNumChunks(uint32 count, uint32 grainSize)
+	{
+		return (count + grainSize - 1) / grainSize;
+	}
+
+	explicit ThreadPool(uint32 numWorkers);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Including the calling thread.
+	inline uint32 getNumThreads() const { return (uint32)workers.size() + 1; }
+
+	// Invokes fn(chunkIx) for each chunkIx in [0, numChunks) on workers and the calling thread.
+	// Blocks until all chunks are done. Only one thread may run a loop at a time.
+	template<typename Fn>
+	void parallelForChunks(uint32 numChunks, Fn&& fn)
+	{
+		using FnType = std::remove_reference_t<Fn>;
+		runJob(
+			numChunks,
+			[](void* context, uint32 chunkIx) { (*static_cast<FnType*>(context))(chunkIx); },
+			const_cast<void*>(static_cast<const void*>(std::addressof(fn))));
+	}
+
+	// Splits [0, count) into ranges of grainSize and invokes fn(chunkIx, begin, end) for each range.
+	// Chunk indices are stable regardless of scheduling, so per-chunk outputs can be merged in order.
+	template<typename Fn>
+	void parallelFor(uint32 count, uint32 grainSize, Fn&& fn)
+	{
+		parallelForChunks(getNumChunks(count, grainSize), [&](uint32 chunkIx) {
+			const uint32 begin = chunkIx * grainSize;
+			fn(chunkIx, begin, std::min(begin + grainSize, count));
+		});
+	}
+
+private:
+	using JobFunc = void(*)(void* context, uint32 chunkIx);
+
+	void runJob(uint32 numChunks, JobFunc func, void* context);
+	void processChunks();
+	void workerMain();
+
+	std::vector<std::thread> workers;
+
+	std::mutex               mutex;
+	std::condition_variable  jobStarted;
+	std::condition_variable  workersIdle;
+	uint64                   jobGeneration = 0;
+	uint32                   numActiveWorkers = 0;
+	bool                     bStopRequested = false;
+
+	// Current job. Written under the mutex while no worker is active.
+	JobFunc                  jobFunc = nullptr;
+	void*                    jobContext = nullptr;
+	uint32                   jobNumChunks = 0;
+	std::atomic<uint32>      nextChunk = 0;
+};
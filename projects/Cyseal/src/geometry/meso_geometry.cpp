@@ -3,6 +3,7 @@
 #include "rhi/render_command.h"
 #include "rhi/vertex_buffer_pool.h"
 #include "rhi/buffer.h"
+#include "rhi/upload_batcher.h"
 #include "render/static_mesh.h"
 #include "world/gpu_resource_asset.h"
 
@@ -83,24 +84,25 @@ MesoGeometryAssets MesoGeometryAssets::createFrom(const Geometry* G)
 			nonposAsset = assets.nonPositionBufferAsset, idxAssets = assets.indexBufferAsset]
 			(RenderCommandList& commandList)
 			{
+				// Source data is released once all buffers are copied to staging pages, maybe a few frames later.
+				SharedPtr<void> geometryOwner(const_cast<Geometry*>(G));
+				SharedPtr<void> mesoListOwner(mesoList);
+
 				auto positionBuffer = gVertexBufferPool->suballocate(G->getPositionBufferTotalBytes());
-				positionBuffer->updateData(&commandList, G->getPositionBlob(), G->getPositionStride());
+				posAsset->setUploadToken(gUploadBatcher->uploadVertexBuffer(positionBuffer, G->getPositionBlob(), G->getPositionStride(), geometryOwner));
 				posAsset->setGPUResource(SharedPtr<VertexBuffer>(positionBuffer));
 
 				auto nonPositionBuffer = gVertexBufferPool->suballocate(G->getNonPositionBufferTotalBytes());
-				nonPositionBuffer->updateData(&commandList, G->getNonPositionBlob(), G->getNonPositionStride());
+				nonposAsset->setUploadToken(gUploadBatcher->uploadVertexBuffer(nonPositionBuffer, G->getNonPositionBlob(), G->getNonPositionStride(), geometryOwner));
 				nonposAsset->setGPUResource(SharedPtr<VertexBuffer>(nonPositionBuffer));
 
 				for (size_t i = 0; i < mesoList->size(); ++i)
 				{
 					const MesoGeometry& meso = mesoList->at(i);
 					auto indexBuffer = gIndexBufferPool->suballocate(meso.getIndexBufferTotalBytes(), G->getIndexFormat());
-					indexBuffer->updateData(&commandList, meso.getIndexBlob(), G->getIndexFormat());
+					idxAssets[i]->setUploadToken(gUploadBatcher->uploadIndexBuffer(indexBuffer, meso.getIndexBlob(), G->getIndexFormat(), mesoListOwner));
 					idxAssets[i]->setGPUResource(SharedPtr<IndexBuffer>(indexBuffer));
 				}
-
-				commandList.enqueueDeferredDealloc(G);
-				commandList.enqueueDeferredDealloc(mesoList);
 			}
 		);
 	}
@@ -114,19 +116,20 @@ MesoGeometryAssets MesoGeometryAssets::createFrom(const Geometry* G)
 		ENQUEUE_RENDER_COMMAND(UploadMeshGeometry)(
 			[G, positionBufferAsset, nonPositionBufferAsset, indexBufferAsset](RenderCommandList& commandList)
 			{
+				// Source data is released once all buffers are copied to staging pages, maybe a few frames later.
+				SharedPtr<void> geometryOwner(const_cast<Geometry*>(G));
+
 				auto positionBuffer = gVertexBufferPool->suballocate(G->getPositionBufferTotalBytes());
 				auto nonPositionBuffer = gVertexBufferPool->suballocate(G->getNonPositionBufferTotalBytes());
 				auto indexBuffer = gIndexBufferPool->suballocate(G->getIndexBufferTotalBytes(), G->getIndexFormat());
 
-				positionBuffer->updateData(&commandList, G->getPositionBlob(), G->getPositionStride());
-				nonPositionBuffer->updateData(&commandList, G->getNonPositionBlob(), G->getNonPositionStride());
-				indexBuffer->updateData(&commandList, G->getIndexBlob(), G->getIndexFormat());
+				positionBufferAsset->setUploadToken(gUploadBatcher->uploadVertexBuffer(positionBuffer, G->getPositionBlob(), G->getPositionStride(), geometryOwner));
+				nonPositionBufferAsset->setUploadToken(gUploadBatcher->uploadVertexBuffer(nonPositionBuffer, G->getNonPositionBlob(), G->getNonPositionStride(), geometryOwner));
+				indexBufferAsset->setUploadToken(gUploadBatcher->uploadIndexBuffer(indexBuffer, G->getIndexBlob(), G->getIndexFormat(), geometryOwner));
 
 				positionBufferAsset->setGPUResource(SharedPtr<VertexBuffer>(positionBuffer));
 				nonPositionBufferAsset->setGPUResource(SharedPtr<VertexBuffer>(nonPositionBuffer));
 				indexBufferAsset->setGPUResource(SharedPtr<IndexBuffer>(indexBuffer));
-
-				commandList.enqueueDeferredDealloc(G);
 			}
 		);
 
@@ -0,0 +1,765 @@
+#include "environment_map.h"
+#include "hdr_image_loader.h"
+#include "texture_cache.h"
+
+#include "core/assertion.h"
+#include "core/cymath.h"
+#include "core/half_float.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
+#include "util/resource_finder.h"
+#include "util/logging.h"
+
+#include <algorithm>
+#include <cstring>
+
+DEFINE_LOG_CATEGORY_STATIC(LogEnvironmentMap);
+
+// Rows per parallel chunk.
+#define ENVIRONMENT_MAP_GRAIN_ROWS 8
+
+template<typename Fn>
+static void parallelForRows(ThreadPool* threadPool, uint32 numRows, uint32 grainSize, Fn&& fn)
+{
+	if (threadPool == nullptr || numRows <= grainSize)
+	{
+		fn(0, 0, numRows);
+	}
+	else
+	{
+		threadPool->parallelFor(numRows, grainSize, fn);
+	}
+}
+
+// ------------------------------------------------
+// Directions
+
+vec3 cubeTexelToDirection(uint32 face, float u, float v)
+{
+	const float s = 2.0f * u - 1.0f;
+	const float t = 2.0f * v - 1.0f;
+	vec3 dir;
+	switch (face)
+	{
+		case 0: dir = vec3( 1.0f,  -t,   -s  ); break;
+		case 1: dir = vec3(-1.0f,  -t,    s  ); break;
+		case 2: dir = vec3(  s,    1.0f,  t  ); break;
+		case 3: dir = vec3(  s,   -1.0f, -t  ); break;
+		case 4: dir = vec3(  s,    -t,   1.0f); break;
+		case 5: dir = vec3( -s,    -t,  -1.0f); break;
+		default: CHECK_NO_ENTRY();
+	}
+	return normalize(dir);
+}
+
+void directionToCubeTexel(const vec3& dir, uint32& outFace, float& outU, float& outV)
+{
+	const float ax = std::abs(dir.x), ay = std::abs(dir.y), az = std::abs(dir.z);
+	float s, t, ma;
+	if (ax >= ay && ax >= az)
+	{
+		outFace = dir.x >= 0.0f ? 0 : 1;
+		s = dir.x >= 0.0f ? -dir.z : dir.z;
+		t = -dir.y;
+		ma = ax;
+	}
+	else if (ay >= az)
+	{
+		outFace = dir.y >= 0.0f ? 2 : 3;
+		s = dir.x;
+		t = dir.y >= 0.0f ? dir.z : -dir.z;
+		ma = ay;
+	}
+	else
+	{
+		outFace = dir.z >= 0.0f ? 4 : 5;
+		s = dir.z >= 0.0f ? dir.x : -dir.x;
+		t = -dir.y;
+		ma = az;
+	}
+	outU = 0.5f * (s / ma + 1.0f);
+	outV = 0.5f * (t / ma + 1.0f);
+}
+
+vec3 equirectUVToDirection(float u, float v)
+{
+	const float phi = 2.0f * Cymath::PI * (u - 0.5f);
+	const float theta = Cymath::PI * v;
+	const float sinTheta = std::sin(theta);
+	return vec3(sinTheta * std::sin(phi), std::cos(theta), -sinTheta * std::cos(phi));
+}
+
+void directionToEquirectUV(const vec3& dir, float& outU, float& outV)
+{
+	outU = 0.5f + std::atan2(dir.x, -dir.z) / (2.0f * Cymath::PI);
+	outV = std::acos(std::clamp(dir.y, -1.0f, 1.0f)) / Cymath::PI;
+}
+
+// Integral of the solid angle from the face center to (x, y) on the [-1, 1] face.
+static float cubeAreaElement(float x, float y)
+{
+	return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0f));
+}
+
+float calcCubeTexelSolidAngle(uint32 x, uint32 y, uint32 faceSize)
+{
+	const float invSize = 1.0f / faceSize;
+	const float x0 = 2.0f * x * invSize - 1.0f, x1 = x0 + 2.0f * invSize;
+	const float y0 = 2.0f * y * invSize - 1.0f, y1 = y0 + 2.0f * invSize;
+	return cubeAreaElement(x0, y0) - cubeAreaElement(x0, y1) - cubeAreaElement(x1, y0) + cubeAreaElement(x1, y1);
+}
+
+// ------------------------------------------------
+// Cube resampling
+
+static vec3 sampleEquirectBilinear(const float* rgba32f, uint32 width, uint32 height, float u, float v)
+{
+	// Wrap horizontally, clamp vertically.
+	const float x = u * width - 0.5f;
+	const float y = std::clamp(v * height - 0.5f, 0.0f, (float)(height - 1));
+	const float fx = std::floor(x), fy = std::floor(y);
+	const float tx = x - fx, ty = y - fy;
+	const int32 x0 = (((int32)fx % (int32)width) + (int32)width) % (int32)width;
+	const int32 x1 = (x0 + 1) % (int32)width;
+	const int32 y0 = (int32)fy;
+	const int32 y1 = std::min(y0 + 1, (int32)height - 1);
+
+	auto texel = [&](int32 px, int32 py)
+	{
+		const float* p = rgba32f + 4 * (uint64(py) * width + px);
+		return vec3(p[0], p[1], p[2]);
+	};
+	return lerp(lerp(texel(x0, y0), texel(x1, y0), tx), lerp(texel(x0, y1), texel(x1, y1), tx), ty);
+}
+
+static inline void storeTexel(float* dst, const vec3& value)
+{
+	dst[0] = value.x;
+	dst[1] = value.y;
+	dst[2] = value.z;
+	dst[3] = 1.0f;
+}
+
+void convertEquirectToCube(
+	const float* rgba32f,
+	uint32 width,
+	uint32 height,
+	uint32 faceSize,
+	uint32 supersamplesPerAxis,
+	MipChain& outCube,
+	ThreadPool* threadPool)
+{
+	CHECK(rgba32f != nullptr && width > 0 && height > 0 && faceSize > 0 && supersamplesPerAxis > 0);
+	outCube.allocate(EPixelFormat::R32G32B32A32_FLOAT, faceSize, faceSize, 1, 6);
+
+	const float invSamples = 1.0f / float(supersamplesPerAxis * supersamplesPerAxis);
+	auto convertRows = [&](uint32 chunkIx, uint32 begin, uint32 end)
+	{
+		for (uint32 row = begin; row < end; ++row)
+		{
+			const uint32 face = row / faceSize, y = row % faceSize;
+			float* dst = reinterpret_cast<float*>(outCube.getSliceData(0, face) + y * outCube.levels[0].rowPitch);
+			for (uint32 x = 0; x < faceSize; ++x)
+			{
+				vec3 sum(0.0f);
+				for (uint32 sy = 0; sy < supersamplesPerAxis; ++sy)
+				{
+					for (uint32 sx = 0; sx < supersamplesPerAxis; ++sx)
+					{
+						const float u = (x + (sx + 0.5f) / supersamplesPerAxis) / faceSize;
+						const float v = (y + (sy + 0.5f) / supersamplesPerAxis) / faceSize;
+						float eu, ev;
+						directionToEquirectUV(cubeTexelToDirection(face, u, v), eu, ev);
+						sum += sampleEquirectBilinear(rgba32f, width, height, eu, ev);
+					}
+				}
+				storeTexel(dst + 4 * x, sum * invSamples);
+			}
+		}
+	};
+	parallelForRows(threadPool, 6 * faceSize, ENVIRONMENT_MAP_GRAIN_ROWS, convertRows);
+}
+
+void generateCubeMips(MipChain& cube, ThreadPool* threadPool)
+{
+	CHECK(cube.format == EPixelFormat::R32G32B32A32_FLOAT && cube.getNumLevels() > 0);
+	const uint32 faceSize = cube.levels[0].width;
+	CHECK(faceSize == cube.levels[0].height && (faceSize & (faceSize - 1)) == 0);
+
+	MipChain result;
+	const uint32 numLevels = calcMipLevelCount(faceSize, faceSize);
+	result.allocate(EPixelFormat::R32G32B32A32_FLOAT, faceSize, faceSize, numLevels, 6);
+	::memcpy(result.getLevelData(0), cube.getLevelData(0), result.levels[0].slicePitch * 6);
+
+	for (uint32 mip = 1; mip < numLevels; ++mip)
+	{
+		const uint32 size = result.levels[mip].width;
+		auto downsampleRows = [&](uint32 chunkIx, uint32 begin, uint32 end)
+		{
+			for (uint32 row = begin; row < end; ++row)
+			{
+				const uint32 face = row / size, y = row % size;
+				const uint64 srcRowPitch = result.levels[mip - 1].rowPitch;
+				const uint8* srcFace = result.getSliceData(mip - 1, face);
+				const float* src0 = reinterpret_cast<const float*>(srcFace + (2 * y + 0) * srcRowPitch);
+				const float* src1 = reinterpret_cast<const float*>(srcFace + (2 * y + 1) * srcRowPitch);
+				float* dst = reinterpret_cast<float*>(result.getSliceData(mip, face) + y * result.levels[mip].rowPitch);
+				for (uint32 x = 0; x < 4 * size; ++x)
+				{
+					const uint32 c = x & 3, srcX = 2 * (x - c) + c;
+					dst[x] = 0.25f * (src0[srcX] + src0[srcX + 4] + src1[srcX] + src1[srcX + 4]);
+				}
+			}
+		};
+		parallelForRows(threadPool, 6 * size, ENVIRONMENT_MAP_GRAIN_ROWS, downsampleRows);
+	}
+	cube = std::move(result);
+}
+
+static vec3 sampleCubeFaceBilinear(const MipChain& cube, uint32 mip, uint32 face, float u, float v)
+{
+	const MipChain::Level& level = cube.levels[mip];
+	const float x = std::clamp(u * level.width - 0.5f, 0.0f, (float)(level.width - 1));
+	const float y = std::clamp(v * level.height - 0.5f, 0.0f, (float)(level.height - 1));
+	const uint32 x0 = (uint32)x, y0 = (uint32)y;
+	const uint32 x1 = std::min(x0 + 1, level.width - 1), y1 = std::min(y0 + 1, level.height - 1);
+	const float tx = x - x0, ty = y - y0;
+
+	const uint8* faceData = cube.getSliceData(mip, face);
+	auto texel = [&](uint32 px, uint32 py)
+	{
+		const float* p = reinterpret_cast<const float*>(faceData + py * level.rowPitch) + 4 * px;
+		return vec3(p[0], p[1], p[2]);
+	};
+	return lerp(lerp(texel(x0, y0), texel(x1, y0), tx), lerp(texel(x0, y1), texel(x1, y1), tx), ty);
+}
+
+vec3 sampleCube(const MipChain& cube, const vec3& dir, float mipLevel)
+{
+	uint32 face;
+	float u, v;
+	directionToCubeTexel(dir, face, u, v);
+
+	const float maxLevel = (float)(cube.getNumLevels() - 1);
+	mipLevel = std::clamp(mipLevel, 0.0f, maxLevel);
+	const uint32 mip0 = (uint32)mipLevel;
+	const float t = mipLevel - mip0;
+	const vec3 value0 = sampleCubeFaceBilinear(cube, mip0, face, u, v);
+	if (t == 0.0f)
+	{
+		return value0;
+	}
+	return lerp(value0, sampleCubeFaceBilinear(cube, mip0 + 1, face, u, v), t);
+}
+
+// ------------------------------------------------
+// Irradiance
+
+static void evalSH9(const vec3& n, float outBasis[9])
+{
+	outBasis[0] = 0.282095f;
+	outBasis[1] = 0.488603f * n.y;
+	outBasis[2] = 0.488603f * n.z;
+	outBasis[3] = 0.488603f * n.x;
+	outBasis[4] = 1.092548f * n.x * n.y;
+	outBasis[5] = 1.092548f * n.y * n.z;
+	outBasis[6] = 0.315392f * (3.0f * n.z * n.z - 1.0f);
+	outBasis[7] = 1.092548f * n.x * n.z;
+	outBasis[8] = 0.546274f * (n.x * n.x - n.y * n.y);
+}
+
+// Projection doesn't need the full resolution. 64x64 faces keep all 9 coefficients accurate.
+#define IRRADIANCE_SOURCE_MAX_SIZE 64
+
+void prefilterIrradiance(const MipChain& radianceCube, uint32 faceSize, MipChain& outCube, ThreadPool* threadPool)
+{
+	CHECK(radianceCube.format == EPixelFormat::R32G32B32A32_FLOAT && faceSize > 0);
+
+	uint32 sourceMip = 0;
+	while (sourceMip + 1 < radianceCube.getNumLevels() && radianceCube.levels[sourceMip].width > IRRADIANCE_SOURCE_MAX_SIZE)
+	{
+		++sourceMip;
+	}
+	const uint32 sourceSize = radianceCube.levels[sourceMip].width;
+
+	// Per-chunk sums are merged in chunk order, so the result does not depend on scheduling.
+	const uint32 numRows = 6 * sourceSize;
+	const uint32 numChunks = ThreadPool::getNumChunks(numRows, ENVIRONMENT_MAP_GRAIN_ROWS);
+	std::vector<vec3> chunkSums(numChunks * 9, vec3(0.0f));
+	auto projectRows = [&](uint32 chunkIx, uint32 begin, uint32 end)
+	{
+		vec3* sums = &chunkSums[chunkIx * 9];
+		float basis[9];
+		for (uint32 row = begin; row < end; ++row)
+		{
+			const uint32 face = row / sourceSize, y = row % sourceSize;
+			const float* src = reinterpret_cast<const float*>(radianceCube.getSliceData(sourceMip, face) + y * radianceCube.levels[sourceMip].rowPitch);
+			for (uint32 x = 0; x < sourceSize; ++x)
+			{
+				const vec3 dir = cubeTexelToDirection(face, (x + 0.5f) / sourceSize, (y + 0.5f) / sourceSize);
+				const vec3 radiance(src[4 * x + 0], src[4 * x + 1], src[4 * x + 2]);
+				const float solidAngle = calcCubeTexelSolidAngle(x, y, sourceSize);
+				evalSH9(dir, basis);
+				for (uint32 i = 0; i < 9; ++i)
+				{
+					sums[i] += radiance * (basis[i] * solidAngle);
+				}
+			}
+		}
+	};
+	if (threadPool == nullptr)
+	{
+		for (uint32 chunkIx = 0; chunkIx < numChunks; ++chunkIx)
+		{
+			const uint32 begin = chunkIx * ENVIRONMENT_MAP_GRAIN_ROWS;
+			projectRows(chunkIx, begin, std::min(begin + ENVIRONMENT_MAP_GRAIN_ROWS, numRows));
+		}
+	}
+	else
+	{
+		threadPool->parallelFor(numRows, ENVIRONMENT_MAP_GRAIN_ROWS, projectRows);
+	}
+
+	// Convolution with the clamped cosine (pi, 2pi/3, pi/4 per band), then divided by pi.
+	const float bandScales[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	vec3 coefficients[9];
+	for (uint32 i = 0; i < 9; ++i)
+	{
+		coefficients[i] = vec3(0.0f);
+		for (uint32 chunkIx = 0; chunkIx < numChunks; ++chunkIx)
+		{
+			coefficients[i] += chunkSums[chunkIx * 9 + i];
+		}
+		coefficients[i] *= bandScales[i];
+	}
+
+	outCube.allocate(EPixelFormat::R32G32B32A32_FLOAT, faceSize, faceSize, 1, 6);
+	auto evalRows = [&](uint32 chunkIx, uint32 begin, uint32 end)
+	{
+		float basis[9];
+		for (uint32 row = begin; row < end; ++row)
+		{
+			const uint32 face = row / faceSize, y = row % faceSize;
+			float* dst = reinterpret_cast<float*>(outCube.getSliceData(0, face) + y * outCube.levels[0].rowPitch);
+			for (uint32 x = 0; x < faceSize; ++x)
+			{
+				evalSH9(cubeTexelToDirection(face, (x + 0.5f) / faceSize, (y + 0.5f) / faceSize), basis);
+				vec3 value(0.0f);
+				for (uint32 i = 0; i < 9; ++i)
+				{
+					value += coefficients[i] * basis[i];
+				}
+				// Ringing of a truncated SH can go below zero around very bright lights.
+				storeTexel(dst + 4 * x, vec3(std::max(0.0f, value.x), std::max(0.0f, value.y), std::max(0.0f, value.z)));
+			}
+		}
+	};
+	parallelForRows(threadPool, 6 * faceSize, ENVIRONMENT_MAP_GRAIN_ROWS, evalRows);
+}
+
+// ------------------------------------------------
+// Specular
+
+static float radicalInverseVdC(uint32 bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return float(bits) * 2.3283064365386963e-10f;
+}
+
+struct SpecularSample
+{
+	vec3  localDir; // Light direction in the tangent frame of N.
+	float weight;   // N.L
+	float mipLevel; // Source radiance mip
+};
+
+void prefilterSpecular(
+	const MipChain& radianceCube,
+	uint32 faceSize,
+	uint32 numLevels,
+	uint32 numSamples,
+	MipChain& outCube,
+	ThreadPool* threadPool)
+{
+	CHECK(radianceCube.format == EPixelFormat::R32G32B32A32_FLOAT && faceSize > 0 && numLevels > 0 && numSamples > 0);
+	numLevels = std::min(numLevels, calcMipLevelCount(faceSize, faceSize));
+	outCube.allocate(EPixelFormat::R32G32B32A32_FLOAT, faceSize, faceSize, numLevels, 6);
+
+	const uint32 radianceSize = radianceCube.levels[0].width;
+	const float texelSolidAngle = 4.0f * Cymath::PI / (6.0f * radianceSize * radianceSize);
+
+	std::vector<SpecularSample> samples;
+	for (uint32 mip = 0; mip < numLevels; ++mip)
+	{
+		const uint32 size = outCube.levels[mip].width;
+		const float perceptualRoughness = (numLevels > 1) ? (float)mip / (numLevels - 1) : 0.0f;
+		const float alpha = perceptualRoughness * perceptualRoughness;
+		const float alpha2 = alpha * alpha;
+
+		// With N = V, GGX samples only depend on roughness. Prepare them in the tangent frame once per level.
+		samples.clear();
+		if (mip > 0)
+		{
+			for (uint32 i = 0; i < numSamples; ++i)
+			{
+				const float xi1 = (float)i / numSamples, xi2 = radicalInverseVdC(i);
+				const float phi = 2.0f * Cymath::PI * xi1;
+				const float cosTheta = std::sqrt((1.0f - xi2) / (1.0f + (alpha2 - 1.0f) * xi2));
+				const float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+				const vec3 H(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+				const vec3 L = 2.0f * cosTheta * H - vec3(0.0f, 0.0f, 1.0f);
+				if (L.z <= 0.0f)
+				{
+					continue;
+				}
+				// pdf(L) = D(H) * NoH / (4 * VoH) = D(H) / 4 when N = V.
+				const float d = cosTheta * cosTheta * (alpha2 - 1.0f) + 1.0f;
+				const float D = alpha2 / (Cymath::PI * d * d);
+				const float pdf = D / 4.0f;
+				const float sampleSolidAngle = 1.0f / (numSamples * pdf + 1e-6f);
+				const float mipLevel = std::max(0.0f, 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f);
+				samples.push_back(SpecularSample{ L, L.z, mipLevel });
+			}
+		}
+		// Level 0 reads a radiance mip of about the same texel size.
+		const float baseMipLevel = std::log2((float)radianceSize / size);
+
+		auto filterRows = [&](uint32 chunkIx, uint32 begin, uint32 end)
+		{
+			for (uint32 row = begin; row < end; ++row)
+			{
+				const uint32 face = row / size, y = row % size;
+				float* dst = reinterpret_cast<float*>(outCube.getSliceData(mip, face) + y * outCube.levels[mip].rowPitch);
+				for (uint32 x = 0; x < size; ++x)
+				{
+					const vec3 N = cubeTexelToDirection(face, (x + 0.5f) / size, (y + 0.5f) / size);
+					if (samples.empty())
+					{
+						storeTexel(dst + 4 * x, sampleCube(radianceCube, N, baseMipLevel));
+						continue;
+					}
+
+					const vec3 up = std::abs(N.z) < 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(1.0f, 0.0f, 0.0f);
+					const vec3 T = normalize(cross(up, N));
+					const vec3 B = cross(N, T);
+					vec3 sum(0.0f);
+					float weightSum = 0.0f;
+					for (const SpecularSample& s : samples)
+					{
+						const vec3 L = s.localDir.x * T + s.localDir.y * B + s.localDir.z * N;
+						sum += sampleCube(radianceCube, L, std::max(s.mipLevel, baseMipLevel)) * s.weight;
+						weightSum += s.weight;
+					}
+					storeTexel(dst + 4 * x, sum / weightSum);
+				}
+			}
+		};
+		parallelForRows(threadPool, 6 * size, ENVIRONMENT_MAP_GRAIN_ROWS, filterRows);
+	}
+}
+
+void convertCubeToHalf(const MipChain& floatCube, MipChain& outHalfCube, ThreadPool* threadPool)
+{
+	CHECK(floatCube.format == EPixelFormat::R32G32B32A32_FLOAT);
+	// Same texels in the same order, with every pitch and offset halved.
+	outHalfCube.format = EPixelFormat::R16G16B16A16_FLOAT;
+	outHalfCube.levels = floatCube.levels;
+	for (MipChain::Level& level : outHalfCube.levels)
+	{
+		level.offset /= 2;
+		level.rowPitch /= 2;
+		level.slicePitch /= 2;
+	}
+	outHalfCube.data.resize(floatCube.data.size() / 2);
+
+	const float* src = reinterpret_cast<const float*>(floatCube.data.data());
+	uint16* dst = reinterpret_cast<uint16*>(outHalfCube.data.data());
+	const uint64 count = floatCube.data.size() / sizeof(float);
+	constexpr uint32 floatsPerChunk = 1 << 16;
+	const uint32 numChunks = (uint32)((count + floatsPerChunk - 1) / floatsPerChunk);
+	parallelForRows(threadPool, numChunks, 1, [&](uint32 chunkIx, uint32 begin, uint32 end)
+		{
+			const uint64 first = uint64(begin) * floatsPerChunk;
+			const uint64 last = std::min(uint64(end) * floatsPerChunk, count);
+			convertFloatToHalf(src + first, dst + first, last - first);
+		});
+}
+
+// ------------------------------------------------
+// EnvironmentLuminanceCDF
+
+static inline float getLuminance(float r, float g, float b)
+{
+	return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+// Normalizes a running sum in cdf[1..n] to [0, 1]. Uniform if the sum is zero.
+static void normalizeCdf(float* cdf, uint32 n)
+{
+	const float total = cdf[n];
+	for (uint32 i = 1; i <= n; ++i)
+	{
+		cdf[i] = (total > 0.0f) ? (cdf[i] / total) : ((float)i / n);
+	}
+	cdf[n] = 1.0f;
+}
+
+void EnvironmentLuminanceCDF::build(const float* rgba32f, uint32 srcWidth, uint32 srcHeight, uint32 maxWidth, ThreadPool* threadPool)
+{
+	CHECK(rgba32f != nullptr && srcWidth > 0 && srcHeight > 0 && maxWidth > 0);
+	const uint32 blockSize = (srcWidth + maxWidth - 1) / maxWidth;
+	width = (srcWidth + blockSize - 1) / blockSize;
+	height = (srcHeight + blockSize - 1) / blockSize;
+
+	conditionalCdf.resize(uint64(width + 1) * height);
+	marginalCdf.resize(height + 1);
+
+	// Rows are independent. Each row keeps its unnormalized integral in marginalCdf[y + 1] for now.
+	auto buildRows = [&](uint32 chunkIx, uint32 begin, uint32 end)
+	{
+		for (uint32 y = begin; y < end; ++y)
+		{
+			const float sinTheta = std::sin(Cymath::PI * (y + 0.5f) / height);
+			float* cdf = &conditionalCdf[uint64(width + 1) * y];
+			cdf[0] = 0.0f;
+			for (uint32 x = 0; x < width; ++x)
+			{
+				float sum = 0.0f;
+				uint32 numTexels = 0;
+				for (uint32 sy = y * blockSize; sy < std::min((y + 1) * blockSize, srcHeight); ++sy)
+				{
+					for (uint32 sx = x * blockSize; sx < std::min((x + 1) * blockSize, srcWidth); ++sx)
+					{
+						const float* p = rgba32f + 4 * (uint64(sy) * srcWidth + sx);
+						sum += std::max(0.0f, getLuminance(p[0], p[1], p[2]));
+						++numTexels;
+					}
+				}
+				cdf[x + 1] = cdf[x] + sinTheta * sum / numTexels;
+			}
+			marginalCdf[y + 1] = cdf[width] / width;
+			normalizeCdf(cdf, width);
+		}
+	};
+	parallelForRows(threadPool, height, ENVIRONMENT_MAP_GRAIN_ROWS, buildRows);
+
+	marginalCdf[0] = 0.0f;
+	for (uint32 y = 0; y < height; ++y)
+	{
+		marginalCdf[y + 1] += marginalCdf[y];
+	}
+	normalizeCdf(marginalCdf.data(), height);
+}
+
+// Finds the segment of u in a cdf of n segments and remaps u within it.
+// @return Segment index, and the pdf of the segment w.r.t. [0, 1] in outPdf.
+static uint32 sampleCdf(const float* cdf, uint32 n, float u, float& outOffset, float& outPdf)
+{
+	const float* it = std::upper_bound(cdf, cdf + n + 1, u);
+	const uint32 ix = (uint32)std::clamp<int64>((it - cdf) - 1, 0, n - 1);
+	const float segment = cdf[ix + 1] - cdf[ix];
+	outOffset = (segment > 0.0f) ? std::clamp((u - cdf[ix]) / segment, 0.0f, 1.0f) : 0.5f;
+	outPdf = segment * n;
+	return ix;
+}
+
+// From the direction rather than v, which is not precise enough near the poles.
+static inline float calcSinTheta(const vec3& dir)
+{
+	return std::sqrt(dir.x * dir.x + dir.z * dir.z);
+}
+
+vec3 EnvironmentLuminanceCDF::sample(float u1, float u2, float& outPdf) const
+{
+	float dv, pdfV, du, pdfU;
+	const uint32 y = sampleCdf(marginalCdf.data(), height, std::min(u2, 0.99999994f), dv, pdfV);
+	const uint32 x = sampleCdf(&conditionalCdf[uint64(width + 1) * y], width, std::min(u1, 0.99999994f), du, pdfU);
+
+	const vec3 dir = equirectUVToDirection((x + du) / width, (y + dv) / height);
+	const float sinTheta = calcSinTheta(dir);
+	outPdf = (sinTheta > 0.0f) ? (pdfU * pdfV) / (2.0f * Cymath::PI * Cymath::PI * sinTheta) : 0.0f;
+	return dir;
+}
+
+float EnvironmentLuminanceCDF::pdf(const vec3& dir) const
+{
+	float u, v;
+	directionToEquirectUV(dir, u, v);
+	const uint32 x = std::min((uint32)(u * width), width - 1);
+	const uint32 y = std::min((uint32)(v * height), height - 1);
+	const float* cdf = &conditionalCdf[uint64(width + 1) * y];
+	const float pdfUV = (cdf[x + 1] - cdf[x]) * width * (marginalCdf[y + 1] - marginalCdf[y]) * height;
+	const float sinTheta = calcSinTheta(dir);
+	return (sinTheta > 0.0f) ? pdfUV / (2.0f * Cymath::PI * Cymath::PI * sinTheta) : 0.0f;
+}
+
+// ------------------------------------------------
+// Loading
+
+enum class EEnvironmentMapProduct : uint32
+{
+	Radiance,
+	Irradiance,
+	Specular,
+	LuminanceCDF,
+	Count
+};
+
+static void copyCacheEntry(const TextureCacheEntry& entry, MipChain& outChain)
+{
+	const MipChain::Level& lastLevel = entry.levels.back();
+	const uint64 totalBytes = lastLevel.offset + lastLevel.slicePitch * entry.depth;
+	outChain.format = entry.format;
+	outChain.levels = entry.levels;
+	outChain.data.assign(entry.getLevelData(0), entry.getLevelData(0) + totalBytes);
+}
+
+// The cache stores MipChains, so the CDF is stored as two R32_FLOAT levels: conditional and marginal.
+static void packLuminanceCDF(const EnvironmentLuminanceCDF& cdf, MipChain& outChain)
+{
+	const uint64 conditionalBytes = cdf.conditionalCdf.size() * sizeof(float);
+	const uint64 marginalBytes = cdf.marginalCdf.size() * sizeof(float);
+	outChain.format = EPixelFormat::R32_FLOAT;
+	outChain.levels = {
+		MipChain::Level{ cdf.width + 1, cdf.height, 0, (cdf.width + 1) * sizeof(float), conditionalBytes },
+		MipChain::Level{ cdf.height + 1, 1, conditionalBytes, marginalBytes, marginalBytes },
+	};
+	outChain.data.resize(conditionalBytes + marginalBytes);
+	::memcpy(outChain.data.data(), cdf.conditionalCdf.data(), conditionalBytes);
+	::memcpy(outChain.data.data() + conditionalBytes, cdf.marginalCdf.data(), marginalBytes);
+}
+
+static bool unpackLuminanceCDF(const TextureCacheEntry& entry, EnvironmentLuminanceCDF& outCdf)
+{
+	if (entry.format != EPixelFormat::R32_FLOAT || entry.getNumLevels() != 2 || entry.levels[0].width < 2)
+	{
+		return false;
+	}
+	outCdf.width = entry.levels[0].width - 1;
+	outCdf.height = entry.levels[0].height;
+	if (entry.levels[1].width != outCdf.height + 1)
+	{
+		return false;
+	}
+	const float* conditional = reinterpret_cast<const float*>(entry.getLevelData(0));
+	const float* marginal = reinterpret_cast<const float*>(entry.getLevelData(1));
+	outCdf.conditionalCdf.assign(conditional, conditional + uint64(outCdf.width + 1) * outCdf.height);
+	outCdf.marginalCdf.assign(marginal, marginal + outCdf.height + 1);
+	return true;
+}
+
+EnvironmentMap* loadEnvironmentMap(const std::wstring& path, const EnvironmentMapDesc& desc, ThreadPool* threadPool, bool useResourceFinder)
+{
+	const std::wstring filepath = useResourceFinder ? ResourceFinder::get().find(path) : path;
+	if (filepath.size() == 0)
+	{
+		CYLOG(LogEnvironmentMap, Error, L"Failed to find: %s", path.c_str());
+		return nullptr;
+	}
+
+	HighFrequencyCounter counter;
+	counter.start();
+
+#if ENABLE_TEXTURE_CACHE
+	const TextureCache textureCache(TEXTURE_CACHE_DIR);
+	TextureCacheKey cacheKeys[(uint32)EEnvironmentMapProduct::Count];
+	for (uint32 product = 0; product < (uint32)EEnvironmentMapProduct::Count; ++product)
+	{
+		const uint32 settings[] = {
+			product, desc.radianceSize, desc.supersamplesPerAxis, desc.irradianceSize,
+			desc.specularSize, desc.specularNumLevels, desc.specularNumSamples, desc.cdfMaxWidth,
+		};
+		cacheKeys[product] = TextureCacheKey{ .sourcePaths = { filepath }, .settingsHash = hashTextureCacheBytes(settings, sizeof(settings)) };
+	}
+
+	{
+		TextureCacheEntry* entries[(uint32)EEnvironmentMapProduct::Count];
+		bool bAllFound = true;
+		for (uint32 product = 0; product < (uint32)EEnvironmentMapProduct::Count; ++product)
+		{
+			entries[product] = textureCache.find(cacheKeys[product]);
+			bAllFound = bAllFound && entries[product] != nullptr;
+		}
+
+		EnvironmentMap* envMap = nullptr;
+		if (bAllFound)
+		{
+			envMap = new EnvironmentMap;
+			copyCacheEntry(*entries[(uint32)EEnvironmentMapProduct::Radiance], envMap->radiance);
+			copyCacheEntry(*entries[(uint32)EEnvironmentMapProduct::Irradiance], envMap->irradiance);
+			copyCacheEntry(*entries[(uint32)EEnvironmentMapProduct::Specular], envMap->specular);
+			envMap->bFromCache = true;
+			if (!unpackLuminanceCDF(*entries[(uint32)EEnvironmentMapProduct::LuminanceCDF], envMap->luminanceCDF))
+			{
+				delete envMap;
+				envMap = nullptr;
+			}
+		}
+		for (TextureCacheEntry* entry : entries)
+		{
+			delete entry;
+		}
+		if (envMap != nullptr)
+		{
+			CYLOG(LogEnvironmentMap, Log, L"Loaded %s from texture cache in %.3f ms", path.c_str(), counter.stopWithMilliseconds());
+			return envMap;
+		}
+	}
+#endif
+
+	HDRImageLoader imageLoader;
+	HDRImageLoadData* image = imageLoader.load(filepath, false, false);
+	if (image == nullptr)
+	{
+		CYLOG(LogEnvironmentMap, Error, L"Failed to load: %s", filepath.c_str());
+		return nullptr;
+	}
+	const float decodeMs = counter.stopWithMilliseconds();
+
+	EnvironmentMap* envMap = new EnvironmentMap;
+	float stageMs[4];
+	MipChain floatCube, floatFiltered;
+
+	counter.start();
+	convertEquirectToCube(image->pixels.data(), image->width, image->height, desc.radianceSize, desc.supersamplesPerAxis, floatCube, threadPool);
+	generateCubeMips(floatCube, threadPool);
+	convertCubeToHalf(floatCube, envMap->radiance, threadPool);
+	stageMs[0] = counter.stopWithMilliseconds();
+
+	counter.start();
+	prefilterIrradiance(floatCube, desc.irradianceSize, floatFiltered, threadPool);
+	convertCubeToHalf(floatFiltered, envMap->irradiance, threadPool);
+	stageMs[1] = counter.stopWithMilliseconds();
+
+	counter.start();
+	prefilterSpecular(floatCube, desc.specularSize, desc.specularNumLevels, desc.specularNumSamples, floatFiltered, threadPool);
+	convertCubeToHalf(floatFiltered, envMap->specular, threadPool);
+	stageMs[2] = counter.stopWithMilliseconds();
+
+	counter.start();
+	envMap->luminanceCDF.build(image->pixels.data(), image->width, image->height, desc.cdfMaxWidth, threadPool);
+	stageMs[3] = counter.stopWithMilliseconds();
+
+	CYLOG(LogEnvironmentMap, Log, L"Processed %s (%ux%u): decode %.3f ms, cube %.3f ms, irradiance %.3f ms, specular %.3f ms, cdf %.3f ms",
+		path.c_str(), image->width, image->height, decodeMs, stageMs[0], stageMs[1], stageMs[2], stageMs[3]);
+	delete image;
+
+#if ENABLE_TEXTURE_CACHE
+	MipChain packedCdf;
+	packLuminanceCDF(envMap->luminanceCDF, packedCdf);
+	const bool bStored = textureCache.store(cacheKeys[(uint32)EEnvironmentMapProduct::Radiance], envMap->radiance, 6)
+		&& textureCache.store(cacheKeys[(uint32)EEnvironmentMapProduct::Irradiance], envMap->irradiance, 6)
+		&& textureCache.store(cacheKeys[(uint32)EEnvironmentMapProduct::Specular], envMap->specular, 6)
+		&& textureCache.store(cacheKeys[(uint32)EEnvironmentMapProduct::LuminanceCDF], packedCdf);
+	if (!bStored)
+	{
+		CYLOG(LogEnvironmentMap, Warning, L"Failed to write texture cache for: %s", filepath.c_str());
+	}
+#endif
+
+	return envMap;
+}
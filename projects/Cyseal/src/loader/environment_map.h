@@ -0,0 +1,114 @@
+#pragma once
+
+#include "core/int_types.h"
+#include "core/vec3.h"
+#include "mip_generator.h"
+
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Cube faces are in the order of +X, -X, +Y, -Y, +Z, -Z, same as D3D12 and Vulkan.
+// Face texel coordinates (u, v) are in [0, 1] with v going down.
+// Equirectangular maps have +Y at the top row and -Z at the center column.
+
+vec3 cubeTexelToDirection(uint32 face, float u, float v);
+void directionToCubeTexel(const vec3& dir, uint32& outFace, float& outU, float& outV);
+
+// u = 0.5 + atan2(dir.x, -dir.z) / 2pi, v = acos(dir.y) / pi
+vec3 equirectUVToDirection(float u, float v);
+void directionToEquirectUV(const vec3& dir, float& outU, float& outV);
+
+// Solid angle of texel (x, y) of a face. All texels of a cube sum up to 4pi.
+float calcCubeTexelSolidAngle(uint32 x, uint32 y, uint32 faceSize);
+
+// Float cubes below are MipChains of R32G32B32A32_FLOAT with 6 faces in each level.
+// Alpha is always 1.
+
+// Resamples an rgba32f equirect image. Each texel averages bilinear taps on (supersamplesPerAxis ^ 2) points,
+// so that a cube smaller than the source does not alias. Rows of all faces are processed in parallel.
+void convertEquirectToCube(
+	const float* rgba32f,
+	uint32 width,
+	uint32 height,
+	uint32 faceSize,
+	uint32 supersamplesPerAxis,
+	MipChain& outCube,
+	ThreadPool* threadPool = nullptr);
+
+// Replaces a float cube with full mips of its level 0, each filtered with a 2x2 box. Face size must be a power of two.
+void generateCubeMips(MipChain& cube, ThreadPool* threadPool = nullptr);
+
+// Bilinear lookup in a face, or trilinear if mipLevel is fractional. Faces are clamped at their edges.
+vec3 sampleCube(const MipChain& cube, const vec3& dir, float mipLevel = 0.0f);
+
+// Cosine-weighted average of radiance, i.e., irradiance / pi, so that a Lambertian surface
+// of albedo a reflects (a * texel). Computed with 9 spherical harmonics coefficients.
+void prefilterIrradiance(const MipChain& radianceCube, uint32 faceSize, MipChain& outCube, ThreadPool* threadPool = nullptr);
+
+// GGX prefiltered radiance for the split sum approximation, assuming N = V = R.
+// Perceptual roughness of level m is m / (numLevels - 1), so level 0 is the radiance itself.
+// Samples are importance sampled and read from a radiance mip that matches their pdf (filtered importance sampling),
+// so few samples are enough without fireflies. radianceCube needs full mips.
+void prefilterSpecular(
+	const MipChain& radianceCube,
+	uint32 faceSize,
+	uint32 numLevels,
+	uint32 numSamples,
+	MipChain& outCube,
+	ThreadPool* threadPool = nullptr);
+
+// Same layout, converted to R16G16B16A16_FLOAT with SIMD.
+void convertCubeToHalf(const MipChain& floatCube, MipChain& outHalfCube, ThreadPool* threadPool = nullptr);
+
+// Piecewise constant distribution over an equirect map, proportional to (luminance * sin(theta)),
+// for importance sampling of environment lighting.
+class EnvironmentLuminanceCDF
+{
+public:
+	// Source texels are averaged in blocks if the image is wider than maxWidth.
+	void build(const float* rgba32f, uint32 srcWidth, uint32 srcHeight, uint32 maxWidth, ThreadPool* threadPool = nullptr);
+
+	// @param u1, u2  Uniform random numbers in [0, 1).
+	// @param outPdf  Pdf of the direction w.r.t. solid angle.
+	vec3 sample(float u1, float u2, float& outPdf) const;
+
+	// Pdf w.r.t. solid angle.
+	float pdf(const vec3& dir) const;
+
+	uint32             width = 0;
+	uint32             height = 0;
+	std::vector<float> conditionalCdf; // height rows of (width + 1) entries.
+	std::vector<float> marginalCdf;    // (height + 1) entries.
+};
+
+struct EnvironmentMapDesc
+{
+	uint32 radianceSize        = 512; // Power of two
+	uint32 supersamplesPerAxis = 2;
+	uint32 irradianceSize      = 32;
+	uint32 specularSize        = 128;
+	uint32 specularNumLevels   = 6;
+	uint32 specularNumSamples  = 64;
+	uint32 cdfMaxWidth         = 1024;
+};
+
+// Processed environment map. Cubes are R16G16B16A16_FLOAT with 6 faces in each level,
+// uploaded with subresource index (mip + face * numLevels).
+struct EnvironmentMap
+{
+	MipChain                radiance;   // Full mips
+	MipChain                irradiance; // Single level
+	MipChain                specular;   // desc.specularNumLevels
+	EnvironmentLuminanceCDF luminanceCDF;
+	bool                    bFromCache = false;
+};
+
+// Loads an equirect .hdr or .exr file and processes it, or reads the results from the texture cache.
+// @return null if the file can't be loaded. You need to delete the returned object.
+EnvironmentMap* loadEnvironmentMap(
+	const std::wstring& path,
+	const EnvironmentMapDesc& desc,
+	ThreadPool* threadPool = nullptr,
+	bool useResourceFinder = true);
@@ -0,0 +1,407 @@
+#include "hdr_image_loader.h"
+#include "core/half_float.h"
+#include "util/mapped_file.h"
+#include "util/resource_finder.h"
+#include "util/string_conversion.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+
+// ------------------------------------------------
+// OpenEXR
+// https://openexr.com/en/latest/OpenEXRFileLayout.html
+// All values are little endian, same as the platforms we run on.
+
+#define EXR_MAGIC              20000630
+#define EXR_FLAG_TILED         0x200
+#define EXR_FLAG_NON_IMAGE     0x800
+#define EXR_FLAG_MULTI_PART    0x1000
+
+enum class EEXRCompression : uint8
+{
+	None = 0,
+	RLE  = 1,
+	ZIPS = 2,
+	ZIP  = 3,
+};
+
+enum class EEXRPixelType : int32
+{
+	Uint  = 0,
+	Half  = 1,
+	Float = 2,
+};
+
+struct EXRChannel
+{
+	std::string   name;
+	EEXRPixelType pixelType;
+	int32         outComponent; // -1 if not read.
+	uint32        byteOffset;   // In a scanline of the block.
+};
+
+class EXRStream
+{
+public:
+	EXRStream(const uint8* inData, uint64 inSize) : data(inData), size(inSize) {}
+
+	template<typename T>
+	bool read(T& outValue)
+	{
+		if (position + sizeof(T) > size) return false;
+		::memcpy(&outValue, data + position, sizeof(T));
+		position += sizeof(T);
+		return true;
+	}
+	bool readString(std::string& outString)
+	{
+		const uint8* begin = data + position;
+		const uint8* end = std::find(begin, data + size, (uint8)0);
+		if (end == data + size) return false;
+		outString.assign(reinterpret_cast<const char*>(begin), end - begin);
+		position += (end - begin) + 1;
+		return true;
+	}
+	bool skip(uint64 numBytes)
+	{
+		if (position + numBytes > size) return false;
+		position += numBytes;
+		return true;
+	}
+
+	inline uint64 getPosition() const { return position; }
+	inline void setPosition(uint64 inPosition) { position = std::min(inPosition, size); }
+
+private:
+	const uint8* data;
+	uint64       size;
+	uint64       position = 0;
+};
+
+static uint32 getEXRPixelTypeBytes(EEXRPixelType pixelType)
+{
+	return (pixelType == EEXRPixelType::Half) ? 2 : 4;
+}
+
+static bool decompressRLE(const uint8* src, uint64 srcSize, uint8* dst, uint64 dstSize)
+{
+	uint64 written = 0;
+	const uint8* srcEnd = src + srcSize;
+	while (src < srcEnd)
+	{
+		const int32 count = (int8)*src++;
+		if (count < 0)
+		{
+			const uint64 literalCount = (uint64)(-count);
+			if (src + literalCount > srcEnd || written + literalCount > dstSize) return false;
+			::memcpy(dst + written, src, literalCount);
+			src += literalCount;
+			written += literalCount;
+		}
+		else
+		{
+			const uint64 runCount = (uint64)count + 1;
+			if (src >= srcEnd || written + runCount > dstSize) return false;
+			::memset(dst + written, *src++, runCount);
+			written += runCount;
+		}
+	}
+	return written == dstSize;
+}
+
+// RLE and ZIP store deltas of bytes, with the first and second halves of each 2 bytes split apart.
+static void reconstructPredictedBytes(uint8* temp, uint64 size, uint8* dst)
+{
+	for (uint64 i = 1; i < size; ++i)
+	{
+		temp[i] = (uint8)(temp[i - 1] + temp[i] - 128);
+	}
+	const uint8* firstHalf = temp;
+	const uint8* secondHalf = temp + (size + 1) / 2;
+	for (uint64 i = 0; i < size; ++i)
+	{
+		dst[i] = (i & 1) ? *secondHalf++ : *firstHalf++;
+	}
+}
+
+HDRImageLoadData* HDRImageLoader::loadEXRFromMemory(const uint8* data, uint64 size, bool flipY)
+{
+	EXRStream stream(data, size);
+	int32 magic, version;
+	if (!stream.read(magic) || !stream.read(version) || magic != EXR_MAGIC || (version & 0xff) != 2)
+	{
+		return nullptr;
+	}
+	if (version & (EXR_FLAG_TILED | EXR_FLAG_NON_IMAGE | EXR_FLAG_MULTI_PART))
+	{
+		return nullptr;
+	}
+
+	std::vector<EXRChannel> channels;
+	EEXRCompression compression = EEXRCompression::None;
+	int32 dataWindow[4] = { 0, 0, -1, -1 };
+	bool bHasCompression = false, bHasDataWindow = false;
+	while (true)
+	{
+		std::string name, type;
+		int32 attributeSize;
+		if (!stream.readString(name))
+		{
+			return nullptr;
+		}
+		if (name.empty())
+		{
+			break;
+		}
+		if (!stream.readString(type) || !stream.read(attributeSize) || attributeSize < 0)
+		{
+			return nullptr;
+		}
+		const uint64 attributeEnd = stream.getPosition() + (uint64)attributeSize;
+
+		if (name == "channels" && type == "chlist")
+		{
+			std::string channelName;
+			while (stream.readString(channelName) && !channelName.empty())
+			{
+				int32 pixelType, xSampling, ySampling;
+				if (!stream.read(pixelType) || !stream.skip(4) || !stream.read(xSampling) || !stream.read(ySampling))
+				{
+					return nullptr;
+				}
+				if (pixelType < 0 || pixelType > 2 || xSampling != 1 || ySampling != 1)
+				{
+					return nullptr;
+				}
+				channels.push_back(EXRChannel{ channelName, (EEXRPixelType)pixelType, -1, 0 });
+			}
+		}
+		else if (name == "compression" && type == "compression")
+		{
+			uint8 value;
+			if (!stream.read(value) || value > (uint8)EEXRCompression::ZIP)
+			{
+				return nullptr;
+			}
+			compression = (EEXRCompression)value;
+			bHasCompression = true;
+		}
+		else if (name == "dataWindow" && type == "box2i")
+		{
+			for (int32& value : dataWindow)
+			{
+				if (!stream.read(value)) return nullptr;
+			}
+			bHasDataWindow = true;
+		}
+		stream.setPosition(attributeEnd);
+	}
+	if (channels.empty() || !bHasCompression || !bHasDataWindow)
+	{
+		return nullptr;
+	}
+
+	const int64 width64 = (int64)dataWindow[2] - dataWindow[0] + 1;
+	const int64 height64 = (int64)dataWindow[3] - dataWindow[1] + 1;
+	if (width64 <= 0 || height64 <= 0 || width64 > 65536 || height64 > 65536)
+	{
+		return nullptr;
+	}
+	const uint32 width = (uint32)width64;
+	const uint32 height = (uint32)height64;
+
+	// Channels are sorted by name in the file. Map R, G, B, A, or Y for greyscale.
+	bool bHasColor = false, bHasLuminance = false, bHasAlpha = false;
+	uint32 scanlineBytes = 0;
+	for (EXRChannel& channel : channels)
+	{
+		if (channel.name == "R") channel.outComponent = 0;
+		else if (channel.name == "G") channel.outComponent = 1;
+		else if (channel.name == "B") channel.outComponent = 2;
+		else if (channel.name == "A") channel.outComponent = 3;
+		else if (channel.name == "Y") channel.outComponent = 0;
+		bHasColor = bHasColor || (channel.outComponent >= 0 && channel.outComponent <= 2 && channel.name != "Y");
+		bHasLuminance = bHasLuminance || channel.name == "Y";
+		bHasAlpha = bHasAlpha || channel.name == "A";
+		channel.byteOffset = scanlineBytes;
+		scanlineBytes += width * getEXRPixelTypeBytes(channel.pixelType);
+	}
+	if (!bHasColor && !bHasLuminance)
+	{
+		return nullptr;
+	}
+	if (bHasColor)
+	{
+		for (EXRChannel& channel : channels)
+		{
+			if (channel.name == "Y") channel.outComponent = -1;
+		}
+	}
+
+	const uint32 linesPerBlock = (compression == EEXRCompression::ZIP) ? 16 : 1;
+	const uint32 numBlocks = (height + linesPerBlock - 1) / linesPerBlock;
+	std::vector<uint64> offsets(numBlocks);
+	for (uint64& offset : offsets)
+	{
+		if (!stream.read(offset)) return nullptr;
+	}
+
+	HDRImageLoadData* image = new HDRImageLoadData;
+	image->width = width;
+	image->height = height;
+	image->numFileComponents = bHasColor ? (bHasAlpha ? 4 : 3) : (bHasAlpha ? 2 : 1);
+	image->pixels.assign(uint64(width) * height * 4, 0.0f);
+	for (uint64 i = 0; i < uint64(width) * height; ++i)
+	{
+		image->pixels[4 * i + 3] = 1.0f;
+	}
+
+	std::vector<uint8> blockData(uint64(scanlineBytes) * linesPerBlock);
+	std::vector<uint8> tempData(blockData.size());
+	for (uint32 block = 0; block < numBlocks; ++block)
+	{
+		stream.setPosition(offsets[block]);
+		int32 blockY, packedSize;
+		if (!stream.read(blockY) || !stream.read(packedSize) || packedSize < 0 || !stream.skip((uint64)packedSize))
+		{
+			delete image;
+			return nullptr;
+		}
+		const uint8* packed = data + stream.getPosition() - packedSize;
+
+		const int64 firstLine = (int64)blockY - dataWindow[1];
+		if (firstLine < 0 || firstLine >= height || firstLine % linesPerBlock != 0)
+		{
+			delete image;
+			return nullptr;
+		}
+		const uint32 numLines = std::min(linesPerBlock, height - (uint32)firstLine);
+		const uint64 unpackedSize = uint64(scanlineBytes) * numLines;
+
+		// Blocks that don't get smaller are stored as is.
+		bool bValidBlock = true;
+		if (compression == EEXRCompression::None || (uint64)packedSize == unpackedSize)
+		{
+			bValidBlock = (uint64)packedSize == unpackedSize;
+			if (bValidBlock) ::memcpy(blockData.data(), packed, unpackedSize);
+		}
+		else if (compression == EEXRCompression::RLE)
+		{
+			bValidBlock = decompressRLE(packed, packedSize, tempData.data(), unpackedSize);
+			if (bValidBlock) reconstructPredictedBytes(tempData.data(), unpackedSize, blockData.data());
+		}
+		else
+		{
+			const int32 decodedSize = ::stbi_zlib_decode_buffer(
+				reinterpret_cast<char*>(tempData.data()), (int32)unpackedSize,
+				reinterpret_cast<const char*>(packed), packedSize);
+			bValidBlock = decodedSize == (int32)unpackedSize;
+			if (bValidBlock) reconstructPredictedBytes(tempData.data(), unpackedSize, blockData.data());
+		}
+		if (!bValidBlock)
+		{
+			delete image;
+			return nullptr;
+		}
+
+		for (uint32 line = 0; line < numLines; ++line)
+		{
+			const uint32 y = (uint32)firstLine + line;
+			float* dstRow = image->pixels.data() + uint64(flipY ? (height - 1 - y) : y) * width * 4;
+			const uint8* srcLine = blockData.data() + uint64(line) * scanlineBytes;
+			for (const EXRChannel& channel : channels)
+			{
+				if (channel.outComponent < 0)
+				{
+					continue;
+				}
+				const uint8* src = srcLine + channel.byteOffset;
+				float* dst = dstRow + channel.outComponent;
+				for (uint32 x = 0; x < width; ++x, dst += 4)
+				{
+					if (channel.pixelType == EEXRPixelType::Half)
+					{
+						uint16 value;
+						::memcpy(&value, src + 2 * x, 2);
+						*dst = halfToFloat(value);
+					}
+					else if (channel.pixelType == EEXRPixelType::Float)
+					{
+						::memcpy(dst, src + 4 * x, 4);
+					}
+					else
+					{
+						uint32 value;
+						::memcpy(&value, src + 4 * x, 4);
+						*dst = (float)value;
+					}
+				}
+			}
+			if (!bHasColor)
+			{
+				for (uint32 x = 0; x < width; ++x)
+				{
+					dstRow[4 * x + 1] = dstRow[4 * x + 2] = dstRow[4 * x + 0];
+				}
+			}
+		}
+	}
+
+	return image;
+}
+
+// ------------------------------------------------
+// HDRImageLoader
+
+static bool isEXRFile(const std::wstring& path)
+{
+	if (path.size() < 4)
+	{
+		return false;
+	}
+	std::wstring extension = path.substr(path.size() - 4);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](wchar_t c) { return (wchar_t)std::towlower(c); });
+	return extension == L".exr";
+}
+
+HDRImageLoadData* HDRImageLoader::load(const std::wstring& path, bool flipY, bool useResourceFinder)
+{
+	const std::wstring wsPath = useResourceFinder ? ResourceFinder::get().find(path) : path;
+	if (wsPath.size() == 0)
+	{
+		return nullptr;
+	}
+
+	if (isEXRFile(wsPath))
+	{
+		MappedFile mappedFile;
+		if (!mappedFile.open(wsPath))
+		{
+			return nullptr;
+		}
+		return loadEXRFromMemory(mappedFile.getData(), mappedFile.getSize(), flipY);
+	}
+
+	std::string sPath;
+	wstr_to_str(wsPath, sPath);
+
+	int width, height, numFileComponents;
+	stbi_set_flip_vertically_on_load_thread(flipY);
+	float* buffer = ::stbi_loadf(sPath.c_str(), &width, &height, &numFileComponents, 4);
+	stbi_set_flip_vertically_on_load_thread(false);
+	if (buffer == nullptr)
+	{
+		return nullptr;
+	}
+
+	HDRImageLoadData* image = new HDRImageLoadData;
+	image->width = (uint32)width;
+	image->height = (uint32)height;
+	image->numFileComponents = (uint32)numFileComponents;
+	image->pixels.assign(buffer, buffer + uint64(width) * height * 4);
+	::stbi_image_free(buffer);
+	return image;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "core/int_types.h"
+
+#include <string>
+#include <vector>
+
+// Linear rgba32f image, tightly packed.
+struct HDRImageLoadData
+{
+	inline uint64 getRowPitch() const { return uint64(width) * 4 * sizeof(float); }
+	inline uint64 getSlicePitch() const { return getRowPitch() * uint64(height); }
+
+	std::vector<float> pixels;
+	uint32 width = 0;
+	uint32 height = 0;
+	uint32 numFileComponents = 0; // Components stored in the file, 1 ~ 4.
+};
+
+// Loads Radiance .hdr files with stb_image, and OpenEXR files with its own reader.
+// The EXR reader supports single part scanline images with NONE, RLE, ZIPS or ZIP compression
+// and HALF, FLOAT or UINT channels. R, G, B, A channels are read, or Y for greyscale images.
+// Other file types are loaded with stb_image and converted to linear.
+class HDRImageLoader
+{
+public:
+	// Returns null if failed. You need to delete the returned object.
+	HDRImageLoadData* load(const std::wstring& path, bool flipY = false, bool useResourceFinder = true);
+
+	// Same as above, for an EXR file in memory.
+	static HDRImageLoadData* loadEXRFromMemory(const uint8* data, uint64 size, bool flipY = false);
+};
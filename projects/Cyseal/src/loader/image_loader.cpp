@@ -1,8 +1,13 @@
 #include "image_loader.h"
+#include "mip_generator.h"
 #include "util/string_conversion.h"
 #include "util/resource_finder.h"
+#include "core/assertion.h"
+#include "core/thread_pool.h"
 
 #include <filesystem>
+#include <cstdlib>
+#include <cstring>
 
 static void ensureDirectory(const std::wstring& path)
 {
@@ -19,16 +24,36 @@ static void ensureDirectory(const std::wstring& path)
 #define __STDC_LIB_EXT1__
 #include <stb_image_write.h>
 
-ImageLoadData* loadImage_internal(char const* filename, bool flipY)
+static uint32 getRequiredComponents(EImageChannels channels, int32 numFileComponents)
 {
-	const int numRequiredComps = 4; // RGB-only data cannot be directly uploaded for RGBA8 formats.
-	int width, height, numActualComponents;
+	switch (channels)
+	{
+		case EImageChannels::Native : return (numFileComponents == 3) ? 4 : (uint32)numFileComponents;
+		case EImageChannels::R      : return 1;
+		case EImageChannels::RG     : return 2;
+		case EImageChannels::RGBA   : return 4;
+	}
+	CHECK_NO_ENTRY();
+	return 4;
+}
+
+ImageLoadData* loadImage_internal(char const* filename, bool flipY, const ImageLoadOptions& options)
+{
+	int width, height, numFileComponents;
+	if (0 == ::stbi_info(filename, &width, &height, &numFileComponents))
+	{
+		return nullptr;
+	}
+	// RGB-only data cannot be directly uploaded for RGBA8 formats.
+	const uint32 numComponents = getRequiredComponents(options.channels, numFileComponents);
+	const bool b16Bit = options.bAllow16Bit && (0 != ::stbi_is_16_bit(filename));
 
-	if (flipY) stbi_set_flip_vertically_on_load(true);
-	unsigned char* buffer = ::stbi_load(filename, &width, &height, &numActualComponents, numRequiredComps);
-	if (flipY) stbi_set_flip_vertically_on_load(false);
-	
-	uint32 numComponents = (std::max)(numRequiredComps, numActualComponents);
+	// Per-thread flag, as images may be decoded in parallel.
+	stbi_set_flip_vertically_on_load_thread(flipY);
+	void* buffer = b16Bit
+		? (void*)::stbi_load_16(filename, &width, &height, &numFileComponents, (int)numComponents)
+		: (void*)::stbi_load(filename, &width, &height, &numFileComponents, (int)numComponents);
+	stbi_set_flip_vertically_on_load_thread(false);
 
 	if (buffer == nullptr)
 	{
@@ -37,24 +62,61 @@ ImageLoadData* loadImage_internal(char const* filename, bool flipY)
 
 	ImageLoadData* imageBlob = new ImageLoadData;
 
-	imageBlob->buffer = reinterpret_cast<uint8*>(buffer);
-	imageBlob->length = static_cast<uint32>(width * height * numComponents);
+	imageBlob->buffer.reset(reinterpret_cast<uint8*>(buffer));
 	imageBlob->width = static_cast<uint32>(width);
 	imageBlob->height = static_cast<uint32>(height);
-	imageBlob->numComponents = static_cast<uint32>(numComponents);
+	imageBlob->numComponents = numComponents;
+	imageBlob->bytesPerComponent = b16Bit ? 2 : 1;
+	imageBlob->numFileComponents = static_cast<uint32>(numFileComponents);
+	imageBlob->length = static_cast<uint32>(imageBlob->getSlicePitch());
 
 	return imageBlob;
 }
 
+// ------------------------------------------------
+// ImageLoadData
+
+void ImageBufferDeleter::operator()(uint8* buffer) const
+{
+	::stbi_image_free(buffer);
+}
+
+void ImageLoadData::allocate(uint32 inWidth, uint32 inHeight, uint32 inNumComponents, uint32 inBytesPerComponent)
+{
+	CHECK(inNumComponents == 1 || inNumComponents == 2 || inNumComponents == 4);
+	CHECK(inBytesPerComponent == 1 || inBytesPerComponent == 2);
+
+	width = inWidth;
+	height = inHeight;
+	numComponents = inNumComponents;
+	bytesPerComponent = inBytesPerComponent;
+	numFileComponents = inNumComponents;
+	length = static_cast<uint32>(getSlicePitch());
+	buffer.reset(reinterpret_cast<uint8*>(::calloc(length, 1)));
+}
+
+EPixelFormat ImageLoadData::getPixelFormat() const
+{
+	const bool b16Bit = bytesPerComponent == 2;
+	switch (numComponents)
+	{
+		case 1: return b16Bit ? EPixelFormat::R16_UNORM : EPixelFormat::R8_UNORM;
+		case 2: return b16Bit ? EPixelFormat::R16G16_UNORM : EPixelFormat::R8G8_UNORM;
+		case 4: return b16Bit ? EPixelFormat::R16G16B16A16_UNORM : EPixelFormat::R8G8B8A8_UNORM;
+	}
+	CHECK_NO_ENTRY();
+	return EPixelFormat::UNKNOWN;
+}
+
 // ------------------------------------------------
 // ImageLoader
 
-ImageLoadData* ImageLoader::load(const std::wstring& path, bool flipY, bool useResourceFinder)
+ImageLoadData* ImageLoader::load(const std::wstring& path, bool flipY, bool useResourceFinder, const ImageLoadOptions& options)
 {
 	std::wstring wsPath = useResourceFinder ? ResourceFinder::get().find(path) : path;
 	std::string sPath;
 	wstr_to_str(wsPath, sPath);
-	return loadImage_internal(sPath.c_str(), flipY);
+	return loadImage_internal(sPath.c_str(), flipY, options);
 }
 
 bool ImageLoader::saveAsPng(const std::wstring& wPath, void* rgba8Data, uint32 width, uint32 height, uint64 rowPitch)
@@ -68,3 +130,49 @@ bool ImageLoader::saveAsPng(const std::wstring& wPath, void* rgba8Data, uint32 w
 	int ret = stbi_write_png(sPath.c_str(), (int)width, (int)height, 4, rgba8Data, (int)rowPitch);
 	return ret != 0;
 }
+
+MipChain* decodeVolumeSlices(const std::vector<std::wstring>& slicePaths, ThreadPool* threadPool)
+{
+	const uint32 numSlices = (uint32)slicePaths.size();
+	if (numSlices == 0)
+	{
+		return nullptr;
+	}
+
+	// PNG decoding dominates, so each file is a chunk.
+	std::vector<std::unique_ptr<ImageLoadData>> slices(numSlices);
+	auto decodeSlices = [&](uint32 chunkIx, uint32 begin, uint32 end)
+	{
+		ImageLoader loader;
+		for (uint32 i = begin; i < end; ++i)
+		{
+			slices[i].reset(loader.load(slicePaths[i], false, false));
+		}
+	};
+	if (threadPool != nullptr)
+	{
+		threadPool->parallelFor(numSlices, 1, decodeSlices);
+	}
+	else
+	{
+		decodeSlices(0, 0, numSlices);
+	}
+
+	for (const std::unique_ptr<ImageLoadData>& slice : slices)
+	{
+		if (slice == nullptr || slice->width != slices[0]->width || slice->height != slices[0]->height)
+		{
+			return nullptr;
+		}
+	}
+
+	MipChain* volume = new MipChain;
+	volume->allocate(EPixelFormat::R8G8B8A8_UNORM, slices[0]->width, slices[0]->height, 1, numSlices);
+	const uint64 slicePitch = volume->levels[0].slicePitch;
+	CHECK(slicePitch == slices[0]->getSlicePitch());
+	for (uint32 i = 0; i < numSlices; ++i)
+	{
+		::memcpy(volume->getSliceData(0, i), slices[i]->getBuffer(), slicePitch);
+	}
+	return volume;
+}
@@ -1,37 +1,67 @@
 #pragma once
 
 #include "core/int_types.h"
+#include "rhi/pixel_format.h"
+
 #include <string>
+#include <vector>
+#include <memory>
+
+class ThreadPool;
+struct MipChain;
+
+// Releases a buffer allocated by malloc(), which stb_image uses.
+struct ImageBufferDeleter
+{
+	void operator()(uint8* buffer) const;
+};
 
 struct ImageLoadData
 {
-	~ImageLoadData()
-	{
-		if (buffer != nullptr)
-		{
-			delete buffer;
-			buffer = nullptr;
-		}
-	}
-
-	inline uint64 getRowPitch() const { return uint64(width) * uint64(numComponents); }
+	// Allocates a zero-initialized buffer of (width * height * numComponents * bytesPerComponent) bytes.
+	void allocate(uint32 inWidth, uint32 inHeight, uint32 inNumComponents, uint32 inBytesPerComponent = 1);
+
+	inline uint8* getBuffer() const { return buffer.get(); }
+	inline uint64 getRowPitch() const { return uint64(width) * uint64(numComponents) * uint64(bytesPerComponent); }
 	inline uint64 getSlicePitch() const { return getRowPitch() * uint64(height); }
 
-	uint8* buffer = nullptr;
+	// R8_UNORM, R8G8_UNORM, R8G8B8A8_UNORM, or their 16-bit versions.
+	EPixelFormat getPixelFormat() const;
+
+	std::unique_ptr<uint8[], ImageBufferDeleter> buffer;
 	uint32 length = 0; // Size in bytes
 	uint32 width = 0;
 	uint32 height = 0;
-	uint32 numComponents = 0; // # of 8-bit components
+	uint32 numComponents = 0;        // 1, 2 or 4 components in the buffer.
+	uint32 bytesPerComponent = 1;    // 1 or 2. 16-bit components are in native endian.
+	uint32 numFileComponents = 0;    // Components stored in the file, 1 ~ 4.
+};
+
+// Components that a user of an image needs.
+// Components are converted by stb_image: rgb to grey is luminance, and grey to rgb replicates grey.
+enum class EImageChannels : uint8
+{
+	Native, // Same as the file, except that rgb is expanded to rgba as there are no 3-component texture formats.
+	R,      // Grey
+	RG,     // Grey and alpha
+	RGBA,
+};
+
+struct ImageLoadOptions
+{
+	EImageChannels channels    = EImageChannels::RGBA;
+	bool           bAllow16Bit = false; // If true, 16-bit files are loaded as 16-bit. Otherwise converted to 8-bit.
 };
 
 class ImageLoader
 {
 public:
-	// Returns null if failed. You need to free the memory manually.
-	ImageLoadData* load(const std::wstring& path, bool flipY = false, bool useResourceFinder = true);
+	// Returns null if failed. You need to delete the returned object.
+	// By default, images are loaded as rgba8 regardless of their files.
+	ImageLoadData* load(const std::wstring& path, bool flipY = false, bool useResourceFinder = true, const ImageLoadOptions& options = {});
 
 	/// <summary>
-	/// Save rgba8 data as png.
+	/// Save rgba8 data as png. Blocks on compression; see AsyncImageWriter to save on worker threads.
 	/// </summary>
 	/// <param name="wPath">Path to write the image.</param>
 	/// <param name="rgba8Data">Pointer to rgba8 buffer (each pixel is 4 bytes)</param>
@@ -44,3 +74,8 @@ public:
 private:
 	//
 };
+
+// Decodes rgba8 image files as slices of a volume. Files are decoded in parallel if a thread pool is given.
+// @return null if any file fails to load or sizes differ. Caller owns the volume.
+//         The volume has a single level whose data holds all slices.
+MipChain* decodeVolumeSlices(const std::vector<std::wstring>& slicePaths, ThreadPool* threadPool = nullptr);
@@ -0,0 +1,567 @@
+#include "image_writer.h"
+#include "core/half_float.h"
+#include "core/assertion.h"
+
+#include <stb_image_write.h>
+
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+// Defined with STB_IMAGE_WRITE_IMPLEMENTATION in image_loader.cpp, but not declared by the header.
+// Thread safe, unlike stbi_write_png() which reads the compression level from a global.
+// Returns a buffer allocated with malloc().
+extern "C" unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+// Max length of hash chains in stb's deflate. Values less than 5 are same as 5.
+static int getZlibQuality(EImageCompression compression)
+{
+	switch (compression)
+	{
+		case EImageCompression::Fast    : return 5;
+		case EImageCompression::Default : return 8; // stbi_write_png_compression_level
+		case EImageCompression::Best    : return 32;
+	}
+	CHECK_NO_ENTRY();
+	return 8;
+}
+
+static inline void appendBytes(std::vector<uint8>& out, const void* data, uint64 size)
+{
+	const uint8* bytes = reinterpret_cast<const uint8*>(data);
+	out.insert(out.end(), bytes, bytes + size);
+}
+
+static inline void appendBigEndian32(std::vector<uint8>& out, uint32 value)
+{
+	const uint8 bytes[4] = { (uint8)(value >> 24), (uint8)(value >> 16), (uint8)(value >> 8), (uint8)value };
+	appendBytes(out, bytes, 4);
+}
+
+// ------------------------------------------------
+// Checksums
+
+// Slicing-by-8 tables of CRC-32 (ISO 3309), as PNG chunks of large images are checksummed in full.
+static const uint32* getCRC32Tables()
+{
+	static const std::vector<uint32> tables = []()
+	{
+		std::vector<uint32> t(8 * 256);
+		for (uint32 i = 0; i < 256; ++i)
+		{
+			uint32 crc = i;
+			for (uint32 bit = 0; bit < 8; ++bit)
+			{
+				crc = (crc & 1) ? (0xedb88320u ^ (crc >> 1)) : (crc >> 1);
+			}
+			t[i] = crc;
+		}
+		for (uint32 k = 1; k < 8; ++k)
+		{
+			for (uint32 i = 0; i < 256; ++i)
+			{
+				const uint32 prev = t[(k - 1) * 256 + i];
+				t[k * 256 + i] = (prev >> 8) ^ t[prev & 0xff];
+			}
+		}
+		return t;
+	}();
+	return tables.data();
+}
+
+static uint32 updateCRC32(uint32 crc, const uint8* data, uint64 size)
+{
+	const uint32* t = getCRC32Tables();
+	crc = ~crc;
+	for (; size >= 8; size -= 8, data += 8)
+	{
+		uint32 lo, hi;
+		::memcpy(&lo, data, 4);
+		::memcpy(&hi, data + 4, 4);
+		lo ^= crc;
+		crc = t[7 * 256 + (lo & 0xff)] ^ t[6 * 256 + ((lo >> 8) & 0xff)]
+			^ t[5 * 256 + ((lo >> 16) & 0xff)] ^ t[4 * 256 + (lo >> 24)]
+			^ t[3 * 256 + (hi & 0xff)] ^ t[2 * 256 + ((hi >> 8) & 0xff)]
+			^ t[1 * 256 + ((hi >> 16) & 0xff)] ^ t[0 * 256 + (hi >> 24)];
+	}
+	for (; size > 0; --size, ++data)
+	{
+		crc = t[(crc ^ *data) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static uint32 calcAdler32(const uint8* data, uint64 size)
+{
+	// Largest count of bytes before s2 can overflow.
+	constexpr uint64 maxBlockSize = 5552;
+	uint32 s1 = 1, s2 = 0;
+	while (size > 0)
+	{
+		const uint64 blockSize = std::min(size, maxBlockSize);
+		for (uint64 i = 0; i < blockSize; ++i)
+		{
+			s1 += data[i];
+			s2 += s1;
+		}
+		s1 %= 65521;
+		s2 %= 65521;
+		data += blockSize;
+		size -= blockSize;
+	}
+	return (s2 << 16) | s1;
+}
+
+// zlib stream of stored deflate blocks.
+static void storeZlib(const uint8* data, uint64 size, std::vector<uint8>& out)
+{
+	constexpr uint64 maxBlockSize = 65535;
+	out.reserve(out.size() + size + 5 * (size / maxBlockSize + 1) + 6);
+	const uint8 header[2] = { 0x78, 0x01 };
+	appendBytes(out, header, 2);
+	uint64 offset = 0;
+	do
+	{
+		const uint32 blockSize = (uint32)std::min(size - offset, maxBlockSize);
+		const bool bFinal = (offset + blockSize == size);
+		const uint8 blockHeader[5] = {
+			(uint8)(bFinal ? 1 : 0),
+			(uint8)blockSize, (uint8)(blockSize >> 8),
+			(uint8)~blockSize, (uint8)(~blockSize >> 8) };
+		appendBytes(out, blockHeader, 5);
+		appendBytes(out, data + offset, blockSize);
+		offset += blockSize;
+	} while (offset < size);
+	appendBigEndian32(out, calcAdler32(data, size));
+}
+
+// Appends a zlib stream of the data.
+static void compressZlib(uint8* data, uint64 size, EImageCompression compression, std::vector<uint8>& out)
+{
+	if (compression != EImageCompression::None)
+	{
+		int compressedSize = 0;
+		unsigned char* compressed = ::stbi_zlib_compress(data, (int)size, &compressedSize, getZlibQuality(compression));
+		if (compressed != nullptr)
+		{
+			appendBytes(out, compressed, (uint64)compressedSize);
+			::free(compressed);
+			return;
+		}
+	}
+	storeZlib(data, size, out);
+}
+
+// ------------------------------------------------
+// PNG
+
+enum class EPNGFilter : uint8
+{
+	None    = 0,
+	Sub     = 1,
+	Up      = 2,
+	Average = 3,
+	Paeth   = 4,
+};
+
+static inline uint8 paethPredictor(int32 a, int32 b, int32 c)
+{
+	const int32 pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+	if (pa <= pb && pa <= pc) return (uint8)a;
+	if (pb <= pc) return (uint8)b;
+	return (uint8)c;
+}
+
+// prevRow is all zeros for the first row.
+static void filterPNGRow(const uint8* row, const uint8* prevRow, uint32 rowBytes, EPNGFilter filter, uint8* dst)
+{
+	constexpr uint32 bpp = 4;
+	switch (filter)
+	{
+		case EPNGFilter::None:
+			::memcpy(dst, row, rowBytes);
+			break;
+		case EPNGFilter::Sub:
+			for (uint32 i = 0; i < bpp; ++i) dst[i] = row[i];
+			for (uint32 i = bpp; i < rowBytes; ++i) dst[i] = (uint8)(row[i] - row[i - bpp]);
+			break;
+		case EPNGFilter::Up:
+			for (uint32 i = 0; i < rowBytes; ++i) dst[i] = (uint8)(row[i] - prevRow[i]);
+			break;
+		case EPNGFilter::Average:
+			for (uint32 i = 0; i < bpp; ++i) dst[i] = (uint8)(row[i] - (prevRow[i] >> 1));
+			for (uint32 i = bpp; i < rowBytes; ++i) dst[i] = (uint8)(row[i] - ((row[i - bpp] + prevRow[i]) >> 1));
+			break;
+		case EPNGFilter::Paeth:
+			for (uint32 i = 0; i < bpp; ++i) dst[i] = (uint8)(row[i] - prevRow[i]);
+			for (uint32 i = bpp; i < rowBytes; ++i) dst[i] = (uint8)(row[i] - paethPredictor(row[i - bpp], prevRow[i], prevRow[i - bpp]));
+			break;
+	}
+}
+
+// Sum of filtered bytes as signed values. Smaller sums usually compress better.
+static uint32 estimateFilteredRowCost(const uint8* filtered, uint32 rowBytes)
+{
+	uint32 cost = 0;
+	for (uint32 i = 0; i < rowBytes; ++i)
+	{
+		cost += (uint32)std::abs((int32)(int8)filtered[i]);
+	}
+	return cost;
+}
+
+static void appendPNGChunk(std::vector<uint8>& out, const char* type, const uint8* data, uint32 size)
+{
+	appendBigEndian32(out, size);
+	const uint64 typeOffset = out.size();
+	appendBytes(out, type, 4);
+	appendBytes(out, data, size);
+	appendBigEndian32(out, updateCRC32(0, out.data() + typeOffset, 4ull + size));
+}
+
+void encodePNG(const uint8* rgba8, uint32 width, uint32 height, uint64 rowPitch, EImageCompression compression, std::vector<uint8>& outFile)
+{
+	CHECK(width > 0 && height > 0);
+	const uint32 rowBytes = width * 4;
+	if (rowPitch == 0) rowPitch = rowBytes;
+
+	// Each row starts with its filter type.
+	const uint64 filteredRowBytes = uint64(rowBytes) + 1;
+	std::vector<uint8> filtered(filteredRowBytes * height);
+	std::vector<uint8> zeroRow(rowBytes, 0);
+	std::vector<uint8> candidate(compression == EImageCompression::None || compression == EImageCompression::Fast ? 0 : rowBytes);
+	for (uint32 y = 0; y < height; ++y)
+	{
+		const uint8* row = rgba8 + y * rowPitch;
+		const uint8* prevRow = (y == 0) ? zeroRow.data() : (row - rowPitch);
+		uint8* dst = filtered.data() + y * filteredRowBytes;
+
+		EPNGFilter filter = EPNGFilter::None;
+		if (compression == EImageCompression::Fast)
+		{
+			filter = EPNGFilter::Paeth;
+		}
+		else if (compression != EImageCompression::None)
+		{
+			// Same heuristic as stb_image_write, so that Default matches ImageLoader::saveAsPng().
+			uint32 bestCost = 0xffffffff;
+			for (uint8 f = 0; f < 5; ++f)
+			{
+				filterPNGRow(row, prevRow, rowBytes, (EPNGFilter)f, candidate.data());
+				const uint32 cost = estimateFilteredRowCost(candidate.data(), rowBytes);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					filter = (EPNGFilter)f;
+				}
+			}
+		}
+		dst[0] = (uint8)filter;
+		filterPNGRow(row, prevRow, rowBytes, filter, dst + 1);
+	}
+
+	std::vector<uint8> zlibData;
+	compressZlib(filtered.data(), filtered.size(), compression, zlibData);
+	filtered = {};
+
+	const uint8 signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	// Width, height, 8 bits per channel, rgba, deflate, adaptive filters, no interlace.
+	const uint8 header[13] = {
+		(uint8)(width >> 24), (uint8)(width >> 16), (uint8)(width >> 8), (uint8)width,
+		(uint8)(height >> 24), (uint8)(height >> 16), (uint8)(height >> 8), (uint8)height,
+		8, 6, 0, 0, 0 };
+
+	outFile.clear();
+	outFile.reserve(8 + 25 + 12 + zlibData.size() + 12);
+	appendBytes(outFile, signature, 8);
+	appendPNGChunk(outFile, "IHDR", header, 13);
+	appendPNGChunk(outFile, "IDAT", zlibData.data(), (uint32)zlibData.size());
+	appendPNGChunk(outFile, "IEND", nullptr, 0);
+}
+
+// ------------------------------------------------
+// OpenEXR
+// https://openexr.com/en/latest/OpenEXRFileLayout.html
+// All values are little endian, same as the platforms we run on.
+
+#define EXR_MAGIC                20000630
+#define EXR_COMPRESSION_NONE     0
+#define EXR_COMPRESSION_ZIP      3
+#define EXR_PIXEL_TYPE_HALF      1
+#define EXR_PIXEL_TYPE_FLOAT     2
+#define EXR_ZIP_LINES_PER_BLOCK  16
+
+template<typename T>
+static inline void appendValue(std::vector<uint8>& out, const T& value)
+{
+	appendBytes(out, &value, sizeof(T));
+}
+
+static void appendEXRAttribute(std::vector<uint8>& out, const char* name, const char* type, const void* value, uint32 size)
+{
+	appendBytes(out, name, ::strlen(name) + 1);
+	appendBytes(out, type, ::strlen(type) + 1);
+	appendValue(out, (int32)size);
+	appendBytes(out, value, size);
+}
+
+// Inverse of the reader: bytes are split into even and odd halves, then stored as deltas.
+static void predictBytes(const uint8* src, uint64 size, uint8* dst)
+{
+	uint8* firstHalf = dst;
+	uint8* secondHalf = dst + (size + 1) / 2;
+	for (uint64 i = 0; i < size; ++i)
+	{
+		((i & 1) ? *secondHalf++ : *firstHalf++) = src[i];
+	}
+	uint8 prev = dst[0];
+	for (uint64 i = 1; i < size; ++i)
+	{
+		const uint8 current = dst[i];
+		dst[i] = (uint8)(current - prev + 128);
+		prev = current;
+	}
+}
+
+void encodeEXR(const float* rgba32f, uint32 width, uint32 height, uint64 rowPitch, EImageCompression compression, bool bHalfFloat, std::vector<uint8>& outFile)
+{
+	CHECK(width > 0 && height > 0);
+	if (rowPitch == 0) rowPitch = uint64(width) * 4 * sizeof(float);
+
+	const bool bZip = compression != EImageCompression::None;
+	const int32 pixelType = bHalfFloat ? EXR_PIXEL_TYPE_HALF : EXR_PIXEL_TYPE_FLOAT;
+	const uint32 bytesPerValue = bHalfFloat ? 2 : 4;
+	const uint32 channelBytes = width * bytesPerValue;
+	const uint32 scanlineBytes = 4 * channelBytes;
+	const uint32 linesPerBlock = bZip ? EXR_ZIP_LINES_PER_BLOCK : 1;
+	const uint32 numBlocks = (height + linesPerBlock - 1) / linesPerBlock;
+
+	outFile.clear();
+	appendValue(outFile, (int32)EXR_MAGIC);
+	appendValue(outFile, (int32)2); // Single part scanline
+
+	// Channels are sorted by name.
+	const char* channelNames[4] = { "A", "B", "G", "R" };
+	const uint32 channelComponents[4] = { 3, 2, 1, 0 };
+	std::vector<uint8> channelList;
+	for (const char* channelName : channelNames)
+	{
+		appendBytes(channelList, channelName, 2);
+		appendValue(channelList, pixelType);
+		appendValue(channelList, (uint32)0); // pLinear and reserved
+		appendValue(channelList, (int32)1);  // xSampling
+		appendValue(channelList, (int32)1);  // ySampling
+	}
+	channelList.push_back(0);
+
+	const uint8 compressionValue = bZip ? EXR_COMPRESSION_ZIP : EXR_COMPRESSION_NONE;
+	const int32 window[4] = { 0, 0, (int32)width - 1, (int32)height - 1 };
+	const uint8 lineOrder = 0; // Increasing y
+	const float pixelAspectRatio = 1.0f;
+	const float screenWindowCenter[2] = { 0.0f, 0.0f };
+	const float screenWindowWidth = 1.0f;
+	appendEXRAttribute(outFile, "channels", "chlist", channelList.data(), (uint32)channelList.size());
+	appendEXRAttribute(outFile, "compression", "compression", &compressionValue, 1);
+	appendEXRAttribute(outFile, "dataWindow", "box2i", window, sizeof(window));
+	appendEXRAttribute(outFile, "displayWindow", "box2i", window, sizeof(window));
+	appendEXRAttribute(outFile, "lineOrder", "lineOrder", &lineOrder, 1);
+	appendEXRAttribute(outFile, "pixelAspectRatio", "float", &pixelAspectRatio, 4);
+	appendEXRAttribute(outFile, "screenWindowCenter", "v2f", screenWindowCenter, sizeof(screenWindowCenter));
+	appendEXRAttribute(outFile, "screenWindowWidth", "float", &screenWindowWidth, 4);
+	outFile.push_back(0);
+
+	// Offset table is filled as blocks are written.
+	const uint64 offsetTablePosition = outFile.size();
+	outFile.resize(outFile.size() + sizeof(uint64) * numBlocks);
+
+	std::vector<uint8> blockData(uint64(scanlineBytes) * linesPerBlock);
+	std::vector<uint8> predicted(bZip ? blockData.size() : 0);
+	std::vector<uint8> compressed;
+	std::vector<float> channelRow(width);
+	for (uint32 block = 0; block < numBlocks; ++block)
+	{
+		const uint32 firstLine = block * linesPerBlock;
+		const uint32 numLines = std::min(linesPerBlock, height - firstLine);
+		const uint64 unpackedSize = uint64(scanlineBytes) * numLines;
+
+		// Each line holds all values of a channel, then the next channel.
+		for (uint32 line = 0; line < numLines; ++line)
+		{
+			const float* srcRow = reinterpret_cast<const float*>(reinterpret_cast<const uint8*>(rgba32f) + (firstLine + line) * rowPitch);
+			uint8* dstLine = blockData.data() + uint64(line) * scanlineBytes;
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				for (uint32 x = 0; x < width; ++x)
+				{
+					channelRow[x] = srcRow[4 * x + channelComponents[c]];
+				}
+				uint8* dst = dstLine + c * channelBytes;
+				if (bHalfFloat)
+				{
+					convertFloatToHalf(channelRow.data(), reinterpret_cast<uint16*>(dst), width);
+				}
+				else
+				{
+					::memcpy(dst, channelRow.data(), channelBytes);
+				}
+			}
+		}
+
+		const uint8* packed = blockData.data();
+		uint64 packedSize = unpackedSize;
+		if (bZip)
+		{
+			predictBytes(blockData.data(), unpackedSize, predicted.data());
+			compressed.clear();
+			compressZlib(predicted.data(), unpackedSize, compression, compressed);
+			// Blocks that don't get smaller are stored as is.
+			if (compressed.size() < unpackedSize)
+			{
+				packed = compressed.data();
+				packedSize = compressed.size();
+			}
+		}
+
+		const uint64 offset = outFile.size();
+		::memcpy(outFile.data() + offsetTablePosition + sizeof(uint64) * block, &offset, sizeof(uint64));
+		appendValue(outFile, (int32)firstLine);
+		appendValue(outFile, (int32)packedSize);
+		appendBytes(outFile, packed, packedSize);
+	}
+}
+
+bool writeImageFile(const std::wstring& path, const std::vector<uint8>& fileData)
+{
+	const std::filesystem::path filepath(path);
+	std::error_code errorCode;
+	if (filepath.has_parent_path())
+	{
+		std::filesystem::create_directories(filepath.parent_path(), errorCode);
+	}
+	std::ofstream fs(filepath, std::ios::binary | std::ios::trunc);
+	if (!fs)
+	{
+		return false;
+	}
+	fs.write(reinterpret_cast<const char*>(fileData.data()), fileData.size());
+	return (bool)fs;
+}
+
+// ------------------------------------------------
+// AsyncImageWriter
+
+AsyncImageWriter::AsyncImageWriter(uint32 numWorkers, uint32 inMaxQueuedImages)
+	: maxQueuedImages(inMaxQueuedImages)
+{
+	CHECK(numWorkers > 0 && maxQueuedImages > 0);
+	workers.reserve(numWorkers);
+	for (uint32 i = 0; i < numWorkers; ++i)
+	{
+		workers.emplace_back([this]() { workerMain(); });
+	}
+}
+
+AsyncImageWriter::~AsyncImageWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bStopRequested = true;
+	}
+	queueNotEmpty.notify_all();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+std::future<bool> AsyncImageWriter::writePNG(const std::wstring& path, std::vector<uint8>&& rgba8, uint32 width, uint32 height, EImageCompression compression)
+{
+	CHECK(rgba8.size() >= uint64(width) * height * 4);
+	WriteRequest request;
+	request.path = path;
+	request.rgba8 = std::move(rgba8);
+	request.width = width;
+	request.height = height;
+	request.compression = compression;
+	return enqueue(std::move(request));
+}
+
+std::future<bool> AsyncImageWriter::writeEXR(const std::wstring& path, std::vector<float>&& rgba32f, uint32 width, uint32 height, EImageCompression compression, bool bHalfFloat)
+{
+	CHECK(rgba32f.size() >= uint64(width) * height * 4);
+	WriteRequest request;
+	request.path = path;
+	request.rgba32f = std::move(rgba32f);
+	request.width = width;
+	request.height = height;
+	request.compression = compression;
+	request.bHalfFloat = bHalfFloat;
+	return enqueue(std::move(request));
+}
+
+void AsyncImageWriter::flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	allWritten.wait(lock, [this]() { return queue.empty() && numActiveWrites == 0; });
+}
+
+std::future<bool> AsyncImageWriter::enqueue(WriteRequest&& request)
+{
+	std::future<bool> future = request.promise.get_future();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		queueNotFull.wait(lock, [this]() { return queue.size() < maxQueuedImages; });
+		queue.push_back(std::move(request));
+	}
+	queueNotEmpty.notify_one();
+	return future;
+}
+
+void AsyncImageWriter::workerMain()
+{
+	// Reused across images, as encoded files of a sequence have similar sizes.
+	std::vector<uint8> fileData;
+	while (true)
+	{
+		WriteRequest request;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			queueNotEmpty.wait(lock, [this]() { return bStopRequested || !queue.empty(); });
+			// Queued images are still written when stopping.
+			if (queue.empty())
+			{
+				break;
+			}
+			request = std::move(queue.front());
+			queue.pop_front();
+			++numActiveWrites;
+		}
+		queueNotFull.notify_one();
+
+		if (request.rgba32f.empty())
+		{
+			encodePNG(request.rgba8.data(), request.width, request.height, 0, request.compression, fileData);
+		}
+		else
+		{
+			encodeEXR(request.rgba32f.data(), request.width, request.height, 0, request.compression, request.bHalfFloat, fileData);
+		}
+		// Release pixels before the request is done, so that memory stays bounded.
+		request.rgba8 = {};
+		request.rgba32f = {};
+		request.promise.set_value(writeImageFile(request.path, fileData));
+
+		bool bAllWritten;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--numActiveWrites;
+			bAllWritten = queue.empty() && numActiveWrites == 0;
+		}
+		if (bAllWritten)
+		{
+			allWritten.notify_all();
+		}
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "core/int_types.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+
+// Trade-off between file size and encoding time, for PNG and ZIP compressed EXR.
+enum class EImageCompression : uint8
+{
+	None,    // Stored as is. Writing is bound by disk bandwidth.
+	Fast,    // PNG uses Paeth filter for all rows. Shortest match search.
+	Default, // PNG output is the same as ImageLoader::saveAsPng().
+	Best,    // Longer match search.
+};
+
+// Encodes rgba8 pixels as a PNG file in memory.
+// Unlike stb_image_write, the compression level is per call, so images can be encoded in parallel.
+// @param rowPitch  0 means tightly packed.
+void encodePNG(
+	const uint8* rgba8,
+	uint32 width,
+	uint32 height,
+	uint64 rowPitch,
+	EImageCompression compression,
+	std::vector<uint8>& outFile);
+
+// Encodes rgba32f pixels as a single part scanline OpenEXR file with A, B, G, R channels.
+// Blocks are ZIP compressed (16 lines each) unless compression is None. HDRImageLoader reads it back.
+// @param bHalfFloat  Channels are HALF if true, FLOAT otherwise.
+// @param rowPitch    In bytes. 0 means tightly packed.
+void encodeEXR(
+	const float* rgba32f,
+	uint32 width,
+	uint32 height,
+	uint64 rowPitch,
+	EImageCompression compression,
+	bool bHalfFloat,
+	std::vector<uint8>& outFile);
+
+// Writes a file, creating its directory if needed.
+bool writeImageFile(const std::wstring& path, const std::vector<uint8>& fileData);
+
+// Encodes and writes images on worker threads, so that callers don't wait for compression,
+// e.g., screenshots or results of render tests.
+// Callers hand over their pixel buffers. At most maxQueuedImages images wait in the queue,
+// and write requests block while it is full, so memory stays bounded when images are produced
+// faster than they are written (queued images + one image per worker).
+class AsyncImageWriter
+{
+public:
+	AsyncImageWriter(uint32 numWorkers, uint32 maxQueuedImages);
+	// Writes all queued images before returning.
+	~AsyncImageWriter();
+
+	AsyncImageWriter(const AsyncImageWriter&) = delete;
+	AsyncImageWriter& operator=(const AsyncImageWriter&) = delete;
+
+	// @return Becomes true when the file is written, or false if it could not be written.
+	std::future<bool> writePNG(
+		const std::wstring& path,
+		std::vector<uint8>&& rgba8,
+		uint32 width,
+		uint32 height,
+		EImageCompression compression = EImageCompression::Default);
+
+	// @param rgba32f  Tightly packed.
+	std::future<bool> writeEXR(
+		const std::wstring& path,
+		std::vector<float>&& rgba32f,
+		uint32 width,
+		uint32 height,
+		EImageCompression compression = EImageCompression::Default,
+		bool bHalfFloat = true);
+
+	// Blocks until all queued images are written.
+	void flush();
+
+	inline uint32 getNumWorkers() const { return (uint32)workers.size(); }
+	inline uint32 getMaxQueuedImages() const { return maxQueuedImages; }
+
+private:
+	struct WriteRequest
+	{
+		std::wstring       path;
+		std::vector<uint8> rgba8;   // PNG
+		std::vector<float> rgba32f; // EXR
+		uint32             width = 0;
+		uint32             height = 0;
+		EImageCompression  compression = EImageCompression::Default;
+		bool               bHalfFloat = true;
+		std::promise<bool> promise;
+	};
+
+	std::future<bool> enqueue(WriteRequest&& request);
+	void workerMain();
+
+	std::vector<std::thread> workers;
+	const uint32             maxQueuedImages;
+
+	std::mutex               mutex;
+	std::condition_variable  queueNotEmpty;
+	std::condition_variable  queueNotFull;
+	std::condition_variable  allWritten;
+	std::deque<WriteRequest> queue;
+	uint32                   numActiveWrites = 0;
+	bool                     bStopRequested = false;
+};
@@ -0,0 +1,443 @@
+#include "mip_generator.h"
+#include "core/thread_pool.h"
+#include "core/cymath.h"
+#include "core/assertion.h"
+
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// ------------------------------------------------
+// sRGB conversion
+
+#define SRGB_COARSE_TABLE_SIZE 4096
+
+struct SRGBTables
+{
+	SRGBTables()
+	{
+		for (uint32 i = 0; i < 256; ++i)
+		{
+			toLinear[i] = (float)decode((double)i / 255.0);
+		}
+		// Linear values that round to code k in sRGB space are [thresholds[k], thresholds[k + 1]).
+		thresholds[0] = 0.0f;
+		for (uint32 k = 1; k < 256; ++k)
+		{
+			thresholds[k] = (float)decode(((double)k - 0.5) / 255.0);
+		}
+		// Lower bound of the code for each coarse bucket of linear values.
+		// A bucket spans less than one code, so encoding takes at most a step or two from here.
+		uint32 code = 0;
+		for (uint32 i = 0; i < SRGB_COARSE_TABLE_SIZE; ++i)
+		{
+			const float x = (float)i / (float)SRGB_COARSE_TABLE_SIZE;
+			while (code < 255 && thresholds[code + 1] <= x)
+			{
+				++code;
+			}
+			coarse[i] = (uint8)code;
+		}
+	}
+
+	static double decode(double c)
+	{
+		return (c <= 0.04045) ? (c / 12.92) : std::pow((c + 0.055) / 1.055, 2.4);
+	}
+
+	float toLinear[256];
+	float thresholds[256];
+	uint8 coarse[SRGB_COARSE_TABLE_SIZE];
+};
+
+static const SRGBTables& getSRGBTables()
+{
+	static const SRGBTables tables;
+	return tables;
+}
+
+static inline uint8 linearToSrgb8_internal(const SRGBTables& tables, float x)
+{
+	if (!(x > 0.0f)) return 0;
+	if (x >= 1.0f) return 255;
+
+	uint32 code = tables.coarse[(uint32)(x * (float)SRGB_COARSE_TABLE_SIZE)];
+	while (code < 255 && x >= tables.thresholds[code + 1]) ++code;
+	while (code > 0 && x < tables.thresholds[code]) --code;
+	return (uint8)code;
+}
+
+static inline uint8 linearToUnorm8(float x)
+{
+	return (uint8)(std::clamp(x, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+float srgb8ToLinear(uint8 x)
+{
+	return getSRGBTables().toLinear[x];
+}
+
+uint8 linearToSrgb8(float x)
+{
+	return linearToSrgb8_internal(getSRGBTables(), x);
+}
+
+// ------------------------------------------------
+// Filters
+
+static float sinc(float x)
+{
+	if (std::abs(x) < 1e-5f)
+	{
+		return 1.0f;
+	}
+	const float px = Cymath::PI * x;
+	return std::sin(px) / px;
+}
+
+// Modified Bessel function of the first kind, order 0.
+static double bessel0(double x)
+{
+	const double halfX = 0.5 * x;
+	double sum = 1.0, term = 1.0;
+	for (int32 k = 1; k < 64 && term > 1e-12 * sum; ++k)
+	{
+		term *= (halfX / k) * (halfX / k);
+		sum += term;
+	}
+	return sum;
+}
+
+// Same parameters as the Kaiser filter of NVIDIA Texture Tools.
+#define KAISER_WIDTH 3.0f
+#define KAISER_ALPHA 4.0
+#define LANCZOS_WIDTH 3.0f
+
+// @param x Distance in destination pixels.
+static float evaluateKernel(EMipFilter filter, float x)
+{
+	x = std::abs(x);
+	switch (filter)
+	{
+		case EMipFilter::Kaiser:
+		{
+			if (x >= KAISER_WIDTH) return 0.0f;
+			const float t = x / KAISER_WIDTH;
+			return sinc(x) * (float)(bessel0(KAISER_ALPHA * std::sqrt(1.0 - t * t)) / bessel0(KAISER_ALPHA));
+		}
+		case EMipFilter::Lanczos:
+			return (x < LANCZOS_WIDTH) ? (sinc(x) * sinc(x / LANCZOS_WIDTH)) : 0.0f;
+		default:
+			CHECK_NO_ENTRY();
+			return 0.0f;
+	}
+}
+
+// Weights of one axis, padded with zero weights to the same number of taps for every destination pixel.
+struct FilterTaps
+{
+	uint32              numTaps = 0;
+	std::vector<uint32> srcIndices; // [dstIx * numTaps + tap]
+	std::vector<float>  weights;    // [dstIx * numTaps + tap]
+};
+
+static void buildFilterTaps(const MipGeneratorDesc& desc, uint32 srcSize, uint32 dstSize, FilterTaps& outTaps)
+{
+	// Footprint of a destination pixel in source pixels.
+	const float scale = (float)srcSize / (float)dstSize;
+	const float radius = scale * ((desc.filter == EMipFilter::Box) ? 0.5f
+		: (desc.filter == EMipFilter::Kaiser) ? KAISER_WIDTH : LANCZOS_WIDTH);
+
+	outTaps.numTaps = (uint32)std::ceil(2.0f * radius) + 1;
+	outTaps.srcIndices.assign((size_t)dstSize * outTaps.numTaps, 0);
+	outTaps.weights.assign((size_t)dstSize * outTaps.numTaps, 0.0f);
+
+	for (uint32 dstIx = 0; dstIx < dstSize; ++dstIx)
+	{
+		const float center = ((float)dstIx + 0.5f) * scale;
+		const int32 first = (int32)std::floor(center - radius);
+		uint32* srcIndices = outTaps.srcIndices.data() + (size_t)dstIx * outTaps.numTaps;
+		float* weights = outTaps.weights.data() + (size_t)dstIx * outTaps.numTaps;
+
+		float weightSum = 0.0f;
+		for (uint32 tap = 0; tap < outTaps.numTaps; ++tap)
+		{
+			const int32 srcIx = first + (int32)tap;
+			float weight;
+			if (desc.filter == EMipFilter::Box)
+			{
+				// Coverage of the source pixel by the footprint.
+				const float coverage = std::min((float)srcIx + 1.0f, center + radius) - std::max((float)srcIx, center - radius);
+				weight = std::max(0.0f, coverage);
+			}
+			else
+			{
+				weight = evaluateKernel(desc.filter, ((float)srcIx + 0.5f - center) / scale);
+			}
+
+			int32 address = srcIx;
+			if (desc.addressMode == EMipAddressMode::Wrap)
+			{
+				address %= (int32)srcSize;
+				address = (address < 0) ? (address + (int32)srcSize) : address;
+			}
+			else
+			{
+				address = std::clamp(address, 0, (int32)srcSize - 1);
+			}
+
+			srcIndices[tap] = (uint32)address;
+			weights[tap] = weight;
+			weightSum += weight;
+		}
+
+		CHECK(weightSum > 0.0f);
+		const float invWeightSum = 1.0f / weightSum;
+		for (uint32 tap = 0; tap < outTaps.numTaps; ++tap)
+		{
+			weights[tap] *= invWeightSum;
+		}
+	}
+}
+
+// ------------------------------------------------
+// Mip generation
+
+template<typename Fn>
+static void forEachRowRange(ThreadPool* threadPool, uint32 numRows, uint32 rowWidth, Fn&& fn)
+{
+	const uint32 grainSize = std::max(1u, MIP_GENERATOR_GRAIN_PIXELS / std::max(1u, rowWidth));
+	if (threadPool == nullptr || numRows <= grainSize)
+	{
+		fn(0u, numRows);
+		return;
+	}
+	threadPool->parallelFor(numRows, grainSize, [&](uint32 chunkIx, uint32 begin, uint32 end)
+		{
+			fn(begin, end);
+		});
+}
+
+// Components of a source format. Internally every pixel is 4 floats, and missing components are 0.
+struct PixelLayout
+{
+	uint32 numComponents;
+	uint32 bytesPerComponent;
+	uint32 numSRGBComponents; // Leading components that are sRGB-encoded.
+};
+
+static PixelLayout getPixelLayout(EPixelFormat format, bool bSRGB)
+{
+	switch (format)
+	{
+		case EPixelFormat::R8G8B8A8_UNORM     : return PixelLayout{ 4, 1, bSRGB ? 3u : 0u };
+		case EPixelFormat::R8G8_UNORM         : return PixelLayout{ 2, 1, bSRGB ? 1u : 0u };
+		case EPixelFormat::R8_UNORM           : return PixelLayout{ 1, 1, bSRGB ? 1u : 0u };
+		case EPixelFormat::R16G16B16A16_UNORM : return PixelLayout{ 4, 2, 0 };
+		case EPixelFormat::R16G16_UNORM       : return PixelLayout{ 2, 2, 0 };
+		case EPixelFormat::R16_UNORM          : return PixelLayout{ 1, 2, 0 };
+		default                               : CHECK_NO_ENTRY();
+	}
+	return PixelLayout{ 4, 1, 0 };
+}
+
+static void decodeRow(const SRGBTables& tables, const PixelLayout& layout, const uint8* src, float* dst, uint32 width)
+{
+	for (uint32 x = 0; x < width; ++x)
+	{
+		float* p = dst + 4 * x;
+		p[0] = p[1] = p[2] = p[3] = 0.0f;
+		for (uint32 c = 0; c < layout.numComponents; ++c, src += layout.bytesPerComponent)
+		{
+			if (layout.bytesPerComponent == 2)
+			{
+				uint16 value;
+				::memcpy(&value, src, 2);
+				p[c] = (float)value / 65535.0f;
+			}
+			else
+			{
+				p[c] = (c < layout.numSRGBComponents) ? tables.toLinear[*src] : ((float)*src / 255.0f);
+			}
+		}
+	}
+}
+
+static void encodeRow(const SRGBTables& tables, const PixelLayout& layout, const float* src, uint8* dst, uint32 width)
+{
+	for (uint32 x = 0; x < width; ++x)
+	{
+		const float* p = src + 4 * x;
+		for (uint32 c = 0; c < layout.numComponents; ++c, dst += layout.bytesPerComponent)
+		{
+			if (layout.bytesPerComponent == 2)
+			{
+				const uint16 value = (uint16)(std::clamp(p[c], 0.0f, 1.0f) * 65535.0f + 0.5f);
+				::memcpy(dst, &value, 2);
+			}
+			else
+			{
+				*dst = (c < layout.numSRGBComponents) ? linearToSrgb8_internal(tables, p[c]) : linearToUnorm8(p[c]);
+			}
+		}
+	}
+}
+
+void MipChain::allocate(EPixelFormat inFormat, uint32 width, uint32 height, uint32 numLevels, uint32 numSlices)
+{
+	format = inFormat;
+	levels.resize(numLevels);
+	uint64 totalBytes = 0;
+	for (uint32 mip = 0; mip < numLevels; ++mip)
+	{
+		Level& level = levels[mip];
+		level.width      = std::max(1u, width >> mip);
+		level.height     = std::max(1u, height >> mip);
+		level.offset     = totalBytes;
+		level.rowPitch   = getPixelFormatRowBytes(format, level.width);
+		level.slicePitch = level.rowPitch * getPixelFormatNumRows(format, level.height);
+		totalBytes += level.slicePitch * numSlices;
+	}
+	data.resize(totalBytes);
+}
+
+uint32 calcMipLevelCount(uint32 width, uint32 height)
+{
+	uint32 size = std::max(width, height);
+	uint32 count = 1;
+	while (size > 1)
+	{
+		size >>= 1;
+		++count;
+	}
+	return count;
+}
+
+void generateMipChain(
+	const uint8* rgba8,
+	uint32 width,
+	uint32 height,
+	uint64 rowPitch,
+	const MipGeneratorDesc& desc,
+	MipChain& outChain,
+	ThreadPool* threadPool)
+{
+	generateMipChain(rgba8, EPixelFormat::R8G8B8A8_UNORM, width, height, rowPitch, desc, outChain, threadPool);
+}
+
+void generateMipChain(
+	const uint8* src,
+	EPixelFormat format,
+	uint32 width,
+	uint32 height,
+	uint64 rowPitch,
+	const MipGeneratorDesc& desc,
+	MipChain& outChain,
+	ThreadPool* threadPool)
+{
+	CHECK(src != nullptr && width > 0 && height > 0);
+	const PixelLayout layout = getPixelLayout(format, desc.bSRGB);
+	if (rowPitch == 0) rowPitch = getPixelFormatRowBytes(format, width);
+
+	const SRGBTables& tables = getSRGBTables();
+
+	uint32 numLevels = calcMipLevelCount(width, height);
+	if (desc.maxMipLevels != 0)
+	{
+		numLevels = std::min(numLevels, desc.maxMipLevels);
+	}
+
+	outChain.allocate(format, width, height, numLevels);
+	for (uint32 y = 0; y < height; ++y)
+	{
+		::memcpy(outChain.getLevelData(0) + outChain.levels[0].rowPitch * y, src + rowPitch * y, outChain.levels[0].rowPitch);
+	}
+	if (numLevels == 1)
+	{
+		return;
+	}
+
+	// Linear rgba of the previous mip, and the previous mip filtered only horizontally.
+	// Formats with fewer components use the same 4-float pixels, so filtering code is shared.
+	std::vector<float> srcLinear((size_t)width * height * 4);
+	std::vector<float> dstLinear;
+	std::vector<float> horizontal;
+	FilterTaps tapsX, tapsY;
+
+	forEachRowRange(threadPool, height, width, [&](uint32 rowBegin, uint32 rowEnd)
+		{
+			for (uint32 y = rowBegin; y < rowEnd; ++y)
+			{
+				decodeRow(tables, layout, src + rowPitch * y, srcLinear.data() + (size_t)width * 4 * y, width);
+			}
+		});
+
+	for (uint32 mip = 1; mip < numLevels; ++mip)
+	{
+		const uint32 srcWidth = outChain.levels[mip - 1].width;
+		const uint32 srcHeight = outChain.levels[mip - 1].height;
+		const uint32 dstWidth = outChain.levels[mip].width;
+		const uint32 dstHeight = outChain.levels[mip].height;
+		uint8* dstData = outChain.getLevelData(mip);
+
+		buildFilterTaps(desc, srcWidth, dstWidth, tapsX);
+		buildFilterTaps(desc, srcHeight, dstHeight, tapsY);
+		horizontal.resize((size_t)dstWidth * srcHeight * 4);
+		dstLinear.resize((size_t)dstWidth * dstHeight * 4);
+
+		// A pixel is one SSE register, so both passes are a multiply-add of 4 channels per tap.
+		forEachRowRange(threadPool, srcHeight, dstWidth, [&](uint32 rowBegin, uint32 rowEnd)
+			{
+				for (uint32 y = rowBegin; y < rowEnd; ++y)
+				{
+					const float* srcRow = srcLinear.data() + (size_t)srcWidth * 4 * y;
+					float* dstRow = horizontal.data() + (size_t)dstWidth * 4 * y;
+					const uint32* srcIndices = tapsX.srcIndices.data();
+					const float* weights = tapsX.weights.data();
+					for (uint32 x = 0; x < dstWidth; ++x)
+					{
+						__m128 sum = _mm_setzero_ps();
+						for (uint32 tap = 0; tap < tapsX.numTaps; ++tap)
+						{
+							const __m128 pixel = _mm_loadu_ps(srcRow + 4 * srcIndices[tap]);
+							sum = _mm_add_ps(sum, _mm_mul_ps(pixel, _mm_set1_ps(weights[tap])));
+						}
+						_mm_storeu_ps(dstRow + 4 * x, sum);
+						srcIndices += tapsX.numTaps;
+						weights += tapsX.numTaps;
+					}
+				}
+			});
+
+		forEachRowRange(threadPool, dstHeight, dstWidth, [&](uint32 rowBegin, uint32 rowEnd)
+			{
+				for (uint32 y = rowBegin; y < rowEnd; ++y)
+				{
+					float* dstRow = dstLinear.data() + (size_t)dstWidth * 4 * y;
+					const uint32* srcIndices = tapsY.srcIndices.data() + (size_t)y * tapsY.numTaps;
+					const float* weights = tapsY.weights.data() + (size_t)y * tapsY.numTaps;
+
+					::memset(dstRow, 0, sizeof(float) * 4 * dstWidth);
+					for (uint32 tap = 0; tap < tapsY.numTaps; ++tap)
+					{
+						if (weights[tap] == 0.0f)
+						{
+							continue;
+						}
+						const float* srcRow = horizontal.data() + (size_t)dstWidth * 4 * srcIndices[tap];
+						const __m128 weight = _mm_set1_ps(weights[tap]);
+						for (uint32 x = 0; x < dstWidth * 4; x += 4)
+						{
+							const __m128 sum = _mm_loadu_ps(dstRow + x);
+							_mm_storeu_ps(dstRow + x, _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(srcRow + x), weight)));
+						}
+					}
+
+					encodeRow(tables, layout, dstRow, dstData + outChain.levels[mip].rowPitch * y, dstWidth);
+				}
+			});
+
+		srcLinear.swap(dstLinear);
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "core/int_types.h"
+#include "rhi/pixel_format.h"
+
+#include <vector>
+
+class ThreadPool;
+
+// Rows of a mip level per parallel chunk are chosen so that a chunk covers about this many pixels.
+#define MIP_GENERATOR_GRAIN_PIXELS 16384
+
+enum class EMipFilter : uint8
+{
+	Box,     // Area average of the footprint. Cheapest, but blurry and aliases the most.
+	Kaiser,  // Kaiser-windowed sinc (width 3, alpha 4). Sharp with little ringing.
+	Lanczos, // Lanczos3. Sharpest, but rings around hard edges.
+};
+
+enum class EMipAddressMode : uint8
+{
+	Wrap,
+	Clamp,
+};
+
+struct MipGeneratorDesc
+{
+	EMipFilter      filter       = EMipFilter::Kaiser;
+	EMipAddressMode addressMode  = EMipAddressMode::Wrap;
+	bool            bSRGB        = true; // If true, rgb are linearized before filtering and re-encoded after. Alpha is always linear.
+	uint32          maxMipLevels = 0;    // 0 means full mips down to 1x1.
+};
+
+// All mips of an image, stored contiguously with tight row pitches.
+struct MipChain
+{
+	struct Level
+	{
+		uint32 width;
+		uint32 height;
+		uint64 offset;     // In bytes, from the start of data.
+		uint64 rowPitch;   // Bytes of a row of texels, or of a row of blocks if block compressed.
+		uint64 slicePitch;
+	};
+
+	// Sets up levels of (max(1, w >> mip), max(1, h >> mip)) and allocates data for them.
+	// Each level holds numSlices slices of slicePitch bytes, e.g., 6 faces of a cube.
+	void allocate(EPixelFormat inFormat, uint32 width, uint32 height, uint32 numLevels, uint32 numSlices = 1);
+
+	inline uint32 getNumLevels() const { return (uint32)levels.size(); }
+	inline const uint8* getLevelData(uint32 mipLevel) const { return data.data() + levels[mipLevel].offset; }
+	inline uint8* getLevelData(uint32 mipLevel) { return data.data() + levels[mipLevel].offset; }
+	inline const uint8* getSliceData(uint32 mipLevel, uint32 slice) const { return getLevelData(mipLevel) + slice * levels[mipLevel].slicePitch; }
+	inline uint8* getSliceData(uint32 mipLevel, uint32 slice) { return getLevelData(mipLevel) + slice * levels[mipLevel].slicePitch; }
+
+	EPixelFormat       format = EPixelFormat::R8G8B8A8_UNORM;
+	std::vector<Level> levels;
+	std::vector<uint8> data;
+};
+
+// Same mip count as D3D12 and Vulkan for full mips. Each mip is (max(1, w >> mip), max(1, h >> mip)).
+uint32 calcMipLevelCount(uint32 width, uint32 height);
+
+// Generates all mips of an rgba8 image. Level 0 is a copy of the source.
+// Each mip is filtered from the previous one in linear float space, so errors don't accumulate with 8-bit rounding.
+// Non-power-of-two sizes are resampled with exact footprints, e.g., 5 -> 2 pixels have a footprint of 2.5 pixels.
+// @param rowPitch   Bytes of a source row. If 0, (width * 4).
+// @param threadPool If not null, rows of each mip are processed in parallel. Results are the same as serial.
+void generateMipChain(
+	const uint8* rgba8,
+	uint32 width,
+	uint32 height,
+	uint64 rowPitch,
+	const MipGeneratorDesc& desc,
+	MipChain& outChain,
+	ThreadPool* threadPool = nullptr);
+
+// Same as above, for an image of any 8-bit or 16-bit UNORM format with 1, 2 or 4 components,
+// e.g., R8_UNORM for masks and R16_UNORM for heightmaps. Mips have the same format.
+// bSRGB applies to color components of 8-bit formats: rgb of R8G8B8A8, and r (grey) of R8 and R8G8.
+// 16-bit formats are always filtered as linear values.
+// @param rowPitch   Bytes of a source row. If 0, tightly packed.
+void generateMipChain(
+	const uint8* src,
+	EPixelFormat format,
+	uint32 width,
+	uint32 height,
+	uint64 rowPitch,
+	const MipGeneratorDesc& desc,
+	MipChain& outChain,
+	ThreadPool* threadPool = nullptr);
+
+// Exact conversions between 8-bit sRGB and linear, without calling pow() per pixel.
+float srgb8ToLinear(uint8 x);
+uint8 linearToSrgb8(float x);
@@ -1,15 +1,22 @@
 #include "pbrt_loader.h"
 #include "ply_loader.h"
 #include "image_loader.h"
+#include "mip_generator.h"
+#include "texture_compressor.h"
+#include "texture_cache.h"
 
 #include "core/assertion.h"
 #include "core/smart_pointer.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
 #include "rhi/render_device.h"
 #include "rhi/render_command.h"
 #include "rhi/gpu_resource.h"
 #include "rhi/texture_manager.h"
+#include "rhi/upload_batcher.h"
 #include "render/material.h"
 #include "render/static_mesh.h"
+#include "render/texture_streamer.h"
 #include "geometry/primitive.h"
 #include "geometry/meso_geometry.h"
 #include "world/gpu_resource_asset.h"
@@ -18,8 +25,12 @@
 #include "util/logging.h"
 
 #include <vector>
+#include <algorithm>
+#include <map>
+#include <unordered_set>
 #include <fstream>
 #include <filesystem>
+#include <cfloat>
 
 DEFINE_LOG_CATEGORY_STATIC(LogPBRT);
 
@@ -27,6 +38,10 @@ DEFINE_LOG_CATEGORY_STATIC(LogPBRT);
 // I don't have it, so creating one StaticMesh for each inst desc, but it causes abysmal performance drop for sanmiguel scene.
 #define ENABLE_PBRT_OBJECT_INSTANCE 0
 
+// Block compress imported textures. Images whose width or height is not a multiple of 4 stay in rgba8.
+#define ENABLE_PBRT_TEXTURE_COMPRESSION 1
+#define PBRT_TEXTURE_COMPRESSION_QUALITY ETextureCompressionQuality::Normal
+
 // -------------------------------------
 // PBRT4Scene
 
@@ -63,7 +78,7 @@ PBRT4Scene::ToCyseal PBRT4Scene::toCyseal(PBRT4Scene* pbrtScene)
 	ToCyseal ret;
 
 	// #todo-pbrt: A single StaticMesh for all root objects or one StaticMesh for each root object?
-	StaticMesh* pbrtMesh = toStaticMesh(pbrtScene->triangleMeshes, pbrtScene->plyMeshes, fallbackMaterial);
+	StaticMesh* pbrtMesh = toStaticMesh(pbrtScene->triangleMeshes, pbrtScene->plyMeshes, fallbackMaterial, ret.textureUsages);
 	ret.rootObjects.push_back(pbrtMesh);
 
 #if ENABLE_PBRT_OBJECT_INSTANCE
@@ -79,7 +94,7 @@ PBRT4Scene::ToCyseal PBRT4Scene::toCyseal(PBRT4Scene* pbrtScene)
 		{
 			if (i == 0)
 			{
-				proto = toStaticMesh(obj.triangleMeshes, obj.plyMeshes, fallbackMaterial);
+				proto = toStaticMesh(obj.triangleMeshes, obj.plyMeshes, fallbackMaterial, ret.textureUsages);
 				ret.instancedObjects.push_back(proto);
 			}
 			else
@@ -98,7 +113,8 @@ PBRT4Scene::ToCyseal PBRT4Scene::toCyseal(PBRT4Scene* pbrtScene)
 	return ret;
 }
 
-StaticMesh* PBRT4Scene::toStaticMesh(std::vector<pbrt::PBRT4ParserOutput::TriangleMeshDesc>& triangleMeshes, std::vector<PLYMesh*>& plyMeshes, const SharedPtr<MaterialAsset>& fallbackMaterial)
+StaticMesh* PBRT4Scene::toStaticMesh(std::vector<pbrt::PBRT4ParserOutput::TriangleMeshDesc>& triangleMeshes, std::vector<PLYMesh*>& plyMeshes, const SharedPtr<MaterialAsset>& fallbackMaterial,
+	std::vector<PBRT4TextureUsage>& outTextureUsages)
 {
 	const size_t numTriangleMeshes = triangleMeshes.size();
 	const size_t numPbrtMeshes = plyMeshes.size();
@@ -141,6 +157,19 @@ StaticMesh* PBRT4Scene::toStaticMesh(std::vector<pbrt::PBRT4ParserOutput::Triang
 	for (size_t i = 0; i < totalSubMeshes; ++i)
 	{
 		auto material = (subMaterials[i] != nullptr) ? subMaterials[i] : fallbackMaterial;
+
+		// Degenerate UVs need only the coarsest mips, which are always resident.
+		const Geometry* G = pbrtGeometries[i];
+		const float localUnitsPerUV = calcWorldUnitsPerUV(G->positions, G->texcoords, G->indices);
+		if (material->getAlbedoTexture() != nullptr && localUnitsPerUV > 0.0f)
+		{
+			outTextureUsages.push_back(PBRT4TextureUsage{
+				.texture         = material->getAlbedoTexture(),
+				.localBounds     = G->localBounds,
+				.localUnitsPerUV = localUnitsPerUV,
+			});
+		}
+
 		MesoGeometryAssets geomAssets = MesoGeometryAssets::createFrom(pbrtGeometries[i]);
 		MesoGeometryAssets::addStaticMeshSections(staticMesh, 0, geomAssets, material);
 	}
@@ -148,10 +177,53 @@ StaticMesh* PBRT4Scene::toStaticMesh(std::vector<pbrt::PBRT4ParserOutput::Triang
 	return staticMesh;
 }
 
+void PBRT4Scene::registerTextureStreamingUsages(const std::vector<PBRT4TextureUsage>& usages, const Matrix& localToWorld)
+{
+	// UV density is scaled by the largest axis, so non-uniform scales overestimate it.
+	const float maxScale = std::max({
+		localToWorld.transformDirection(vec3(1.0f, 0.0f, 0.0f)).length(),
+		localToWorld.transformDirection(vec3(0.0f, 1.0f, 0.0f)).length(),
+		localToWorld.transformDirection(vec3(0.0f, 0.0f, 1.0f)).length() });
+
+	std::vector<PBRT4TextureUsage> worldUsages;
+	worldUsages.reserve(usages.size());
+	for (const PBRT4TextureUsage& usage : usages)
+	{
+		vec3 minBounds(FLT_MAX, FLT_MAX, FLT_MAX);
+		vec3 maxBounds(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (uint32 corner = 0; corner < 8; ++corner)
+		{
+			const vec3 localCorner(
+				(corner & 1) ? usage.localBounds.maxBounds.x : usage.localBounds.minBounds.x,
+				(corner & 2) ? usage.localBounds.maxBounds.y : usage.localBounds.minBounds.y,
+				(corner & 4) ? usage.localBounds.maxBounds.z : usage.localBounds.minBounds.z);
+			const vec3 worldCorner = localToWorld.transformPosition(localCorner);
+			minBounds = vecMin(minBounds, worldCorner);
+			maxBounds = vecMax(maxBounds, worldCorner);
+		}
+		worldUsages.push_back(PBRT4TextureUsage{
+			.texture         = usage.texture,
+			.localBounds     = AABB::fromMinMax(minBounds, maxBounds),
+			.localUnitsPerUV = usage.localUnitsPerUV * maxScale,
+		});
+	}
+
+	// After CreateTextureAsset commands, so that textures are registered to gTextureStreamer.
+	ENQUEUE_RENDER_COMMAND(RegisterTextureStreamingUsages)(
+		[worldUsages = std::move(worldUsages)](RenderCommandList& commandList)
+		{
+			for (const PBRT4TextureUsage& usage : worldUsages)
+			{
+				gTextureStreamer->addUsage(usage.texture, usage.localBounds, usage.localUnitsPerUV);
+			}
+		}
+	);
+}
+
 // -------------------------------------
 // PBRT4Loader
 
-PBRT4Scene* PBRT4Loader::loadFromFile(const std::wstring& filepath)
+PBRT4Scene* PBRT4Loader::loadFromFile(const std::wstring& filepath, ThreadPool* threadPool)
 {
 	std::wstring wFilepath = ResourceFinder::get().find(filepath);
 	if (wFilepath.size() == 0)
@@ -190,7 +262,7 @@ PBRT4Scene* PBRT4Loader::loadFromFile(const std::wstring& filepath)
 
 	PBRT4Scene* pbrtScene = new PBRT4Scene;
 
-	loadTextureFiles(baseDir, parserOutput);
+	loadTextureFiles(baseDir, parserOutput, threadPool);
 	loadMaterials(parserOutput);
 	pbrtScene->triangleMeshes = std::move(parserOutput.triangleShapeDescs);
 	loadPLYMeshes(baseDir, parserOutput.plyShapeDescs, pbrtScene->plyMeshes);
@@ -205,32 +277,204 @@ MaterialAsset* PBRT4Loader::findNamedMaterial(const char* name) const
 	return it == namedMaterialDatabase.end() ? nullptr : it->second.get();
 }
 
-void PBRT4Loader::loadTextureFiles(const std::wstring& baseDir, const pbrt::PBRT4ParserOutput& parserOutput)
+void PBRT4Loader::loadTextureFiles(const std::wstring& baseDir, const pbrt::PBRT4ParserOutput& parserOutput, ThreadPool* threadPool)
 {
-	ImageLoader imageLoader;
-
 	textureAssetDatabase.clear();
 	textureDirectiveDatabase.clear();
 
-	// Load image files used by Texture directives.
-	for (const std::wstring& wFilename : parserOutput.textureFileDescSet)
+	std::vector<std::wstring> filenames(parserOutput.textureFileDescSet.begin(), parserOutput.textureFileDescSet.end());
+	std::vector<std::wstring> filepaths(filenames.size());
+	for (size_t i = 0; i < filenames.size(); ++i)
 	{
-		ImageLoadData* imageBlob = nullptr;
+		filepaths[i] = ResourceFinder::get().find(baseDir + filenames[i]);
+		if (filepaths[i].size() == 0)
+		{
+			CYLOG(LogPBRT, Error, L"Failed to open: %s", filenames[i].c_str());
+		}
+	}
 
-		std::wstring textureFilepath = baseDir + wFilename;
-		textureFilepath = ResourceFinder::get().find(textureFilepath);
-		if (textureFilepath.size() > 0)
+	// Components needed by each image file. Spectrum textures are rgb, and float textures are grey.
+	// Files that materials sample as reflectance are always rgba, as albedo textures are sampled as rgb.
+	std::map<std::wstring, ImageLoadOptions> fileLoadOptions;
+	for (const auto& desc : parserOutput.textureDescs)
+	{
+		const bool bGrey = desc.numChannels == 1;
+		ImageLoadOptions options{
+			.channels    = bGrey ? EImageChannels::R : EImageChannels::RGBA,
+			.bAllow16Bit = bGrey,
+		};
+		auto it = fileLoadOptions.find(desc.filename);
+		if (it != fileLoadOptions.end() && it->second.channels != options.channels)
 		{
-			constexpr bool bFlipY = true;
-			imageBlob = imageLoader.load(textureFilepath, bFlipY);
+			options = ImageLoadOptions{};
 		}
-		else
+		fileLoadOptions.insert_or_assign(desc.filename, options);
+	}
+	std::unordered_set<std::string> reflectanceTextureNames;
+	for (const auto* materialDescs : { &parserOutput.namedMaterialDescs, &parserOutput.unnamedMaterialDescs })
+	{
+		for (const auto& desc : *materialDescs)
+		{
+			reflectanceTextureNames.insert(desc.textureReflectance);
+		}
+	}
+	for (const auto& desc : parserOutput.textureDescs)
+	{
+		if (reflectanceTextureNames.find(desc.textureName) != reflectanceTextureNames.end())
+		{
+			fileLoadOptions.insert_or_assign(desc.filename, ImageLoadOptions{});
+		}
+	}
+	std::vector<ImageLoadOptions> loadOptions(filenames.size());
+	for (size_t i = 0; i < filenames.size(); ++i)
+	{
+		auto it = fileLoadOptions.find(filenames[i]);
+		if (it != fileLoadOptions.end())
+		{
+			loadOptions[i] = it->second;
+		}
+	}
+
+	constexpr bool bFlipY = true;
+	// pbrt-v4 treats 8-bit images as sRGB-encoded unless "encoding" parameter says otherwise.
+	// Grey images are mostly non-color data like roughness or displacement, so they are linear.
+	// Materials sample with wrap addressing.
+	auto getMipDesc = [](const ImageLoadOptions& options)
+	{
+		return MipGeneratorDesc{
+			.filter      = EMipFilter::Kaiser,
+			.addressMode = EMipAddressMode::Wrap,
+			.bSRGB       = options.channels == EImageChannels::RGBA,
+		};
+	};
+
+#if ENABLE_TEXTURE_CACHE
+	const TextureCache textureCache(TEXTURE_CACHE_DIR);
+	auto getCacheSettingsHash = [&](const ImageLoadOptions& options)
+	{
+		const MipGeneratorDesc mipDesc = getMipDesc(options);
+		const uint32 cacheSettings[] = {
+			(uint32)bFlipY, (uint32)mipDesc.filter, (uint32)mipDesc.addressMode, (uint32)mipDesc.bSRGB, mipDesc.maxMipLevels,
+			(uint32)ENABLE_PBRT_TEXTURE_COMPRESSION, (uint32)PBRT_TEXTURE_COMPRESSION_QUALITY,
+			(uint32)options.channels, (uint32)options.bAllow16Bit,
+		};
+		return hashTextureCacheBytes(cacheSettings, sizeof(cacheSettings));
+	};
+#endif
+
+	HighFrequencyCounter loadCounter;
+	loadCounter.start();
+
+	// Decode image files used by Texture directives and generate their mips. Each image is independent.
+	// Processed images are read from the texture cache if possible.
+	std::vector<MipChain*> mipChains(filenames.size(), nullptr);
+	std::vector<TextureCacheEntry*> cacheEntries(filenames.size(), nullptr);
+	auto loadImages = [&](uint32 chunkIx, uint32 begin, uint32 end)
+	{
+		ImageLoader imageLoader;
+		for (uint32 i = begin; i < end; ++i)
+		{
+			if (filepaths[i].size() == 0)
+			{
+				continue;
+			}
+
+#if ENABLE_TEXTURE_CACHE
+			const TextureCacheKey cacheKey{ .sourcePaths = { filepaths[i] }, .settingsHash = getCacheSettingsHash(loadOptions[i]) };
+			cacheEntries[i] = textureCache.find(cacheKey);
+			if (cacheEntries[i] != nullptr)
+			{
+				continue;
+			}
+#endif
+
+			constexpr bool bUseResourceFinder = false;
+			ImageLoadData* imageBlob = imageLoader.load(filepaths[i], bFlipY, bUseResourceFinder, loadOptions[i]);
+			if (imageBlob == nullptr)
+			{
+				continue;
+			}
+
+			mipChains[i] = new MipChain;
+			generateMipChain(imageBlob->getBuffer(), imageBlob->getPixelFormat(), imageBlob->width, imageBlob->height,
+				imageBlob->getRowPitch(), getMipDesc(loadOptions[i]), *mipChains[i]);
+			delete imageBlob;
+
+#if ENABLE_PBRT_TEXTURE_COMPRESSION
+			// Images are already processed in parallel, so blocks of each image are compressed serially.
+			// 16-bit images stay uncompressed to keep their precision.
+			const MipChain::Level& level0 = mipChains[i]->levels[0];
+			const EPixelFormat srcFormat = mipChains[i]->format;
+			const bool bCompressible = srcFormat == EPixelFormat::R8G8B8A8_UNORM || srcFormat == EPixelFormat::R8_UNORM;
+			if (bCompressible && level0.width % 4 == 0 && level0.height % 4 == 0)
+			{
+				EPixelFormat format;
+				if (srcFormat == EPixelFormat::R8_UNORM)
+				{
+					format = chooseCompressedFormat(ETextureUsage::Mask, false, PBRT_TEXTURE_COMPRESSION_QUALITY);
+				}
+				else
+				{
+					const bool bHasAlpha = !isOpaqueRgba8(mipChains[i]->getLevelData(0), level0.width, level0.height, level0.rowPitch);
+					format = chooseCompressedFormat(ETextureUsage::Albedo, bHasAlpha, PBRT_TEXTURE_COMPRESSION_QUALITY);
+				}
+				MipChain* compressedChain = new MipChain;
+				compressMipChain(*mipChains[i], format, PBRT_TEXTURE_COMPRESSION_QUALITY, *compressedChain);
+				delete mipChains[i];
+				mipChains[i] = compressedChain;
+			}
+#endif
+
+#if ENABLE_TEXTURE_CACHE
+			if (!textureCache.store(cacheKey, *mipChains[i]))
+			{
+				CYLOG(LogPBRT, Warning, L"Failed to write texture cache for: %s", filenames[i].c_str());
+			}
+#endif
+		}
+	};
+	if (threadPool != nullptr)
+	{
+		threadPool->parallelFor((uint32)filenames.size(), 1, loadImages);
+	}
+	else
+	{
+		loadImages(0, 0, (uint32)filenames.size());
+	}
+
+	const float loadMs = loadCounter.stopWithMilliseconds();
+	const size_t numCached = std::count_if(cacheEntries.begin(), cacheEntries.end(), [](TextureCacheEntry* entry) { return entry != nullptr; });
+	CYLOG(LogPBRT, Log, L"Loaded %u texture files in %.3f ms (%u from texture cache)", (uint32)filenames.size(), loadMs, (uint32)numCached);
+
+	// Compare with the same mips in rgba8, which all images were loaded as before.
+	uint64 textureBytes = 0, rgba8Bytes = 0;
+	for (size_t i = 0; i < filenames.size(); ++i)
+	{
+		const std::vector<MipChain::Level>* levels = (cacheEntries[i] != nullptr) ? &cacheEntries[i]->levels
+			: (mipChains[i] != nullptr) ? &mipChains[i]->levels : nullptr;
+		if (levels != nullptr)
 		{
-			CYLOG(LogPBRT, Error, L"Failed to open: %s", wFilename.c_str());
+			for (const MipChain::Level& level : *levels)
+			{
+				textureBytes += level.slicePitch;
+				rgba8Bytes += 4 * uint64(level.width) * uint64(level.height);
+			}
 		}
+	}
+	if (rgba8Bytes > 0)
+	{
+		CYLOG(LogPBRT, Log, L"Texture memory: %.2f MiB (%.2f MiB as rgba8, %.1f%% saved)",
+			textureBytes / (1024.0 * 1024.0), rgba8Bytes / (1024.0 * 1024.0), 100.0 * (1.0 - (double)textureBytes / rgba8Bytes));
+	}
+
+	for (size_t i = 0; i < filenames.size(); ++i)
+	{
+		const std::wstring& wFilename = filenames[i];
+		MipChain* mipChain = mipChains[i];
+		TextureCacheEntry* cacheEntry = cacheEntries[i];
 
 		SharedPtr<TextureAsset> textureAsset;
-		if (imageBlob == nullptr)
+		if (mipChain == nullptr && cacheEntry == nullptr)
 		{
 			textureAsset = gTextureManager->getSystemTextureGrey2D();
 		}
@@ -239,7 +483,7 @@ void PBRT4Loader::loadTextureFiles(const std::wstring& baseDir, const pbrt::PBRT
 			textureAsset = makeShared<TextureAsset>();
 
 			ENQUEUE_RENDER_COMMAND(CreateTextureAsset)(
-				[texWeak = WeakPtr<TextureAsset>(textureAsset), imageBlob, wFilename](RenderCommandList& commandList)
+				[texWeak = WeakPtr<TextureAsset>(textureAsset), mipChain, cacheEntry, wFilename](RenderCommandList& commandList)
 				{
 					SharedPtr<TextureAsset> texShared = texWeak.lock();
 					if (texShared == nullptr)
@@ -248,24 +492,53 @@ void PBRT4Loader::loadTextureFiles(const std::wstring& baseDir, const pbrt::PBRT
 						// Texture file was declared in a pbrt file, but actually not used by any material,
 						// so related TextureAsset was already deallocated.
 						CYLOG(LogPBRT, Error, L"TextureAsset is already deallocated for: %s", wFilename.c_str());
+						delete mipChain;
+						delete cacheEntry;
 						return;
 					}
 
+					// Cached images are uploaded directly from the mapped file.
+					const EPixelFormat format = (cacheEntry != nullptr) ? cacheEntry->format : mipChain->format;
+					const std::vector<MipChain::Level>& levels = (cacheEntry != nullptr) ? cacheEntry->levels : mipChain->levels;
+
+					// No CPU_WRITE, as mips are uploaded by gUploadBatcher instead of a per-texture upload heap.
 					TextureCreateParams createParams = TextureCreateParams::texture2D(
-						EPixelFormat::R8G8B8A8_UNORM,
-						ETextureAccessFlags::SRV | ETextureAccessFlags::CPU_WRITE,
-						imageBlob->width, imageBlob->height);
-					
-					Texture* texture = gRenderDevice->createTexture(createParams);
-					texture->uploadData(&commandList,
-						imageBlob->buffer,
-						imageBlob->getRowPitch(),
-						imageBlob->getSlicePitch());
+						format,
+						ETextureAccessFlags::SRV,
+						levels[0].width, levels[0].height,
+						(uint16)levels.size());
+
+					// Cached images are streamed, as their mips can be read again from the mapped file.
+					// The streamer creates textures with only the resident mips.
+					// The source owns the cache entry, and also keeps it for the full upload below if registration fails.
+					SharedPtr<ITextureMipSource> mipSource;
+					if (cacheEntry != nullptr)
+					{
+						mipSource = makeShared<TextureCacheMipSource>(cacheEntry);
+						if (gTextureStreamer->registerTexture(texShared, createParams, wFilename, mipSource))
+						{
+							return;
+						}
+						CYLOG(LogPBRT, Warning, L"Failed to stream %s, all mips are uploaded", wFilename.c_str());
+					}
+
+					SharedPtr<Texture> texture(gRenderDevice->createTexture(createParams));
 					texture->setDebugName(wFilename.c_str());
 
-					texShared->setGPUResource(SharedPtr<Texture>(texture));
+					// Source data is released once all mips are copied to staging pages, maybe a few frames later.
+					// Only one of them is valid.
+					SharedPtr<void> dataOwner = (cacheEntry != nullptr) ? SharedPtr<void>(mipSource) : SharedPtr<void>(mipChain);
+					UploadToken uploadToken = UPLOAD_TOKEN_NONE;
+					for (uint32 mip = 0; mip < (uint32)levels.size(); ++mip)
+					{
+						uploadToken = gUploadBatcher->uploadTexture(texture, mip,
+							(cacheEntry != nullptr) ? cacheEntry->getLevelData(mip) : mipChain->getLevelData(mip),
+							levels[mip].rowPitch,
+							dataOwner);
+					}
 
-					commandList.enqueueDeferredDealloc(imageBlob);
+					texShared->setUploadToken(uploadToken);
+					texShared->setGPUResource(texture);
 				}
 			);
 		}
@@ -5,6 +5,7 @@
 
 #include "pbrt_parser.h"
 #include "core/smart_pointer.h"
+#include "core/aabb.h"
 #include "world/material_asset.h"
 
 #include <string>
@@ -13,6 +14,7 @@
 
 class PLYMesh;
 class StaticMesh;
+class ThreadPool;
 
 struct PBRT4ObjectInstances
 {
@@ -24,6 +26,14 @@ struct PBRT4ObjectInstances
 	std::vector<Matrix> instanceTransforms;
 };
 
+// Albedo texture of a submesh, in the space of the StaticMesh that contains it.
+struct PBRT4TextureUsage
+{
+	SharedPtr<TextureAsset> texture;
+	AABB                    localBounds;
+	float                   localUnitsPerUV; // See calcWorldUnitsPerUV().
+};
+
 struct PBRT4Scene
 {
 	// Camera
@@ -45,21 +55,29 @@ public:
 	{
 		std::vector<StaticMesh*> rootObjects;
 		std::vector<StaticMesh*> instancedObjects;
+		std::vector<PBRT4TextureUsage> textureUsages;
 	};
 	static ToCyseal toCyseal(PBRT4Scene* inoutPbrtScene);
-	static StaticMesh* toStaticMesh(std::vector<pbrt::PBRT4ParserOutput::TriangleMeshDesc>& inoutTriangleMeshes, std::vector<PLYMesh*>& inoutPlyMeshes, const SharedPtr<MaterialAsset>& fallbackMaterial);
+	static StaticMesh* toStaticMesh(std::vector<pbrt::PBRT4ParserOutput::TriangleMeshDesc>& inoutTriangleMeshes, std::vector<PLYMesh*>& inoutPlyMeshes, const SharedPtr<MaterialAsset>& fallbackMaterial,
+		std::vector<PBRT4TextureUsage>& outTextureUsages);
+
+	// Adds usages to gTextureStreamer, so that streamed textures load mips for the view.
+	// Usages are kept until their textures are released.
+	// @param localToWorld  Transform of the StaticMeshes that the usages came from.
+	static void registerTextureStreamingUsages(const std::vector<PBRT4TextureUsage>& usages, const Matrix& localToWorld);
 };
 
 class PBRT4Loader
 {
 public:
 	// @return Parsed scene. Should dealloc yourself. Null if load has failed.
-	PBRT4Scene* loadFromFile(const std::wstring& filepath);
+	// @param threadPool If not null, texture files are decoded and their mips are generated in parallel.
+	PBRT4Scene* loadFromFile(const std::wstring& filepath, ThreadPool* threadPool = nullptr);
 
 	MaterialAsset* findNamedMaterial(const char* name) const;
 
 private:
-	void loadTextureFiles(const std::wstring& baseDir, const pbrt::PBRT4ParserOutput& parserOutput);
+	void loadTextureFiles(const std::wstring& baseDir, const pbrt::PBRT4ParserOutput& parserOutput, ThreadPool* threadPool);
 	void loadMaterials(const pbrt::PBRT4ParserOutput& parserOutput);
 	void loadPLYMeshes(const std::wstring& baseDir, const std::vector<pbrt::PBRT4ParserOutput::PLYShapeDesc>& descs, std::vector<PLYMesh*>& outMeshes);
 	void loadObjects(const std::wstring& baseDir, pbrt::PBRT4ParserOutput& parserOutput, std::vector<PBRT4ObjectInstances>& outInstances);
@@ -0,0 +1,281 @@
+#include "texture_cache.h"
+#include "core/assertion.h"
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <cstring>
+
+#define TEXTURE_CACHE_MAGIC          0x58545943 // 'CYTX'
+#define TEXTURE_CACHE_DATA_ALIGNMENT 256
+#define TEXTURE_CACHE_FILE_EXTENSION L".cytex"
+
+struct TextureCacheFileHeader
+{
+	uint32 magic;
+	uint32 version;
+	uint64 keyHash;      // Source paths.
+	uint64 settingsHash;
+	uint32 format;       // EPixelFormat
+	uint32 depth;
+	uint32 numSources;
+	uint32 numLevels;
+	uint64 dataOffset;   // From the start of the file.
+	uint64 dataSize;
+};
+
+struct TextureCacheFileSource
+{
+	uint64 fileSize;
+	int64  lastWriteTime;
+	uint64 contentHash;
+};
+
+static_assert(sizeof(TextureCacheFileHeader) == 56);
+static_assert(sizeof(TextureCacheFileSource) == 24);
+static_assert(sizeof(MipChain::Level) == 32);
+
+static inline uint64 rotateLeft64(uint64 x, uint32 bits)
+{
+	return (x << bits) | (x >> (64 - bits));
+}
+
+uint64 hashTextureCacheBytes(const void* data, uint64 size, uint64 seed)
+{
+	constexpr uint64 kPrime0 = 0x9E3779B185EBCA87ull;
+	constexpr uint64 kPrime1 = 0xC2B2AE3D27D4EB4Full;
+
+	// Four independent lanes of 8-byte words, so that multiplies are not serialized.
+	const uint8* bytes = reinterpret_cast<const uint8*>(data);
+	uint64 lanes[4] = { seed + kPrime0, seed ^ kPrime1, seed - kPrime0, ~seed };
+	uint64 i = 0;
+	for (; i + 32 <= size; i += 32)
+	{
+		for (uint32 lane = 0; lane < 4; ++lane)
+		{
+			uint64 word;
+			::memcpy(&word, bytes + i + 8 * lane, 8);
+			lanes[lane] = rotateLeft64(lanes[lane] + word * kPrime1, 31) * kPrime0;
+		}
+	}
+
+	uint64 hash = size * kPrime0;
+	for (uint32 lane = 0; lane < 4; ++lane)
+	{
+		hash = rotateLeft64(hash ^ lanes[lane], 27) * kPrime1;
+	}
+	for (; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+	}
+
+	hash ^= hash >> 33;
+	hash *= kPrime1;
+	hash ^= hash >> 29;
+	hash *= kPrime0;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+static std::wstring normalizeSourcePath(const std::wstring& path)
+{
+	std::error_code errorCode;
+	std::filesystem::path absolutePath = std::filesystem::absolute(path, errorCode);
+	return errorCode ? path : absolutePath.lexically_normal().wstring();
+}
+
+static uint64 calcKeyHash(const TextureCacheKey& key)
+{
+	uint64 hash = hashTextureCacheBytes(nullptr, 0, TEXTURE_CACHE_VERSION);
+	for (const std::wstring& sourcePath : key.sourcePaths)
+	{
+		const std::wstring normalized = normalizeSourcePath(sourcePath);
+		hash = hashTextureCacheBytes(normalized.data(), normalized.size() * sizeof(wchar_t), hash);
+	}
+	return hash;
+}
+
+static bool statSource(const std::wstring& path, uint64& outFileSize, int64& outLastWriteTime)
+{
+	std::error_code errorCode;
+	outFileSize = (uint64)std::filesystem::file_size(path, errorCode);
+	if (errorCode)
+	{
+		return false;
+	}
+	outLastWriteTime = (int64)std::filesystem::last_write_time(path, errorCode).time_since_epoch().count();
+	return !errorCode;
+}
+
+static bool hashSourceContent(const std::wstring& path, uint64 fileSize, uint64& outHash)
+{
+	if (fileSize == 0)
+	{
+		outHash = hashTextureCacheBytes(nullptr, 0);
+		return true;
+	}
+	MappedFile mappedFile;
+	if (!mappedFile.open(path))
+	{
+		return false;
+	}
+	outHash = hashTextureCacheBytes(mappedFile.getData(), mappedFile.getSize());
+	return true;
+}
+
+TextureCache::TextureCache(const std::wstring& inDirectory)
+	: directory(inDirectory)
+{
+	if (directory.size() > 0 && directory.back() != L'/' && directory.back() != L'\\')
+	{
+		directory += L'/';
+	}
+}
+
+std::wstring TextureCache::getCacheFilePath(const TextureCacheKey& key) const
+{
+	const uint64 fileHash = hashTextureCacheBytes(&key.settingsHash, sizeof(uint64), calcKeyHash(key));
+	wchar_t filename[32];
+	swprintf_s(filename, L"%016llx", (unsigned long long)fileHash);
+	return directory + filename + TEXTURE_CACHE_FILE_EXTENSION;
+}
+
+TextureCacheEntry* TextureCache::find(const TextureCacheKey& key) const
+{
+	TextureCacheEntry* entry = new TextureCacheEntry;
+	MappedFile& mappedFile = entry->mappedFile;
+	auto reject = [entry]()
+	{
+		delete entry;
+		return nullptr;
+	};
+
+	if (!mappedFile.open(getCacheFilePath(key)) || mappedFile.getSize() < sizeof(TextureCacheFileHeader))
+	{
+		return reject();
+	}
+
+	TextureCacheFileHeader header;
+	::memcpy(&header, mappedFile.getData(), sizeof(header));
+	const uint64 tablesEnd = sizeof(TextureCacheFileHeader)
+		+ sizeof(TextureCacheFileSource) * uint64(header.numSources)
+		+ sizeof(MipChain::Level) * uint64(header.numLevels);
+	const bool bValidHeader = header.magic == TEXTURE_CACHE_MAGIC
+		&& header.version == TEXTURE_CACHE_VERSION
+		&& header.keyHash == calcKeyHash(key)
+		&& header.settingsHash == key.settingsHash
+		&& header.numSources == (uint32)key.sourcePaths.size()
+		&& header.numLevels > 0
+		&& header.depth > 0
+		&& tablesEnd <= header.dataOffset
+		&& header.dataOffset + header.dataSize == mappedFile.getSize();
+	if (!bValidHeader)
+	{
+		return reject();
+	}
+
+	const uint8* sourceTable = mappedFile.getData() + sizeof(TextureCacheFileHeader);
+	for (uint32 i = 0; i < header.numSources; ++i)
+	{
+		TextureCacheFileSource cached;
+		::memcpy(&cached, sourceTable + sizeof(TextureCacheFileSource) * i, sizeof(cached));
+
+		uint64 fileSize;
+		int64 lastWriteTime;
+		if (!statSource(key.sourcePaths[i], fileSize, lastWriteTime) || fileSize != cached.fileSize)
+		{
+			return reject();
+		}
+		if (lastWriteTime != cached.lastWriteTime)
+		{
+			uint64 contentHash;
+			if (!hashSourceContent(key.sourcePaths[i], fileSize, contentHash) || contentHash != cached.contentHash)
+			{
+				return reject();
+			}
+		}
+	}
+
+	entry->format = (EPixelFormat)header.format;
+	entry->depth = header.depth;
+	entry->levels.resize(header.numLevels);
+	::memcpy(entry->levels.data(), sourceTable + sizeof(TextureCacheFileSource) * header.numSources, sizeof(MipChain::Level) * header.numLevels);
+	for (const MipChain::Level& level : entry->levels)
+	{
+		if (level.offset + level.slicePitch * header.depth > header.dataSize)
+		{
+			return reject();
+		}
+	}
+	entry->data = mappedFile.getData() + header.dataOffset;
+
+	return entry;
+}
+
+bool TextureCache::store(const TextureCacheKey& key, const MipChain& chain, uint32 depth) const
+{
+	CHECK(chain.getNumLevels() > 0 && depth > 0);
+
+	std::vector<TextureCacheFileSource> sources(key.sourcePaths.size());
+	for (size_t i = 0; i < key.sourcePaths.size(); ++i)
+	{
+		TextureCacheFileSource& source = sources[i];
+		if (!statSource(key.sourcePaths[i], source.fileSize, source.lastWriteTime)
+			|| !hashSourceContent(key.sourcePaths[i], source.fileSize, source.contentHash))
+		{
+			return false;
+		}
+	}
+
+	TextureCacheFileHeader header{
+		.magic        = TEXTURE_CACHE_MAGIC,
+		.version      = TEXTURE_CACHE_VERSION,
+		.keyHash      = calcKeyHash(key),
+		.settingsHash = key.settingsHash,
+		.format       = (uint32)chain.format,
+		.depth        = depth,
+		.numSources   = (uint32)sources.size(),
+		.numLevels    = chain.getNumLevels(),
+		.dataOffset   = 0,
+		.dataSize     = (uint64)chain.data.size(),
+	};
+	const uint64 tablesEnd = sizeof(TextureCacheFileHeader)
+		+ sizeof(TextureCacheFileSource) * sources.size()
+		+ sizeof(MipChain::Level) * chain.levels.size();
+	header.dataOffset = (tablesEnd + TEXTURE_CACHE_DATA_ALIGNMENT - 1) & ~uint64(TEXTURE_CACHE_DATA_ALIGNMENT - 1);
+
+	// Write to a temporary file first, so that other loaders never map a partially written file.
+	const std::wstring filepath = getCacheFilePath(key);
+	wchar_t tempSuffix[32];
+	swprintf_s(tempSuffix, L".%016llx.tmp", (unsigned long long)std::hash<std::thread::id>{}(std::this_thread::get_id()));
+	const std::wstring tempFilepath = filepath + tempSuffix;
+
+	std::error_code errorCode;
+	std::filesystem::create_directories(std::filesystem::path(filepath).parent_path(), errorCode);
+	{
+		std::ofstream fs(std::filesystem::path(tempFilepath), std::ios::binary | std::ios::trunc);
+		if (!fs)
+		{
+			return false;
+		}
+		const char padding[TEXTURE_CACHE_DATA_ALIGNMENT] = {};
+		fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		fs.write(reinterpret_cast<const char*>(sources.data()), sizeof(TextureCacheFileSource) * sources.size());
+		fs.write(reinterpret_cast<const char*>(chain.levels.data()), sizeof(MipChain::Level) * chain.levels.size());
+		fs.write(padding, header.dataOffset - tablesEnd);
+		fs.write(reinterpret_cast<const char*>(chain.data.data()), chain.data.size());
+		if (!fs)
+		{
+			fs.close();
+			std::filesystem::remove(tempFilepath, errorCode);
+			return false;
+		}
+	}
+	std::filesystem::rename(tempFilepath, filepath, errorCode);
+	if (errorCode)
+	{
+		std::filesystem::remove(tempFilepath, errorCode);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "core/int_types.h"
+#include "rhi/pixel_format.h"
+#include "mip_generator.h"
+#include "util/mapped_file.h"
+
+#include <string>
+#include <vector>
+
+// Processed images (after mip generation and compression) are written to this directory
+// and memory-mapped on later loads instead of decoding source images again.
+// Relative to the working directory, same as base directories of ResourceFinder.
+#define ENABLE_TEXTURE_CACHE  1
+#define TEXTURE_CACHE_DIR     L"../../intermediate/texture_cache/"
+
+// Bump when the container layout or any image processing code changes,
+// so that stale cache files are not used. Old files are overwritten on the next load.
+#define TEXTURE_CACHE_VERSION 2
+
+struct TextureCacheKey
+{
+	// Full paths of source files. A cached image can be built from several files, e.g., slices of a volume.
+	std::vector<std::wstring> sourcePaths;
+	// Hash of all settings that affect the processed image. See hashTextureCacheBytes().
+	uint64 settingsHash = 0;
+};
+
+// Processed image mapped from a cache file. Level data points into the mapping,
+// so it can be uploaded directly and is valid while the entry is alive.
+class TextureCacheEntry
+{
+public:
+	inline uint32 getNumLevels() const { return (uint32)levels.size(); }
+	inline const uint8* getLevelData(uint32 mipLevel) const { return data + levels[mipLevel].offset; }
+	inline const uint8* getSliceData(uint32 mipLevel, uint32 slice) const { return getLevelData(mipLevel) + slice * levels[mipLevel].slicePitch; }
+
+	EPixelFormat                 format = EPixelFormat::UNKNOWN;
+	uint32                       depth  = 1; // Slices in each level, e.g., of a volume or a cube.
+	std::vector<MipChain::Level> levels;
+
+private:
+	friend class TextureCache;
+	MappedFile   mappedFile;
+	const uint8* data = nullptr;
+};
+
+// Container layout, all little endian:
+//   TextureCacheFileHeader
+//   TextureCacheFileSource[numSources]
+//   MipChain::Level[numLevels]
+//   padding to 256 bytes
+//   image data of all levels
+// A cache file is valid if its version, key hash and settings hash match,
+// and every source has the same size and either the same mtime or the same content hash.
+// Content hashes are only computed when mtimes differ, e.g., files touched by a version control checkout.
+class TextureCache
+{
+public:
+	explicit TextureCache(const std::wstring& inDirectory);
+
+	// @return null if there is no valid cache file for the key. Caller owns the entry.
+	TextureCacheEntry* find(const TextureCacheKey& key) const;
+
+	// Writes a processed image for the key. For a volume or a cube, each level of the chain
+	// holds 'depth' slices of slicePitch bytes, e.g., see MipChain::allocate().
+	// @return false if sources can't be read or the file can't be written.
+	bool store(const TextureCacheKey& key, const MipChain& chain, uint32 depth = 1) const;
+
+	// Path of the cache file for the key, whether it exists or not.
+	std::wstring getCacheFilePath(const TextureCacheKey& key) const;
+
+private:
+	std::wstring directory;
+};
+
+// 64-bit hash for cache keys and source contents. Not cryptographic.
+uint64 hashTextureCacheBytes(const void* data, uint64 size, uint64 seed = 0);
@@ -0,0 +1,935 @@
+#include "texture_compressor.h"
+#include "mip_generator.h"
+#include "core/thread_pool.h"
+#include "core/assertion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// ------------------------------------------------
+// Common
+
+struct EncodeSettings
+{
+	uint32 numRefinements;
+	bool   bPrincipalAxis;
+	bool   bExhaustivePBits;
+};
+
+static EncodeSettings getEncodeSettings(ETextureCompressionQuality quality)
+{
+	switch (quality)
+	{
+		case ETextureCompressionQuality::Fast   : return EncodeSettings{ 0, false, false };
+		case ETextureCompressionQuality::Normal : return EncodeSettings{ 1, true, false };
+		case ETextureCompressionQuality::High   : return EncodeSettings{ 4, true, true };
+	}
+	CHECK_NO_ENTRY();
+	return EncodeSettings{ 0, false, false };
+}
+
+// Writes bits from LSB to MSB, as block compressed formats are laid out. Destination should be zeroed.
+struct BlockBitWriter
+{
+	void write(uint32 value, uint32 numBits)
+	{
+		for (uint32 i = 0; i < numBits; ++i, ++position)
+		{
+			if ((value >> i) & 1)
+			{
+				dest[position >> 3] |= (uint8)(1 << (position & 7));
+			}
+		}
+	}
+	uint8* dest;
+	uint32 position = 0;
+};
+
+struct BlockBitReader
+{
+	uint32 read(uint32 numBits)
+	{
+		uint32 value = 0;
+		for (uint32 i = 0; i < numBits; ++i, ++position)
+		{
+			value |= (uint32)((src[position >> 3] >> (position & 7)) & 1) << i;
+		}
+		return value;
+	}
+	const uint8* src;
+	uint32 position = 0;
+};
+
+// Source texels are expanded to rgba8. Missing components are 0, except alpha which is 255.
+static void fetchBlock(const uint8* src, uint32 numComponents, uint32 width, uint32 height, uint64 rowPitch, uint32 blockX, uint32 blockY, uint8 outBlock[64])
+{
+	for (uint32 y = 0; y < 4; ++y)
+	{
+		const uint8* row = src + rowPitch * std::min(blockY * 4 + y, height - 1);
+		for (uint32 x = 0; x < 4; ++x)
+		{
+			const uint8* texel = row + numComponents * std::min(blockX * 4 + x, width - 1);
+			uint8* dst = outBlock + 4 * (4 * y + x);
+			if (numComponents == 4)
+			{
+				::memcpy(dst, texel, 4);
+			}
+			else
+			{
+				dst[0] = texel[0];
+				dst[1] = (numComponents == 2) ? texel[1] : 0;
+				dst[2] = 0;
+				dst[3] = 255;
+			}
+		}
+	}
+}
+
+// Fits a line through texels of the first numChannels channels.
+// Endpoints are the extreme projections of texels on the line.
+static void fitLineEndpoints(const float texels[16][4], uint32 numChannels, bool bPrincipalAxis, float outEndpoints[2][4])
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float minValue[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+	float maxValue[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		for (uint32 c = 0; c < numChannels; ++c)
+		{
+			mean[c] += texels[i][c];
+			minValue[c] = std::min(minValue[c], texels[i][c]);
+			maxValue[c] = std::max(maxValue[c], texels[i][c]);
+		}
+	}
+	float covariance[4][4] = {};
+	for (uint32 c = 0; c < numChannels; ++c)
+	{
+		mean[c] /= 16.0f;
+	}
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		for (uint32 c0 = 0; c0 < numChannels; ++c0)
+		{
+			for (uint32 c1 = c0; c1 < numChannels; ++c1)
+			{
+				covariance[c0][c1] += (texels[i][c0] - mean[c0]) * (texels[i][c1] - mean[c1]);
+			}
+		}
+	}
+	for (uint32 c0 = 0; c0 < numChannels; ++c0)
+	{
+		for (uint32 c1 = 0; c1 < c0; ++c1)
+		{
+			covariance[c0][c1] = covariance[c1][c0];
+		}
+	}
+
+	// Bounding box diagonal. Channels that decrease as the widest channel increases are flipped.
+	uint32 widest = 0;
+	for (uint32 c = 1; c < numChannels; ++c)
+	{
+		if (maxValue[c] - minValue[c] > maxValue[widest] - minValue[widest]) widest = c;
+	}
+	float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (uint32 c = 0; c < numChannels; ++c)
+	{
+		axis[c] = (covariance[widest][c] < 0.0f) ? (minValue[c] - maxValue[c]) : (maxValue[c] - minValue[c]);
+	}
+
+	// Principal axis by power iteration, starting from the diagonal.
+	if (bPrincipalAxis)
+	{
+		for (uint32 iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float maxComponent = 0.0f;
+			for (uint32 c0 = 0; c0 < numChannels; ++c0)
+			{
+				for (uint32 c1 = 0; c1 < numChannels; ++c1)
+				{
+					next[c0] += covariance[c0][c1] * axis[c1];
+				}
+				maxComponent = std::max(maxComponent, std::abs(next[c0]));
+			}
+			if (maxComponent < 1e-6f)
+			{
+				break;
+			}
+			for (uint32 c = 0; c < numChannels; ++c)
+			{
+				axis[c] = next[c] / maxComponent;
+			}
+		}
+	}
+
+	float lengthSq = 0.0f;
+	for (uint32 c = 0; c < numChannels; ++c)
+	{
+		lengthSq += axis[c] * axis[c];
+	}
+	if (lengthSq < 1e-12f)
+	{
+		for (uint32 c = 0; c < numChannels; ++c)
+		{
+			outEndpoints[0][c] = outEndpoints[1][c] = mean[c];
+		}
+		return;
+	}
+	const float invLength = 1.0f / std::sqrt(lengthSq);
+	for (uint32 c = 0; c < numChannels; ++c)
+	{
+		axis[c] *= invLength;
+	}
+
+	float minT = FLT_MAX, maxT = -FLT_MAX;
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		float t = 0.0f;
+		for (uint32 c = 0; c < numChannels; ++c)
+		{
+			t += (texels[i][c] - mean[c]) * axis[c];
+		}
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	for (uint32 c = 0; c < numChannels; ++c)
+	{
+		outEndpoints[0][c] = std::clamp(mean[c] + minT * axis[c], 0.0f, 255.0f);
+		outEndpoints[1][c] = std::clamp(mean[c] + maxT * axis[c], 0.0f, 255.0f);
+	}
+}
+
+// Least squares endpoints for the given weights of endpoint 1 per texel. Endpoint 0 has (1 - weight).
+// @return false if the system is singular, e.g., all texels use the same index.
+static bool solveEndpoints(const float texels[16][4], uint32 numChannels, const float weights1[16], float outEndpoints[2][4])
+{
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+	float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		const float b = weights1[i];
+		const float a = 1.0f - b;
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+		for (uint32 c = 0; c < numChannels; ++c)
+		{
+			ax[c] += a * texels[i][c];
+			bx[c] += b * texels[i][c];
+		}
+	}
+	const float det = aa * bb - ab * ab;
+	if (std::abs(det) < 1e-6f)
+	{
+		return false;
+	}
+	const float invDet = 1.0f / det;
+	for (uint32 c = 0; c < numChannels; ++c)
+	{
+		outEndpoints[0][c] = std::clamp((bb * ax[c] - ab * bx[c]) * invDet, 0.0f, 255.0f);
+		outEndpoints[1][c] = std::clamp((aa * bx[c] - ab * ax[c]) * invDet, 0.0f, 255.0f);
+	}
+	return true;
+}
+
+static inline uint32 squaredDistance(const int32* a, const uint8* b, uint32 numChannels)
+{
+	uint32 sum = 0;
+	for (uint32 c = 0; c < numChannels; ++c)
+	{
+		const int32 d = a[c] - (int32)b[c];
+		sum += (uint32)(d * d);
+	}
+	return sum;
+}
+
+// ------------------------------------------------
+// BC1 color block
+
+static uint16 quantizeRGB565(const float color[4])
+{
+	const uint32 r = (uint32)std::lround(color[0] * 31.0f / 255.0f);
+	const uint32 g = (uint32)std::lround(color[1] * 63.0f / 255.0f);
+	const uint32 b = (uint32)std::lround(color[2] * 31.0f / 255.0f);
+	return (uint16)((r << 11) | (g << 5) | b);
+}
+
+static void expandRGB565(uint16 packed, int32 outColor[3])
+{
+	const int32 r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	outColor[0] = (r << 3) | (r >> 2);
+	outColor[1] = (g << 2) | (g >> 4);
+	outColor[2] = (b << 3) | (b >> 2);
+}
+
+// Four color mode palette: c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+static void makeBC1Palette(uint16 c0, uint16 c1, int32 outPalette[4][3])
+{
+	expandRGB565(c0, outPalette[0]);
+	expandRGB565(c1, outPalette[1]);
+	for (uint32 c = 0; c < 3; ++c)
+	{
+		outPalette[2][c] = (2 * outPalette[0][c] + outPalette[1][c]) / 3;
+		outPalette[3][c] = (outPalette[0][c] + 2 * outPalette[1][c]) / 3;
+	}
+}
+
+static uint32 chooseBC1Indices(const uint8 block[64], uint16 c0, uint16 c1, uint8 outIndices[16])
+{
+	int32 palette[4][3];
+	makeBC1Palette(c0, c1, palette);
+	uint32 totalError = 0;
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		uint32 bestError = 0xffffffff;
+		for (uint8 ix = 0; ix < 4; ++ix)
+		{
+			const uint32 error = squaredDistance(palette[ix], block + 4 * i, 3);
+			if (error < bestError)
+			{
+				bestError = error;
+				outIndices[i] = ix;
+			}
+		}
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+static void encodeBC1Color(const uint8 block[64], const EncodeSettings& settings, uint8* out)
+{
+	static const float kWeights1[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	float texels[16][4];
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		for (uint32 c = 0; c < 4; ++c) texels[i][c] = (float)block[4 * i + c];
+	}
+	float endpoints[2][4];
+	fitLineEndpoints(texels, 3, settings.bPrincipalAxis, endpoints);
+
+	uint16 c0 = quantizeRGB565(endpoints[1]);
+	uint16 c1 = quantizeRGB565(endpoints[0]);
+	uint8 indices[16];
+	uint32 bestError = chooseBC1Indices(block, c0, c1, indices);
+
+	for (uint32 refinement = 0; refinement < settings.numRefinements && bestError > 0; ++refinement)
+	{
+		float weights1[16];
+		for (uint32 i = 0; i < 16; ++i) weights1[i] = kWeights1[indices[i]];
+		if (!solveEndpoints(texels, 3, weights1, endpoints))
+		{
+			break;
+		}
+		const uint16 newC0 = quantizeRGB565(endpoints[0]);
+		const uint16 newC1 = quantizeRGB565(endpoints[1]);
+		uint8 newIndices[16];
+		const uint32 error = chooseBC1Indices(block, newC0, newC1, newIndices);
+		if (error >= bestError)
+		{
+			break;
+		}
+		c0 = newC0;
+		c1 = newC1;
+		bestError = error;
+		::memcpy(indices, newIndices, 16);
+	}
+
+	// Four color mode needs c0 > c1. Swapping endpoints maps index 0 <-> 1 and 2 <-> 3.
+	if (c0 < c1)
+	{
+		std::swap(c0, c1);
+		for (uint32 i = 0; i < 16; ++i) indices[i] ^= 1;
+	}
+	else if (c0 == c1)
+	{
+		::memset(indices, 0, 16);
+	}
+
+	uint32 packedIndices = 0;
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		packedIndices |= (uint32)indices[i] << (2 * i);
+	}
+	::memcpy(out + 0, &c0, 2);
+	::memcpy(out + 2, &c1, 2);
+	::memcpy(out + 4, &packedIndices, 4);
+}
+
+static void decodeBC1Color(const uint8* in, bool bForceFourColor, uint8 outBlock[64])
+{
+	uint16 c0, c1;
+	uint32 packedIndices;
+	::memcpy(&c0, in + 0, 2);
+	::memcpy(&c1, in + 2, 2);
+	::memcpy(&packedIndices, in + 4, 4);
+
+	int32 palette[4][4];
+	expandRGB565(c0, palette[0]);
+	expandRGB565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	for (uint32 c = 0; c < 3; ++c)
+	{
+		if (c0 > c1 || bForceFourColor)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	if (c0 <= c1 && !bForceFourColor)
+	{
+		palette[3][3] = 0;
+	}
+
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		const int32* color = palette[(packedIndices >> (2 * i)) & 3];
+		for (uint32 c = 0; c < 4; ++c) outBlock[4 * i + c] = (uint8)color[c];
+	}
+}
+
+// ------------------------------------------------
+// BC4 single channel block (also alpha of BC3 and each channel of BC5)
+
+// e0 > e1: 8 values. Otherwise 6 values with explicit 0 and 255.
+static void makeBC4Palette(int32 e0, int32 e1, int32 outPalette[8])
+{
+	outPalette[0] = e0;
+	outPalette[1] = e1;
+	if (e0 > e1)
+	{
+		for (int32 i = 2; i < 8; ++i) outPalette[i] = ((8 - i) * e0 + (i - 1) * e1) / 7;
+	}
+	else
+	{
+		for (int32 i = 2; i < 6; ++i) outPalette[i] = ((6 - i) * e0 + (i - 1) * e1) / 5;
+		outPalette[6] = 0;
+		outPalette[7] = 255;
+	}
+}
+
+static uint32 chooseBC4Indices(const uint8 values[16], int32 e0, int32 e1, uint8 outIndices[16])
+{
+	int32 palette[8];
+	makeBC4Palette(e0, e1, palette);
+	uint32 totalError = 0;
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		uint32 bestError = 0xffffffff;
+		for (uint8 ix = 0; ix < 8; ++ix)
+		{
+			const int32 d = palette[ix] - (int32)values[i];
+			if ((uint32)(d * d) < bestError)
+			{
+				bestError = (uint32)(d * d);
+				outIndices[i] = ix;
+			}
+		}
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+static void encodeBC4(const uint8 values[16], const EncodeSettings& settings, uint8* out)
+{
+	int32 minValue = 255, maxValue = 0;
+	int32 minInner = 255, maxInner = 0; // Excluding 0 and 255.
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		minValue = std::min(minValue, (int32)values[i]);
+		maxValue = std::max(maxValue, (int32)values[i]);
+		if (values[i] != 0 && values[i] != 255)
+		{
+			minInner = std::min(minInner, (int32)values[i]);
+			maxInner = std::max(maxInner, (int32)values[i]);
+		}
+	}
+
+	int32 e0 = maxValue, e1 = minValue;
+	uint8 indices[16];
+	uint32 bestError = chooseBC4Indices(values, e0, e1, indices);
+
+	// Least squares in the 8 value mode.
+	float texels[16][4];
+	for (uint32 i = 0; i < 16; ++i) texels[i][0] = (float)values[i];
+	for (uint32 refinement = 0; refinement < settings.numRefinements && bestError > 0 && e0 > e1; ++refinement)
+	{
+		float weights1[16];
+		for (uint32 i = 0; i < 16; ++i) weights1[i] = (indices[i] < 2) ? (float)indices[i] : ((float)(indices[i] - 1) / 7.0f);
+		float endpoints[2][4];
+		if (!solveEndpoints(texels, 1, weights1, endpoints))
+		{
+			break;
+		}
+		const int32 newE0 = (int32)std::lround(endpoints[0][0]);
+		const int32 newE1 = (int32)std::lround(endpoints[1][0]);
+		if (newE0 <= newE1)
+		{
+			break;
+		}
+		uint8 newIndices[16];
+		const uint32 error = chooseBC4Indices(values, newE0, newE1, newIndices);
+		if (error >= bestError)
+		{
+			break;
+		}
+		e0 = newE0;
+		e1 = newE1;
+		bestError = error;
+		::memcpy(indices, newIndices, 16);
+	}
+
+	// 6 value mode is better if some values are 0 or 255 and the rest are clustered.
+	if (settings.numRefinements > 0 && bestError > 0)
+	{
+		const int32 newE0 = (minInner <= maxInner) ? minInner : 0;
+		const int32 newE1 = (minInner <= maxInner) ? maxInner : 0;
+		uint8 newIndices[16];
+		const uint32 error = chooseBC4Indices(values, newE0, newE1, newIndices);
+		if (error < bestError)
+		{
+			e0 = newE0;
+			e1 = newE1;
+			bestError = error;
+			::memcpy(indices, newIndices, 16);
+		}
+	}
+
+	::memset(out, 0, 8);
+	out[0] = (uint8)e0;
+	out[1] = (uint8)e1;
+	BlockBitWriter writer{ out + 2 };
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		writer.write(indices[i], 3);
+	}
+}
+
+static void decodeBC4(const uint8* in, uint8 outValues[16])
+{
+	int32 palette[8];
+	makeBC4Palette(in[0], in[1], palette);
+	BlockBitReader reader{ in + 2 };
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		outValues[i] = (uint8)palette[reader.read(3)];
+	}
+}
+
+// ------------------------------------------------
+// BC7 mode 6: one subset of rgba, 7-bit endpoints with a p-bit each, 4-bit indices
+
+static const int32 kBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BC7Mode6Block
+{
+	int32  endpoints[2][4]; // 7 bits
+	int32  pbits[2];
+	uint8  indices[16];
+	uint32 error = 0xffffffff;
+};
+
+static void quantizeBC7Endpoint(const float endpoint[4], int32 pbit, int32 outQuantized[4])
+{
+	for (uint32 c = 0; c < 4; ++c)
+	{
+		outQuantized[c] = std::clamp((int32)std::lround((endpoint[c] - (float)pbit) * 0.5f), 0, 127);
+	}
+}
+
+static uint32 bc7QuantizationError(const float endpoint[4], int32 pbit)
+{
+	int32 quantized[4];
+	quantizeBC7Endpoint(endpoint, pbit, quantized);
+	float error = 0.0f;
+	for (uint32 c = 0; c < 4; ++c)
+	{
+		const float d = (float)((quantized[c] << 1) | pbit) - endpoint[c];
+		error += d * d;
+	}
+	return (uint32)(error * 16.0f);
+}
+
+static uint32 chooseBC7Indices(const uint8 block[64], const int32 endpoints[2][4], const int32 pbits[2], uint8 outIndices[16])
+{
+	int32 e0[4], e1[4];
+	for (uint32 c = 0; c < 4; ++c)
+	{
+		e0[c] = (endpoints[0][c] << 1) | pbits[0];
+		e1[c] = (endpoints[1][c] << 1) | pbits[1];
+	}
+	int32 palette[16][4];
+	for (uint32 ix = 0; ix < 16; ++ix)
+	{
+		for (uint32 c = 0; c < 4; ++c)
+		{
+			palette[ix][c] = ((64 - kBC7Weights4[ix]) * e0[c] + kBC7Weights4[ix] * e1[c] + 32) >> 6;
+		}
+	}
+
+	uint32 totalError = 0;
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		uint32 bestError = 0xffffffff;
+		for (uint8 ix = 0; ix < 16; ++ix)
+		{
+			const uint32 error = squaredDistance(palette[ix], block + 4 * i, 4);
+			if (error < bestError)
+			{
+				bestError = error;
+				outIndices[i] = ix;
+			}
+		}
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+// Quantizes the endpoints with p-bits and keeps the result if it's better than inoutBest.
+static void evaluateBC7Endpoints(const uint8 block[64], const float endpoints[2][4], bool bExhaustivePBits, BC7Mode6Block& inoutBest)
+{
+	int32 pbitCandidates[4][2];
+	uint32 numCandidates = 0;
+	if (bExhaustivePBits)
+	{
+		for (int32 p = 0; p < 4; ++p)
+		{
+			pbitCandidates[numCandidates][0] = p & 1;
+			pbitCandidates[numCandidates][1] = p >> 1;
+			++numCandidates;
+		}
+	}
+	else
+	{
+		for (uint32 e = 0; e < 2; ++e)
+		{
+			pbitCandidates[0][e] = (bc7QuantizationError(endpoints[e], 1) < bc7QuantizationError(endpoints[e], 0)) ? 1 : 0;
+		}
+		numCandidates = 1;
+	}
+
+	for (uint32 candidate = 0; candidate < numCandidates; ++candidate)
+	{
+		BC7Mode6Block trial;
+		trial.pbits[0] = pbitCandidates[candidate][0];
+		trial.pbits[1] = pbitCandidates[candidate][1];
+		quantizeBC7Endpoint(endpoints[0], trial.pbits[0], trial.endpoints[0]);
+		quantizeBC7Endpoint(endpoints[1], trial.pbits[1], trial.endpoints[1]);
+		trial.error = chooseBC7Indices(block, trial.endpoints, trial.pbits, trial.indices);
+		if (trial.error < inoutBest.error)
+		{
+			inoutBest = trial;
+		}
+	}
+}
+
+static void encodeBC7(const uint8 block[64], const EncodeSettings& settings, uint8* out)
+{
+	float texels[16][4];
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		for (uint32 c = 0; c < 4; ++c) texels[i][c] = (float)block[4 * i + c];
+	}
+	float endpoints[2][4];
+	fitLineEndpoints(texels, 4, settings.bPrincipalAxis, endpoints);
+
+	BC7Mode6Block best;
+	evaluateBC7Endpoints(block, endpoints, settings.bExhaustivePBits, best);
+
+	for (uint32 refinement = 0; refinement < settings.numRefinements && best.error > 0; ++refinement)
+	{
+		float weights1[16];
+		for (uint32 i = 0; i < 16; ++i) weights1[i] = (float)kBC7Weights4[best.indices[i]] / 64.0f;
+		if (!solveEndpoints(texels, 4, weights1, endpoints))
+		{
+			break;
+		}
+		const uint32 prevError = best.error;
+		evaluateBC7Endpoints(block, endpoints, settings.bExhaustivePBits, best);
+		if (best.error >= prevError)
+		{
+			break;
+		}
+	}
+
+	// MSB of the anchor index is implicitly 0.
+	if (best.indices[0] & 8)
+	{
+		for (uint32 c = 0; c < 4; ++c) std::swap(best.endpoints[0][c], best.endpoints[1][c]);
+		std::swap(best.pbits[0], best.pbits[1]);
+		for (uint32 i = 0; i < 16; ++i) best.indices[i] = 15 - best.indices[i];
+	}
+
+	::memset(out, 0, 16);
+	BlockBitWriter writer{ out };
+	writer.write(1 << 6, 7);
+	for (uint32 c = 0; c < 4; ++c)
+	{
+		writer.write(best.endpoints[0][c], 7);
+		writer.write(best.endpoints[1][c], 7);
+	}
+	writer.write(best.pbits[0], 1);
+	writer.write(best.pbits[1], 1);
+	writer.write(best.indices[0], 3);
+	for (uint32 i = 1; i < 16; ++i)
+	{
+		writer.write(best.indices[i], 4);
+	}
+}
+
+static void decodeBC7(const uint8* in, uint8 outBlock[64])
+{
+	BlockBitReader reader{ in };
+	CHECK(reader.read(7) == (1 << 6)); // Only mode 6
+
+	int32 endpoints[2][4];
+	for (uint32 c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] = reader.read(7) << 1;
+		endpoints[1][c] = reader.read(7) << 1;
+	}
+	const int32 pbit0 = reader.read(1), pbit1 = reader.read(1);
+	for (uint32 c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] |= pbit0;
+		endpoints[1][c] |= pbit1;
+	}
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		const int32 weight = kBC7Weights4[reader.read(i == 0 ? 3 : 4)];
+		for (uint32 c = 0; c < 4; ++c)
+		{
+			outBlock[4 * i + c] = (uint8)(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+		}
+	}
+}
+
+// ------------------------------------------------
+// Public API
+
+static void encodeBlock(EPixelFormat format, const uint8 block[64], const EncodeSettings& settings, uint8* out)
+{
+	uint8 channel[16];
+	auto extractChannel = [&](uint32 c)
+	{
+		for (uint32 i = 0; i < 16; ++i) channel[i] = block[4 * i + c];
+	};
+
+	switch (format)
+	{
+		case EPixelFormat::BC1_UNORM:
+			encodeBC1Color(block, settings, out);
+			break;
+		case EPixelFormat::BC3_UNORM:
+			extractChannel(3);
+			encodeBC4(channel, settings, out);
+			encodeBC1Color(block, settings, out + 8);
+			break;
+		case EPixelFormat::BC4_UNORM:
+			extractChannel(0);
+			encodeBC4(channel, settings, out);
+			break;
+		case EPixelFormat::BC5_UNORM:
+			extractChannel(0);
+			encodeBC4(channel, settings, out);
+			extractChannel(1);
+			encodeBC4(channel, settings, out + 8);
+			break;
+		case EPixelFormat::BC7_UNORM:
+			encodeBC7(block, settings, out);
+			break;
+		default:
+			CHECK_NO_ENTRY();
+	}
+}
+
+static void decodeBlock(EPixelFormat format, const uint8* in, uint8 outBlock[64])
+{
+	uint8 channel[16];
+	switch (format)
+	{
+		case EPixelFormat::BC1_UNORM:
+			decodeBC1Color(in, false, outBlock);
+			break;
+		case EPixelFormat::BC3_UNORM:
+			decodeBC1Color(in + 8, true, outBlock);
+			decodeBC4(in, channel);
+			for (uint32 i = 0; i < 16; ++i) outBlock[4 * i + 3] = channel[i];
+			break;
+		case EPixelFormat::BC4_UNORM:
+			decodeBC4(in, channel);
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				outBlock[4 * i + 0] = channel[i];
+				outBlock[4 * i + 1] = 0;
+				outBlock[4 * i + 2] = 0;
+				outBlock[4 * i + 3] = 255;
+			}
+			break;
+		case EPixelFormat::BC5_UNORM:
+			decodeBC4(in, channel);
+			for (uint32 i = 0; i < 16; ++i) outBlock[4 * i + 0] = channel[i];
+			decodeBC4(in + 8, channel);
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				outBlock[4 * i + 1] = channel[i];
+				outBlock[4 * i + 2] = 0;
+				outBlock[4 * i + 3] = 255;
+			}
+			break;
+		case EPixelFormat::BC7_UNORM:
+			decodeBC7(in, outBlock);
+			break;
+		default:
+			CHECK_NO_ENTRY();
+	}
+}
+
+EPixelFormat chooseCompressedFormat(ETextureUsage usage, bool bHasAlpha, ETextureCompressionQuality quality)
+{
+	switch (usage)
+	{
+		case ETextureUsage::Albedo:
+			if (quality == ETextureCompressionQuality::Fast)
+			{
+				return bHasAlpha ? EPixelFormat::BC3_UNORM : EPixelFormat::BC1_UNORM;
+			}
+			return EPixelFormat::BC7_UNORM;
+		case ETextureUsage::Normal:
+			return EPixelFormat::BC5_UNORM;
+		case ETextureUsage::Mask:
+			return EPixelFormat::BC4_UNORM;
+	}
+	CHECK_NO_ENTRY();
+	return EPixelFormat::UNKNOWN;
+}
+
+bool isOpaqueRgba8(const uint8* rgba8, uint32 width, uint32 height, uint64 rowPitch)
+{
+	if (rowPitch == 0) rowPitch = uint64(width) * 4;
+	for (uint32 y = 0; y < height; ++y)
+	{
+		const uint8* row = rgba8 + rowPitch * y;
+		for (uint32 x = 0; x < width; ++x)
+		{
+			if (row[4 * x + 3] != 255)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void compressImage_internal(
+	const uint8* src,
+	uint32 numComponents,
+	uint32 width,
+	uint32 height,
+	uint64 rowPitch,
+	EPixelFormat format,
+	ETextureCompressionQuality quality,
+	uint8* outBlocks,
+	ThreadPool* threadPool)
+{
+	CHECK(src != nullptr && width > 0 && height > 0);
+	CHECK(isBlockCompressedFormat(format));
+	if (rowPitch == 0) rowPitch = uint64(width) * numComponents;
+
+	const uint32 numBlocksX = (width + 3) / 4;
+	const uint32 numBlocksY = (height + 3) / 4;
+	const uint32 blockBytes = getBlockCompressedBlockBytes(format);
+	const EncodeSettings settings = getEncodeSettings(quality);
+
+	auto encodeBlockRows = [&](uint32 begin, uint32 end)
+	{
+		uint8 block[64];
+		for (uint32 blockY = begin; blockY < end; ++blockY)
+		{
+			uint8* out = outBlocks + (uint64)blockY * numBlocksX * blockBytes;
+			for (uint32 blockX = 0; blockX < numBlocksX; ++blockX)
+			{
+				fetchBlock(src, numComponents, width, height, rowPitch, blockX, blockY, block);
+				encodeBlock(format, block, settings, out + (uint64)blockX * blockBytes);
+			}
+		}
+	};
+
+	const uint32 grainSize = std::max(1u, TEXTURE_COMPRESSOR_GRAIN_BLOCKS / numBlocksX);
+	if (threadPool == nullptr || numBlocksY <= grainSize)
+	{
+		encodeBlockRows(0, numBlocksY);
+	}
+	else
+	{
+		threadPool->parallelFor(numBlocksY, grainSize, [&](uint32 chunkIx, uint32 begin, uint32 end)
+			{
+				encodeBlockRows(begin, end);
+			});
+	}
+}
+
+void compressImage(
+	const uint8* rgba8,
+	uint32 width,
+	uint32 height,
+	uint64 rowPitch,
+	EPixelFormat format,
+	ETextureCompressionQuality quality,
+	uint8* outBlocks,
+	ThreadPool* threadPool)
+{
+	compressImage_internal(rgba8, 4, width, height, rowPitch, format, quality, outBlocks, threadPool);
+}
+
+void compressMipChain(
+	const MipChain& src,
+	EPixelFormat format,
+	ETextureCompressionQuality quality,
+	MipChain& outChain,
+	ThreadPool* threadPool)
+{
+	CHECK(src.getNumLevels() > 0);
+	const uint32 numComponents = (src.format == EPixelFormat::R8G8B8A8_UNORM) ? 4
+		: (src.format == EPixelFormat::R8G8_UNORM) ? 2
+		: (src.format == EPixelFormat::R8_UNORM) ? 1 : 0;
+	CHECK(numComponents != 0);
+
+	outChain.allocate(format, src.levels[0].width, src.levels[0].height, src.getNumLevels());
+	for (uint32 mip = 0; mip < src.getNumLevels(); ++mip)
+	{
+		const MipChain::Level& level = src.levels[mip];
+		compressImage_internal(src.getLevelData(mip), numComponents, level.width, level.height, level.rowPitch,
+			format, quality, outChain.getLevelData(mip), threadPool);
+	}
+}
+
+void decompressImage(const uint8* blocks, uint32 width, uint32 height, EPixelFormat format, uint8* outRgba8)
+{
+	const uint32 numBlocksX = (width + 3) / 4;
+	const uint32 numBlocksY = (height + 3) / 4;
+	const uint32 blockBytes = getBlockCompressedBlockBytes(format);
+
+	uint8 block[64];
+	for (uint32 blockY = 0; blockY < numBlocksY; ++blockY)
+	{
+		for (uint32 blockX = 0; blockX < numBlocksX; ++blockX)
+		{
+			decodeBlock(format, blocks + ((uint64)blockY * numBlocksX + blockX) * blockBytes, block);
+			for (uint32 y = 0; y < 4 && blockY * 4 + y < height; ++y)
+			{
+				for (uint32 x = 0; x < 4 && blockX * 4 + x < width; ++x)
+				{
+					::memcpy(outRgba8 + 4 * ((uint64)(blockY * 4 + y) * width + blockX * 4 + x), block + 4 * (4 * y + x), 4);
+				}
+			}
+		}
+	}
+}
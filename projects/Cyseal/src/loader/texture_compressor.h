@@ -0,0 +1,59 @@
+#pragma once
+
+#include "core/int_types.h"
+#include "rhi/pixel_format.h"
+
+class ThreadPool;
+struct MipChain;
+
+// Block rows per parallel chunk are chosen so that a chunk covers about this many blocks.
+#define TEXTURE_COMPRESSOR_GRAIN_BLOCKS 1024
+
+// What a texture is sampled for. Decides its block compressed format.
+enum class ETextureUsage : uint8
+{
+	Albedo, // rgb, and alpha if not opaque.
+	Normal, // Tangent space xy in rg. z is reconstructed in shaders.
+	Mask,   // Single channel in r, e.g., roughness, metalness or opacity.
+};
+
+enum class ETextureCompressionQuality : uint8
+{
+	Fast,   // Bounding box endpoints. BC1/BC3 for albedo.
+	Normal, // Principal axis endpoints, refined once by least squares.
+	High,   // Refined several times, and all p-bit combinations are tried for BC7.
+};
+
+// Albedo: BC7, or BC1/BC3 if Fast. Normal: BC5. Mask: BC4.
+EPixelFormat chooseCompressedFormat(ETextureUsage usage, bool bHasAlpha, ETextureCompressionQuality quality);
+
+// @return true if all alpha values are 255.
+bool isOpaqueRgba8(const uint8* rgba8, uint32 width, uint32 height, uint64 rowPitch);
+
+// Encodes an rgba8 image into 4x4 blocks. Partial blocks at right and bottom edges repeat edge texels.
+// BC4 stores r and BC5 stores rg. BC1 ignores alpha.
+// @param rowPitch   Bytes of a source row. If 0, (width * 4).
+// @param outBlocks  getPixelFormatRowBytes(format, width) * getPixelFormatNumRows(format, height) bytes.
+// @param threadPool If not null, block rows are encoded in parallel. Results are the same as serial.
+void compressImage(
+	const uint8* rgba8,
+	uint32 width,
+	uint32 height,
+	uint64 rowPitch,
+	EPixelFormat format,
+	ETextureCompressionQuality quality,
+	uint8* outBlocks,
+	ThreadPool* threadPool = nullptr);
+
+// Compresses every level of a mip chain of R8G8B8A8, R8G8 or R8 UNORM.
+// Sources with fewer components are expanded as (r, 0, 0, 255) and (r, g, 0, 255), which suit BC4 and BC5.
+void compressMipChain(
+	const MipChain& src,
+	EPixelFormat format,
+	ETextureCompressionQuality quality,
+	MipChain& outChain,
+	ThreadPool* threadPool = nullptr);
+
+// Decodes blocks into rgba8 as GPUs sample them: BC4 is (r, 0, 0, 255) and BC5 is (r, g, 0, 255).
+// Only BC7 mode 6 is supported, which is the only mode compressImage() writes.
+void decompressImage(const uint8* blocks, uint32 width, uint32 height, EPixelFormat format, uint8* outRgba8);
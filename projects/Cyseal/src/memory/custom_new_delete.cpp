@@ -5,6 +5,9 @@
 //        Disable it for final build.
 #define ENABLE_MEMORY_TRACKING 1
 
+// Serve small allocations from size-class slabs instead of the system heap.
+#define ENABLE_SLAB_ALLOCATOR 1
+
 // --------------------------------------------------------
 
 #include "memory_tag.h"
@@ -12,6 +15,9 @@
 #if ENABLE_MEMORY_TRACKING
 	#include "memory_tracker.h"
 #endif
+#if ENABLE_SLAB_ALLOCATOR
+	#include "slab_allocator.h"
+#endif
 
 #include <cstdio>
 #include <cstdlib>
@@ -29,7 +35,12 @@ namespace cyseal_private
 			//++sz; // avoid std::malloc(0) which may return nullptr on success
 		}
 
-		if (void* ptr = std::malloc(sz))
+#if ENABLE_SLAB_ALLOCATOR
+		void* ptr = (sz <= SlabAllocator::MAX_BLOCK_SIZE) ? SlabAllocator::alloc(sz) : std::malloc(sz);
+#else
+		void* ptr = std::malloc(sz);
+#endif
+		if (ptr != nullptr)
 		{
 #if ENABLE_MEMORY_TRACKING
 			if (memoryTag != EMemoryTag::Untracked)
@@ -64,6 +75,13 @@ void operator delete(void* ptr) noexcept
 {
 #if ENABLE_MEMORY_TRACKING
 	MemoryTracker::get().decrease(ptr);
+#endif
+#if ENABLE_SLAB_ALLOCATOR
+	if (SlabAllocator::owns(ptr))
+	{
+		SlabAllocator::free(ptr);
+		return;
+	}
 #endif
 	std::free(ptr);
 }
@@ -0,0 +1,111 @@
+#include "frame_allocator.h"
+#include "custom_new_delete.h"
+
+#include <algorithm>
+#include <new>
+
+// -----------------------------------------
+// LinearAllocator
+
+LinearAllocator::LinearAllocator(size_t inChunkSize, EMemoryTag inMemoryTag)
+	: chunkSize(inChunkSize)
+	, memoryTag(inMemoryTag)
+{
+	CHECK(chunkSize > 0);
+}
+
+LinearAllocator::~LinearAllocator()
+{
+	releaseChunks();
+}
+
+void* LinearAllocator::alloc(size_t bytes, size_t alignment)
+{
+	CHECK(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	if (bytes == 0)
+	{
+		bytes = 1;
+	}
+
+	if (chunks.size() > 0)
+	{
+		const Chunk& chunk = chunks.back();
+		const uintptr_t base = reinterpret_cast<uintptr_t>(chunk.memblock);
+		const uintptr_t aligned = (base + usedBytes + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		const size_t offset = (size_t)(aligned - base);
+		if (offset + bytes <= chunk.capacity)
+		{
+			usedBytes = offset + bytes;
+			return reinterpret_cast<void*>(aligned);
+		}
+	}
+
+	// Chunk memory is aligned for max_align_t, so over-reserve only for larger alignments.
+	addChunk(bytes + ((alignment > alignof(std::max_align_t)) ? alignment : 0));
+	return alloc(bytes, alignment);
+}
+
+void LinearAllocator::reset()
+{
+	if (chunks.size() > 1)
+	{
+		const size_t mergedCapacity = totalCapacity;
+		releaseChunks();
+		addChunk(mergedCapacity);
+	}
+	usedBytes = 0;
+	usedBytesInPrevChunks = 0;
+	numHeapAllocations = 0;
+}
+
+void LinearAllocator::addChunk(size_t minBytes)
+{
+	if (chunks.size() > 0)
+	{
+		usedBytesInPrevChunks += chunks.back().capacity;
+	}
+	const size_t capacity = std::max(chunkSize, minBytes);
+	uint8* memblock = static_cast<uint8*>(::operator new(capacity, memoryTag));
+	chunks.push_back(Chunk{ memblock, capacity });
+	usedBytes = 0;
+	totalCapacity += capacity;
+	++numHeapAllocations;
+}
+
+void LinearAllocator::releaseChunks()
+{
+	for (Chunk& chunk : chunks)
+	{
+		::operator delete(chunk.memblock);
+	}
+	chunks.clear();
+	totalCapacity = 0;
+}
+
+// -----------------------------------------
+// FrameAllocator
+
+FrameAllocator::~FrameAllocator()
+{
+	for (LinearAllocator* allocator : allocators)
+	{
+		delete allocator;
+	}
+}
+
+void FrameAllocator::initialize(uint32 maxFramesInFlight, size_t chunkSize, EMemoryTag memoryTag)
+{
+	CHECK(allocators.size() == 0 && maxFramesInFlight > 0);
+	for (uint32 i = 0; i < maxFramesInFlight; ++i)
+	{
+		allocators.push_back(new(memoryTag) LinearAllocator(chunkSize, memoryTag));
+	}
+}
+
+LinearAllocator* FrameAllocator::beginFrame(uint32 frameIndex)
+{
+	CHECK(frameIndex < allocators.size());
+	current = allocators[frameIndex];
+	current->reset();
+	return current;
+}
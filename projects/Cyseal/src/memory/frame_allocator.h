@@ -0,0 +1,122 @@
+#pragma once
+
+#include "core/int_types.h"
+#include "core/assertion.h"
+#include "memory/memory_tag.h"
+
+#include <cstddef>
+#include <vector>
+
+// Linear allocator for transient data. Unlike StackAllocator,
+// - Sizes are 64-bit and allocations are aligned.
+// - Grows in chunks instead of failing when full.
+// - Individual deallocation is a no-op. Memory is released at once by reset().
+class LinearAllocator
+{
+	struct Chunk
+	{
+		uint8* memblock;
+		size_t capacity;
+	};
+
+public:
+	explicit LinearAllocator(size_t inChunkSize = 256 * 1024, EMemoryTag inMemoryTag = EMemoryTag::Renderer);
+	~LinearAllocator();
+
+	LinearAllocator(const LinearAllocator&) = delete;
+	LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+	// alignment should be a power of two.
+	void* alloc(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+	template<typename T>
+	T* allocArray(size_t count)
+	{
+		return static_cast<T*>(alloc(count * sizeof(T), alignof(T)));
+	}
+
+	// Invalidate all allocations. If the last usage needed several chunks,
+	// they are merged into one chunk so that steady-state frames don't touch the heap.
+	void reset();
+
+	inline size_t getUsedBytes() const { return usedBytesInPrevChunks + usedBytes; }
+	inline size_t getCapacity() const { return totalCapacity; }
+	// Number of heap allocations made since the last reset().
+	inline uint32 getNumHeapAllocations() const { return numHeapAllocations; }
+
+private:
+	void addChunk(size_t minBytes);
+	void releaseChunks();
+
+	size_t             chunkSize;
+	EMemoryTag         memoryTag;
+
+	std::vector<Chunk> chunks;
+	size_t             usedBytes = 0;             // In the last chunk
+	size_t             usedBytesInPrevChunks = 0; // Including alignment waste
+	size_t             totalCapacity = 0;
+	uint32             numHeapAllocations = 0;
+};
+
+// Multi-buffered LinearAllocator. Allocations made in a frame stay valid
+// until the same frame index comes again, so GPU work in flight can read them.
+class FrameAllocator
+{
+public:
+	FrameAllocator() = default;
+	~FrameAllocator();
+
+	void initialize(uint32 maxFramesInFlight, size_t chunkSize = 256 * 1024, EMemoryTag memoryTag = EMemoryTag::Renderer);
+
+	// Resets the allocator of the given frame index and makes it current.
+	LinearAllocator* beginFrame(uint32 frameIndex);
+
+	inline LinearAllocator* getCurrent() const { return current; }
+
+private:
+	std::vector<LinearAllocator*> allocators;
+	LinearAllocator* current = nullptr;
+};
+
+// STL allocator adaptor for LinearAllocator.
+// e.g., LinearVector<T> v{ LinearStlAllocator<T>(frameInfo.frameAllocator) };
+template<typename T>
+class LinearStlAllocator
+{
+public:
+	using value_type = T;
+
+	LinearStlAllocator(LinearAllocator* inArena) noexcept
+		: arena(inArena)
+	{
+		CHECK(arena != nullptr);
+	}
+
+	template<typename U>
+	LinearStlAllocator(const LinearStlAllocator<U>& other) noexcept
+		: arena(other.getArena())
+	{
+	}
+
+	inline T* allocate(size_t n)
+	{
+		return arena->allocArray<T>(n);
+	}
+	inline void deallocate(T* p, size_t n) noexcept
+	{
+		// Released at once by LinearAllocator::reset().
+	}
+
+	inline LinearAllocator* getArena() const { return arena; }
+
+	template<typename U>
+	inline bool operator==(const LinearStlAllocator<U>& other) const { return arena == other.getArena(); }
+	template<typename U>
+	inline bool operator!=(const LinearStlAllocator<U>& other) const { return arena != other.getArena(); }
+
+private:
+	LinearAllocator* arena;
+};
+
+template<typename T>
+using LinearVector = std::vector<T, LinearStlAllocator<T>>;
@@ -5,168 +5,132 @@
 
 #include "core/int_types.h"
 #include "core/assertion.h"
-#include "memory/custom_new_delete.h"
+#include "memory/hierarchical_bitmap.h"
 
-// Possible improvements
-// 1. Binary search the intervals to alloc/dealloc.
-// 2. Implement a method to allocate several numbers at once.
+// Thin wrapper of HierarchicalBitmap where bit (n - 1) represents number n.
+// Single allocation and deallocation cost O(log64(maxNumber)).
 class FreeNumberList
 {
-	// Represent allocated numbers
-	struct Range { uint32 a, b; Range* next; }; // [a, b]
-
 public:
 	static void clone(const FreeNumberList& src, FreeNumberList& dst)
 	{
 		CHECK(dst.maxNumber >= src.maxNumber);
-
-		dst.clear();
-		Range* srcNode = src.head;
-		Range** dstNode = &dst.head;
-		Range* dstNodePrev = nullptr;
-		while (srcNode != nullptr)
-		{
-			*dstNode = new Range{ srcNode->a, srcNode->b, nullptr };
-			srcNode = srcNode->next;
-			if (dstNodePrev != nullptr)
-			{
-				dstNodePrev->next = *dstNode;
-			}
-			dstNodePrev = *dstNode;
-			dstNode = &((*dstNode)->next);
-		}
+		dst.bitmap.copyFrom(src.bitmap);
 	}
 
 public:
 	FreeNumberList(uint32 inMaxNumber = 0xffffffff, EMemoryTag inMemoryTag = EMemoryTag::Etc)
 		: maxNumber(inMaxNumber)
-		, memoryTag(inMemoryTag)
-		, head(nullptr)
+		, bitmap(inMaxNumber, inMemoryTag)
 	{
 	}
 
-	~FreeNumberList()
-	{
-		clear();
-	}
-
 	// Allocate a new free number, greater than 0.
-	// It's not guaranteed that the smallest free number will be returned.
+	// Currently the smallest free number is returned, but callers should not rely on it.
 	// @return The allocated number. 0 if failed.
 	uint32 allocate()
 	{
-		if (head == nullptr)
+		const uint32 ix = bitmap.findFirstZero();
+		if (ix == HierarchicalBitmap::INVALID_INDEX)
 		{
-			head = new(memoryTag) Range{ 1, 1, nullptr };
-			return head->a;
+			return 0;
 		}
-		else if (head->a > 1)
+		bitmap.set(ix);
+		return ix + 1;
+	}
+
+	// Allocate 'count' consecutive numbers.
+	// @return The first number of [first, first + count). 0 if failed.
+	uint32 allocateRange(uint32 count)
+	{
+		const uint32 ix = bitmap.findZeroRun(count);
+		if (ix == HierarchicalBitmap::INVALID_INDEX)
 		{
-			head->a -= 1;
-			return head->a;
+			return 0;
 		}
+		bitmap.setRange(ix, count);
+		return ix + 1;
+	}
 
-		Range* cand = head;
-		while (cand != nullptr)
+	// Allocate 'count' numbers that are not necessarily consecutive.
+	// Nothing is allocated if there are less than 'count' free numbers.
+	// @return true if successful, false otherwise.
+	bool allocate(uint32 count, uint32* outNumbers)
+	{
+		if (count > maxNumber - bitmap.getNumSetBits())
 		{
-			if (cand->b == maxNumber) return 0;
-			Range* next = cand->next;
-			if (next == nullptr || cand->b < next->a - 1)
-			{
-				cand->b += 1;
-				uint32 freeNumber = cand->b;
-				if (next != nullptr && cand->b == next->a)
-				{
-					cand->b = next->b;
-					cand->next = next->next;
-					delete next;
-				}
-				return freeNumber;
-			}
-			cand = cand->next;
+			return false;
 		}
-		return 0;
+		uint32 ix = 0;
+		for (uint32 i = 0; i < count; ++i)
+		{
+			ix = bitmap.findNextZero(ix);
+			CHECK(ix != HierarchicalBitmap::INVALID_INDEX);
+			bitmap.set(ix);
+			outNumbers[i] = ix + 1;
+		}
+		return true;
 	}
-	
-	//uint32 allocate(uint32 count, uint32* outNumbers);
 
 	// Put back the number to the free list.
 	// Fail if it's not a free number.
 	// @return true if successful, false otherwise.
 	bool deallocate(uint32 number)
 	{
-		if (number > maxNumber) return false; // early exit
+		if (number == 0 || number > maxNumber || !bitmap.test(number - 1))
+		{
+			return false;
+		}
+		bitmap.clear(number - 1);
+		return true;
+	}
 
-		Range* candPrev = nullptr;
-		Range* cand = head;
-		while (cand != nullptr)
+	// Put back [first, first + count) to the free list.
+	// Fail without any change if any of them is not allocated.
+	// @return true if successful, false otherwise.
+	bool deallocateRange(uint32 first, uint32 count)
+	{
+		if (first == 0 || count == 0 || !bitmap.isRangeSet(first - 1, count))
 		{
-			if (cand->a == number || cand->b == number)
-			{
-				if (cand->a == number) cand->a += 1;
-				else cand->b -= 1;
-				if (cand->a > cand->b)
-				{
-					if (cand == head)
-					{
-						head = cand->next;
-					}
-					if (candPrev != nullptr)
-					{
-						candPrev->next = cand->next;
-					}
-					delete cand;
-				}
-				return true;
-			}
-			else if (cand->a < number && number < cand->b)
-			{
-				cand->next = new(memoryTag) Range{ number + 1, cand->b, cand->next };
-				cand->b = number - 1;
-				return true;
-			}
-			candPrev = cand;
-			cand = cand->next;
+			return false;
 		}
-		return false;
+		bitmap.clearRange(first - 1, count);
+		return true;
 	}
 
 	// Returns true if can allocate further.
 	bool canAllocate() const
 	{
-		if (head == nullptr)
-		{
-			return maxNumber != 0;
-		}
-		Range* tail = head;
-		while (tail != nullptr && tail->next != nullptr)
-		{
-			if (tail->b < tail->next->a - 1) return true;
-			tail = tail->next;
-		}
-		return tail->b != maxNumber;
+		return bitmap.getNumSetBits() < maxNumber;
 	}
 
 	void clear()
 	{
-		Range* item = head;
-		while (item != nullptr)
-		{
-			Range* temp = item;
-			item = item->next;
-			delete temp;
-		}
-		head = nullptr;
+		bitmap.reset();
 	}
 
 	bool isEmpty() const
 	{
-		return head == nullptr;
+		return bitmap.getNumSetBits() == 0;
+	}
+
+	inline uint32 getNumAllocated() const { return bitmap.getNumSetBits(); }
+
+	// @return The smallest allocated number. 0 if nothing is allocated.
+	uint32 getMinAllocated() const
+	{
+		const uint32 ix = bitmap.findFirstOne();
+		return (ix != HierarchicalBitmap::INVALID_INDEX) ? (ix + 1) : 0;
+	}
+
+	// @return The largest allocated number. 0 if nothing is allocated.
+	uint32 getMaxAllocated() const
+	{
+		const uint32 ix = bitmap.findLastOne();
+		return (ix != HierarchicalBitmap::INVALID_INDEX) ? (ix + 1) : 0;
 	}
 
 private:
 	uint32 maxNumber;
-	EMemoryTag memoryTag;
-
-	Range* head;
+	HierarchicalBitmap bitmap;
 };
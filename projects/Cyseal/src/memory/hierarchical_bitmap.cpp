@@ -0,0 +1,313 @@
+#include "hierarchical_bitmap.h"
+#include "custom_new_delete.h"
+#include "core/assertion.h"
+
+#include <bit>
+#include <cstring>
+#include <algorithm>
+
+static constexpr uint64 ALL_ONES = ~0ull;
+
+HierarchicalBitmap::HierarchicalBitmap(uint32 inNumBits, EMemoryTag inMemoryTag)
+	: numBits(inNumBits)
+	, memoryTag(inMemoryTag)
+{
+	uint32 words = (uint32)(((uint64)numBits + 63) / 64);
+	levels[0].maxWords = words;
+	numLevels = 1;
+	while (words > 1)
+	{
+		words = (words + 63) / 64;
+		CHECK(numLevels < MAX_LEVELS);
+		levels[numLevels].maxWords = words;
+		++numLevels;
+	}
+}
+
+HierarchicalBitmap::~HierarchicalBitmap()
+{
+	reset();
+}
+
+void HierarchicalBitmap::copyFrom(const HierarchicalBitmap& src)
+{
+	CHECK(src.numBits <= numBits);
+
+	reset();
+	const Level& srcLevel = src.levels[0];
+	if (srcLevel.numWords > 0)
+	{
+		reserveWords(0, srcLevel.numWords - 1);
+		::memcpy(levels[0].full, srcLevel.full, srcLevel.numWords * sizeof(uint64));
+	}
+	numSetBits = src.numSetBits;
+	rebuildSummaries();
+}
+
+bool HierarchicalBitmap::test(uint32 ix) const
+{
+	if (ix >= numBits) return false;
+	return ((getFull(0, ix / 64) >> (ix % 64)) & 1) != 0;
+}
+
+void HierarchicalBitmap::set(uint32 ix)
+{
+	CHECK(ix < numBits);
+	const uint32 w = ix / 64;
+	writeWord(w, getFull(0, w) | (1ull << (ix % 64)));
+}
+
+void HierarchicalBitmap::clear(uint32 ix)
+{
+	CHECK(ix < numBits);
+	const uint32 w = ix / 64;
+	writeWord(w, getFull(0, w) & ~(1ull << (ix % 64)));
+}
+
+// Calls fn(wordIndex, mask) for each word that [first, first + count) touches.
+template<typename Fn>
+static void forEachWordInRange(uint32 first, uint32 count, Fn fn)
+{
+	uint64 begin = first;
+	const uint64 end = (uint64)first + count;
+	while (begin < end)
+	{
+		const uint32 w = (uint32)(begin / 64);
+		const uint32 lo = (uint32)(begin % 64);
+		const uint32 hi = (uint32)std::min<uint64>(64, end - (uint64)w * 64);
+		const uint64 mask = ((hi == 64) ? ALL_ONES : ((1ull << hi) - 1)) & (ALL_ONES << lo);
+		if (!fn(w, mask)) break;
+		begin = (uint64)(w + 1) * 64;
+	}
+}
+
+void HierarchicalBitmap::setRange(uint32 first, uint32 count)
+{
+	CHECK((uint64)first + count <= numBits);
+	forEachWordInRange(first, count, [this](uint32 w, uint64 mask) {
+		writeWord(w, getFull(0, w) | mask);
+		return true;
+	});
+}
+
+void HierarchicalBitmap::clearRange(uint32 first, uint32 count)
+{
+	CHECK((uint64)first + count <= numBits);
+	forEachWordInRange(first, count, [this](uint32 w, uint64 mask) {
+		writeWord(w, getFull(0, w) & ~mask);
+		return true;
+	});
+}
+
+bool HierarchicalBitmap::isRangeSet(uint32 first, uint32 count) const
+{
+	if ((uint64)first + count > numBits) return false;
+	bool bAllSet = true;
+	forEachWordInRange(first, count, [this, &bAllSet](uint32 w, uint64 mask) {
+		bAllSet = (getFull(0, w) & mask) == mask;
+		return bAllSet;
+	});
+	return bAllSet;
+}
+
+void HierarchicalBitmap::reset()
+{
+	for (uint32 i = 0; i < numLevels; ++i)
+	{
+		Level& level = levels[i];
+		if (level.full != nullptr) ::operator delete(level.full);
+		if (level.any != nullptr) ::operator delete(level.any);
+		level.full = nullptr;
+		level.any = nullptr;
+		level.numWords = 0;
+	}
+	numSetBits = 0;
+}
+
+uint32 HierarchicalBitmap::findLastOne() const
+{
+	const uint32 top = numLevels - 1;
+	if (getAny(top, 0) == 0)
+	{
+		return INVALID_INDEX;
+	}
+	return descend(top, 0, true, false);
+}
+
+uint32 HierarchicalBitmap::findZeroRun(uint32 count) const
+{
+	if (count == 0)
+	{
+		return INVALID_INDEX;
+	}
+	uint32 start = findNextZero(0);
+	while (start != INVALID_INDEX)
+	{
+		if ((uint64)start + count > numBits)
+		{
+			return INVALID_INDEX;
+		}
+		const uint32 nextOne = findNextOne(start);
+		const uint64 end = (nextOne == INVALID_INDEX) ? numBits : nextOne;
+		if (end - start >= count)
+		{
+			return start;
+		}
+		start = findNextZero(nextOne);
+	}
+	return INVALID_INDEX;
+}
+
+uint32 HierarchicalBitmap::findNext(uint32 from, bool bFindOne) const
+{
+	if (from >= numBits)
+	{
+		return INVALID_INDEX;
+	}
+
+	uint32 child = from / 64;
+	uint64 word = getFull(0, child);
+	uint64 candidates = (bFindOne ? word : ~word) & (ALL_ONES << (from % 64));
+	if (candidates != 0)
+	{
+		const uint32 ix = child * 64 + (uint32)std::countr_zero(candidates);
+		return (ix < numBits) ? ix : INVALID_INDEX;
+	}
+
+	// Climb up until a summary word has a candidate after the current child.
+	for (uint32 level = 1; level < numLevels; ++level)
+	{
+		const uint32 parent = child / 64;
+		const uint32 shift = (child % 64) + 1;
+		const uint64 mask = (shift == 64) ? 0 : (ALL_ONES << shift);
+		candidates = (bFindOne ? getAny(level, parent) : ~getFull(level, parent)) & mask;
+		if (candidates != 0)
+		{
+			const uint32 ix = descend(level - 1, parent * 64 + (uint32)std::countr_zero(candidates), bFindOne, true);
+			return (ix < numBits) ? ix : INVALID_INDEX;
+		}
+		child = parent;
+	}
+	return INVALID_INDEX;
+}
+
+uint32 HierarchicalBitmap::descend(uint32 level, uint32 w, bool bFindOne, bool bLowest) const
+{
+	while (true)
+	{
+		uint64 candidates;
+		if (level == 0)
+		{
+			candidates = bFindOne ? getFull(0, w) : ~getFull(0, w);
+		}
+		else
+		{
+			candidates = bFindOne ? getAny(level, w) : ~getFull(level, w);
+		}
+		CHECK(candidates != 0);
+
+		const uint32 bit = bLowest ? (uint32)std::countr_zero(candidates) : (63 - (uint32)std::countl_zero(candidates));
+		const uint64 next = (uint64)w * 64 + bit;
+		if (level == 0 || next >= levels[level - 1].maxWords)
+		{
+			// Past the last word, only possible when searching zeros. Caller rejects it.
+			return (level == 0 && next < numBits) ? (uint32)next : INVALID_INDEX;
+		}
+		w = (uint32)next;
+		--level;
+	}
+}
+
+void HierarchicalBitmap::reserveWords(uint32 level, uint32 wordIx)
+{
+	Level& L = levels[level];
+	if (wordIx < L.numWords)
+	{
+		return;
+	}
+	CHECK(wordIx < L.maxWords);
+
+	const uint32 newNumWords = std::min(L.maxWords, std::max({ wordIx + 1, L.numWords * 2, 4u }));
+	const size_t bytes = newNumWords * sizeof(uint64);
+
+	uint64* newFull = static_cast<uint64*>(::operator new(bytes, memoryTag));
+	::memset(newFull, 0, bytes);
+	if (L.full != nullptr)
+	{
+		::memcpy(newFull, L.full, L.numWords * sizeof(uint64));
+		::operator delete(L.full);
+	}
+	L.full = newFull;
+
+	if (level > 0)
+	{
+		uint64* newAny = static_cast<uint64*>(::operator new(bytes, memoryTag));
+		::memset(newAny, 0, bytes);
+		if (L.any != nullptr)
+		{
+			::memcpy(newAny, L.any, L.numWords * sizeof(uint64));
+			::operator delete(L.any);
+		}
+		L.any = newAny;
+	}
+
+	L.numWords = newNumWords;
+}
+
+void HierarchicalBitmap::writeWord(uint32 w, uint64 newValue)
+{
+	const uint64 oldValue = getFull(0, w);
+	if (oldValue == newValue)
+	{
+		return;
+	}
+	reserveWords(0, w);
+	levels[0].full[w] = newValue;
+	numSetBits = numSetBits + std::popcount(newValue) - std::popcount(oldValue);
+
+	bool bOldFull = (oldValue == ALL_ONES), bNewFull = (newValue == ALL_ONES);
+	bool bOldAny = (oldValue != 0), bNewAny = (newValue != 0);
+	uint32 child = w;
+	for (uint32 level = 1; level < numLevels; ++level)
+	{
+		if (bOldFull == bNewFull && bOldAny == bNewAny)
+		{
+			break;
+		}
+		const uint32 parent = child / 64;
+		const uint64 bit = 1ull << (child % 64);
+		reserveWords(level, parent);
+
+		Level& L = levels[level];
+		const uint64 oldFull = L.full[parent];
+		const uint64 oldAny = L.any[parent];
+		L.full[parent] = bNewFull ? (oldFull | bit) : (oldFull & ~bit);
+		L.any[parent] = bNewAny ? (oldAny | bit) : (oldAny & ~bit);
+
+		bOldFull = (oldFull == ALL_ONES);
+		bNewFull = (L.full[parent] == ALL_ONES);
+		bOldAny = (oldAny != 0);
+		bNewAny = (L.any[parent] != 0);
+		child = parent;
+	}
+}
+
+void HierarchicalBitmap::rebuildSummaries()
+{
+	for (uint32 level = 1; level < numLevels; ++level)
+	{
+		const Level& childLevel = levels[level - 1];
+		for (uint32 c = 0; c < childLevel.numWords; ++c)
+		{
+			const bool bChildFull = (childLevel.full[c] == ALL_ONES);
+			const bool bChildAny = (level == 1) ? (childLevel.full[c] != 0) : (childLevel.any[c] != 0);
+			if (bChildFull || bChildAny)
+			{
+				reserveWords(level, c / 64);
+				const uint64 bit = 1ull << (c % 64);
+				if (bChildFull) levels[level].full[c / 64] |= bit;
+				if (bChildAny) levels[level].any[c / 64] |= bit;
+			}
+		}
+	}
+}
@@ -0,0 +1,89 @@
+// Hierarchical bitmap over bit indices [0, numBits).
+// Each level summarizes 64 words of the level below, so searches cost O(log64(numBits)).
+// Words are allocated lazily, so a huge numBits costs nothing until bits are actually set.
+
+#pragma once
+
+#include "core/int_types.h"
+#include "memory/memory_tag.h"
+
+class HierarchicalBitmap
+{
+public:
+	static constexpr uint32 INVALID_INDEX = 0xffffffff;
+
+	HierarchicalBitmap(uint32 inNumBits, EMemoryTag inMemoryTag = EMemoryTag::Etc);
+	~HierarchicalBitmap();
+
+	HierarchicalBitmap(const HierarchicalBitmap&) = delete;
+	HierarchicalBitmap& operator=(const HierarchicalBitmap&) = delete;
+
+	// Copy all bits of src. src.numBits should not be greater than this->numBits.
+	void copyFrom(const HierarchicalBitmap& src);
+
+	bool test(uint32 ix) const;
+	void set(uint32 ix);
+	void clear(uint32 ix);
+
+	// Set or clear [first, first + count).
+	void setRange(uint32 first, uint32 count);
+	void clearRange(uint32 first, uint32 count);
+
+	// true if all bits in [first, first + count) are set.
+	bool isRangeSet(uint32 first, uint32 count) const;
+
+	// Clear all bits and release memory.
+	void reset();
+
+	// All find functions return INVALID_INDEX if not found.
+	uint32 findFirstZero() const { return findNext(0, false); }
+	uint32 findFirstOne() const { return findNext(0, true); }
+	uint32 findLastOne() const;
+	uint32 findNextZero(uint32 from) const { return findNext(from, false); }
+	uint32 findNextOne(uint32 from) const { return findNext(from, true); }
+
+	// First-fit search for 'count' consecutive zero bits.
+	uint32 findZeroRun(uint32 count) const;
+
+	inline uint32 getNumBits() const { return numBits; }
+	inline uint32 getNumSetBits() const { return numSetBits; }
+
+private:
+	static constexpr uint32 MAX_LEVELS = 6; // 64^6 > 2^32
+
+	// Level 0: 'full' holds the bits themselves and 'any' is unused.
+	// Level k > 0: bit b of word w is about word (w * 64 + b) of level (k - 1).
+	//   'full' - the child word has all bits set.
+	//   'any'  - the child word has at least one bit set.
+	struct Level
+	{
+		uint64* full = nullptr;
+		uint64* any = nullptr;
+		uint32 numWords = 0;     // Allocated word count. Missing words are zero.
+		uint32 maxWords = 0;     // Word count to cover all bits.
+	};
+
+	inline uint64 getFull(uint32 level, uint32 w) const
+	{
+		return (w < levels[level].numWords) ? levels[level].full[w] : 0;
+	}
+	inline uint64 getAny(uint32 level, uint32 w) const
+	{
+		if (level == 0) return getFull(0, w);
+		return (w < levels[level].numWords) ? levels[level].any[w] : 0;
+	}
+
+	uint32 findNext(uint32 from, bool bFindOne) const;
+	uint32 descend(uint32 level, uint32 w, bool bFindOne, bool bLowest) const;
+
+	void reserveWords(uint32 level, uint32 wordIx);
+	// Write a level-0 word and propagate summary bits.
+	void writeWord(uint32 w, uint64 newValue);
+	void rebuildSummaries();
+
+	uint32     numBits;
+	uint32     numLevels;
+	uint32     numSetBits = 0;
+	EMemoryTag memoryTag;
+	Level      levels[MAX_LEVELS];
+};
@@ -1,50 +1,241 @@
 #include "memory_tracker.h"
 #include "custom_new_delete.h"
-#include "core/critical_section.h"
+#include "core/int_types.h"
+#include "core/spin_lock.h"
 #include "util/logging.h"
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
 #include <atomic>
-#include <map>
 #include <mutex>
 
 DEFINE_LOG_CATEGORY_STATIC(LogMemory);
 
 // Well... constructors of member variables in MemoryTracker
 // causes infinite loop. Let's make all of them global variables...
+// Everything here is constant-initialized and backed by std::malloc
+// so that nothing re-enters custom new/delete.
 namespace memtrack
 {
-	template<typename T>
-	class allocatorUntracked: public std::allocator<T>
+	// ------------------------------------------------------------
+	// Allocation table: open addressing with linear probing, split into shards.
+
+	struct Entry
+	{
+		uintptr_t  key; // 0 if empty
+		size_t     size;
+		EMemoryTag tag;
+	};
+
+	struct alignas(64) Shard
+	{
+		SpinLock            lock;
+		std::atomic<uint32> count = 0; // Written under lock, may be peeked without lock.
+		uint32              capacity = 0; // Power of two
+		Entry*              entries = nullptr;
+	};
+
+	static constexpr uint32 NUM_SHARDS_LOG2 = 6;
+	static constexpr uint32 NUM_SHARDS = 1 << NUM_SHARDS_LOG2;
+	static constexpr uint32 INITIAL_SHARD_CAPACITY = 256;
+
+	static inline uint64 hashPointer(uintptr_t key)
+	{
+		return (uint64)key * 0x9E3779B97F4A7C15ull;
+	}
+	static inline uint32 getShardIndex(uint64 hash)
+	{
+		return (uint32)(hash >> (64 - NUM_SHARDS_LOG2));
+	}
+	static inline uint32 getSlotIndex(uint64 hash, uint32 capacity)
+	{
+		return (uint32)(hash >> 16) & (capacity - 1);
+	}
+
+	static uint32 findSlot(const Shard& shard, uintptr_t key)
+	{
+		const uint32 mask = shard.capacity - 1;
+		uint32 i = getSlotIndex(hashPointer(key), shard.capacity);
+		while (shard.entries[i].key != 0 && shard.entries[i].key != key)
+		{
+			i = (i + 1) & mask;
+		}
+		return i;
+	}
+
+	static void growShard(Shard& shard)
+	{
+		const uint32 oldCapacity = shard.capacity;
+		Entry* oldEntries = shard.entries;
+
+		shard.capacity = (oldCapacity == 0) ? INITIAL_SHARD_CAPACITY : (oldCapacity * 2);
+		shard.entries = static_cast<Entry*>(std::calloc(shard.capacity, sizeof(Entry)));
+		if (shard.entries == nullptr)
+		{
+			std::abort();
+		}
+
+		for (uint32 i = 0; i < oldCapacity; ++i)
+		{
+			if (oldEntries[i].key != 0)
+			{
+				shard.entries[findSlot(shard, oldEntries[i].key)] = oldEntries[i];
+			}
+		}
+		std::free(oldEntries);
+	}
+
+	// @return true if an existing entry of the same key was replaced.
+	static bool insertEntry(Shard& shard, uintptr_t key, size_t size, EMemoryTag tag, Entry& outReplaced)
+	{
+		// Keep load factor <= 0.5
+		if ((shard.count.load(std::memory_order_relaxed) + 1) * 2 > shard.capacity)
+		{
+			growShard(shard);
+		}
+		Entry& entry = shard.entries[findSlot(shard, key)];
+		const bool bReplaced = (entry.key != 0);
+		if (bReplaced)
+		{
+			outReplaced = entry;
+		}
+		else
+		{
+			shard.count.store(shard.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+		entry = Entry{ key, size, tag };
+		return bReplaced;
+	}
+
+	// Backward shift deletion, so no tombstones are needed.
+	static bool removeEntry(Shard& shard, uintptr_t key, Entry& outEntry)
 	{
-	public:
-		//using value_type = T;
-		//using value_type = std::pair<T, std::pair<size_t, EMemoryTag>>;
-		allocatorUntracked() noexcept {}
+		if (shard.capacity == 0)
+		{
+			return false;
+		}
+		const uint32 mask = shard.capacity - 1;
+		uint32 i = findSlot(shard, key);
+		if (shard.entries[i].key == 0)
+		{
+			return false;
+		}
+		outEntry = shard.entries[i];
+
+		uint32 j = i;
+		while (true)
+		{
+			j = (j + 1) & mask;
+			if (shard.entries[j].key == 0)
+			{
+				break;
+			}
+			// Move entry j into hole i unless its home slot lies cyclically in (i, j].
+			const uint32 home = getSlotIndex(hashPointer(shard.entries[j].key), shard.capacity);
+			const bool bStays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+			if (!bStays)
+			{
+				shard.entries[i] = shard.entries[j];
+				i = j;
+			}
+		}
+		shard.entries[i].key = 0;
+		shard.count.store(shard.count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// ------------------------------------------------------------
+	// Byte counters: each thread owns a slot and only that thread writes to it.
+	// Readers fold all slots. Slots of exited threads are folded into retiredBytes and recycled.
+
+	struct ThreadCounters
+	{
+		std::atomic<int64> bytes[(int)EMemoryTag::Count];
+		ThreadCounters*    next;
+		bool               bInUse;
+	};
 
-		template<class Other>
-		allocatorUntracked(const allocatorUntracked<Other>& _Right) {}
+	static SpinLock           registryLock;
+	static ThreadCounters*    registryHead = nullptr;
+	static std::atomic<int64> retiredBytes[(int)EMemoryTag::Count];
 
-		inline T* allocate(std::size_t n)
+	static thread_local ThreadCounters* tlsCounters = nullptr;
+	static thread_local bool            tlsCountersRetired = false;
+
+	static ThreadCounters* acquireThreadCounters()
+	{
+		std::lock_guard<SpinLock> guard(registryLock);
+		for (ThreadCounters* node = registryHead; node != nullptr; node = node->next)
+		{
+			if (!node->bInUse)
+			{
+				node->bInUse = true;
+				return node;
+			}
+		}
+		ThreadCounters* node = static_cast<ThreadCounters*>(std::calloc(1, sizeof(ThreadCounters)));
+		if (node == nullptr)
 		{
-			return static_cast<T*>(cyseal_private::customMalloc(n * sizeof(T), EMemoryTag::Untracked));
+			std::abort();
 		}
-		inline void deallocate(T* p, std::size_t n) noexcept
+		node->next = registryHead;
+		node->bInUse = true;
+		registryHead = node;
+		return node;
+	}
+
+	static void retireThreadCounters()
+	{
+		if (tlsCounters == nullptr)
 		{
-			cyseal_private::customFree(p);
+			return;
 		}
+		{
+			std::lock_guard<SpinLock> guard(registryLock);
+			for (int i = 0; i < (int)EMemoryTag::Count; ++i)
+			{
+				retiredBytes[i].fetch_add(tlsCounters->bytes[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+				tlsCounters->bytes[i].store(0, std::memory_order_relaxed);
+			}
+			tlsCounters->bInUse = false;
+		}
+		tlsCounters = nullptr;
+		tlsCountersRetired = true;
+	}
+
+	struct ThreadCountersRetirer
+	{
+		~ThreadCountersRetirer() { retireThreadCounters(); }
 	};
-	using TrackerKey = void*;
-	using TrackerValue = std::pair<size_t, EMemoryTag>;
-	using TrackerTable = std::map<TrackerKey, TrackerValue, std::less<TrackerKey>, allocatorUntracked<std::pair<const TrackerKey, TrackerValue>>>;
+
+	static inline void addBytes(EMemoryTag tag, int64 delta)
+	{
+		if (tlsCounters == nullptr)
+		{
+			if (tlsCountersRetired)
+			{
+				// Allocations during thread shutdown go straight to the shared counter.
+				retiredBytes[(int)tag].fetch_add(delta, std::memory_order_relaxed);
+				return;
+			}
+			tlsCounters = acquireThreadCounters();
+			static thread_local ThreadCountersRetirer retirer;
+			(void)retirer;
+		}
+		std::atomic<int64>& counter = tlsCounters->bytes[(int)tag];
+		counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+	}
+
+	// ------------------------------------------------------------
 
 	static MemoryTracker*      g_instance = nullptr;
 	static std::once_flag      onceFlag;
 
-	static bool                bDestroyed = false;
-	static std::atomic<size_t> totalAllocated[(int)EMemoryTag::Count];
-	static TrackerTable*       trackerTable;
-	static CriticalSection*    trackerTableCS;
+	static std::atomic<bool>   bDestroyed = false;
+	static std::atomic<bool>   bEnabled = true;
+	static Shard               shards[NUM_SHARDS];
 }
 
 MemoryTracker& MemoryTracker::get()
@@ -68,75 +259,119 @@ MemoryTracker::~MemoryTracker()
 void MemoryTracker::initialize()
 {
 	memtrack::bDestroyed = false;
-	for (int i = 0; i < (int)EMemoryTag::Count; ++i)
-	{
-		memtrack::totalAllocated[i] = 0;
-	}
-	memtrack::trackerTable = new(EMemoryTag::Untracked) memtrack::TrackerTable();
-	memtrack::trackerTableCS = new(EMemoryTag::Untracked) CriticalSection();
 }
 
 void MemoryTracker::terminate()
 {
-	if (memtrack::bDestroyed)
+	if (memtrack::bDestroyed.exchange(true))
 	{
 		return;
 	}
-	memtrack::bDestroyed = true;
 
-	delete memtrack::trackerTable;
-	delete memtrack::trackerTableCS;
+	for (memtrack::Shard& shard : memtrack::shards)
+	{
+		std::lock_guard<SpinLock> guard(shard.lock);
+		std::free(shard.entries);
+		shard.entries = nullptr;
+		shard.capacity = 0;
+		shard.count = 0;
+	}
 }
 
 void MemoryTracker::increase(void* ptr, size_t sz, EMemoryTag tag)
 {
-	memtrack::totalAllocated[(int)tag] += sz;
+	if (!memtrack::bEnabled.load(std::memory_order_relaxed) || memtrack::bDestroyed.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	const uintptr_t key = reinterpret_cast<uintptr_t>(ptr);
+	memtrack::Shard& shard = memtrack::shards[memtrack::getShardIndex(memtrack::hashPointer(key))];
 
-	memtrack::trackerTableCS->Enter();
-	memtrack::trackerTable->insert(std::pair{ ptr, std::pair{ sz, tag } });
-	memtrack::trackerTableCS->Leave();
+	memtrack::Entry replaced;
+	bool bReplaced;
+	{
+		std::lock_guard<SpinLock> guard(shard.lock);
+		bReplaced = memtrack::insertEntry(shard, key, sz, tag, replaced);
+	}
+
+	// Stale entry of a pointer that was released without custom delete.
+	if (bReplaced)
+	{
+		memtrack::addBytes(replaced.tag, -(int64)replaced.size);
+	}
+	memtrack::addBytes(tag, (int64)sz);
 }
 
 void MemoryTracker::decrease(void* ptr)
 {
-	if (memtrack::bDestroyed)
+	if (memtrack::bDestroyed.load(std::memory_order_relaxed))
 	{
 		return;
 	}
 
-	size_t sz;
-	EMemoryTag tag;
-	bool found = false;
+	const uintptr_t key = reinterpret_cast<uintptr_t>(ptr);
+	memtrack::Shard& shard = memtrack::shards[memtrack::getShardIndex(memtrack::hashPointer(key))];
+	if (shard.count.load(std::memory_order_relaxed) == 0)
+	{
+		// Untracked pointer, or tracking has been disabled from the start.
+		return;
+	}
 
-	memtrack::trackerTableCS->Enter();
-	auto it = memtrack::trackerTable->find(ptr);
-	if (it != memtrack::trackerTable->end())
+	memtrack::Entry entry;
+	bool found;
 	{
-		found = true;
-		sz = it->second.first;
-		tag = it->second.second;
-		memtrack::trackerTable->erase(it);
+		std::lock_guard<SpinLock> guard(shard.lock);
+		found = memtrack::removeEntry(shard, key, entry);
 	}
-	memtrack::trackerTableCS->Leave();
 
 	if (found)
 	{
-		memtrack::totalAllocated[(int)tag] -= sz;
+		memtrack::addBytes(entry.tag, -(int64)entry.size);
 	}
 }
 
+void MemoryTracker::setEnabled(bool bEnabled)
+{
+	memtrack::bEnabled.store(bEnabled);
+}
+
+bool MemoryTracker::isEnabled() const
+{
+	return memtrack::bEnabled.load();
+}
+
 void MemoryTracker::report()
 {
 	for (int i = 0; i < (int)EMemoryTag::Count; ++i)
 	{
-		size_t total = memtrack::totalAllocated[i];
+		size_t total = getTotalBytes((EMemoryTag)i);
 		CYLOG(LogMemory, Log, L"tag = %d, total size = %zu", i, total);
 		//std::printf("tag = %d, total size = %zu\n", i, total);
 	}
+	CYLOG(LogMemory, Log, L"live allocations = %zu", getNumAllocations());
 }
 
 size_t MemoryTracker::getTotalBytes(EMemoryTag tag) const
 {
-	size_t total = memtrack::totalAllocated[(int)tag];
+	int64 total = memtrack::retiredBytes[(int)tag].load(std::memory_order_relaxed);
+	{
+		std::lock_guard<SpinLock> guard(memtrack::registryLock);
+		for (memtrack::ThreadCounters* node = memtrack::registryHead; node != nullptr; node = node->next)
+		{
+			total += node->bytes[(int)tag].load(std::memory_order_relaxed);
+		}
+	}
+	// Per-thread values are read at slightly different times, so a concurrent free may be seen before its alloc.
+	return (total > 0) ? (size_t)total : 0;
+}
+
+size_t MemoryTracker::getNumAllocations() const
+{
+	size_t total = 0;
+	for (const memtrack::Shard& shard : memtrack::shards)
+	{
+		total += shard.count.load(std::memory_order_relaxed);
+	}
 	return total;
 }
@@ -2,6 +2,11 @@
 
 #include "memory_tag.h"
 
+#include <cstddef>
+
+// Tracks live allocations made by custom new/delete.
+// - Allocation table is split into lock-striped shards so threads rarely contend.
+// - Byte counters are per-thread and folded only when queried.
 class MemoryTracker
 {
 public:
@@ -18,6 +23,12 @@ public:
 	void increase(void* ptr, size_t sz, EMemoryTag tag);
 	void decrease(void* ptr);
 
+	// Allocations made while disabled are not tracked.
+	// Tracked allocations are still untracked correctly when freed while disabled.
+	void setEnabled(bool bEnabled);
+	bool isEnabled() const;
+
 	void report();
 	size_t getTotalBytes(EMemoryTag tag) const;
+	size_t getNumAllocations() const;
 };
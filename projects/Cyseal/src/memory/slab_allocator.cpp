@@ -0,0 +1,351 @@
+#include "slab_allocator.h"
+#include "core/assertion.h"
+#include "core/platform.h"
+#include "core/spin_lock.h"
+
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <array>
+#include <algorithm>
+
+#if PLATFORM_WINDOWS
+	#include <malloc.h>
+#endif
+
+// Like memory_tracker.cpp, everything here is constant-initialized
+// and backed by system allocation functions so that nothing re-enters custom new/delete.
+namespace slab
+{
+	// ------------------------------------------------------------
+	// Size classes
+
+	static constexpr uint32 CLASS_SIZES[] = {
+		16,   32,   48,   64,   80,   96,   112,  128,
+		160,  192,  224,  256,  320,  384,  448,  512,
+		640,  768,  896,  1024, 1280, 1536, 1792, 2048,
+		2560, 3072, 3584, 4096,
+	};
+	static constexpr uint32 NUM_CLASSES = (uint32)(sizeof(CLASS_SIZES) / sizeof(CLASS_SIZES[0]));
+	static_assert(CLASS_SIZES[NUM_CLASSES - 1] == SlabAllocator::MAX_BLOCK_SIZE);
+
+	// sz <= 1024: indexed by (sz + 15) / 16, otherwise by (sz + 127) / 128.
+	static constexpr std::array<uint8, 65> SMALL_LOOKUP = []() {
+		std::array<uint8, 65> table{};
+		for (uint32 i = 0, c = 0; i <= 64; ++i)
+		{
+			while (CLASS_SIZES[c] < i * 16) ++c;
+			table[i] = (uint8)c;
+		}
+		return table;
+	}();
+	static constexpr std::array<uint8, 33> LARGE_LOOKUP = []() {
+		std::array<uint8, 33> table{};
+		for (uint32 i = 0, c = 0; i <= 32; ++i)
+		{
+			while (CLASS_SIZES[c] < i * 128) ++c;
+			table[i] = (uint8)c;
+		}
+		return table;
+	}();
+
+	static inline uint32 getSizeClass(size_t sz)
+	{
+		return (sz <= 1024) ? SMALL_LOOKUP[(sz + 15) / 16] : LARGE_LOOKUP[(sz + 127) / 128];
+	}
+
+	// Free blocks are linked through their first bytes.
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	// ------------------------------------------------------------
+	// Page map: span address -> (size class + 1), 0 if not a slab span.
+
+	static constexpr uint32 SPAN_SHIFT = 16;
+	static constexpr uint32 LEAF_BITS = 16;
+	static constexpr uint32 ROOT_BITS = 48 - SPAN_SHIFT - LEAF_BITS;
+	static_assert((1 << SPAN_SHIFT) == SlabAllocator::SPAN_SIZE);
+
+	static std::atomic<uint8*> pageMapRoot[1 << ROOT_BITS];
+
+	static inline uint8* findLeaf(uintptr_t addr)
+	{
+		if ((addr >> 48) != 0) return nullptr;
+		return pageMapRoot[addr >> (SPAN_SHIFT + LEAF_BITS)].load(std::memory_order_acquire);
+	}
+
+	static void registerSpan(uint8* span, uint32 sizeClass)
+	{
+		const uintptr_t addr = reinterpret_cast<uintptr_t>(span);
+		CHECK((addr >> 48) == 0);
+		std::atomic<uint8*>& root = pageMapRoot[addr >> (SPAN_SHIFT + LEAF_BITS)];
+		uint8* leaf = root.load(std::memory_order_acquire);
+		if (leaf == nullptr)
+		{
+			uint8* newLeaf = static_cast<uint8*>(std::calloc(1 << LEAF_BITS, 1));
+			if (newLeaf == nullptr) std::abort();
+			if (root.compare_exchange_strong(leaf, newLeaf, std::memory_order_acq_rel))
+			{
+				leaf = newLeaf;
+			}
+			else
+			{
+				std::free(newLeaf);
+			}
+		}
+		leaf[(addr >> SPAN_SHIFT) & ((1 << LEAF_BITS) - 1)] = (uint8)(sizeClass + 1);
+	}
+
+	// ------------------------------------------------------------
+	// Span reservoir
+
+	static constexpr uint32 SPANS_PER_RESERVE = 16;
+
+	static SpinLock            reservoirLock;
+	static uint8*              reservoirCursor = nullptr;
+	static uint32              reservoirRemaining = 0;
+	static std::atomic<size_t> reservedBytes = 0;
+	static std::atomic<size_t> numSpans = 0;
+
+	static uint8* allocateSpan(uint32 sizeClass)
+	{
+		uint8* span;
+		{
+			std::lock_guard<SpinLock> guard(reservoirLock);
+			if (reservoirRemaining == 0)
+			{
+				const size_t bytes = SPANS_PER_RESERVE * SlabAllocator::SPAN_SIZE;
+#if PLATFORM_WINDOWS
+				reservoirCursor = static_cast<uint8*>(_aligned_malloc(bytes, SlabAllocator::SPAN_SIZE));
+#else
+				reservoirCursor = static_cast<uint8*>(std::aligned_alloc(SlabAllocator::SPAN_SIZE, bytes));
+#endif
+				if (reservoirCursor == nullptr) std::abort();
+				reservoirRemaining = SPANS_PER_RESERVE;
+				reservedBytes.fetch_add(bytes, std::memory_order_relaxed);
+			}
+			span = reservoirCursor;
+			reservoirCursor += SlabAllocator::SPAN_SIZE;
+			--reservoirRemaining;
+		}
+		registerSpan(span, sizeClass);
+		numSpans.fetch_add(1, std::memory_order_relaxed);
+		return span;
+	}
+
+	// ------------------------------------------------------------
+	// Central free lists
+
+	struct alignas(64) CentralList
+	{
+		SpinLock   lock;
+		FreeBlock* freeList = nullptr;
+		size_t     numFree = 0;
+		size_t     numCarved = 0;
+		uint8*     carveCursor = nullptr;
+		uint8*     carveEnd = nullptr;
+	};
+	static CentralList centralLists[NUM_CLASSES];
+
+	// Number of blocks moved between a thread cache and the central list at once.
+	static inline uint32 getBatchCount(uint32 sizeClass)
+	{
+		return std::clamp(16384u / CLASS_SIZES[sizeClass], 4u, 64u);
+	}
+
+	// Pop up to 'count' blocks into a linked list. Returns at least one block.
+	static uint32 fetchFromCentral(uint32 sizeClass, uint32 count, FreeBlock*& outHead)
+	{
+		CentralList& central = centralLists[sizeClass];
+		const uint32 blockSize = CLASS_SIZES[sizeClass];
+
+		std::lock_guard<SpinLock> guard(central.lock);
+		FreeBlock* head = nullptr;
+		uint32 fetched = 0;
+		while (fetched < count && central.freeList != nullptr)
+		{
+			FreeBlock* block = central.freeList;
+			central.freeList = block->next;
+			block->next = head;
+			head = block;
+			++fetched;
+		}
+		central.numFree -= fetched;
+
+		while (fetched < count)
+		{
+			if (central.carveCursor == central.carveEnd)
+			{
+				if (fetched > 0) break;
+				central.carveCursor = allocateSpan(sizeClass);
+				central.carveEnd = central.carveCursor + (SlabAllocator::SPAN_SIZE / blockSize) * blockSize;
+			}
+			FreeBlock* block = reinterpret_cast<FreeBlock*>(central.carveCursor);
+			central.carveCursor += blockSize;
+			block->next = head;
+			head = block;
+			++fetched;
+			++central.numCarved;
+		}
+
+		outHead = head;
+		return fetched;
+	}
+
+	// Push a linked list of 'count' blocks, whose last node is 'tail'.
+	static void returnToCentral(uint32 sizeClass, FreeBlock* head, FreeBlock* tail, uint32 count)
+	{
+		CentralList& central = centralLists[sizeClass];
+		std::lock_guard<SpinLock> guard(central.lock);
+		tail->next = central.freeList;
+		central.freeList = head;
+		central.numFree += count;
+	}
+
+	// ------------------------------------------------------------
+	// Thread caches
+
+	struct ThreadCache
+	{
+		FreeBlock* heads[NUM_CLASSES];
+		uint32     counts[NUM_CLASSES];
+	};
+	static thread_local ThreadCache tlsCache;
+	static thread_local bool        tlsCacheActive = false;
+	static thread_local bool        tlsCacheRetired = false;
+
+	static void flushClass(uint32 sizeClass, uint32 keepCount)
+	{
+		ThreadCache& cache = tlsCache;
+		uint32 releaseCount = cache.counts[sizeClass] - keepCount;
+		if (releaseCount == 0) return;
+
+		FreeBlock* head = cache.heads[sizeClass];
+		FreeBlock* tail = head;
+		for (uint32 i = 1; i < releaseCount; ++i) tail = tail->next;
+		cache.heads[sizeClass] = tail->next;
+		cache.counts[sizeClass] = keepCount;
+		returnToCentral(sizeClass, head, tail, releaseCount);
+	}
+
+	static void flushAll()
+	{
+		for (uint32 c = 0; c < NUM_CLASSES; ++c)
+		{
+			flushClass(c, 0);
+		}
+	}
+
+	struct ThreadCacheRetirer
+	{
+		~ThreadCacheRetirer()
+		{
+			flushAll();
+			tlsCacheRetired = true;
+		}
+	};
+
+	// @return false if the thread is exiting and the cache must not be used.
+	static inline bool acquireThreadCache()
+	{
+		if (tlsCacheRetired) return false;
+		if (!tlsCacheActive)
+		{
+			tlsCacheActive = true;
+			static thread_local ThreadCacheRetirer retirer;
+			(void)retirer;
+		}
+		return true;
+	}
+}
+
+void* SlabAllocator::alloc(size_t sz)
+{
+	CHECK(sz > 0 && sz <= MAX_BLOCK_SIZE);
+	const uint32 sizeClass = slab::getSizeClass(sz);
+
+	if (!slab::acquireThreadCache())
+	{
+		slab::FreeBlock* block;
+		slab::fetchFromCentral(sizeClass, 1, block);
+		return block;
+	}
+
+	slab::ThreadCache& cache = slab::tlsCache;
+	if (cache.heads[sizeClass] == nullptr)
+	{
+		cache.counts[sizeClass] = slab::fetchFromCentral(sizeClass, slab::getBatchCount(sizeClass), cache.heads[sizeClass]);
+	}
+	slab::FreeBlock* block = cache.heads[sizeClass];
+	cache.heads[sizeClass] = block->next;
+	cache.counts[sizeClass] -= 1;
+	return block;
+}
+
+void SlabAllocator::free(void* ptr)
+{
+	const uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+	uint8* leaf = slab::findLeaf(addr);
+	CHECK(leaf != nullptr);
+	const uint32 sizeClass = (uint32)leaf[(addr >> slab::SPAN_SHIFT) & ((1 << slab::LEAF_BITS) - 1)] - 1;
+	CHECK(sizeClass < slab::NUM_CLASSES);
+
+	slab::FreeBlock* block = static_cast<slab::FreeBlock*>(ptr);
+	if (!slab::acquireThreadCache())
+	{
+		slab::returnToCentral(sizeClass, block, block, 1);
+		return;
+	}
+
+	slab::ThreadCache& cache = slab::tlsCache;
+	block->next = cache.heads[sizeClass];
+	cache.heads[sizeClass] = block;
+	cache.counts[sizeClass] += 1;
+
+	// Keep one batch and return the rest, so a producer/consumer thread pair doesn't hoard blocks.
+	const uint32 batch = slab::getBatchCount(sizeClass);
+	if (cache.counts[sizeClass] >= 2 * batch)
+	{
+		slab::flushClass(sizeClass, batch);
+	}
+}
+
+bool SlabAllocator::owns(const void* ptr)
+{
+	const uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+	const uint8* leaf = slab::findLeaf(addr);
+	return leaf != nullptr && leaf[(addr >> slab::SPAN_SHIFT) & ((1 << slab::LEAF_BITS) - 1)] != 0;
+}
+
+size_t SlabAllocator::getBlockSize(size_t sz)
+{
+	CHECK(sz > 0 && sz <= MAX_BLOCK_SIZE);
+	return slab::CLASS_SIZES[slab::getSizeClass(sz)];
+}
+
+void SlabAllocator::flushThreadCache()
+{
+	if (slab::tlsCacheActive && !slab::tlsCacheRetired)
+	{
+		slab::flushAll();
+	}
+}
+
+SlabAllocator::Stats SlabAllocator::getStats()
+{
+	Stats stats{
+		.numSpans       = slab::numSpans.load(std::memory_order_relaxed),
+		.reservedBytes  = slab::reservedBytes.load(std::memory_order_relaxed),
+		.usedBlockBytes = 0,
+	};
+	for (uint32 c = 0; c < slab::NUM_CLASSES; ++c)
+	{
+		slab::CentralList& central = slab::centralLists[c];
+		std::lock_guard<SpinLock> guard(central.lock);
+		stats.usedBlockBytes += (central.numCarved - central.numFree) * slab::CLASS_SIZES[c];
+	}
+	return stats;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "core/int_types.h"
+
+#include <cstddef>
+
+// Size-class slab allocator for small objects, used by custom new/delete.
+// - Blocks of the same size class are carved from 64 KiB spans.
+// - Each thread caches free blocks per size class, so most alloc/free don't take any lock.
+// - A two-level radix map over span addresses tells if a pointer belongs to a slab,
+//   so operator delete needs no header in front of each block.
+// Spans are never returned to the system.
+class SlabAllocator
+{
+public:
+	static constexpr size_t MAX_BLOCK_SIZE = 4096;
+	static constexpr size_t SPAN_SIZE = 64 * 1024;
+
+	struct Stats
+	{
+		size_t numSpans;       // Spans assigned to size classes.
+		size_t reservedBytes;  // Memory taken from the system, including unassigned spans.
+		size_t usedBlockBytes; // Block bytes not in central free lists. (live + cached by threads)
+	};
+
+	// @param sz Should be in (0, MAX_BLOCK_SIZE].
+	static void* alloc(size_t sz);
+
+	// @param ptr Should be a pointer that owns() returns true for.
+	static void free(void* ptr);
+
+	static bool owns(const void* ptr);
+
+	// Actual block size that alloc(sz) uses.
+	static size_t getBlockSize(size_t sz);
+
+	// Return blocks cached by the calling thread to central lists.
+	static void flushThreadCache();
+
+	static Stats getStats();
+};
@@ -72,6 +72,7 @@ void BasePass::renderBasePass(RenderCommandList* commandList, const FrameInfo& f
 		.camera           = passInput.camera,
 		.indirectDrawMode = passInput.indirectDrawMode,
 		.bGpuCulling      = passInput.bGPUCulling,
+		.drawBuckets      = passInput.drawBuckets,
 		.gpuScene         = passInput.gpuScene,
 		.gpuCulling       = passInput.gpuCulling,
 		.psoPermutation   = &pipelinePermutation,
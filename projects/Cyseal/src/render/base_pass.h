@@ -17,15 +17,16 @@ class GPUCulling;
 
 struct BasePassInput
 {
-	const SceneProxy*      scene;
-	const Camera*          camera;
-	EIndirectDrawMode      indirectDrawMode;
-	bool                   bGPUCulling;
-
-	ConstantBufferView*    sceneUniformBuffer;
-	GPUScene*              gpuScene;
-	GPUCulling*            gpuCulling;
-	ShaderResourceView*    shadowMaskSRV;
+	const SceneProxy*            scene;
+	const Camera*                camera;
+	EIndirectDrawMode            indirectDrawMode;
+	bool                         bGPUCulling;
+	const StaticMeshDrawBuckets* drawBuckets;
+
+	ConstantBufferView*          sceneUniformBuffer;
+	GPUScene*                    gpuScene;
+	GPUCulling*                  gpuCulling;
+	ShaderResourceView*          shadowMaskSRV;
 };
 
 // Render direct lighting + gbuffers.
@@ -80,6 +80,7 @@ void DepthPrepass::renderDepthPrepass(RenderCommandList* commandList, const Fram
 		.camera           = passInput.camera,
 		.indirectDrawMode = passInput.indirectDrawMode,
 		.bGpuCulling      = passInput.bGPUCulling,
+		.drawBuckets      = passInput.drawBuckets,
 		.gpuScene         = passInput.gpuScene,
 		.gpuCulling       = passInput.gpuCulling,
 		.psoPermutation   = passInput.bVisibilityBuffer ? &visPipelinePermutation : &pipelinePermutation,
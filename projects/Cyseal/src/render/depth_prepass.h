@@ -14,15 +14,16 @@ class GPUCulling;
 
 struct DepthPrepassInput
 {
-	const SceneProxy*      scene;
-	const Camera*          camera;
-	EIndirectDrawMode      indirectDrawMode;
-	bool                   bGPUCulling;
-	bool                   bVisibilityBuffer;
-
-	ConstantBufferView*    sceneUniformBuffer;
-	GPUScene*              gpuScene;
-	GPUCulling*            gpuCulling;
+	const SceneProxy*            scene;
+	const Camera*                camera;
+	EIndirectDrawMode            indirectDrawMode;
+	bool                         bGPUCulling;
+	bool                         bVisibilityBuffer;
+	const StaticMeshDrawBuckets* drawBuckets;
+
+	ConstantBufferView*          sceneUniformBuffer;
+	GPUScene*                    gpuScene;
+	GPUCulling*                  gpuCulling;
 };
 
 // Render scene dpeth.
@@ -3,6 +3,7 @@
 #include "rhi/render_device.h"
 #include "rhi/render_command.h"
 #include "rhi/gpu_resource_binding.h"
+#include "rhi/upload_ring.h"
 #include "world/camera.h"
 #include "util/logging.h"
 
@@ -57,7 +58,7 @@ void GPUCulling::cullDrawCommands(RenderCommandList* commandList, const FrameInf
 	auto drawCounterBufferUAV        = passInput.culledDrawCounterBufferUAV;
 
 	uint32 zeroValue = 0;
-	drawCounterBuffer->singleWriteToGPU(commandList, &zeroValue, sizeof(zeroValue), 0);
+	frameInfo.uploadRing->writeToBuffer(commandList, &zeroValue, sizeof(zeroValue), drawCounterBuffer, 0);
 
 	BufferBarrierAuto barriersBefore[] = {
 		{ EBarrierSync::COMPUTE_SHADING, EBarrierAccess::SHADER_RESOURCE, indirectDrawBuffer },
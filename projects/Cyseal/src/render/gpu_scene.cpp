@@ -1,5 +1,6 @@
 #include "gpu_scene.h"
 #include "gpu_scene_command.h"
+#include "gpu_scene_command_compaction.h"
 #include "static_mesh.h"
 #include "material.h"
 #include "rhi/gpu_resource.h"
@@ -8,6 +9,8 @@
 #include "rhi/render_command.h"
 #include "rhi/texture_manager.h"
 #include "rhi/vertex_buffer_pool.h"
+#include "rhi/upload_ring.h"
+#include "memory/frame_allocator.h"
 #include "core/matrix.h"
 #include "world/scene_proxy.h"
 #include "world/gpu_resource_asset.h"
@@ -80,6 +83,9 @@ void GPUScene::initializeSceneBufferPipeline()
 	gpuSceneAllocCommandBufferSRV.initialize(maxFramesInFlight);
 	gpuSceneUpdateCommandBufferSRV.initialize(maxFramesInFlight);
 
+	gpuSceneTransformDataBuffer.initialize(maxFramesInFlight);
+	gpuSceneTransformDataSRV.initialize(maxFramesInFlight);
+
 	passDescriptor.initialize(L"GPUScene", maxFramesInFlight, 0);
 
 	// Shaders
@@ -182,6 +188,11 @@ void GPUScene::renderGPUScene(RenderCommandList* commandList, const FrameInfo& f
 		maxElements = scene->gpuSceneItemMaxValidIndex + 1;
 	}
 
+	// Sections of a mesh occupy consecutive items, so evicts and updates are uploaded per mesh.
+	coalesceGPUSceneEvictCommands(scene->gpuSceneEvictCommands, evictRangeCommands);
+	packGPUSceneUpdateCommands(scene->gpuSceneUpdateCommands, passInput.bQuantizeTransforms,
+		packedUpdateCommands, packedTransformData);
+
 	resizeGPUSceneBuffer(commandList, maxElements);
 	resizeGPUSceneCommandBuffers(frameInfo, scene);
 
@@ -201,8 +212,8 @@ void GPUScene::generateDrawcalls(RenderCommandList* commandList, const FrameInfo
 
 	resizeDrawcallBuffer(commandList, passInput.scene);
 
-	std::vector<uint32> zeroCounters(numPermutations, 0);
-	drawcallCounterBuffer->singleWriteToGPU(commandList, zeroCounters.data(), (uint32)(sizeof(uint32) * zeroCounters.size()), 0);
+	LinearVector<uint32> zeroCounters(numPermutations, 0, LinearStlAllocator<uint32>(frameInfo.frameAllocator));
+	frameInfo.uploadRing->writeToBuffer(commandList, zeroCounters.data(), sizeof(uint32) * zeroCounters.size(), drawcallCounterBuffer.get(), 0);
 
 	// Calculate drawID offsets.
 	drawIDOffsets.resize(numPermutations, 0);
@@ -219,7 +230,7 @@ void GPUScene::generateDrawcalls(RenderCommandList* commandList, const FrameInfo
 		return;
 	}
 
-	drawcallOffsetBuffer->singleWriteToGPU(commandList, drawIDOffsets.data(), (uint32)(sizeof(uint32) * drawIDOffsets.size()), 0);
+	frameInfo.uploadRing->writeToBuffer(commandList, drawIDOffsets.data(), sizeof(uint32) * drawIDOffsets.size(), drawcallOffsetBuffer.get(), 0);
 
 	DrawcallPassUniform passUniformData{
 		.vertexBufferPoolAddress = gVertexBufferPool->internal_getPoolBuffer()->internal_getGPUVirtualAddress(),
@@ -375,7 +386,7 @@ void GPUScene::resizeGPUSceneBuffer(RenderCommandList* commandList, uint32 maxEl
 void GPUScene::resizeGPUSceneCommandBuffers(const FrameInfo& frameInfo, const SceneProxy* scene)
 {
 	auto fn = [device = this->device](UniquePtr<Buffer>& buffer, UniquePtr<ShaderResourceView>& srv,
-		size_t stride, size_t count, const wchar_t* debugName)
+		size_t stride, size_t count, const wchar_t* debugName, bool bRawView)
 	{
 		if (count == 0)
 		{
@@ -390,19 +401,19 @@ void GPUScene::resizeGPUSceneCommandBuffers(const FrameInfo& frameInfo, const Sc
 				BufferCreateParams{
 					.sizeInBytes = stride * count,
 					.alignment   = 0,
-					.accessFlags = EBufferAccessFlags::CPU_WRITE | EBufferAccessFlags::SRV
+					.accessFlags = EBufferAccessFlags::COPY_DST | EBufferAccessFlags::SRV
 				}
 			));
 			buffer->setDebugName(debugName);
 
 			ShaderResourceViewDesc srvDesc{
-				.format        = EPixelFormat::UNKNOWN,
+				.format        = bRawView ? EPixelFormat::R32_TYPELESS : EPixelFormat::UNKNOWN,
 				.viewDimension = ESRVDimension::Buffer,
 				.buffer        = BufferSRVDesc{
 					.firstElement        = 0,
 					.numElements         = (uint32)count,
-					.structureByteStride = (uint32)stride,
-					.flags               = EBufferSRVFlags::None,
+					.structureByteStride = bRawView ? 0 : (uint32)stride,
+					.flags               = bRawView ? EBufferSRVFlags::Raw : EBufferSRVFlags::None,
 				}
 			};
 			srv = UniquePtr<ShaderResourceView>(device->createSRV(buffer.get(), srvDesc));
@@ -413,15 +424,19 @@ void GPUScene::resizeGPUSceneCommandBuffers(const FrameInfo& frameInfo, const Sc
 
 	swprintf_s(debugName, L"Buffer_GPUSceneEvictCommand_%u", frameInfo.frameIndex);
 	fn(gpuSceneEvictCommandBuffer[frameInfo.frameIndex], gpuSceneEvictCommandBufferSRV[frameInfo.frameIndex],
-		sizeof(GPUSceneEvictCommand), scene->gpuSceneEvictCommands.size(), debugName);
+		sizeof(GPUSceneEvictRangeCommand), evictRangeCommands.size(), debugName, false);
 
 	swprintf_s(debugName, L"Buffer_GPUSceneAllocCommand_%u", frameInfo.frameIndex);
 	fn(gpuSceneAllocCommandBuffer[frameInfo.frameIndex], gpuSceneAllocCommandBufferSRV[frameInfo.frameIndex],
-		sizeof(GPUSceneAllocCommand), scene->gpuSceneAllocCommands.size(), debugName);
+		sizeof(GPUSceneAllocCommand), scene->gpuSceneAllocCommands.size(), debugName, false);
 
 	swprintf_s(debugName, L"Buffer_GPUSceneUpdateCommand_%u", frameInfo.frameIndex);
 	fn(gpuSceneUpdateCommandBuffer[frameInfo.frameIndex], gpuSceneUpdateCommandBufferSRV[frameInfo.frameIndex],
-		sizeof(GPUSceneUpdateCommand), scene->gpuSceneUpdateCommands.size(), debugName);
+		sizeof(GPUScenePackedUpdateCommand), packedUpdateCommands.size(), debugName, false);
+
+	swprintf_s(debugName, L"Buffer_GPUSceneTransformData_%u", frameInfo.frameIndex);
+	fn(gpuSceneTransformDataBuffer[frameInfo.frameIndex], gpuSceneTransformDataSRV[frameInfo.frameIndex],
+		sizeof(uint32), packedTransformData.size(), debugName, true);
 }
 
 void GPUScene::executeGPUSceneCommands(RenderCommandList* commandList, const FrameInfo& frameInfo, const SceneProxy* scene)
@@ -435,6 +450,7 @@ void GPUScene::executeGPUSceneCommands(RenderCommandList* commandList, const Fra
 		gpuSceneEvictCommandBuffer.at(frameInfo.frameIndex),
 		gpuSceneAllocCommandBuffer.at(frameInfo.frameIndex),
 		gpuSceneUpdateCommandBuffer.at(frameInfo.frameIndex),
+		gpuSceneTransformDataBuffer.at(frameInfo.frameIndex),
 	};
 	for (size_t i = 0; i < _countof(buffers); ++i)
 	{
@@ -447,17 +463,34 @@ void GPUScene::executeGPUSceneCommands(RenderCommandList* commandList, const Fra
 		uint32 requiredVolatiles = 0;
 		requiredVolatiles += 1; // gpuSceneBuffer
 		requiredVolatiles += 1; // commandBuffer
-		passDescriptor.resizeDescriptorHeap(frameInfo, requiredVolatiles * 3);
+		passDescriptor.resizeDescriptorHeap(frameInfo, requiredVolatiles * 3 + 1); // +1 for transformData
+	}
+
+	if (packedTransformData.size() > 0)
+	{
+		Buffer* transformDataBuffer = gpuSceneTransformDataBuffer.at(frameInfo.frameIndex);
+		frameInfo.uploadRing->writeToBuffer(
+			commandList,
+			packedTransformData.data(),
+			sizeof(uint32) * packedTransformData.size(),
+			transformDataBuffer,
+			0);
+
+		BufferBarrierAuto cpuWriteBarrier{
+			EBarrierSync::COMPUTE_SHADING, EBarrierAccess::SHADER_RESOURCE, transformDataBuffer
+		};
+		commandList->barrierAuto(1, &cpuWriteBarrier, 0, nullptr, 0, nullptr);
 	}
 
 	auto sceneBufferUAV = gpuSceneBufferUAV.get();
 	auto descriptorHeap = passDescriptor.getDescriptorHeap(frameInfo);
 	DescriptorIndexTracker tracker{};
 
-	auto fn = [commandList, descriptorHeap, sceneBufferUAV, &tracker]<typename TCommandType>(
+	auto fn = [commandList, uploadRing = frameInfo.uploadRing, descriptorHeap, sceneBufferUAV, &tracker]<typename TCommandType>(
 		const std::vector<TCommandType>& sceneCommands,
 		Buffer*                          sceneCommandBuffer,
 		ShaderResourceView*              sceneCommandSRV,
+		ShaderResourceView*              transformDataSRV,
 		ComputePipelineState*            pipelineState,
 		const char*                      drawEventName)
 	{
@@ -468,10 +501,11 @@ void GPUScene::executeGPUSceneCommands(RenderCommandList* commandList, const Fra
 			sprintf_s(eventString, "%s (count=%u)", drawEventName, count);
 			SCOPED_DRAW_EVENT_STRING(commandList, eventString);
 
-			sceneCommandBuffer->singleWriteToGPU(
+			uploadRing->writeToBuffer(
 				commandList,
-				(void*)sceneCommands.data(),
-				(uint32)(sizeof(sceneCommands[0]) * count),
+				sceneCommands.data(),
+				sizeof(sceneCommands[0]) * count,
+				sceneCommandBuffer,
 				0);
 
 			BufferBarrierAuto cpuWriteBarrier{
@@ -483,6 +517,10 @@ void GPUScene::executeGPUSceneCommands(RenderCommandList* commandList, const Fra
 			SPT.pushConstant("pushConstants", count);
 			SPT.rwStructuredBuffer("gpuSceneBuffer", sceneBufferUAV);
 			SPT.structuredBuffer("commandBuffer", sceneCommandSRV);
+			if (transformDataSRV != nullptr)
+			{
+				SPT.byteAddressBuffer("transformData", transformDataSRV);
+			}
 
 			commandList->setComputePipelineState(pipelineState);
 			commandList->bindComputeShaderParameters(pipelineState, &SPT, descriptorHeap, &tracker);
@@ -497,14 +535,14 @@ void GPUScene::executeGPUSceneCommands(RenderCommandList* commandList, const Fra
 		}
 	};
 
-	fn(scene->gpuSceneEvictCommands, gpuSceneEvictCommandBuffer.at(frameInfo.frameIndex),
-		gpuSceneEvictCommandBufferSRV.at(frameInfo.frameIndex), evictPipelineState.get(),
+	fn(evictRangeCommands, gpuSceneEvictCommandBuffer.at(frameInfo.frameIndex),
+		gpuSceneEvictCommandBufferSRV.at(frameInfo.frameIndex), nullptr, evictPipelineState.get(),
 		"GPUSceneEvictItems");
 	fn(scene->gpuSceneAllocCommands, gpuSceneAllocCommandBuffer.at(frameInfo.frameIndex),
-		gpuSceneAllocCommandBufferSRV.at(frameInfo.frameIndex), allocPipelineState.get(),
+		gpuSceneAllocCommandBufferSRV.at(frameInfo.frameIndex), nullptr, allocPipelineState.get(),
 		"GPUSceneAllocItems");
-	fn(scene->gpuSceneUpdateCommands, gpuSceneUpdateCommandBuffer.at(frameInfo.frameIndex),
-		gpuSceneUpdateCommandBufferSRV.at(frameInfo.frameIndex), updatePipelineState.get(),
+	fn(packedUpdateCommands, gpuSceneUpdateCommandBuffer.at(frameInfo.frameIndex),
+		gpuSceneUpdateCommandBufferSRV.at(frameInfo.frameIndex), gpuSceneTransformDataSRV.at(frameInfo.frameIndex), updatePipelineState.get(),
 		"GPUSceneUpdateItems");
 
 	BufferBarrierAuto barriersAfter[] = {
@@ -645,7 +683,7 @@ void GPUScene::resizeMaterialCommandBuffer(const FrameInfo& frameInfo, const Sce
 				BufferCreateParams{
 					.sizeInBytes = stride * count,
 					.alignment   = 0,
-					.accessFlags = EBufferAccessFlags::CPU_WRITE | EBufferAccessFlags::SRV
+					.accessFlags = EBufferAccessFlags::COPY_DST | EBufferAccessFlags::SRV
 				}
 			));
 			buffer->setDebugName(debugName);
@@ -707,19 +745,29 @@ void GPUScene::executeMaterialCommands(RenderCommandList* commandList, const Fra
 
 		for (size_t i = 0; i < materialCommands.size(); ++i)
 		{
-			Texture* albedo = scene->gpuSceneAlbedoTextures[i];
-			if (albedo == nullptr) albedo = fallback;
+			// Streamed textures are clamped to their uploaded mips.
+			Texture* albedo = scene->gpuSceneAlbedoTextures[i].texture;
+			float minLOD = scene->gpuSceneAlbedoTextures[i].minLOD;
+			if (albedo == nullptr)
+			{
+				albedo = fallback;
+				minLOD = 0.0f;
+			}
 
 			const uint32 itemIx = materialCommands[i].sceneItemIndex;
 
+			// Some backends ignore minLODClamp, so the view also starts at the clamped mip.
+			const uint32 numMips = getTextureNumMipLevels(albedo->getCreateParams());
+			const uint32 mostDetailedMip = std::min((uint32)minLOD, numMips - 1);
+
 			ShaderResourceViewDesc srvDesc{
 				.format              = albedo->getCreateParams().format,
 				.viewDimension       = ESRVDimension::Texture2D,
 				.texture2D           = Texture2DSRVDesc{
-					.mostDetailedMip = 0,
-					.mipLevels       = albedo->getCreateParams().mipLevels,
+					.mostDetailedMip = mostDetailedMip,
+					.mipLevels       = numMips - mostDetailedMip,
 					.planeSlice      = 0,
-					.minLODClamp     = 0.0f,
+					.minLODClamp     = minLOD,
 				}
 			};
 			auto albedoSRV = device->createSRV(albedo, albedoHeap, srvDesc);
@@ -742,7 +790,7 @@ void GPUScene::executeMaterialCommands(RenderCommandList* commandList, const Fra
 	auto materialBufferUAV = materialConstantsUAV.get();
 	auto descriptorHeap = materialPassDescriptor.getDescriptorHeap(frameInfo);
 
-	auto fn = [commandList, descriptorHeap, materialBufferUAV]<typename TCommandType>(
+	auto fn = [commandList, uploadRing = frameInfo.uploadRing, descriptorHeap, materialBufferUAV]<typename TCommandType>(
 		const std::vector<TCommandType>& sceneCommands,
 		Buffer*                          sceneCommandBuffer,
 		ShaderResourceView*              sceneCommandSRV,
@@ -756,10 +804,11 @@ void GPUScene::executeMaterialCommands(RenderCommandList* commandList, const Fra
 			sprintf_s(eventString, "%s (count=%u)", drawEventName, count);
 			SCOPED_DRAW_EVENT_STRING(commandList, eventString);
 
-			sceneCommandBuffer->singleWriteToGPU(
+			uploadRing->writeToBuffer(
 				commandList,
-				(void*)sceneCommands.data(),
-				(uint32)(sizeof(sceneCommands[0]) * count),
+				sceneCommands.data(),
+				sizeof(sceneCommands[0]) * count,
+				sceneCommandBuffer,
 				0);
 
 			BufferBarrierAuto cpuWriteBarrier{
@@ -873,7 +922,7 @@ void GPUScene::resizeDrawcallBuffer(RenderCommandList* commandList, const SceneP
 			BufferCreateParams{
 				.sizeInBytes = sizeof(uint32) * numPermutations,
 				.alignment   = 0,
-				.accessFlags = EBufferAccessFlags::CPU_WRITE | EBufferAccessFlags::UAV,
+				.accessFlags = EBufferAccessFlags::COPY_DST | EBufferAccessFlags::UAV,
 			}
 		));
 		drawcallCounterBuffer->setDebugName(L"Buffer_DrawcallCounter");
@@ -906,7 +955,7 @@ void GPUScene::resizeDrawcallBuffer(RenderCommandList* commandList, const SceneP
 			BufferCreateParams{
 				.sizeInBytes = sizeof(uint32) * numPermutations,
 				.alignment   = 0,
-				.accessFlags = EBufferAccessFlags::CPU_WRITE | EBufferAccessFlags::SRV,
+				.accessFlags = EBufferAccessFlags::COPY_DST | EBufferAccessFlags::SRV,
 			}
 		));
 		drawcallOffsetBuffer->setDebugName(L"Buffer_DrawcallOffset");
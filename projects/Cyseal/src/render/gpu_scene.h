@@ -1,6 +1,7 @@
 #pragma once
 
 #include "scene_render_pass.h"
+#include "gpu_scene_transform_packing.h"
 #include "core/vec3.h"
 #include "core/smart_pointer.h"
 #include "rhi/rhi_forward.h"
@@ -14,6 +15,7 @@ struct GPUSceneInput
 {
 	const SceneProxy*   scene;
 	const Camera*       camera;
+	bool                bQuantizeTransforms;
 };
 
 class GPUScene final : public SceneRenderPass
@@ -91,6 +93,14 @@ private:
 	BufferedUniquePtr<ShaderResourceView> gpuSceneAllocCommandBufferSRV;
 	BufferedUniquePtr<ShaderResourceView> gpuSceneUpdateCommandBufferSRV;
 
+	// Evict commands are merged into item ranges. See coalesceGPUSceneEvictCommands().
+	std::vector<GPUSceneEvictRangeCommand> evictRangeCommands;
+	// Update commands are packed with variable-sized transform data. See packGPUSceneUpdateCommands().
+	std::vector<GPUScenePackedUpdateCommand> packedUpdateCommands;
+	std::vector<uint32>                   packedTransformData;
+	BufferedUniquePtr<Buffer>             gpuSceneTransformDataBuffer;
+	BufferedUniquePtr<ShaderResourceView> gpuSceneTransformDataSRV; // ByteAddressBuffer view
+
 	// ----------------------------------------------
 	// Bindless materials
 	using UniqueSrvVec = std::vector<UniquePtr<ShaderResourceView>>;
@@ -1,7 +1,14 @@
 #pragma once
 
+#include "core/types.h"
+#include "util/enum_util.h"
 #include "material.h"
 
+#include <vector>
+
+class Texture;
+class MaterialAsset;
+
 // Should match with GPUSceneItem in common.hlsl
 struct GPUSceneItem
 {
@@ -30,11 +37,25 @@ struct GPUSceneItem
 };
 ENUM_CLASS_FLAGS(GPUSceneItem::FlagBits);
 
-// Should match with definitions in gpu_scene.hlsl
+// Consecutive gpu scene items [first, first + count), one for each section of a static mesh LOD.
+struct GPUSceneItemRange
+{
+	uint32       first = 0;
+	uint32       count = 0;
+};
+
+// CPU-only. Uploaded as GPUSceneEvictRangeCommand.
 struct GPUSceneEvictCommand
 {
 	uint32       sceneItemIndex;
 };
+// Should match with definitions in gpu_scene.hlsl
+// Evict commands merged into item ranges. See coalesceGPUSceneEvictCommands().
+struct GPUSceneEvictRangeCommand
+{
+	uint32       firstItemIndex;
+	uint32       numItems;
+};
 struct GPUSceneAllocCommand
 {
 	uint32       sceneItemIndex;
@@ -43,12 +64,11 @@ struct GPUSceneAllocCommand
 	uint32       _pad2;
 	GPUSceneItem sceneItem;
 };
+// Not uploaded as is. See packGPUSceneUpdateCommands().
 struct GPUSceneUpdateCommand
 {
 	uint32       sceneItemIndex;
-	uint32       _pad0;
-	uint32       _pad1;
-	uint32       _pad2;
+	bool         bPrevLocalToWorldResident; // prevLocalToWorld is localToWorld in the gpu scene buffer, so no need to upload it.
 	Float4x4     localToWorld;
 	Float4x4     prevLocalToWorld;
 };
@@ -65,3 +85,23 @@ struct GPUSceneEvictMaterialCommand
 {
 	uint32            sceneItemIndex;
 };
+
+// Albedo texture of a material command. GPUScene binds a fallback texture if null.
+struct GPUSceneMaterialTexture
+{
+	Texture*          texture = nullptr;
+	float             minLOD  = 0.0f; // Min LOD clamp of the SRV. See TextureAsset::getMinLOD().
+};
+
+// GPU scene commands of a frame, in the form that StaticMesh records them.
+// When recorded in parallel, each chunk of meshes has its own buffer and they are merged into SceneProxy in chunk order.
+struct GPUSceneCommandBuffer
+{
+	std::vector<GPUSceneEvictCommand>         evictCommands;
+	std::vector<GPUSceneAllocCommand>         allocCommands;
+	std::vector<GPUSceneUpdateCommand>        updateCommands;
+	std::vector<GPUSceneEvictMaterialCommand> evictMaterialCommands;
+	std::vector<GPUSceneMaterialCommand>      materialCommands;
+	std::vector<GPUSceneMaterialTexture>      albedoTextures; // For each material command
+	std::vector<MaterialAsset*>               dirtyMaterials;
+};
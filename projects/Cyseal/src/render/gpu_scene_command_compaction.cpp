@@ -0,0 +1,222 @@
+#include "gpu_scene_command_compaction.h"
+#include "core/assertion.h"
+
+#include <algorithm>
+
+enum class ECommandKind : uint8
+{
+	Evict,
+	Alloc,
+	Update,
+	EvictMaterial,
+	Material,
+};
+
+struct CommandRef
+{
+	ECommandKind kind;
+	uint32       batchIx;
+	uint32       commandIx;
+};
+
+static uint32 countCommands(const GPUSceneCommandBuffer& commands)
+{
+	return (uint32)(commands.evictCommands.size()
+		+ commands.allocCommands.size()
+		+ commands.updateCommands.size()
+		+ commands.evictMaterialCommands.size()
+		+ commands.materialCommands.size());
+}
+
+static uint64 countCommandBytes(const GPUSceneCommandBuffer& commands)
+{
+	return commands.evictCommands.size() * sizeof(GPUSceneEvictCommand)
+		+ commands.allocCommands.size() * sizeof(GPUSceneAllocCommand)
+		+ commands.updateCommands.size() * sizeof(GPUSceneUpdateCommand)
+		+ commands.evictMaterialCommands.size() * sizeof(GPUSceneEvictMaterialCommand)
+		+ commands.materialCommands.size() * sizeof(GPUSceneMaterialCommand);
+}
+
+void compactGPUSceneCommands(
+	const GPUSceneCommandBuffer* batches,
+	uint32 numBatches,
+	GPUSceneCommandBuffer& outCommands,
+	GPUSceneCommandStats* outStats)
+{
+	outCommands = GPUSceneCommandBuffer{};
+
+	// Enumerate commands in the order they take effect.
+	// (item index << 32 | ref index) sorts by item index, then by that order.
+	std::vector<CommandRef> refs;
+	std::vector<uint64> keys;
+	{
+		uint32 numTotalCommands = 0;
+		for (uint32 b = 0; b < numBatches; ++b)
+		{
+			numTotalCommands += countCommands(batches[b]);
+		}
+		refs.reserve(numTotalCommands);
+		keys.reserve(numTotalCommands);
+	}
+	auto addRefs = [&refs, &keys]<typename TCommandType>(const std::vector<TCommandType>& commands, ECommandKind kind, uint32 batchIx)
+	{
+		for (size_t i = 0; i < commands.size(); ++i)
+		{
+			keys.push_back(((uint64)commands[i].sceneItemIndex << 32) | (uint64)refs.size());
+			refs.push_back(CommandRef{ kind, batchIx, (uint32)i });
+		}
+	};
+	for (uint32 b = 0; b < numBatches; ++b)
+	{
+		const GPUSceneCommandBuffer& batch = batches[b];
+		CHECK(batch.materialCommands.size() == batch.albedoTextures.size());
+		addRefs(batch.evictCommands, ECommandKind::Evict, b);
+		addRefs(batch.allocCommands, ECommandKind::Alloc, b);
+		addRefs(batch.updateCommands, ECommandKind::Update, b);
+		addRefs(batch.evictMaterialCommands, ECommandKind::EvictMaterial, b);
+		addRefs(batch.materialCommands, ECommandKind::Material, b);
+	}
+	// Commands are mostly sorted already if item indices were allocated in mesh order.
+	if (!std::is_sorted(keys.begin(), keys.end()))
+	{
+		std::sort(keys.begin(), keys.end());
+	}
+
+	// Replay commands of each item and keep only the final effect.
+	size_t keyIx = 0;
+	while (keyIx < keys.size())
+	{
+		const uint32 itemIx = (uint32)(keys[keyIx] >> 32);
+
+		bool                            bEvict = false;
+		const GPUSceneAllocCommand*     allocCmd = nullptr;
+		const GPUSceneUpdateCommand*    updateCmd = nullptr;
+		bool                            bUpdateReplaced = false;
+		bool                            bEvictMaterial = false;
+		const GPUSceneMaterialCommand*  materialCmd = nullptr;
+		GPUSceneMaterialTexture         albedoTexture;
+
+		for (; keyIx < keys.size() && (uint32)(keys[keyIx] >> 32) == itemIx; ++keyIx)
+		{
+			const CommandRef& ref = refs[(uint32)keys[keyIx]];
+			const GPUSceneCommandBuffer& batch = batches[ref.batchIx];
+			switch (ref.kind)
+			{
+				case ECommandKind::Evict:
+					if (allocCmd != nullptr)
+					{
+						// Cancels the alloc. The item was free before it.
+						allocCmd = nullptr;
+					}
+					else
+					{
+						bEvict = true;
+					}
+					updateCmd = nullptr;
+					break;
+				case ECommandKind::Alloc:
+					allocCmd = &batch.allocCommands[ref.commandIx];
+					updateCmd = nullptr;
+					break;
+				case ECommandKind::Update:
+					bUpdateReplaced = (updateCmd != nullptr);
+					updateCmd = &batch.updateCommands[ref.commandIx];
+					break;
+				case ECommandKind::EvictMaterial:
+					bEvictMaterial = true;
+					materialCmd = nullptr;
+					albedoTexture = GPUSceneMaterialTexture{};
+					break;
+				case ECommandKind::Material:
+					materialCmd = &batch.materialCommands[ref.commandIx];
+					albedoTexture = batch.albedoTextures[ref.commandIx];
+					break;
+				default:
+					CHECK_NO_ENTRY();
+			}
+		}
+
+		if (allocCmd != nullptr)
+		{
+			outCommands.allocCommands.push_back(*allocCmd);
+			if (updateCmd != nullptr)
+			{
+				GPUSceneItem& item = outCommands.allocCommands.back().sceneItem;
+				item.localToWorld = updateCmd->localToWorld;
+				item.prevLocalToWorld = updateCmd->prevLocalToWorld;
+			}
+		}
+		else
+		{
+			if (bEvict)
+			{
+				outCommands.evictCommands.push_back(GPUSceneEvictCommand{ .sceneItemIndex = itemIx });
+			}
+			if (updateCmd != nullptr)
+			{
+				outCommands.updateCommands.push_back(*updateCmd);
+				if (bUpdateReplaced)
+				{
+					// The gpu scene won't have localToWorld of the dropped update.
+					outCommands.updateCommands.back().bPrevLocalToWorldResident = false;
+				}
+			}
+		}
+
+		if (materialCmd != nullptr)
+		{
+			outCommands.materialCommands.push_back(*materialCmd);
+			outCommands.albedoTextures.push_back(albedoTexture);
+		}
+		else if (bEvictMaterial)
+		{
+			outCommands.evictMaterialCommands.push_back(GPUSceneEvictMaterialCommand{ .sceneItemIndex = itemIx });
+		}
+	}
+
+	for (uint32 b = 0; b < numBatches; ++b)
+	{
+		const std::vector<MaterialAsset*>& dirtyMaterials = batches[b].dirtyMaterials;
+		outCommands.dirtyMaterials.insert(outCommands.dirtyMaterials.end(), dirtyMaterials.begin(), dirtyMaterials.end());
+	}
+	std::sort(outCommands.dirtyMaterials.begin(), outCommands.dirtyMaterials.end());
+	outCommands.dirtyMaterials.erase(
+		std::unique(outCommands.dirtyMaterials.begin(), outCommands.dirtyMaterials.end()),
+		outCommands.dirtyMaterials.end());
+
+	if (outStats != nullptr)
+	{
+		*outStats = GPUSceneCommandStats{};
+		for (uint32 b = 0; b < numBatches; ++b)
+		{
+			outStats->numCommandsBefore += countCommands(batches[b]);
+			outStats->bytesBefore += countCommandBytes(batches[b]);
+		}
+		outStats->numCommandsAfter = countCommands(outCommands);
+		outStats->bytesAfter = countCommandBytes(outCommands);
+	}
+}
+
+void coalesceGPUSceneEvictCommands(
+	const std::vector<GPUSceneEvictCommand>& commands,
+	std::vector<GPUSceneEvictRangeCommand>& outCommands)
+{
+	outCommands.clear();
+	for (const GPUSceneEvictCommand& cmd : commands)
+	{
+		if (!outCommands.empty())
+		{
+			GPUSceneEvictRangeCommand& last = outCommands.back();
+			CHECK(cmd.sceneItemIndex >= last.firstItemIndex + last.numItems);
+			if (cmd.sceneItemIndex == last.firstItemIndex + last.numItems)
+			{
+				last.numItems += 1;
+				continue;
+			}
+		}
+		outCommands.emplace_back(GPUSceneEvictRangeCommand{
+			.firstItemIndex = cmd.sceneItemIndex,
+			.numItems       = 1,
+		});
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "gpu_scene_command.h"
+
+struct GPUSceneCommandStats
+{
+	uint32 numCommandsBefore = 0;
+	uint32 numCommandsAfter  = 0;
+	uint64 bytesBefore       = 0;
+	uint64 bytesAfter        = 0;
+
+	inline uint64 getBytesSaved() const { return bytesBefore - bytesAfter; }
+};
+
+// Combines command batches into one batch that has the same effect on the GPU scene.
+// Batches are given in submission order, and commands of a batch take effect in stage order:
+// evict -> alloc -> update, and evict material -> material.
+// - Only the last write per item index survives. Updates of an item allocated earlier are folded into the alloc command.
+//   An update that replaces another one no longer reuses prevLocalToWorld resident in the gpu scene.
+// - Alloc then evict of the same item cancels out, as alloc only targets free items.
+// - Evict then alloc leaves only the alloc, as alloc overwrites the whole item. Same for materials.
+// - Commands are sorted by item index, and dirty materials are deduplicated.
+void compactGPUSceneCommands(
+	const GPUSceneCommandBuffer* batches,
+	uint32 numBatches,
+	GPUSceneCommandBuffer& outCommands,
+	GPUSceneCommandStats* outStats = nullptr);
+
+// Merges evict commands of consecutive item indices into ranges, for upload.
+// Commands should be sorted by item index, as compactGPUSceneCommands() outputs.
+void coalesceGPUSceneEvictCommands(
+	const std::vector<GPUSceneEvictCommand>& commands,
+	std::vector<GPUSceneEvictRangeCommand>& outCommands);
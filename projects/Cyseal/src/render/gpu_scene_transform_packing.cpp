@@ -0,0 +1,294 @@
+#include "gpu_scene_transform_packing.h"
+#include "core/assertion.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// Smallest three components of a unit quaternion are in [-1/sqrt(2), 1/sqrt(2)].
+static const float QUATERNION_COMPONENT_RANGE = 0.70710678f;
+
+static uint32 quantizeQuaternionComponent(float x)
+{
+	float t = (x / QUATERNION_COMPONENT_RANGE) * 0.5f + 0.5f;
+	t = std::clamp(t, 0.0f, 1.0f);
+	return (uint32)(t * 65535.0f + 0.5f);
+}
+
+static float dequantizeQuaternionComponent(uint32 x)
+{
+	return ((float)x / 65535.0f * 2.0f - 1.0f) * QUATERNION_COMPONENT_RANGE;
+}
+
+// Rotation matrix -> quaternion (x, y, z, w). R is for column vectors.
+static void rotationMatrixToQuaternion(const float R[3][3], float q[4])
+{
+	const float trace = R[0][0] + R[1][1] + R[2][2];
+	if (trace > 0.0f)
+	{
+		const float s = std::sqrt(trace + 1.0f) * 2.0f;
+		q[0] = (R[2][1] - R[1][2]) / s;
+		q[1] = (R[0][2] - R[2][0]) / s;
+		q[2] = (R[1][0] - R[0][1]) / s;
+		q[3] = 0.25f * s;
+	}
+	else if (R[0][0] > R[1][1] && R[0][0] > R[2][2])
+	{
+		const float s = std::sqrt(1.0f + R[0][0] - R[1][1] - R[2][2]) * 2.0f;
+		q[0] = 0.25f * s;
+		q[1] = (R[0][1] + R[1][0]) / s;
+		q[2] = (R[0][2] + R[2][0]) / s;
+		q[3] = (R[2][1] - R[1][2]) / s;
+	}
+	else if (R[1][1] > R[2][2])
+	{
+		const float s = std::sqrt(1.0f + R[1][1] - R[0][0] - R[2][2]) * 2.0f;
+		q[0] = (R[0][1] + R[1][0]) / s;
+		q[1] = 0.25f * s;
+		q[2] = (R[1][2] + R[2][1]) / s;
+		q[3] = (R[0][2] - R[2][0]) / s;
+	}
+	else
+	{
+		const float s = std::sqrt(1.0f + R[2][2] - R[0][0] - R[1][1]) * 2.0f;
+		q[0] = (R[0][2] + R[2][0]) / s;
+		q[1] = (R[1][2] + R[2][1]) / s;
+		q[2] = 0.25f * s;
+		q[3] = (R[1][0] - R[0][1]) / s;
+	}
+}
+
+void packAffineTransform(const Float4x4& transform, uint32* outData)
+{
+	// localToWorld is always affine, so the last row is not stored.
+	memcpy(outData, &(transform.m[0][0]), sizeof(float) * GPU_SCENE_AFFINE_TRANSFORM_SIZE);
+}
+
+bool packQuantizedTransform(const Float4x4& transform, uint32* outData)
+{
+	// Float4x4 is transposed, so each row of the upper 3x3 is a rotation axis multiplied by its scale.
+	float R[3][3];
+	float scale[3];
+	float maxScale = 0.0f;
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		const float* row = transform.m[i];
+		scale[i] = std::sqrt(row[0] * row[0] + row[1] * row[1] + row[2] * row[2]);
+		if (!(scale[i] > 0.0f) || !std::isfinite(scale[i]))
+		{
+			return false;
+		}
+		for (uint32 j = 0; j < 3; ++j)
+		{
+			R[i][j] = row[j] / scale[i];
+		}
+		maxScale = std::max(maxScale, scale[i]);
+	}
+
+	// Mirrored transform. Move the reflection to the scale.
+	const float det = R[0][0] * (R[1][1] * R[2][2] - R[1][2] * R[2][1])
+		- R[0][1] * (R[1][0] * R[2][2] - R[1][2] * R[2][0])
+		+ R[0][2] * (R[1][0] * R[2][1] - R[1][1] * R[2][0]);
+	if (det < 0.0f)
+	{
+		scale[0] = -scale[0];
+		R[0][0] = -R[0][0];
+		R[0][1] = -R[0][1];
+		R[0][2] = -R[0][2];
+	}
+
+	float q[4];
+	rotationMatrixToQuaternion(R, q);
+	const float qNorm = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	uint32 largest = 0;
+	for (uint32 i = 0; i < 4; ++i)
+	{
+		q[i] /= qNorm;
+		if (std::abs(q[i]) > std::abs(q[largest]))
+		{
+			largest = i;
+		}
+	}
+	// q and -q are the same rotation. Make the dropped component positive.
+	const float qSign = (q[largest] < 0.0f) ? -1.0f : 1.0f;
+	uint32 smallest[3];
+	for (uint32 i = 0, n = 0; i < 4; ++i)
+	{
+		if (i != largest)
+		{
+			smallest[n++] = quantizeQuaternionComponent(q[i] * qSign);
+		}
+	}
+
+	uint32 data[GPU_SCENE_QUANTIZED_TRANSFORM_SIZE];
+	const float translation[3] = { transform.m[0][3], transform.m[1][3], transform.m[2][3] };
+	memcpy(&data[0], translation, sizeof(translation));
+	memcpy(&data[3], scale, sizeof(scale));
+	data[6] = Cymath::packUint16x2(smallest[0], smallest[1]);
+	data[7] = Cymath::packUint16x2(smallest[2], largest);
+
+	// Reject if the rotation part is not orthonormal (shear) or the quantization error is too big.
+	const Float4x4 decoded = unpackQuantizedTransform(data);
+	const float tolerance = GPU_SCENE_QUANTIZED_TRANSFORM_TOLERANCE * maxScale;
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		for (uint32 j = 0; j < 3; ++j)
+		{
+			if (!(std::abs(decoded.m[i][j] - transform.m[i][j]) <= tolerance))
+			{
+				return false;
+			}
+		}
+	}
+
+	memcpy(outData, data, sizeof(data));
+	return true;
+}
+
+Float4x4 unpackAffineTransform(const uint32* data)
+{
+	Float4x4 M;
+	memcpy(&(M.m[0][0]), data, sizeof(float) * GPU_SCENE_AFFINE_TRANSFORM_SIZE);
+	M.m[3][3] = 1.0f;
+	return M;
+}
+
+Float4x4 unpackQuantizedTransform(const uint32* data)
+{
+	float translation[3], scale[3];
+	memcpy(translation, &data[0], sizeof(translation));
+	memcpy(scale, &data[3], sizeof(scale));
+
+	const uint32 largest = data[7] >> 16;
+	const float smallest[3] = {
+		dequantizeQuaternionComponent(data[6] & 0xffff),
+		dequantizeQuaternionComponent(data[6] >> 16),
+		dequantizeQuaternionComponent(data[7] & 0xffff),
+	};
+	float q[4];
+	float sumSq = 0.0f;
+	for (uint32 i = 0, n = 0; i < 4; ++i)
+	{
+		if (i != largest)
+		{
+			q[i] = smallest[n++];
+			sumSq += q[i] * q[i];
+		}
+	}
+	q[largest] = std::sqrt(std::max(0.0f, 1.0f - sumSq));
+
+	const float x = q[0], y = q[1], z = q[2], w = q[3];
+	const float R[3][3] = {
+		{ 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y - w * z),        2.0f * (x * z + w * y)        },
+		{ 2.0f * (x * y + w * z),        1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z - w * x)        },
+		{ 2.0f * (x * z - w * y),        2.0f * (y * z + w * x),        1.0f - 2.0f * (x * x + y * y) },
+	};
+
+	Float4x4 M;
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		M.m[i][0] = scale[i] * R[i][0];
+		M.m[i][1] = scale[i] * R[i][1];
+		M.m[i][2] = scale[i] * R[i][2];
+		M.m[i][3] = translation[i];
+	}
+	M.m[3][3] = 1.0f;
+	return M;
+}
+
+// Returns true if quantized.
+static bool appendTransform(const Float4x4& transform, bool bAllowQuantization, std::vector<uint32>& outData)
+{
+	const size_t offset = outData.size();
+	outData.resize(offset + GPU_SCENE_AFFINE_TRANSFORM_SIZE);
+	if (bAllowQuantization && packQuantizedTransform(transform, outData.data() + offset))
+	{
+		outData.resize(offset + GPU_SCENE_QUANTIZED_TRANSFORM_SIZE);
+		return true;
+	}
+	packAffineTransform(transform, outData.data() + offset);
+	return false;
+}
+
+static bool canMergeUpdateCommands(const GPUSceneUpdateCommand& prev, const GPUSceneUpdateCommand& next)
+{
+	if (next.sceneItemIndex != prev.sceneItemIndex + 1 || next.bPrevLocalToWorldResident != prev.bPrevLocalToWorldResident)
+	{
+		return false;
+	}
+	if (memcmp(&prev.localToWorld, &next.localToWorld, sizeof(Float4x4)) != 0)
+	{
+		return false;
+	}
+	return next.bPrevLocalToWorldResident || memcmp(&prev.prevLocalToWorld, &next.prevLocalToWorld, sizeof(Float4x4)) == 0;
+}
+
+void packGPUSceneUpdateCommands(
+	const std::vector<GPUSceneUpdateCommand>& commands,
+	bool bAllowQuantization,
+	std::vector<GPUScenePackedUpdateCommand>& outCommands,
+	std::vector<uint32>& outTransformData)
+{
+	outCommands.clear();
+	outTransformData.clear();
+	outCommands.reserve(commands.size());
+	outTransformData.reserve(commands.size() * GPU_SCENE_AFFINE_TRANSFORM_SIZE);
+
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		const GPUSceneUpdateCommand& cmd = commands[i];
+		if (i > 0 && canMergeUpdateCommands(commands[i - 1], cmd))
+		{
+			outCommands.back().numItems += 1;
+			continue;
+		}
+
+		const uint32 dataOffset = (uint32)outTransformData.size();
+		CHECK(dataOffset < (1u << 29));
+
+		EGPUScenePackedUpdateFlags flags = EGPUScenePackedUpdateFlags::None;
+		if (appendTransform(cmd.localToWorld, bAllowQuantization, outTransformData))
+		{
+			flags |= EGPUScenePackedUpdateFlags::QuantizedLocalToWorld;
+		}
+		if (!cmd.bPrevLocalToWorldResident)
+		{
+			flags |= EGPUScenePackedUpdateFlags::HasPrevLocalToWorld;
+			if (appendTransform(cmd.prevLocalToWorld, bAllowQuantization, outTransformData))
+			{
+				flags |= EGPUScenePackedUpdateFlags::QuantizedPrevLocalToWorld;
+			}
+		}
+
+		outCommands.emplace_back(GPUScenePackedUpdateCommand{
+			.sceneItemIndex     = cmd.sceneItemIndex,
+			.numItems           = 1,
+			.dataOffsetAndFlags = (dataOffset << 3) | (uint32)flags,
+		});
+	}
+}
+
+void unpackGPUSceneUpdateCommand(
+	const GPUScenePackedUpdateCommand& command,
+	const uint32* transformData,
+	const Float4x4& residentLocalToWorld,
+	Float4x4& outLocalToWorld,
+	Float4x4& outPrevLocalToWorld)
+{
+	const EGPUScenePackedUpdateFlags flags = (EGPUScenePackedUpdateFlags)(command.dataOffsetAndFlags & 7);
+	const uint32* data = transformData + (command.dataOffsetAndFlags >> 3);
+
+	const bool bQuantized = ENUM_HAS_FLAG(flags, EGPUScenePackedUpdateFlags::QuantizedLocalToWorld);
+	outLocalToWorld = bQuantized ? unpackQuantizedTransform(data) : unpackAffineTransform(data);
+	data += bQuantized ? GPU_SCENE_QUANTIZED_TRANSFORM_SIZE : GPU_SCENE_AFFINE_TRANSFORM_SIZE;
+
+	if (ENUM_HAS_FLAG(flags, EGPUScenePackedUpdateFlags::HasPrevLocalToWorld))
+	{
+		const bool bPrevQuantized = ENUM_HAS_FLAG(flags, EGPUScenePackedUpdateFlags::QuantizedPrevLocalToWorld);
+		outPrevLocalToWorld = bPrevQuantized ? unpackQuantizedTransform(data) : unpackAffineTransform(data);
+	}
+	else
+	{
+		outPrevLocalToWorld = residentLocalToWorld;
+	}
+}
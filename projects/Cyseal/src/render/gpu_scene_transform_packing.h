@@ -0,0 +1,62 @@
+#pragma once
+
+#include "gpu_scene_command.h"
+
+#include <vector>
+
+// Compact transform encodings for GPUSceneUpdateCommand.
+// Each update is uploaded as a 12-byte GPUScenePackedUpdateCommand plus variable-sized transform data.
+// Should match with gpu_scene.hlsl
+
+// Size of each encoding in uint32s.
+// - Affine       : First 3 rows of Float4x4. (The last row is always (0, 0, 0, 1))
+// - QuantizedTRS : Translation (float3), scale (float3), and rotation quantized to 64 bits (smallest three, 16 bits per component).
+constexpr uint32 GPU_SCENE_AFFINE_TRANSFORM_SIZE = 12;
+constexpr uint32 GPU_SCENE_QUANTIZED_TRANSFORM_SIZE = 8;
+
+// Max abs error of upper 3x3 elements relative to the largest scale, for a transform to be quantized.
+constexpr float GPU_SCENE_QUANTIZED_TRANSFORM_TOLERANCE = 1e-4f;
+
+enum class EGPUScenePackedUpdateFlags : uint32
+{
+	None                      = 0,
+	QuantizedLocalToWorld     = 1 << 0, // Else affine
+	HasPrevLocalToWorld       = 1 << 1, // Else reuse localToWorld in the gpu scene buffer
+	QuantizedPrevLocalToWorld = 1 << 2, // Else affine
+};
+ENUM_CLASS_FLAGS(EGPUScenePackedUpdateFlags);
+
+struct GPUScenePackedUpdateCommand
+{
+	uint32 sceneItemIndex;
+	uint32 numItems;           // Items [sceneItemIndex, sceneItemIndex + numItems) share the transform data.
+	uint32 dataOffsetAndFlags; // (Offset in uint32s to transform data << 3) | EGPUScenePackedUpdateFlags
+};
+
+void packAffineTransform(const Float4x4& transform, uint32* outData);
+
+// Returns false if the transform can't be represented within GPU_SCENE_QUANTIZED_TRANSFORM_TOLERANCE
+// (e.g., has shear or zero scale) and nothing is written.
+bool packQuantizedTransform(const Float4x4& transform, uint32* outData);
+
+Float4x4 unpackAffineTransform(const uint32* data);
+Float4x4 unpackQuantizedTransform(const uint32* data);
+
+// Packs update commands in order. If bAllowQuantization is true, each transform is quantized
+// if possible and stored as affine otherwise.
+// Commands for consecutive item indices with identical transforms (e.g., sections of a static mesh)
+// are merged into one packed command.
+void packGPUSceneUpdateCommands(
+	const std::vector<GPUSceneUpdateCommand>& commands,
+	bool bAllowQuantization,
+	std::vector<GPUScenePackedUpdateCommand>& outCommands,
+	std::vector<uint32>& outTransformData);
+
+// CPU version of the update command in gpu_scene.hlsl, for any item in the command's range.
+// residentLocalToWorld is localToWorld of the item in the gpu scene buffer before the update.
+void unpackGPUSceneUpdateCommand(
+	const GPUScenePackedUpdateCommand& command,
+	const uint32* transformData,
+	const Float4x4& residentLocalToWorld,
+	Float4x4& outLocalToWorld,
+	Float4x4& outPrevLocalToWorld);
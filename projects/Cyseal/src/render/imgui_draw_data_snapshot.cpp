@@ -0,0 +1,31 @@
+#include "imgui_draw_data_snapshot.h"
+#include "memory/custom_new_delete.h"
+
+ImguiDrawDataSnapshot* ImguiDrawDataSnapshot::capture()
+{
+	ImDrawData* source = ImGui::GetDrawData();
+	if (source == nullptr || !source->Valid)
+	{
+		return nullptr;
+	}
+
+	ImguiDrawDataSnapshot* snapshot = new(EMemoryTag::Renderer) ImguiDrawDataSnapshot;
+	snapshot->cmdLists.resize(source->CmdListsCount);
+	for (int32 i = 0; i < source->CmdListsCount; ++i)
+	{
+		// Only the output of the list: commands, vertices and indices.
+		snapshot->cmdLists[i] = source->CmdLists[i]->CloneOutput();
+	}
+
+	snapshot->drawData = *source;
+	snapshot->drawData.CmdLists = snapshot->cmdLists.data();
+	return snapshot;
+}
+
+ImguiDrawDataSnapshot::~ImguiDrawDataSnapshot()
+{
+	for (ImDrawList* cmdList : cmdLists)
+	{
+		IM_DELETE(cmdList);
+	}
+}
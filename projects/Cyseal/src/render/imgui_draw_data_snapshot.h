@@ -0,0 +1,31 @@
+#pragma once
+
+#include "core/int_types.h"
+
+#include "imgui.h"
+
+#include <vector>
+
+// Deep copy of Dear ImGui draw data, so the render thread can draw it
+// while the main thread builds the next ImGui frame.
+// ImGui's allocator is not thread-safe, so create and delete it on the main thread.
+class ImguiDrawDataSnapshot
+{
+public:
+	// Copies ImGui::GetDrawData(). Call after ImGui::Render().
+	// @return nullptr if there is no valid draw data.
+	static ImguiDrawDataSnapshot* capture();
+
+	~ImguiDrawDataSnapshot();
+
+	ImguiDrawDataSnapshot(const ImguiDrawDataSnapshot&) = delete;
+	ImguiDrawDataSnapshot& operator=(const ImguiDrawDataSnapshot&) = delete;
+
+	inline ImDrawData* getDrawData() { return &drawData; }
+
+private:
+	ImguiDrawDataSnapshot() = default;
+
+	ImDrawData               drawData;
+	std::vector<ImDrawList*> cmdLists; // Owned clones. drawData.CmdLists points here.
+};
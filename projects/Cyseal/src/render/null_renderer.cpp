@@ -1,6 +1,7 @@
 #include "null_renderer.h"
 #include "rhi/render_command.h"
 #include "rhi/swap_chain.h"
+#include "rhi/upload_batcher.h"
 
 #define VERIFY_EMPTY_LOOP 1
 #define VERIFY_DEAR_IMGUI 1
@@ -33,11 +34,8 @@ void NullRenderer::render(const SceneProxy* scene, const Camera* camera, const R
 	commandAllocator->reset();
 	commandList->reset(commandAllocator);
 
-	for (RenderCommandList::CustomCommandType lambda : customCommands)
-	{
-		lambda(*commandList);
-	}
-	customCommands.clear();
+	executeCustomCommands(commandList);
+	gUploadBatcher->flush(commandList);
 
 	TextureBarrierAuto renderToBackbufferBarrier = {
 		EBarrierSync::RENDER_TARGET, EBarrierAccess::RENDER_TARGET, EBarrierLayout::RenderTarget,
@@ -66,7 +64,7 @@ void NullRenderer::render(const SceneProxy* scene, const Camera* camera, const R
 		// - No beginRenderPass() and endRenderPass() as this function handles render pass part internally.
 		// - Render pass implicitly converts the swapchain image's layout to PRESENT.
 		//   So we pass swapchainBuffer and forcefully change its internal barrier tracker.
-		device->renderDearImgui(commandList, swapchainBuffer);
+		device->renderDearImgui(commandList, swapchainBuffer, getImguiDrawData());
 	}
 #endif
 
@@ -86,12 +84,9 @@ void NullRenderer::render(const SceneProxy* scene, const Camera* camera, const R
 	device->flushCommandQueue();
 
 	commandList->executeDeferredDealloc();
+	gUploadBatcher->endFrame(frameID);
+	gUploadBatcher->retire(frameID);
 #endif
 	
 	frameID += 1;
-}
-
-void NullRenderer::enqueueCustomCommands(std::vector<RenderCommandList::CustomCommandType>&& inCommands)
-{
-	customCommands = inCommands;
 }
\ No newline at end of file
@@ -13,11 +13,7 @@ public:
 
 	virtual void recreateSceneTextures(uint32 sceneWidth, uint32 sceneHeight) override {}
 
-	virtual void enqueueCustomCommands(std::vector<RenderCommandList::CustomCommandType>&& inCommands) override;
-
 private:
 	RenderDevice* device = nullptr;
 	uint32 frameID = 0;
-
-	std::vector<RenderCommandList::CustomCommandType> customCommands;
 };
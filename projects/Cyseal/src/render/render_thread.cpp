@@ -0,0 +1,111 @@
+#include "render_thread.h"
+#include "renderer.h"
+#include "core/assertion.h"
+#include "world/scene_proxy.h"
+
+RenderThread::~RenderThread()
+{
+	CHECK(!isRunning());
+}
+
+void RenderThread::start(Renderer* inRenderer, uint32 inMaxPendingFrames)
+{
+	CHECK(!isRunning() && inRenderer != nullptr && inMaxPendingFrames > 0);
+
+	renderer = inRenderer;
+	maxPendingFrames = inMaxPendingFrames;
+	bStopRequested = false;
+	thread = std::thread([this]() { threadMain(); });
+}
+
+void RenderThread::stop()
+{
+	if (!isRunning()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bStopRequested = true;
+	}
+	frameSubmitted.notify_one();
+	thread.join();
+}
+
+uint64 RenderThread::submit(RenderFrameSnapshot&& frame)
+{
+	CHECK(isRunning());
+
+	uint64 frameNumber;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		frameCompleted.wait(lock, [this]() {
+			return numSubmittedFrames - numCompletedFrames < maxPendingFrames;
+		});
+		frameQueue.emplace_back(std::move(frame));
+		frameNumber = ++numSubmittedFrames;
+	}
+	frameSubmitted.notify_one();
+	return frameNumber;
+}
+
+void RenderThread::waitForFrame(uint64 frameNumber)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	CHECK(frameNumber <= numSubmittedFrames);
+	frameCompleted.wait(lock, [this, frameNumber]() {
+		return numCompletedFrames >= frameNumber;
+	});
+}
+
+void RenderThread::flush()
+{
+	uint64 lastFrame;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		lastFrame = numSubmittedFrames;
+	}
+	waitForFrame(lastFrame);
+}
+
+uint64 RenderThread::getNumSubmittedFrames() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return numSubmittedFrames;
+}
+
+uint64 RenderThread::getNumCompletedFrames() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return numCompletedFrames;
+}
+
+void RenderThread::threadMain()
+{
+	while (true)
+	{
+		RenderFrameSnapshot frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			frameSubmitted.wait(lock, [this]() {
+				return !frameQueue.empty() || bStopRequested;
+			});
+			// Pending frames are rendered even if stop was requested.
+			if (frameQueue.empty())
+			{
+				break;
+			}
+			frame = std::move(frameQueue.front());
+			frameQueue.pop_front();
+		}
+
+		renderer->setImguiDrawData(frame.imguiDrawData);
+		renderer->render(frame.sceneProxy, &frame.camera, frame.rendererOptions);
+		renderer->setImguiDrawData(nullptr);
+		delete frame.sceneProxy;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			++numCompletedFrames;
+		}
+		frameCompleted.notify_all();
+	}
+}
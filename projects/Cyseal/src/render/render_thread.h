@@ -0,0 +1,67 @@
+#pragma once
+
+#include "renderer_options.h"
+#include "core/int_types.h"
+#include "world/camera.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+class Renderer;
+class SceneProxy;
+struct ImDrawData;
+
+// Immutable input of a frame. The render thread owns it after submission.
+struct RenderFrameSnapshot
+{
+	SceneProxy*     sceneProxy = nullptr; // Deleted by the render thread after rendering.
+	Camera          camera;
+	RendererOptions rendererOptions;
+	ImDrawData*     imguiDrawData = nullptr; // Optional. Owned by the submitter, kept until the frame is rendered.
+};
+
+// Renders submitted frames on a dedicated thread, so the main thread
+// can build frame N+1 while the render thread renders frame N.
+// At most maxPendingFrames frames can be submitted but not completed;
+// submit() blocks when the limit is reached.
+class RenderThread
+{
+public:
+	~RenderThread();
+
+	void start(Renderer* inRenderer, uint32 inMaxPendingFrames = 2);
+
+	// Renders all pending frames and joins the thread.
+	void stop();
+
+	// @return Frame number to pass to waitForFrame(). Starts from 1.
+	uint64 submit(RenderFrameSnapshot&& frame);
+
+	// Blocks until the given frame is completely rendered.
+	void waitForFrame(uint64 frameNumber);
+
+	// Blocks until all submitted frames are rendered.
+	// Call before the main thread touches what the renderer might be using.
+	void flush();
+
+	inline bool isRunning() const { return thread.joinable(); }
+	uint64 getNumSubmittedFrames() const;
+	uint64 getNumCompletedFrames() const;
+
+private:
+	void threadMain();
+
+	Renderer*                       renderer = nullptr;
+	uint32                          maxPendingFrames = 2;
+
+	std::thread                     thread;
+	mutable std::mutex              mutex;
+	std::condition_variable         frameSubmitted;
+	std::condition_variable         frameCompleted;
+	std::deque<RenderFrameSnapshot> frameQueue;
+	uint64                          numSubmittedFrames = 0;
+	uint64                          numCompletedFrames = 0;
+	bool                            bStopRequested = false;
+};
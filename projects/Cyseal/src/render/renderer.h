@@ -5,9 +5,16 @@
 #include "rhi/render_command.h"
 #include "world/camera.h"
 #include "world/scene_proxy.h"
+#include "core/command_packet_queue.h"
 
 #include <vector>
 
+class ThreadPool;
+struct ImDrawData;
+
+// Commands enqueued by ENQUEUE_RENDER_COMMAND. Can be fed from any thread.
+using CustomRenderCommandQueue = CommandPacketQueue<RenderCommandList&>;
+
 class Renderer
 {
 public:
@@ -19,5 +26,30 @@ public:
 
 	virtual void recreateSceneTextures(uint32 sceneWidth, uint32 sceneHeight) = 0;
 
-	virtual void enqueueCustomCommands(std::vector<RenderCommandList::CustomCommandType>&& inCommands) = 0;
+	// Commands in the queue are drained by executeCustomCommands() during render().
+	inline void setCustomCommandQueue(CustomRenderCommandQueue* inQueue) { customCommandQueue = inQueue; }
+
+	// Workers for data-parallel loops in render(). Must not be used by other threads while rendering.
+	inline void setThreadPool(ThreadPool* inThreadPool) { threadPool = inThreadPool; }
+
+	// Dear ImGui draw data for render(). nullptr means nothing to draw.
+	// The caller keeps it alive until render() returns, as the main thread might be building the next ImGui frame.
+	inline void setImguiDrawData(ImDrawData* inDrawData) { imguiDrawData = inDrawData; }
+
+protected:
+	inline ThreadPool* getThreadPool() const { return threadPool; }
+	inline ImDrawData* getImguiDrawData() const { return imguiDrawData; }
+
+	inline void executeCustomCommands(RenderCommandList* commandList)
+	{
+		if (customCommandQueue != nullptr)
+		{
+			customCommandQueue->execute(*commandList);
+		}
+	}
+
+private:
+	CustomRenderCommandQueue* customCommandQueue = nullptr;
+	ThreadPool* threadPool = nullptr;
+	ImDrawData* imguiDrawData = nullptr;
 };
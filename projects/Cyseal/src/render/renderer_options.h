@@ -227,6 +227,7 @@ struct RendererOptions
 	// Indirect draw
 	EIndirectDrawMode          indirectDrawMode = EIndirectDrawMode::PopulateOnGPU;
 	bool                       bEnableGPUCulling = true;
+	bool                       bQuantizeGPUSceneTransforms = true; // Upload transform updates as quantized TRS if precise enough, else as 3x4 affine.
 
 	// Depth and visibility pass
 	bool                       bEnableDepthPrepass = true;
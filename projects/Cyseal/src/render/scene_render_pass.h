@@ -2,6 +2,10 @@
 
 #include "core/int_types.h"
 
+class LinearAllocator;
+class UploadRing;
+class ThreadPool;
+
 // Naming of 'frameId' and 'frameIndex' is a little vague, but my criteria:
 // - Each ID has a unique value. frameID does.
 // - An index is, well, an index. frameIndex could be 0 and then again 0 in the next frame.
@@ -16,6 +20,15 @@ struct FrameInfo
 	// - So a render pass that relies on temporal accumulations need to create
 	//   e.g., 2 textures regardless of maxFramesInFlight() and index them with (frameID % 2).
 	uint32 frameIndex;
+
+	// Transient CPU memory for this frame. Valid until the same frameIndex comes again.
+	LinearAllocator* frameAllocator;
+
+	// Transient upload memory for this frame. Allocations are valid only in this frame.
+	UploadRing*      uploadRing;
+
+	// Workers for data-parallel loops of render passes. Null if the renderer has no thread pool.
+	ThreadPool*      threadPool;
 };
 
 // Has nothing to do with D3D render pass or vulkan render pass.
@@ -12,11 +12,13 @@
 #include "rhi/vertex_buffer_pool.h"
 #include "rhi/global_descriptor_heaps.h"
 #include "rhi/texture_manager.h"
+#include "rhi/upload_batcher.h"
 #include "rhi/hardware_raytracing.h"
 #include "rhi/denoiser_device.h"
 
 #include "render/renderer_constants.h"
 #include "render/static_mesh.h"
+#include "render/texture_streamer.h"
 #include "render/util/clear_resource_pass.h"
 #include "render/gpu_scene.h"
 #include "render/gpu_culling.h"
@@ -40,14 +42,18 @@
 #include "render/final_blit_pass.h"
 
 #include "util/profiling.h"
+#include "util/logging.h"
 
 #include <thread>
 
 #define SCENE_UNIFORM_MEMORY_POOL_SIZE (64 * 1024) // 64 KiB
+#define UPLOAD_RING_INITIAL_SIZE       (4 * 1024 * 1024) // 4 MiB, grows if needed
 #define MAX_CULL_OPERATIONS            (2 * kMaxBasePassPermutation) // depth prepass + base pass
 #define MAX_FINAL_BLIT_OPERATIONS      2 // Actual count: 2 if frame generation is enabled, 1 otherwise.
 #define AVG_FRAME_TIME_WINDOW_SIZE     16
 
+DEFINE_LOG_CATEGORY_STATIC(LogSceneRenderer);
+
 static uint32 fullMipCount(uint32 width, uint32 height)
 {
 	return static_cast<uint32>(floor(log2(std::max(width, height))) + 1);
@@ -60,6 +66,9 @@ void SceneRenderer::initialize(RenderDevice* renderDevice)
 
 	avgFrameTime.init(AVG_FRAME_TIME_WINDOW_SIZE);
 
+	frameAllocator.initialize(renderDevice->maxFramesInFlight());
+	uploadRing.initialize(renderDevice, UPLOAD_RING_INITIAL_SIZE, &uploadRingFence);
+
 	// Scene textures: Don't create yet. You invoke recreateSceneTextures() before using scene renderer.
 	// recreateSceneTextures(width, height);
 
@@ -196,9 +205,13 @@ void SceneRenderer::render(const SceneProxy* scene, const Camera* camera, const
 		acquireSwapchainResources(swapchainBuffer, swapchainBufferRTV);
 	}
 
+	const uint32 frameIndex = frameID % device->maxFramesInFlight();
 	const FrameInfo frameInfo{
-		.frameID    = frameID,
-		.frameIndex = (frameID % device->maxFramesInFlight()),
+		.frameID        = frameID,
+		.frameIndex     = frameIndex,
+		.frameAllocator = frameAllocator.beginFrame(frameIndex),
+		.uploadRing     = &uploadRing,
+		.threadPool     = getThreadPool(),
 	};
 
 	auto commandAllocator     = device->getCommandAllocator(frameInfo.frameIndex);
@@ -265,11 +278,11 @@ void SceneRenderer::render(const SceneProxy* scene, const Camera* camera, const
 	// Just execute prior to any standard renderer works.
 	// If some custom commands should execute in midst of frame rendering,
 	// I need to insert delegates here and there of this SceneRenderer::render() function.
-	for (RenderCommandList::CustomCommandType lambda : customCommands)
-	{
-		lambda(*commandList);
-	}
-	customCommands.clear();
+	executeCustomCommands(commandList);
+	// Record uploads enqueued by custom commands and earlier frames.
+	gUploadBatcher->flush(commandList);
+	// Reallocate streamed textures before any pass samples them.
+	gTextureStreamer->flush(commandList);
 
 	// #todo-renderer: In future each render pass might write to RTs of different dimensions.
 	// Currently all passes work at full resolution.
@@ -297,13 +310,24 @@ void SceneRenderer::render(const SceneProxy* scene, const Camera* camera, const
 		SCOPED_DRAW_EVENT(commandList, GPUScene);
 
 		GPUSceneInput passInput{
-			.scene  = scene,
-			.camera = camera,
+			.scene               = scene,
+			.camera              = camera,
+			.bQuantizeTransforms = renderOptions.bQuantizeGPUSceneTransforms,
 		};
 		gpuScene->renderGPUScene(commandList, frameInfo, passInput);
 		gpuScene->generateDrawcalls(commandList, frameInfo, passInput);
 	}
 
+	// CPU draw lists are only needed if drawcalls are not generated on GPU.
+	if (renderOptions.indirectDrawMode != EIndirectDrawMode::PopulateOnGPU)
+	{
+		staticMeshDrawBuckets.update(scene, frameInfo.frameAllocator);
+	}
+	else
+	{
+		staticMeshDrawBuckets.invalidate();
+	}
+
 	if (renderOptions.bEnableGPUCulling)
 	{
 		gpuCulling->resetCullingResources();
@@ -397,6 +421,7 @@ void SceneRenderer::render(const SceneProxy* scene, const Camera* camera, const
 			.indirectDrawMode   = renderOptions.indirectDrawMode,
 			.bGPUCulling        = renderOptions.bEnableGPUCulling,
 			.bVisibilityBuffer  = bRenderVisibilityBuffer,
+			.drawBuckets        = &staticMeshDrawBuckets,
 			.sceneUniformBuffer = sceneUniformCBV,
 			.gpuScene           = gpuScene,
 			.gpuCulling         = gpuCulling,
@@ -520,6 +545,7 @@ void SceneRenderer::render(const SceneProxy* scene, const Camera* camera, const
 			.camera             = camera,
 			.indirectDrawMode   = renderOptions.indirectDrawMode,
 			.bGPUCulling        = renderOptions.bEnableGPUCulling,
+			.drawBuckets        = &staticMeshDrawBuckets,
 			.sceneUniformBuffer = sceneUniformCBV,
 			.gpuScene           = gpuScene,
 			.gpuCulling         = gpuCulling,
@@ -1098,7 +1124,7 @@ void SceneRenderer::render(const SceneProxy* scene, const Camera* camera, const
 		
 			DescriptorHeap* imguiHeaps[] = { device->getDearImguiSRVHeap() };
 			commandList->setDescriptorHeaps(1, imguiHeaps);
-			device->renderDearImgui(commandList, swapchainBuffer);
+			device->renderDearImgui(commandList, swapchainBuffer, getImguiDrawData());
 		}
 
 		//////////////////////////////////////////////////////////////////////////
@@ -1164,10 +1190,34 @@ void SceneRenderer::render(const SceneProxy* scene, const Camera* camera, const
 	prevScaledRenderResolutionX = sceneWidth;
 	prevScaledRenderResolutionY = sceneHeight;
 
-	// Deallocate memory, a bit messy
+	// Deallocate memory. GPU works were flushed above.
 	commandList->executeDeferredDealloc();
-	for (auto& cand : deferredCleanupList) delete cand.resource;
-	deferredCleanupList.clear();
+	deferredCleanupQueue.retire(frameID);
+	uploadRingFence.completedValue = frameID;
+	uploadRing.endFrame(frameID);
+	logUploadRingStats();
+	gUploadBatcher->endFrame(frameID);
+	gUploadBatcher->retire(frameID);
+	gTextureStreamer->update(TextureStreamingView::fromCamera(*camera, sceneHeight));
+}
+
+void SceneRenderer::logUploadRingStats()
+{
+	// Only log when changed. They are all monotonic, so this stops once the ring fits the workload.
+	const UploadRingAllocator& allocator = uploadRing.getAllocator();
+	UploadRingStats stats{
+		.highWaterMark = allocator.getHighWaterMark(),
+		.numStalls     = allocator.getNumStalls(),
+		.numGrows      = uploadRing.getNumGrows(),
+	};
+	if (stats.highWaterMark != prevUploadRingStats.highWaterMark
+		|| stats.numStalls != prevUploadRingStats.numStalls
+		|| stats.numGrows != prevUploadRingStats.numGrows)
+	{
+		CYLOG(LogSceneRenderer, Log, L"Upload ring: high-water mark %llu / %llu bytes, %llu stalls, %u grows (frame %u)",
+			stats.highWaterMark, allocator.getCapacity(), stats.numStalls, stats.numGrows, frameID);
+		prevUploadRingStats = stats;
+	}
 }
 
 void SceneRenderer::recreateSceneTextures(uint32 sceneWidth, uint32 sceneHeight)
@@ -1182,11 +1232,12 @@ void SceneRenderer::recreateSceneTextures(uint32 sceneWidth, uint32 sceneHeight)
 
 	device->getDenoiserDevice()->recreateResources(sceneWidth, sceneHeight);
 
-	auto& cleanupList = this->deferredCleanupList;
-	auto cleanup = [&cleanupList](GPUResource* resource) {
+	auto& cleanupQueue = this->deferredCleanupQueue;
+	const uint64 cleanupFence = frameID;
+	auto cleanup = [&cleanupQueue, cleanupFence](GPUResource* resource) {
 		if (resource != nullptr)
 		{
-			cleanupList.push_back({ resource });
+			cleanupQueue.enqueue(resource, cleanupFence);
 		}
 	};
 
@@ -1686,11 +1737,6 @@ void SceneRenderer::recreateSceneTextures(uint32 sceneWidth, uint32 sceneHeight)
 	));
 }
 
-void SceneRenderer::enqueueCustomCommands(std::vector<RenderCommandList::CustomCommandType>&& inCommands)
-{
-	customCommands = inCommands;
-}
-
 void SceneRenderer::resetCommandList(RenderCommandAllocator* commandAllocator, RenderCommandList* commandList)
 {
 	commandAllocator->reset();
@@ -4,6 +4,10 @@
 #include "rhi/rhi_forward.h"
 #include "rhi/gpu_resource_view.h"
 #include "core/smart_pointer.h"
+#include "memory/frame_allocator.h"
+#include "rhi/deferred_dealloc_queue.h"
+#include "rhi/upload_ring.h"
+#include "static_mesh_draw_buckets.h"
 
 // Should match with common.hlsl
 struct SceneUniform
@@ -76,8 +80,6 @@ public:
 	/// <param name="sceneHeight">Height of new render resolution.</param>
 	virtual void recreateSceneTextures(uint32 sceneWidth, uint32 sceneHeight) override;
 
-	virtual void enqueueCustomCommands(std::vector<RenderCommandList::CustomCommandType>&& inCommands) override;
-
 private:
 	void resetCommandList(RenderCommandAllocator* commandAllocator, RenderCommandList* commandList);
 	void immediateFlushCommandQueue(RenderCommandQueue* commandQueue, RenderCommandAllocator* commandAllocator, RenderCommandList* commandList);
@@ -90,18 +92,38 @@ private:
 
 	void createFinalBlitRTV(RenderCommandList* commandList, const RendererOptions& renderOptions);
 
+	void logUploadRingStats();
+
 private:
 	RenderDevice* device = nullptr;
 
-	std::vector<RenderCommandList::CustomCommandType> customCommands;
-
-	struct DeferredCleanup { GPUResource* resource; /*uint32 count;*/ }; // Don't remember why I put 'count' there...?
-	std::vector<DeferredCleanup> deferredCleanupList;
+	// Scene textures replaced by recreateSceneTextures(), tagged with frameID.
+	DeferredDeallocQueue deferredCleanupQueue;
 
 	SceneUniform sceneUniformData;
 	SceneUniform prevSceneUniformData;
 
 	uint32 frameID = 0;
+	FrameAllocator frameAllocator;
+
+	// render() flushes the command queue every frame, so a frame is complete when it returns.
+	class FlushedFrameFence : public UploadRingFence
+	{
+	public:
+		virtual uint64 getCompletedValue() const override { return completedValue; }
+		virtual void waitForValue(uint64 value) override { CHECK(value <= completedValue); }
+		uint64 completedValue = 0;
+	};
+	FlushedFrameFence uploadRingFence;
+	UploadRing uploadRing;
+	struct UploadRingStats
+	{
+		uint64 highWaterMark = 0;
+		uint64 numStalls = 0;
+		uint32 numGrows = 0;
+	};
+	UploadRingStats prevUploadRingStats; // Last logged
+	StaticMeshDrawBuckets staticMeshDrawBuckets;
 	SimpleMovingAverage avgFrameTime;
 	float prevInterpTime = 0.0f;
 
@@ -70,13 +70,51 @@ static MaterialConstants createMaterialConstants(MaterialAsset* material, uint32
 	return constants;
 }
 
-static Texture* getAlbedoTexture(const SharedPtr<MaterialAsset>& material)
+// Textures that are not created or uploaded yet are not bound (GPUScene binds a fallback texture instead).
+static bool isAlbedoTexturePending(const SharedPtr<MaterialAsset>& material)
 {
 	if (material != nullptr && material->getAlbedoTexture() != nullptr)
 	{
-		return material->getAlbedoTexture()->getGPUResource().get();
+		const TextureAsset* albedo = material->getAlbedoTexture().get();
+		return !albedo->isUploadComplete() || albedo->getRawGPUResource() == nullptr;
 	}
-	return nullptr;
+	return false;
+}
+
+// Buffers are suballocated and uploaded by gUploadBatcher in a render command, maybe over several frames.
+static bool isSectionGeometryReady(const StaticMeshSection& section)
+{
+	return section.positionBuffer->getRawGPUResource() != nullptr && section.positionBuffer->isUploadComplete()
+		&& section.nonPositionBuffer->getRawGPUResource() != nullptr && section.nonPositionBuffer->isUploadComplete()
+		&& section.indexBuffer->getRawGPUResource() != nullptr && section.indexBuffer->isUploadComplete();
+}
+
+// Changes when SRVs of the texture should be recreated, e.g., finer mips of a streamed texture are uploaded.
+static uint32 getAlbedoViewRevision(const SharedPtr<MaterialAsset>& material)
+{
+	if (material != nullptr && material->getAlbedoTexture() != nullptr)
+	{
+		return material->getAlbedoTexture()->getViewRevision();
+	}
+	return 0;
+}
+
+// @param outNumPending    Incremented if the texture is pending.
+// @param outViewRevision  Added with the view revision of the texture.
+static GPUSceneMaterialTexture getAlbedoTexture(const SharedPtr<MaterialAsset>& material, uint32& outNumPending, uint32& outViewRevision)
+{
+	outViewRevision += getAlbedoViewRevision(material);
+	if (isAlbedoTexturePending(material))
+	{
+		outNumPending += 1;
+		return GPUSceneMaterialTexture{};
+	}
+	if (material != nullptr && material->getAlbedoTexture() != nullptr)
+	{
+		const TextureAsset* albedo = material->getAlbedoTexture().get();
+		return GPUSceneMaterialTexture{ albedo->getGPUResource().get(), albedo->getMinLOD() };
+	}
+	return GPUSceneMaterialTexture{};
 }
 
 StaticMesh::~StaticMesh()
@@ -85,7 +123,7 @@ StaticMesh::~StaticMesh()
 	// Manually unregister buffers from buffer pools before buffer destructors are called.
 	for (const auto& lod : LODs)
 	{
-		for (const auto& sec : lod.sections)
+		for (const auto& sec : lod->sections)
 		{
 			sec.positionBuffer->getGPUResource()->removeFromPool();
 			sec.nonPositionBuffer->getGPUResource()->removeFromPool();
@@ -94,17 +132,40 @@ StaticMesh::~StaticMesh()
 	}
 }
 
-void StaticMesh::updateGPUSceneResidency(SceneProxy* sceneProxy, GPUSceneItemIndexAllocator* gpuSceneItemIndexAllocator)
+bool StaticMesh::isGeometryUploadComplete() const
 {
-	// NOTE: activeLOD should have been updated already.
+	for (const StaticMeshSection& section : LODs[activeLOD]->sections)
+	{
+		if (!isSectionGeometryReady(section))
+		{
+			return false;
+		}
+	}
+	return true;
+}
 
-	const std::vector<StaticMeshSection>& sections = LODs[activeLOD].sections;
-	const size_t numSections = sections.size();
+uint32 StaticMesh::prepareGPUSceneResidency(std::vector<GPUSceneItemRange>& outItemRangesToFree)
+{
+	const std::vector<StaticMeshSection>& sections = LODs[activeLOD]->sections;
+	const uint32 numSections = (uint32)sections.size();
 
 	bool isMaterialDirty = false;
+	uint32 albedoViewRevision = 0;
 	for (const auto& section : sections)
 	{
 		isMaterialDirty = isMaterialDirty || section.material->isDirty();
+		albedoViewRevision += getAlbedoViewRevision(section.material);
+	}
+	isMaterialDirty = isMaterialDirty || (albedoViewRevision != gpuSceneResidency.albedoViewRevision);
+	// Uploads only complete, so fewer pending textures mean some can be bound now.
+	if (!isMaterialDirty && gpuSceneResidency.numPendingAlbedoTextures > 0)
+	{
+		uint32 numPending = 0;
+		for (const auto& section : sections)
+		{
+			numPending += isAlbedoTexturePending(section.material) ? 1 : 0;
+		}
+		isMaterialDirty = numPending < gpuSceneResidency.numPendingAlbedoTextures;
 	}
 
 	if (gpuSceneResidency.phase == EGPUResidencyPhase::Allocated)
@@ -124,103 +185,113 @@ void StaticMesh::updateGPUSceneResidency(SceneProxy* sceneProxy, GPUSceneItemInd
 		case EGPUResidencyPhase::NotAllocated:
 			{
 				// Check first if GPU resources are valid.
-				bool bInvalidResources = false;
-				for (size_t i = 0; i < numSections; ++i)
-				{
-					const StaticMeshSection& section = sections[i];
-					if (section.positionBuffer->getGPUResource() == nullptr
-						|| section.nonPositionBuffer->getGPUResource() == nullptr
-						|| section.indexBuffer->getGPUResource() == nullptr)
-					{
-						bInvalidResources = true;
-						break;
-					}
-				}
-				if (bInvalidResources)
+				if (!isGeometryUploadComplete())
 				{
-					break;
+					return 0;
 				}
-				gpuSceneResidency.itemIndices.resize(numSections);
-				for (size_t i = 0; i < numSections; ++i)
-				{
-					const StaticMeshSection& section = sections[i];
-					const uint32 itemIx = gpuSceneItemIndexAllocator->allocate();
-					gpuSceneResidency.itemIndices[i] = itemIx;
-
-					GPUSceneAllocCommand allocCmd{
-						.sceneItemIndex = itemIx,
-						.sceneItem      = createGPUSceneItem(section, transform.getMatrix(), prevModelMatrix),
-					};
-					sceneProxy->gpuSceneAllocCommands.emplace_back(allocCmd);
-
-					GPUSceneMaterialCommand materialCmd{
-						.sceneItemIndex = itemIx,
-						.materialData   = createMaterialConstants(section.material.get(), itemIx),
-					};
-					sceneProxy->gpuSceneMaterialCommands.emplace_back(materialCmd);
-					sceneProxy->gpuSceneAlbedoTextures.push_back(getAlbedoTexture(section.material));
-				}
-				gpuSceneResidency.phase = EGPUResidencyPhase::Allocated;
+				gpuSceneResidency.phase = EGPUResidencyPhase::NeedToAllocate;
 			}
-			break;
-		case EGPUResidencyPhase::Allocated:
-			// Do nothing.
-			break;
+			return numSections;
 		case EGPUResidencyPhase::NeedToEvict:
-			for (size_t i = 0; i < numSections; ++i)
+			if (gpuSceneResidency.itemRange.count > 0)
 			{
-				const uint32 itemIx = gpuSceneResidency.itemIndices[i];
-				gpuSceneItemIndexAllocator->deallocate(itemIx);
-
-				GPUSceneEvictCommand cmd{
-					.sceneItemIndex = itemIx
-				};
-				sceneProxy->gpuSceneEvictCommands.emplace_back(cmd);
-
-				GPUSceneEvictMaterialCommand materialCmd{
-					.sceneItemIndex = itemIx
-				};
-				sceneProxy->gpuSceneEvictMaterialCommands.emplace_back(materialCmd);
+				outItemRangesToFree.push_back(gpuSceneResidency.itemRange);
 			}
-			gpuSceneResidency.phase = EGPUResidencyPhase::NotAllocated;
-			gpuSceneResidency.itemIndices.clear();
-			break;
+			return 0;
 		case EGPUResidencyPhase::NeedToReallocate:
-			for (size_t i = 0; i < gpuSceneResidency.itemIndices.size(); ++i)
+			if (gpuSceneResidency.itemRange.count > 0)
 			{
-				const uint32 itemIx = gpuSceneResidency.itemIndices[i];
-				gpuSceneItemIndexAllocator->deallocate(itemIx);
+				outItemRangesToFree.push_back(gpuSceneResidency.itemRange);
+			}
+			return numSections;
+		case EGPUResidencyPhase::Allocated:
+		case EGPUResidencyPhase::NeedToUpdate:
+			return 0;
+		default:
+			CHECK_NO_ENTRY();
+			return 0;
+	}
+}
 
-				GPUSceneEvictCommand cmd{
-					.sceneItemIndex = itemIx
-				};
-				sceneProxy->gpuSceneEvictCommands.emplace_back(cmd);
+uint32 StaticMesh::recordGPUSceneCommands(GPUSceneCommandBuffer& outCommands, const uint32* newItemRangeStarts)
+{
+	const std::vector<StaticMeshSection>& sections = LODs[activeLOD]->sections;
+	const size_t numSections = sections.size();
 
-				GPUSceneEvictMaterialCommand materialCmd{
-					.sceneItemIndex = itemIx
-				};
-				sceneProxy->gpuSceneEvictMaterialCommands.emplace_back(materialCmd);
-			}
-			gpuSceneResidency.itemIndices.resize(numSections);
-			for (size_t i = 0; i < numSections; ++i)
-			{
-				const StaticMeshSection& section = sections[i];
-				const uint32 itemIx = gpuSceneItemIndexAllocator->allocate();
-				gpuSceneResidency.itemIndices[i] = itemIx;
+	auto recordEvictCommands = [this, &outCommands]()
+	{
+		const GPUSceneItemRange& range = gpuSceneResidency.itemRange;
+		for (uint32 itemIx = range.first; itemIx < range.first + range.count; ++itemIx)
+		{
+			GPUSceneEvictCommand cmd{
+				.sceneItemIndex = itemIx
+			};
+			outCommands.evictCommands.emplace_back(cmd);
 
-				GPUSceneAllocCommand allocCmd{
-					.sceneItemIndex = itemIx,
-					.sceneItem      = createGPUSceneItem(section, transform.getMatrix(), prevModelMatrix),
-				};
-				sceneProxy->gpuSceneAllocCommands.emplace_back(allocCmd);
+			GPUSceneEvictMaterialCommand materialCmd{
+				.sceneItemIndex = itemIx
+			};
+			outCommands.evictMaterialCommands.emplace_back(materialCmd);
+		}
+	};
+	// @return Number of consumed ranges.
+	auto recordAllocCommands = [this, &outCommands, &sections, numSections, newItemRangeStarts]() -> uint32
+	{
+		if (numSections == 0)
+		{
+			gpuSceneResidency.itemRange = GPUSceneItemRange{};
+			return 0;
+		}
+		gpuSceneResidency.itemRange = GPUSceneItemRange{ newItemRangeStarts[0], (uint32)numSections };
+		gpuSceneResidency.numPendingAlbedoTextures = 0;
+		gpuSceneResidency.albedoViewRevision = 0;
+		for (size_t i = 0; i < numSections; ++i)
+		{
+			const StaticMeshSection& section = sections[i];
+			const uint32 itemIx = newItemRangeStarts[0] + (uint32)i;
 
-				GPUSceneMaterialCommand materialCmd{
-					.sceneItemIndex = itemIx,
-					.materialData   = createMaterialConstants(section.material.get(), itemIx)
-				};
-				sceneProxy->gpuSceneMaterialCommands.emplace_back(materialCmd);
-				sceneProxy->gpuSceneAlbedoTextures.push_back(getAlbedoTexture(section.material));
-			}
+			GPUSceneAllocCommand allocCmd{
+				.sceneItemIndex = itemIx,
+				.sceneItem      = createGPUSceneItem(section, transform.getMatrix(), prevModelMatrix),
+			};
+			outCommands.allocCommands.emplace_back(allocCmd);
+
+			GPUSceneMaterialCommand materialCmd{
+				.sceneItemIndex = itemIx,
+				.materialData   = createMaterialConstants(section.material.get(), itemIx),
+			};
+			outCommands.materialCommands.emplace_back(materialCmd);
+			outCommands.albedoTextures.push_back(getAlbedoTexture(section.material, gpuSceneResidency.numPendingAlbedoTextures, gpuSceneResidency.albedoViewRevision));
+		}
+		return 1;
+	};
+
+	uint32 numConsumedRanges = 0;
+	gpuSceneResidency.bChangedInLastRecord = (gpuSceneResidency.phase == EGPUResidencyPhase::NeedToAllocate)
+		|| (gpuSceneResidency.phase == EGPUResidencyPhase::NeedToReallocate)
+		|| (gpuSceneResidency.phase == EGPUResidencyPhase::NeedToUpdate);
+	switch (gpuSceneResidency.phase)
+	{
+		case EGPUResidencyPhase::NotAllocated:
+			// GPU resources are not ready.
+			break;
+		case EGPUResidencyPhase::NeedToAllocate:
+			numConsumedRanges = recordAllocCommands();
+			gpuSceneResidency.phase = EGPUResidencyPhase::Allocated;
+			break;
+		case EGPUResidencyPhase::Allocated:
+			// Do nothing.
+			break;
+		case EGPUResidencyPhase::NeedToEvict:
+			recordEvictCommands();
+			gpuSceneResidency.phase = EGPUResidencyPhase::NotAllocated;
+			gpuSceneResidency.itemRange = GPUSceneItemRange{};
+			gpuSceneResidency.numPendingAlbedoTextures = 0;
+			gpuSceneResidency.albedoViewRevision = 0;
+			break;
+		case EGPUResidencyPhase::NeedToReallocate:
+			recordEvictCommands();
+			numConsumedRanges = recordAllocCommands();
 			gpuSceneResidency.phase = EGPUResidencyPhase::Allocated;
 			break;
 		// #todo-gpuscene: Separate transform update and material update.
@@ -229,17 +300,22 @@ void StaticMesh::updateGPUSceneResidency(SceneProxy* sceneProxy, GPUSceneItemInd
 			
 			// MaterialAsset needs to hide its public fields and provide public methods for dirty flags.
 			// Same for StaticMeshSection.
+			gpuSceneResidency.numPendingAlbedoTextures = 0;
+			gpuSceneResidency.albedoViewRevision = 0;
 			for (size_t i = 0; i < numSections; ++i)
 			{
 				const StaticMeshSection& section = sections[i];
-				const uint32 itemIx = gpuSceneResidency.itemIndices[i];
+				const uint32 itemIx = gpuSceneResidency.itemRange.first + (uint32)i;
 
+				// prevModelMatrix is what was uploaded in the last alloc or update,
+				// as transformDirtyCounter keeps updating one more frame after the transform stops changing.
 				GPUSceneUpdateCommand cmd{
-					.sceneItemIndex   = itemIx,
-					.localToWorld     = transform.getMatrix(),
-					.prevLocalToWorld = prevModelMatrix,
+					.sceneItemIndex            = itemIx,
+					.bPrevLocalToWorldResident = true,
+					.localToWorld              = transform.getMatrix(),
+					.prevLocalToWorld          = prevModelMatrix,
 				};
-				sceneProxy->gpuSceneUpdateCommands.emplace_back(cmd);
+				outCommands.updateCommands.emplace_back(cmd);
 
 				GPUSceneEvictMaterialCommand evictMaterialCmd{
 					.sceneItemIndex = itemIx
@@ -248,10 +324,10 @@ void StaticMesh::updateGPUSceneResidency(SceneProxy* sceneProxy, GPUSceneItemInd
 					.sceneItemIndex = itemIx,
 					.materialData   = createMaterialConstants(section.material.get(), itemIx)
 				};
-				sceneProxy->gpuSceneEvictMaterialCommands.emplace_back(evictMaterialCmd);
-				sceneProxy->gpuSceneMaterialCommands.emplace_back(materialCmd);
-				sceneProxy->gpuSceneAlbedoTextures.push_back(getAlbedoTexture(section.material));
-				sceneProxy->dirtyMaterials.push_back(section.material.get());
+				outCommands.evictMaterialCommands.emplace_back(evictMaterialCmd);
+				outCommands.materialCommands.emplace_back(materialCmd);
+				outCommands.albedoTextures.push_back(getAlbedoTexture(section.material, gpuSceneResidency.numPendingAlbedoTextures, gpuSceneResidency.albedoViewRevision));
+				outCommands.dirtyMaterials.push_back(section.material.get());
 			}
 			gpuSceneResidency.phase = EGPUResidencyPhase::Allocated;
 			break;
@@ -259,6 +335,7 @@ void StaticMesh::updateGPUSceneResidency(SceneProxy* sceneProxy, GPUSceneItemInd
 			CHECK_NO_ENTRY();
 			break;
 	}
+	return numConsumedRanges;
 }
 
 void StaticMesh::markToEvictFromGPUScene()
@@ -267,17 +344,25 @@ void StaticMesh::markToEvictFromGPUScene()
 	gpuSceneResidency.phase = EGPUResidencyPhase::NeedToEvict;
 }
 
-StaticMeshProxy* StaticMesh::createStaticMeshProxy(StackAllocator* allocator) const
+StaticMeshProxy* StaticMesh::createStaticMeshProxy(SceneProxy* sceneProxy) const
 {
-	StaticMeshProxy* proxy = static_cast<StaticMeshProxy*>(allocator->alloc(sizeof(StaticMeshProxy)));
+	StaticMeshProxy* proxy = static_cast<StaticMeshProxy*>(sceneProxy->staticMeshProxyAllocator->alloc(sizeof(StaticMeshProxy)));
+	sceneProxy->staticMeshLODs.emplace_back();
+	initStaticMeshProxy(proxy, sceneProxy->staticMeshLODs.back());
+	return proxy;
+}
 
-	proxy->lod              = &(LODs[activeLOD]);
-	proxy->localToWorld     = transform.getMatrix();
-	proxy->prevLocalToWorld = prevModelMatrix;
-	proxy->bTransformDirty  = isTransformDirty();
-	proxy->bLodDirty        = bLodDirty;
+void StaticMesh::initStaticMeshProxy(StaticMeshProxy* outProxy, SharedPtr<const StaticMeshLOD>& outLODRef) const
+{
+	outLODRef = LODs[activeLOD];
 
-	return proxy;
+	outProxy->lod                   = LODs[activeLOD].get();
+	outProxy->localToWorld          = transform.getMatrix();
+	outProxy->prevLocalToWorld      = prevModelMatrix;
+	outProxy->bTransformDirty       = isTransformDirty();
+	outProxy->bLodDirty             = bLodDirty;
+	outProxy->bGPUSceneItemsChanged = gpuSceneResidency.bChangedInLastRecord;
+	outProxy->gpuSceneItemRange     = gpuSceneResidency.itemRange;
 }
 
 void StaticMesh::addSection(
@@ -291,8 +376,17 @@ void StaticMesh::addSection(
 	if (LODs.size() <= lod)
 	{
 		LODs.resize(lod + 1);
+		for (SharedPtr<StaticMeshLOD>& lodPtr : LODs)
+		{
+			if (lodPtr == nullptr) lodPtr = makeShared<StaticMeshLOD, EMemoryTag::World>();
+		}
+	}
+	// Scene proxies of frames in flight might be reading this LOD.
+	if (LODs[lod].use_count() > 1)
+	{
+		LODs[lod] = makeShared<StaticMeshLOD, EMemoryTag::World>(*LODs[lod]);
 	}
-	LODs[lod].sections.emplace_back(
+	LODs[lod]->sections.emplace_back(
 		StaticMeshSection{
 			.positionBuffer    = positionBuffer,
 			.nonPositionBuffer = nonPositionBuffer,
@@ -2,15 +2,16 @@
 
 #include "core/core_minimal.h"
 #include "core/smart_pointer.h"
+#include "core/slot_map.h"
 #include "geometry/transform.h"
 #include "world/gpu_resource_asset.h"
 #include "world/material_asset.h"
+#include "render/gpu_scene_command.h"
 
 #include <vector>
 
 class SceneProxy;
 class StackAllocator;
-class GPUSceneItemIndexAllocator;
 
 struct StaticMeshSection
 {
@@ -28,12 +29,13 @@ struct StaticMeshLOD
 
 struct StaticMeshProxy
 {
-	const StaticMeshLOD* lod; // #todo-renderer: Use-after-free hazard when multithreading comes.
-	                          // but must be a pointer for now, as StaticMeshProxy is allocated by StackAllocator so should be a POD.
+	const StaticMeshLOD* lod; // Kept alive by SceneProxy::staticMeshLODs, as StaticMeshProxy is allocated by StackAllocator so should be a POD.
 	Matrix               localToWorld;
 	Matrix               prevLocalToWorld;
 	bool                 bTransformDirty;
 	bool                 bLodDirty;
+	bool                 bGPUSceneItemsChanged; // Items were (re)allocated or updated in this frame.
+	GPUSceneItemRange    gpuSceneItemRange;     // Section i is at (first + i). Empty if not resident.
 
 	inline const std::vector<StaticMeshSection>& getSections() const { return lod->sections; }
 	inline const Matrix& getLocalToWorld() const { return localToWorld; }
@@ -47,10 +49,33 @@ class StaticMesh
 public:
 	~StaticMesh();
 
-	void updateGPUSceneResidency(SceneProxy* sceneProxy, GPUSceneItemIndexAllocator* gpuSceneItemIndexAllocator);
+	// GPU scene residency is updated in two steps so that meshes can be processed in parallel.
+	// Item ranges are freed and allocated in between, in a batch. (See Scene::createProxy)
+	// Sections of the active LOD occupy consecutive item indices, one range per mesh.
+	// NOTE: activeLOD should have been updated already.
+	// 1. Decides how residency changes. Item range to free is appended to outItemRangesToFree.
+	//    @return Size of the item range to allocate. 0 if no allocation is needed.
+	uint32 prepareGPUSceneResidency(std::vector<GPUSceneItemRange>& outItemRangesToFree);
+	// 2. Records gpu scene commands. newItemRangeStarts[0] should be the first index of
+	//    a new range of the size that step 1 returned.
+	//    @return Number of consumed ranges. 1 if step 1 returned non-zero, 0 otherwise.
+	uint32 recordGPUSceneCommands(GPUSceneCommandBuffer& outCommands, const uint32* newItemRangeStarts);
+
 	void markToEvictFromGPUScene();
 	inline bool isMarkedToBeEvictedFromGPUScene() const { return gpuSceneResidency.phase == EGPUResidencyPhase::NeedToEvict; }
-	StaticMeshProxy* createStaticMeshProxy(StackAllocator* allocator) const;
+	// Also adds a reference of the active LOD to the scene proxy, so that the render thread can read it
+	// even if this mesh changes or is destroyed meanwhile.
+	StaticMeshProxy* createStaticMeshProxy(SceneProxy* sceneProxy) const;
+	// Same as above, but the caller provides storage so that proxies can be filled in parallel.
+	void initStaticMeshProxy(StaticMeshProxy* outProxy, SharedPtr<const StaticMeshLOD>& outLODRef) const;
+
+	// Buffers of sections of the active LOD are created and their uploads are complete.
+	// GPU scene items and BLASes read them, so they wait until then.
+	bool isGeometryUploadComplete() const;
+
+	// Handle in the owning scene. Managed by Scene.
+	inline SlotHandle getSceneHandle() const { return sceneHandle; }
+	inline void setSceneHandle(SlotHandle handle) { sceneHandle = handle; }
 
 	void addSection(
 		uint32 lod,
@@ -63,7 +88,7 @@ public:
 	inline const std::vector<StaticMeshSection>& getSections(uint32 lod) const
 	{
 		CHECK(lod < LODs.size());
-		return LODs[lod].sections;
+		return LODs[lod]->sections;
 	}
 
 	inline size_t getNumLODs() const { return LODs.size(); }
@@ -112,7 +137,8 @@ public:
 	}
 
 private:
-	std::vector<StaticMeshLOD> LODs;
+	// Shared with scene proxies of frames in flight. Copied on write.
+	std::vector<SharedPtr<StaticMeshLOD>> LODs;
 	uint32 activeLOD = 0;
 
 	Transform transform;
@@ -120,6 +146,8 @@ private:
 	int32 transformDirtyCounter = 0; // Was a boolean, but modified to update prev model matrix.
 	bool bLodDirty = false;
 
+	SlotHandle sceneHandle;
+
 private:
 	enum class EGPUResidencyPhase : uint32
 	{
@@ -128,14 +156,20 @@ private:
 		NeedToEvict      = 2, // Allocated but need to evict.
 		NeedToReallocate = 3, // Allocated but need to evict and allocate again. (e.g., LOD change)
 		NeedToUpdate     = 4, // Allocated but need to update in-place. (e.g., transform change)
+		NeedToAllocate   = 5, // Not allocated and GPU resources are ready.
 	};
 	struct GPUSceneResidency
 	{
 		EGPUResidencyPhase phase = EGPUResidencyPhase::NotAllocated;
-		// #todo-gpuscene: Could be just [start,end) if indices are consecutive.
-		// FreeNumberList does not provide such API yet, and it will make (max_item_ix >= element_count).
-		// Currently, residency can be sparse but at least (max_item_ix < element_count) holds.
-		std::vector<uint32> itemIndices;
+		bool bChangedInLastRecord = false;
+		// Section i of the active LOD is at (itemRange.first + i).
+		// Ranges are allocated first fit, so (max_item_ix < element_count) does not hold
+		// if the allocator is fragmented, but the gpu scene is sized by the max index anyway.
+		GPUSceneItemRange itemRange;
+		// Albedo textures that were bound as the fallback texture in the last record, as their uploads were pending.
+		uint32 numPendingAlbedoTextures = 0;
+		// Sum of view revisions of albedo textures in the last record.
+		uint32 albedoViewRevision = 0;
 	};
 	GPUSceneResidency gpuSceneResidency;
 };
@@ -0,0 +1,235 @@
+#include "static_mesh_draw_buckets.h"
+#include "static_mesh.h"
+#include "world/scene_proxy.h"
+#include "core/assertion.h"
+
+#include <algorithm>
+
+uint64 makeStaticMeshDrawSortKey(uint32 pipelineFreeNumber, uint64 positionBufferOffset, uint64 indexBufferOffset, uint32 materialID)
+{
+	CHECK(pipelineFreeNumber < 256);
+	const uint64 positionPage = (positionBufferOffset >> STATIC_MESH_DRAW_PAGE_SIZE_LOG2) & 0xfffff;
+	const uint64 indexPage = (indexBufferOffset >> STATIC_MESH_DRAW_PAGE_SIZE_LOG2) & 0xfffff;
+	return ((uint64)pipelineFreeNumber << 56)
+		| (positionPage << 36)
+		| (indexPage << 16)
+		| (uint64)(materialID & 0xffff);
+}
+
+uint64 makeStaticMeshDrawSortKey(const StaticMeshSection& section)
+{
+	return makeStaticMeshDrawSortKey(
+		section.material->getPipelineFreeNumber(),
+		section.positionBuffer->getGPUResource()->getBufferOffsetInBytes(),
+		section.indexBuffer->getGPUResource()->getBufferOffsetInBytes(),
+		(uint32)section.material->getMaterialID());
+}
+
+StaticMeshDrawKey* radixSortStaticMeshDrawKeys(StaticMeshDrawKey* keys, StaticMeshDrawKey* scratch, size_t numKeys)
+{
+	if (numKeys < 2)
+	{
+		return keys;
+	}
+	CHECK(numKeys <= 0xffffffff);
+
+	// Histograms of all digits in one pass.
+	uint32 counts[8][256] = {};
+	for (size_t i = 0; i < numKeys; ++i)
+	{
+		for (uint32 digit = 0; digit < 8; ++digit)
+		{
+			counts[digit][(keys[i].sortKey >> (digit * 8)) & 0xff] += 1;
+		}
+	}
+
+	StaticMeshDrawKey* src = keys;
+	StaticMeshDrawKey* dst = scratch;
+	for (uint32 digit = 0; digit < 8; ++digit)
+	{
+		const uint32 shift = digit * 8;
+		uint32* count = counts[digit];
+		if (count[(src[0].sortKey >> shift) & 0xff] == (uint32)numKeys)
+		{
+			continue;
+		}
+
+		uint32 offset = 0;
+		for (uint32 i = 0; i < 256; ++i)
+		{
+			const uint32 n = count[i];
+			count[i] = offset;
+			offset += n;
+		}
+		for (size_t i = 0; i < numKeys; ++i)
+		{
+			dst[count[(src[i].sortKey >> shift) & 0xff]++] = src[i];
+		}
+		std::swap(src, dst);
+	}
+	return src;
+}
+
+void radixSortStaticMeshDrawKeys(std::vector<StaticMeshDrawKey>& keys, std::vector<StaticMeshDrawKey>& scratch)
+{
+	scratch.resize(keys.size());
+	if (radixSortStaticMeshDrawKeys(keys.data(), scratch.data(), keys.size()) != keys.data())
+	{
+		keys.swap(scratch);
+	}
+}
+
+void StaticMeshDrawBuckets::update(const SceneProxy* scene, LinearAllocator* allocator)
+{
+	if (bNeedsRebuild || buckets.size() != scene->sceneItemsPerPipeline.size())
+	{
+		rebuild(scene, allocator);
+		return;
+	}
+
+	numChangedItems = 0;
+	for (const GPUSceneEvictCommand& cmd : scene->gpuSceneEvictCommands)
+	{
+		if (removeItem(cmd.sceneItemIndex))
+		{
+			numChangedItems += 1;
+		}
+	}
+	LinearVector<StaticMeshDrawKey> pending{ LinearStlAllocator<StaticMeshDrawKey>(allocator) };
+	for (size_t i = 0; i < scene->staticMeshes.size(); ++i)
+	{
+		if (scene->staticMeshes[i]->bGPUSceneItemsChanged)
+		{
+			addProxySections(scene, i, pending);
+		}
+	}
+	finalizeBuckets(pending, allocator);
+}
+
+void StaticMeshDrawBuckets::rebuild(const SceneProxy* scene, LinearAllocator* allocator)
+{
+	items.clear();
+	buckets.clear();
+	buckets.resize(scene->sceneItemsPerPipeline.size());
+
+	numChangedItems = 0;
+	LinearVector<StaticMeshDrawKey> pending{ LinearStlAllocator<StaticMeshDrawKey>(allocator) };
+	pending.reserve(scene->totalMeshSectionsLOD0);
+	for (size_t i = 0; i < scene->staticMeshes.size(); ++i)
+	{
+		addProxySections(scene, i, pending);
+	}
+	finalizeBuckets(pending, allocator);
+	bNeedsRebuild = false;
+}
+bool StaticMeshDrawBuckets::removeItem(uint32 sceneItemIndex)
+{
+	if (sceneItemIndex >= items.size() || items[sceneItemIndex].section == nullptr)
+	{
+		return false;
+	}
+	ItemSlot& slot = items[sceneItemIndex];
+	buckets[slot.bucket].numStale += 1;
+	slot.lod.reset();
+	slot.section = nullptr;
+	slot.sortKey = 0;
+	slot.bucket  = 0xffffffff;
+	slot.version += 1;
+	return true;
+}
+
+void StaticMeshDrawBuckets::setItem(uint32 sceneItemIndex, const StaticMeshSection& section, uint32 pipelineFreeNumber, const SharedPtr<const StaticMeshLOD>& lod,
+	LinearVector<StaticMeshDrawKey>& outPending)
+{
+	if (sceneItemIndex >= items.size())
+	{
+		items.resize(sceneItemIndex + 1);
+	}
+	const uint64 sortKey = makeStaticMeshDrawSortKey(section);
+
+	// Transform-only updates don't change draws.
+	ItemSlot& slot = items[sceneItemIndex];
+	if (slot.section == &section && slot.sortKey == sortKey && slot.bucket == pipelineFreeNumber)
+	{
+		return;
+	}
+	removeItem(sceneItemIndex);
+
+	CHECK(pipelineFreeNumber < buckets.size());
+	slot.lod     = lod;
+	slot.section = &section;
+	slot.sortKey = sortKey;
+	slot.bucket  = pipelineFreeNumber;
+	outPending.emplace_back(StaticMeshDrawKey{ sortKey, sceneItemIndex, slot.version });
+	numChangedItems += 1;
+}
+
+void StaticMeshDrawBuckets::addProxySections(const SceneProxy* scene, size_t proxyIndex, LinearVector<StaticMeshDrawKey>& outPending)
+{
+	const StaticMeshProxy* proxy = scene->staticMeshes[proxyIndex];
+	const GPUSceneItemRange& range = proxy->gpuSceneItemRange;
+	const std::vector<StaticMeshSection>& sections = proxy->getSections();
+	if (range.count == 0)
+	{
+		// GPU resources are not ready.
+		return;
+	}
+	CHECK(range.count == (uint32)sections.size());
+
+	for (uint32 i = 0; i < range.count; ++i)
+	{
+		const StaticMeshSection& section = sections[i];
+		setItem(range.first + i, section, section.material->getPipelineFreeNumber(), scene->staticMeshLODs[proxyIndex], outPending);
+	}
+}
+
+void StaticMeshDrawBuckets::finalizeBuckets(LinearVector<StaticMeshDrawKey>& pending, LinearAllocator* allocator)
+{
+	auto isStale = [this](const StaticMeshDrawKey& key)
+	{
+		return items[key.sceneItemIndex].version != key.version;
+	};
+	auto compareKeys = [](const StaticMeshDrawKey& a, const StaticMeshDrawKey& b)
+	{
+		return a.sortKey < b.sortKey;
+	};
+
+	for (Bucket& bucket : buckets)
+	{
+		if (bucket.numStale > 0)
+		{
+			std::erase_if(bucket.draws, isStale);
+			bucket.numStale = 0;
+		}
+	}
+	// An item might have been set twice in this update.
+	std::erase_if(pending, isStale);
+
+	// Sort new keys of all buckets at once. The pipeline free number is the top byte of the sort key,
+	// so sorted keys are grouped by bucket and each group is merged into already sorted ones.
+	const size_t numPending = pending.size();
+	StaticMeshDrawKey* scratch = allocator->allocArray<StaticMeshDrawKey>(numPending);
+	const StaticMeshDrawKey* sorted = radixSortStaticMeshDrawKeys(pending.data(), scratch, numPending);
+
+	numSortedBuckets = 0;
+	for (size_t first = 0; first < numPending; )
+	{
+		const uint32 bucketIx = (uint32)(sorted[first].sortKey >> 56);
+		size_t last = first + 1;
+		while (last < numPending && (uint32)(sorted[last].sortKey >> 56) == bucketIx)
+		{
+			++last;
+		}
+		CHECK(bucketIx < buckets.size());
+
+		std::vector<StaticMeshDrawKey>& draws = buckets[bucketIx].draws;
+		const size_t numSorted = draws.size();
+		draws.insert(draws.end(), sorted + first, sorted + last);
+		if (numSorted > 0)
+		{
+			std::inplace_merge(draws.begin(), draws.begin() + numSorted, draws.end(), compareKeys);
+		}
+		numSortedBuckets += 1;
+		first = last;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "core/int_types.h"
+#include "core/smart_pointer.h"
+#include "memory/frame_allocator.h"
+
+#include <vector>
+
+struct StaticMeshSection;
+struct StaticMeshLOD;
+class SceneProxy;
+
+// Offsets in vertex/index buffer pools are grouped by pages of this size in the sort key.
+#define STATIC_MESH_DRAW_PAGE_SIZE_LOG2 16
+
+// Sort key of a mesh section draw. Draws are issued in ascending order to minimize state changes.
+// [63:56] pipeline free number, [55:36] position buffer page, [35:16] index buffer page, [15:0] material id
+uint64 makeStaticMeshDrawSortKey(uint32 pipelineFreeNumber, uint64 positionBufferOffset, uint64 indexBufferOffset, uint32 materialID);
+uint64 makeStaticMeshDrawSortKey(const StaticMeshSection& section);
+
+struct StaticMeshDrawKey
+{
+	uint64 sortKey;
+	uint32 sceneItemIndex; // Also the object ID of the draw.
+	uint32 version;        // Stale if it differs from the current version of the item.
+};
+
+// LSD radix sort by sortKey, 8 bits per pass. Stable.
+// Passes where all keys have the same digit are skipped, so keys that differ only in a few bytes sort fast.
+// @param scratch At least numKeys elements.
+// @return Either keys or scratch, whichever has the sorted keys.
+StaticMeshDrawKey* radixSortStaticMeshDrawKeys(StaticMeshDrawKey* keys, StaticMeshDrawKey* scratch, size_t numKeys);
+void radixSortStaticMeshDrawKeys(std::vector<StaticMeshDrawKey>& keys, std::vector<StaticMeshDrawKey>& scratch);
+
+// Persistent static mesh draws, bucketed by pipeline and sorted by sort key.
+// Updated incrementally from gpu scene changes of each scene proxy, so meshes that did not change
+// cost nothing per frame. Every scene proxy should be given to update() in order,
+// otherwise call invalidate() so that the next update() rebuilds everything.
+class StaticMeshDrawBuckets
+{
+public:
+	// Applies evicted, (re)allocated and updated gpu scene items of the scene proxy. Only changed buckets are sorted.
+	// Material edits update gpu scene items, so sections that move to another pipeline are also handled here.
+	// @param allocator Scratch memory for new keys, e.g., FrameInfo::frameAllocator.
+	void update(const SceneProxy* scene, LinearAllocator* allocator);
+	// Discards all draws and collects them again from all static mesh proxies.
+	void rebuild(const SceneProxy* scene, LinearAllocator* allocator);
+	inline void invalidate() { bNeedsRebuild = true; }
+
+	inline uint32 getNumBuckets() const { return (uint32)buckets.size(); }
+	// Draws of a pipeline in sort key order.
+	inline const std::vector<StaticMeshDrawKey>& getDraws(uint32 pipelineFreeNumber) const { return buckets[pipelineFreeNumber].draws; }
+	inline const StaticMeshSection* getSection(uint32 sceneItemIndex) const { return items[sceneItemIndex].section; }
+
+	// Stats of the last update() or rebuild()
+	inline uint32 getNumChangedItems() const { return numChangedItems; }
+	inline uint32 getNumSortedBuckets() const { return numSortedBuckets; }
+
+private:
+	struct ItemSlot
+	{
+		SharedPtr<const StaticMeshLOD> lod; // Keeps section alive.
+		const StaticMeshSection*       section = nullptr;
+		uint64                         sortKey = 0;
+		uint32                         bucket  = 0xffffffff;
+		uint32                         version = 0;
+	};
+	struct Bucket
+	{
+		std::vector<StaticMeshDrawKey> draws; // Sorted. Might contain stale keys until finalizeBuckets().
+		uint32                         numStale = 0;
+	};
+
+	// @return false if the item had no draw.
+	bool removeItem(uint32 sceneItemIndex);
+	void setItem(uint32 sceneItemIndex, const StaticMeshSection& section, uint32 pipelineFreeNumber, const SharedPtr<const StaticMeshLOD>& lod,
+		LinearVector<StaticMeshDrawKey>& outPending);
+	void addProxySections(const SceneProxy* scene, size_t proxyIndex, LinearVector<StaticMeshDrawKey>& outPending);
+	// @param pending Keys inserted in this update, of all buckets.
+	void finalizeBuckets(LinearVector<StaticMeshDrawKey>& pending, LinearAllocator* allocator);
+
+	std::vector<ItemSlot>          items; // index = gpu scene item index
+	std::vector<Bucket>            buckets; // index = pipeline free number
+	bool                           bNeedsRebuild = true;
+
+	uint32                         numChangedItems = 0;
+	uint32                         numSortedBuckets = 0;
+};
@@ -0,0 +1,97 @@
+#include "static_mesh_indirect_args.h"
+#include "static_mesh.h"
+#include "static_mesh_draw_buckets.h"
+#include "rhi/pipeline_state.h"
+#include "core/thread_pool.h"
+#include "core/assertion.h"
+
+static bool isDrawable(const StaticMeshSection* section)
+{
+	if (section == nullptr)
+	{
+		return false;
+	}
+	const IndexBuffer* indexBuffer = section->indexBuffer->getRawGPUResource();
+	return section->positionBuffer->getRawGPUResource() != nullptr
+		&& section->nonPositionBuffer->getRawGPUResource() != nullptr
+		&& indexBuffer != nullptr
+		&& indexBuffer->getIndexCount() > 0;
+}
+
+// @return The number of written commands.
+static uint32 writeDrawRange(
+	const IndirectCommandGenerator* generator,
+	const StaticMeshDrawBuckets& drawBuckets,
+	const std::vector<StaticMeshDrawKey>& draws,
+	uint32 begin, uint32 end,
+	uint8* dest)
+{
+	const uint32 byteStride = generator->getCommandByteStride();
+	uint32 numWritten = 0;
+	for (uint32 i = begin; i < end; ++i)
+	{
+		const StaticMeshSection* section = drawBuckets.getSection(draws[i].sceneItemIndex);
+		if (!isDrawable(section))
+		{
+			continue;
+		}
+		IndexBuffer* indexBuffer = section->indexBuffer->getRawGPUResource();
+
+		IndirectCommandCursor cursor;
+		generator->beginCommand(cursor, dest + (size_t)byteStride * numWritten);
+		generator->writeConstant32(cursor, draws[i].sceneItemIndex);
+		generator->writeVertexBufferView(cursor, section->positionBuffer->getRawGPUResource());
+		generator->writeVertexBufferView(cursor, section->nonPositionBuffer->getRawGPUResource());
+		generator->writeIndexBufferView(cursor, indexBuffer);
+		generator->writeDrawIndexedArguments(cursor, indexBuffer->getIndexCount(), 1, 0, 0, 0);
+		generator->endCommand(cursor);
+
+		++numWritten;
+	}
+	return numWritten;
+}
+
+uint32 writeStaticMeshIndirectCommands(
+	const IndirectCommandGenerator* generator,
+	const StaticMeshDrawBuckets& drawBuckets,
+	const std::vector<StaticMeshDrawKey>& draws,
+	uint8* dest,
+	ThreadPool* threadPool)
+{
+	const uint32 numDraws = (uint32)draws.size();
+	const uint32 grainSize = STATIC_MESH_INDIRECT_ARGS_GRAIN_SIZE;
+	if (threadPool == nullptr || threadPool->getNumThreads() == 1 || numDraws <= grainSize)
+	{
+		return writeDrawRange(generator, drawBuckets, draws, 0, numDraws, dest);
+	}
+
+	// 1. Count valid draws of each chunk.
+	const uint32 numChunks = ThreadPool::getNumChunks(numDraws, grainSize);
+	std::vector<uint32> chunkOffsets(numChunks + 1, 0);
+	threadPool->parallelFor(numDraws, grainSize, [&](uint32 chunkIx, uint32 begin, uint32 end)
+	{
+		uint32 count = 0;
+		for (uint32 i = begin; i < end; ++i)
+		{
+			count += isDrawable(drawBuckets.getSection(draws[i].sceneItemIndex)) ? 1 : 0;
+		}
+		chunkOffsets[chunkIx + 1] = count;
+	});
+
+	// 2. Prefix sum. chunkOffsets[i] is the first command index of chunk i.
+	for (uint32 chunkIx = 0; chunkIx < numChunks; ++chunkIx)
+	{
+		chunkOffsets[chunkIx + 1] += chunkOffsets[chunkIx];
+	}
+
+	// 3. Each chunk writes to its own range.
+	const uint32 byteStride = generator->getCommandByteStride();
+	threadPool->parallelFor(numDraws, grainSize, [&](uint32 chunkIx, uint32 begin, uint32 end)
+	{
+		uint8* chunkDest = dest + (size_t)byteStride * chunkOffsets[chunkIx];
+		const uint32 numWritten = writeDrawRange(generator, drawBuckets, draws, begin, end, chunkDest);
+		CHECK(numWritten == chunkOffsets[chunkIx + 1] - chunkOffsets[chunkIx]);
+	});
+
+	return chunkOffsets[numChunks];
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "core/int_types.h"
+
+#include <vector>
+
+class IndirectCommandGenerator;
+class ThreadPool;
+class StaticMeshDrawBuckets;
+struct StaticMeshDrawKey;
+
+// Draws per chunk when writing indirect commands in parallel.
+#define STATIC_MESH_INDIRECT_ARGS_GRAIN_SIZE 2048
+
+// Writes indirect draw commands of the draws to 'dest' in order.
+// Each command is (object id, position VBV, non-position VBV, IBV, draw indexed arguments).
+// Draws without GPU resources or indices are skipped and the rest are packed without holes.
+//
+// With a thread pool, draws are split into chunks. Each chunk counts its valid draws first,
+// then a prefix sum of the counts gives every chunk a disjoint range of 'dest' to write.
+// 'dest' is never read, so it can be write-combined memory like an upload ring allocation.
+//
+// @param dest At least (generator->getCommandByteStride() * draws.size()) bytes.
+// @return The number of written commands.
+uint32 writeStaticMeshIndirectCommands(
+	const IndirectCommandGenerator* generator,
+	const StaticMeshDrawBuckets& drawBuckets,
+	const std::vector<StaticMeshDrawKey>& draws,
+	uint8* dest,
+	ThreadPool* threadPool = nullptr);
@@ -2,13 +2,13 @@
 #include "render/gpu_scene.h"
 #include "render/gpu_culling.h"
 #include "render/static_mesh.h"
+#include "render/static_mesh_indirect_args.h"
 #include "rhi/render_device.h"
 #include "rhi/render_command.h"
+#include "rhi/upload_ring.h"
 #include "world/scene_proxy.h"
 #include "material/material_database.h"
 
-#define kMaxIndirectDrawCommandCount 256
-
 // -----------------------------------------
 // GraphicsPipelineKeyDesc
 
@@ -88,8 +88,10 @@ void IndirectDrawHelper::initialize(
 	commandSignature = UniquePtr<CommandSignature>(
 		device->createCommandSignature(commandSignatureDesc, pipelineState));
 
+	// Commands are written to the upload ring with the cursor API,
+	// so the internal memory of the generator is not used. See writeStaticMeshIndirectCommands().
 	argumentBufferGenerator = UniquePtr<IndirectCommandGenerator>(
-		device->createIndirectCommandGenerator(commandSignatureDesc, kMaxIndirectDrawCommandCount));
+		device->createIndirectCommandGenerator(commandSignatureDesc, 1));
 
 	// Create resources of fixed sizes. Other resources might be reallocated in resizeResources().
 	for (uint32 i = 0; i < maxFramesInFlight; ++i)
@@ -98,7 +100,7 @@ void IndirectDrawHelper::initialize(
 			BufferCreateParams{
 				.sizeInBytes = sizeof(uint32),
 				.alignment   = 0,
-				.accessFlags = EBufferAccessFlags::CPU_WRITE | EBufferAccessFlags::UAV,
+				.accessFlags = EBufferAccessFlags::COPY_DST | EBufferAccessFlags::UAV,
 			}
 		));
 
@@ -122,11 +124,6 @@ void IndirectDrawHelper::initialize(
 
 void IndirectDrawHelper::resizeResources(const FrameInfo& frameInfo, uint32 maxDrawCount)
 {
-	if (argumentBufferGenerator->getMaxCommandCount() < maxDrawCount)
-	{
-		argumentBufferGenerator->resizeMaxCommandCount(maxDrawCount);
-	}
-
 	uint32 requiredCapacity = argumentBufferGenerator->getCommandByteStride() * maxDrawCount;
 	Buffer* argBuffer = argumentBuffer.at(frameInfo.frameIndex);
 	Buffer* culledArgBuffer = culledArgumentBuffer.at(frameInfo.frameIndex);
@@ -137,7 +134,7 @@ void IndirectDrawHelper::resizeResources(const FrameInfo& frameInfo, uint32 maxD
 			BufferCreateParams{
 				.sizeInBytes = requiredCapacity,
 				.alignment   = 0,
-				.accessFlags = EBufferAccessFlags::CPU_WRITE | EBufferAccessFlags::SRV,
+				.accessFlags = EBufferAccessFlags::COPY_DST | EBufferAccessFlags::SRV,
 			}
 		));
 
@@ -218,37 +215,19 @@ void StaticMeshRendering::renderStaticMeshes(
 	const FrameInfo& frameInfo,
 	const StaticMeshRenderingInput& input)
 {
-	// #todo-renderer: Need smarter way to generate drawlists per pipeline if permutation blows up.
-	size_t kNumKeys = GraphicsPipelineKeyDesc::numPipelineKeyDescs();
-	std::vector<StaticMeshDrawList> drawsForPipelines(kNumKeys);
-
-	if (input.indirectDrawMode != EIndirectDrawMode::PopulateOnGPU)
-	{
-		for (size_t pipelineFN = 0; pipelineFN < kNumKeys; ++pipelineFN)
-		{
-			const uint32 maxDraws = input.scene->sceneItemsPerPipeline[pipelineFN];
-			drawsForPipelines[pipelineFN].reserve(maxDraws);
-		}
-		{
-			uint32 objectID = 0;
-			for (const StaticMeshProxy* mesh : input.scene->staticMeshes)
-			{
-				for (const StaticMeshSection& section : mesh->getSections())
-				{
-					uint32 pipelineFN = section.material->getPipelineFreeNumber();
-					drawsForPipelines[pipelineFN].meshes.push_back(&section);
-					drawsForPipelines[pipelineFN].objectIDs.push_back(objectID);
-					++objectID;
-				}
-			}
-		}
-	}
+	// Draw lists persist across frames and are sorted per pipeline. See StaticMeshDrawBuckets.
+	// PopulateOnGPU generates draws from the gpu scene instead.
+	static const std::vector<StaticMeshDrawKey> kNoDraws;
+	const bool bUseDrawBuckets = input.indirectDrawMode != EIndirectDrawMode::PopulateOnGPU;
+	CHECK(!bUseDrawBuckets || input.drawBuckets != nullptr);
 
+	size_t kNumKeys = GraphicsPipelineKeyDesc::numPipelineKeyDescs();
 	for (size_t i = 0; i < kNumKeys; ++i)
 	{
 		const auto& keyDesc = GraphicsPipelineKeyDesc::kPipelineKeyDescs[i];
 		const GraphicsPipelineKey key = GraphicsPipelineKeyDesc::assemblePipelineKey(keyDesc);
-		renderForPipeline(commandList, frameInfo, input, key, drawsForPipelines[i]);
+		const bool bHasBucket = bUseDrawBuckets && i < input.drawBuckets->getNumBuckets();
+		renderForPipeline(commandList, frameInfo, input, key, bHasBucket ? input.drawBuckets->getDraws((uint32)i) : kNoDraws);
 	}
 }
 
@@ -257,7 +236,7 @@ void StaticMeshRendering::renderForPipeline(
 	const FrameInfo& frameInfo,
 	const StaticMeshRenderingInput& input,
 	GraphicsPipelineKey pipelineKey,
-	const StaticMeshDrawList& drawList)
+	const std::vector<StaticMeshDrawKey>& draws)
 {
 	SCOPED_DRAW_EVENT(commandList, DrawStaticMeshes);
 
@@ -279,7 +258,7 @@ void StaticMeshRendering::renderForPipeline(
 	uint32 maxIndirectDraws, drawIDOffset;
 	if (indirectDrawMode == EIndirectDrawMode::PopulateOnCPU)
 	{
-		maxIndirectDraws = (uint32)drawList.meshes.size();
+		maxIndirectDraws = (uint32)draws.size();
 		drawIDOffset = 0;
 	}
 	else
@@ -311,34 +290,26 @@ void StaticMeshRendering::renderForPipeline(
 		}
 		else if (indirectDrawMode == EIndirectDrawMode::PopulateOnCPU)
 		{
-			uint32 indirectCommandID = 0;
-			for (size_t i = 0; i < drawList.meshes.size(); ++i)
-			{
-				const StaticMeshSection* section = drawList.meshes[i];
-				const uint32 objectID = drawList.objectIDs[i];
-
-				VertexBuffer* positionBuffer = section->positionBuffer->getGPUResource().get();
-				VertexBuffer* nonPositionBuffer = section->nonPositionBuffer->getGPUResource().get();
-				IndexBuffer* indexBuffer = section->indexBuffer->getGPUResource().get();
-
-				argumentBufferGenerator->beginCommand(indirectCommandID);
-
-				argumentBufferGenerator->writeConstant32(objectID);
-				argumentBufferGenerator->writeVertexBufferView(positionBuffer);
-				argumentBufferGenerator->writeVertexBufferView(nonPositionBuffer);
-				argumentBufferGenerator->writeIndexBufferView(indexBuffer);
-				argumentBufferGenerator->writeDrawIndexedArguments(indexBuffer->getIndexCount(), 1, 0, 0, 0);
-
-				argumentBufferGenerator->endCommand();
-
-				++indirectCommandID;
-			}
-
 			argumentBuffer = indirectDrawHelper->argumentBuffer.at(frameInfo.frameIndex);
 			drawCounterBuffer = nullptr;
 			argumentBufferSRV = indirectDrawHelper->argumentBufferSRV.at(frameInfo.frameIndex);
 
-			argumentBufferGenerator->copyToBuffer(commandList, maxIndirectDraws, argumentBuffer, 0);
+			// Write commands directly to the upload ring, in parallel if possible.
+			const uint64 byteStride = argumentBufferGenerator->getCommandByteStride();
+			UploadRingAllocation allocation = frameInfo.uploadRing->allocate(byteStride * maxIndirectDraws);
+			maxIndirectDraws = writeStaticMeshIndirectCommands(
+				argumentBufferGenerator, *input.drawBuckets, draws, allocation.cpuPtr, frameInfo.threadPool);
+			if (maxIndirectDraws == 0)
+			{
+				return;
+			}
+
+			frameInfo.uploadRing->copyToBuffer(
+				commandList,
+				allocation,
+				byteStride * maxIndirectDraws,
+				argumentBuffer,
+				0);
 		}
 		else
 		{
@@ -413,10 +384,10 @@ void StaticMeshRendering::renderForPipeline(
 	{
 		commandList->beginRenderPass();
 
-		for (size_t i = 0; i < drawList.meshes.size(); ++i)
+		for (const StaticMeshDrawKey& draw : draws)
 		{
-			const StaticMeshSection* section = drawList.meshes[i];
-			const uint32 objectID = drawList.objectIDs[i];
+			const StaticMeshSection* section = input.drawBuckets->getSection(draw.sceneItemIndex);
+			const uint32 objectID = draw.sceneItemIndex;
 
 			ShaderParameterTable SPT{};
 			SPT.pushConstant("pushConstants", objectID);
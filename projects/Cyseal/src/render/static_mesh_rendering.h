@@ -7,9 +7,11 @@
 #include "rhi/gpu_resource.h"
 #include "rhi/gpu_resource_view.h"
 #include "material/material_shader.h"
+#include "static_mesh_draw_buckets.h"
 
 #include <vector>
 #include <string>
+#include <map>
 
 struct StaticMeshSection;
 class SceneProxy;
@@ -67,25 +69,13 @@ private:
 // -----------------------------------------
 // Mesh rendering
 
-// Per-pipeline draw list.
-struct StaticMeshDrawList
-{
-	std::vector<const StaticMeshSection*> meshes;
-	std::vector<uint32> objectIDs;
-
-	void reserve(size_t n)
-	{
-		meshes.reserve(n);
-		objectIDs.reserve(n);
-	}
-};
-
 struct StaticMeshRenderingInput
 {
 	const SceneProxy*                       scene;
 	const Camera*                           camera;
 	EIndirectDrawMode                       indirectDrawMode;
 	bool                                    bGpuCulling;
+	const StaticMeshDrawBuckets*            drawBuckets; // Not used if PopulateOnGPU
 
 	GPUScene*                               gpuScene;
 	GPUCulling*                             gpuCulling;
@@ -106,5 +96,5 @@ private:
 		const FrameInfo& frameInfo,
 		const StaticMeshRenderingInput& input,
 		GraphicsPipelineKey pipelineKey,
-		const StaticMeshDrawList& drawList);
+		const std::vector<StaticMeshDrawKey>& draws);
 };
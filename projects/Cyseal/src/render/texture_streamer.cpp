@@ -0,0 +1,374 @@
+#include "texture_streamer.h"
+#include "rhi/texture.h"
+#include "rhi/upload_batcher.h"
+#include "rhi/pixel_format.h"
+#include "rhi/render_device.h"
+#include "rhi/render_command.h"
+#include "rhi/barrier_tracker.h"
+#include "core/assertion.h"
+
+#include <algorithm>
+
+TextureStreamer* gTextureStreamer = nullptr;
+
+TextureStreamer::~TextureStreamer()
+{
+	destroy();
+}
+
+void TextureStreamer::initialize(const TextureStreamingDesc& desc)
+{
+	manager = makeUnique<TextureStreamingManager>(desc, this);
+}
+
+void TextureStreamer::destroy()
+{
+	// The manager releases all textures through releaseTexture().
+	manager.reset();
+	textures.clear();
+	assetToHandle.clear();
+	// GPU is idle at shutdown.
+	retiredTextures.clear();
+}
+
+bool TextureStreamer::registerTexture(const SharedPtr<TextureAsset>& asset, const TextureCreateParams& createParams, const std::wstring& debugName, SharedPtr<ITextureMipSource> source)
+{
+	CHECK(asset != nullptr);
+	const uint32 numMips = getTextureNumMipLevels(createParams);
+
+	// Textures can start at any mip down to the tail, and the top mip of a block compressed texture
+	// should be a multiple of the block size.
+	if (isBlockCompressedFormat(createParams.format))
+	{
+		for (uint32 mip = 0; mip < numMips; ++mip)
+		{
+			const uint32 w = std::max(1u, createParams.width >> mip);
+			const uint32 h = std::max(1u, createParams.height >> mip);
+			if ((w % 4) != 0 || (h % 4) != 0)
+			{
+				return false;
+			}
+			if (std::max(w, h) <= manager->getDesc().minResidentMipSize)
+			{
+				break;
+			}
+		}
+	}
+
+	registeringAsset = asset;
+	registeringParams = &createParams;
+	registeringName = &debugName;
+	const SlotHandle handle = manager->registerTexture(std::move(source), createParams.format, createParams.width, createParams.height, numMips);
+	registeringAsset.reset();
+	registeringParams = nullptr;
+	registeringName = nullptr;
+	if (!handle.isValid())
+	{
+		return false;
+	}
+
+	// Mips of the tail were made resident before the texture exists.
+	StreamedTexture* streamed = findTexture(handle);
+	CHECK(streamed != nullptr && !streamed->pendingMips.empty());
+	const uint32 tailFirstMip = streamed->residentFirstMip;
+	const TextureCreateParams tailParams = TextureCreateParams::texture2D(
+		createParams.format,
+		createParams.accessFlags,
+		std::max(1u, createParams.width >> tailFirstMip),
+		std::max(1u, createParams.height >> tailFirstMip),
+		(uint16)(numMips - tailFirstMip));
+	streamed->texture = SharedPtr<Texture>(gRenderDevice->createTexture(tailParams));
+	streamed->texture->setDebugName(debugName.c_str());
+	streamed->textureFirstMip = tailFirstMip;
+
+	for (PendingMip& pending : streamed->pendingMips)
+	{
+		const uint64 rowPitch = getPixelFormatRowBytes(createParams.format, std::max(1u, createParams.width >> pending.mipLevel));
+		pending.uploadToken = gUploadBatcher->uploadTexture(streamed->texture, pending.mipLevel - tailFirstMip, pending.data->data(), rowPitch, pending.data);
+	}
+
+	// The asset is not bound until the tail is uploaded, so the tail is visible from the start.
+	streamed->visibleFirstMip = tailFirstMip;
+	assetToHandle[asset.get()] = handle;
+
+	asset->setUploadToken(streamed->pendingMips.back().uploadToken);
+	asset->setGPUResource(streamed->texture);
+	applyMinLOD(*streamed, true);
+	return true;
+}
+
+void TextureStreamer::addUsage(const SharedPtr<TextureAsset>& asset, const AABB& worldBounds, float worldUnitsPerUV)
+{
+	auto it = assetToHandle.find(asset.get());
+	if (it == assetToHandle.end())
+	{
+		return;
+	}
+	StreamedTexture* streamed = findTexture(it->second);
+	if (streamed == nullptr || streamed->bUnregistered)
+	{
+		return;
+	}
+	streamed->usages.push_back(manager->addUsage(streamed->handle, worldBounds, worldUnitsPerUV));
+}
+
+void TextureStreamer::flush(RenderCommandList* commandList)
+{
+	for (RetiredTexture& retired : retiredTextures)
+	{
+		if (--retired.numFlushesLeft == 0)
+		{
+			commandList->enqueueDeferredDealloc(new SharedPtr<Texture>(std::move(retired.texture)));
+		}
+	}
+	std::erase_if(retiredTextures, [](const RetiredTexture& retired) { return retired.numFlushesLeft == 0; });
+
+	for (StreamedTexture& streamed : textures)
+	{
+		if (!streamed.handle.isValid() || streamed.bUnregistered || streamed.texture == nullptr)
+		{
+			continue;
+		}
+		if (streamed.numRetiringFlushes > 0 && --streamed.numRetiringFlushes == 0)
+		{
+			streamed.retiredMinLOD = 0;
+			applyMinLOD(streamed);
+		}
+		if (streamed.residentFirstMip != streamed.textureFirstMip && !streamed.asset.expired())
+		{
+			reallocateTexture(commandList, streamed);
+		}
+	}
+}
+
+void TextureStreamer::update(const TextureStreamingView& view)
+{
+	for (StreamedTexture& streamed : textures)
+	{
+		if (streamed.handle.isValid() && !streamed.bUnregistered && streamed.asset.expired())
+		{
+			for (SlotHandle usage : streamed.usages)
+			{
+				manager->removeUsage(usage);
+			}
+			streamed.usages.clear();
+			streamed.bUnregistered = true;
+			// Might call releaseTexture() right away.
+			manager->unregisterTexture(streamed.handle);
+		}
+	}
+
+	manager->update(view);
+
+	for (StreamedTexture& streamed : textures)
+	{
+		if (streamed.handle.isValid())
+		{
+			updateVisibleMips(streamed);
+		}
+	}
+}
+
+void TextureStreamer::makeMipResident(SlotHandle handle, uint32 mipLevel, const uint8* data, uint64 size)
+{
+	StreamedTexture* streamed = findTexture(handle);
+	if (streamed == nullptr)
+	{
+		CHECK(registeringParams != nullptr && registeringName != nullptr);
+		if (handle.index >= textures.size())
+		{
+			textures.resize(handle.index + 1);
+		}
+		streamed = &textures[handle.index];
+		*streamed = StreamedTexture{};
+		streamed->handle = handle;
+		streamed->asset = registeringAsset;
+		streamed->createParams = *registeringParams;
+		streamed->numMips = getTextureNumMipLevels(*registeringParams);
+		streamed->debugName = *registeringName;
+		streamed->textureFirstMip = streamed->residentFirstMip = streamed->visibleFirstMip = streamed->numMips;
+	}
+
+	// The manager's data is only valid during this call, but it's kept until uploaded.
+	PendingMip pending{ mipLevel, UPLOAD_TOKEN_NONE, makeShared<std::vector<uint8>>(data, data + size) };
+
+	// Mips not in the current texture are uploaded after it's reallocated in flush().
+	if (streamed->texture != nullptr && mipLevel >= streamed->textureFirstMip)
+	{
+		const uint64 rowPitch = getPixelFormatRowBytes(streamed->createParams.format, std::max(1u, streamed->createParams.width >> mipLevel));
+		pending.uploadToken = gUploadBatcher->uploadTexture(streamed->texture, mipLevel - streamed->textureFirstMip, pending.data->data(), rowPitch, pending.data);
+	}
+
+	streamed->pendingMips.emplace_back(std::move(pending));
+	streamed->residentFirstMip = mipLevel;
+}
+
+void TextureStreamer::evictMip(SlotHandle handle, uint32 mipLevel)
+{
+	StreamedTexture* streamed = findTexture(handle);
+	CHECK(streamed != nullptr);
+
+	// Finer mips are evicted first, so pending uploads of this mip or finer ones are for evicted mips.
+	// They still complete, but are not made visible.
+	std::erase_if(streamed->pendingMips, [mipLevel](const PendingMip& pending) { return pending.mipLevel <= mipLevel; });
+	streamed->residentFirstMip = mipLevel + 1;
+	streamed->visibleFirstMip = std::max(streamed->visibleFirstMip, mipLevel + 1);
+
+	// Raised right away. Memory of the mip is released when the texture is reallocated in the next flush().
+	applyMinLOD(*streamed);
+}
+
+void TextureStreamer::releaseTexture(SlotHandle handle)
+{
+	StreamedTexture* streamed = findTexture(handle);
+	CHECK(streamed != nullptr);
+
+	// Searched by the handle, as the asset is usually released already.
+	std::erase_if(assetToHandle, [handle](const auto& item) { return item.second == handle; });
+
+	// Uploads in flight keep their own references. Scene proxies might still refer to the texture.
+	if (streamed->texture != nullptr)
+	{
+		retireTexture(std::move(streamed->texture));
+	}
+	*streamed = StreamedTexture{};
+}
+
+TextureStreamer::StreamedTexture* TextureStreamer::findTexture(SlotHandle handle)
+{
+	if (handle.index < textures.size() && textures[handle.index].handle == handle)
+	{
+		return &textures[handle.index];
+	}
+	return nullptr;
+}
+
+void TextureStreamer::reallocateTexture(RenderCommandList* commandList, StreamedTexture& streamed)
+{
+	const TextureCreateParams& params = streamed.createParams;
+	const uint32 oldFirstMip = streamed.textureFirstMip;
+	const uint32 newFirstMip = streamed.residentFirstMip;
+	CHECK(newFirstMip < streamed.numMips);
+
+	const TextureCreateParams newParams = TextureCreateParams::texture2D(
+		params.format,
+		params.accessFlags,
+		std::max(1u, params.width >> newFirstMip),
+		std::max(1u, params.height >> newFirstMip),
+		(uint16)(streamed.numMips - newFirstMip));
+	SharedPtr<Texture> newTexture(gRenderDevice->createTexture(newParams));
+	newTexture->setDebugName(streamed.debugName.c_str());
+
+	// Visible mips are copied on the GPU, except the ones still uploading.
+	const uint32 copyFirstMip = std::max(streamed.visibleFirstMip, newFirstMip);
+	auto isPending = [&streamed](uint32 mip)
+	{
+		return std::any_of(streamed.pendingMips.begin(), streamed.pendingMips.end(),
+			[mip](const PendingMip& pending) { return pending.mipLevel == mip; });
+	};
+	if (copyFirstMip < streamed.numMips)
+	{
+		TextureBarrierAuto barriersBefore[] = {
+			TextureBarrierAuto::toCopySource(streamed.texture.get()),
+			TextureBarrierAuto::toCopyDest(newTexture.get()),
+		};
+		commandList->barrierAuto(0, nullptr, _countof(barriersBefore), barriersBefore, 0, nullptr);
+
+		for (uint32 mip = copyFirstMip; mip < streamed.numMips; ++mip)
+		{
+			if (!isPending(mip))
+			{
+				commandList->copyTextureSubresource(streamed.texture.get(), mip - oldFirstMip, newTexture.get(), mip - newFirstMip);
+			}
+		}
+
+		// Scene proxies might still sample the old texture for a few frames.
+		TextureBarrierAuto barriersAfter[] = {
+			TextureBarrierAuto::toShaderResource(streamed.texture.get(), EBarrierSync::ALL_SHADING),
+			TextureBarrierAuto::toShaderResource(newTexture.get(), EBarrierSync::ALL_SHADING),
+		};
+		commandList->barrierAuto(0, nullptr, _countof(barriersAfter), barriersAfter, 0, nullptr);
+	}
+
+	// Uploads to the old texture still complete, but only the ones to the new texture count.
+	UploadToken visibleUploadToken = UPLOAD_TOKEN_NONE;
+	for (PendingMip& pending : streamed.pendingMips)
+	{
+		CHECK(pending.mipLevel >= newFirstMip);
+		const uint64 rowPitch = getPixelFormatRowBytes(params.format, std::max(1u, params.width >> pending.mipLevel));
+		pending.uploadToken = gUploadBatcher->uploadTexture(newTexture, pending.mipLevel - newFirstMip, pending.data->data(), rowPitch, pending.data);
+		if (pending.mipLevel >= streamed.visibleFirstMip)
+		{
+			visibleUploadToken = pending.uploadToken;
+		}
+	}
+
+	// Min LOD should be valid for both textures until no proxy refers to the old one.
+	streamed.retiredMinLOD = std::max(streamed.retiredMinLOD, getRelativeMinLOD(streamed));
+	streamed.numRetiringFlushes = TEXTURE_STREAMER_RETIRE_FRAMES;
+	retireTexture(std::move(streamed.texture));
+	streamed.texture = newTexture;
+	streamed.textureFirstMip = newFirstMip;
+
+	// Applied before and after the texture is switched, so the game thread never pairs it with a lower min LOD.
+	applyMinLOD(streamed, true);
+	if (SharedPtr<TextureAsset> asset = streamed.asset.lock())
+	{
+		// Only if the tail is still uploading, in which case the asset is not bound yet.
+		if (visibleUploadToken != UPLOAD_TOKEN_NONE)
+		{
+			asset->setUploadToken(visibleUploadToken);
+		}
+		asset->setGPUResource(newTexture);
+	}
+	applyMinLOD(streamed, true);
+}
+
+void TextureStreamer::updateVisibleMips(StreamedTexture& streamed)
+{
+	uint32 visibleFirstMip = streamed.visibleFirstMip;
+	size_t numCompleted = 0;
+	for (const PendingMip& pending : streamed.pendingMips)
+	{
+		// Finer mips wait for the texture to be reallocated.
+		if (pending.mipLevel < streamed.textureFirstMip || !gUploadBatcher->isComplete(pending.uploadToken))
+		{
+			break;
+		}
+		visibleFirstMip = std::min(visibleFirstMip, pending.mipLevel);
+		++numCompleted;
+	}
+	streamed.pendingMips.erase(streamed.pendingMips.begin(), streamed.pendingMips.begin() + numCompleted);
+
+	if (visibleFirstMip != streamed.visibleFirstMip)
+	{
+		streamed.visibleFirstMip = visibleFirstMip;
+		applyMinLOD(streamed);
+	}
+}
+
+uint32 TextureStreamer::getRelativeMinLOD(const StreamedTexture& streamed) const
+{
+	// Visible mips are always in the current texture, except the ones evicted before it's reallocated.
+	const uint32 visibleFirstMip = std::min(streamed.visibleFirstMip, streamed.numMips - 1);
+	return (visibleFirstMip > streamed.textureFirstMip) ? (visibleFirstMip - streamed.textureFirstMip) : 0;
+}
+
+void TextureStreamer::applyMinLOD(StreamedTexture& streamed, bool bForce)
+{
+	SharedPtr<TextureAsset> asset = streamed.asset.lock();
+	if (asset == nullptr)
+	{
+		return;
+	}
+	const float minLOD = (float)std::max(getRelativeMinLOD(streamed), streamed.retiredMinLOD);
+	if (bForce || asset->getMinLOD() != minLOD)
+	{
+		asset->setMinLOD(minLOD);
+	}
+}
+
+void TextureStreamer::retireTexture(SharedPtr<Texture> texture)
+{
+	retiredTextures.push_back(RetiredTexture{ std::move(texture), TEXTURE_STREAMER_RETIRE_FRAMES });
+}
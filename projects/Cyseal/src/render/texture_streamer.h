@@ -0,0 +1,117 @@
+#pragma once
+
+#include "texture_streaming.h"
+#include "core/smart_pointer.h"
+#include "rhi/upload_batch_scheduler.h"
+#include "world/gpu_resource_asset.h"
+#include "rhi/texture.h"
+
+#include <vector>
+#include <map>
+#include <string>
+
+class RenderCommandList;
+
+// Scene proxies are made ahead of the render thread (see CysealEngineCreateParams::maxPendingRenderFrames),
+// so they might refer to a texture for a few frames after its asset switched to a reallocated one.
+#define TEXTURE_STREAMER_RETIRE_FRAMES 4
+
+// Streams mips of TextureAssets with TextureStreamingManager.
+//
+// Each texture only has the resident mips of its source. When residency changes, flush() creates a texture
+// for the new resident range, copies mips that were already uploaded from the current texture on the GPU,
+// and uploads the rest through gUploadBatcher. The asset switches to the new texture right away,
+// and the current one is released through deferred dealloc once no scene proxy can refer to it.
+// Memory of evicted mips is released that way, so the budget of the manager is what the textures take,
+// except the old texture of a reallocation until it's released.
+//
+// Shaders only see uploaded mips through TextureAsset::getMinLOD(), relative to the first mip of the texture,
+// which GPUScene applies to material SRVs.
+//
+// Render thread only, like gUploadBatcher. Textures whose assets are released by the game thread
+// are unregistered in update().
+class TextureStreamer : public ITextureStreamingBackend
+{
+public:
+	~TextureStreamer();
+
+	void initialize(const TextureStreamingDesc& desc = TextureStreamingDesc{});
+	// Releases all textures.
+	void destroy();
+
+	// Creates a texture with the tail of the source and uploads it. The texture is set to the asset
+	// with the upload token of the tail, and finer mips are streamed into textures created later.
+	// @param createParams  Texture of all mips of the source. Textures are created with its format and flags.
+	// @return false if the tail can't be read or the texture can't be reallocated. The asset is left untouched.
+	bool registerTexture(const SharedPtr<TextureAsset>& asset, const TextureCreateParams& createParams, const std::wstring& debugName, SharedPtr<ITextureMipSource> source);
+
+	// Kept until the texture is unregistered. Ignored if the asset is not streamed.
+	// @param worldUnitsPerUV  See calcWorldUnitsPerUV().
+	void addUsage(const SharedPtr<TextureAsset>& asset, const AABB& worldBounds, float worldUnitsPerUV);
+
+	// Reallocates textures whose resident mips changed in the last update().
+	// Call after gUploadBatcher->flush(), before any pass samples the textures.
+	void flush(RenderCommandList* commandList);
+
+	// Call once per frame, after gUploadBatcher->retire().
+	void update(const TextureStreamingView& view);
+
+	inline const TextureStreamingManager* getManager() const { return manager.get(); }
+
+	// ITextureStreamingBackend
+	virtual void makeMipResident(SlotHandle handle, uint32 mipLevel, const uint8* data, uint64 size) override;
+	virtual void evictMip(SlotHandle handle, uint32 mipLevel) override;
+	virtual void releaseTexture(SlotHandle handle) override;
+
+private:
+	struct PendingMip
+	{
+		uint32                        mipLevel;
+		UploadToken                   uploadToken; // To the current texture. Only valid if the texture has the mip.
+		SharedPtr<std::vector<uint8>> data;        // Kept until uploaded, as it's uploaded again if the texture is reallocated.
+	};
+	struct StreamedTexture
+	{
+		SlotHandle              handle;
+		WeakPtr<TextureAsset>   asset;
+		TextureCreateParams     createParams;         // Of all mips
+		uint32                  numMips          = 0;
+		std::wstring            debugName;
+		SharedPtr<Texture>      texture;              // Has mips [textureFirstMip, numMips) of the source.
+		uint32                  textureFirstMip  = 0;
+		uint32                  residentFirstMip = 0;
+		uint32                  visibleFirstMip  = 0; // Uploaded and not evicted.
+		std::vector<PendingMip> pendingMips;          // From coarse to fine, same as the upload order.
+		std::vector<SlotHandle> usages;
+		bool                    bUnregistered    = false;
+		// Min LOD is kept at least this high while proxies might refer to textures retired from this one,
+		// so it's also valid for them. Reset after TEXTURE_STREAMER_RETIRE_FRAMES flushes.
+		uint32                  retiredMinLOD    = 0;
+		uint32                  numRetiringFlushes = 0;
+	};
+	struct RetiredTexture
+	{
+		SharedPtr<Texture> texture;
+		uint32             numFlushesLeft;
+	};
+
+	StreamedTexture* findTexture(SlotHandle handle);
+	void reallocateTexture(RenderCommandList* commandList, StreamedTexture& streamed);
+	void updateVisibleMips(StreamedTexture& streamed);
+	// @param bForce  Bumps the view revision of the asset even if the min LOD is the same, e.g., for a new texture.
+	void applyMinLOD(StreamedTexture& streamed, bool bForce = false);
+	uint32 getRelativeMinLOD(const StreamedTexture& streamed) const;
+	void retireTexture(SharedPtr<Texture> texture);
+
+	UniquePtr<TextureStreamingManager>        manager;
+	std::vector<StreamedTexture>              textures; // index = SlotHandle::index
+	std::map<const TextureAsset*, SlotHandle> assetToHandle;
+	std::vector<RetiredTexture>               retiredTextures;
+
+	// Backend calls for the tail are made before registerTexture() knows the handle.
+	WeakPtr<TextureAsset>                     registeringAsset;
+	const TextureCreateParams*                registeringParams = nullptr;
+	const std::wstring*                       registeringName = nullptr;
+};
+
+extern TextureStreamer* gTextureStreamer;
@@ -0,0 +1,503 @@
+#include "texture_streaming.h"
+#include "core/assertion.h"
+#include "util/logging.h"
+#include "loader/texture_cache.h"
+
+#include <algorithm>
+#include <queue>
+#include <cstring>
+#include <cfloat>
+
+DEFINE_LOG_CATEGORY_STATIC(LogTextureStreaming);
+
+#define INVALID_MIP 0xffffffff
+
+TextureStreamingView TextureStreamingView::fromCamera(const Camera& camera, uint32 screenHeight)
+{
+	TextureStreamingView view;
+	view.position = camera.getPosition();
+	view.frustum = camera.getFrustum();
+	view.fovY_radians = camera.getFovYInRadians();
+	view.screenHeight = std::max(1u, screenHeight);
+	return view;
+}
+
+float calcStreamingMipLevel(const TextureStreamingView& view, const AABB& worldBounds, float worldUnitsPerUV, uint32 textureSize)
+{
+	const vec3& p = view.position;
+	const vec3 closest(
+		std::clamp(p.x, worldBounds.minBounds.x, worldBounds.maxBounds.x),
+		std::clamp(p.y, worldBounds.minBounds.y, worldBounds.maxBounds.y),
+		std::clamp(p.z, worldBounds.minBounds.z, worldBounds.maxBounds.z));
+	const float distance = (closest - p).length();
+	if (distance <= 0.0f || worldUnitsPerUV <= 0.0f)
+	{
+		return 0.0f;
+	}
+
+	// World size of a pixel at the distance, in texels of mip 0.
+	const float worldUnitsPerPixel = 2.0f * distance * tanf(0.5f * view.fovY_radians) / (float)view.screenHeight;
+	const float texelsPerPixel = worldUnitsPerPixel * (float)textureSize / worldUnitsPerUV;
+	return std::max(0.0f, log2f(texelsPerPixel));
+}
+
+float calcWorldUnitsPerUV(const std::vector<vec3>& positions, const std::vector<vec2>& texcoords, const std::vector<uint32>& indices)
+{
+	CHECK(positions.size() == texcoords.size());
+	double worldArea = 0.0, uvArea = 0.0;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const uint32 i0 = indices[i], i1 = indices[i + 1], i2 = indices[i + 2];
+		worldArea += 0.5 * cross(positions[i1] - positions[i0], positions[i2] - positions[i0]).length();
+		const vec2 e1 = texcoords[i1] - texcoords[i0];
+		const vec2 e2 = texcoords[i2] - texcoords[i0];
+		uvArea += 0.5 * std::abs(e1.x * e2.y - e1.y * e2.x);
+	}
+	return uvArea > 0.0 ? (float)sqrt(worldArea / uvArea) : 0.0f;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// TextureCacheMipSource
+
+TextureCacheMipSource::TextureCacheMipSource(TextureCacheEntry* inEntry)
+	: entry(inEntry)
+{
+	CHECK(entry != nullptr);
+}
+
+TextureCacheMipSource::~TextureCacheMipSource()
+{
+	delete entry;
+}
+
+bool TextureCacheMipSource::readMip(uint32 mipLevel, std::vector<uint8>& outData)
+{
+	if (mipLevel >= entry->getNumLevels())
+	{
+		return false;
+	}
+	const MipChain::Level& level = entry->levels[mipLevel];
+	const uint64 rowBytes = getPixelFormatRowBytes(entry->format, level.width);
+	const uint32 numRows = getPixelFormatNumRows(entry->format, level.height);
+	outData.resize(rowBytes * numRows);
+	const uint8* src = entry->getSliceData(mipLevel, 0);
+	for (uint32 y = 0; y < numRows; ++y)
+	{
+		::memcpy(outData.data() + y * rowBytes, src + y * level.rowPitch, rowBytes);
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// TextureStreamingManager
+
+TextureStreamingManager::TextureStreamingManager(const TextureStreamingDesc& inDesc, ITextureStreamingBackend* inBackend)
+	: desc(inDesc)
+	, backend(inBackend)
+{
+	CHECK(backend != nullptr && desc.maxLoadsInFlight > 0);
+	workers.reserve(desc.numWorkers);
+	for (uint32 i = 0; i < desc.numWorkers; ++i)
+	{
+		workers.emplace_back([this]() { workerMain(); });
+	}
+}
+
+TextureStreamingManager::~TextureStreamingManager()
+{
+	flush();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bStopRequested = true;
+	}
+	queueNotEmpty.notify_all();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		backend->releaseTexture(textures.getHandle(i));
+	}
+}
+
+SlotHandle TextureStreamingManager::registerTexture(SharedPtr<ITextureMipSource> source, EPixelFormat format, uint32 width, uint32 height, uint32 numMips)
+{
+	CHECK(source != nullptr && numMips > 0);
+
+	StreamedTexture texture;
+	texture.source = std::move(source);
+	texture.numMips = numMips;
+	texture.textureSize = std::max(width, height);
+	texture.mipSizes.resize(numMips);
+	texture.tailFirstMip = numMips - 1;
+	for (uint32 mip = 0; mip < numMips; ++mip)
+	{
+		const uint32 w = std::max(1u, width >> mip);
+		const uint32 h = std::max(1u, height >> mip);
+		texture.mipSizes[mip] = getPixelFormatRowBytes(format, w) * getPixelFormatNumRows(format, h);
+		if (std::max(w, h) <= desc.minResidentMipSize)
+		{
+			texture.tailFirstMip = std::min(texture.tailFirstMip, mip);
+		}
+	}
+	texture.residentFirstMip = numMips;
+	texture.requestedFirstMip = texture.tailFirstMip;
+	texture.wantedMip = (float)numMips;
+
+	// Read the tail before the texture is visible to the backend, so a failed read leaves nothing behind.
+	std::vector<std::vector<uint8>> tailData(numMips - texture.tailFirstMip);
+	for (uint32 mip = texture.tailFirstMip; mip < numMips; ++mip)
+	{
+		std::vector<uint8>& data = tailData[mip - texture.tailFirstMip];
+		if (!texture.source->readMip(mip, data) || data.size() != texture.mipSizes[mip])
+		{
+			CYLOG(LogTextureStreaming, Error, L"Failed to read mip %u of a streamed texture", mip);
+			return SlotHandle{};
+		}
+	}
+
+	SlotHandle handle = textures.insert(std::move(texture));
+	StreamedTexture& inserted = *textures.find(handle);
+	for (uint32 mip = numMips; mip-- > inserted.tailFirstMip; )
+	{
+		const std::vector<uint8>& data = tailData[mip - inserted.tailFirstMip];
+		backend->makeMipResident(handle, mip, data.data(), data.size());
+		stats.residentBytes += data.size();
+	}
+	inserted.residentFirstMip = inserted.tailFirstMip;
+	return handle;
+}
+
+void TextureStreamingManager::unregisterTexture(SlotHandle handle)
+{
+	StreamedTexture* texture = textures.find(handle);
+	if (texture == nullptr || texture->bUnregistered)
+	{
+		return;
+	}
+	if (texture->loadingMip != INVALID_MIP)
+	{
+		texture->bUnregistered = true;
+		return;
+	}
+	releaseTexture(handle, *texture);
+}
+
+SlotHandle TextureStreamingManager::addUsage(SlotHandle texture, const AABB& worldBounds, float worldUnitsPerUV)
+{
+	CHECK(textures.contains(texture));
+	return usages.insert(TextureUsage{ texture, worldBounds, worldUnitsPerUV });
+}
+
+void TextureStreamingManager::updateUsage(SlotHandle usage, const AABB& worldBounds)
+{
+	TextureUsage* item = usages.find(usage);
+	CHECK(item != nullptr);
+	item->worldBounds = worldBounds;
+}
+
+void TextureStreamingManager::removeUsage(SlotHandle usage)
+{
+	usages.remove(usage);
+}
+
+void TextureStreamingManager::update(const TextureStreamingView& view)
+{
+	++frameNumber;
+	stats.numLoadsIssued = 0;
+	stats.numMipsEvicted = 0;
+	stats.numLoadsDeferred = 0;
+
+	completeLoads();
+	updateRequestedMips(view);
+	scheduleLoads();
+
+	if (workers.empty())
+	{
+		flush();
+	}
+}
+
+void TextureStreamingManager::flush()
+{
+	if (workers.empty())
+	{
+		while (!pendingJobs.empty())
+		{
+			LoadJob job = std::move(pendingJobs.front());
+			pendingJobs.pop_front();
+			job.bSuccess = job.source->readMip(job.mipLevel, job.data);
+			completedJobs.push_back(std::move(job));
+		}
+	}
+	else
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		jobCompleted.wait(lock, [this]() { return completedJobs.size() == stats.numLoadsInFlight; });
+	}
+	completeLoads();
+}
+
+void TextureStreamingManager::setMemoryBudget(uint64 newBudget)
+{
+	desc.memoryBudget = newBudget;
+	evictForBudget(0, SlotHandle{}, FLT_MAX);
+}
+
+uint32 TextureStreamingManager::getResidentFirstMip(SlotHandle handle) const
+{
+	const StreamedTexture* texture = textures.find(handle);
+	CHECK(texture != nullptr);
+	return texture->residentFirstMip;
+}
+
+uint32 TextureStreamingManager::getRequestedFirstMip(SlotHandle handle) const
+{
+	const StreamedTexture* texture = textures.find(handle);
+	CHECK(texture != nullptr);
+	return texture->requestedFirstMip;
+}
+
+uint64 TextureStreamingManager::getMipSize(SlotHandle handle, uint32 mipLevel) const
+{
+	const StreamedTexture* texture = textures.find(handle);
+	CHECK(texture != nullptr && mipLevel < texture->numMips);
+	return texture->mipSizes[mipLevel];
+}
+
+void TextureStreamingManager::updateRequestedMips(const TextureStreamingView& view)
+{
+	for (StreamedTexture& texture : textures)
+	{
+		texture.wantedMip = (float)texture.numMips;
+	}
+	for (const TextureUsage& usage : usages)
+	{
+		StreamedTexture* texture = textures.find(usage.texture);
+		if (texture == nullptr || texture->bUnregistered)
+		{
+			continue;
+		}
+		float mip = calcStreamingMipLevel(view, usage.worldBounds, usage.worldUnitsPerUV, texture->textureSize);
+		if (!view.frustum.intersectsAABB(usage.worldBounds))
+		{
+			mip += desc.offscreenMipBias;
+		}
+		texture->wantedMip = std::min(texture->wantedMip, std::max(0.0f, mip + desc.mipBias));
+	}
+	for (StreamedTexture& texture : textures)
+	{
+		const uint32 requested = (uint32)std::floor(texture.wantedMip);
+		texture.requestedFirstMip = texture.bLoadFailed ? texture.tailFirstMip : std::min(requested, texture.tailFirstMip);
+		if (texture.requestedFirstMip < texture.tailFirstMip)
+		{
+			texture.lastRequestedFrame = frameNumber;
+		}
+	}
+}
+
+float TextureStreamingManager::getDeficit(const StreamedTexture& texture) const
+{
+	// Mips between resident and wanted. Negative if more is resident than wanted.
+	return (float)texture.residentFirstMip - texture.wantedMip;
+}
+
+void TextureStreamingManager::scheduleLoads()
+{
+	struct LoadCandidate
+	{
+		float      deficit;
+		SlotHandle texture;
+		bool operator<(const LoadCandidate& other) const { return deficit < other.deficit; }
+	};
+	std::priority_queue<LoadCandidate> loadQueue;
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		const StreamedTexture& texture = textures[i];
+		if (!texture.bUnregistered && texture.loadingMip == INVALID_MIP && texture.residentFirstMip > texture.requestedFirstMip)
+		{
+			loadQueue.push(LoadCandidate{ getDeficit(texture), textures.getHandle(i) });
+		}
+	}
+
+	uint64 issuedBytes = 0;
+	while (!loadQueue.empty() && stats.numLoadsInFlight < desc.maxLoadsInFlight)
+	{
+		if (stats.numLoadsIssued > 0 && issuedBytes >= desc.maxLoadBytesPerUpdate)
+		{
+			break;
+		}
+		const LoadCandidate candidate = loadQueue.top();
+		StreamedTexture& texture = *textures.find(candidate.texture);
+		const uint64 mipSize = texture.mipSizes[texture.residentFirstMip - 1];
+		// Loads are issued in priority order. If the most urgent load does not fit,
+		// smaller loads behind it must not take its memory, otherwise it might never fit.
+		if (!evictForBudget(mipSize, candidate.texture, candidate.deficit))
+		{
+			stats.numLoadsDeferred = (uint32)loadQueue.size();
+			break;
+		}
+		loadQueue.pop();
+		issueLoad(candidate.texture, texture);
+		issuedBytes += mipSize;
+	}
+}
+
+bool TextureStreamingManager::evictForBudget(uint64 requiredBytes, SlotHandle loadingTexture, float loadDeficit)
+{
+	auto fitsInBudget = [&]()
+	{
+		return stats.residentBytes + stats.loadingBytes + requiredBytes <= desc.memoryBudget;
+	};
+	if (fitsInBudget())
+	{
+		return true;
+	}
+
+	struct EvictCandidate
+	{
+		float      deficit;
+		uint64     lastRequestedFrame;
+		SlotHandle texture;
+		// Least behind first, then least recently requested first.
+		bool operator<(const EvictCandidate& other) const
+		{
+			if (deficit != other.deficit) return deficit > other.deficit;
+			return lastRequestedFrame > other.lastRequestedFrame;
+		}
+	};
+	auto isEvictable = [](const StreamedTexture& texture)
+	{
+		return texture.loadingMip == INVALID_MIP && texture.residentFirstMip < texture.tailFirstMip;
+	};
+	std::priority_queue<EvictCandidate> evictQueue;
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		const StreamedTexture& texture = textures[i];
+		const SlotHandle handle = textures.getHandle(i);
+		if (handle != loadingTexture && isEvictable(texture))
+		{
+			evictQueue.push(EvictCandidate{ getDeficit(texture), texture.lastRequestedFrame, handle });
+		}
+	}
+
+	while (!fitsInBudget() && !evictQueue.empty())
+	{
+		const EvictCandidate candidate = evictQueue.top();
+		// Evicting a texture to load another that is only one mip further behind would make them swap places.
+		if (candidate.deficit + 1.0f >= loadDeficit)
+		{
+			break;
+		}
+		evictQueue.pop();
+		StreamedTexture& texture = *textures.find(candidate.texture);
+		evictMip(candidate.texture, texture);
+		if (isEvictable(texture))
+		{
+			evictQueue.push(EvictCandidate{ getDeficit(texture), texture.lastRequestedFrame, candidate.texture });
+		}
+	}
+	return fitsInBudget();
+}
+
+void TextureStreamingManager::evictMip(SlotHandle handle, StreamedTexture& texture)
+{
+	CHECK(texture.residentFirstMip < texture.tailFirstMip);
+	backend->evictMip(handle, texture.residentFirstMip);
+	stats.residentBytes -= texture.mipSizes[texture.residentFirstMip];
+	++texture.residentFirstMip;
+	++stats.numMipsEvicted;
+}
+
+void TextureStreamingManager::issueLoad(SlotHandle handle, StreamedTexture& texture)
+{
+	CHECK(texture.loadingMip == INVALID_MIP && texture.residentFirstMip > 0);
+	texture.loadingMip = texture.residentFirstMip - 1;
+	stats.loadingBytes += texture.mipSizes[texture.loadingMip];
+	++stats.numLoadsInFlight;
+	++stats.numLoadsIssued;
+
+	LoadJob job;
+	job.texture = handle;
+	job.mipLevel = texture.loadingMip;
+	job.source = texture.source;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingJobs.push_back(std::move(job));
+	}
+	queueNotEmpty.notify_one();
+}
+
+void TextureStreamingManager::completeLoads()
+{
+	std::vector<LoadJob> jobs;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.swap(completedJobs);
+	}
+	for (LoadJob& job : jobs)
+	{
+		StreamedTexture& texture = *textures.find(job.texture);
+		CHECK(texture.loadingMip == job.mipLevel);
+		const uint64 mipSize = texture.mipSizes[job.mipLevel];
+		texture.loadingMip = INVALID_MIP;
+		stats.loadingBytes -= mipSize;
+		--stats.numLoadsInFlight;
+
+		if (texture.bUnregistered)
+		{
+			releaseTexture(job.texture, texture);
+		}
+		else if (job.bSuccess && job.data.size() == mipSize)
+		{
+			backend->makeMipResident(job.texture, job.mipLevel, job.data.data(), mipSize);
+			stats.residentBytes += mipSize;
+			texture.residentFirstMip = job.mipLevel;
+		}
+		else
+		{
+			CYLOG(LogTextureStreaming, Warning, L"Failed to read mip %u of a streamed texture. It stops streaming.", job.mipLevel);
+			texture.bLoadFailed = true;
+		}
+	}
+}
+
+void TextureStreamingManager::releaseTexture(SlotHandle handle, StreamedTexture& texture)
+{
+	CHECK(texture.loadingMip == INVALID_MIP);
+	for (uint32 mip = texture.residentFirstMip; mip < texture.numMips; ++mip)
+	{
+		stats.residentBytes -= texture.mipSizes[mip];
+	}
+	backend->releaseTexture(handle);
+	textures.remove(handle);
+}
+
+void TextureStreamingManager::workerMain()
+{
+	while (true)
+	{
+		LoadJob job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			queueNotEmpty.wait(lock, [this]() { return bStopRequested || !pendingJobs.empty(); });
+			if (bStopRequested)
+			{
+				break;
+			}
+			job = std::move(pendingJobs.front());
+			pendingJobs.pop_front();
+		}
+
+		job.bSuccess = job.source->readMip(job.mipLevel, job.data);
+		// The source is released on the render thread with the texture.
+		job.source.reset();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			completedJobs.push_back(std::move(job));
+		}
+		jobCompleted.notify_all();
+	}
+}
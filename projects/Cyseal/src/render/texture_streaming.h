@@ -0,0 +1,228 @@
+#pragma once
+
+#include "core/int_types.h"
+#include "core/vec2.h"
+#include "core/vec3.h"
+#include "core/aabb.h"
+#include "core/slot_map.h"
+#include "core/smart_pointer.h"
+#include "rhi/pixel_format.h"
+#include "world/camera.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class TextureCacheEntry;
+
+// Mips at or below this size (max of width and height) are always resident,
+// so that every streamed texture has something to sample while finer mips are loading.
+#define TEXTURE_STREAMING_MIN_RESIDENT_MIP_SIZE 64
+
+// What the renderer sees this frame. Screen coverage of texture usages is estimated from this.
+struct TextureStreamingView
+{
+	static TextureStreamingView fromCamera(const Camera& camera, uint32 screenHeight);
+
+	vec3          position;
+	CameraFrustum frustum;
+	float         fovY_radians = 1.0f;
+	uint32        screenHeight = 1;
+};
+
+// Mip level at which one texel of a texture covers about one pixel, estimated on CPU.
+// The closest point of worldBounds to the view is used, so the result is the finest level the usage might need.
+// @param worldUnitsPerUV  World space length of UV length 1. See calcWorldUnitsPerUV().
+// @param textureSize      Max of width and height of mip 0.
+// @return Fractional mip level, 0 if the view is inside the bounds. Not clamped to the mip count.
+float calcStreamingMipLevel(
+	const TextureStreamingView& view,
+	const AABB& worldBounds,
+	float worldUnitsPerUV,
+	uint32 textureSize);
+
+// UV density of a mesh: sqrt(sum of world space triangle areas / sum of UV space triangle areas).
+// Positions should be in world space, or scaled by the mesh transform.
+// @return 0 if UVs are degenerate.
+float calcWorldUnitsPerUV(
+	const std::vector<vec3>& positions,
+	const std::vector<vec2>& texcoords,
+	const std::vector<uint32>& indices);
+
+// Provides texel data of mips. Called from worker threads of TextureStreamingManager,
+// one call at a time per texture, so sources may read files or decompress.
+class ITextureMipSource
+{
+public:
+	virtual ~ITextureMipSource() = default;
+	// @param outData  Resized to the mip size and filled with tightly packed rows.
+	// @return false if the mip can't be read. The texture stops streaming.
+	virtual bool readMip(uint32 mipLevel, std::vector<uint8>& outData) = 0;
+};
+
+// Reads mips of the first slice from a mapped TextureCache file. Reads page in the mapping,
+// so disk reads happen on worker threads instead of the render thread.
+class TextureCacheMipSource : public ITextureMipSource
+{
+public:
+	// Takes ownership of the entry.
+	explicit TextureCacheMipSource(TextureCacheEntry* inEntry);
+	~TextureCacheMipSource();
+
+	virtual bool readMip(uint32 mipLevel, std::vector<uint8>& outData) override;
+
+private:
+	TextureCacheEntry* entry;
+};
+
+// Memory that holds resident mips, e.g., GPU textures. Called from the thread that calls
+// TextureStreamingManager::update(), in the order of residency changes.
+// Mips are made resident from coarse to fine and evicted from fine to coarse,
+// so the resident mips of a texture are always [residentFirstMip, numMips).
+class ITextureStreamingBackend
+{
+public:
+	virtual ~ITextureStreamingBackend() = default;
+	// @param data  Tightly packed rows of the mip. Valid only during the call.
+	virtual void makeMipResident(SlotHandle texture, uint32 mipLevel, const uint8* data, uint64 size) = 0;
+	virtual void evictMip(SlotHandle texture, uint32 mipLevel) = 0;
+	// All mips of the texture are released. No calls for the handle follow.
+	virtual void releaseTexture(SlotHandle texture) = 0;
+};
+
+struct TextureStreamingDesc
+{
+	uint64 memoryBudget          = 512ull * 1024 * 1024; // Resident and loading mips.
+	uint32 numWorkers            = 2;                    // 0 means mips are read in update(). Deterministic, for tests.
+	uint32 maxLoadsInFlight      = 16;
+	uint64 maxLoadBytesPerUpdate = 64ull * 1024 * 1024;  // At least one load is issued per update regardless.
+	uint32 minResidentMipSize    = TEXTURE_STREAMING_MIN_RESIDENT_MIP_SIZE;
+	float  mipBias               = 0.0f;                 // Added to requested mips. Positive values save memory.
+	float  offscreenMipBias      = 2.0f;                 // Added for usages outside of the frustum.
+};
+
+struct TextureStreamingStats
+{
+	uint64 residentBytes    = 0;
+	uint64 loadingBytes     = 0;
+	uint32 numLoadsInFlight = 0;
+	// Of the last update()
+	uint32 numLoadsIssued   = 0;
+	uint32 numMipsEvicted   = 0;
+	uint32 numLoadsDeferred = 0; // Textures that want finer mips but did not fit in the budget.
+};
+
+// Decides which mips of textures are resident under a memory budget and streams them in.
+//
+// Each texture usage (e.g., a mesh section) estimates the mip it needs from its bounds and UV density.
+// A texture requests the finest mip of all its usages. Every update():
+// 1. Mips read by workers are made resident.
+// 2. Requested mips are updated from the view.
+// 3. Textures are loaded one mip at a time in order of how far they are from their requested mips.
+//    If a load does not fit in the budget, mips of textures that are least behind are evicted for it,
+//    textures that are not requested anymore first. A texture is only evicted for a load
+//    that is more than one mip further behind, so two textures never take turns evicting each other.
+// Mips that are not requested anymore stay resident until their memory is needed.
+class TextureStreamingManager
+{
+public:
+	TextureStreamingManager(const TextureStreamingDesc& inDesc, ITextureStreamingBackend* inBackend);
+	// Waits for loads in flight and releases all textures.
+	~TextureStreamingManager();
+
+	TextureStreamingManager(const TextureStreamingManager&) = delete;
+	TextureStreamingManager& operator=(const TextureStreamingManager&) = delete;
+
+	// Mips from the tail (see minResidentMipSize) are read and made resident immediately.
+	// @return Invalid handle if the tail can't be read.
+	SlotHandle registerTexture(
+		SharedPtr<ITextureMipSource> source,
+		EPixelFormat format,
+		uint32 width,
+		uint32 height,
+		uint32 numMips);
+	// A load in flight is discarded when it completes.
+	void unregisterTexture(SlotHandle texture);
+
+	// @param worldUnitsPerUV  See calcWorldUnitsPerUV().
+	SlotHandle addUsage(SlotHandle texture, const AABB& worldBounds, float worldUnitsPerUV);
+	void updateUsage(SlotHandle usage, const AABB& worldBounds);
+	void removeUsage(SlotHandle usage);
+
+	void update(const TextureStreamingView& view);
+	// Blocks until all loads in flight complete and makes them resident.
+	void flush();
+
+	// Evicted immediately if resident mips exceed the new budget.
+	void setMemoryBudget(uint64 newBudget);
+
+	// Finest resident mip, or the mip count if nothing is resident.
+	uint32 getResidentFirstMip(SlotHandle texture) const;
+	// Finest mip requested by the last update().
+	uint32 getRequestedFirstMip(SlotHandle texture) const;
+	uint64 getMipSize(SlotHandle texture, uint32 mipLevel) const;
+
+	inline const TextureStreamingDesc& getDesc() const { return desc; }
+	inline const TextureStreamingStats& getStats() const { return stats; }
+	inline uint32 getNumTextures() const { return (uint32)textures.size(); }
+
+private:
+	struct StreamedTexture
+	{
+		SharedPtr<ITextureMipSource> source;
+		std::vector<uint64>          mipSizes;
+		uint32                       numMips            = 0;
+		uint32                       textureSize        = 0; // Max of width and height.
+		uint32                       tailFirstMip       = 0; // Mips from here are always resident.
+		uint32                       residentFirstMip   = 0;
+		uint32                       loadingMip         = 0xffffffff;
+		uint32                       requestedFirstMip  = 0;
+		float                        wantedMip          = 0.0f; // Before clamp and rounding.
+		uint64                       lastRequestedFrame = 0;
+		bool                         bUnregistered      = false; // Removed when its load completes.
+		bool                         bLoadFailed        = false;
+	};
+	struct TextureUsage
+	{
+		SlotHandle texture;
+		AABB       worldBounds;
+		float      worldUnitsPerUV;
+	};
+	struct LoadJob
+	{
+		SlotHandle                   texture;
+		uint32                       mipLevel;
+		SharedPtr<ITextureMipSource> source;
+		std::vector<uint8>           data;
+		bool                         bSuccess = false;
+	};
+
+	void updateRequestedMips(const TextureStreamingView& view);
+	void scheduleLoads();
+	// @return false if there is nothing to evict.
+	bool evictForBudget(uint64 requiredBytes, SlotHandle loadingTexture, float loadDeficit);
+	void evictMip(SlotHandle handle, StreamedTexture& texture);
+	void issueLoad(SlotHandle handle, StreamedTexture& texture);
+	void completeLoads();
+	void releaseTexture(SlotHandle handle, StreamedTexture& texture);
+	float getDeficit(const StreamedTexture& texture) const;
+	void workerMain();
+
+	TextureStreamingDesc      desc;
+	ITextureStreamingBackend* backend;
+	SlotMap<StreamedTexture>  textures;
+	SlotMap<TextureUsage>     usages;
+	TextureStreamingStats     stats;
+	uint64                    frameNumber = 0;
+
+	std::vector<std::thread>  workers;
+	std::mutex                mutex;
+	std::condition_variable   queueNotEmpty;
+	std::condition_variable   jobCompleted;
+	std::deque<LoadJob>       pendingJobs;   // Issued, not read yet.
+	std::vector<LoadJob>      completedJobs; // Read, not resident yet.
+	bool                      bStopRequested = false;
+};
@@ -23,6 +23,7 @@ enum class EBufferAccessFlags : uint32
 	UAV           = 1 << 6, // Can be bound as UAV
 	CPU_WRITE     = 1 << 7, // If set, COPY_DST flag is automatically set.
 	CPU_READBACK  = 1 << 8, // If set, COPY_SRC flag is automatically set.
+	UPLOAD_HEAP   = 1 << 9, // The buffer itself lives in CPU-visible memory and stays mapped. See Buffer::getMappedPointer().
 };
 ENUM_CLASS_FLAGS(EBufferAccessFlags);
 
@@ -70,6 +71,9 @@ public:
 
 	virtual void updateData(RenderCommandList* commandList, void* data, uint32 strideInBytes) = 0;
 
+	// Sets the stride without updating data, e.g., if data is uploaded by UploadBatcher::uploadVertexBuffer().
+	virtual void setStrideInBytes(uint32 strideInBytes) = 0;
+
 	virtual uint32 getVertexCount() const = 0;
 
 	virtual uint64 getBufferOffsetInBytes() const = 0; // offsetInPool
@@ -114,6 +118,9 @@ public:
 
 	virtual void updateData(RenderCommandList* commandList, void* data, EPixelFormat format) = 0;
 
+	// Sets the format without updating data, e.g., if data is uploaded by UploadBatcher::uploadIndexBuffer().
+	virtual void setIndexFormat(EPixelFormat format) = 0;
+
 	virtual uint32 getIndexCount() const = 0;
 	virtual EPixelFormat getIndexFormat() const = 0;
 
@@ -173,6 +180,14 @@ public:
 		{
 			createParams.accessFlags |= EBufferAccessFlags::COPY_SRC;
 		}
+		if (ENUM_HAS_FLAG(createParams.accessFlags, EBufferAccessFlags::UPLOAD_HEAP))
+		{
+			// GPU can only read from an upload heap. Writing is done by CPU via getMappedPointer().
+			CHECK(!ENUM_HAS_FLAG(createParams.accessFlags, EBufferAccessFlags::UAV));
+			CHECK(!ENUM_HAS_FLAG(createParams.accessFlags, EBufferAccessFlags::CPU_WRITE));
+			CHECK(!ENUM_HAS_FLAG(createParams.accessFlags, EBufferAccessFlags::CPU_READBACK));
+			createParams.accessFlags |= EBufferAccessFlags::COPY_SRC;
+		}
 
 		lastBarrier = BarrierTracker::BufferState::createUnused();
 
@@ -206,6 +221,10 @@ public:
 	/// <returns>Handle to the readback request.</returns>
 	virtual SharedPtr<ReadbackHandle> requestReadback(RenderCommandList* commandList, uint64 offset = 0, uint64 size = READBACK_SIZE_ALL) { return nullptr; }
 
+	// Persistently mapped CPU address of the buffer.
+	// Only valid if the buffer was initialized with EBufferAccessFlags::UPLOAD_HEAP flag.
+	virtual uint8* getMappedPointer() const = 0;
+
 	inline const BufferCreateParams& getCreateParams() const { return createParams; }
 
 	// Use only when a barrier tracker in a command list has no history for this buffer.
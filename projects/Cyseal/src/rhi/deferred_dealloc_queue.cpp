@@ -0,0 +1,74 @@
+#include "deferred_dealloc_queue.h"
+#include "buffer.h"
+#include "texture.h"
+#include "pixel_format.h"
+
+#include <atomic>
+#include <algorithm>
+
+uint64 getBufferDeallocBytes(const Buffer* buffer)
+{
+	return buffer->getCreateParams().sizeInBytes;
+}
+
+// Tight size of all subresources, without placement alignment.
+uint64 getTextureDeallocBytes(const Texture* texture)
+{
+	const TextureCreateParams& params = texture->getCreateParams();
+	const bool b3D = params.dimension == ETextureDimension::TEXTURE3D;
+	const uint32 numMips = getTextureNumMipLevels(params);
+
+	uint64 bytes = 0;
+	for (uint32 mip = 0; mip < numMips; ++mip)
+	{
+		const uint32 width = std::max(1u, params.width >> mip);
+		const uint32 height = std::max(1u, params.height >> mip);
+		const uint32 depth = b3D ? std::max(1u, (uint32)params.depth >> mip) : 1;
+		bytes += getPixelFormatRowBytes(params.format, width) * getPixelFormatNumRows(params.format, height) * depth;
+	}
+	const uint64 numSlices = uint64(b3D ? 1 : std::max<uint16>(1, params.depth)) * std::max(1u, params.numLayers);
+	return bytes * numSlices * std::max(1u, params.sampleCount);
+}
+
+DeferredDeallocQueue::~DeferredDeallocQueue()
+{
+	for (TypedListBase* list : typedLists)
+	{
+		delete list;
+	}
+}
+
+void DeferredDeallocQueue::retire(uint64 completedFenceValue)
+{
+	if (numPendingObjects == 0) return;
+
+	for (TypedListBase* list : typedLists)
+	{
+		if (list == nullptr) continue;
+
+		uint64 bytes = 0;
+		numPendingObjects -= list->retire(completedFenceValue, bytes);
+		pendingBytes -= bytes;
+	}
+}
+
+void DeferredDeallocQueue::retireAll()
+{
+	retire(~0ull);
+}
+
+size_t DeferredDeallocQueue::getNumPendingBatches() const
+{
+	size_t count = 0;
+	for (const TypedListBase* list : typedLists)
+	{
+		if (list != nullptr) count += list->getNumBatches();
+	}
+	return count;
+}
+
+uint32 DeferredDeallocQueue::allocateTypeId()
+{
+	static std::atomic<uint32> nextTypeId = 0;
+	return nextTypeId.fetch_add(1, std::memory_order_relaxed);
+}
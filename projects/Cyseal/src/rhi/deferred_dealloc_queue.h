@@ -0,0 +1,167 @@
+#pragma once
+
+#include "core/int_types.h"
+#include "core/assertion.h"
+#include "memory/custom_new_delete.h"
+
+#include <vector>
+#include <deque>
+#include <type_traits>
+
+class Buffer;
+class Texture;
+
+uint64 getBufferDeallocBytes(const Buffer* buffer);
+uint64 getTextureDeallocBytes(const Texture* texture);
+
+// Footprint of an object waiting in DeferredDeallocQueue, for stats only.
+// Buffers and textures, including backend subclasses, report their GPU memory.
+template<typename T>
+inline uint64 getDeferredDeallocBytes(const T* ptr)
+{
+	if constexpr (std::is_base_of_v<Buffer, T>)
+	{
+		return getBufferDeallocBytes(ptr);
+	}
+	else if constexpr (std::is_base_of_v<Texture, T>)
+	{
+		return getTextureDeallocBytes(ptr);
+	}
+	else
+	{
+		return sizeof(T);
+	}
+}
+
+// Deletes objects after the GPU is done with them.
+// Pointers are batched per type and per fence value, so retiring a fence
+// deletes each batch in one loop instead of invoking a closure per object.
+class DeferredDeallocQueue
+{
+public:
+	DeferredDeallocQueue() = default;
+	~DeferredDeallocQueue();
+
+	DeferredDeallocQueue(const DeferredDeallocQueue&) = delete;
+	DeferredDeallocQueue& operator=(const DeferredDeallocQueue&) = delete;
+
+	// @param fenceValue Fence value that signals GPU completion of works using ptr.
+	//                   Should not decrease between calls for the same type.
+	template<typename T>
+	void enqueue(T* ptr, uint64 fenceValue)
+	{
+		CHECK(ptr != nullptr);
+		const uint32 typeId = getTypeId<T>();
+		if (typeId >= typedLists.size())
+		{
+			typedLists.resize(typeId + 1, nullptr);
+		}
+		if (typedLists[typeId] == nullptr)
+		{
+			typedLists[typeId] = new(EMemoryTag::RHI) TypedList<T>;
+		}
+		const uint64 bytes = getDeferredDeallocBytes(ptr);
+		static_cast<TypedList<T>*>(typedLists[typeId])->add(ptr, fenceValue, bytes);
+		numPendingObjects += 1;
+		pendingBytes += bytes;
+	}
+
+	// Delete all objects enqueued with fence values <= completedFenceValue.
+	void retire(uint64 completedFenceValue);
+
+	// Delete all objects. The GPU should be idle.
+	void retireAll();
+
+	inline size_t getNumPendingObjects() const { return numPendingObjects; }
+	inline uint64 getPendingBytes() const { return pendingBytes; }
+	size_t getNumPendingBatches() const;
+
+private:
+	class TypedListBase
+	{
+	public:
+		virtual ~TypedListBase() = default;
+		// @return Number of deleted objects.
+		virtual size_t retire(uint64 completedFenceValue, uint64& outBytes) = 0;
+		virtual size_t getNumBatches() const = 0;
+	};
+
+	template<typename T>
+	class TypedList : public TypedListBase
+	{
+		struct Batch
+		{
+			uint64          fenceValue;
+			uint64          bytes;
+			std::vector<T*> objects;
+		};
+
+	public:
+		~TypedList()
+		{
+			uint64 bytes;
+			retire(~0ull, bytes);
+		}
+
+		void add(T* ptr, uint64 fenceValue, uint64 bytes)
+		{
+			if (batches.empty() || batches.back().fenceValue != fenceValue)
+			{
+				CHECK(batches.empty() || batches.back().fenceValue < fenceValue);
+				batches.push_back(Batch{ fenceValue, 0, {} });
+				if (!spareArrays.empty())
+				{
+					batches.back().objects.swap(spareArrays.back());
+					spareArrays.pop_back();
+				}
+			}
+			Batch& batch = batches.back();
+			batch.objects.push_back(ptr);
+			batch.bytes += bytes;
+		}
+
+		virtual size_t retire(uint64 completedFenceValue, uint64& outBytes) override
+		{
+			size_t count = 0;
+			outBytes = 0;
+			while (!batches.empty() && batches.front().fenceValue <= completedFenceValue)
+			{
+				Batch& batch = batches.front();
+				for (T* ptr : batch.objects)
+				{
+					delete ptr;
+				}
+				count += batch.objects.size();
+				outBytes += batch.bytes;
+
+				// Keep the array to avoid reallocation in next frames.
+				batch.objects.clear();
+				spareArrays.emplace_back(std::move(batch.objects));
+				batches.pop_front();
+			}
+			return count;
+		}
+
+		virtual size_t getNumBatches() const override
+		{
+			return batches.size();
+		}
+
+	private:
+		std::deque<Batch>            batches;
+		std::vector<std::vector<T*>> spareArrays;
+	};
+
+	static uint32 allocateTypeId();
+
+	template<typename T>
+	static uint32 getTypeId()
+	{
+		static const uint32 typeId = allocateTypeId();
+		return typeId;
+	}
+
+	std::vector<TypedListBase*> typedLists; // Indexed by type id
+	size_t                      numPendingObjects = 0;
+	uint64                      pendingBytes = 0;
+};
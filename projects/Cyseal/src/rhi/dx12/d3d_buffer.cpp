@@ -119,6 +119,11 @@ void D3DVertexBuffer::updateData(RenderCommandList* commandList, void* data, uin
 	updateDefaultBuffer(device, cmdList, defaultBuffer, uploadBuffer,
 		offsetInDefaultBuffer, data, view.SizeInBytes);
 
+	setStrideInBytes(strideInBytes);
+}
+
+void D3DVertexBuffer::setStrideInBytes(uint32 strideInBytes)
+{
 	view.StrideInBytes  = strideInBytes;
 
 	vertexCount = (uint32)(view.SizeInBytes / strideInBytes);
@@ -162,6 +167,16 @@ void D3DIndexBuffer::updateData(RenderCommandList* commandList, void* data, EPix
 	CHECK(!bRemovedFromPool);
 	CHECK(indexFormat == format);
 
+	auto cmdList = static_cast<D3DRenderCommandList*>(commandList)->getRaw();
+
+	updateDefaultBuffer(device, cmdList, defaultBuffer, uploadBuffer,
+		offsetInDefaultBuffer, data, view.SizeInBytes);
+
+	setIndexFormat(format);
+}
+
+void D3DIndexBuffer::setIndexFormat(EPixelFormat format)
+{
 	DXGI_FORMAT d3dFormat = DXGI_FORMAT_UNKNOWN;
 	uint32 sizeInBytes = view.SizeInBytes;
 
@@ -179,11 +194,7 @@ void D3DIndexBuffer::updateData(RenderCommandList* commandList, void* data, EPix
 
 	CHECK(d3dFormat != DXGI_FORMAT_UNKNOWN);
 
-	auto cmdList = static_cast<D3DRenderCommandList*>(commandList)->getRaw();
-
-	updateDefaultBuffer(device, cmdList, defaultBuffer, uploadBuffer,
-		offsetInDefaultBuffer, data, sizeInBytes);
-
+	indexFormat = format;
 	view.Format = d3dFormat;
 }
 
@@ -203,6 +214,10 @@ D3D12_GPU_VIRTUAL_ADDRESS D3DIndexBuffer::getGPUVirtualAddress() const
 
 D3DBuffer::~D3DBuffer()
 {
+	if (defaultMapPtr != nullptr)
+	{
+		defaultBuffer->Unmap(0, nullptr);
+	}
 	if (uploadBuffer != nullptr)
 	{
 		uploadBuffer->Unmap(0, nullptr);
@@ -216,7 +231,25 @@ void D3DBuffer::onInitialize()
 
 	// NOTE: alignment should be 0 or 65536 for buffers.
 	
-	// default buffer
+	// default buffer (in upload heap if requested)
+	if (ENUM_HAS_FLAG(createParams.accessFlags, EBufferAccessFlags::UPLOAD_HEAP))
+	{
+		// Resources in upload heap should stay in GENERIC_READ state.
+		auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(createParams.sizeInBytes, D3D12_RESOURCE_FLAG_NONE, createParams.alignment);
+		HR(rawDevice->CreateCommittedResource(
+			&heapProps,
+			D3D12_HEAP_FLAG_NONE,
+			&bufferDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(defaultBuffer.GetAddressOf())));
+
+		CD3DX12_RANGE readRange(0, 0);
+		HR(defaultBuffer->Map(0, &readRange, reinterpret_cast<void**>(&defaultMapPtr)));
+		CHECK(defaultMapPtr != nullptr);
+	}
+	else
 	{
 		D3D12_RESOURCE_FLAGS resourceFlags = into_d3d::bufferResourceFlags(createParams.accessFlags);
 		auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
@@ -16,6 +16,8 @@ public:
 	virtual void writeToGPU(RenderCommandList* commandList, uint32 numUploads, Buffer::UploadDesc* uploadDescs) override;
 	virtual SharedPtr<ReadbackHandle> requestReadback(RenderCommandList* commandList, uint64 offset, uint64 size) override;
 
+	virtual uint8* getMappedPointer() const override { return defaultMapPtr; }
+
 	virtual void* getRawResource() const { return defaultBuffer.Get(); }
 	virtual void setDebugName(const wchar_t* inDebugName) override;
 
@@ -28,6 +30,7 @@ private:
 	D3DDevice* device = nullptr;
 
 	WRL::ComPtr<ID3D12Resource> defaultBuffer;
+	uint8* defaultMapPtr = nullptr; // Only if UPLOAD_HEAP
 
 	// #todo-renderdevice: Always holding an upload buffer
 	// as the same size as the default buffer is inefficient.
@@ -51,6 +54,7 @@ public:
 	virtual void initialize(uint32 sizeInBytes, EBufferAccessFlags usageFlags) override;
 	virtual void initializeWithinPool(VertexBufferPool* pool, uint64 offsetInPool, uint32 sizeInBytes) override;
 	virtual void updateData(RenderCommandList* commandList, void* data, uint32 strideInBytes) override;
+	virtual void setStrideInBytes(uint32 strideInBytes) override;
 	virtual uint32 getVertexCount() const override { return vertexCount; };
 	virtual uint64 getBufferOffsetInBytes() const override { return offsetInDefaultBuffer; }
 	virtual uint32 getBufferSizeInBytes() const override { return view.SizeInBytes; }
@@ -90,6 +94,7 @@ public:
 	virtual void initialize(uint32 sizeInBytes, EPixelFormat format, EBufferAccessFlags usageFlags) override;
 	virtual void initializeWithinPool(IndexBufferPool* pool, uint64 offsetInPool, uint32 sizeInBytes) override;
 	virtual void updateData(RenderCommandList* commandList, void* data, EPixelFormat format) override;
+	virtual void setIndexFormat(EPixelFormat format) override;
 	virtual uint32 getIndexCount() const override { return indexCount; }
 	virtual EPixelFormat getIndexFormat() const override { return indexFormat; }
 	virtual uint64 getBufferOffsetInBytes() const override { return offsetInDefaultBuffer; }
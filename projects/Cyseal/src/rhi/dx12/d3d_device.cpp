@@ -361,10 +361,14 @@ void D3DDevice::beginDearImguiNewFrame()
 	ImGui_ImplDX12_NewFrame();
 }
 
-void D3DDevice::renderDearImgui(RenderCommandList* commandList, SwapChainImage* swapChainImage)
+void D3DDevice::renderDearImgui(RenderCommandList* commandList, SwapChainImage* swapChainImage, ImDrawData* drawData)
 {
+	if (drawData == nullptr)
+	{
+		return;
+	}
 	auto d3dCmdList = static_cast<D3DRenderCommandList*>(commandList)->getRaw();
-	ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), d3dCmdList);
+	ImGui_ImplDX12_RenderDrawData(drawData, d3dCmdList);
 }
 
 void D3DDevice::shutdownDearImgui()
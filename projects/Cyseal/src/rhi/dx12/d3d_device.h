@@ -37,7 +37,7 @@ public:
 
 	virtual void initializeDearImgui() override;
 	virtual void beginDearImguiNewFrame() override;
-	virtual void renderDearImgui(RenderCommandList* commandList, SwapChainImage* swapChainImage) override;
+	virtual void renderDearImgui(RenderCommandList* commandList, SwapChainImage* swapChainImage, ImDrawData* drawData) override;
 	virtual void shutdownDearImgui() override;
 
 	// ------------------------------------------------------------------------
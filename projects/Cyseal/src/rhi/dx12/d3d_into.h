@@ -252,6 +252,9 @@ namespace into_d3d
 			case EPixelFormat::B8G8R8A8_UNORM           : return DXGI_FORMAT_B8G8R8A8_UNORM;
 			case EPixelFormat::R8G8_UNORM               : return DXGI_FORMAT_R8G8_UNORM;
 			case EPixelFormat::R8_UNORM                 : return DXGI_FORMAT_R8_UNORM;
+			case EPixelFormat::R16G16B16A16_UNORM       : return DXGI_FORMAT_R16G16B16A16_UNORM;
+			case EPixelFormat::R16G16_UNORM             : return DXGI_FORMAT_R16G16_UNORM;
+			case EPixelFormat::R16_UNORM                : return DXGI_FORMAT_R16_UNORM;
 			case EPixelFormat::R32_FLOAT                : return DXGI_FORMAT_R32_FLOAT;
 			case EPixelFormat::R32G32_FLOAT             : return DXGI_FORMAT_R32G32_FLOAT;
 			case EPixelFormat::R32G32B32_FLOAT          : return DXGI_FORMAT_R32G32B32_FLOAT;
@@ -265,6 +268,11 @@ namespace into_d3d
 			case EPixelFormat::R16G16_UINT              : return DXGI_FORMAT_R16G16_UINT;
 			case EPixelFormat::R32G32B32A32_UINT        : return DXGI_FORMAT_R32G32B32A32_UINT;
 			case EPixelFormat::R16G16_SINT              : return DXGI_FORMAT_R16G16_SINT;
+			case EPixelFormat::BC1_UNORM                : return DXGI_FORMAT_BC1_UNORM;
+			case EPixelFormat::BC3_UNORM                : return DXGI_FORMAT_BC3_UNORM;
+			case EPixelFormat::BC4_UNORM                : return DXGI_FORMAT_BC4_UNORM;
+			case EPixelFormat::BC5_UNORM                : return DXGI_FORMAT_BC5_UNORM;
+			case EPixelFormat::BC7_UNORM                : return DXGI_FORMAT_BC7_UNORM;
 			case EPixelFormat::D24_UNORM_S8_UINT        : return DXGI_FORMAT_D24_UNORM_S8_UINT;
 			case EPixelFormat::D32_FLOAT_S8_UINT        : return DXGI_FORMAT_D32_FLOAT_S8X24_UINT;
 		}
@@ -636,7 +636,7 @@ void D3DIndirectCommandGenerator::initialize(
 
 void D3DIndirectCommandGenerator::resizeMaxCommandCount(uint32 newMaxCount)
 {
-	CHECK(byteStride != 0 && currentWritePtr == nullptr);
+	CHECK(byteStride != 0 && cursor.writePtr == nullptr);
 
 	maxCommandCount = newMaxCount;
 	if (memblock != nullptr)
@@ -648,58 +648,60 @@ void D3DIndirectCommandGenerator::resizeMaxCommandCount(uint32 newMaxCount)
 
 void D3DIndirectCommandGenerator::beginCommand(uint32 commandIx)
 {
-	CHECK(currentWritePtr == nullptr && commandIx < maxCommandCount);
-	currentWritePtr = memblock + byteStride * commandIx;
+	CHECK(commandIx < maxCommandCount);
+	IndirectCommandGenerator::beginCommand(cursor, memblock + byteStride * commandIx);
 }
 
-void D3DIndirectCommandGenerator::writeConstant32(uint32 constant)
+void D3DIndirectCommandGenerator::writeConstant32(IndirectCommandCursor& inCursor, uint32 constant) const
 {
-	CHECK(currentWritePtr != nullptr);
-	::memcpy_s(currentWritePtr, sizeof(uint32), &constant, sizeof(uint32));
-	currentWritePtr += sizeof(uint32);
+	CHECK(inCursor.writePtr != nullptr);
+	::memcpy_s(inCursor.writePtr, sizeof(uint32), &constant, sizeof(uint32));
+	inCursor.writePtr += sizeof(uint32);
 }
 
-void D3DIndirectCommandGenerator::writeVertexBufferView(VertexBuffer* vbuffer)
+void D3DIndirectCommandGenerator::writeVertexBufferView(IndirectCommandCursor& inCursor, VertexBuffer* vbuffer) const
 {
-	CHECK(currentWritePtr != nullptr);
+	CHECK(inCursor.writePtr != nullptr);
 	D3D12_VERTEX_BUFFER_VIEW view = static_cast<D3DVertexBuffer*>(vbuffer)->getVertexBufferView();
-	::memcpy_s(currentWritePtr, sizeof(D3D12_VERTEX_BUFFER_VIEW), &view, sizeof(D3D12_VERTEX_BUFFER_VIEW));
-	currentWritePtr += sizeof(D3D12_VERTEX_BUFFER_VIEW);
+	::memcpy_s(inCursor.writePtr, sizeof(D3D12_VERTEX_BUFFER_VIEW), &view, sizeof(D3D12_VERTEX_BUFFER_VIEW));
+	inCursor.writePtr += sizeof(D3D12_VERTEX_BUFFER_VIEW);
 }
 
-void D3DIndirectCommandGenerator::writeIndexBufferView(IndexBuffer* ibuffer)
+void D3DIndirectCommandGenerator::writeIndexBufferView(IndirectCommandCursor& inCursor, IndexBuffer* ibuffer) const
 {
-	CHECK(currentWritePtr != nullptr);
+	CHECK(inCursor.writePtr != nullptr);
 	D3D12_INDEX_BUFFER_VIEW view = static_cast<D3DIndexBuffer*>(ibuffer)->getIndexBufferView();
-	::memcpy_s(currentWritePtr, sizeof(D3D12_INDEX_BUFFER_VIEW), &view, sizeof(D3D12_INDEX_BUFFER_VIEW));
-	currentWritePtr += sizeof(D3D12_INDEX_BUFFER_VIEW);
+	::memcpy_s(inCursor.writePtr, sizeof(D3D12_INDEX_BUFFER_VIEW), &view, sizeof(D3D12_INDEX_BUFFER_VIEW));
+	inCursor.writePtr += sizeof(D3D12_INDEX_BUFFER_VIEW);
 }
 
 void D3DIndirectCommandGenerator::writeDrawArguments(
+	IndirectCommandCursor& inCursor,
 	uint32 vertexCountPerInstance,
 	uint32 instanceCount,
 	uint32 startVertexLocation,
-	uint32 startInstanceLocation)
+	uint32 startInstanceLocation) const
 {
-	CHECK(currentWritePtr != nullptr);
+	CHECK(inCursor.writePtr != nullptr);
 	D3D12_DRAW_ARGUMENTS args{
 		.VertexCountPerInstance = vertexCountPerInstance,
 		.InstanceCount = instanceCount,
 		.StartVertexLocation = startVertexLocation,
 		.StartInstanceLocation = startInstanceLocation
 	};
-	::memcpy_s(currentWritePtr, sizeof(D3D12_DRAW_ARGUMENTS), &args, sizeof(D3D12_DRAW_ARGUMENTS));
-	currentWritePtr += sizeof(D3D12_DRAW_ARGUMENTS);
+	::memcpy_s(inCursor.writePtr, sizeof(D3D12_DRAW_ARGUMENTS), &args, sizeof(D3D12_DRAW_ARGUMENTS));
+	inCursor.writePtr += sizeof(D3D12_DRAW_ARGUMENTS);
 }
 
 void D3DIndirectCommandGenerator::writeDrawIndexedArguments(
+	IndirectCommandCursor& inCursor,
 	uint32 indexCountPerInstance,
 	uint32 instanceCount,
 	uint32 startIndexLocation,
 	int32 baseVertexLocation,
-	uint32 startInstanceLocation)
+	uint32 startInstanceLocation) const
 {
-	CHECK(currentWritePtr != nullptr);
+	CHECK(inCursor.writePtr != nullptr);
 	D3D12_DRAW_INDEXED_ARGUMENTS args{
 		.IndexCountPerInstance = indexCountPerInstance,
 		.InstanceCount = instanceCount,
@@ -707,75 +709,77 @@ void D3DIndirectCommandGenerator::writeDrawIndexedArguments(
 		.BaseVertexLocation = baseVertexLocation,
 		.StartInstanceLocation = startInstanceLocation,
 	};
-	::memcpy_s(currentWritePtr, sizeof(D3D12_DRAW_INDEXED_ARGUMENTS), &args, sizeof(D3D12_DRAW_INDEXED_ARGUMENTS));
-	currentWritePtr += sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
+	::memcpy_s(inCursor.writePtr, sizeof(D3D12_DRAW_INDEXED_ARGUMENTS), &args, sizeof(D3D12_DRAW_INDEXED_ARGUMENTS));
+	inCursor.writePtr += sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
 }
 
 void D3DIndirectCommandGenerator::writeDispatchArguments(
+	IndirectCommandCursor& inCursor,
 	uint32 threadGroupCountX,
 	uint32 threadGroupCountY,
-	uint32 threadGroupCountZ)
+	uint32 threadGroupCountZ) const
 {
-	CHECK(currentWritePtr != nullptr);
+	CHECK(inCursor.writePtr != nullptr);
 	D3D12_DISPATCH_ARGUMENTS args{
 		.ThreadGroupCountX = threadGroupCountX,
 		.ThreadGroupCountY = threadGroupCountY,
 		.ThreadGroupCountZ = threadGroupCountZ
 	};
-	::memcpy_s(currentWritePtr, sizeof(D3D12_DISPATCH_ARGUMENTS), &args, sizeof(D3D12_DISPATCH_ARGUMENTS));
-	currentWritePtr += sizeof(D3D12_DISPATCH_ARGUMENTS);
+	::memcpy_s(inCursor.writePtr, sizeof(D3D12_DISPATCH_ARGUMENTS), &args, sizeof(D3D12_DISPATCH_ARGUMENTS));
+	inCursor.writePtr += sizeof(D3D12_DISPATCH_ARGUMENTS);
 }
 
-void D3DIndirectCommandGenerator::writeConstantBufferView(ConstantBufferView* view)
+void D3DIndirectCommandGenerator::writeConstantBufferView(IndirectCommandCursor& inCursor, ConstantBufferView* view) const
 {
 	D3D12_GPU_VIRTUAL_ADDRESS addr = static_cast<D3DConstantBufferView*>(view)->getGPUVirtualAddress();
-	::memcpy_s(currentWritePtr, sizeof(D3D12_GPU_VIRTUAL_ADDRESS), &addr, sizeof(D3D12_GPU_VIRTUAL_ADDRESS));
-	currentWritePtr += sizeof(D3D12_GPU_VIRTUAL_ADDRESS);
+	::memcpy_s(inCursor.writePtr, sizeof(D3D12_GPU_VIRTUAL_ADDRESS), &addr, sizeof(D3D12_GPU_VIRTUAL_ADDRESS));
+	inCursor.writePtr += sizeof(D3D12_GPU_VIRTUAL_ADDRESS);
 }
 
-void D3DIndirectCommandGenerator::writeShaderResourceView(ShaderResourceView* view)
+void D3DIndirectCommandGenerator::writeShaderResourceView(IndirectCommandCursor& inCursor, ShaderResourceView* view) const
 {
 	D3D12_GPU_VIRTUAL_ADDRESS addr = static_cast<D3DShaderResourceView*>(view)->getGPUVirtualAddress();
-	::memcpy_s(currentWritePtr, sizeof(D3D12_GPU_VIRTUAL_ADDRESS), &addr, sizeof(D3D12_GPU_VIRTUAL_ADDRESS));
-	currentWritePtr += sizeof(D3D12_GPU_VIRTUAL_ADDRESS);
+	::memcpy_s(inCursor.writePtr, sizeof(D3D12_GPU_VIRTUAL_ADDRESS), &addr, sizeof(D3D12_GPU_VIRTUAL_ADDRESS));
+	inCursor.writePtr += sizeof(D3D12_GPU_VIRTUAL_ADDRESS);
 }
 
-void D3DIndirectCommandGenerator::writeUnorderedAccessView(UnorderedAccessView* view)
+void D3DIndirectCommandGenerator::writeUnorderedAccessView(IndirectCommandCursor& inCursor, UnorderedAccessView* view) const
 {
 	D3D12_GPU_VIRTUAL_ADDRESS addr = static_cast<D3DUnorderedAccessView*>(view)->getGPUVirtualAddress();
-	::memcpy_s(currentWritePtr, sizeof(D3D12_GPU_VIRTUAL_ADDRESS), &addr, sizeof(D3D12_GPU_VIRTUAL_ADDRESS));
-	currentWritePtr += sizeof(D3D12_GPU_VIRTUAL_ADDRESS);
+	::memcpy_s(inCursor.writePtr, sizeof(D3D12_GPU_VIRTUAL_ADDRESS), &addr, sizeof(D3D12_GPU_VIRTUAL_ADDRESS));
+	inCursor.writePtr += sizeof(D3D12_GPU_VIRTUAL_ADDRESS);
 }
 
-void D3DIndirectCommandGenerator::writeDispatchRaysArguments(const DispatchRaysDesc& inDesc)
+void D3DIndirectCommandGenerator::writeDispatchRaysArguments(IndirectCommandCursor& inCursor, const DispatchRaysDesc& inDesc) const
 {
 	// https://microsoft.github.io/DirectX-Specs/d3d/IndirectDrawing.html#indirect-argument-buffer-structures
 	D3D12_DISPATCH_RAYS_DESC desc;
 	into_d3d::dispatchRaysDesc(inDesc, desc);
-	::memcpy_s(currentWritePtr, sizeof(desc), &desc, sizeof(desc));
-	currentWritePtr += sizeof(desc);
+	::memcpy_s(inCursor.writePtr, sizeof(desc), &desc, sizeof(desc));
+	inCursor.writePtr += sizeof(desc);
 }
 
 void D3DIndirectCommandGenerator::writeDispatchMeshArguments(
+	IndirectCommandCursor& inCursor,
 	uint32 threadGroupCountX,
 	uint32 threadGroupCountY,
-	uint32 threadGroupCountZ)
+	uint32 threadGroupCountZ) const
 {
-	CHECK(currentWritePtr != nullptr);
+	CHECK(inCursor.writePtr != nullptr);
 	D3D12_DISPATCH_MESH_ARGUMENTS args{
 		.ThreadGroupCountX = threadGroupCountX,
 		.ThreadGroupCountY = threadGroupCountY,
 		.ThreadGroupCountZ = threadGroupCountZ
 	};
-	::memcpy_s(currentWritePtr, sizeof(D3D12_DISPATCH_MESH_ARGUMENTS), &args, sizeof(D3D12_DISPATCH_MESH_ARGUMENTS));
-	currentWritePtr += sizeof(D3D12_DISPATCH_MESH_ARGUMENTS);
+	::memcpy_s(inCursor.writePtr, sizeof(D3D12_DISPATCH_MESH_ARGUMENTS), &args, sizeof(D3D12_DISPATCH_MESH_ARGUMENTS));
+	inCursor.writePtr += sizeof(D3D12_DISPATCH_MESH_ARGUMENTS);
 }
 
-void D3DIndirectCommandGenerator::endCommand()
+void D3DIndirectCommandGenerator::endCommand(IndirectCommandCursor& inCursor) const
 {
-	CHECK(currentWritePtr != nullptr);
-	::memset(currentWritePtr, 0, paddingBytes);
-	currentWritePtr = nullptr;
+	CHECK(inCursor.writePtr != nullptr);
+	::memset(inCursor.writePtr, 0, paddingBytes);
+	inCursor.writePtr = nullptr;
 }
 
 void D3DIndirectCommandGenerator::copyToBuffer(RenderCommandList* commandList, uint32 numCommands, Buffer* destBuffer, uint64 destOffset)
@@ -224,41 +224,46 @@ public:
 
 	virtual void resizeMaxCommandCount(uint32 newMaxCount) override;
 
-	//~ BEGIN stateful API
 	virtual void beginCommand(uint32 commandIx) override;
 
-	virtual void writeConstant32(uint32 constant) override;
-	virtual void writeVertexBufferView(VertexBuffer* vbuffer) override;
-	virtual void writeIndexBufferView(IndexBuffer* ibuffer) override;
+	//~ BEGIN cursor API
+	virtual void writeConstant32(IndirectCommandCursor& inCursor, uint32 constant) const override;
+	virtual void writeVertexBufferView(IndirectCommandCursor& inCursor, VertexBuffer* vbuffer) const override;
+	virtual void writeIndexBufferView(IndirectCommandCursor& inCursor, IndexBuffer* ibuffer) const override;
 	virtual void writeDrawArguments(
+		IndirectCommandCursor& inCursor,
 		uint32 vertexCountPerInstance,
 		uint32 instanceCount,
 		uint32 startVertexLocation,
-		uint32 startInstanceLocation) override;
+		uint32 startInstanceLocation) const override;
 	virtual void writeDrawIndexedArguments(
+		IndirectCommandCursor& inCursor,
 		uint32 indexCountPerInstance,
 		uint32 instanceCount,
 		uint32 startIndexLocation,
 		int32  baseVertexLocation,
-		uint32 startInstanceLocation) override;
+		uint32 startInstanceLocation) const override;
 	virtual void writeDispatchArguments(
+		IndirectCommandCursor& inCursor,
 		uint32 threadGroupCountX,
 		uint32 threadGroupCountY,
-		uint32 threadGroupCountZ) override;
-	virtual void writeConstantBufferView(ConstantBufferView* view) override;
-	virtual void writeShaderResourceView(ShaderResourceView* view) override;
-	virtual void writeUnorderedAccessView(UnorderedAccessView* view) override;
-	virtual void writeDispatchRaysArguments(const DispatchRaysDesc& desc) override;
+		uint32 threadGroupCountZ) const override;
+	virtual void writeConstantBufferView(IndirectCommandCursor& inCursor, ConstantBufferView* view) const override;
+	virtual void writeShaderResourceView(IndirectCommandCursor& inCursor, ShaderResourceView* view) const override;
+	virtual void writeUnorderedAccessView(IndirectCommandCursor& inCursor, UnorderedAccessView* view) const override;
+	virtual void writeDispatchRaysArguments(IndirectCommandCursor& inCursor, const DispatchRaysDesc& desc) const override;
 	virtual void writeDispatchMeshArguments(
+		IndirectCommandCursor& inCursor,
 		uint32 threadGroupCountX,
 		uint32 threadGroupCountY,
-		uint32 threadGroupCountZ) override;
+		uint32 threadGroupCountZ) const override;
 
-	virtual void endCommand() override;
-	//~ END stateful API
+	virtual void endCommand(IndirectCommandCursor& inCursor) const override;
+	//~ END cursor API
 
 	virtual uint32 getMaxCommandCount() const override { return maxCommandCount; }
 	virtual uint32 getCommandByteStride() const override { return byteStride; }
+	virtual const uint8* getCommandData() const override { return memblock; }
 	virtual void copyToBuffer(RenderCommandList* commandList, uint32 numCommands, Buffer* destBuffer, uint64 destOffset) override;
 
 private:
@@ -267,5 +272,4 @@ private:
 	uint32 paddingBytes = 0;
 
 	uint8* memblock = nullptr;
-	uint8* currentWritePtr = nullptr;
 };
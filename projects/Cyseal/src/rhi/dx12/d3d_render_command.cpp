@@ -303,6 +303,76 @@ void D3DRenderCommandList::copyTexture2D(Texture* src, Texture* dst)
 	commandList->CopyTextureRegion(&pDst, 0, 0, 0, &pSrc, &srcRegion);
 }
 
+void D3DRenderCommandList::copyTextureSubresource(Texture* src, uint32 srcSubresourceIndex, Texture* dst, uint32 dstSubresourceIndex)
+{
+	D3D12_TEXTURE_COPY_LOCATION pDst{
+		.pResource        = into_d3d::id3d12Resource(dst),
+		.Type             = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+		.SubresourceIndex = dstSubresourceIndex,
+	};
+	D3D12_TEXTURE_COPY_LOCATION pSrc{
+		.pResource        = into_d3d::id3d12Resource(src),
+		.Type             = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+		.SubresourceIndex = srcSubresourceIndex,
+	};
+	commandList->CopyTextureRegion(&pDst, 0, 0, 0, &pSrc, nullptr);
+}
+
+void D3DRenderCommandList::copyBufferToTexture(Buffer* src, uint64 srcOffset, uint64 srcRowPitch, Texture* dst, uint32 subresourceIndex)
+{
+	CHECK(srcOffset % D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT == 0);
+	CHECK(srcRowPitch % D3D12_TEXTURE_DATA_PITCH_ALIGNMENT == 0);
+
+	ID3D12Resource* rawDst = into_d3d::id3d12Resource(dst);
+	const D3D12_RESOURCE_DESC dstDesc = rawDst->GetDesc();
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+	device->getRawDevice()->GetCopyableFootprints(&dstDesc, subresourceIndex, 1, 0, &footprint, nullptr, nullptr, nullptr);
+	// The footprint has the minimum aligned pitch, which is what the source rows were packed with.
+	CHECK(footprint.Footprint.RowPitch == srcRowPitch);
+	footprint.Offset = srcOffset;
+
+	D3D12_TEXTURE_COPY_LOCATION pDst{
+		.pResource        = rawDst,
+		.Type             = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+		.SubresourceIndex = subresourceIndex,
+	};
+	D3D12_TEXTURE_COPY_LOCATION pSrc{
+		.pResource        = into_d3d::id3d12Resource(src),
+		.Type             = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT,
+		.PlacedFootprint  = footprint,
+	};
+	commandList->CopyTextureRegion(&pDst, 0, 0, 0, &pSrc, nullptr);
+}
+
+// Pool buffers stay in GENERIC_READ outside of copies. (See updateDefaultBuffer() in d3d_buffer.cpp)
+static void transitionPooledBuffers(ID3D12GraphicsCommandList* commandList, uint32 numPools, GPUResource* const* pools,
+	D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter)
+{
+	std::vector<D3D12_RESOURCE_BARRIER> barriers(numPools);
+	for (uint32 i = 0; i < numPools; ++i)
+	{
+		barriers[i] = CD3DX12_RESOURCE_BARRIER::Transition(into_d3d::id3d12Resource(pools[i]), stateBefore, stateAfter);
+	}
+	commandList->ResourceBarrier(numPools, barriers.data());
+}
+
+void D3DRenderCommandList::beginPooledBufferCopies(uint32 numPools, GPUResource* const* pools)
+{
+	transitionPooledBuffers(commandList.Get(), numPools, pools, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST);
+}
+
+void D3DRenderCommandList::copyBufferToPooledBuffer(Buffer* src, uint64 srcOffset, uint64 numBytes, GPUResource* dstPool, uint64 dstOffset)
+{
+	auto pSrc = into_d3d::id3d12Resource(src);
+	auto pDst = into_d3d::id3d12Resource(dstPool);
+	commandList->CopyBufferRegion(pDst, dstOffset, pSrc, srcOffset, numBytes);
+}
+
+void D3DRenderCommandList::endPooledBufferCopies(uint32 numPools, GPUResource* const* pools)
+{
+	transitionPooledBuffers(commandList.Get(), numPools, pools, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+}
+
 void D3DRenderCommandList::omSetRenderTarget(RenderTargetView* RTV, DepthStencilView* DSV)
 {
 	CHECK(RTV != nullptr || DSV != nullptr); // At least one of them should exist... right?
@@ -110,6 +110,21 @@ size_t bitsPerPixel(DXGI_FORMAT fmt)
 	case DXGI_FORMAT_NV11:
 		return 12;
 
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
 	case DXGI_FORMAT_R8_TYPELESS:
 	case DXGI_FORMAT_R8_UNORM:
 	case DXGI_FORMAT_R8_UINT:
@@ -205,13 +220,26 @@ void D3DTexture::initialize(const TextureCreateParams& params)
 	{
 		numSubresources = 1;
 	}
-	const UINT64 uploadBufferSize = ::GetRequiredIntermediateSize(rawResource.Get(), 0, numSubresources);
 	// Maybe better to just use slice pitch instead of using upload buffer size?
-	const UINT64 readbackBufferSize = Cymath::alignBytes64(uploadBufferSize, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+	const UINT64 readbackBufferSize = Cymath::alignBytes64(
+		::GetRequiredIntermediateSize(rawResource.Get(), 0, numSubresources),
+		D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
 
 	// Create optional resources if this texture supports upload and/or readback.
 	if (ENUM_HAS_FLAG(params.accessFlags, ETextureAccessFlags::CPU_WRITE))
 	{
+		// Every mip has its own region in the upload heap, so that all mips can be uploaded in the same command list.
+		const D3D12_RESOURCE_DESC actualDesc = rawResource->GetDesc();
+		const uint32 numUploadSubresources = numSubresources * actualDesc.MipLevels;
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(numUploadSubresources);
+		UINT64 uploadBufferSize = 0;
+		rawDevice->GetCopyableFootprints(&actualDesc, 0, numUploadSubresources, 0, footprints.data(), nullptr, nullptr, &uploadBufferSize);
+		uploadOffsets.resize(numUploadSubresources);
+		for (uint32 i = 0; i < numUploadSubresources; ++i)
+		{
+			uploadOffsets[i] = footprints[i].Offset;
+		}
+
 		auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
 		auto uploadBufferDesc = CD3DX12_RESOURCE_DESC1::Buffer(uploadBufferSize);
 		HR(rawDevice->CreateCommittedResource3(
@@ -279,14 +307,14 @@ void D3DTexture::uploadData(
 	};
 	commandList->barrierAuto(0, nullptr, 1, &barrierBefore, 0, nullptr);
 
+	// Offsets from GetCopyableFootprints() are multiples of 512.
 	// [ RESOURCE_MANIPULATION ERROR #864: COPYTEXTUREREGION_INVALIDSRCOFFSET ]
-	// Offset must be a multiple of 512.
-	uint64 slicePitchAligned = (slicePitch + 511) & ~511;
+	CHECK(subresourceIndex < uploadOffsets.size());
 
 	UINT64 ret = ::UpdateSubresources(
 		static_cast<D3DRenderCommandList*>(commandList)->getRaw(),
 		rawResource.Get(),
-		textureUploadHeap.Get(), slicePitchAligned * subresourceIndex,
+		textureUploadHeap.Get(), uploadOffsets[subresourceIndex],
 		subresourceIndex, 1, &textureData);
 	CHECK(ret != 0);
 }
@@ -4,6 +4,8 @@
 #include "rhi/gpu_resource_barrier.h"
 #include "d3d_util.h"
 
+#include <vector>
+
 class D3DDevice;
 
 class D3DTexture : public Texture
@@ -42,6 +44,7 @@ private:
 	// We will flush the GPU at the end of this method to ensure the resource is not
 	// prematurely destroyed.
 	WRL::ComPtr<ID3D12Resource> textureUploadHeap;
+	std::vector<uint64> uploadOffsets; // Offset of each subresource in textureUploadHeap
 
 	size_t bytesPerPixel = 0;
 	uint64 rowPitch = 0;
@@ -3,6 +3,7 @@
 #include "rhi_forward.h"
 #include "pixel_format.h"
 #include "core/int_types.h"
+#include "core/assertion.h"
 #include "util/enum_util.h"
 
 #include <vector>
@@ -657,6 +658,12 @@ public:
 	virtual ~CommandSignature() = default;
 };
 
+// Write position of an indirect command. See IndirectCommandGenerator.
+struct IndirectCommandCursor
+{
+	uint8* writePtr = nullptr;
+};
+
 // RHI-agnostic interface to fill indirect commands.
 // This is just a memory writer and not a GPU resource,
 // but requires different implementations for different backends.
@@ -669,38 +676,103 @@ public:
 
 	virtual void resizeMaxCommandCount(uint32 newMaxCount) = 0;
 
+	//~ BEGIN stateful API
+	// Writes commands to the internal memory, one command at a time.
 	virtual void beginCommand(uint32 commandIx) = 0;
 
-	virtual void writeConstant32(uint32 constant) = 0;
-	virtual void writeVertexBufferView(VertexBuffer* vbuffer) = 0;
-	virtual void writeIndexBufferView(IndexBuffer* ibuffer) = 0;
+	inline void writeConstant32(uint32 constant) { writeConstant32(cursor, constant); }
+	inline void writeVertexBufferView(VertexBuffer* vbuffer) { writeVertexBufferView(cursor, vbuffer); }
+	inline void writeIndexBufferView(IndexBuffer* ibuffer) { writeIndexBufferView(cursor, ibuffer); }
+	inline void writeDrawArguments(
+		uint32 vertexCountPerInstance,
+		uint32 instanceCount,
+		uint32 startVertexLocation,
+		uint32 startInstanceLocation)
+	{
+		writeDrawArguments(cursor, vertexCountPerInstance, instanceCount, startVertexLocation, startInstanceLocation);
+	}
+	inline void writeDrawIndexedArguments(
+		uint32 indexCountPerInstance,
+		uint32 instanceCount,
+		uint32 startIndexLocation,
+		int32  baseVertexLocation,
+		uint32 startInstanceLocation)
+	{
+		writeDrawIndexedArguments(cursor, indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
+	}
+	inline void writeDispatchArguments(
+		uint32 threadGroupCountX,
+		uint32 threadGroupCountY,
+		uint32 threadGroupCountZ)
+	{
+		writeDispatchArguments(cursor, threadGroupCountX, threadGroupCountY, threadGroupCountZ);
+	}
+	inline void writeConstantBufferView(ConstantBufferView* view) { writeConstantBufferView(cursor, view); }
+	inline void writeShaderResourceView(ShaderResourceView* view) { writeShaderResourceView(cursor, view); }
+	inline void writeUnorderedAccessView(UnorderedAccessView* view) { writeUnorderedAccessView(cursor, view); }
+	inline void writeDispatchRaysArguments(const DispatchRaysDesc& desc) { writeDispatchRaysArguments(cursor, desc); }
+	inline void writeDispatchMeshArguments(
+		uint32 threadGroupCountX,
+		uint32 threadGroupCountY,
+		uint32 threadGroupCountZ)
+	{
+		writeDispatchMeshArguments(cursor, threadGroupCountX, threadGroupCountY, threadGroupCountZ);
+	}
+
+	inline void endCommand() { endCommand(cursor); }
+	//~ END stateful API
+
+	//~ BEGIN cursor API
+	// Same as the stateful API, but the caller owns the write position.
+	// The generator is not modified, so multiple threads can write disjoint commands at the same time,
+	// directly to any memory (e.g., a mapped upload buffer) of getCommandByteStride() bytes per command.
+	inline void beginCommand(IndirectCommandCursor& outCursor, uint8* commandPtr) const
+	{
+		CHECK(outCursor.writePtr == nullptr && commandPtr != nullptr);
+		outCursor.writePtr = commandPtr;
+	}
+
+	virtual void writeConstant32(IndirectCommandCursor& inCursor, uint32 constant) const = 0;
+	virtual void writeVertexBufferView(IndirectCommandCursor& inCursor, VertexBuffer* vbuffer) const = 0;
+	virtual void writeIndexBufferView(IndirectCommandCursor& inCursor, IndexBuffer* ibuffer) const = 0;
 	virtual void writeDrawArguments(
+		IndirectCommandCursor& inCursor,
 		uint32 vertexCountPerInstance,
 		uint32 instanceCount,
 		uint32 startVertexLocation,
-		uint32 startInstanceLocation) = 0;
+		uint32 startInstanceLocation) const = 0;
 	virtual void writeDrawIndexedArguments(
+		IndirectCommandCursor& inCursor,
 		uint32 indexCountPerInstance,
 		uint32 instanceCount,
 		uint32 startIndexLocation,
 		int32  baseVertexLocation,
-		uint32 startInstanceLocation) = 0;
+		uint32 startInstanceLocation) const = 0;
 	virtual void writeDispatchArguments(
+		IndirectCommandCursor& inCursor,
 		uint32 threadGroupCountX,
 		uint32 threadGroupCountY,
-		uint32 threadGroupCountZ) = 0;
-	virtual void writeConstantBufferView(ConstantBufferView* view) = 0;
-	virtual void writeShaderResourceView(ShaderResourceView* view) = 0;
-	virtual void writeUnorderedAccessView(UnorderedAccessView* view) = 0;
-	virtual void writeDispatchRaysArguments(const DispatchRaysDesc& desc) = 0;
+		uint32 threadGroupCountZ) const = 0;
+	virtual void writeConstantBufferView(IndirectCommandCursor& inCursor, ConstantBufferView* view) const = 0;
+	virtual void writeShaderResourceView(IndirectCommandCursor& inCursor, ShaderResourceView* view) const = 0;
+	virtual void writeUnorderedAccessView(IndirectCommandCursor& inCursor, UnorderedAccessView* view) const = 0;
+	virtual void writeDispatchRaysArguments(IndirectCommandCursor& inCursor, const DispatchRaysDesc& desc) const = 0;
 	virtual void writeDispatchMeshArguments(
+		IndirectCommandCursor& inCursor,
 		uint32 threadGroupCountX,
 		uint32 threadGroupCountY,
-		uint32 threadGroupCountZ) = 0;
+		uint32 threadGroupCountZ) const = 0;
 
-	virtual void endCommand() = 0;
+	virtual void endCommand(IndirectCommandCursor& inCursor) const = 0;
+	//~ END cursor API
 
 	virtual uint32 getMaxCommandCount() const = 0;
 	virtual uint32 getCommandByteStride() const = 0;
+	// Written commands in CPU memory. (getCommandByteStride() * numCommands) bytes are valid.
+	virtual const uint8* getCommandData() const = 0;
 	virtual void copyToBuffer(RenderCommandList* commandList, uint32 numCommands, Buffer* destBuffer, uint64 destOffset) = 0;
+
+protected:
+	// Write position of the stateful API.
+	IndirectCommandCursor cursor;
 };
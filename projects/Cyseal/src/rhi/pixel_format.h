@@ -8,6 +8,7 @@
 // - isDepthStencilFormat()
 // - into_d3d::pixelFormat()
 // - into_vk::pixelFormat()
+// - isBlockCompressedFormat() and getBlockCompressedBlockBytes() if block compressed
 enum class EPixelFormat : uint8
 {
 	UNKNOWN,
@@ -24,6 +25,9 @@ enum class EPixelFormat : uint8
 	B8G8R8A8_UNORM,
 	R8G8_UNORM,
 	R8_UNORM,
+	R16G16B16A16_UNORM,
+	R16G16_UNORM,
+	R16_UNORM,
 	
 	// FLOAT
 	R32_FLOAT,
@@ -44,11 +48,19 @@ enum class EPixelFormat : uint8
 	// SINT
 	R16G16_SINT,
 
+	// Block compressed (4x4 texels per block)
+	BC1_UNORM,
+	BC3_UNORM,
+	BC4_UNORM,
+	BC5_UNORM,
+	BC7_UNORM,
+
 	// DepthStencil
 	D24_UNORM_S8_UINT,
 	D32_FLOAT_S8_UINT,
 };
 
+// Not for block compressed formats. See getPixelFormatRowBytes().
 inline uint32 getPixelFormatBytes(EPixelFormat format)
 {
 	// #todo-rhi: Ignore depth formats?
@@ -65,6 +77,9 @@ inline uint32 getPixelFormatBytes(EPixelFormat format)
 		case EPixelFormat::B8G8R8A8_UNORM           : return 4;
 		case EPixelFormat::R8G8_UNORM               : return 2;
 		case EPixelFormat::R8_UNORM                 : return 1;
+		case EPixelFormat::R16G16B16A16_UNORM       : return 8;
+		case EPixelFormat::R16G16_UNORM             : return 4;
+		case EPixelFormat::R16_UNORM                : return 2;
 		// FLOAT
 		case EPixelFormat::R32_FLOAT                : return 4;
 		case EPixelFormat::R32G32_FLOAT             : return 8;
@@ -81,11 +96,59 @@ inline uint32 getPixelFormatBytes(EPixelFormat format)
 		case EPixelFormat::R32G32B32A32_UINT        : return 16;
 		// SINT
 		case EPixelFormat::R16G16_SINT              : return 4;
+		// DEPTH_STENCIL
+		case EPixelFormat::D24_UNORM_S8_UINT        : return 4;
+		case EPixelFormat::D32_FLOAT_S8_UINT        : return 8;
 		default: CHECK_NO_ENTRY();
 	}
 	return 0;
 }
 
+inline bool isBlockCompressedFormat(EPixelFormat format)
+{
+	switch (format)
+	{
+		case EPixelFormat::BC1_UNORM:
+		case EPixelFormat::BC3_UNORM:
+		case EPixelFormat::BC4_UNORM:
+		case EPixelFormat::BC5_UNORM:
+		case EPixelFormat::BC7_UNORM:
+			return true;
+	}
+	return false;
+}
+
+// Bytes of a 4x4 block.
+inline uint32 getBlockCompressedBlockBytes(EPixelFormat format)
+{
+	switch (format)
+	{
+		case EPixelFormat::BC1_UNORM : return 8;
+		case EPixelFormat::BC3_UNORM : return 16;
+		case EPixelFormat::BC4_UNORM : return 8;
+		case EPixelFormat::BC5_UNORM : return 16;
+		case EPixelFormat::BC7_UNORM : return 16;
+		default: CHECK_NO_ENTRY();
+	}
+	return 0;
+}
+
+// Tight bytes of a row of texels, or of a row of blocks for block compressed formats.
+inline uint64 getPixelFormatRowBytes(EPixelFormat format, uint32 width)
+{
+	if (isBlockCompressedFormat(format))
+	{
+		return uint64((width + 3) / 4) * getBlockCompressedBlockBytes(format);
+	}
+	return uint64(width) * getPixelFormatBytes(format);
+}
+
+// Number of rows of texels, or of rows of blocks for block compressed formats.
+inline uint32 getPixelFormatNumRows(EPixelFormat format, uint32 height)
+{
+	return isBlockCompressedFormat(format) ? ((height + 3) / 4) : height;
+}
+
 inline bool isDepthStencilFormat(EPixelFormat format)
 {
 	switch (format)
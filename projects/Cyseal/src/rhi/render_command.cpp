@@ -4,9 +4,6 @@
 
 void RenderCommandList::executeDeferredDealloc()
 {
-	for (auto deallocFn : deferredDeallocs)
-	{
-		deallocFn();
-	}
-	deferredDeallocs.clear();
+	deferredDeallocs.retire(deferredDeallocFence);
+	deferredDeallocFence += 1;
 }
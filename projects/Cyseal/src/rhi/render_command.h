@@ -6,8 +6,7 @@
 #include "gpu_resource_binding.h"
 #include "gpu_resource_barrier.h"
 #include "barrier_tracker.h"
-
-#include <functional>
+#include "deferred_dealloc_queue.h"
 
 // Forward Declarations
 class VertexBuffer;
@@ -59,8 +58,6 @@ private:
 class RenderCommandList
 {
 public:
-	using CustomCommandType = std::function<void(RenderCommandList&)>;
-
 	virtual ~RenderCommandList() = default;
 
 	virtual void initialize(RenderDevice* renderDevice) = 0;
@@ -99,6 +96,21 @@ public:
 	// For now I only need copy between 2D textures of the same size.
 	virtual void copyTexture2D(Texture* src, Texture* dst) = 0;
 
+	// Copies a whole subresource to a subresource of the same size in another texture,
+	// e.g., a mip that is kept when a streamed texture is reallocated.
+	virtual void copyTextureSubresource(Texture* src, uint32 srcSubresourceIndex, Texture* dst, uint32 dstSubresourceIndex) = 0;
+
+	// Copies a whole subresource from rows in a buffer.
+	// srcOffset should be a multiple of 512 and srcRowPitch a multiple of 256. (See UploadBatchScheduler)
+	virtual void copyBufferToTexture(Buffer* src, uint64 srcOffset, uint64 srcRowPitch, Texture* dst, uint32 subresourceIndex) = 0;
+
+	// Pool buffers of VertexBufferPool and IndexBufferPool are not tracked by barrierAuto().
+	// Call beginPooledBufferCopies() before copyBufferToPooledBuffer() and endPooledBufferCopies() after,
+	// which transition the pools to copy dest and back to vertex/index buffer read.
+	virtual void beginPooledBufferCopies(uint32 numPools, GPUResource* const* pools) = 0;
+	virtual void copyBufferToPooledBuffer(Buffer* src, uint64 srcOffset, uint64 numBytes, GPUResource* dstPool, uint64 dstOffset) = 0;
+	virtual void endPooledBufferCopies(uint32 numPools, GPUResource* const* pools) = 0;
+
 	// ------------------------------------------------------------------------
 	// Pipeline state object (graphics & compute)
 
@@ -195,16 +207,16 @@ public:
 			CHECK_NO_ENTRY();
 		}
 
-		auto deallocFn = [addrToDelete]() {
-			delete (T*)addrToDelete;
-		};
-		deferredDeallocs.push_back(deallocFn);
+		deferredDeallocs.enqueue(addrToDelete, deferredDeallocFence);
 	}
+	// Deletes objects enqueued so far. Call after all GPU works for this command list are done.
 	void executeDeferredDealloc();
 
+	inline const DeferredDeallocQueue& getDeferredDeallocQueue() const { return deferredDeallocs; }
+
 private:
-	std::vector<CustomCommandType> customCommands;
-	std::vector<std::function<void()>> deferredDeallocs; // Free'd after all GPU works for this command list is done.
+	DeferredDeallocQueue deferredDeallocs;
+	uint64 deferredDeallocFence = 0; // Incremented by each executeDeferredDealloc().
 };
 
 struct ScopedDrawEvent
@@ -13,6 +13,7 @@
 
 class DenoiserDevice;
 class SwapChainImage;
+struct ImDrawData;
 
 enum class ERenderDeviceRawAPI
 {
@@ -97,7 +98,8 @@ public:
 
 	virtual void initializeDearImgui();
 	virtual void beginDearImguiNewFrame() = 0;
-	virtual void renderDearImgui(RenderCommandList* commandList, SwapChainImage* swapChainImage) = 0;
+	// @param drawData  Snapshot of ImGui::GetDrawData() for the frame. Nothing is drawn if nullptr.
+	virtual void renderDearImgui(RenderCommandList* commandList, SwapChainImage* swapChainImage, ImDrawData* drawData) = 0;
 	virtual void shutdownDearImgui();
 	inline DescriptorHeap* getDearImguiSRVHeap() const { return imguiSRVHeap; }
 
@@ -242,7 +244,7 @@ protected:
 	//   4. Submit commands allocated in alloc0 to the queue
 	//   5. Repeat 1~4, but allocators swapped.
 	// Therefore only one command list is needed in theory, but
-	// RenderCommandList also has some utils like customCommands and deferredDeallocs.
+	// RenderCommandList also has some utils like deferredDeallocs.
 	// So I'll just create command lists as many as allocators.
 	std::vector<RenderCommandAllocator*> commandAllocators;
 	std::vector<RenderCommandList*> commandLists;
@@ -4,6 +4,8 @@
 #include "util/enum_util.h"
 #include "core/smart_pointer.h"
 
+#include <algorithm>
+
 class RenderCommandList;
 
 enum class ETextureDimension : uint8
@@ -157,6 +159,21 @@ struct TextureCreateParams
 	}
 };
 
+// mipLevels of 0 means full mips.
+inline uint32 getTextureNumMipLevels(const TextureCreateParams& params)
+{
+	if (params.mipLevels != 0)
+	{
+		return params.mipLevels;
+	}
+	uint32 numMips = 1;
+	for (uint32 size = std::max(params.width, params.height); size > 1; size >>= 1)
+	{
+		numMips += 1;
+	}
+	return numMips;
+}
+
 class Texture : public TextureKind
 {
 public:
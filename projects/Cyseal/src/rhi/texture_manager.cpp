@@ -4,11 +4,18 @@
 #include "gpu_resource.h"
 #include "core/engine.h"
 #include "core/assertion.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
 #include "util/resource_finder.h"
+#include "util/logging.h"
+#include "loader/mip_generator.h"
 #include "loader/image_loader.h"
+#include "loader/texture_cache.h"
 
 #include <vector>
 
+DEFINE_LOG_CATEGORY_STATIC(LogTextureManager);
+
 #define MAX_SRV_DESCRIPTORS 1024
 #define MAX_RTV_DESCRIPTORS 64
 #define MAX_DSV_DESCRIPTORS 64
@@ -121,27 +128,6 @@ void TextureManager::createSystemTextures()
 
 void TextureManager::createBlueNoiseTextures()
 {
-	ImageLoader loader;
-	std::vector<ImageLoadData*> blobs(STBN_SLICES, nullptr);
-	for (size_t ix = 0; ix < STBN_SLICES; ++ix)
-	{
-		std::wstring filepath = STBN_FILEPATH(ix);
-		filepath = ResourceFinder::get().find(filepath);
-		
-		blobs[ix] = loader.load(filepath);
-	}
-
-	const uint64 rowPitch = blobs[0]->getRowPitch();
-	const uint64 slicePitch = blobs[0]->getSlicePitch();
-
-	uint8* totalBlob = new uint8[slicePitch * STBN_SLICES];
-	for (size_t ix = 0; ix < STBN_SLICES; ++ix)
-	{
-		memcpy_s(totalBlob + ix * slicePitch, slicePitch, blobs[ix]->buffer, slicePitch);
-		delete blobs[ix];
-	}
-	blobs.clear();
-
 	TextureCreateParams params = TextureCreateParams::texture3D(
 		EPixelFormat::R8G8B8A8_UNORM,
 		ETextureAccessFlags::SRV | ETextureAccessFlags::CPU_WRITE,
@@ -152,11 +138,59 @@ void TextureManager::createBlueNoiseTextures()
 	blueNoise_vec3cosine = makeShared<TextureAsset>();
 	blueNoise_vec3cosine->setGPUResource(SharedPtr<Texture>(tex));
 
+	HighFrequencyCounter counter;
+	counter.start();
+
+	std::vector<std::wstring> filepaths(STBN_SLICES);
+	for (size_t ix = 0; ix < STBN_SLICES; ++ix)
+	{
+		filepaths[ix] = ResourceFinder::get().find(STBN_FILEPATH(ix));
+	}
+#if ENABLE_TEXTURE_CACHE
+	// All slices are cached as one volume, which is uploaded directly from its mapping.
+	const TextureCache textureCache(TEXTURE_CACHE_DIR);
+	const uint32 cacheSettings[] = { (uint32)EPixelFormat::R8G8B8A8_UNORM, STBN_WIDTH, STBN_HEIGHT, STBN_SLICES };
+	const TextureCacheKey cacheKey{ .sourcePaths = filepaths, .settingsHash = hashTextureCacheBytes(cacheSettings, sizeof(cacheSettings)) };
+	if (TextureCacheEntry* cacheEntry = textureCache.find(cacheKey))
+	{
+		CHECK(cacheEntry->format == EPixelFormat::R8G8B8A8_UNORM && cacheEntry->depth == STBN_SLICES);
+		CHECK(cacheEntry->levels[0].width == STBN_WIDTH && cacheEntry->levels[0].height == STBN_HEIGHT);
+		ENQUEUE_RENDER_COMMAND(UploadSTBN)(
+			[cacheEntry, tex](RenderCommandList& commandList)
+			{
+				const MipChain::Level& level = cacheEntry->levels[0];
+				tex->uploadData(&commandList, cacheEntry->getLevelData(0), level.rowPitch, level.slicePitch, 0);
+				commandList.enqueueDeferredDealloc(cacheEntry);
+			}
+		);
+		CYLOG(LogTextureManager, Log, L"Loaded STBN from the texture cache in %.3f ms", counter.stopWithMilliseconds());
+		return;
+	}
+#endif
+
+	MipChain* volume = nullptr;
+	{
+		ThreadPool threadPool(ThreadPool::getDefaultNumWorkers());
+		volume = decodeVolumeSlices(filepaths, &threadPool);
+	}
+	CHECK(volume != nullptr);
+	CHECK(volume->levels[0].width == STBN_WIDTH && volume->levels[0].height == STBN_HEIGHT);
+	CYLOG(LogTextureManager, Log, L"Decoded %u STBN slices in %.3f ms", STBN_SLICES, counter.stopWithMilliseconds());
+
+#if ENABLE_TEXTURE_CACHE
+	if (!textureCache.store(cacheKey, *volume, STBN_SLICES))
+	{
+		CYLOG(LogTextureManager, Warning, L"Failed to write STBN to the texture cache: %s", textureCache.getCacheFilePath(cacheKey).c_str());
+	}
+#endif
+
+	const uint64 rowPitch = volume->levels[0].rowPitch;
+	const uint64 slicePitch = volume->levels[0].slicePitch;
 	ENQUEUE_RENDER_COMMAND(UploadSTBN)(
-		[totalBlob, rowPitch, slicePitch, tex](RenderCommandList& commandList)
+		[volume, rowPitch, slicePitch, tex](RenderCommandList& commandList)
 		{
-			tex->uploadData(&commandList, totalBlob, rowPitch, slicePitch, 0);
-			commandList.enqueueDeferredDealloc(totalBlob);
+			tex->uploadData(&commandList, volume->data.data(), rowPitch, slicePitch, 0);
+			commandList.enqueueDeferredDealloc(volume);
 		}
 	);
 }
@@ -0,0 +1,375 @@
+#include "upload_batch_scheduler.h"
+#include "core/assertion.h"
+
+#include <algorithm>
+#include <cstring>
+
+static uint64 alignUp(uint64 value, uint64 alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static bool isBufferDestination(EUploadDestination type)
+{
+	return type == EUploadDestination::Buffer || type == EUploadDestination::PooledBuffer;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UploadRequest
+
+UploadRequest UploadRequest::buffer(GPUResource* destination, uint64 destinationOffset, const void* data, uint64 size, SharedPtr<void> dataOwner, SharedPtr<GPUResource> destinationOwner)
+{
+	UploadRequest request;
+	request.destinationType = EUploadDestination::Buffer;
+	request.destination = destination;
+	request.destinationOffset = destinationOffset;
+	request.data = static_cast<const uint8*>(data);
+	request.rowBytes = size;
+	request.numRows = 1;
+	request.srcRowPitch = size;
+	request.dataOwner = std::move(dataOwner);
+	request.destinationOwner = std::move(destinationOwner);
+	return request;
+}
+
+UploadRequest UploadRequest::pooledBuffer(GPUResource* destination, uint64 destinationOffset, const void* data, uint64 size, SharedPtr<void> dataOwner)
+{
+	// Pools outlive all uploads, so no destination owner.
+	UploadRequest request = UploadRequest::buffer(destination, destinationOffset, data, size, std::move(dataOwner), nullptr);
+	request.destinationType = EUploadDestination::PooledBuffer;
+	return request;
+}
+
+UploadRequest UploadRequest::texture(GPUResource* destination, uint32 subresourceIndex, const void* data, uint64 rowBytes, uint32 numRows, uint64 srcRowPitch, SharedPtr<void> dataOwner, SharedPtr<GPUResource> destinationOwner)
+{
+	CHECK(srcRowPitch >= rowBytes);
+	UploadRequest request;
+	request.destinationType = EUploadDestination::Texture;
+	request.destination = destination;
+	request.subresourceIndex = subresourceIndex;
+	request.data = static_cast<const uint8*>(data);
+	request.rowBytes = rowBytes;
+	request.numRows = numRows;
+	request.srcRowPitch = srcRowPitch;
+	request.dataOwner = std::move(dataOwner);
+	request.destinationOwner = std::move(destinationOwner);
+	return request;
+}
+
+uint64 UploadRequest::getStagingRowPitch() const
+{
+	return (destinationType == EUploadDestination::Texture) ? alignUp(rowBytes, UPLOAD_TEXTURE_ROW_PITCH_ALIGNMENT) : rowBytes;
+}
+
+uint64 UploadRequest::getStagingSize() const
+{
+	// Padding after the last row is not needed.
+	return getStagingRowPitch() * (numRows - 1) + rowBytes;
+}
+
+uint64 UploadRequest::getStagingAlignment() const
+{
+	return (destinationType == EUploadDestination::Texture) ? UPLOAD_TEXTURE_PLACEMENT_ALIGNMENT : UPLOAD_BUFFER_ALIGNMENT;
+}
+
+void UploadBatch::clear()
+{
+	copies.clear();
+	buffers.clear();
+	textureSubresources.clear();
+	pooledBuffers.clear();
+	numBytes = 0;
+	numUploads = 0;
+	lastToken = UPLOAD_TOKEN_NONE;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UploadBatchScheduler
+
+UploadBatchScheduler::~UploadBatchScheduler()
+{
+	destroy();
+}
+
+void UploadBatchScheduler::initialize(const UploadBatchSchedulerDesc& inDesc, UploadStagingMemory* inMemory)
+{
+	CHECK(inMemory != nullptr && inDesc.pageSize > 0 && inDesc.maxPages > 0);
+	desc = inDesc;
+	memory = inMemory;
+}
+
+void UploadBatchScheduler::destroy()
+{
+	for (uint32 i = 0; i < (uint32)pages.size(); ++i)
+	{
+		if (pages[i].cpuPtr != nullptr)
+		{
+			destroyPage(i);
+		}
+	}
+	pages.clear();
+	freePageIndices.clear();
+	freePages.clear();
+	framePages.clear();
+	frameDestinations.clear();
+	pendingFrames.clear();
+	pendingRequests.clear();
+	pendingBytes = 0;
+}
+
+UploadToken UploadBatchScheduler::enqueue(UploadRequest&& request)
+{
+	CHECK(request.destination != nullptr && request.data != nullptr && request.rowBytes > 0 && request.numRows > 0);
+	CHECK(request.destinationOwner == nullptr || request.destinationOwner.get() == request.destination);
+	pendingBytes += request.getStagingSize();
+	pendingRequests.push_back(std::move(request));
+	return ++lastToken;
+}
+
+void UploadBatchScheduler::buildBatch(UploadBatch& outBatch)
+{
+	outBatch.clear();
+
+	uint64 frameBytes = 0;
+	for (uint32 page : framePages)
+	{
+		frameBytes += pages[page].usedBytes;
+	}
+
+	while (!pendingRequests.empty())
+	{
+		UploadRequest& request = pendingRequests.front();
+		const uint64 stagingSize = request.getStagingSize();
+		if (frameBytes > 0 && frameBytes + stagingSize > desc.frameBudget)
+		{
+			break;
+		}
+		uint32 page;
+		uint64 pageOffset;
+		if (!placeInPage(stagingSize, request.getStagingAlignment(), page, pageOffset))
+		{
+			break;
+		}
+
+		const uint64 rowPitch = request.getStagingRowPitch();
+		uint8* dst = pages[page].cpuPtr + pageOffset;
+		if (rowPitch == request.srcRowPitch || request.numRows == 1)
+		{
+			::memcpy(dst, request.data, (size_t)stagingSize);
+		}
+		else
+		{
+			for (uint32 row = 0; row < request.numRows; ++row)
+			{
+				::memcpy(dst + row * rowPitch, request.data + row * request.srcRowPitch, (size_t)request.rowBytes);
+			}
+		}
+
+		outBatch.copies.push_back(UploadCopy{
+			.page              = page,
+			.pageOffset        = pageOffset,
+			.size              = stagingSize,
+			.rowPitch          = rowPitch,
+			.destinationType   = request.destinationType,
+			.destination       = request.destination,
+			.destinationOffset = request.destinationOffset,
+			.subresourceIndex  = request.subresourceIndex,
+		});
+		outBatch.numBytes += request.rowBytes * request.numRows;
+		outBatch.numUploads += 1;
+		frameBytes += stagingSize;
+		if (request.destinationOwner != nullptr)
+		{
+			frameDestinations.push_back(std::move(request.destinationOwner));
+		}
+
+		pendingBytes -= stagingSize;
+		pendingRequests.pop_front();
+		scheduledToken += 1;
+	}
+	outBatch.lastToken = scheduledToken;
+	if (outBatch.copies.empty())
+	{
+		return;
+	}
+
+	// Group by destination. Stable, so uploads to the same subresource keep their order.
+	std::vector<UploadCopy>& copies = outBatch.copies;
+	std::stable_sort(copies.begin(), copies.end(), [](const UploadCopy& a, const UploadCopy& b)
+		{
+			if (a.destinationType != b.destinationType) return a.destinationType < b.destinationType;
+			if (a.destination != b.destination) return a.destination < b.destination;
+			if (isBufferDestination(a.destinationType)) return a.destinationOffset < b.destinationOffset;
+			return a.subresourceIndex < b.subresourceIndex;
+		});
+
+	// Merge buffer copies that are adjacent in both the page and the destination,
+	// e.g., data of meshes suballocated one after another in a buffer.
+	size_t numMerged = 0;
+	for (size_t i = 0; i < copies.size(); ++i)
+	{
+		const UploadCopy& copy = copies[i];
+		if (numMerged > 0)
+		{
+			UploadCopy& prev = copies[numMerged - 1];
+			const bool bAdjacent = isBufferDestination(copy.destinationType)
+				&& prev.destinationType == copy.destinationType
+				&& prev.destination == copy.destination
+				&& prev.page == copy.page
+				&& prev.pageOffset + prev.size == copy.pageOffset
+				&& prev.destinationOffset + prev.size == copy.destinationOffset;
+			if (bAdjacent)
+			{
+				prev.size += copy.size;
+				continue;
+			}
+		}
+		copies[numMerged++] = copy;
+	}
+	copies.resize(numMerged);
+
+	for (const UploadCopy& copy : copies)
+	{
+		if (copy.destinationType == EUploadDestination::Buffer)
+		{
+			if (outBatch.buffers.empty() || outBatch.buffers.back() != copy.destination)
+			{
+				outBatch.buffers.push_back(copy.destination);
+			}
+		}
+		else if (copy.destinationType == EUploadDestination::PooledBuffer)
+		{
+			if (outBatch.pooledBuffers.empty() || outBatch.pooledBuffers.back() != copy.destination)
+			{
+				outBatch.pooledBuffers.push_back(copy.destination);
+			}
+		}
+		else
+		{
+			const UploadTextureSubresource* last = outBatch.textureSubresources.empty() ? nullptr : &outBatch.textureSubresources.back();
+			if (last == nullptr || last->texture != copy.destination || last->subresourceIndex != copy.subresourceIndex)
+			{
+				outBatch.textureSubresources.push_back(UploadTextureSubresource{ copy.destination, copy.subresourceIndex });
+			}
+		}
+	}
+}
+
+void UploadBatchScheduler::endFrame(uint64 fenceValue)
+{
+	CHECK(pendingFrames.empty() || pendingFrames.back().fenceValue <= fenceValue);
+	if (framePages.empty())
+	{
+		// Nothing was copied in this frame, so scheduled uploads complete with the previous frame.
+		if (pendingFrames.empty())
+		{
+			completedToken.store(scheduledToken, std::memory_order_release);
+		}
+		return;
+	}
+	pendingFrames.push_back(PendingFrame{ fenceValue, scheduledToken, std::move(framePages), std::move(frameDestinations) });
+	framePages.clear();
+	frameDestinations.clear();
+}
+
+void UploadBatchScheduler::retire(uint64 completedFenceValue)
+{
+	while (!pendingFrames.empty() && pendingFrames.front().fenceValue <= completedFenceValue)
+	{
+		PendingFrame& frame = pendingFrames.front();
+		for (uint32 pageIndex : frame.pages)
+		{
+			Page& page = pages[pageIndex];
+			if (page.bDedicated)
+			{
+				destroyPage(pageIndex);
+			}
+			else
+			{
+				page.usedBytes = 0;
+				freePages.push_back(pageIndex);
+			}
+		}
+		completedToken.store(frame.lastToken, std::memory_order_release);
+		pendingFrames.pop_front();
+	}
+}
+
+bool UploadBatchScheduler::placeInPage(uint64 size, uint64 alignment, uint32& outPage, uint64& outOffset)
+{
+	if (size > desc.pageSize)
+	{
+		outPage = createPage(size, true);
+		outOffset = 0;
+		pages[outPage].usedBytes = size;
+		framePages.push_back(outPage);
+		return true;
+	}
+
+	// Only the last page of this frame is filled. Earlier pages are full enough.
+	if (!framePages.empty() && !pages[framePages.back()].bDedicated)
+	{
+		Page& page = pages[framePages.back()];
+		const uint64 offset = alignUp(page.usedBytes, alignment);
+		if (offset + size <= page.size)
+		{
+			page.usedBytes = offset + size;
+			outPage = framePages.back();
+			outOffset = offset;
+			return true;
+		}
+	}
+
+	if (!freePages.empty())
+	{
+		outPage = freePages.back();
+		freePages.pop_back();
+	}
+	else if (numPages - numDedicatedPages < desc.maxPages)
+	{
+		outPage = createPage(desc.pageSize, false);
+	}
+	else
+	{
+		return false;
+	}
+	pages[outPage].usedBytes = size;
+	outOffset = 0;
+	framePages.push_back(outPage);
+	return true;
+}
+
+uint32 UploadBatchScheduler::createPage(uint64 size, bool bDedicated)
+{
+	uint32 pageIndex;
+	if (!freePageIndices.empty())
+	{
+		pageIndex = freePageIndices.back();
+		freePageIndices.pop_back();
+	}
+	else
+	{
+		pageIndex = (uint32)pages.size();
+		pages.emplace_back();
+	}
+	Page& page = pages[pageIndex];
+	page.cpuPtr = memory->createPage(pageIndex, size);
+	page.size = size;
+	page.usedBytes = 0;
+	page.bDedicated = bDedicated;
+	CHECK(page.cpuPtr != nullptr);
+
+	numPages += 1;
+	numDedicatedPages += bDedicated ? 1 : 0;
+	return pageIndex;
+}
+
+void UploadBatchScheduler::destroyPage(uint32 pageIndex)
+{
+	Page& page = pages[pageIndex];
+	memory->destroyPage(pageIndex);
+	numPages -= 1;
+	numDedicatedPages -= page.bDedicated ? 1 : 0;
+	page = Page{};
+	freePageIndices.push_back(pageIndex);
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "core/int_types.h"
+#include "core/smart_pointer.h"
+
+#include <vector>
+#include <deque>
+#include <atomic>
+
+class GPUResource;
+
+// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+#define UPLOAD_TEXTURE_ROW_PITCH_ALIGNMENT 256
+// D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+#define UPLOAD_TEXTURE_PLACEMENT_ALIGNMENT 512
+// Same as UPLOAD_RING_DEFAULT_ALIGNMENT.
+#define UPLOAD_BUFFER_ALIGNMENT            16
+
+// Identifies an upload. Tokens increase in enqueue order and uploads complete in that order,
+// so an asset made of several uploads only needs to check the last token.
+using UploadToken = uint64;
+// Token that is always complete, e.g., for assets that did not need an upload.
+#define UPLOAD_TOKEN_NONE 0
+
+enum class EUploadDestination : uint8
+{
+	Buffer,
+	Texture,
+	PooledBuffer, // Pool buffer of VertexBufferPool or IndexBufferPool
+};
+
+struct UploadRequest
+{
+	static UploadRequest buffer(
+		GPUResource* destination,
+		uint64 destinationOffset,
+		const void* data,
+		uint64 size,
+		SharedPtr<void> dataOwner = nullptr,
+		SharedPtr<GPUResource> destinationOwner = nullptr);
+
+	// @param destination  Pool buffer, e.g., gVertexBufferPool->internal_getPoolBuffer().
+	// @param destinationOffset Offset of a suballocation in the pool.
+	static UploadRequest pooledBuffer(
+		GPUResource* destination,
+		uint64 destinationOffset,
+		const void* data,
+		uint64 size,
+		SharedPtr<void> dataOwner = nullptr);
+
+	// @param rowBytes     Bytes of a row of texels (or blocks for block compressed formats).
+	// @param numRows      Rows of texels (or blocks) in the subresource.
+	// @param srcRowPitch  Bytes between rows in data.
+	static UploadRequest texture(
+		GPUResource* destination,
+		uint32 subresourceIndex,
+		const void* data,
+		uint64 rowBytes,
+		uint32 numRows,
+		uint64 srcRowPitch,
+		SharedPtr<void> dataOwner = nullptr,
+		SharedPtr<GPUResource> destinationOwner = nullptr);
+
+	// Bytes in a staging page, excluding alignment of the placement.
+	uint64 getStagingSize() const;
+	uint64 getStagingRowPitch() const;
+	uint64 getStagingAlignment() const;
+
+	EUploadDestination destinationType   = EUploadDestination::Buffer;
+	GPUResource*       destination       = nullptr; // Should be alive until the upload completes if destinationOwner is null.
+	uint64             destinationOffset = 0;       // Buffer and pooled buffer only.
+	uint32             subresourceIndex  = 0;       // Texture only.
+	const uint8*       data              = nullptr;
+	uint64             rowBytes          = 0;       // Whole size for buffers.
+	uint32             numRows           = 1;
+	uint64             srcRowPitch       = 0;
+	SharedPtr<void>    dataOwner;                   // Keeps data alive. Released once data is copied to a staging page.
+	// Keeps destination alive, so it can be released while its upload is pending, e.g., on a world switch.
+	// Released once the copy completes.
+	SharedPtr<GPUResource> destinationOwner;
+};
+
+// Copy from a staging page to a destination.
+// Buffer copies of adjacent regions are merged when their staging memory is also adjacent.
+struct UploadCopy
+{
+	uint32             page;
+	uint64             pageOffset;
+	uint64             size;              // Bytes in the page.
+	uint64             rowPitch;          // Texture only. Row pitch in the page.
+	EUploadDestination destinationType;
+	GPUResource*       destination;
+	uint64             destinationOffset; // Buffer and pooled buffer only.
+	uint32             subresourceIndex;  // Texture only.
+};
+
+struct UploadTextureSubresource
+{
+	GPUResource* texture;
+	uint32       subresourceIndex;
+};
+
+struct UploadBatch
+{
+	std::vector<UploadCopy>               copies;              // Sorted by destination.
+	// Unique destinations of copies, for one batch of barriers before all copies.
+	std::vector<GPUResource*>             buffers;
+	std::vector<UploadTextureSubresource> textureSubresources;
+	std::vector<GPUResource*>             pooledBuffers;
+	uint64                                numBytes   = 0;      // Data bytes, excluding row pitch and placement padding.
+	uint32                                numUploads = 0;      // Requests in this batch. Can be more than copies.
+	UploadToken                           lastToken  = UPLOAD_TOKEN_NONE; // Complete when this batch completes.
+
+	void clear();
+};
+
+// Memory of staging pages, e.g., buffers in the upload heap.
+class UploadStagingMemory
+{
+public:
+	virtual ~UploadStagingMemory() = default;
+	// @return Persistently mapped memory of the page.
+	virtual uint8* createPage(uint32 pageIndex, uint64 size) = 0;
+	// GPU works that read the page are done.
+	virtual void destroyPage(uint32 pageIndex) = 0;
+};
+
+struct UploadBatchSchedulerDesc
+{
+	uint64 pageSize    = 16ull * 1024 * 1024;
+	uint32 maxPages    = 8;                   // Uploads larger than a page get a dedicated page that does not count.
+	uint64 frameBudget = 32ull * 1024 * 1024; // Staging bytes per frame. At least one upload is scheduled per frame regardless.
+};
+
+// Packs many small uploads into large staging pages and schedules them over frames.
+// Instead of a staging allocation and a command per upload, each frame records one batch:
+// all barriers at once, then copies grouped by destination.
+//
+// Uploads are scheduled in enqueue order under a per-frame byte budget, so loading a big scene
+// does not stall a frame. If all pages are in flight, the rest waits for the next frame instead of blocking.
+// Pages of a frame are reused once the fence value given to endFrame() is completed.
+//
+// Like UploadRingAllocator, this class only does bookkeeping. Backing memory is given by UploadStagingMemory
+// and UploadBatcher records the commands. All functions except isComplete() should be called from one thread.
+// A region of a destination should not be uploaded again before its previous upload completes.
+class UploadBatchScheduler
+{
+public:
+	~UploadBatchScheduler();
+
+	void initialize(const UploadBatchSchedulerDesc& inDesc, UploadStagingMemory* inMemory);
+	// Destroys all pages. GPU works reading them should be done.
+	void destroy();
+
+	// Data is read when the upload is scheduled, which might be a later frame.
+	UploadToken enqueue(UploadRequest&& request);
+
+	// Copies pending uploads to staging pages and groups them into copies.
+	void buildBatch(UploadBatch& outBatch);
+
+	// Closes batches built since the last endFrame().
+	// @param fenceValue Fence value that signals GPU completion of their copies.
+	void endFrame(uint64 fenceValue);
+
+	// Reuses pages and completes tokens of frames whose fence values are completed.
+	void retire(uint64 completedFenceValue);
+
+	// Safe to call from any thread.
+	inline bool isComplete(UploadToken token) const { return token <= completedToken.load(std::memory_order_acquire); }
+	inline UploadToken getCompletedToken() const { return completedToken.load(std::memory_order_acquire); }
+	inline UploadToken getLastToken() const { return lastToken; }
+
+	inline size_t getNumPendingUploads() const { return pendingRequests.size(); }
+	inline uint64 getPendingBytes() const { return pendingBytes; }
+	inline uint32 getNumPages() const { return numPages; }
+	inline uint32 getNumDedicatedPages() const { return numDedicatedPages; }
+	inline const UploadBatchSchedulerDesc& getDesc() const { return desc; }
+
+private:
+	struct Page
+	{
+		uint8* cpuPtr     = nullptr;
+		uint64 size       = 0;
+		uint64 usedBytes  = 0;
+		bool   bDedicated = false;
+	};
+	struct PendingFrame
+	{
+		uint64                              fenceValue;
+		UploadToken                         lastToken;
+		std::vector<uint32>                 pages;
+		std::vector<SharedPtr<GPUResource>> destinations;
+	};
+
+	// @return Page index and offset, or false if no page can be used in this frame.
+	bool placeInPage(uint64 size, uint64 alignment, uint32& outPage, uint64& outOffset);
+	uint32 createPage(uint64 size, bool bDedicated);
+	void destroyPage(uint32 pageIndex);
+
+	UploadBatchSchedulerDesc  desc;
+	UploadStagingMemory*      memory = nullptr;
+
+	std::deque<UploadRequest> pendingRequests;
+	uint64                    pendingBytes = 0;
+	UploadToken               lastToken = UPLOAD_TOKEN_NONE;     // Enqueued
+	UploadToken               scheduledToken = UPLOAD_TOKEN_NONE; // Copied to pages
+	std::atomic<UploadToken>  completedToken = UPLOAD_TOKEN_NONE;
+
+	std::vector<Page>         pages;          // index = page index. Destroyed pages have no memory.
+	std::vector<uint32>       freePageIndices; // Slots in pages to reuse.
+	std::vector<uint32>       freePages;      // Pages that can take uploads.
+	std::vector<uint32>       framePages;     // Pages used since the last endFrame(). The last one is being filled.
+	std::vector<SharedPtr<GPUResource>> frameDestinations; // Owners of destinations copied since the last endFrame().
+	std::deque<PendingFrame>  pendingFrames;
+	uint32                    numPages = 0;
+	uint32                    numDedicatedPages = 0;
+};
@@ -0,0 +1,174 @@
+#include "upload_batcher.h"
+#include "render_device.h"
+#include "render_command.h"
+#include "buffer.h"
+#include "vertex_buffer_pool.h"
+#include "texture.h"
+#include "pixel_format.h"
+#include "core/assertion.h"
+
+#include <algorithm>
+
+UploadBatcher* gUploadBatcher = nullptr;
+
+UploadBatcher::~UploadBatcher()
+{
+	destroy();
+}
+
+void UploadBatcher::initialize(RenderDevice* inDevice, const UploadBatchSchedulerDesc& desc)
+{
+	device = inDevice;
+	scheduler.initialize(desc, this);
+}
+
+void UploadBatcher::destroy()
+{
+	scheduler.destroy();
+	pageBuffers.clear();
+}
+
+UploadToken UploadBatcher::uploadBuffer(SharedPtr<Buffer> destBuffer, uint64 destOffsetInBytes, const void* data, uint64 sizeInBytes, SharedPtr<void> dataOwner)
+{
+	CHECK(ENUM_HAS_FLAG(destBuffer->getCreateParams().accessFlags, EBufferAccessFlags::COPY_DST));
+	CHECK(destOffsetInBytes + sizeInBytes <= destBuffer->getCreateParams().sizeInBytes);
+
+	Buffer* destination = destBuffer.get();
+	return scheduler.enqueue(UploadRequest::buffer(destination, destOffsetInBytes, data, sizeInBytes, std::move(dataOwner), std::move(destBuffer)));
+}
+
+UploadToken UploadBatcher::uploadTexture(SharedPtr<Texture> destTexture, uint32 subresourceIndex, const void* data, uint64 rowPitch, SharedPtr<void> dataOwner)
+{
+	const TextureCreateParams& params = destTexture->getCreateParams();
+	const uint32 mipLevel = subresourceIndex % getTextureNumMipLevels(params);
+	const uint32 mipWidth = std::max(1u, params.width >> mipLevel);
+	const uint32 mipHeight = std::max(1u, params.height >> mipLevel);
+
+	Texture* destination = destTexture.get();
+	return scheduler.enqueue(UploadRequest::texture(
+		destination, subresourceIndex, data,
+		getPixelFormatRowBytes(params.format, mipWidth),
+		getPixelFormatNumRows(params.format, mipHeight),
+		rowPitch, std::move(dataOwner), std::move(destTexture)));
+}
+
+UploadToken UploadBatcher::uploadVertexBuffer(VertexBuffer* destBuffer, const void* data, uint32 strideInBytes, SharedPtr<void> dataOwner)
+{
+	VertexBufferPool* pool = destBuffer->internal_getParentPool();
+	CHECK(pool != nullptr);
+
+	destBuffer->setStrideInBytes(strideInBytes);
+	return scheduler.enqueue(UploadRequest::pooledBuffer(
+		pool->internal_getPoolBuffer(), destBuffer->getBufferOffsetInBytes(),
+		data, destBuffer->getBufferSizeInBytes(), std::move(dataOwner)));
+}
+
+UploadToken UploadBatcher::uploadIndexBuffer(IndexBuffer* destBuffer, const void* data, EPixelFormat format, SharedPtr<void> dataOwner)
+{
+	IndexBufferPool* pool = destBuffer->internal_getParentPool();
+	CHECK(pool != nullptr);
+
+	destBuffer->setIndexFormat(format);
+	return scheduler.enqueue(UploadRequest::pooledBuffer(
+		pool->internal_getPoolBuffer(), destBuffer->getBufferOffsetInBytes(),
+		data, destBuffer->getBufferSizeInBytes(), std::move(dataOwner)));
+}
+
+void UploadBatcher::flush(RenderCommandList* commandList)
+{
+	scheduler.buildBatch(batch);
+	if (batch.copies.empty())
+	{
+		return;
+	}
+
+	SCOPED_DRAW_EVENT(commandList, UploadBatch);
+
+	bufferBarriers.clear();
+	textureBarriers.clear();
+	for (GPUResource* buffer : batch.buffers)
+	{
+		bufferBarriers.push_back(BufferBarrierAuto{
+			EBarrierSync::COPY, EBarrierAccess::COPY_DEST, static_cast<Buffer*>(buffer)
+		});
+	}
+	for (const UploadTextureSubresource& subresource : batch.textureSubresources)
+	{
+		textureBarriers.push_back(TextureBarrierAuto{
+			EBarrierSync::COPY, EBarrierAccess::COPY_DEST, EBarrierLayout::CopyDest,
+			static_cast<Texture*>(subresource.texture),
+			BarrierSubresourceRange{ subresource.subresourceIndex, 0, 0, 0, 0, 0 }, ETextureBarrierFlags::None
+		});
+	}
+	commandList->barrierAuto(
+		(uint32)bufferBarriers.size(), bufferBarriers.data(),
+		(uint32)textureBarriers.size(), textureBarriers.data(),
+		0, nullptr);
+
+	const uint32 numPooledBuffers = (uint32)batch.pooledBuffers.size();
+	if (numPooledBuffers > 0)
+	{
+		commandList->beginPooledBufferCopies(numPooledBuffers, batch.pooledBuffers.data());
+	}
+
+	for (const UploadCopy& copy : batch.copies)
+	{
+		Buffer* pageBuffer = pageBuffers[copy.page].get();
+		if (copy.destinationType == EUploadDestination::Buffer)
+		{
+			commandList->copyBufferRegion(pageBuffer, copy.pageOffset, copy.size,
+				static_cast<Buffer*>(copy.destination), copy.destinationOffset);
+		}
+		else if (copy.destinationType == EUploadDestination::PooledBuffer)
+		{
+			commandList->copyBufferToPooledBuffer(pageBuffer, copy.pageOffset, copy.size,
+				copy.destination, copy.destinationOffset);
+		}
+		else
+		{
+			commandList->copyBufferToTexture(pageBuffer, copy.pageOffset, copy.rowPitch,
+				static_cast<Texture*>(copy.destination), copy.subresourceIndex);
+		}
+	}
+
+	// Pools are read by draws and GPU scene, so they go back to their read state right away.
+	if (numPooledBuffers > 0)
+	{
+		commandList->endPooledBufferCopies(numPooledBuffers, batch.pooledBuffers.data());
+	}
+}
+
+void UploadBatcher::endFrame(uint64 fenceValue)
+{
+	scheduler.endFrame(fenceValue);
+}
+
+void UploadBatcher::retire(uint64 completedFenceValue)
+{
+	scheduler.retire(completedFenceValue);
+}
+
+uint8* UploadBatcher::createPage(uint32 pageIndex, uint64 size)
+{
+	if (pageIndex >= pageBuffers.size())
+	{
+		pageBuffers.resize(pageIndex + 1);
+	}
+	CHECK(pageBuffers[pageIndex] == nullptr);
+
+	pageBuffers[pageIndex] = UniquePtr<Buffer>(device->createBuffer(
+		BufferCreateParams{
+			.sizeInBytes = size,
+			.alignment   = 0,
+			.accessFlags = EBufferAccessFlags::UPLOAD_HEAP,
+		}
+	));
+	pageBuffers[pageIndex]->setDebugName(L"Buffer_UploadBatchPage");
+
+	return pageBuffers[pageIndex]->getMappedPointer();
+}
+
+void UploadBatcher::destroyPage(uint32 pageIndex)
+{
+	pageBuffers[pageIndex].reset();
+}
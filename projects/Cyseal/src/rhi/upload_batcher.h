@@ -0,0 +1,77 @@
+#pragma once
+
+#include "upload_batch_scheduler.h"
+#include "barrier_tracker.h"
+#include "pixel_format.h"
+#include "core/smart_pointer.h"
+
+#include <vector>
+
+class RenderDevice;
+class RenderCommandList;
+class Buffer;
+class Texture;
+class VertexBuffer;
+class IndexBuffer;
+
+// Batched staging uploads for assets, e.g., texture mips of a loaded scene.
+// Uploads are recorded by flush() in the renderer's frame, so they can be enqueued
+// from render commands without a staging buffer or barrier per upload.
+// See UploadBatchScheduler for how uploads are packed and scheduled.
+//
+// Use UploadRing instead for per-frame data that should be copied in the same frame.
+class UploadBatcher : public UploadStagingMemory
+{
+public:
+	~UploadBatcher();
+
+	void initialize(RenderDevice* inDevice, const UploadBatchSchedulerDesc& desc = UploadBatchSchedulerDesc{});
+	// GPU works should be flushed before.
+	void destroy();
+
+	// destBuffer should have COPY_DST flag.
+	// Destinations are kept alive until their uploads complete, so callers may release them anytime.
+	// @param dataOwner Keeps data alive until it's copied to a staging page. Data should outlive the call if null.
+	UploadToken uploadBuffer(SharedPtr<Buffer> destBuffer, uint64 destOffsetInBytes, const void* data, uint64 sizeInBytes, SharedPtr<void> dataOwner = nullptr);
+
+	// Uploads a whole subresource. Unlike Texture::uploadData(), the texture does not need CPU_WRITE flag.
+	// @param rowPitch Bytes between rows (or rows of blocks) in data.
+	UploadToken uploadTexture(SharedPtr<Texture> destTexture, uint32 subresourceIndex, const void* data, uint64 rowPitch, SharedPtr<void> dataOwner = nullptr);
+
+	// Uploads a whole suballocation of gVertexBufferPool into the pool buffer at getBufferOffsetInBytes(),
+	// then sets the stride. Unlike VertexBuffer::updateData(), no staging buffer is created per buffer.
+	// The pool should outlive the upload, but the suballocation may be released anytime.
+	UploadToken uploadVertexBuffer(VertexBuffer* destBuffer, const void* data, uint32 strideInBytes, SharedPtr<void> dataOwner = nullptr);
+
+	// Same as uploadVertexBuffer(), for a suballocation of gIndexBufferPool.
+	UploadToken uploadIndexBuffer(IndexBuffer* destBuffer, const void* data, EPixelFormat format, SharedPtr<void> dataOwner = nullptr);
+
+	// Records copies of uploads scheduled for this frame.
+	// Destinations are left in COPY_DEST state, same as Texture::uploadData(), except pool buffers.
+	void flush(RenderCommandList* commandList);
+
+	// @param fenceValue Fence value that signals GPU completion of this frame.
+	void endFrame(uint64 fenceValue);
+	void retire(uint64 completedFenceValue);
+
+	// Safe to call from any thread.
+	inline bool isComplete(UploadToken token) const { return scheduler.isComplete(token); }
+	inline const UploadBatchScheduler& getScheduler() const { return scheduler; }
+	// Of the last flush()
+	inline const UploadBatch& getLastBatch() const { return batch; }
+
+	// UploadStagingMemory
+	virtual uint8* createPage(uint32 pageIndex, uint64 size) override;
+	virtual void destroyPage(uint32 pageIndex) override;
+
+private:
+	RenderDevice*                  device = nullptr;
+	UploadBatchScheduler           scheduler;
+	std::vector<UniquePtr<Buffer>> pageBuffers; // index = page index
+	UploadBatch                    batch;
+
+	std::vector<BufferBarrierAuto>  bufferBarriers;
+	std::vector<TextureBarrierAuto> textureBarriers;
+};
+
+extern UploadBatcher* gUploadBatcher;
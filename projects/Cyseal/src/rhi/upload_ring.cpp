@@ -0,0 +1,102 @@
+#include "upload_ring.h"
+#include "render_device.h"
+#include "render_command.h"
+#include "buffer.h"
+#include "util/logging.h"
+
+#include <cstring>
+
+DEFINE_LOG_CATEGORY_STATIC(LogUploadRing);
+
+UploadRing::~UploadRing()
+{
+	// The renderer flushes the GPU before destruction.
+	for (Buffer* oldBuffer : oldBuffers)
+	{
+		delete oldBuffer;
+	}
+	oldBufferQueue.retireAll();
+}
+
+void UploadRing::initialize(RenderDevice* inDevice, uint64 capacity, UploadRingFence* inFence)
+{
+	device = inDevice;
+	fence = inFence;
+	createBuffer(capacity);
+}
+
+UploadRingAllocation UploadRing::allocate(uint64 size, uint64 alignment)
+{
+	UploadRingAllocation allocation = allocator.allocate(size, alignment);
+	if (allocation.isValid())
+	{
+		return allocation;
+	}
+
+	// This frame alone needs more than the whole ring.
+	uint64 newCapacity = allocator.getCapacity() * 2;
+	while (newCapacity < size + alignment)
+	{
+		newCapacity *= 2;
+	}
+	CYLOG(LogUploadRing, Warning, L"Grow upload ring: %llu bytes (%.3f MiB)",
+		newCapacity, (double)newCapacity / (1024.0 * 1024.0));
+
+	oldBuffers.push_back(buffer.release());
+	createBuffer(newCapacity);
+	numGrows += 1;
+
+	allocation = allocator.allocate(size, alignment);
+	CHECK(allocation.isValid());
+	return allocation;
+}
+
+void UploadRing::writeToBuffer(RenderCommandList* commandList, const void* srcData, uint64 sizeInBytes, Buffer* destBuffer, uint64 destOffsetInBytes)
+{
+	CHECK(ENUM_HAS_FLAG(destBuffer->getCreateParams().accessFlags, EBufferAccessFlags::COPY_DST));
+	CHECK(destOffsetInBytes + sizeInBytes <= destBuffer->getCreateParams().sizeInBytes);
+
+	UploadRingAllocation allocation = allocate(sizeInBytes);
+	::memcpy(allocation.cpuPtr, srcData, (size_t)sizeInBytes);
+
+	copyToBuffer(commandList, allocation, sizeInBytes, destBuffer, destOffsetInBytes);
+}
+
+void UploadRing::copyToBuffer(RenderCommandList* commandList, const UploadRingAllocation& allocation, uint64 sizeInBytes, Buffer* destBuffer, uint64 destOffsetInBytes)
+{
+	CHECK(ENUM_HAS_FLAG(destBuffer->getCreateParams().accessFlags, EBufferAccessFlags::COPY_DST));
+	CHECK(destOffsetInBytes + sizeInBytes <= destBuffer->getCreateParams().sizeInBytes);
+	CHECK(allocation.isValid() && sizeInBytes <= allocation.size);
+
+	BufferBarrierAuto barrierBefore{ EBarrierSync::COPY, EBarrierAccess::COPY_DEST, destBuffer };
+	commandList->barrierAuto(1, &barrierBefore, 0, nullptr, 0, nullptr);
+
+	commandList->copyBufferRegion(buffer.get(), allocation.offset, sizeInBytes, destBuffer, destOffsetInBytes);
+}
+
+void UploadRing::endFrame(uint64 fenceValue)
+{
+	allocator.endFrame(fenceValue);
+	allocator.retire();
+
+	for (Buffer* oldBuffer : oldBuffers)
+	{
+		oldBufferQueue.enqueue(oldBuffer, fenceValue);
+	}
+	oldBuffers.clear();
+	oldBufferQueue.retire(fence->getCompletedValue());
+}
+
+void UploadRing::createBuffer(uint64 capacity)
+{
+	buffer = UniquePtr<Buffer>(device->createBuffer(
+		BufferCreateParams{
+			.sizeInBytes = capacity,
+			.alignment   = 0,
+			.accessFlags = EBufferAccessFlags::UPLOAD_HEAP,
+		}
+	));
+	buffer->setDebugName(L"Buffer_UploadRing");
+
+	allocator.initialize(buffer->getMappedPointer(), capacity, fence);
+}
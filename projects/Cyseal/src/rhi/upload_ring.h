@@ -0,0 +1,62 @@
+#pragma once
+
+#include "upload_ring_allocator.h"
+#include "deferred_dealloc_queue.h"
+#include "core/smart_pointer.h"
+
+#include <vector>
+
+class RenderDevice;
+class RenderCommandList;
+class Buffer;
+
+// Enough for copy sources and structured buffers of 16-byte elements.
+#define UPLOAD_RING_DEFAULT_ALIGNMENT 16
+// D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT
+#define UPLOAD_RING_CONSTANT_ALIGNMENT 256
+
+// Persistently mapped upload buffer shared by render passes for per-frame data.
+// Use it instead of holding CPU_WRITE buffers for data that changes every frame,
+// like GPU scene commands and indirect arguments.
+// Grows when a frame needs more than the whole ring. Old backing buffers are
+// destroyed after the GPU finishes with them.
+class UploadRing
+{
+public:
+	~UploadRing();
+
+	void initialize(RenderDevice* inDevice, uint64 capacity, UploadRingFence* inFence);
+
+	// Suballocate from the backing buffer, which is getBuffer() at the moment.
+	// Always returns a valid allocation. Never hold an allocation across frames.
+	UploadRingAllocation allocate(uint64 size, uint64 alignment = UPLOAD_RING_DEFAULT_ALIGNMENT);
+
+	// Copy data to destBuffer through the ring. destBuffer should have COPY_DST flag.
+	// Like Buffer::singleWriteToGPU(), destBuffer is left in COPY_DEST state.
+	void writeToBuffer(RenderCommandList* commandList, const void* srcData, uint64 sizeInBytes, Buffer* destBuffer, uint64 destOffsetInBytes);
+
+	// Same as writeToBuffer() but the data was already written to an allocation of this frame.
+	// Saves a copy when the data can be generated directly in the mapped memory.
+	// Call before the next allocate(), which might replace the backing buffer.
+	void copyToBuffer(RenderCommandList* commandList, const UploadRingAllocation& allocation, uint64 sizeInBytes, Buffer* destBuffer, uint64 destOffsetInBytes);
+
+	// @param fenceValue Fence value that signals GPU completion of this frame.
+	void endFrame(uint64 fenceValue);
+
+	inline Buffer* getBuffer() const { return buffer.get(); }
+	inline const UploadRingAllocator& getAllocator() const { return allocator; }
+	inline uint32 getNumGrows() const { return numGrows; }
+
+private:
+	void createBuffer(uint64 capacity);
+
+	RenderDevice*        device = nullptr;
+	UploadRingFence*     fence = nullptr;
+	UniquePtr<Buffer>    buffer;
+	UploadRingAllocator  allocator;
+	uint32               numGrows = 0;
+
+	// Replaced backing buffers. Might be referenced by the current frame.
+	std::vector<Buffer*> oldBuffers;
+	DeferredDeallocQueue oldBufferQueue;
+};
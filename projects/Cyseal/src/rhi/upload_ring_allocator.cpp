@@ -0,0 +1,108 @@
+#include "upload_ring_allocator.h"
+#include "core/assertion.h"
+
+#include <algorithm>
+
+void UploadRingAllocator::initialize(uint8* mappedPtr, uint64 inCapacity, UploadRingFence* inFence)
+{
+	CHECK(mappedPtr != nullptr && inCapacity > 0 && inFence != nullptr);
+
+	basePtr = mappedPtr;
+	capacity = inCapacity;
+	fence = inFence;
+
+	head = 0;
+	tail = 0;
+	currentFrameStart = 0;
+	pendingFrames.clear();
+}
+
+UploadRingAllocation UploadRingAllocator::allocate(uint64 size, uint64 alignment)
+{
+	CHECK(size > 0);
+	CHECK(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	uint64 offset;
+	bool bAllocated = tryAllocate(size, alignment, offset);
+	if (!bAllocated)
+	{
+		retire();
+		bAllocated = tryAllocate(size, alignment, offset);
+	}
+	// Wait for the oldest frame until enough space is reclaimed.
+	while (!bAllocated && !pendingFrames.empty())
+	{
+		numStalls += 1;
+		fence->waitForValue(pendingFrames.front().fenceValue);
+		retire();
+		bAllocated = tryAllocate(size, alignment, offset);
+	}
+	if (!bAllocated)
+	{
+		numFailedAllocations += 1;
+		return UploadRingAllocation{};
+	}
+
+	highWaterMark = std::max(highWaterMark, head - tail);
+	return UploadRingAllocation{
+		.cpuPtr = basePtr + offset,
+		.offset = offset,
+		.size   = size,
+	};
+}
+
+void UploadRingAllocator::endFrame(uint64 fenceValue)
+{
+	CHECK(pendingFrames.empty() || pendingFrames.back().fenceValue <= fenceValue);
+	if (head != currentFrameStart)
+	{
+		pendingFrames.push_back(PendingFrame{ fenceValue, head });
+	}
+	currentFrameStart = head;
+}
+
+void UploadRingAllocator::retire()
+{
+	if (pendingFrames.empty())
+	{
+		return;
+	}
+	const uint64 completedValue = fence->getCompletedValue();
+	while (!pendingFrames.empty() && pendingFrames.front().fenceValue <= completedValue)
+	{
+		tail = pendingFrames.front().endPosition;
+		pendingFrames.pop_front();
+	}
+}
+
+bool UploadRingAllocator::tryAllocate(uint64 size, uint64 alignment, uint64& outOffset)
+{
+	if (size > capacity)
+	{
+		return false;
+	}
+	if (head == tail && pendingFrames.empty())
+	{
+		// Nothing in flight. Restart from the beginning to avoid needless wrapping.
+		head = tail = currentFrameStart = 0;
+	}
+
+	const uint64 headOffset = head % capacity;
+	uint64 offset = (headOffset + alignment - 1) & ~(alignment - 1);
+	if (offset + size > capacity)
+	{
+		// Not enough space until the end. Skip to the beginning of the buffer.
+		offset = 0;
+	}
+
+	const uint64 padding = (offset >= headOffset) ? (offset - headOffset) : (capacity - headOffset);
+	const uint64 newHead = head + padding + size;
+	if (newHead - tail > capacity)
+	{
+		return false;
+	}
+
+	head = newHead;
+	outOffset = offset;
+	return true;
+}
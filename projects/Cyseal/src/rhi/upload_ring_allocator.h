@@ -0,0 +1,86 @@
+#pragma once
+
+#include "core/int_types.h"
+
+#include <deque>
+
+// Fence that tells how far the GPU has progressed.
+// Values passed to UploadRingAllocator::endFrame() should be signaled in order.
+class UploadRingFence
+{
+public:
+	virtual ~UploadRingFence() = default;
+
+	virtual uint64 getCompletedValue() const = 0;
+
+	// Block until the GPU reaches the value.
+	virtual void waitForValue(uint64 value) = 0;
+};
+
+struct UploadRingAllocation
+{
+	uint8* cpuPtr = nullptr; // Persistently mapped address to write data.
+	uint64 offset = 0;       // Offset in the backing buffer.
+	uint64 size   = 0;
+
+	inline bool isValid() const { return cpuPtr != nullptr; }
+};
+
+// Suballocates transient upload memory from a persistently mapped buffer.
+// Memory is handed out linearly and wraps around. Space of a frame is
+// reclaimed once the fence value given to endFrame() is completed.
+//
+// This class only does bookkeeping on a raw memory block,
+// so any buffer (or just a CPU array) can back it.
+class UploadRingAllocator
+{
+public:
+	// @param mappedPtr Persistently mapped memory of the backing buffer.
+	// @param fence     Fence to query and wait for frame completion.
+	void initialize(uint8* mappedPtr, uint64 capacity, UploadRingFence* fence);
+
+	// Wait for GPU if there is not enough space (counted as a stall).
+	// Returns an invalid allocation if the request can't fit even after all previous frames retire.
+	// @param alignment Power of two. Applied to the offset in the backing buffer.
+	UploadRingAllocation allocate(uint64 size, uint64 alignment);
+
+	// Close allocations made since last endFrame().
+	// @param fenceValue Fence value that signals GPU completion of works using those allocations.
+	void endFrame(uint64 fenceValue);
+
+	// Reclaim space of frames whose fence values are completed.
+	void retire();
+
+	inline uint64 getCapacity() const { return capacity; }
+	inline uint64 getUsedBytes() const { return head - tail; }
+	inline uint64 getHighWaterMark() const { return highWaterMark; }
+	// Bytes allocated since last endFrame(), including alignment and wrap padding.
+	inline uint64 getCurrentFrameBytes() const { return head - currentFrameStart; }
+	inline uint64 getNumStalls() const { return numStalls; }
+	inline uint64 getNumFailedAllocations() const { return numFailedAllocations; }
+	inline size_t getNumPendingFrames() const { return pendingFrames.size(); }
+
+private:
+	struct PendingFrame
+	{
+		uint64 fenceValue;
+		uint64 endPosition; // tail can move up to here when the fence is completed.
+	};
+
+	// @return false if the allocation does not fit in free space.
+	bool tryAllocate(uint64 size, uint64 alignment, uint64& outOffset);
+
+	uint8*                   basePtr = nullptr;
+	uint64                   capacity = 0;
+	UploadRingFence*         fence = nullptr;
+
+	// Monotonic positions. Physical offset is (position % capacity).
+	uint64                   head = 0;
+	uint64                   tail = 0;
+	uint64                   currentFrameStart = 0;
+	std::deque<PendingFrame> pendingFrames;
+
+	uint64                   highWaterMark = 0;
+	uint64                   numStalls = 0;
+	uint64                   numFailedAllocations = 0;
+};
@@ -96,6 +96,10 @@ static void updateDefaultBuffer(
 VulkanBuffer::~VulkanBuffer()
 {
 	VkDevice vkDevice = device->getRaw();
+	if (vkBufferMapPtr != nullptr)
+	{
+		vkUnmapMemory(vkDevice, vkBufferMemory);
+	}
 	vkDestroyBuffer(vkDevice, vkBuffer, nullptr);
 	vkDestroyBuffer(vkDevice, vkUploadBuffer, nullptr);
 	vkDestroyBuffer(vkDevice, vkReadbackBuffer, nullptr);
@@ -119,6 +123,23 @@ void VulkanBuffer::onInitialize()
 	if (ENUM_HAS_FLAG(createParams.accessFlags, EBufferAccessFlags::SRV)) usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT; // Both SRV and UAV are SSBO in Vulkan
 	if (ENUM_HAS_FLAG(createParams.accessFlags, EBufferAccessFlags::UAV)) usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 
+	if (ENUM_HAS_FLAG(createParams.accessFlags, EBufferAccessFlags::UPLOAD_HEAP))
+	{
+		VkMemoryPropertyFlags memoryProps = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		createBufferUtil(
+			vkDevice,
+			vkPhysicalDevice,
+			(VkDeviceSize)createParams.sizeInBytes,
+			usage,
+			memoryProps,
+			vkBuffer, vkBufferMemory);
+
+		void* pData = nullptr;
+		vkMapMemory(vkDevice, vkBufferMemory, 0, VK_WHOLE_SIZE, (VkMemoryMapFlags)0, &pData);
+		vkBufferMapPtr = reinterpret_cast<uint8*>(pData);
+		CHECK(vkBufferMapPtr != nullptr);
+	}
+	else
 	{
 		VkMemoryPropertyFlags memoryProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 		createBufferUtil(
@@ -293,7 +314,7 @@ void VulkanVertexBuffer::updateData(
 	uint32 strideInBytes)
 {
 	CHECK(!bRemovedFromPool);
-	vertexCount = (uint32)(bufferSize / strideInBytes);
+	setStrideInBytes(strideInBytes);
 
 	VulkanVertexBuffer* bufferOwner = (parentPool == nullptr) ? this : static_cast<VulkanVertexBuffer*>(parentPool->internal_getPoolBuffer());
 	VkBuffer vkBuffer = (VkBuffer)bufferOwner->internalBuffer->getRawResource();
@@ -301,6 +322,12 @@ void VulkanVertexBuffer::updateData(
 	updateDefaultBuffer(device, vkBuffer, offsetInParentBuffer, data, bufferSize);
 }
 
+void VulkanVertexBuffer::setStrideInBytes(uint32 strideInBytes)
+{
+	bufferStride = strideInBytes;
+	vertexCount = (uint32)(bufferSize / strideInBytes);
+}
+
 VkBuffer VulkanVertexBuffer::getVkBuffer() const
 {
 	const VulkanVertexBuffer* bufferOwner = (parentPool == nullptr) ? this : static_cast<VulkanVertexBuffer*>(parentPool->internal_getPoolBuffer());
@@ -349,6 +376,13 @@ void VulkanIndexBuffer::updateData(
 	EPixelFormat format)
 {
 	CHECK(!bRemovedFromPool);
+	setIndexFormat(format);
+
+	updateDefaultBuffer(device, getVkBuffer(), offsetInParentBuffer, data, vkBufferSize);
+}
+
+void VulkanIndexBuffer::setIndexFormat(EPixelFormat format)
+{
 	vkIndexType = VK_INDEX_TYPE_MAX_ENUM;
 	switch (format)
 	{
@@ -362,8 +396,7 @@ void VulkanIndexBuffer::updateData(
 			break;
 	}
 	CHECK(vkIndexType != VK_INDEX_TYPE_MAX_ENUM);
-
-	updateDefaultBuffer(device, getVkBuffer(), offsetInParentBuffer, data, vkBufferSize);
+	indexFormat = format;
 }
 
 VkBuffer VulkanIndexBuffer::getVkBuffer() const
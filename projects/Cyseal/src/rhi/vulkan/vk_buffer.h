@@ -20,6 +20,8 @@ public:
 	virtual void writeToGPU(RenderCommandList* commandList, uint32 numUploads, Buffer::UploadDesc* uploadDescs) override;
 	virtual SharedPtr<ReadbackHandle> requestReadback(RenderCommandList* commandList, uint64 offset, uint64 size) override;
 
+	virtual uint8* getMappedPointer() const override { return vkBufferMapPtr; }
+
 	virtual void* getRawResource() const { return vkBuffer; }
 	virtual void setDebugName(const wchar_t* inDebugName) override;
 
@@ -32,6 +34,7 @@ private:
 	VulkanDevice* device = nullptr;
 	VkDeviceMemory vkBufferMemory = VK_NULL_HANDLE;
 	VkBuffer vkBuffer = VK_NULL_HANDLE;
+	uint8* vkBufferMapPtr = nullptr; // Only if UPLOAD_HEAP
 
 	VkDeviceMemory vkUploadMemory = VK_NULL_HANDLE;
 	VkBuffer vkUploadBuffer = VK_NULL_HANDLE;
@@ -56,6 +59,7 @@ public:
 	virtual void initialize(uint32 sizeInBytes, EBufferAccessFlags usageFlags) override;
 	virtual void initializeWithinPool(VertexBufferPool* pool, uint64 offsetInPool, uint32 sizeInBytes) override;
 	virtual void updateData(RenderCommandList* commandList, void* data, uint32 strideInBytes) override;
+	virtual void setStrideInBytes(uint32 strideInBytes) override;
 	virtual uint32 getVertexCount() const override { return vertexCount; };
 	virtual uint64 getBufferOffsetInBytes() const override { return offsetInParentBuffer; }
 	virtual uint32 getBufferSizeInBytes() const { return (uint32)bufferSize; }
@@ -93,6 +97,7 @@ public:
 	virtual void initialize(uint32 sizeInBytes, EPixelFormat format, EBufferAccessFlags usageFlags) override;
 	virtual void initializeWithinPool(IndexBufferPool* pool, uint64 offsetInPool, uint32 sizeInBytes) override;
 	virtual void updateData(RenderCommandList* commandList, void* data, EPixelFormat format) override;
+	virtual void setIndexFormat(EPixelFormat format) override;
 	virtual uint32 getIndexCount() const override { return indexCount; }
 	virtual EPixelFormat getIndexFormat() const override { return indexFormat; }
 	virtual uint64 getBufferOffsetInBytes() const override { return offsetInParentBuffer; }
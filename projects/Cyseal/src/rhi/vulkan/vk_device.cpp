@@ -73,6 +73,7 @@ struct PhysicalDeviceFeatureBlob
 	{
 		//deviceFeatures.imageCubeArray = VK_TRUE;
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.textureCompressionBC = VK_TRUE;
 		//deviceFeatures.multiDrawIndirect = VK_TRUE;
 
 		features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
@@ -564,7 +565,7 @@ void VulkanDevice::beginDearImguiNewFrame()
 	ImGui_ImplVulkan_NewFrame();
 }
 
-void VulkanDevice::renderDearImgui(RenderCommandList* commandList, SwapChainImage* swapChainImage)
+void VulkanDevice::renderDearImgui(RenderCommandList* commandList, SwapChainImage* swapChainImage, ImDrawData* drawData)
 {
 	if (createParams.swapChainParams.bHeadless)
 	{
@@ -589,7 +590,11 @@ void VulkanDevice::renderDearImgui(RenderCommandList* commandList, SwapChainImag
 		.pClearValues    = clearValues,
 	};
 	vkCmdBeginRenderPass(vkCommandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), vkCommandBuffer, VK_NULL_HANDLE);
+	// The render pass still transitions the swapchain image even if there is nothing to draw.
+	if (drawData != nullptr)
+	{
+		ImGui_ImplVulkan_RenderDrawData(drawData, vkCommandBuffer, VK_NULL_HANDLE);
+	}
 	vkCmdEndRenderPass(vkCommandBuffer);
 
 	VulkanSwapchainImage* vulkanSwapChainImage = static_cast<VulkanSwapchainImage*>(swapChainImage);
@@ -1613,7 +1618,8 @@ bool VulkanDevice::isDeviceSuitable(VkPhysicalDevice physDevice, bool bSkipSwapc
 	}
 
 	return indices.isComplete() && extensionsSupported
-		&& swapChainAdequate && deviceFeatures2.features.samplerAnisotropy;
+		&& swapChainAdequate && deviceFeatures2.features.samplerAnisotropy
+		&& deviceFeatures2.features.textureCompressionBC;
 }
 
 bool VulkanDevice::checkDeviceExtensionSupport(VkPhysicalDevice physDevice)
@@ -516,6 +516,9 @@ namespace into_vk
 			case EPixelFormat::B8G8R8A8_UNORM           : return VkFormat::VK_FORMAT_B8G8R8A8_UNORM;
 			case EPixelFormat::R8G8_UNORM               : return VkFormat::VK_FORMAT_R8G8_UNORM;
 			case EPixelFormat::R8_UNORM                 : return VkFormat::VK_FORMAT_R8_UNORM;
+			case EPixelFormat::R16G16B16A16_UNORM       : return VkFormat::VK_FORMAT_R16G16B16A16_UNORM;
+			case EPixelFormat::R16G16_UNORM             : return VkFormat::VK_FORMAT_R16G16_UNORM;
+			case EPixelFormat::R16_UNORM                : return VkFormat::VK_FORMAT_R16_UNORM;
 			case EPixelFormat::R32_FLOAT                : return VkFormat::VK_FORMAT_R32_SFLOAT;
 			case EPixelFormat::R32G32_FLOAT             : return VkFormat::VK_FORMAT_R32G32_SFLOAT;
 			case EPixelFormat::R32G32B32_FLOAT          : return VkFormat::VK_FORMAT_R32G32B32_SFLOAT;
@@ -529,6 +532,11 @@ namespace into_vk
 			case EPixelFormat::R16G16_UINT              : return VkFormat::VK_FORMAT_R16G16_UINT;
 			case EPixelFormat::R32G32B32A32_UINT        : return VkFormat::VK_FORMAT_R32G32B32A32_UINT;
 			case EPixelFormat::R16G16_SINT              : return VkFormat::VK_FORMAT_R16G16_SINT;
+			case EPixelFormat::BC1_UNORM                : return VkFormat::VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+			case EPixelFormat::BC3_UNORM                : return VkFormat::VK_FORMAT_BC3_UNORM_BLOCK;
+			case EPixelFormat::BC4_UNORM                : return VkFormat::VK_FORMAT_BC4_UNORM_BLOCK;
+			case EPixelFormat::BC5_UNORM                : return VkFormat::VK_FORMAT_BC5_UNORM_BLOCK;
+			case EPixelFormat::BC7_UNORM                : return VkFormat::VK_FORMAT_BC7_UNORM_BLOCK;
 			case EPixelFormat::D24_UNORM_S8_UINT        : return VkFormat::VK_FORMAT_D24_UNORM_S8_UINT;
 			case EPixelFormat::D32_FLOAT_S8_UINT        : return VkFormat::VK_FORMAT_D32_SFLOAT_S8_UINT;
 		}
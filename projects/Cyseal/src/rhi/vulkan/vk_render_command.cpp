@@ -280,6 +280,36 @@ void VulkanRenderCommandList::copyTexture2D(Texture* src, Texture* dst)
 	CHECK_NO_ENTRY();
 }
 
+void VulkanRenderCommandList::copyTextureSubresource(Texture* src, uint32 srcSubresourceIndex, Texture* dst, uint32 dstSubresourceIndex)
+{
+	// #todo-vulkan
+	CHECK_NO_ENTRY();
+}
+
+void VulkanRenderCommandList::copyBufferToTexture(Buffer* src, uint64 srcOffset, uint64 srcRowPitch, Texture* dst, uint32 subresourceIndex)
+{
+	// #todo-vulkan
+	CHECK_NO_ENTRY();
+}
+
+void VulkanRenderCommandList::beginPooledBufferCopies(uint32 numPools, GPUResource* const* pools)
+{
+	// #todo-vulkan
+	CHECK_NO_ENTRY();
+}
+
+void VulkanRenderCommandList::copyBufferToPooledBuffer(Buffer* src, uint64 srcOffset, uint64 numBytes, GPUResource* dstPool, uint64 dstOffset)
+{
+	// #todo-vulkan
+	CHECK_NO_ENTRY();
+}
+
+void VulkanRenderCommandList::endPooledBufferCopies(uint32 numPools, GPUResource* const* pools)
+{
+	// #todo-vulkan
+	CHECK_NO_ENTRY();
+}
+
 void VulkanRenderCommandList::setGraphicsPipelineState(GraphicsPipelineState* state)
 {
 	// #todo-vulkan
@@ -74,6 +74,12 @@ public:
 	virtual void copyBufferRegion(Buffer* src, uint64 srcOffset, uint64 numBytes, Buffer* dst, uint64 dstOffset) override;
 
 	virtual void copyTexture2D(Texture* src, Texture* dst) override;
+	virtual void copyTextureSubresource(Texture* src, uint32 srcSubresourceIndex, Texture* dst, uint32 dstSubresourceIndex) override;
+
+	virtual void copyBufferToTexture(Buffer* src, uint64 srcOffset, uint64 srcRowPitch, Texture* dst, uint32 subresourceIndex) override;
+	virtual void beginPooledBufferCopies(uint32 numPools, GPUResource* const* pools) override;
+	virtual void copyBufferToPooledBuffer(Buffer* src, uint64 srcOffset, uint64 numBytes, GPUResource* dstPool, uint64 dstOffset) override;
+	virtual void endPooledBufferCopies(uint32 numPools, GPUResource* const* pools) override;
 
 	// ------------------------------------------------------------------------
 	// Pipeline state (graphics, compute, raytracing)
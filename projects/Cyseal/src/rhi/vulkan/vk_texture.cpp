@@ -149,14 +149,31 @@ void VulkanTexture::uploadData(
 	uint64 slicePitch,
 	uint32 subresourceIndex)
 {
+	// #todo-vulkan: subresourceIndex is treated as a mip level.
+	const uint32 mipLevel = subresourceIndex;
+	const uint32 mipWidth = (std::max)(1u, createParams.width >> mipLevel);
+	const uint32 mipHeight = (std::max)(1u, createParams.height >> mipLevel);
 	const uint64 uploadSize = slicePitch * createParams.depth;
-	CHECK(uploadSize <= allocSize);
+
+	// Mips are packed one after another in the upload buffer, so that all mips can be uploaded in the same command list.
+	// Offsets should be multiples of both 4 and the texel (or block) size.
+	const EPixelFormat format = createParams.format;
+	const uint64 offsetAlignment = 4 * (isBlockCompressedFormat(format) ? getBlockCompressedBlockBytes(format) : getPixelFormatBytes(format));
+	uint64 bufferOffset = 0;
+	for (uint32 mip = 0; mip < mipLevel; ++mip)
+	{
+		const uint32 w = (std::max)(1u, createParams.width >> mip);
+		const uint32 h = (std::max)(1u, createParams.height >> mip);
+		const uint64 mipBytes = getPixelFormatRowBytes(format, w) * getPixelFormatNumRows(format, h) * createParams.depth;
+		bufferOffset += (mipBytes + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+	}
+	CHECK(bufferOffset + uploadSize <= allocSize);
 
 	VkDevice vkDevice = device->getRaw();
 	VkCommandBuffer cmd = static_cast<VulkanRenderCommandList*>(commandList)->internal_getVkCommandBuffer();
 
 	void* pData = nullptr;
-	vkMapMemory(vkDevice, vkUploadMemory, 0, uploadSize, (VkMemoryMapFlags)0, &pData);
+	vkMapMemory(vkDevice, vkUploadMemory, bufferOffset, uploadSize, (VkMemoryMapFlags)0, &pData);
 	std::memcpy(pData, buffer, uploadSize);
 	vkUnmapMemory(vkDevice, vkUploadMemory);
 
@@ -166,18 +183,18 @@ void VulkanTexture::uploadData(
 	
 	// https://docs.vulkan.org/refpages/latest/refpages/source/VkBufferImageCopy.html
 	VkBufferImageCopy region{
-		.bufferOffset       = 0,
+		.bufferOffset       = bufferOffset,
 		// Hmm I don't understand the doc :( let's just make it use imageExtent.
 		.bufferRowLength    = 0,//(uint32)rowPitch,
 		.bufferImageHeight  = 0,//(uint32)(slicePitch / rowPitch),
 		.imageSubresource   = VkImageSubresourceLayers{
 			.aspectMask     = aspectMask,
-			.mipLevel       = subresourceIndex,
+			.mipLevel       = mipLevel,
 			.baseArrayLayer = 0,
 			.layerCount     = 1,
 		},
 		.imageOffset        = VkOffset3D { 0, 0, 0 },
-		.imageExtent        = VkExtent3D { createParams.width, createParams.height, createParams.depth },
+		.imageExtent        = VkExtent3D { mipWidth, mipHeight, createParams.depth },
 	};
 
 	TextureBarrierAuto texBarrier = TextureBarrierAuto::toCopyDest(this);
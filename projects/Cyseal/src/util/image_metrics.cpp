@@ -0,0 +1,1117 @@
+#include "image_metrics.h"
+
+#include "core/assertion.h"
+#include "core/cymath.h"
+#include "core/thread_pool.h"
+
+#include <emmintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <limits>
+
+// Rows per parallel chunk for per-pixel metrics.
+#define IMAGE_METRICS_GRAIN_ROWS 16
+// Minimum output rows per parallel chunk for filtered metrics.
+// Each chunk also filters a margin of the kernel radius above and below its rows.
+#define IMAGE_METRICS_MIN_BAND_ROWS 32
+
+// Chunks are the same with or without a thread pool, so per-chunk results merge to the same values.
+template<typename Fn>
+static void parallelForRows(ThreadPool* threadPool, uint32 numRows, uint32 grainSize, Fn&& fn)
+{
+	if (threadPool == nullptr)
+	{
+		const uint32 numChunks = ThreadPool::getNumChunks(numRows, grainSize);
+		for (uint32 chunkIx = 0; chunkIx < numChunks; ++chunkIx)
+		{
+			const uint32 begin = chunkIx * grainSize;
+			fn(chunkIx, begin, std::min(begin + grainSize, numRows));
+		}
+	}
+	else
+	{
+		threadPool->parallelFor(numRows, grainSize, fn);
+	}
+}
+
+MetricImage MetricImage::rgba8(const uint8* data, uint32 width, uint32 height, uint64 rowPitch)
+{
+	return MetricImage{ data, width, height, (rowPitch != 0) ? rowPitch : 4ull * width, EMetricPixelFormat::RGBA8 };
+}
+
+MetricImage MetricImage::rgba32f(const float* data, uint32 width, uint32 height, uint64 rowPitch)
+{
+	return MetricImage{ data, width, height, (rowPitch != 0) ? rowPitch : 16ull * width, EMetricPixelFormat::RGBA32F };
+}
+
+static void checkComparable(const MetricImage& reference, const MetricImage& test)
+{
+	CHECK(reference.data != nullptr && test.data != nullptr);
+	CHECK(reference.width > 0 && reference.height > 0);
+	CHECK(reference.width == test.width && reference.height == test.height);
+}
+
+static inline const uint8* getRow(const MetricImage& image, uint32 y)
+{
+	return static_cast<const uint8*>(image.data) + y * image.rowPitch;
+}
+
+static inline uint32 roundUpTo4(uint32 n)
+{
+	return (n + 3) & ~3u;
+}
+
+// ------------------------------------------------
+// SIMD math
+
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 clamp01_ps(__m128 x)
+{
+	// max() returns its second operand for NaN, so NaN becomes 0.
+	return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+// log2 for positive normal floats. Max error is around 1e-7.
+static inline __m128 log2_ps(__m128 x)
+{
+	const __m128i bits = _mm_castps_si128(x);
+	__m128i exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+	__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+
+	// Mantissa in [sqrt(0.5), sqrt(2)) so that the series below converges fast.
+	const __m128 bIsLarge = _mm_cmpgt_ps(m, _mm_set1_ps(1.41421356f));
+	m = select_ps(bIsLarge, _mm_mul_ps(m, _mm_set1_ps(0.5f)), m);
+	exponent = _mm_sub_epi32(exponent, _mm_castps_si128(bIsLarge));
+
+	// log2(m) = 2 / ln2 * (t + t^3 / 3 + t^5 / 5 + t^7 / 7 + ...), t = (m - 1) / (m + 1)
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+	const __m128 t2 = _mm_mul_ps(t, t);
+	__m128 poly = _mm_set1_ps(2.0f / (7.0f * 0.69314718f));
+	poly = _mm_add_ps(_mm_mul_ps(poly, t2), _mm_set1_ps(2.0f / (5.0f * 0.69314718f)));
+	poly = _mm_add_ps(_mm_mul_ps(poly, t2), _mm_set1_ps(2.0f / (3.0f * 0.69314718f)));
+	poly = _mm_add_ps(_mm_mul_ps(poly, t2), _mm_set1_ps(2.0f / 0.69314718f));
+	return _mm_add_ps(_mm_cvtepi32_ps(exponent), _mm_mul_ps(poly, t));
+}
+
+// exp2 with the input clamped to [-126, 126]. Max relative error is around 2e-7.
+static inline __m128 exp2_ps(__m128 x)
+{
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0f)), _mm_set1_ps(126.0f));
+	const __m128i n = _mm_cvtps_epi32(x); // Round to nearest
+	const __m128 y = _mm_mul_ps(_mm_sub_ps(x, _mm_cvtepi32_ps(n)), _mm_set1_ps(0.69314718f));
+
+	// e^y for |y| <= ln2 / 2
+	__m128 poly = _mm_set1_ps(1.0f / 720.0f);
+	poly = _mm_add_ps(_mm_mul_ps(poly, y), _mm_set1_ps(1.0f / 120.0f));
+	poly = _mm_add_ps(_mm_mul_ps(poly, y), _mm_set1_ps(1.0f / 24.0f));
+	poly = _mm_add_ps(_mm_mul_ps(poly, y), _mm_set1_ps(1.0f / 6.0f));
+	poly = _mm_add_ps(_mm_mul_ps(poly, y), _mm_set1_ps(0.5f));
+	poly = _mm_add_ps(_mm_mul_ps(poly, y), _mm_set1_ps(1.0f));
+	poly = _mm_add_ps(_mm_mul_ps(poly, y), _mm_set1_ps(1.0f));
+
+	const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+	return _mm_mul_ps(poly, scale);
+}
+
+// x^p for x > 0, and 0 for x <= 0.
+static inline __m128 powPositive_ps(__m128 x, __m128 p)
+{
+	const __m128 bIsPositive = _mm_cmpgt_ps(x, _mm_setzero_ps());
+	const __m128 result = exp2_ps(_mm_mul_ps(p, log2_ps(_mm_max_ps(x, _mm_set1_ps(FLT_MIN)))));
+	return _mm_and_ps(bIsPositive, result);
+}
+
+// ------------------------------------------------
+// Separable filters
+
+struct SeparableKernel
+{
+	int32              radius = 0;
+	std::vector<float> weights; // 2 * radius + 1
+};
+
+static SeparableKernel normalizeKernel(int32 radius, std::vector<float> weights)
+{
+	float sum = 0.0f;
+	for (float w : weights) sum += w;
+	for (float& w : weights) w /= sum;
+	return SeparableKernel{ radius, std::move(weights) };
+}
+
+// Replicates the first and last texels of a row stored at padded[margin, margin + width).
+static void padRow(float* padded, uint32 width, int32 margin)
+{
+	for (int32 i = 0; i < margin; ++i)
+	{
+		padded[i] = padded[margin];
+		padded[margin + width + i] = padded[margin + width - 1];
+	}
+}
+
+// Horizontal pass. src is a padded row with the given margin, which must be at least the kernel radius.
+static void convolveRow(const float* padded, int32 margin, uint32 width, const SeparableKernel& kernel, float* dst)
+{
+	const float* src = padded + (margin - kernel.radius);
+	const uint32 numTaps = (uint32)kernel.weights.size();
+	const float* weights = kernel.weights.data();
+
+	// 16 pixels at a time, as independent sums hide the latency of additions.
+	uint32 x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps(), sum2 = _mm_setzero_ps(), sum3 = _mm_setzero_ps();
+		for (uint32 t = 0; t < numTaps; ++t)
+		{
+			const __m128 weight = _mm_set1_ps(weights[t]);
+			const float* p = src + x + t;
+			sum0 = _mm_add_ps(sum0, _mm_mul_ps(weight, _mm_loadu_ps(p)));
+			sum1 = _mm_add_ps(sum1, _mm_mul_ps(weight, _mm_loadu_ps(p + 4)));
+			sum2 = _mm_add_ps(sum2, _mm_mul_ps(weight, _mm_loadu_ps(p + 8)));
+			sum3 = _mm_add_ps(sum3, _mm_mul_ps(weight, _mm_loadu_ps(p + 12)));
+		}
+		_mm_storeu_ps(dst + x, sum0);
+		_mm_storeu_ps(dst + x + 4, sum1);
+		_mm_storeu_ps(dst + x + 8, sum2);
+		_mm_storeu_ps(dst + x + 12, sum3);
+	}
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (uint32 t = 0; t < numTaps; ++t)
+		{
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(src + x + t)));
+		}
+		_mm_storeu_ps(dst + x, sum);
+	}
+	for (; x < width; ++x)
+	{
+		float sum = 0.0f;
+		for (uint32 t = 0; t < numTaps; ++t)
+		{
+			sum += weights[t] * src[x + t];
+		}
+		dst[x] = sum;
+	}
+}
+
+// Vertical pass over rows[0, numTaps).
+static void convolveColumns(const float* const* rows, uint32 width, const SeparableKernel& kernel, float* dst)
+{
+	const uint32 numTaps = (uint32)kernel.weights.size();
+	const float* weights = kernel.weights.data();
+
+	uint32 x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps(), sum2 = _mm_setzero_ps(), sum3 = _mm_setzero_ps();
+		for (uint32 t = 0; t < numTaps; ++t)
+		{
+			const __m128 weight = _mm_set1_ps(weights[t]);
+			const float* p = rows[t] + x;
+			sum0 = _mm_add_ps(sum0, _mm_mul_ps(weight, _mm_loadu_ps(p)));
+			sum1 = _mm_add_ps(sum1, _mm_mul_ps(weight, _mm_loadu_ps(p + 4)));
+			sum2 = _mm_add_ps(sum2, _mm_mul_ps(weight, _mm_loadu_ps(p + 8)));
+			sum3 = _mm_add_ps(sum3, _mm_mul_ps(weight, _mm_loadu_ps(p + 12)));
+		}
+		_mm_storeu_ps(dst + x, sum0);
+		_mm_storeu_ps(dst + x + 4, sum1);
+		_mm_storeu_ps(dst + x + 8, sum2);
+		_mm_storeu_ps(dst + x + 12, sum3);
+	}
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (uint32 t = 0; t < numTaps; ++t)
+		{
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + x)));
+		}
+		_mm_storeu_ps(dst + x, sum);
+	}
+	for (; x < width; ++x)
+	{
+		float sum = 0.0f;
+		for (uint32 t = 0; t < numTaps; ++t)
+		{
+			sum += weights[t] * rows[t][x];
+		}
+		dst[x] = sum;
+	}
+}
+
+// Horizontally filtered rows around the current output row, (2 * margin + 1) rows for each plane.
+// Each chunk of output rows filters its source rows once, plus the margin above and below.
+class FilteredRowRing
+{
+public:
+	FilteredRowRing(uint32 numPlanes, uint32 width, int32 margin)
+		: width(width)
+		, margin(margin)
+		, numRows(2 * margin + 1)
+		, rows(uint64(numPlanes) * numRows * width)
+	{}
+
+	// Row y of a plane, for y in [-margin, height + margin).
+	inline float* getRow(uint32 plane, int64 y)
+	{
+		const uint32 slot = (uint32)((y + margin) % numRows);
+		return rows.data() + (uint64(plane) * numRows + slot) * width;
+	}
+
+	// Rows (y - radius) to (y + radius) of a plane.
+	inline void getColumn(uint32 plane, int64 y, int32 radius, const float** outRows)
+	{
+		for (int32 t = -radius; t <= radius; ++t)
+		{
+			outRows[t + radius] = getRow(plane, y + t);
+		}
+	}
+
+private:
+	uint32             width;
+	int32              margin;
+	uint32             numRows;
+	std::vector<float> rows;
+};
+
+static inline uint32 clampRow(int64 y, uint32 height)
+{
+	return (uint32)std::clamp<int64>(y, 0, (int64)height - 1);
+}
+
+// Filtered metrics keep a sum for each row, so results do not depend on how rows are split into chunks.
+// Without a thread pool, the whole image is one chunk.
+static uint32 getBandRows(ThreadPool* threadPool, uint32 height)
+{
+	if (threadPool == nullptr)
+	{
+		return height;
+	}
+	const uint32 numChunks = 4 * threadPool->getNumThreads();
+	return std::max<uint32>(IMAGE_METRICS_MIN_BAND_ROWS, (height + numChunks - 1) / numChunks);
+}
+
+// ------------------------------------------------
+// MSE
+
+float calcPSNR(float mse)
+{
+	return (mse > 0.0f) ? 10.0f * std::log10(1.0f / mse) : std::numeric_limits<float>::infinity();
+}
+
+struct MSEChunkResult
+{
+	uint64 integerSum[3] = { 0, 0, 0 }; // rgba8 vs rgba8, in units of (1 / 255)^2
+	double floatSum[3]   = { 0.0, 0.0, 0.0 };
+	uint32 numDifferentPixels = 0;
+	float  maxAbsError = 0.0f;
+};
+
+static const uint8 kBitCount4[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+static void accumulateRowRgba8(const uint8* a, const uint8* b, uint32 width, MSEChunkResult& result, float* errorRow)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rgbMask = _mm_set1_epi32(0x00ffffff);
+	__m128i maxDiff = zero;
+
+	uint32 x = 0;
+	while (x + 4 <= width)
+	{
+		// Squares are up to 255^2, so 32-bit lanes are flushed before they could overflow.
+		const uint32 blockEnd = x + std::min((width - x) & ~3u, 16384u);
+		__m128i sum = zero;
+		for (; x < blockEnd; x += 4)
+		{
+			const __m128i va = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 4 * x)), rgbMask);
+			const __m128i vb = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 4 * x)), rgbMask);
+			const __m128i absDiff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+			maxDiff = _mm_max_epu8(maxDiff, absDiff);
+
+			const int32 equalMask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, vb)));
+			result.numDifferentPixels += 4 - kBitCount4[equalMask];
+
+			// Widen to one pixel per register, with 16-bit (diff, 0) pairs so that madd squares each channel.
+			const __m128i lo = _mm_unpacklo_epi8(absDiff, zero);
+			const __m128i hi = _mm_unpackhi_epi8(absDiff, zero);
+			const __m128i p0 = _mm_unpacklo_epi16(lo, zero);
+			const __m128i p1 = _mm_unpackhi_epi16(lo, zero);
+			const __m128i p2 = _mm_unpacklo_epi16(hi, zero);
+			const __m128i p3 = _mm_unpackhi_epi16(hi, zero);
+			sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_madd_epi16(p0, p0), _mm_madd_epi16(p1, p1)));
+			sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_madd_epi16(p2, p2), _mm_madd_epi16(p3, p3)));
+		}
+		alignas(16) uint32 lanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum);
+		for (uint32 c = 0; c < 3; ++c) result.integerSum[c] += lanes[c];
+	}
+
+	alignas(16) uint8 maxBytes[16];
+	_mm_store_si128(reinterpret_cast<__m128i*>(maxBytes), maxDiff);
+	uint32 maxAbs = *std::max_element(maxBytes, maxBytes + 16);
+
+	for (; x < width; ++x)
+	{
+		bool bDifferent = false;
+		for (uint32 c = 0; c < 3; ++c)
+		{
+			const int32 diff = std::abs((int32)a[4 * x + c] - (int32)b[4 * x + c]);
+			result.integerSum[c] += uint64(diff * diff);
+			maxAbs = std::max(maxAbs, (uint32)diff);
+			bDifferent = bDifferent || (diff != 0);
+		}
+		result.numDifferentPixels += bDifferent ? 1 : 0;
+	}
+	result.maxAbsError = std::max(result.maxAbsError, maxAbs / 255.0f);
+
+	if (errorRow != nullptr)
+	{
+		constexpr float scale = 1.0f / (3.0f * 255.0f * 255.0f);
+		for (x = 0; x < width; ++x)
+		{
+			const int32 dr = (int32)a[4 * x + 0] - (int32)b[4 * x + 0];
+			const int32 dg = (int32)a[4 * x + 1] - (int32)b[4 * x + 1];
+			const int32 db = (int32)a[4 * x + 2] - (int32)b[4 * x + 2];
+			errorRow[x] = (float)(dr * dr + dg * dg + db * db) * scale;
+		}
+	}
+}
+
+// Decodes a row to rgba32f in [0, 1] with alpha zeroed, so that SIMD loops process all 4 channels.
+static void decodeRowRgba(const MetricImage& image, uint32 y, float* outRow)
+{
+	const uint8* row = getRow(image, y);
+	if (image.format == EMetricPixelFormat::RGBA8)
+	{
+		for (uint32 x = 0; x < image.width; ++x)
+		{
+			// Divide rather than multiply by the reciprocal, to match values converted as (v / 255.0f) exactly.
+			outRow[4 * x + 0] = row[4 * x + 0] / 255.0f;
+			outRow[4 * x + 1] = row[4 * x + 1] / 255.0f;
+			outRow[4 * x + 2] = row[4 * x + 2] / 255.0f;
+			outRow[4 * x + 3] = 0.0f;
+		}
+	}
+	else
+	{
+		const float* src = reinterpret_cast<const float*>(row);
+		const __m128 rgbMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		for (uint32 x = 0; x < image.width; ++x)
+		{
+			_mm_storeu_ps(outRow + 4 * x, _mm_and_ps(clamp01_ps(_mm_loadu_ps(src + 4 * x)), rgbMask));
+		}
+	}
+}
+
+static void accumulateRowFloat(const float* a, const float* b, uint32 width, MSEChunkResult& result, float* errorRow)
+{
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 sum = _mm_setzero_ps();
+	__m128 maxDiff = _mm_setzero_ps();
+	for (uint32 x = 0; x < width; ++x)
+	{
+		const __m128 va = _mm_loadu_ps(a + 4 * x);
+		const __m128 vb = _mm_loadu_ps(b + 4 * x);
+		const __m128 diff = _mm_sub_ps(va, vb);
+		const __m128 squared = _mm_mul_ps(diff, diff);
+		sum = _mm_add_ps(sum, squared);
+		maxDiff = _mm_max_ps(maxDiff, _mm_and_ps(diff, absMask));
+		result.numDifferentPixels += (_mm_movemask_ps(_mm_cmpneq_ps(va, vb)) != 0) ? 1 : 0;
+		if (errorRow != nullptr)
+		{
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, squared);
+			errorRow[x] = (lanes[0] + lanes[1] + lanes[2]) * (1.0f / 3.0f);
+		}
+	}
+	alignas(16) float lanes[4];
+	_mm_store_ps(lanes, sum);
+	for (uint32 c = 0; c < 3; ++c) result.floatSum[c] += lanes[c];
+	_mm_store_ps(lanes, maxDiff);
+	result.maxAbsError = std::max(result.maxAbsError, std::max(lanes[0], std::max(lanes[1], lanes[2])));
+}
+
+ImageErrorStats computeMSE(const MetricImage& reference, const MetricImage& test, ThreadPool* threadPool, std::vector<float>* outErrorMap)
+{
+	checkComparable(reference, test);
+	const uint32 width = reference.width;
+	const uint32 height = reference.height;
+	const bool bIntegers = (reference.format == EMetricPixelFormat::RGBA8 && test.format == EMetricPixelFormat::RGBA8);
+	if (outErrorMap != nullptr)
+	{
+		outErrorMap->resize(uint64(width) * height);
+	}
+
+	std::vector<MSEChunkResult> chunkResults(ThreadPool::getNumChunks(height, IMAGE_METRICS_GRAIN_ROWS));
+	auto processRows = [&](uint32 chunkIx, uint32 begin, uint32 end)
+	{
+		MSEChunkResult& result = chunkResults[chunkIx];
+		std::vector<float> rowA, rowB;
+		if (!bIntegers)
+		{
+			rowA.resize(4 * width);
+			rowB.resize(4 * width);
+		}
+		for (uint32 y = begin; y < end; ++y)
+		{
+			float* errorRow = (outErrorMap != nullptr) ? outErrorMap->data() + uint64(y) * width : nullptr;
+			if (bIntegers)
+			{
+				accumulateRowRgba8(getRow(reference, y), getRow(test, y), width, result, errorRow);
+			}
+			else
+			{
+				decodeRowRgba(reference, y, rowA.data());
+				decodeRowRgba(test, y, rowB.data());
+				accumulateRowFloat(rowA.data(), rowB.data(), width, result, errorRow);
+			}
+		}
+	};
+	parallelForRows(threadPool, height, IMAGE_METRICS_GRAIN_ROWS, processRows);
+
+	double sums[3] = { 0.0, 0.0, 0.0 };
+	ImageErrorStats stats;
+	for (const MSEChunkResult& result : chunkResults)
+	{
+		for (uint32 c = 0; c < 3; ++c)
+		{
+			sums[c] += (double)result.integerSum[c] / (255.0 * 255.0) + result.floatSum[c];
+		}
+		stats.numDifferentPixels += result.numDifferentPixels;
+		stats.maxAbsError = std::max(stats.maxAbsError, result.maxAbsError);
+	}
+	const double numPixels = (double)width * height;
+	stats.mse = vec3((float)(sums[0] / numPixels), (float)(sums[1] / numPixels), (float)(sums[2] / numPixels));
+	stats.mseAverage = (float)((sums[0] + sums[1] + sums[2]) / (3.0 * numPixels));
+	stats.psnr = vec3(calcPSNR(stats.mse.x), calcPSNR(stats.mse.y), calcPSNR(stats.mse.z));
+	stats.psnrAverage = calcPSNR(stats.mseAverage);
+	return stats;
+}
+
+// ------------------------------------------------
+// SSIM
+
+// Luma minus 0.5. Centered values lose less precision in E[x^2] - E[x]^2.
+static void decodeRowLuma(const MetricImage& image, uint32 y, float* outLuma)
+{
+	const uint8* row = getRow(image, y);
+	if (image.format == EMetricPixelFormat::RGBA8)
+	{
+		for (uint32 x = 0; x < image.width; ++x)
+		{
+			const uint8* p = row + 4 * x;
+			outLuma[x] = (0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2]) * (1.0f / 255.0f) - 0.5f;
+		}
+	}
+	else
+	{
+		const float* src = reinterpret_cast<const float*>(row);
+		for (uint32 x = 0; x < image.width; ++x)
+		{
+			const float* p = src + 4 * x;
+			const float r = std::clamp(p[0], 0.0f, 1.0f), g = std::clamp(p[1], 0.0f, 1.0f), b = std::clamp(p[2], 0.0f, 1.0f);
+			outLuma[x] = 0.299f * r + 0.587f * g + 0.114f * b - 0.5f;
+		}
+	}
+}
+
+float computeSSIM(const MetricImage& reference, const MetricImage& test, ThreadPool* threadPool, std::vector<float>* outSSIMMap)
+{
+	checkComparable(reference, test);
+	const uint32 width = reference.width;
+	const uint32 height = reference.height;
+	if (outSSIMMap != nullptr)
+	{
+		outSSIMMap->resize(uint64(width) * height);
+	}
+
+	constexpr int32 margin = 5;
+	std::vector<float> gaussian(2 * margin + 1);
+	for (int32 i = -margin; i <= margin; ++i)
+	{
+		gaussian[i + margin] = std::exp(-(float)(i * i) / (2.0f * 1.5f * 1.5f));
+	}
+	const SeparableKernel window = normalizeKernel(margin, std::move(gaussian));
+
+	// Pixel values are in [0, 1], so the dynamic range L is 1.
+	const __m128 C1 = _mm_set1_ps(0.01f * 0.01f);
+	const __m128 C2 = _mm_set1_ps(0.03f * 0.03f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	std::vector<double> rowSums(height);
+	auto processRows = [&](uint32 chunkIx, uint32 begin, uint32 end)
+	{
+		// Horizontally filtered x, y, x^2, y^2 and xy.
+		constexpr uint32 numPlanes = 5;
+		FilteredRowRing ring(numPlanes, width, margin);
+
+		const uint32 paddedWidth = width + 2 * margin;
+		std::vector<float> padded(numPlanes * paddedWidth);
+		float* paddedRows[numPlanes];
+		for (uint32 q = 0; q < numPlanes; ++q) paddedRows[q] = padded.data() + q * paddedWidth;
+
+		auto filterSourceRow = [&](int64 y)
+		{
+			const uint32 sy = clampRow(y, height);
+			decodeRowLuma(reference, sy, paddedRows[0] + margin);
+			decodeRowLuma(test, sy, paddedRows[1] + margin);
+			for (uint32 x = margin; x < width + margin; ++x)
+			{
+				const float a = paddedRows[0][x], b = paddedRows[1][x];
+				paddedRows[2][x] = a * a;
+				paddedRows[3][x] = b * b;
+				paddedRows[4][x] = a * b;
+			}
+			for (uint32 q = 0; q < numPlanes; ++q)
+			{
+				padRow(paddedRows[q], width, margin);
+				convolveRow(paddedRows[q], margin, width, window, ring.getRow(q, y));
+			}
+		};
+		for (int64 y = (int64)begin - margin; y < (int64)begin + margin; ++y)
+		{
+			filterSourceRow(y);
+		}
+
+		const uint32 roundedWidth = roundUpTo4(width);
+		std::vector<float> filtered(numPlanes * roundedWidth, 0.0f);
+		std::vector<float> ssimRow(roundedWidth);
+		std::vector<const float*> column(2 * margin + 1);
+		for (uint32 y = begin; y < end; ++y)
+		{
+			filterSourceRow((int64)y + margin);
+			for (uint32 q = 0; q < numPlanes; ++q)
+			{
+				ring.getColumn(q, y, margin, column.data());
+				convolveColumns(column.data(), width, window, filtered.data() + q * roundedWidth);
+			}
+			// Lanes past the width are zeros and not summed.
+			for (uint32 x = 0; x < roundedWidth; x += 4)
+			{
+				const __m128 centeredX = _mm_loadu_ps(filtered.data() + 0 * roundedWidth + x);
+				const __m128 centeredY = _mm_loadu_ps(filtered.data() + 1 * roundedWidth + x);
+				const __m128 varX = _mm_sub_ps(_mm_loadu_ps(filtered.data() + 2 * roundedWidth + x), _mm_mul_ps(centeredX, centeredX));
+				const __m128 varY = _mm_sub_ps(_mm_loadu_ps(filtered.data() + 3 * roundedWidth + x), _mm_mul_ps(centeredY, centeredY));
+				const __m128 covXY = _mm_sub_ps(_mm_loadu_ps(filtered.data() + 4 * roundedWidth + x), _mm_mul_ps(centeredX, centeredY));
+
+				const __m128 muX  = _mm_add_ps(centeredX, half);
+				const __m128 muY  = _mm_add_ps(centeredY, half);
+				const __m128 muXX = _mm_mul_ps(muX, muX);
+				const __m128 muYY = _mm_mul_ps(muY, muY);
+				const __m128 muXY = _mm_mul_ps(muX, muY);
+
+				const __m128 numerator = _mm_mul_ps(
+					_mm_add_ps(_mm_mul_ps(two, muXY), C1),
+					_mm_add_ps(_mm_mul_ps(two, covXY), C2));
+				const __m128 denominator = _mm_mul_ps(
+					_mm_add_ps(_mm_add_ps(muXX, muYY), C1),
+					_mm_add_ps(_mm_add_ps(varX, varY), C2));
+				_mm_storeu_ps(ssimRow.data() + x, _mm_div_ps(numerator, denominator));
+			}
+
+			double rowSum = 0.0;
+			for (uint32 x = 0; x < width; ++x) rowSum += ssimRow[x];
+			rowSums[y] = rowSum;
+			if (outSSIMMap != nullptr)
+			{
+				std::copy(ssimRow.begin(), ssimRow.begin() + width, outSSIMMap->begin() + uint64(y) * width);
+			}
+		}
+	};
+	parallelForRows(threadPool, height, getBandRows(threadPool, height), processRows);
+
+	double sum = 0.0;
+	for (double rowSum : rowSums) sum += rowSum;
+	return (float)(sum / ((double)width * height));
+}
+
+// ------------------------------------------------
+// FLIP
+
+// sRGB primaries with D65 white.
+static const float kLinearRGBToXYZ[3][3] = {
+	{ 0.4124564f, 0.3575761f, 0.1804375f },
+	{ 0.2126729f, 0.7151522f, 0.0721750f },
+	{ 0.0193339f, 0.1191920f, 0.9503041f },
+};
+static const float kXYZToLinearRGB[3][3] = {
+	{  3.2404542f, -1.5371385f, -0.4985314f },
+	{ -0.9692660f,  1.8760108f,  0.0415560f },
+	{  0.0556434f, -0.2040259f,  1.0572252f },
+};
+
+// Contrast sensitivity of each YCxCz channel as (a1, b1, a2, b2) of a1 * sqrt(pi / b1) * exp(-pi^2 x^2 / b1) + (same for a2, b2),
+// with x in degrees.
+static const float kCSFParams[3][4] = {
+	{  1.0f, 0.0047f,  0.0f, 1e-5f },
+	{  1.0f, 0.0053f,  0.0f, 1e-5f },
+	{ 34.1f, 0.04f,   13.5f, 0.025f },
+};
+
+constexpr float kFLIPColorExponent   = 0.7f;   // qc
+constexpr float kFLIPFeatureExponent = 0.5f;   // qf
+constexpr float kFLIPColorCutoff     = 0.4f;   // pc
+constexpr float kFLIPColorThreshold  = 0.95f;  // pt
+constexpr float kFLIPFeatureWidth    = 0.082f; // gw, in degrees
+
+struct FLIPFilters
+{
+	// CSF of Y, Cx, and the two Gaussians of Cz.
+	SeparableKernel csf[4];
+	float           czWeights[2];
+	// Feature detection on normalized luminance. 2D kernels are (edge x gaussian) and (point x gaussian),
+	// and their transposes.
+	SeparableKernel gaussian;
+	SeparableKernel edge;
+	SeparableKernel point;
+	int32           margin;
+};
+
+static FLIPFilters createFLIPFilters(float pixelsPerDegree)
+{
+	FLIPFilters filters;
+
+	const float maxB = kCSFParams[2][1];
+	const int32 csfRadius = (int32)std::ceil(3.0f * std::sqrt(maxB / (2.0f * Cymath::PI * Cymath::PI)) * pixelsPerDegree);
+	auto makeCSFGaussian = [&](float b, float& outSum)
+	{
+		std::vector<float> weights(2 * csfRadius + 1);
+		outSum = 0.0f;
+		for (int32 i = -csfRadius; i <= csfRadius; ++i)
+		{
+			const float x = i / pixelsPerDegree;
+			weights[i + csfRadius] = std::exp(-Cymath::PI * Cymath::PI * x * x / b);
+			outSum += weights[i + csfRadius];
+		}
+		// The radius fits the widest Gaussian. Narrower ones drop taps that are below float precision.
+		int32 radius = csfRadius;
+		while (radius > 0 && weights[csfRadius + radius] < 1e-7f * outSum)
+		{
+			--radius;
+		}
+		return normalizeKernel(radius, std::vector<float>(weights.begin() + (csfRadius - radius), weights.end() - (csfRadius - radius)));
+	};
+
+	float sum1, sum2;
+	filters.csf[0] = makeCSFGaussian(kCSFParams[0][1], sum1);
+	filters.csf[1] = makeCSFGaussian(kCSFParams[1][1], sum1);
+	filters.csf[2] = makeCSFGaussian(kCSFParams[2][1], sum1);
+	filters.csf[3] = makeCSFGaussian(kCSFParams[2][3], sum2);
+	// The 2D kernel of Cz is a sum of two separable Gaussians. Weigh them by their 2D sums before normalization.
+	const float total1 = kCSFParams[2][0] * std::sqrt(Cymath::PI / kCSFParams[2][1]) * sum1 * sum1;
+	const float total2 = kCSFParams[2][2] * std::sqrt(Cymath::PI / kCSFParams[2][3]) * sum2 * sum2;
+	filters.czWeights[0] = total1 / (total1 + total2);
+	filters.czWeights[1] = total2 / (total1 + total2);
+
+	const float sigma = 0.5f * kFLIPFeatureWidth * pixelsPerDegree;
+	const int32 featureRadius = (int32)std::ceil(3.0f * sigma);
+	std::vector<float> gaussian(2 * featureRadius + 1), edge(2 * featureRadius + 1), point(2 * featureRadius + 1);
+	for (int32 i = -featureRadius; i <= featureRadius; ++i)
+	{
+		const float x = (float)i;
+		const float g = std::exp(-x * x / (2.0f * sigma * sigma));
+		gaussian[i + featureRadius] = g;
+		edge[i + featureRadius] = -x * g;
+		point[i + featureRadius] = (x * x / (sigma * sigma) - 1.0f) * g;
+	}
+	// Positive and negative weights of the 2D edge and point kernels sum to 1 and -1, respectively.
+	auto normalizeSigned = [](std::vector<float>& weights)
+	{
+		float positiveSum = 0.0f, negativeSum = 0.0f;
+		for (float w : weights) (w > 0.0f ? positiveSum : negativeSum) += w;
+		for (float& w : weights) w /= (w > 0.0f) ? positiveSum : -negativeSum;
+	};
+	normalizeSigned(edge);
+	normalizeSigned(point);
+	filters.gaussian = normalizeKernel(featureRadius, std::move(gaussian));
+	filters.edge = SeparableKernel{ featureRadius, std::move(edge) };
+	filters.point = SeparableKernel{ featureRadius, std::move(point) };
+
+	filters.margin = std::max(csfRadius, featureRadius);
+	return filters;
+}
+
+static const float* getSRGBToLinearTable()
+{
+	static const std::vector<float> table = []()
+	{
+		std::vector<float> values(256);
+		for (uint32 i = 0; i < 256; ++i)
+		{
+			const float c = i / 255.0f;
+			values[i] = (c <= 0.04045f) ? (c / 12.92f) : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return values;
+	}();
+	return table.data();
+}
+
+// Decodes a row to YCxCz and normalized luminance, at [margin, margin + width) of padded rows.
+// r, g, b are scratch rows of roundUpTo4(width).
+static void decodeRowYCxCz(
+	const MetricImage& image, uint32 y, float* r, float* g, float* b, const float whiteXYZ[3],
+	float* outY, float* outCx, float* outCz, float* outLuminance)
+{
+	const uint32 width = image.width;
+	const uint8* row = getRow(image, y);
+	if (image.format == EMetricPixelFormat::RGBA8)
+	{
+		const float* table = getSRGBToLinearTable();
+		for (uint32 x = 0; x < width; ++x)
+		{
+			r[x] = table[row[4 * x + 0]];
+			g[x] = table[row[4 * x + 1]];
+			b[x] = table[row[4 * x + 2]];
+		}
+	}
+	else
+	{
+		const float* src = reinterpret_cast<const float*>(row);
+		for (uint32 x = 0; x < width; ++x)
+		{
+			r[x] = src[4 * x + 0];
+			g[x] = src[4 * x + 1];
+			b[x] = src[4 * x + 2];
+		}
+		const __m128 threshold = _mm_set1_ps(0.04045f);
+		const __m128 gamma = _mm_set1_ps(2.4f);
+		for (float* channel : { r, g, b })
+		{
+			for (uint32 x = 0; x < width; x += 4)
+			{
+				const __m128 c = clamp01_ps(_mm_loadu_ps(channel + x));
+				const __m128 linear = _mm_mul_ps(c, _mm_set1_ps(1.0f / 12.92f));
+				const __m128 curve = powPositive_ps(_mm_mul_ps(_mm_add_ps(c, _mm_set1_ps(0.055f)), _mm_set1_ps(1.0f / 1.055f)), gamma);
+				_mm_storeu_ps(channel + x, select_ps(_mm_cmple_ps(c, threshold), linear, curve));
+			}
+		}
+	}
+
+	for (uint32 x = 0; x < width; ++x)
+	{
+		const float X = (kLinearRGBToXYZ[0][0] * r[x] + kLinearRGBToXYZ[0][1] * g[x] + kLinearRGBToXYZ[0][2] * b[x]) / whiteXYZ[0];
+		const float Y = (kLinearRGBToXYZ[1][0] * r[x] + kLinearRGBToXYZ[1][1] * g[x] + kLinearRGBToXYZ[1][2] * b[x]) / whiteXYZ[1];
+		const float Z = (kLinearRGBToXYZ[2][0] * r[x] + kLinearRGBToXYZ[2][1] * g[x] + kLinearRGBToXYZ[2][2] * b[x]) / whiteXYZ[2];
+		outY[x] = 116.0f * Y - 16.0f;
+		outCx[x] = 500.0f * (X - Y);
+		outCz[x] = 200.0f * (Y - Z);
+		outLuminance[x] = Y;
+	}
+}
+
+struct HuntLab4
+{
+	__m128 L, a, b;
+};
+
+static inline __m128 labCurve_ps(__m128 t)
+{
+	constexpr float delta = 6.0f / 29.0f;
+	const __m128 cubeRoot = powPositive_ps(t, _mm_set1_ps(1.0f / 3.0f));
+	const __m128 linear = _mm_add_ps(_mm_mul_ps(t, _mm_set1_ps(1.0f / (3.0f * delta * delta))), _mm_set1_ps(4.0f / 29.0f));
+	return select_ps(_mm_cmpgt_ps(t, _mm_set1_ps(delta * delta * delta)), cubeRoot, linear);
+}
+
+// CIELAB from the curves of normalized X, Y, Z, with a and b scaled by 0.01 L (Hunt effect).
+static inline HuntLab4 labCurvesToHuntLab(__m128 fx, __m128 fy, __m128 fz)
+{
+	HuntLab4 lab;
+	lab.L = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(116.0f), fy), _mm_set1_ps(16.0f));
+	const __m128 hunt = _mm_mul_ps(_mm_set1_ps(0.01f), lab.L);
+	lab.a = _mm_mul_ps(hunt, _mm_mul_ps(_mm_set1_ps(500.0f), _mm_sub_ps(fx, fy)));
+	lab.b = _mm_mul_ps(hunt, _mm_mul_ps(_mm_set1_ps(200.0f), _mm_sub_ps(fy, fz)));
+	return lab;
+}
+
+static inline __m128 linearRGBToNormalizedXYZ(uint32 i, __m128 r, __m128 g, __m128 b, const float whiteXYZ[3])
+{
+	const __m128 value = _mm_add_ps(
+		_mm_add_ps(_mm_mul_ps(_mm_set1_ps(kLinearRGBToXYZ[i][0]), r), _mm_mul_ps(_mm_set1_ps(kLinearRGBToXYZ[i][1]), g)),
+		_mm_mul_ps(_mm_set1_ps(kLinearRGBToXYZ[i][2]), b));
+	return _mm_mul_ps(value, _mm_set1_ps(1.0f / whiteXYZ[i]));
+}
+
+static inline HuntLab4 linearRGBToHuntLab(__m128 r, __m128 g, __m128 b, const float whiteXYZ[3])
+{
+	return labCurvesToHuntLab(
+		labCurve_ps(linearRGBToNormalizedXYZ(0, r, g, b, whiteXYZ)),
+		labCurve_ps(linearRGBToNormalizedXYZ(1, r, g, b, whiteXYZ)),
+		labCurve_ps(linearRGBToNormalizedXYZ(2, r, g, b, whiteXYZ)));
+}
+
+static inline __m128 calcHyAB(const HuntLab4& x, const HuntLab4& y)
+{
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 da = _mm_sub_ps(x.a, y.a);
+	const __m128 db = _mm_sub_ps(x.b, y.b);
+	return _mm_add_ps(
+		_mm_and_ps(_mm_sub_ps(x.L, y.L), absMask),
+		_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(da, da), _mm_mul_ps(db, db))));
+}
+
+// Per-pixel steps below run over whole rows, one step at a time. Loop bodies stay short,
+// so that the CPU overlaps iterations instead of stalling on the long chains of pow().
+// Rows are padded to a multiple of 4.
+
+// In place, from filtered Y, Cx, Cz to the Hunt adjusted CIELAB of the color clamped to the RGB gamut.
+static void filteredYCxCzToHuntLabRows(float* rowY, float* rowCx, float* rowCz, uint32 count, const float whiteXYZ[3])
+{
+	for (uint32 x = 0; x < count; x += 4)
+	{
+		const __m128 normY = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(rowY + x), _mm_set1_ps(16.0f)), _mm_set1_ps(1.0f / 116.0f));
+		const __m128 xyz[3] = {
+			_mm_mul_ps(_mm_add_ps(normY, _mm_mul_ps(_mm_loadu_ps(rowCx + x), _mm_set1_ps(1.0f / 500.0f))), _mm_set1_ps(whiteXYZ[0])),
+			_mm_mul_ps(normY, _mm_set1_ps(whiteXYZ[1])),
+			_mm_mul_ps(_mm_sub_ps(normY, _mm_mul_ps(_mm_loadu_ps(rowCz + x), _mm_set1_ps(1.0f / 200.0f))), _mm_set1_ps(whiteXYZ[2])),
+		};
+		__m128 rgb[3];
+		for (uint32 i = 0; i < 3; ++i)
+		{
+			rgb[i] = clamp01_ps(_mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(kXYZToLinearRGB[i][0]), xyz[0]), _mm_mul_ps(_mm_set1_ps(kXYZToLinearRGB[i][1]), xyz[1])),
+				_mm_mul_ps(_mm_set1_ps(kXYZToLinearRGB[i][2]), xyz[2])));
+		}
+		_mm_storeu_ps(rowCx + x, linearRGBToNormalizedXYZ(0, rgb[0], rgb[1], rgb[2], whiteXYZ));
+		_mm_storeu_ps(rowY + x, linearRGBToNormalizedXYZ(1, rgb[0], rgb[1], rgb[2], whiteXYZ));
+		_mm_storeu_ps(rowCz + x, linearRGBToNormalizedXYZ(2, rgb[0], rgb[1], rgb[2], whiteXYZ));
+	}
+	for (float* row : { rowCx, rowY, rowCz })
+	{
+		for (uint32 x = 0; x < count; x += 4)
+		{
+			_mm_storeu_ps(row + x, labCurve_ps(_mm_loadu_ps(row + x)));
+		}
+	}
+	for (uint32 x = 0; x < count; x += 4)
+	{
+		const HuntLab4 lab = labCurvesToHuntLab(_mm_loadu_ps(rowCx + x), _mm_loadu_ps(rowY + x), _mm_loadu_ps(rowCz + x));
+		_mm_storeu_ps(rowY + x, lab.L);
+		_mm_storeu_ps(rowCx + x, lab.a);
+		_mm_storeu_ps(rowCz + x, lab.b);
+	}
+}
+
+float computeFLIP(const MetricImage& reference, const MetricImage& test, const FLIPParams& params, ThreadPool* threadPool, std::vector<float>* outErrorMap)
+{
+	checkComparable(reference, test);
+	CHECK(params.pixelsPerDegree > 0.0f);
+	const uint32 width = reference.width;
+	const uint32 height = reference.height;
+	if (outErrorMap != nullptr)
+	{
+		outErrorMap->resize(uint64(width) * height);
+	}
+
+	const FLIPFilters filters = createFLIPFilters(params.pixelsPerDegree);
+	const int32 margin = filters.margin;
+
+	float whiteXYZ[3];
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		whiteXYZ[i] = kLinearRGBToXYZ[i][0] + kLinearRGBToXYZ[i][1] + kLinearRGBToXYZ[i][2];
+	}
+
+	// Largest color difference, between green and blue.
+	alignas(16) float maxColorDifference[4];
+	{
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+		const __m128 hyab = calcHyAB(linearRGBToHuntLab(zero, one, zero, whiteXYZ), linearRGBToHuntLab(zero, zero, one, whiteXYZ));
+		_mm_store_ps(maxColorDifference, powPositive_ps(hyab, _mm_set1_ps(kFLIPColorExponent)));
+	}
+	const float cmax = maxColorDifference[0];
+	const float cutoff = kFLIPColorCutoff * cmax;
+	const __m128 cutoffV = _mm_set1_ps(cutoff);
+	const __m128 lowScale = _mm_set1_ps(kFLIPColorThreshold / cutoff);
+	const __m128 highScale = _mm_set1_ps((1.0f - kFLIPColorThreshold) / (cmax - cutoff));
+	const __m128 thresholdV = _mm_set1_ps(kFLIPColorThreshold);
+	const __m128 colorExponent = _mm_set1_ps(kFLIPColorExponent);
+	const __m128 invSqrt2 = _mm_set1_ps(0.70710678f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+	std::vector<double> rowSums(height);
+	auto processRows = [&](uint32 chunkIx, uint32 begin, uint32 end)
+	{
+		// Horizontal passes of each image: Y, Cx, Cz (two Gaussians), and luminance with gaussian, edge and point.
+		enum { H_Y, H_Cx, H_Cz1, H_Cz2, H_Gaussian, H_Edge, H_Point, NumHPlanes };
+		// Vertical passes of each image, as the final filtered values.
+		enum { V_Y, V_Cx, V_Cz, V_EdgeX, V_EdgeY, V_PointX, V_PointY, NumVRows };
+
+		FilteredRowRing ring(2 * NumHPlanes, width, margin);
+
+		const uint32 roundedWidth = roundUpTo4(width);
+		const uint32 paddedWidth = roundedWidth + 2 * margin;
+		std::vector<float> scratch(3 * roundedWidth + 4 * paddedWidth);
+		float* r = scratch.data();
+		float* g = r + roundedWidth;
+		float* b = g + roundedWidth;
+		float* paddedY = b + roundedWidth;
+		float* paddedCx = paddedY + paddedWidth;
+		float* paddedCz = paddedCx + paddedWidth;
+		float* paddedLuminance = paddedCz + paddedWidth;
+
+		auto filterSourceRow = [&](int64 y)
+		{
+			const uint32 sy = clampRow(y, height);
+			for (uint32 image = 0; image < 2; ++image)
+			{
+				const MetricImage& source = (image == 0) ? reference : test;
+				decodeRowYCxCz(source, sy, r, g, b, whiteXYZ, paddedY + margin, paddedCx + margin, paddedCz + margin, paddedLuminance + margin);
+				for (float* padded : { paddedY, paddedCx, paddedCz, paddedLuminance })
+				{
+					padRow(padded, width, margin);
+				}
+				const uint32 firstPlane = image * NumHPlanes;
+				convolveRow(paddedY, margin, width, filters.csf[0], ring.getRow(firstPlane + H_Y, y));
+				convolveRow(paddedCx, margin, width, filters.csf[1], ring.getRow(firstPlane + H_Cx, y));
+				convolveRow(paddedCz, margin, width, filters.csf[2], ring.getRow(firstPlane + H_Cz1, y));
+				convolveRow(paddedCz, margin, width, filters.csf[3], ring.getRow(firstPlane + H_Cz2, y));
+				convolveRow(paddedLuminance, margin, width, filters.gaussian, ring.getRow(firstPlane + H_Gaussian, y));
+				convolveRow(paddedLuminance, margin, width, filters.edge, ring.getRow(firstPlane + H_Edge, y));
+				convolveRow(paddedLuminance, margin, width, filters.point, ring.getRow(firstPlane + H_Point, y));
+			}
+		};
+		for (int64 y = (int64)begin - margin; y < (int64)begin + margin; ++y)
+		{
+			filterSourceRow(y);
+		}
+
+		// Lanes past the width stay zero, so that the SIMD loop below covers whole rows.
+		std::vector<float> filtered(2 * NumVRows * roundedWidth, 0.0f);
+		std::vector<float> flipRow(roundedWidth);
+		auto getFiltered = [&](uint32 image, uint32 row) { return filtered.data() + (image * NumVRows + row) * roundedWidth; };
+
+		std::vector<const float*> column(2 * margin + 1);
+		for (uint32 y = begin; y < end; ++y)
+		{
+			filterSourceRow((int64)y + margin);
+			for (uint32 image = 0; image < 2; ++image)
+			{
+				auto verticalPass = [&](uint32 plane, const SeparableKernel& kernel, float* dst)
+				{
+					ring.getColumn(image * NumHPlanes + plane, y, kernel.radius, column.data());
+					convolveColumns(column.data(), width, kernel, dst);
+				};
+				verticalPass(H_Y, filters.csf[0], getFiltered(image, V_Y));
+				verticalPass(H_Cx, filters.csf[1], getFiltered(image, V_Cx));
+				verticalPass(H_Cz1, filters.csf[2], getFiltered(image, V_Cz));
+				verticalPass(H_Cz2, filters.csf[3], flipRow.data());
+				float* cz = getFiltered(image, V_Cz);
+				for (uint32 x = 0; x < width; ++x)
+				{
+					cz[x] = filters.czWeights[0] * cz[x] + filters.czWeights[1] * flipRow[x];
+				}
+				verticalPass(H_Edge, filters.gaussian, getFiltered(image, V_EdgeX));
+				verticalPass(H_Gaussian, filters.edge, getFiltered(image, V_EdgeY));
+				verticalPass(H_Point, filters.gaussian, getFiltered(image, V_PointX));
+				verticalPass(H_Gaussian, filters.point, getFiltered(image, V_PointY));
+			}
+
+			// Color difference, remapped so that differences up to the cutoff get most of the range.
+			for (uint32 image = 0; image < 2; ++image)
+			{
+				filteredYCxCzToHuntLabRows(getFiltered(image, V_Y), getFiltered(image, V_Cx), getFiltered(image, V_Cz), roundedWidth, whiteXYZ);
+			}
+			for (uint32 x = 0; x < roundedWidth; x += 4)
+			{
+				HuntLab4 lab[2];
+				for (uint32 image = 0; image < 2; ++image)
+				{
+					lab[image] = HuntLab4{ _mm_loadu_ps(getFiltered(image, V_Y) + x), _mm_loadu_ps(getFiltered(image, V_Cx) + x), _mm_loadu_ps(getFiltered(image, V_Cz) + x) };
+				}
+				_mm_storeu_ps(flipRow.data() + x, powPositive_ps(calcHyAB(lab[0], lab[1]), colorExponent));
+			}
+			for (uint32 x = 0; x < roundedWidth; x += 4)
+			{
+				const __m128 colorDiff = _mm_loadu_ps(flipRow.data() + x);
+				const __m128 low = _mm_mul_ps(colorDiff, lowScale);
+				const __m128 high = _mm_add_ps(thresholdV, _mm_mul_ps(_mm_sub_ps(colorDiff, cutoffV), highScale));
+				_mm_storeu_ps(flipRow.data() + x, _mm_min_ps(select_ps(_mm_cmplt_ps(colorDiff, cutoffV), low, high), one));
+			}
+
+			// Feature difference, (max of edge and point differences / sqrt(2)) ^ qf with qf = 0.5,
+			// then FLIP = colorError ^ (1 - featureError).
+			float* featureRow = getFiltered(0, V_EdgeX);
+			for (uint32 x = 0; x < roundedWidth; x += 4)
+			{
+				__m128 edgeMagnitude[2], pointMagnitude[2];
+				for (uint32 image = 0; image < 2; ++image)
+				{
+					const __m128 ex = _mm_loadu_ps(getFiltered(image, V_EdgeX) + x), ey = _mm_loadu_ps(getFiltered(image, V_EdgeY) + x);
+					const __m128 px = _mm_loadu_ps(getFiltered(image, V_PointX) + x), py = _mm_loadu_ps(getFiltered(image, V_PointY) + x);
+					edgeMagnitude[image] = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)));
+					pointMagnitude[image] = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)));
+				}
+				const __m128 edgeDiff = _mm_and_ps(_mm_sub_ps(edgeMagnitude[0], edgeMagnitude[1]), absMask);
+				const __m128 pointDiff = _mm_and_ps(_mm_sub_ps(pointMagnitude[0], pointMagnitude[1]), absMask);
+				_mm_storeu_ps(featureRow + x, _mm_sqrt_ps(_mm_min_ps(_mm_mul_ps(_mm_max_ps(edgeDiff, pointDiff), invSqrt2), one)));
+			}
+			for (uint32 x = 0; x < roundedWidth; x += 4)
+			{
+				const __m128 exponent = _mm_sub_ps(one, _mm_loadu_ps(featureRow + x));
+				_mm_storeu_ps(flipRow.data() + x, powPositive_ps(_mm_loadu_ps(flipRow.data() + x), exponent));
+			}
+
+			double rowSum = 0.0;
+			for (uint32 x = 0; x < width; ++x) rowSum += flipRow[x];
+			rowSums[y] = rowSum;
+			if (outErrorMap != nullptr)
+			{
+				std::copy(flipRow.begin(), flipRow.begin() + width, outErrorMap->begin() + uint64(y) * width);
+			}
+		}
+	};
+	parallelForRows(threadPool, height, getBandRows(threadPool, height), processRows);
+
+	double sum = 0.0;
+	for (double rowSum : rowSums) sum += rowSum;
+	return (float)(sum / ((double)width * height));
+}
+
+// ------------------------------------------------
+// Heatmap
+
+// Magma at 9 evenly spaced points.
+static const uint8 kMagma[9][3] = {
+	{   0,   0,   4 },
+	{  28,  16,  68 },
+	{  79,  18, 123 },
+	{ 129,  37, 129 },
+	{ 181,  54, 122 },
+	{ 229,  80, 100 },
+	{ 251, 135,  97 },
+	{ 254, 194, 135 },
+	{ 252, 253, 191 },
+};
+
+void generateHeatmap(const float* values, uint32 width, uint32 height, float maxValue, std::vector<uint8>& outRgba8, ThreadPool* threadPool)
+{
+	CHECK(values != nullptr && maxValue > 0.0f);
+	outRgba8.resize(4 * uint64(width) * height);
+	const float scale = 8.0f / maxValue;
+
+	auto processRows = [&](uint32 chunkIx, uint32 begin, uint32 end)
+	{
+		for (uint64 i = uint64(begin) * width; i < uint64(end) * width; ++i)
+		{
+			// NaN maps to the start of the color map.
+			const float scaled = values[i] * scale;
+			const float t = (scaled > 0.0f) ? std::min(scaled, 8.0f) : 0.0f;
+			const uint32 ix = std::min((uint32)t, 7u);
+			const float frac = t - ix;
+			for (uint32 c = 0; c < 3; ++c)
+			{
+				const float color = kMagma[ix][c] + frac * ((float)kMagma[ix + 1][c] - (float)kMagma[ix][c]);
+				outRgba8[4 * i + c] = (uint8)(color + 0.5f);
+			}
+			outRgba8[4 * i + 3] = 255;
+		}
+	};
+	parallelForRows(threadPool, height, IMAGE_METRICS_GRAIN_ROWS, processRows);
+}
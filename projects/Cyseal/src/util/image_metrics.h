@@ -0,0 +1,94 @@
+#pragma once
+
+#include "core/int_types.h"
+#include "core/vec3.h"
+
+#include <vector>
+
+class ThreadPool;
+
+// Image comparison metrics on raw CPU buffers, e.g., render test output against reference images.
+// Nothing here depends on the RHI.
+//
+// Pixel values are display-referred (sRGB encoded) and in [0, 1].
+// rgba8 is divided by 255 and rgba32f is clamped, same as the conversion render tests do before saving.
+// Alpha is ignored by all metrics.
+//
+// All functions are SIMD (SSE2) and split rows across the thread pool if one is given.
+// Results do not depend on the number of threads.
+
+enum class EMetricPixelFormat : uint8
+{
+	RGBA8,
+	RGBA32F,
+};
+
+struct MetricImage
+{
+	const void*        data     = nullptr;
+	uint32             width    = 0;
+	uint32             height   = 0;
+	uint64             rowPitch = 0; // In bytes
+	EMetricPixelFormat format   = EMetricPixelFormat::RGBA8;
+
+	// @param rowPitch  0 means tightly packed.
+	static MetricImage rgba8(const uint8* data, uint32 width, uint32 height, uint64 rowPitch = 0);
+	static MetricImage rgba32f(const float* data, uint32 width, uint32 height, uint64 rowPitch = 0);
+};
+
+struct ImageErrorStats
+{
+	vec3   mse                = vec3(0.0f); // Per channel
+	float  mseAverage         = 0.0f;       // Over RGB
+	vec3   psnr               = vec3(0.0f); // In dB. Infinity if the channel has no error.
+	float  psnrAverage        = 0.0f;       // From mseAverage
+	float  maxAbsError        = 0.0f;       // Over RGB
+	uint32 numDifferentPixels = 0;          // Pixels that differ in any of RGB
+};
+
+// 10 * log10(1 / mse). Infinity if mse is 0.
+float calcPSNR(float mse);
+
+// Mean squared error and PSNR of each channel.
+// rgba8 vs rgba8 is exact as it accumulates integers.
+// @param outErrorMap  If not null, receives the squared error of each pixel, averaged over RGB.
+ImageErrorStats computeMSE(
+	const MetricImage& reference,
+	const MetricImage& test,
+	ThreadPool* threadPool = nullptr,
+	std::vector<float>* outErrorMap = nullptr);
+
+// Mean SSIM (Wang et al. 2004) of luma, with an 11x11 Gaussian window of sigma 1.5.
+// Borders are clamped, so the SSIM map is as large as the images.
+// @param outSSIMMap  If not null, receives SSIM of each pixel, in [-1, 1].
+float computeSSIM(
+	const MetricImage& reference,
+	const MetricImage& test,
+	ThreadPool* threadPool = nullptr,
+	std::vector<float>* outSSIMMap = nullptr);
+
+struct FLIPParams
+{
+	// Observer distance and display density. 67 is a 0.7 m wide 4K monitor at 0.7 m.
+	float pixelsPerDegree = 67.0f;
+};
+
+// Mean of LDR-FLIP (Andersson et al. 2020): contrast sensitivity filtering in YCxCz, Hunt adjusted HyAB
+// color difference, and edge and point feature differences. 0 means identical and 1 is the largest error.
+// @param outErrorMap  If not null, receives FLIP of each pixel, in [0, 1].
+float computeFLIP(
+	const MetricImage& reference,
+	const MetricImage& test,
+	const FLIPParams& params = FLIPParams{},
+	ThreadPool* threadPool = nullptr,
+	std::vector<float>* outErrorMap = nullptr);
+
+// Maps (value / maxValue) to the magma color map, for saving error maps of failed tests.
+// @param outRgba8  Resized to 4 * width * height. Alpha is 255.
+void generateHeatmap(
+	const float* values,
+	uint32 width,
+	uint32 height,
+	float maxValue,
+	std::vector<uint8>& outRgba8,
+	ThreadPool* threadPool = nullptr);
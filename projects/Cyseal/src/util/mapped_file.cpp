@@ -0,0 +1,96 @@
+#include "mapped_file.h"
+
+#if PLATFORM_WINDOWS
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <filesystem>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::wstring& path)
+{
+	close();
+
+#if PLATFORM_WINDOWS
+	HANDLE hFile = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0)
+	{
+		::CloseHandle(hFile);
+		return false;
+	}
+	HANDLE hMapping = ::CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (hMapping == NULL)
+	{
+		::CloseHandle(hFile);
+		return false;
+	}
+	void* view = ::MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		::CloseHandle(hMapping);
+		::CloseHandle(hFile);
+		return false;
+	}
+	fileHandle = hFile;
+	mappingHandle = hMapping;
+	data = reinterpret_cast<const uint8*>(view);
+	size = (uint64)fileSize.QuadPart;
+#else
+	const std::string narrowPath = std::filesystem::path(path).string();
+	int fd = ::open(narrowPath.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat fileStat;
+	if (::fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+	void* view = ::mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED)
+	{
+		::close(fd);
+		return false;
+	}
+	fileDescriptor = fd;
+	data = reinterpret_cast<const uint8*>(view);
+	size = (uint64)fileStat.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data == nullptr)
+	{
+		return;
+	}
+#if PLATFORM_WINDOWS
+	::UnmapViewOfFile(data);
+	::CloseHandle((HANDLE)mappingHandle);
+	::CloseHandle((HANDLE)fileHandle);
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+#else
+	::munmap(const_cast<uint8*>(data), (size_t)size);
+	::close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
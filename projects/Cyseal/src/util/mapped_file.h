@@ -0,0 +1,35 @@
+#pragma once
+
+#include "core/int_types.h"
+#include "core/platform.h"
+#include <string>
+
+// Read-only memory mapping of a whole file.
+// Pages are loaded by the OS on first access, so opening is cheap even for large files.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// @return false if the file does not exist or can't be mapped. Empty files can't be mapped.
+	bool open(const std::wstring& path);
+	void close();
+
+	inline bool isOpen() const { return data != nullptr; }
+	inline const uint8* getData() const { return data; }
+	inline uint64 getSize() const { return size; }
+
+private:
+#if PLATFORM_WINDOWS
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int32 fileDescriptor = -1;
+#endif
+	const uint8* data = nullptr;
+	uint64 size = 0;
+};
@@ -4,6 +4,9 @@
 #include "rhi/gpu_resource.h"
 #include "rhi/buffer.h"
 #include "rhi/texture.h"
+#include "rhi/upload_batcher.h"
+
+#include <atomic>
 
 // Application-side view of GPU resources.
 
@@ -21,10 +24,36 @@ public:
 	}
 
 	inline SharedPtr<T> getGPUResource() const { return rhi; }
+	// Doesn't touch the reference count, which is contended if many threads read the same asset.
+	inline T* getRawGPUResource() const { return rhi.get(); }
 	inline void setGPUResource(SharedPtr<T> inRHI) { rhi = inRHI; }
 
+	// Last upload of the resource's data through gUploadBatcher. Its content is undefined until then,
+	// so bindings should use a fallback resource instead. Set before setGPUResource() on the render thread,
+	// so the game thread never sees a resource without its token.
+	inline void setUploadToken(UploadToken token) { uploadToken.store(token, std::memory_order_release); }
+	inline bool isUploadComplete() const
+	{
+		const UploadToken token = uploadToken.load(std::memory_order_acquire);
+		return token == UPLOAD_TOKEN_NONE || gUploadBatcher->isComplete(token);
+	}
+
+	// Textures only. Finest mip that shaders should sample, e.g., while finer mips of a streamed texture are not uploaded.
+	// Bindings apply it as the min LOD clamp of SRVs, and recreate SRVs when getViewRevision() changes.
+	inline void setMinLOD(float lod)
+	{
+		minLOD.store(lod, std::memory_order_relaxed);
+		viewRevision.fetch_add(1, std::memory_order_release);
+	}
+	inline float getMinLOD() const { return minLOD.load(std::memory_order_relaxed); }
+	// Read before getMinLOD(), so a revision never goes with an older min LOD.
+	inline uint32 getViewRevision() const { return viewRevision.load(std::memory_order_acquire); }
+
 private:
 	SharedPtr<T> rhi;
+	std::atomic<UploadToken> uploadToken = UPLOAD_TOKEN_NONE;
+	std::atomic<float> minLOD = 0.0f;
+	std::atomic<uint32> viewRevision = 0;
 };
 
 using TextureAsset = GPUResourceAsset<Texture>;
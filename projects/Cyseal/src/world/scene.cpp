@@ -1,8 +1,60 @@
 #include "scene.h"
 #include "scene_proxy.h"
 #include "render/static_mesh.h"
+#include "render/gpu_scene_command_compaction.h"
+#include "core/thread_pool.h"
 #include "memory/mem_alloc.h"
 
+#include <algorithm>
+
+// Meshes per chunk when creating a scene proxy in parallel.
+static const uint32 SCENE_PROXY_CHUNK_SIZE = 256;
+
+// Per-chunk outputs of Scene::createProxy().
+struct SceneProxyChunk
+{
+	GPUSceneCommandBuffer          commands;
+	std::vector<GPUSceneItemRange> itemRangesToFree;
+	std::vector<uint32>            itemRangeSizesToAllocate; // One for each mesh that needs a new item range, in mesh order.
+	std::vector<uint32>            sceneItemsPerPipeline; // index = pipeline free number
+	uint32                         firstNewItemRange = 0;
+	uint32                         totalMeshSectionsLOD0 = 0;
+};
+
+template<typename Fn>
+static void forEachChunk(ThreadPool* threadPool, uint32 numChunks, Fn&& fn)
+{
+	if (threadPool != nullptr)
+	{
+		threadPool->parallelForChunks(numChunks, fn);
+	}
+	else
+	{
+		for (uint32 i = 0; i < numChunks; ++i)
+		{
+			fn(i);
+		}
+	}
+}
+
+// Concatenates an array of all chunks in chunk order. Destination offsets are a prefix sum of array sizes.
+template<typename T>
+static void mergeChunkArrays(ThreadPool* threadPool, const std::vector<SceneProxyChunk>& chunks, std::vector<T> GPUSceneCommandBuffer::* member, std::vector<T>& outArray)
+{
+	const uint32 numChunks = (uint32)chunks.size();
+	std::vector<size_t> offsets(numChunks + 1, 0);
+	for (uint32 i = 0; i < numChunks; ++i)
+	{
+		offsets[i + 1] = offsets[i] + (chunks[i].commands.*member).size();
+	}
+	outArray.resize(offsets[numChunks]);
+	forEachChunk(threadPool, numChunks, [&](uint32 chunkIx)
+	{
+		const std::vector<T>& src = chunks[chunkIx].commands.*member;
+		std::copy(src.begin(), src.end(), outArray.begin() + offsets[chunkIx]);
+	});
+}
+
 static uint32 calculateLOD(const StaticMesh* mesh, const Camera& camera)
 {
 	const size_t numLODs = mesh->getNumLODs();
@@ -26,59 +78,147 @@ Scene::~Scene()
 
 void Scene::updateMeshLODs(const Camera& camera, const RendererOptions& rendererOptions)
 {
-	size_t numStaticMeshes = staticMeshes.size();
-	for (uint32 i = 0; i < numStaticMeshes; ++i)
+	for (StaticMesh* sm : staticMeshes)
 	{
-		StaticMesh* sm = staticMeshes[i];
 		// #todo-lod: Mesh LOD is currently incompatible with raytracing passes.
 		uint32 lod = rendererOptions.anyRayTracingEnabled() ? 0 : calculateLOD(sm, camera);
 		sm->setActiveLOD(lod);
 	}
 }
 
-SceneProxy* Scene::createProxy()
+SceneProxy* Scene::createProxy(ThreadPool* threadPool)
 {
 	SceneProxy* proxy = new(EMemoryTag::World) SceneProxy;
 
-	size_t totalActiveMeshSections = 0;
-	std::vector<uint32> sceneItemsPerPipeline(GraphicsPipelineKeyDesc::numPipelineKeyDescs(), 0);
-	for (StaticMesh* sm : staticMeshes)
-	{
-		const std::vector<StaticMeshSection>& sections = sm->getSections(sm->getActiveLOD());
-		totalActiveMeshSections += sections.size();
-		for (const StaticMeshSection section : sections)
-		{
-			uint32 pipelineKey = section.material->getPipelineKey();
-			uint32 pipelineFN = section.material->getPipelineFreeNumber();
-			sceneItemsPerPipeline[pipelineFN] += 1;
-		}
-	}
+	const uint32 numMeshes = (uint32)staticMeshes.size();
+	const uint32 numChunks = ThreadPool::getNumChunks(numMeshes, SCENE_PROXY_CHUNK_SIZE);
+	const size_t numPipelines = GraphicsPipelineKeyDesc::numPipelineKeyDescs();
 
-	const uint32 stackAllocatorSize = (uint32)(totalActiveMeshSections * sizeof(StaticMeshProxy));
-	proxy->staticMeshProxyAllocator = new(EMemoryTag::Renderer) StackAllocator(stackAllocatorSize);
+	// chunks[0] is for meshes to remove, chunks[1 + n] is for n-th chunk of meshes in the scene.
+	std::vector<SceneProxyChunk> chunks(1 + numChunks);
 
+	// Evict removed meshes first and serially, as a mesh might have been removed and added again.
+	SceneProxyChunk& evictionChunk = chunks[0];
 	for (StaticMesh* sm : staticMeshesToRemove)
 	{
 		CHECK(sm->isMarkedToBeEvictedFromGPUScene());
-		sm->updateGPUSceneResidency(proxy, &gpuSceneItemIndexAllocator);
+		sm->prepareGPUSceneResidency(evictionChunk.itemRangesToFree);
+		sm->recordGPUSceneCommands(evictionChunk.commands, nullptr);
 	}
 	staticMeshesToRemove.clear();
 
-	std::vector<StaticMeshProxy*> staticMeshProxyList;
+	// 1. Decide residency changes and count mesh sections.
+	forEachChunk(threadPool, numChunks, [&](uint32 chunkIx)
+	{
+		SceneProxyChunk& chunk = chunks[1 + chunkIx];
+		chunk.sceneItemsPerPipeline.resize(numPipelines, 0);
+		const uint32 begin = chunkIx * SCENE_PROXY_CHUNK_SIZE;
+		const uint32 end = std::min(begin + SCENE_PROXY_CHUNK_SIZE, numMeshes);
+		for (uint32 i = begin; i < end; ++i)
+		{
+			StaticMesh* sm = staticMeshes[i];
+			for (const StaticMeshSection& section : sm->getSections(sm->getActiveLOD()))
+			{
+				uint32 pipelineFN = section.material->getPipelineFreeNumber();
+				chunk.sceneItemsPerPipeline[pipelineFN] += 1;
+			}
+			chunk.totalMeshSectionsLOD0 += (uint32)(sm->getSections(0).size());
+			const uint32 rangeSize = sm->prepareGPUSceneResidency(chunk.itemRangesToFree);
+			if (rangeSize > 0)
+			{
+				chunk.itemRangeSizesToAllocate.push_back(rangeSize);
+			}
+		}
+	});
+
+	// 2. Free and allocate gpu scene item ranges in a batch. All ranges are freed before any allocation
+	// so that holes left by evicted meshes are reused in this frame.
+	// Each chunk takes a consecutive part of newItemRangeStarts, in chunk order.
+	std::vector<uint32> sceneItemsPerPipeline(numPipelines, 0);
 	uint32 totalMeshSectionsLOD0 = 0;
-	for (StaticMesh* sm : staticMeshes)
+	uint32 numNewItemRanges = 0;
+	for (SceneProxyChunk& chunk : chunks)
+	{
+		for (const GPUSceneItemRange& range : chunk.itemRangesToFree)
+		{
+			gpuSceneItemIndexAllocator.deallocateRange(range);
+		}
+		chunk.firstNewItemRange = numNewItemRanges;
+		numNewItemRanges += (uint32)chunk.itemRangeSizesToAllocate.size();
+
+		for (size_t i = 0; i < chunk.sceneItemsPerPipeline.size(); ++i)
+		{
+			sceneItemsPerPipeline[i] += chunk.sceneItemsPerPipeline[i];
+		}
+		totalMeshSectionsLOD0 += chunk.totalMeshSectionsLOD0;
+	}
+	std::vector<uint32> newItemRangeStarts;
+	newItemRangeStarts.reserve(numNewItemRanges);
+	for (const SceneProxyChunk& chunk : chunks)
+	{
+		for (uint32 rangeSize : chunk.itemRangeSizesToAllocate)
+		{
+			const uint32 first = gpuSceneItemIndexAllocator.allocateRange(rangeSize);
+			CHECK(first != 0xffffffff);
+			newItemRangeStarts.push_back(first);
+		}
+	}
+
+	// 3. Record gpu scene commands and fill mesh proxies.
+	const uint32 stackAllocatorSize = (uint32)(numMeshes * sizeof(StaticMeshProxy));
+	proxy->staticMeshProxyAllocator = new(EMemoryTag::Renderer) StackAllocator(stackAllocatorSize);
+	StaticMeshProxy* meshProxies = nullptr;
+	if (numMeshes > 0)
+	{
+		meshProxies = static_cast<StaticMeshProxy*>(proxy->staticMeshProxyAllocator->alloc(stackAllocatorSize));
+	}
+	proxy->staticMeshes.resize(numMeshes);
+	proxy->staticMeshLODs.resize(numMeshes);
+
+	forEachChunk(threadPool, numChunks, [&](uint32 chunkIx)
+	{
+		SceneProxyChunk& chunk = chunks[1 + chunkIx];
+		const uint32* chunkItemRangeStarts = newItemRangeStarts.data() + chunk.firstNewItemRange;
+		const uint32 begin = chunkIx * SCENE_PROXY_CHUNK_SIZE;
+		const uint32 end = std::min(begin + SCENE_PROXY_CHUNK_SIZE, numMeshes);
+		for (uint32 i = begin; i < end; ++i)
+		{
+			StaticMesh* sm = staticMeshes[i];
+			chunkItemRangeStarts += sm->recordGPUSceneCommands(chunk.commands, chunkItemRangeStarts);
+
+			sm->initStaticMeshProxy(&meshProxies[i], proxy->staticMeshLODs[i]);
+			proxy->staticMeshes[i] = &meshProxies[i];
+
+			sm->savePrevTransform();
+			sm->clearDirtyFlags();
+		}
+	});
+
+	// 4. Merge per-chunk commands, then drop redundant ones.
 	{
-		sm->updateGPUSceneResidency(proxy, &gpuSceneItemIndexAllocator);
-		staticMeshProxyList.push_back(sm->createStaticMeshProxy(proxy->staticMeshProxyAllocator));
+		GPUSceneCommandBuffer frameCommands;
+		mergeChunkArrays(threadPool, chunks, &GPUSceneCommandBuffer::evictCommands, frameCommands.evictCommands);
+		mergeChunkArrays(threadPool, chunks, &GPUSceneCommandBuffer::allocCommands, frameCommands.allocCommands);
+		mergeChunkArrays(threadPool, chunks, &GPUSceneCommandBuffer::updateCommands, frameCommands.updateCommands);
+		mergeChunkArrays(threadPool, chunks, &GPUSceneCommandBuffer::evictMaterialCommands, frameCommands.evictMaterialCommands);
+		mergeChunkArrays(threadPool, chunks, &GPUSceneCommandBuffer::materialCommands, frameCommands.materialCommands);
+		mergeChunkArrays(threadPool, chunks, &GPUSceneCommandBuffer::albedoTextures, frameCommands.albedoTextures);
+		mergeChunkArrays(threadPool, chunks, &GPUSceneCommandBuffer::dirtyMaterials, frameCommands.dirtyMaterials);
 
-		totalMeshSectionsLOD0 += (uint32)(sm->getSections(0).size());
+		GPUSceneCommandBuffer compacted;
+		compactGPUSceneCommands(&frameCommands, 1, compacted, &proxy->gpuSceneCommandStats);
 
-		sm->savePrevTransform();
+		proxy->gpuSceneEvictCommands         = std::move(compacted.evictCommands);
+		proxy->gpuSceneAllocCommands         = std::move(compacted.allocCommands);
+		proxy->gpuSceneUpdateCommands        = std::move(compacted.updateCommands);
+		proxy->gpuSceneEvictMaterialCommands = std::move(compacted.evictMaterialCommands);
+		proxy->gpuSceneMaterialCommands      = std::move(compacted.materialCommands);
+		proxy->gpuSceneAlbedoTextures        = std::move(compacted.albedoTextures);
+		proxy->dirtyMaterials                = std::move(compacted.dirtyMaterials);
 	}
 
 	proxy->sun                       = sun;
 	proxy->skyboxTexture             = skyboxTexture ? skyboxTexture->getGPUResource() : nullptr;
-	proxy->staticMeshes              = std::move(staticMeshProxyList);
 	proxy->bRebuildGPUScene          = bRebuildGPUScene;
 	proxy->bRebuildRaytracingScene   = bRebuildRaytracingScene;
 	proxy->totalMeshSectionsLOD0     = totalMeshSectionsLOD0;
@@ -86,13 +226,18 @@ SceneProxy* Scene::createProxy()
 	proxy->gpuSceneItemMinValidIndex = gpuSceneItemIndexAllocator.getMinValidIndex();
 	proxy->gpuSceneItemMaxValidIndex = gpuSceneItemIndexAllocator.getMaxValidIndex();
 
-	// Clear flags
-	bRebuildGPUScene = false;
-	bRebuildRaytracingScene = false;
-	for (StaticMesh* sm : staticMeshes)
+	// Clear flags. Dirty flags of meshes were cleared in step 3.
+	// BLASes are built from vertex and index buffers, so keep rebuilding them until geometry uploads are complete.
+	bool bGeometryUploadPending = false;
+	if (bRebuildRaytracingScene)
 	{
-		sm->clearDirtyFlags();
+		for (uint32 i = 0; i < numMeshes && !bGeometryUploadPending; ++i)
+		{
+			bGeometryUploadPending = !staticMeshes[i]->isGeometryUploadComplete();
+		}
 	}
+	bRebuildGPUScene = false;
+	bRebuildRaytracingScene = bGeometryUploadPending;
 	for (MaterialAsset* mat : proxy->dirtyMaterials)
 	{
 		mat->clearDirtyFlag();
@@ -101,30 +246,55 @@ SceneProxy* Scene::createProxy()
 	return proxy;
 }
 
-void Scene::addStaticMesh(StaticMesh* staticMesh)
+SlotHandle Scene::addStaticMesh(StaticMesh* staticMesh)
 {
-	staticMeshes.push_back(staticMesh);
+	CHECK(!staticMesh->getSceneHandle().isValid());
+	SlotHandle handle = staticMeshes.insert(staticMesh);
+	staticMesh->setSceneHandle(handle);
 	bRebuildGPUScene = true;
 	bRebuildRaytracingScene = true;
+	return handle;
 }
 
-void Scene::removeStaticMesh(StaticMesh* staticMesh)
+bool Scene::removeStaticMesh(StaticMesh* staticMesh)
 {
-	auto it = std::find(staticMeshes.begin(), staticMeshes.end(), staticMesh);
-	if (it != staticMeshes.end())
+	SlotHandle handle = staticMesh->getSceneHandle();
+	if (findStaticMesh(handle) != staticMesh)
 	{
-		staticMeshes.erase(it);
-		staticMeshesToRemove.push_back(staticMesh);
-		staticMesh->markToEvictFromGPUScene();
+		return false;
 	}
+	return removeStaticMesh(handle);
+}
+
+bool Scene::removeStaticMesh(SlotHandle handle)
+{
+	StaticMesh* const* found = staticMeshes.find(handle);
+	if (found == nullptr)
+	{
+		return false;
+	}
+	StaticMesh* staticMesh = *found;
+	staticMeshes.remove(handle);
+	staticMesh->setSceneHandle(SlotHandle{});
+	staticMeshesToRemove.push_back(staticMesh);
+	staticMesh->markToEvictFromGPUScene();
+	return true;
+}
+
+StaticMesh* Scene::findStaticMesh(SlotHandle handle) const
+{
+	StaticMesh* const* found = staticMeshes.find(handle);
+	return (found != nullptr) ? *found : nullptr;
 }
 
 void Scene::clearStaticMeshes()
 {
-	staticMeshesToRemove = std::move(staticMeshes);
-	for (StaticMesh* sm : staticMeshesToRemove)
+	staticMeshesToRemove.reserve(staticMeshesToRemove.size() + staticMeshes.size());
+	for (StaticMesh* sm : staticMeshes)
 	{
+		sm->setSceneHandle(SlotHandle{});
 		sm->markToEvictFromGPUScene();
+		staticMeshesToRemove.push_back(sm);
 	}
 	staticMeshes.clear();
 }
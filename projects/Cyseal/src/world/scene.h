@@ -4,15 +4,17 @@
 #include "camera.h"
 #include "gpu_resource_asset.h"
 #include "core/smart_pointer.h"
+#include "core/slot_map.h"
 #include "render/renderer_options.h"
 #include "memory/memory_tag.h"
 #include "memory/free_number_list.h"
+#include "render/gpu_scene_command.h"
 
 #include <vector>
-#include <set>
 
 class StaticMesh;
 class SceneProxy;
+class ThreadPool;
 
 class GPUSceneItemIndexAllocator
 {
@@ -21,24 +23,20 @@ public:
 		: allocator(0xffffffff, EMemoryTag::World)
 	{}
 
-	inline uint32 allocate()
-	{
-		uint32 n = allocator.allocate() - 1;
-		allocatedNumbers.insert(n);
-		return n;
-	}
-	inline bool deallocate(uint32 n)
-	{
-		allocatedNumbers.erase(n + 1);
-		return allocator.deallocate(n + 1);
-	}
-
-	inline uint32 getMinValidIndex() const { return (allocatedNumbers.size() > 0) ? *(allocatedNumbers.begin()) : 0xffffffff; }
-	inline uint32 getMaxValidIndex() const { return (allocatedNumbers.size() > 0) ? *(allocatedNumbers.rbegin()) : 0xffffffff; }
+	inline uint32 allocate() { return allocator.allocate() - 1; }
+	inline bool deallocate(uint32 n) { return allocator.deallocate(n + 1); }
+
+	// Allocate 'count' consecutive indices. First fit, so holes left by evicted meshes are reused.
+	// @return The first index. 0xffffffff if failed.
+	inline uint32 allocateRange(uint32 count) { return allocator.allocateRange(count) - 1; }
+	inline bool deallocateRange(const GPUSceneItemRange& range) { return allocator.deallocateRange(range.first + 1, range.count); }
+
+	inline uint32 getNumAllocated() const { return allocator.getNumAllocated(); }
+	inline uint32 getMinValidIndex() const { return allocator.isEmpty() ? 0xffffffff : (allocator.getMinAllocated() - 1); }
+	inline uint32 getMaxValidIndex() const { return allocator.isEmpty() ? 0xffffffff : (allocator.getMaxAllocated() - 1); }
 
 private:
 	FreeNumberList allocator;
-	std::set<uint32> allocatedNumbers;
 };
 
 // Main thread version of scene representation.
@@ -49,11 +47,19 @@ public:
 
 	void updateMeshLODs(const Camera& camera, const RendererOptions& rendererOptions);
 
-	SceneProxy* createProxy();
+	// @param threadPool If not null, meshes are processed in parallel.
+	SceneProxy* createProxy(ThreadPool* threadPool = nullptr);
+
+	// @return Stable handle of the mesh in this scene. Invalidated when the mesh is removed.
+	SlotHandle addStaticMesh(StaticMesh* staticMesh);
 
-	void addStaticMesh(StaticMesh* staticMesh);
+	// O(1) removal. Returns false if the mesh was not in the scene.
+	bool removeStaticMesh(StaticMesh* staticMesh);
+	bool removeStaticMesh(SlotHandle handle);
 
-	void removeStaticMesh(StaticMesh* staticMesh);
+	// @return nullptr if the handle is stale.
+	StaticMesh* findStaticMesh(SlotHandle handle) const;
+	inline size_t getNumStaticMeshes() const { return staticMeshes.size(); }
 
 	void clearStaticMeshes();
 	void clearSkybox();
@@ -63,7 +69,7 @@ public:
 	SharedPtr<TextureAsset> skyboxTexture;
 
 private:
-	std::vector<StaticMesh*> staticMeshes;
+	SlotMap<StaticMesh*> staticMeshes;
 	bool bRebuildGPUScene = false;
 	bool bRebuildRaytracingScene = false;
 
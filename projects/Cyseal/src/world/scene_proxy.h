@@ -3,12 +3,13 @@
 #include "light.h"
 #include "gpu_resource_asset.h"
 #include "core/smart_pointer.h"
-#include "render/gpu_scene_command.h"
+#include "render/gpu_scene_command_compaction.h"
 #include "material/material_shader.h"
 
 #include <vector>
 
 struct StaticMeshProxy;
+struct StaticMeshLOD;
 class StackAllocator;
 
 // Render thread version of scene representation.
@@ -21,6 +22,7 @@ public:
 	DirectionalLight              sun;
 	SharedPtr<Texture>            skyboxTexture;
 	std::vector<StaticMeshProxy*> staticMeshes;
+	std::vector<SharedPtr<const StaticMeshLOD>> staticMeshLODs; // Keeps StaticMeshProxy::lod alive.
 
 	bool   bRebuildGPUScene        = false;
 	bool   bRebuildRaytracingScene = false;
@@ -31,7 +33,7 @@ public:
 	uint32 gpuSceneItemMinValidIndex = 0xffffffff;
 	uint32 gpuSceneItemMaxValidIndex = 0xffffffff;
 
-	StackAllocator* staticMeshProxyAllocator;
+	StackAllocator* staticMeshProxyAllocator = nullptr;
 
 public:
 	inline bool hasAnyGPUSceneCommands() const
@@ -49,7 +51,10 @@ public:
 
 	std::vector<GPUSceneEvictMaterialCommand> gpuSceneEvictMaterialCommands;
 	std::vector<GPUSceneMaterialCommand>      gpuSceneMaterialCommands;
-	std::vector<Texture*>                     gpuSceneAlbedoTextures; // For each material command
+	std::vector<GPUSceneMaterialTexture>      gpuSceneAlbedoTextures; // For each material command
 
-	std::vector<class MaterialAsset*>         dirtyMaterials; // Duplicate items might exist
+	std::vector<class MaterialAsset*>         dirtyMaterials;
+
+	// Commands above are compacted. See compactGPUSceneCommands().
+	GPUSceneCommandStats                      gpuSceneCommandStats;
 };
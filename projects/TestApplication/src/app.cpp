@@ -5,6 +5,7 @@
 
 #include "core/core_minimal.h"
 #include "memory/memory_tracker.h"
+#include "world/scene_proxy.h"
 #include "rhi/render_device_capabilities.h"
 #include "util/profiling.h"
 #include "imgui.h"
@@ -30,6 +31,7 @@
 
 #define WINDOW_TYPE          EWindowType::WINDOWED
 #define RAYTRACING_TIER      ERaytracingTier::MaxTier
+#define USE_RENDER_THREAD    false
 
 // Camera position and direction can be overriden by world.
 #define CAMERA_POSITION      vec3(50.0f, 0.0f, 30.0f)
@@ -105,12 +107,13 @@ bool TestApplication::onInitialize()
 	};
 
 	CysealEngineCreateParams engineInit{
-		.renderDevice = RenderDeviceCreateParams{
+		.renderDevice     = RenderDeviceCreateParams{
 			.swapChainParams  = swapChainParams,
 			.rawAPI           = RAW_API,
 			.raytracingTier   = RAYTRACING_TIER,
 		},
-		.rendererType = RENDERER_TYPE,
+		.rendererType     = RENDERER_TYPE,
+		.bUseRenderThread = USE_RENDER_THREAD,
 	};
 	cysealEngine.startup(engineInit);
 	cysealEngine.setRenderAndDisplayResolution(getWindowWidth(), getWindowHeight());
@@ -121,7 +124,7 @@ bool TestApplication::onInitialize()
 	resetSceneAndCamera();
 
 	world = createWorldInstance((EWorldIndex)appState.currentWorldIndex);
-	world->preinitialize(&scene, &camera, &appState);
+	world->preinitialize(&scene, &camera, &appState, cysealEngine.getThreadPool());
 	world->onInitialize();
 
 	return true;
@@ -129,14 +132,14 @@ bool TestApplication::onInitialize()
 
 void TestApplication::onTick(float deltaSeconds)
 {
-	// #todo-renderthread: Start to render using prev frame's scene proxy.
+	// With USE_RENDER_THREAD, the previous frame is being rendered while world logic runs.
 
 	if (bChangeWorld)
 	{
 		// Clear GPU scene residency.
 		scene.clearStaticMeshes();
 		scene.clearSkybox();
-		SceneProxy* sceneProxy = scene.createProxy();
+		SceneProxy* sceneProxy = scene.createProxy(cysealEngine.getThreadPool());
 		// #todo-renderer: How to update gpu scene only, without executing other render passes?
 		cysealEngine.renderScene(sceneProxy, &camera, appState.rendererOptions);
 		delete sceneProxy;
@@ -147,7 +150,7 @@ void TestApplication::onTick(float deltaSeconds)
 		resetSceneAndCamera();
 
 		world = createWorldInstance((EWorldIndex)appState.currentWorldIndex);
-		world->preinitialize(&scene, &camera, &appState);
+		world->preinitialize(&scene, &camera, &appState, cysealEngine.getThreadPool());
 		world->onInitialize();
 	}
 
@@ -248,7 +251,7 @@ void TestApplication::onTick(float deltaSeconds)
 
 		scene.updateMeshLODs(camera, appState.rendererOptions);
 
-		SceneProxy* sceneProxy = scene.createProxy();
+		SceneProxy* sceneProxy = scene.createProxy(cysealEngine.getThreadPool());
 
 		if (bViewportNeedsResize)
 		{
@@ -309,6 +312,7 @@ void TestApplication::onTick(float deltaSeconds)
 				{
 					ImGui::EndDisabled();
 				}
+				ImGui::Checkbox("Quantize GPU Scene Transforms", &appState.rendererOptions.bQuantizeGPUSceneTransforms);
 			}
 
 			if (ImGui::CollapsingHeader("Depth and Visibility", sectionDefaultFlags))
@@ -453,6 +457,10 @@ void TestApplication::onTick(float deltaSeconds)
 				{
 					ImGui::Text("Static Mesh LOD is enabled");
 				}
+
+				const GPUSceneCommandStats& commandStats = sceneProxy->gpuSceneCommandStats;
+				ImGui::Text("GPU scene commands: %u -> %u", commandStats.numCommandsBefore, commandStats.numCommandsAfter);
+				ImGui::Text("GPU scene command bytes saved: %llu", commandStats.getBytesSaved());
 			}
 
 			if (ImGui::CollapsingHeader("Memory", ImGuiTreeNodeFlags_DefaultOpen))
@@ -468,14 +476,14 @@ void TestApplication::onTick(float deltaSeconds)
 		cysealEngine.renderImgui();
 
 		appState.rendererOptions.prevFrameTime = 1000.0f * deltaSeconds;
-		cysealEngine.renderScene(sceneProxy, &camera, appState.rendererOptions);
-
-		delete sceneProxy;
+		// The engine takes ownership of sceneProxy.
+		cysealEngine.submitSceneFrame(sceneProxy, camera, appState.rendererOptions);
 	}
 }
 
 void TestApplication::onTerminate()
 {
+	cysealEngine.flushRendering();
 	world->onTerminate();
 
 	cysealEngine.shutdown();
@@ -5,17 +5,20 @@
 #include "world/scene.h"
 #include "world/camera.h"
 
+class ThreadPool;
+
 class World
 {
 public:
 	World() {}
 	virtual ~World() {}
 
-	void preinitialize(Scene* inScene, Camera* inCamera, AppState* inAppState)
+	void preinitialize(Scene* inScene, Camera* inCamera, AppState* inAppState, ThreadPool* inThreadPool)
 	{
 		scene = inScene;
 		camera = inCamera;
 		appState = inAppState;
+		threadPool = inThreadPool;
 	}
 
 	virtual void onInitialize() = 0;
@@ -28,4 +31,5 @@ protected:
 	Scene* scene = nullptr;
 	Camera* camera = nullptr;
 	AppState* appState = nullptr;
+	ThreadPool* threadPool = nullptr;
 };
@@ -13,6 +13,8 @@
 #include "loader/image_loader.h"
 #include "loader/pbrt_loader.h"
 #include "loader/ply_loader.h"
+#include "util/resource_finder.h"
+#include "world_utils.h"
 
 #include "imgui.h"
 
@@ -24,6 +26,8 @@
 #define LOAD_PBRT_FILE       1
 #define CREATE_TEST_MESHES   1
 #define CREATE_SKYBOX        1
+// Equirect .hdr or .exr file for the skybox. The Footballfield cube is used if not found.
+#define SKYBOX_ENVIRONMENT_MAP L"external/environment_map/skybox.hdr"
 #define MESH_SPLATTING_DELAY 0
 #define PBRT_LOAD_DELAY      30
 
@@ -193,20 +197,17 @@ void World1::createTestMeshes()
 		imageBlob = new ImageLoadData;
 
 		// Fill random image
-		imageBlob->numComponents = 4;
-		imageBlob->width = 256;
-		imageBlob->height = 256;
-		imageBlob->length = 256 * 256 * 4;
-		imageBlob->buffer = new uint8[imageBlob->length];
+		imageBlob->allocate(256, 256, 4);
+		uint8* buffer = imageBlob->getBuffer();
 		int32 p = 0;
 		for (int32 y = 0; y < 256; ++y)
 		{
 			for (int32 x = 0; x < 256; ++x)
 			{
-				imageBlob->buffer[p] = (uint8)(x ^ y);
-				imageBlob->buffer[p+1] = (uint8)(x ^ y);
-				imageBlob->buffer[p+2] = (uint8)(x ^ y);
-				imageBlob->buffer[p+3] = 0xff;
+				buffer[p] = (uint8)(x ^ y);
+				buffer[p+1] = (uint8)(x ^ y);
+				buffer[p+2] = (uint8)(x ^ y);
+				buffer[p+3] = 0xff;
 				p += 4;
 			}
 		}
@@ -225,7 +226,7 @@ void World1::createTestMeshes()
 				imageBlob->width, imageBlob->height, 1);
 
 			Texture* texture = gRenderDevice->createTexture(params);
-			texture->uploadData(&commandList, imageBlob->buffer, imageBlob->getRowPitch(), imageBlob->getSlicePitch());
+			texture->uploadData(&commandList, imageBlob->getBuffer(), imageBlob->getRowPitch(), imageBlob->getSlicePitch());
 			texture->setDebugName(TEXT("Texture_albedoTest"));
 
 			tex->setGPUResource(SharedPtr<Texture>(texture));
@@ -338,6 +339,15 @@ void World1::createMeshSplatting()
 
 void World1::createSkybox()
 {
+	if (ResourceFinder::get().find(SKYBOX_ENVIRONMENT_MAP).size() > 0)
+	{
+		scene->skyboxTexture = worldUtils::createEnvironmentMapSkyboxAsset(SKYBOX_ENVIRONMENT_MAP, threadPool);
+		if (scene->skyboxTexture != nullptr)
+		{
+			return;
+		}
+	}
+
 	ImageLoader imageLoader;
 
 	// Skybox
@@ -373,7 +383,7 @@ void World1::createSkybox()
 				for (uint32 i = 0; i < 6; ++i)
 				{
 					texture->uploadData(&commandList,
-						skyboxBlobs[i]->buffer,
+						skyboxBlobs[i]->getBuffer(),
 						skyboxBlobs[i]->getRowPitch(),
 						skyboxBlobs[i]->getSlicePitch(),
 						i);
@@ -398,7 +408,7 @@ void World1::createPbrtResources()
 	// Currently only pbrt mesh contains multiple mesh sections.
 	// It's highly suspicious that mesh index, gpu scene item index, and material index are out of sync.
 	PBRT4Loader pbrtLoader;
-	PBRT4Scene* pbrtScene = pbrtLoader.loadFromFile(pbrtLoadDesc.filename);
+	PBRT4Scene* pbrtScene = pbrtLoader.loadFromFile(pbrtLoadDesc.filename, threadPool);
 
 	if (bIsPbrtBedroomUsed)
 	{
@@ -442,6 +452,12 @@ void World1::createPbrtResources()
 			scene->addStaticMesh(pbrtInst);
 		}
 
+		// All meshes share the same transform.
+		if (pbrtMeshes.size() > 0)
+		{
+			PBRT4Scene::registerTextureStreamingUsages(ret.textureUsages, pbrtMeshes[0]->getTransformMatrix());
+		}
+
 		ENQUEUE_RENDER_COMMAND(DeallocPbrtScene)(
 			[pbrtScene](RenderCommandList& commandList) {
 				commandList.enqueueDeferredDealloc(pbrtScene);
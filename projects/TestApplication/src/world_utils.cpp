@@ -1,6 +1,8 @@
 #include "world_utils.h"
 
 #include "loader/image_loader.h"
+#include "loader/environment_map.h"
+#include "rhi/upload_batcher.h"
 #include "core/engine.h"
 
 #include <string>
@@ -49,7 +51,7 @@ namespace worldUtils
 						for (uint32 i = 0; i < 6; ++i)
 						{
 							texture->uploadData(&commandList,
-								skyboxBlobs[i]->buffer,
+								skyboxBlobs[i]->getBuffer(),
 								skyboxBlobs[i]->getRowPitch(),
 								skyboxBlobs[i]->getSlicePitch(),
 								i);
@@ -71,4 +73,61 @@ namespace worldUtils
 
 		return skyboxTexture;
 	}
+
+	SharedPtr<TextureAsset> createEnvironmentMapSkyboxAsset(const wchar_t* filepath, ThreadPool* threadPool, const wchar_t* inDebugName)
+	{
+		EnvironmentMap* envMap = loadEnvironmentMap(filepath, EnvironmentMapDesc{}, threadPool);
+		if (envMap == nullptr)
+		{
+			return nullptr;
+		}
+
+		SharedPtr<TextureAsset> skyboxTexture = makeShared<TextureAsset>();
+		std::wstring debugName = (inDebugName != nullptr) ? inDebugName : L"";
+		// Released once all faces are copied to staging pages.
+		SharedPtr<EnvironmentMap> envMapOwner(envMap);
+
+		ENQUEUE_RENDER_COMMAND(CreateEnvironmentMapSkybox)(
+			[texWeak = WeakPtr<TextureAsset>(skyboxTexture), debugName, envMapOwner](RenderCommandList& commandList) {
+					SharedPtr<TextureAsset> tex = texWeak.lock();
+					if (tex == nullptr)
+					{
+						return;
+					}
+
+					const MipChain& radiance = envMapOwner->radiance;
+					const uint32 numLevels = radiance.getNumLevels();
+					CHECK(radiance.format == EPixelFormat::R16G16B16A16_FLOAT);
+
+					TextureCreateParams params = TextureCreateParams::textureCube(
+						EPixelFormat::R16G16B16A16_FLOAT,
+						ETextureAccessFlags::SRV,
+						radiance.levels[0].width, radiance.levels[0].height,
+						(uint16)numLevels);
+
+					SharedPtr<Texture> texture(gRenderDevice->createTexture(params));
+					if (debugName.size() > 0)
+					{
+						texture->setDebugName(debugName.c_str());
+					}
+
+					UploadToken uploadToken = UPLOAD_TOKEN_NONE;
+					for (uint32 face = 0; face < 6; ++face)
+					{
+						for (uint32 mip = 0; mip < numLevels; ++mip)
+						{
+							uploadToken = gUploadBatcher->uploadTexture(texture, mip + face * numLevels,
+								radiance.getSliceData(mip, face),
+								radiance.levels[mip].rowPitch,
+								envMapOwner);
+						}
+					}
+
+					tex->setUploadToken(uploadToken);
+					tex->setGPUResource(texture);
+			}
+		);
+
+		return skyboxTexture;
+	}
 }
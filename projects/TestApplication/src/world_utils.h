@@ -2,7 +2,16 @@
 
 #include "world/gpu_resource_asset.h"
 
+class ThreadPool;
+
 namespace worldUtils
 {
 	SharedPtr<TextureAsset> createSkyboxAsset(const wchar_t* inDebugName = L"Texture_skybox");
+
+	// Cube of the radiance of an equirect .hdr or .exr file, with full mips.
+	// @return null if the file can't be loaded.
+	SharedPtr<TextureAsset> createEnvironmentMapSkyboxAsset(
+		const wchar_t* filepath,
+		ThreadPool* threadPool = nullptr,
+		const wchar_t* inDebugName = L"Texture_environmentMap");
 };
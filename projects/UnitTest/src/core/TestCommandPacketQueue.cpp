@@ -0,0 +1,210 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "core/command_packet_queue.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <functional>
+
+namespace UnitTest
+{
+	struct CommandContext
+	{
+		std::vector<uint32> executed;
+	};
+	using TestCommandQueue = CommandPacketQueue<CommandContext&>;
+
+	TEST_CLASS(TestCommandPacketQueue)
+	{
+	public:
+		TEST_METHOD(SingleProducerOrder)
+		{
+			TestCommandQueue queue;
+			CommandContext context;
+			// Enough packets to span several segments.
+			const uint32 count = 20000;
+			for (uint32 i = 0; i < count; ++i)
+			{
+				queue.enqueue([i](CommandContext& ctx) { ctx.executed.push_back(i); });
+			}
+			Assert::AreEqual(count, queue.execute(context));
+			Assert::AreEqual((size_t)count, context.executed.size());
+			for (uint32 i = 0; i < count; ++i)
+			{
+				Assert::AreEqual(i, context.executed[i]);
+			}
+			Assert::AreEqual(0u, queue.execute(context));
+		}
+
+		TEST_METHOD(LargeAndInlinePayloads)
+		{
+			TestCommandQueue queue;
+			CommandContext context;
+			auto token = std::make_shared<uint32>(7);
+			uint32 bigPayload[256];
+			for (uint32 i = 0; i < 256; ++i) bigPayload[i] = i;
+
+			queue.enqueue([token](CommandContext& ctx) { ctx.executed.push_back(*token); });
+			queue.enqueue([bigPayload, token](CommandContext& ctx) { ctx.executed.push_back(bigPayload[255] + *token); });
+			queue.enqueue(std::function<void(CommandContext&)>([](CommandContext& ctx) { ctx.executed.push_back(1); }));
+			Assert::AreEqual(3L, token.use_count());
+
+			Assert::AreEqual(3u, queue.execute(context));
+			Assert::AreEqual(7u, context.executed[0]);
+			Assert::AreEqual(262u, context.executed[1]);
+			Assert::AreEqual(1u, context.executed[2]);
+			Assert::AreEqual(1L, token.use_count(), L"Captures should be destroyed after execution");
+		}
+
+		TEST_METHOD(DestroyPendingCommands)
+		{
+			auto token = std::make_shared<uint32>(0);
+			{
+				TestCommandQueue queue;
+				for (uint32 i = 0; i < 5000; ++i)
+				{
+					queue.enqueue([token](CommandContext& ctx) { ctx.executed.push_back(0); });
+				}
+				Assert::AreEqual(5001L, token.use_count());
+			}
+			Assert::AreEqual(1L, token.use_count());
+		}
+
+		TEST_METHOD(EnqueueWhileExecuting)
+		{
+			TestCommandQueue queue;
+			CommandContext context;
+			queue.enqueue([&queue](CommandContext& ctx) {
+				ctx.executed.push_back(1);
+				queue.enqueue([](CommandContext& ctx2) { ctx2.executed.push_back(3); });
+			});
+			queue.enqueue([](CommandContext& ctx) { ctx.executed.push_back(2); });
+
+			Assert::AreEqual(2u, queue.execute(context));
+			Assert::AreEqual((size_t)2, context.executed.size());
+			Assert::AreEqual(1u, queue.execute(context));
+			Assert::AreEqual(3u, context.executed[2]);
+		}
+
+		// Each producer's commands must run in its enqueue order while the consumer drains concurrently.
+		TEST_METHOD(MultiProducerOrder)
+		{
+			const uint32 numProducers = 4;
+			const uint32 countPerProducer = 50000;
+
+			TestCommandQueue queue;
+			CommandContext context;
+			std::atomic<uint32> numFinished = 0;
+			std::vector<std::thread> producers;
+			for (uint32 p = 0; p < numProducers; ++p)
+			{
+				producers.emplace_back([&queue, &numFinished, p, countPerProducer]() {
+					for (uint32 i = 0; i < countPerProducer; ++i)
+					{
+						const uint32 value = (p << 24) | i;
+						queue.enqueue([value](CommandContext& ctx) { ctx.executed.push_back(value); });
+					}
+					numFinished.fetch_add(1);
+				});
+			}
+			while (numFinished.load() < numProducers)
+			{
+				queue.execute(context);
+			}
+			for (std::thread& t : producers) t.join();
+			queue.execute(context);
+
+			Assert::AreEqual((size_t)(numProducers * countPerProducer), context.executed.size());
+			std::vector<uint32> nextSeq(numProducers, 0);
+			for (uint32 value : context.executed)
+			{
+				const uint32 p = value >> 24;
+				const uint32 seq = value & 0xffffff;
+				Assert::AreEqual(nextSeq[p], seq);
+				nextSeq[p] += 1;
+			}
+		}
+
+		TEST_METHOD(ThroughputBenchmark)
+		{
+			const uint32 numProducers = 4;
+			const uint32 countPerProducer = 200000;
+
+			// Captures five pointers, which is more than std::function stores inline on common implementations.
+			struct Payload { uint64 a, b, c, d, e; };
+			auto runPacketQueue = [&]() -> float {
+				CommandPacketQueue<uint64&> queue;
+				uint64 sum = 0;
+				HighFrequencyCounter counter;
+				counter.start();
+				std::atomic<uint32> numFinished = 0;
+				std::vector<std::thread> producers;
+				for (uint32 p = 0; p < numProducers; ++p)
+				{
+					producers.emplace_back([&]() {
+						for (uint32 i = 0; i < countPerProducer; ++i)
+						{
+							Payload payload{ i, 1, 2, 3, 4 };
+							queue.enqueue([payload](uint64& s) { s += payload.a + payload.e; });
+						}
+						numFinished.fetch_add(1);
+					});
+				}
+				while (numFinished.load() < numProducers) queue.execute(sum);
+				for (std::thread& t : producers) t.join();
+				queue.execute(sum);
+				float elapsed = counter.stopWithMilliseconds();
+				Assert::AreEqual((uint64)numProducers * ((uint64)countPerProducer * (countPerProducer - 1) / 2 + 4ull * countPerProducer), sum);
+				return elapsed;
+			};
+			auto runLockedVector = [&]() -> float {
+				std::mutex mutex;
+				std::vector<std::function<void(uint64&)>> commands;
+				uint64 sum = 0;
+				HighFrequencyCounter counter;
+				counter.start();
+				std::atomic<uint32> numFinished = 0;
+				std::vector<std::thread> producers;
+				for (uint32 p = 0; p < numProducers; ++p)
+				{
+					producers.emplace_back([&]() {
+						for (uint32 i = 0; i < countPerProducer; ++i)
+						{
+							Payload payload{ i, 1, 2, 3, 4 };
+							std::lock_guard<std::mutex> guard(mutex);
+							commands.push_back([payload](uint64& s) { s += payload.a + payload.e; });
+						}
+						numFinished.fetch_add(1);
+					});
+				}
+				auto drain = [&]() {
+					std::vector<std::function<void(uint64&)>> local;
+					{
+						std::lock_guard<std::mutex> guard(mutex);
+						local.swap(commands);
+					}
+					for (auto& fn : local) fn(sum);
+				};
+				while (numFinished.load() < numProducers) drain();
+				for (std::thread& t : producers) t.join();
+				drain();
+				return counter.stopWithMilliseconds();
+			};
+
+			const float lockedMs = runLockedVector();
+			const float packetMs = runPacketQueue();
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"%u producers x %u commands: mutex + std::function vector %.2f ms, packet queue %.2f ms\n",
+				numProducers, countPerProducer, lockedMs, packetMs);
+			UnitLogger::WriteMessage(msg);
+		}
+	};
+}
@@ -0,0 +1,139 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "memory/frame_allocator.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace UnitTest
+{
+	static uint32 g_heapAllocCount = 0;
+
+	// Counts heap allocations made by std::vector.
+	template<typename T>
+	struct CountingAllocator
+	{
+		using value_type = T;
+		CountingAllocator() = default;
+		template<typename U> CountingAllocator(const CountingAllocator<U>&) {}
+		T* allocate(size_t n) { ++g_heapAllocCount; return std::allocator<T>().allocate(n); }
+		void deallocate(T* p, size_t n) { std::allocator<T>().deallocate(p, n); }
+		template<typename U> bool operator==(const CountingAllocator<U>&) const { return true; }
+		template<typename U> bool operator!=(const CountingAllocator<U>&) const { return false; }
+	};
+
+	TEST_CLASS(TestFrameAllocator)
+	{
+	public:
+		TEST_METHOD(Alignment)
+		{
+			LinearAllocator allocator(1024);
+			allocator.alloc(1, 1);
+			void* p16 = allocator.alloc(8, 16);
+			allocator.alloc(3, 1);
+			void* p256 = allocator.alloc(64, 256);
+			Assert::AreEqual((uintptr_t)0, reinterpret_cast<uintptr_t>(p16) % 16);
+			Assert::AreEqual((uintptr_t)0, reinterpret_cast<uintptr_t>(p256) % 256);
+		}
+
+		TEST_METHOD(GrowAndMergeOnReset)
+		{
+			LinearAllocator allocator(1024);
+			for (uint32 i = 0; i < 10; ++i)
+			{
+				allocator.alloc(512);
+			}
+			// Also larger than a chunk.
+			allocator.alloc(4096);
+			Assert::IsTrue(allocator.getNumHeapAllocations() > 1);
+			const size_t capacity = allocator.getCapacity();
+			Assert::IsTrue(capacity >= 10 * 512 + 4096);
+
+			allocator.reset();
+			Assert::AreEqual(0u, allocator.getNumHeapAllocations());
+			Assert::AreEqual(capacity, allocator.getCapacity());
+
+			for (uint32 i = 0; i < 10; ++i)
+			{
+				allocator.alloc(512);
+			}
+			allocator.alloc(4096);
+			Assert::AreEqual(0u, allocator.getNumHeapAllocations(), L"Steady-state frame should not touch the heap");
+		}
+
+		TEST_METHOD(MultiBuffered)
+		{
+			FrameAllocator frameAllocator;
+			frameAllocator.initialize(2, 256);
+
+			uint32* frame0 = frameAllocator.beginFrame(0)->allocArray<uint32>(4);
+			for (uint32 i = 0; i < 4; ++i) frame0[i] = i;
+
+			// Writing to frame 1 must not clobber frame 0 which may be still in flight.
+			uint32* frame1 = frameAllocator.beginFrame(1)->allocArray<uint32>(4);
+			for (uint32 i = 0; i < 4; ++i) frame1[i] = 100 + i;
+			for (uint32 i = 0; i < 4; ++i) Assert::AreEqual(i, frame0[i]);
+
+			// Frame 0 comes again and reuses the same memory.
+			uint32* frame2 = frameAllocator.beginFrame(0)->allocArray<uint32>(4);
+			Assert::IsTrue(frame0 == frame2);
+		}
+
+		TEST_METHOD(StlAdaptor)
+		{
+			LinearAllocator allocator(64);
+			LinearVector<uint64> v{ LinearStlAllocator<uint64>(&allocator) };
+			for (uint64 i = 0; i < 1000; ++i) v.push_back(i);
+			uint64 sum = 0;
+			for (uint64 x : v) sum += x;
+			Assert::AreEqual((uint64)(999 * 1000 / 2), sum);
+
+			LinearVector<LinearVector<uint32>> nested{ LinearStlAllocator<LinearVector<uint32>>(&allocator) };
+			nested.emplace_back(LinearStlAllocator<uint32>(&allocator));
+			nested[0].push_back(7);
+			Assert::AreEqual(7u, nested[0][0]);
+		}
+
+		// Simulates per-pipeline draw list building and reports heap allocations per frame.
+		TEST_METHOD(HeapAllocationsPerFrame)
+		{
+			const uint32 numPipelines = 2;
+			const uint32 numSections = 5000;
+			const uint32 numFrames = 8;
+
+			uint32 heapAllocsBefore = 0;
+			for (uint32 frame = 0; frame < numFrames; ++frame)
+			{
+				g_heapAllocCount = 0;
+				std::vector<std::vector<uint32, CountingAllocator<uint32>>, CountingAllocator<std::vector<uint32, CountingAllocator<uint32>>>> drawLists(numPipelines);
+				for (auto& list : drawLists) list.reserve(numSections / numPipelines);
+				for (uint32 i = 0; i < numSections; ++i) drawLists[i % numPipelines].push_back(i);
+				heapAllocsBefore = g_heapAllocCount;
+			}
+
+			FrameAllocator frameAllocator;
+			frameAllocator.initialize(2, 4096);
+			uint32 heapAllocsAfter = 0;
+			for (uint32 frame = 0; frame < numFrames; ++frame)
+			{
+				LinearAllocator* allocator = frameAllocator.beginFrame(frame % 2);
+				LinearVector<LinearVector<uint32>> drawLists{ LinearStlAllocator<LinearVector<uint32>>(allocator) };
+				drawLists.reserve(numPipelines);
+				for (uint32 i = 0; i < numPipelines; ++i) drawLists.emplace_back(allocator);
+				for (auto& list : drawLists) list.reserve(numSections / numPipelines);
+				for (uint32 i = 0; i < numSections; ++i) drawLists[i % numPipelines].push_back(i);
+				heapAllocsAfter = allocator->getNumHeapAllocations();
+			}
+
+			Assert::AreEqual(0u, heapAllocsAfter);
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"Draw list heap allocations per frame: global heap %u, frame allocator %u (steady state)\n",
+				heapAllocsBefore, heapAllocsAfter);
+			UnitLogger::WriteMessage(msg);
+		}
+	};
+}
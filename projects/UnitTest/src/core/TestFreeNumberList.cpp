@@ -1,8 +1,15 @@
 #include "pch.h"
 #include "CppUnitTest.h"
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
 
 #include "memory/free_number_list.h"
+#include "core/high_freq_counter.h"
+
+#include <set>
+#include <vector>
+#include <random>
+#include <algorithm>
 
 // Current implementation returns a smallest possible number but it's not guaranteed by spec.
 #define CHECK_SMALLEST_POSSIBLE_NUMBER 1
@@ -92,5 +99,170 @@ namespace UnitTest
 				}
 			}
 		}
+
+		TEST_METHOD(AllocateRange)
+		{
+			FreeNumberList fn(200);
+			Assert::AreEqual(1u, fn.allocateRange(10));   // [1, 10]
+			Assert::AreEqual(11u, fn.allocateRange(100)); // [11, 110]
+			Assert::AreEqual(111u, fn.allocate());
+
+			Assert::IsTrue(fn.deallocateRange(20, 30));   // Free [20, 49]
+			Assert::IsFalse(fn.deallocateRange(20, 1), L"Freed a range twice");
+			Assert::IsFalse(fn.deallocateRange(105, 10), L"Freed a partially allocated range");
+
+			Assert::AreEqual(112u, fn.allocateRange(31)); // Does not fit in the hole
+			Assert::AreEqual(20u, fn.allocateRange(30));  // Fits exactly
+			Assert::AreEqual(0u, fn.allocateRange(100), L"Allocated over maxNumber");
+			Assert::AreEqual(143u, fn.allocateRange(58));
+			Assert::IsFalse(fn.canAllocate());
+			Assert::AreEqual(200u, fn.getNumAllocated());
+		}
+
+		TEST_METHOD(AllocateMany)
+		{
+			FreeNumberList fn(8);
+			fn.allocate();
+			fn.allocate();
+			fn.deallocate(1);
+
+			uint32 numbers[8];
+			Assert::IsFalse(fn.allocate(8, numbers));
+			Assert::AreEqual(1u, fn.getNumAllocated());
+			Assert::IsTrue(fn.allocate(7, numbers));
+			const uint32 expected[] = { 1, 3, 4, 5, 6, 7, 8 };
+			for (uint32 i = 0; i < 7; ++i)
+			{
+				Assert::AreEqual(expected[i], numbers[i]);
+			}
+		}
+
+		TEST_METHOD(MinMaxAndClone)
+		{
+			FreeNumberList fn(100000);
+			Assert::AreEqual(0u, fn.getMinAllocated());
+			Assert::AreEqual(0u, fn.getMaxAllocated());
+
+			fn.allocateRange(70000);
+			fn.deallocateRange(1, 5000);
+			fn.deallocateRange(60000, 10001);
+			Assert::AreEqual(5001u, fn.getMinAllocated());
+			Assert::AreEqual(59999u, fn.getMaxAllocated());
+
+			FreeNumberList copy(200000);
+			copy.allocate();
+			FreeNumberList::clone(fn, copy);
+			Assert::AreEqual(fn.getNumAllocated(), copy.getNumAllocated());
+			Assert::AreEqual(5001u, copy.getMinAllocated());
+			Assert::AreEqual(59999u, copy.getMaxAllocated());
+			Assert::AreEqual(1u, copy.allocate());
+			Assert::AreEqual(60000u, copy.allocateRange(5000));
+		}
+
+		// Compare against std::set under random alloc/dealloc/range operations.
+		TEST_METHOD(RandomModelCheck)
+		{
+			const uint32 maxNumber = 5000;
+			FreeNumberList fn(maxNumber);
+			std::set<uint32> model;
+
+			auto smallestFree = [&model]() {
+				uint32 n = 1;
+				for (uint32 x : model) { if (x != n) break; ++n; }
+				return n;
+			};
+			auto firstFitRun = [&model, maxNumber](uint32 count) -> uint32 {
+				uint32 start = 1;
+				for (uint32 x : model)
+				{
+					if (x - start >= count) break;
+					start = x + 1;
+				}
+				return ((uint64)start + count - 1 <= maxNumber) ? start : 0;
+			};
+
+			std::mt19937 rng(7);
+			for (uint32 iter = 0; iter < 20000; ++iter)
+			{
+				const uint32 op = rng() % 4;
+				if (op == 0)
+				{
+					uint32 expected = smallestFree();
+					if (expected > maxNumber) expected = 0;
+					const uint32 n = fn.allocate();
+					Assert::AreEqual(expected, n);
+					if (n != 0) model.insert(n);
+				}
+				else if (op == 1)
+				{
+					const uint32 count = 1 + rng() % 64;
+					const uint32 expected = firstFitRun(count);
+					const uint32 first = fn.allocateRange(count);
+					Assert::AreEqual(expected, first);
+					if (first != 0)
+					{
+						for (uint32 i = 0; i < count; ++i) model.insert(first + i);
+					}
+				}
+				else if (op == 2)
+				{
+					const uint32 n = rng() % (maxNumber + 2);
+					const bool bExpected = model.erase(n) > 0;
+					Assert::AreEqual(bExpected, fn.deallocate(n));
+				}
+				else
+				{
+					const uint32 first = 1 + rng() % maxNumber;
+					const uint32 count = 1 + rng() % 16;
+					bool bExpected = ((uint64)first + count - 1 <= maxNumber);
+					for (uint32 i = 0; bExpected && i < count; ++i) bExpected = model.count(first + i) > 0;
+					Assert::AreEqual(bExpected, fn.deallocateRange(first, count));
+					if (bExpected)
+					{
+						for (uint32 i = 0; i < count; ++i) model.erase(first + i);
+					}
+				}
+
+				Assert::AreEqual((uint32)model.size(), fn.getNumAllocated());
+				Assert::AreEqual(model.empty() ? 0u : *model.begin(), fn.getMinAllocated());
+				Assert::AreEqual(model.empty() ? 0u : *model.rbegin(), fn.getMaxAllocated());
+			}
+		}
+
+		TEST_METHOD(AllocationBenchmark)
+		{
+			const uint32 count = 1000000;
+			std::vector<uint32> numbers(count);
+
+			std::vector<uint32> freeOrder(count);
+			for (uint32 i = 0; i < count; ++i) freeOrder[i] = i;
+			std::shuffle(freeOrder.begin(), freeOrder.end(), std::mt19937(42));
+
+			FreeNumberList fn(0xffffffff);
+			HighFrequencyCounter counter;
+
+			counter.start();
+			for (uint32 i = 0; i < count; ++i) numbers[i] = fn.allocate();
+			float allocElapsed = counter.stopWithMilliseconds();
+
+			// Free half in random order to fragment, then refill.
+			counter.start();
+			for (uint32 i = 0; i < count / 2; ++i) fn.deallocate(numbers[freeOrder[i]]);
+			float freeElapsed = counter.stopWithMilliseconds();
+
+			counter.start();
+			for (uint32 i = 0; i < count / 2; ++i) Assert::IsTrue(fn.allocate() != 0);
+			float refillElapsed = counter.stopWithMilliseconds();
+
+			fn.clear();
+			counter.start();
+			for (uint32 i = 0; i < count / 64; ++i) Assert::IsTrue(fn.allocateRange(64) != 0);
+			float rangeElapsed = counter.stopWithMilliseconds();
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"FreeNumberList %u numbers: alloc %.3f ms, random free %.3f ms, refill %.3f ms, allocateRange(64) %.3f ms\n",
+				count, allocElapsed, freeElapsed, refillElapsed, rangeElapsed);
+			UnitLogger::WriteMessage(msg);
+		}
 	};
 }
@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "core/half_float.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <random>
+#include <limits>
+#include <cmath>
+
+namespace UnitTest
+{
+	static float floatFromBits(uint32 bits)
+	{
+		float value;
+		::memcpy(&value, &bits, 4);
+		return value;
+	}
+
+	TEST_CLASS(TestHalfFloat)
+	{
+	public:
+		TEST_METHOD(KnownValues)
+		{
+			Assert::AreEqual((uint16)0x0000, floatToHalf(0.0f));
+			Assert::AreEqual((uint16)0x8000, floatToHalf(-0.0f));
+			Assert::AreEqual((uint16)0x3c00, floatToHalf(1.0f));
+			Assert::AreEqual((uint16)0xc000, floatToHalf(-2.0f));
+			Assert::AreEqual((uint16)0x3555, floatToHalf(1.0f / 3.0f));
+			Assert::AreEqual((uint16)0x7bff, floatToHalf(65504.0f));
+			Assert::AreEqual((uint16)0x7c00, floatToHalf(65520.0f)); // Rounds up to infinity
+			Assert::AreEqual((uint16)0x7c00, floatToHalf(std::numeric_limits<float>::infinity()));
+			Assert::AreEqual((uint16)0xfc00, floatToHalf(-std::numeric_limits<float>::infinity()));
+			Assert::AreEqual((uint16)0x7e00, floatToHalf(std::numeric_limits<float>::quiet_NaN()));
+
+			// Denormals
+			Assert::AreEqual((uint16)0x0400, floatToHalf(6.10351562e-05f));
+			Assert::AreEqual((uint16)0x0001, floatToHalf(5.96046448e-08f));
+			Assert::AreEqual((uint16)0x0000, floatToHalf(2.0e-08f));
+
+			// Ties round to even.
+			Assert::AreEqual((uint16)0x3c00, floatToHalf(1.0f + std::ldexp(1.0f, -11)));
+			Assert::AreEqual((uint16)0x3c02, floatToHalf(1.0f + 3.0f * std::ldexp(1.0f, -11)));
+			Assert::AreEqual((uint16)0x3c01, floatToHalf(1.0f + std::ldexp(1.0f, -11) + std::ldexp(1.0f, -20)));
+
+			Assert::AreEqual(1.0f, halfToFloat(0x3c00));
+			Assert::AreEqual(-2.0f, halfToFloat(0xc000));
+			Assert::AreEqual(65504.0f, halfToFloat(0x7bff));
+			Assert::AreEqual(5.96046448e-08f, halfToFloat(0x0001));
+			Assert::IsTrue(std::isinf(halfToFloat(0x7c00)));
+			Assert::IsTrue(std::isnan(halfToFloat(0x7e00)));
+		}
+
+		TEST_METHOD(RoundTripAllHalfValues)
+		{
+			for (uint32 h = 0; h < 0x10000; ++h)
+			{
+				const float value = halfToFloat((uint16)h);
+				const bool bNaN = (h & 0x7c00) == 0x7c00 && (h & 0x03ff) != 0;
+				if (bNaN)
+				{
+					Assert::IsTrue(std::isnan(value));
+					Assert::AreEqual((uint16)(0x7e00 | (h & 0x8000)), floatToHalf(value));
+				}
+				else
+				{
+					Assert::AreEqual((uint16)h, floatToHalf(value));
+				}
+			}
+		}
+
+		TEST_METHOD(SIMDSameAsScalar)
+		{
+			// Random bit patterns cover all exponents, plus specials. Count is not a multiple of 8.
+			std::mt19937 rng(1234);
+			std::vector<float> values(1000003);
+			for (float& value : values) value = floatFromBits((uint32)rng());
+			const float specials[] = { 0.0f, -0.0f, 65504.0f, 65519.0f, 65520.0f, 6.10351562e-05f, 6.1e-05f, 2.98e-08f, 2.99e-08f,
+				std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN() };
+			for (size_t i = 0; i < std::size(specials); ++i) values[i * 7] = specials[i];
+
+			std::vector<uint16> halves(values.size());
+			convertFloatToHalf(values.data(), halves.data(), values.size());
+			for (size_t i = 0; i < values.size(); ++i)
+			{
+				if (halves[i] != floatToHalf(values[i]))
+				{
+					Assert::Fail();
+				}
+			}
+
+			std::vector<float> floats(halves.size());
+			convertHalfToFloat(halves.data(), floats.data(), halves.size());
+			for (size_t i = 0; i < halves.size(); ++i)
+			{
+				Assert::AreEqual(halves[i], floatToHalf(floats[i]));
+			}
+		}
+
+		TEST_METHOD(BenchmarkConversion)
+		{
+			const uint32 count = 4096 * 2048 * 4; // A 4K rgba32f image
+			std::vector<float> values(count);
+			for (uint32 i = 0; i < count; ++i) values[i] = 0.001f * (float)(i % 100000);
+			std::vector<uint16> halves(count);
+
+			HighFrequencyCounter counter;
+			counter.start();
+			for (uint32 i = 0; i < count; ++i) halves[i] = floatToHalf(values[i]);
+			const float scalarMs = counter.stopWithMilliseconds();
+			const uint64 checksum = halves[count / 3];
+
+			counter.start();
+			convertFloatToHalf(values.data(), halves.data(), count);
+			const float simdMs = counter.stopWithMilliseconds();
+			Assert::AreEqual(checksum, (uint64)halves[count / 3]);
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"%u floats: scalar %.3f ms, SIMD %.3f ms (%.1fx, %.1f Mfloat/s)\n",
+				count, scalarMs, simdMs, scalarMs / simdMs, 1e-3f * count / simdMs);
+			UnitLogger::WriteMessage(msg);
+		}
+	};
+}
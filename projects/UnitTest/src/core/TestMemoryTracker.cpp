@@ -0,0 +1,150 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "memory/memory_tracker.h"
+#include "memory/custom_new_delete.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <thread>
+#include <map>
+#include <mutex>
+#include <algorithm>
+
+namespace UnitTest
+{
+	// Allocate and free 'count' objects of various sizes in a sliding window.
+	static void allocFreeLoop(uint32 count, EMemoryTag tag)
+	{
+		constexpr uint32 window = 64;
+		void* live[window] = {};
+		for (uint32 i = 0; i < count; ++i)
+		{
+			void*& slot = live[i % window];
+			if (slot != nullptr) ::operator delete(slot);
+			slot = ::operator new(16 + (i % 7) * 24, tag);
+		}
+		for (void* ptr : live)
+		{
+			if (ptr != nullptr) ::operator delete(ptr);
+		}
+	}
+
+	static float runThreads(uint32 numThreads, uint32 countPerThread, void(*fn)(uint32, EMemoryTag))
+	{
+		HighFrequencyCounter counter;
+		counter.start();
+		std::vector<std::thread> threads;
+		for (uint32 i = 0; i < numThreads; ++i)
+		{
+			threads.emplace_back(fn, countPerThread, EMemoryTag::World);
+		}
+		for (std::thread& t : threads) t.join();
+		return counter.stopWithMilliseconds();
+	}
+
+	TEST_CLASS(TestMemoryTracker)
+	{
+	public:
+		TEST_METHOD(TrackAcrossThreads)
+		{
+			MemoryTracker& tracker = MemoryTracker::get();
+			const size_t baseBytes = tracker.getTotalBytes(EMemoryTag::Renderer);
+			const size_t baseCount = tracker.getNumAllocations();
+
+			// Allocate on worker threads, free on this thread after the workers exited.
+			constexpr uint32 numThreads = 4;
+			constexpr uint32 numAllocs = 1000;
+			std::vector<void*> ptrs[numThreads];
+			std::vector<std::thread> threads;
+			for (uint32 t = 0; t < numThreads; ++t)
+			{
+				threads.emplace_back([&ptrs, t]() {
+					for (uint32 i = 0; i < numAllocs; ++i)
+					{
+						ptrs[t].push_back(::operator new(100, EMemoryTag::Renderer));
+					}
+				});
+			}
+			for (std::thread& t : threads) t.join();
+
+			// Vectors of ptrs are tagged Etc, so only count Renderer bytes here.
+			Assert::AreEqual(baseBytes + numThreads * numAllocs * 100, tracker.getTotalBytes(EMemoryTag::Renderer));
+			Assert::IsTrue(tracker.getNumAllocations() >= baseCount + numThreads * numAllocs);
+
+			for (uint32 t = 0; t < numThreads; ++t)
+			{
+				for (void* ptr : ptrs[t]) ::operator delete(ptr);
+			}
+			Assert::AreEqual(baseBytes, tracker.getTotalBytes(EMemoryTag::Renderer));
+		}
+
+		TEST_METHOD(FreeWhileDisabled)
+		{
+			MemoryTracker& tracker = MemoryTracker::get();
+			const size_t baseBytes = tracker.getTotalBytes(EMemoryTag::Renderer);
+
+			void* tracked = ::operator new(256, EMemoryTag::Renderer);
+			tracker.setEnabled(false);
+			void* untracked = ::operator new(512, EMemoryTag::Renderer);
+			Assert::AreEqual(baseBytes + 256, tracker.getTotalBytes(EMemoryTag::Renderer));
+			::operator delete(tracked);
+			tracker.setEnabled(true);
+			::operator delete(untracked);
+
+			Assert::AreEqual(baseBytes, tracker.getTotalBytes(EMemoryTag::Renderer));
+		}
+
+		TEST_METHOD(MultiThreadedBenchmark)
+		{
+			const uint32 numThreads = std::max(2u, std::thread::hardware_concurrency());
+			const uint32 countPerThread = 200000;
+			MemoryTracker& tracker = MemoryTracker::get();
+
+			tracker.setEnabled(false);
+			float offElapsed = runThreads(numThreads, countPerThread, allocFreeLoop);
+			tracker.setEnabled(true);
+			float onElapsed = runThreads(numThreads, countPerThread, allocFreeLoop);
+
+			// Reference: what a single global lock + std::map costs on the same workload.
+			// Allocations themselves are untracked here.
+			static std::mutex referenceLock;
+			static std::map<void*, size_t> referenceTable;
+			tracker.setEnabled(false);
+			float referenceElapsed = runThreads(numThreads, countPerThread, [](uint32 count, EMemoryTag tag) {
+				constexpr uint32 window = 64;
+				void* live[window] = {};
+				for (uint32 i = 0; i < count; ++i)
+				{
+					void*& slot = live[i % window];
+					if (slot != nullptr)
+					{
+						{
+							std::lock_guard<std::mutex> guard(referenceLock);
+							referenceTable.erase(slot);
+						}
+						::operator delete(slot);
+					}
+					const size_t sz = 16 + (i % 7) * 24;
+					slot = ::operator new(sz, tag);
+					std::lock_guard<std::mutex> guard(referenceLock);
+					referenceTable.insert({ slot, sz });
+				}
+				for (void* ptr : live)
+				{
+					std::lock_guard<std::mutex> guard(referenceLock);
+					referenceTable.erase(ptr);
+					::operator delete(ptr);
+				}
+			});
+			tracker.setEnabled(true);
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"%u threads x %u alloc/free: tracker off %.3f ms, tracker on %.3f ms, global lock + std::map %.3f ms\n",
+				numThreads, countPerThread, offElapsed, onElapsed, referenceElapsed);
+			UnitLogger::WriteMessage(msg);
+		}
+	};
+}
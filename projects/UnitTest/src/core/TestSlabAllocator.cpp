@@ -0,0 +1,241 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "memory/slab_allocator.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+namespace UnitTest
+{
+	// Synthetic trace that resembles loading a PBRT scene file:
+	// short-lived token strings, parameter arrays that grow by doubling,
+	// and long-lived shape/material records that survive until the end.
+	struct TraceOp
+	{
+		uint32 slot;  // Index into the live pointer table
+		uint32 size;  // 0 means free
+	};
+
+	static std::vector<TraceOp> buildLoaderTrace(uint32 numStatements, uint32& outNumSlots)
+	{
+		std::mt19937 rng(1234);
+		std::vector<TraceOp> trace;
+		std::vector<uint32> freeSlots;
+		uint32 numSlots = 0;
+		auto newSlot = [&]() -> uint32 {
+			if (freeSlots.empty()) return numSlots++;
+			uint32 s = freeSlots.back();
+			freeSlots.pop_back();
+			return s;
+		};
+		auto release = [&](uint32 s) {
+			trace.push_back({ s, 0 });
+			freeSlots.push_back(s);
+		};
+
+		for (uint32 stmt = 0; stmt < numStatements; ++stmt)
+		{
+			// Tokens of the statement.
+			std::vector<uint32> tokens;
+			const uint32 numTokens = 2 + rng() % 6;
+			for (uint32 i = 0; i < numTokens; ++i)
+			{
+				uint32 s = newSlot();
+				trace.push_back({ s, 16 + (uint32)(rng() % 48) });
+				tokens.push_back(s);
+			}
+			// Parameter list that grows like std::vector<float>.
+			const uint32 numValues = 1 + rng() % 200;
+			uint32 arraySlot = 0;
+			bool hasArray = false;
+			for (uint32 capacity = 1; ; capacity *= 2)
+			{
+				uint32 s = newSlot();
+				trace.push_back({ s, capacity * (uint32)sizeof(float) });
+				if (hasArray) release(arraySlot);
+				arraySlot = s;
+				hasArray = true;
+				if (capacity >= numValues || capacity * sizeof(float) >= SlabAllocator::MAX_BLOCK_SIZE) break;
+			}
+			// Parsed result that outlives the tokens.
+			uint32 recordSlot = newSlot();
+			trace.push_back({ recordSlot, 64 + (uint32)(rng() % 448) });
+
+			for (uint32 s : tokens) release(s);
+			release(arraySlot);
+			// Most records are kept for the scene, some are temporaries.
+			if (rng() % 4 == 0) release(recordSlot);
+		}
+		outNumSlots = numSlots;
+		return trace;
+	}
+
+	TEST_CLASS(TestSlabAllocator)
+	{
+	public:
+		TEST_METHOD(SizeClasses)
+		{
+			size_t prevBlockSize = 0;
+			for (size_t sz = 1; sz <= SlabAllocator::MAX_BLOCK_SIZE; ++sz)
+			{
+				const size_t blockSize = SlabAllocator::getBlockSize(sz);
+				Assert::IsTrue(blockSize >= sz);
+				Assert::IsTrue(blockSize >= prevBlockSize);
+				Assert::AreEqual((size_t)0, blockSize % 16);
+				// Internal waste is at most 25% except for tiny sizes.
+				if (sz > 64) Assert::IsTrue(blockSize * 4 <= sz * 5 + 64);
+				prevBlockSize = blockSize;
+			}
+			Assert::AreEqual(SlabAllocator::MAX_BLOCK_SIZE, SlabAllocator::getBlockSize(SlabAllocator::MAX_BLOCK_SIZE));
+		}
+
+		TEST_METHOD(AllocAndOwns)
+		{
+			std::vector<void*> blocks;
+			for (size_t sz = 1; sz <= SlabAllocator::MAX_BLOCK_SIZE; sz += 7)
+			{
+				void* p = SlabAllocator::alloc(sz);
+				Assert::IsTrue(SlabAllocator::owns(p));
+				Assert::AreEqual((uintptr_t)0, reinterpret_cast<uintptr_t>(p) % 16);
+				std::memset(p, 0xcd, sz);
+				blocks.push_back(p);
+			}
+			// Blocks must not overlap.
+			for (size_t i = 0; i < blocks.size(); ++i)
+			{
+				std::memset(blocks[i], (int)(i & 0xff), 1);
+			}
+			for (size_t i = 0; i < blocks.size(); ++i)
+			{
+				Assert::AreEqual((uint8)(i & 0xff), *static_cast<uint8*>(blocks[i]));
+				SlabAllocator::free(blocks[i]);
+			}
+
+			void* heapPtr = std::malloc(64);
+			Assert::IsFalse(SlabAllocator::owns(heapPtr));
+			std::free(heapPtr);
+			Assert::IsFalse(SlabAllocator::owns(nullptr));
+		}
+
+		TEST_METHOD(ReuseFreedBlock)
+		{
+			void* p0 = SlabAllocator::alloc(100);
+			SlabAllocator::free(p0);
+			void* p1 = SlabAllocator::alloc(110);
+			Assert::IsTrue(p0 == p1, L"Same size class should reuse the block cached by this thread");
+			SlabAllocator::free(p1);
+		}
+
+		TEST_METHOD(CrossThreadFree)
+		{
+			const uint32 count = 20000;
+			std::vector<void*> blocks(count);
+			std::thread producer([&]() {
+				for (uint32 i = 0; i < count; ++i)
+				{
+					blocks[i] = SlabAllocator::alloc(24 + (i % 8) * 16);
+					*static_cast<uint32*>(blocks[i]) = i;
+				}
+			});
+			producer.join();
+
+			std::thread consumer([&]() {
+				for (uint32 i = 0; i < count; ++i)
+				{
+					Assert::AreEqual(i, *static_cast<uint32*>(blocks[i]));
+					SlabAllocator::free(blocks[i]);
+				}
+			});
+			consumer.join();
+
+			// Both threads have exited, so their caches are flushed to central lists
+			// and blocks are served again without new spans.
+			const size_t numSpansBefore = SlabAllocator::getStats().numSpans;
+			for (uint32 i = 0; i < count; ++i)
+			{
+				blocks[i] = SlabAllocator::alloc(24 + (i % 8) * 16);
+			}
+			Assert::AreEqual(numSpansBefore, SlabAllocator::getStats().numSpans);
+			for (uint32 i = 0; i < count; ++i)
+			{
+				SlabAllocator::free(blocks[i]);
+			}
+			SlabAllocator::flushThreadCache();
+		}
+
+		// Replays a loader-like trace on several threads against std::malloc,
+		// and reports slab memory reserved against the peak of live bytes.
+		TEST_METHOD(LoaderTraceBenchmark)
+		{
+			uint32 numSlots = 0;
+			const std::vector<TraceOp> trace = buildLoaderTrace(50000, numSlots);
+
+			auto replay = [&](bool useSlab, size_t* outPeakLiveBytes) {
+				std::vector<void*> slots(numSlots, nullptr);
+				std::vector<uint32> sizes(numSlots, 0);
+				size_t liveBytes = 0, peakLiveBytes = 0;
+				for (const TraceOp& op : trace)
+				{
+					if (op.size != 0)
+					{
+						slots[op.slot] = useSlab ? SlabAllocator::alloc(op.size) : std::malloc(op.size);
+						*static_cast<uint8*>(slots[op.slot]) = 1;
+						sizes[op.slot] = op.size;
+						liveBytes += op.size;
+						peakLiveBytes = std::max(peakLiveBytes, liveBytes);
+					}
+					else
+					{
+						useSlab ? SlabAllocator::free(slots[op.slot]) : std::free(slots[op.slot]);
+						slots[op.slot] = nullptr;
+						liveBytes -= sizes[op.slot];
+					}
+				}
+				for (void* p : slots)
+				{
+					if (p != nullptr) useSlab ? SlabAllocator::free(p) : std::free(p);
+				}
+				if (outPeakLiveBytes != nullptr) *outPeakLiveBytes = peakLiveBytes;
+			};
+
+			const uint32 numThreads = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+			auto runThreads = [&](bool useSlab) -> float {
+				HighFrequencyCounter counter;
+				counter.start();
+				std::vector<std::thread> threads;
+				for (uint32 t = 0; t < numThreads; ++t)
+				{
+					threads.emplace_back([&]() { replay(useSlab, nullptr); });
+				}
+				for (std::thread& thread : threads) thread.join();
+				return counter.stopWithMilliseconds();
+			};
+
+			const size_t reservedBefore = SlabAllocator::getStats().reservedBytes;
+			size_t peakLiveBytes = 0;
+			replay(true, &peakLiveBytes);
+			SlabAllocator::flushThreadCache();
+			const size_t reservedForOneReplay = SlabAllocator::getStats().reservedBytes - reservedBefore;
+
+			const float mallocMs = runThreads(false);
+			const float slabMs = runThreads(true);
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"Loader trace: %zu ops x %u threads, std::malloc %.2f ms, slab %.2f ms\n",
+				trace.size(), numThreads, mallocMs, slabMs);
+			UnitLogger::WriteMessage(msg);
+			swprintf_s(msg, L"Loader trace: peak live %.1f KiB, slab newly reserved %.1f KiB for one replay\n",
+				(float)peakLiveBytes / 1024.0f, (float)reservedForOneReplay / 1024.0f);
+			UnitLogger::WriteMessage(msg);
+		}
+	};
+}
@@ -0,0 +1,169 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "core/slot_map.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <algorithm>
+#include <random>
+
+namespace UnitTest
+{
+	TEST_CLASS(TestSlotMap)
+	{
+	public:
+		TEST_METHOD(InsertAndFind)
+		{
+			SlotMap<int32> map;
+			SlotHandle h1 = map.insert(10);
+			SlotHandle h2 = map.insert(20);
+			SlotHandle h3 = map.insert(30);
+
+			Assert::AreEqual((size_t)3, map.size());
+			Assert::AreEqual(10, *map.find(h1));
+			Assert::AreEqual(20, *map.find(h2));
+			Assert::AreEqual(30, *map.find(h3));
+
+			int32 sum = 0;
+			for (int32 x : map) sum += x;
+			Assert::AreEqual(60, sum);
+		}
+
+		TEST_METHOD(StaleHandleAfterRemove)
+		{
+			SlotMap<int32> map;
+			SlotHandle h1 = map.insert(10);
+			SlotHandle h2 = map.insert(20);
+
+			Assert::IsTrue(map.remove(h1));
+			Assert::IsFalse(map.contains(h1));
+			Assert::IsTrue(map.find(h1) == nullptr);
+			Assert::IsFalse(map.remove(h1), L"Removed the same handle twice");
+
+			// Other handles must survive the swap-remove.
+			Assert::AreEqual(20, *map.find(h2));
+
+			// Slot is reused but the old handle must stay invalid.
+			SlotHandle h3 = map.insert(30);
+			Assert::AreEqual(h1.index, h3.index);
+			Assert::IsTrue(h1 != h3);
+			Assert::IsTrue(map.find(h1) == nullptr);
+			Assert::AreEqual(30, *map.find(h3));
+		}
+
+		TEST_METHOD(StaleHandleAfterClear)
+		{
+			SlotMap<int32> map;
+			std::vector<SlotHandle> handles;
+			for (int32 i = 0; i < 16; ++i) handles.push_back(map.insert(i));
+			map.clear();
+			Assert::IsTrue(map.empty());
+			for (SlotHandle h : handles)
+			{
+				Assert::IsFalse(map.contains(h));
+			}
+			SlotHandle h = map.insert(100);
+			Assert::AreEqual(100, *map.find(h));
+			Assert::AreEqual((size_t)1, map.size());
+		}
+
+		TEST_METHOD(DefaultHandleIsInvalid)
+		{
+			SlotMap<int32> map;
+			map.insert(1);
+			SlotHandle h;
+			Assert::IsFalse(h.isValid());
+			Assert::IsFalse(map.contains(h));
+			Assert::IsFalse(map.remove(h));
+		}
+
+		TEST_METHOD(RandomChurnMatchesReference)
+		{
+			SlotMap<uint32> map;
+			std::vector<std::pair<SlotHandle, uint32>> alive;
+			std::vector<SlotHandle> dead;
+
+			std::mt19937 rng(1234);
+			uint32 nextValue = 0;
+			for (uint32 i = 0; i < 20000; ++i)
+			{
+				if (alive.empty() || (rng() % 3) != 0)
+				{
+					SlotHandle h = map.insert(nextValue);
+					alive.push_back({ h, nextValue });
+					++nextValue;
+				}
+				else
+				{
+					size_t victim = rng() % alive.size();
+					Assert::IsTrue(map.remove(alive[victim].first));
+					dead.push_back(alive[victim].first);
+					alive[victim] = alive.back();
+					alive.pop_back();
+				}
+			}
+
+			Assert::AreEqual(alive.size(), map.size());
+			for (const auto& it : alive)
+			{
+				const uint32* value = map.find(it.first);
+				Assert::IsTrue(value != nullptr);
+				Assert::AreEqual(it.second, *value);
+			}
+			for (SlotHandle h : dead)
+			{
+				Assert::IsFalse(map.contains(h));
+			}
+			for (size_t i = 0; i < map.size(); ++i)
+			{
+				Assert::AreEqual(map[i], *map.find(map.getHandle(i)));
+			}
+		}
+
+		// Spawn and despawn many objects, compared against vector + std::find removal.
+		TEST_METHOD(ChurnBenchmark)
+		{
+			const uint32 numObjects = 20000;
+			const uint32 numRounds = 4;
+
+			std::vector<uint32> removeOrder(numObjects);
+			for (uint32 i = 0; i < numObjects; ++i) removeOrder[i] = i;
+			std::shuffle(removeOrder.begin(), removeOrder.end(), std::mt19937(42));
+
+			HighFrequencyCounter counter;
+
+			counter.start();
+			{
+				SlotMap<uint32> map;
+				std::vector<SlotHandle> handles(numObjects);
+				for (uint32 round = 0; round < numRounds; ++round)
+				{
+					for (uint32 i = 0; i < numObjects; ++i) handles[i] = map.insert(i);
+					for (uint32 i : removeOrder) map.remove(handles[i]);
+				}
+				Assert::IsTrue(map.empty());
+			}
+			float slotMapElapsed = counter.stopWithMilliseconds();
+
+			counter.start();
+			{
+				std::vector<uint32> vec;
+				for (uint32 round = 0; round < numRounds; ++round)
+				{
+					for (uint32 i = 0; i < numObjects; ++i) vec.push_back(i);
+					for (uint32 i : removeOrder) vec.erase(std::find(vec.begin(), vec.end(), i));
+				}
+				Assert::IsTrue(vec.empty());
+			}
+			float vectorElapsed = counter.stopWithMilliseconds();
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"Churn %u objects x %u rounds: SlotMap %.3f ms, vector+find %.3f ms\n",
+				numObjects, numRounds, slotMapElapsed, vectorElapsed);
+			UnitLogger::WriteMessage(msg);
+		}
+	};
+}
@@ -0,0 +1,64 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+#include "core/thread_pool.h"
+
+#include <vector>
+#include <atomic>
+
+namespace UnitTest
+{
+	TEST_CLASS(TestThreadPool)
+	{
+	public:
+		TEST_METHOD(EachChunkOnce)
+		{
+			ThreadPool threadPool(3);
+			Assert::AreEqual(4u, threadPool.getNumThreads());
+
+			const uint32 count = 10000;
+			const uint32 grainSize = 64;
+			std::vector<std::atomic<uint32>> visits(count);
+			std::vector<uint32> chunkBegins(ThreadPool::getNumChunks(count, grainSize), 0xffffffff);
+
+			// Reuse the pool for many small jobs.
+			for (uint32 round = 0; round < 50; ++round)
+			{
+				threadPool.parallelFor(count, grainSize, [&](uint32 chunkIx, uint32 begin, uint32 end)
+				{
+					chunkBegins[chunkIx] = begin;
+					for (uint32 i = begin; i < end; ++i)
+					{
+						visits[i].fetch_add(1, std::memory_order_relaxed);
+					}
+				});
+			}
+			for (uint32 i = 0; i < count; ++i)
+			{
+				Assert::AreEqual(50u, visits[i].load());
+			}
+			for (uint32 i = 0; i < (uint32)chunkBegins.size(); ++i)
+			{
+				Assert::AreEqual(i * grainSize, chunkBegins[i]);
+			}
+		}
+
+		TEST_METHOD(NoWorkers)
+		{
+			ThreadPool threadPool(0);
+			Assert::AreEqual(1u, threadPool.getNumThreads());
+
+			std::vector<uint32> order;
+			threadPool.parallelForChunks(5, [&order](uint32 chunkIx) { order.push_back(chunkIx); });
+			Assert::AreEqual((size_t)5, order.size());
+			for (uint32 i = 0; i < 5; ++i)
+			{
+				Assert::AreEqual(i, order[i]);
+			}
+
+			// Empty loops are fine.
+			threadPool.parallelFor(0, 16, [](uint32, uint32, uint32) { Assert::Fail(); });
+		}
+	};
+}
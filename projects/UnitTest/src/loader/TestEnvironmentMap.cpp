@@ -0,0 +1,490 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "loader/environment_map.h"
+#include "loader/hdr_image_loader.h"
+#include "core/half_float.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
+#include "core/cymath.h"
+
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <fstream>
+#include <filesystem>
+
+namespace UnitTest
+{
+	static std::vector<float> makeEquirect(uint32 width, uint32 height, vec3 (*radianceFn)(const vec3&))
+	{
+		std::vector<float> image(4 * uint64(width) * height);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			for (uint32 x = 0; x < width; ++x)
+			{
+				const vec3 L = radianceFn(equirectUVToDirection((x + 0.5f) / width, (y + 0.5f) / height));
+				float* p = &image[4 * (uint64(y) * width + x)];
+				p[0] = L.x; p[1] = L.y; p[2] = L.z; p[3] = 1.0f;
+			}
+		}
+		return image;
+	}
+
+	static vec3 constantRadiance(const vec3& dir) { return vec3(2.0f, 1.0f, 0.5f); }
+	static vec3 linearRadiance(const vec3& dir) { return vec3(1.0f) + vec3(0.5f * dir.x, 0.25f * dir.y, -0.5f * dir.z); }
+
+	// Dim sky with a small sun, the usual case for importance sampling.
+	static const vec3 kSunDirection = normalize(vec3(0.3f, 0.8f, -0.5f));
+	static vec3 sunAndSkyRadiance(const vec3& dir)
+	{
+		const float sky = 0.2f + 0.3f * std::max(0.0f, dir.y);
+		return vec3(sky) + (dot(dir, kSunDirection) > 0.998f ? vec3(5000.0f) : vec3(0.0f));
+	}
+
+	static vec3 loadTexel(const MipChain& cube, uint32 mip, uint32 face, uint32 x, uint32 y)
+	{
+		const float* p = reinterpret_cast<const float*>(cube.getSliceData(mip, face) + y * cube.levels[mip].rowPitch) + 4 * x;
+		return vec3(p[0], p[1], p[2]);
+	}
+
+	static bool nearlyEqual(const vec3& a, const vec3& b, float tolerance)
+	{
+		return std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance && std::abs(a.z - b.z) <= tolerance;
+	}
+
+	// Scanline EXR with R, G, B channels of the given type. compression 0 is NONE, 1 is RLE of literal runs.
+	static std::vector<uint8> makeTestEXR(uint32 width, uint32 height, const std::vector<float>& rgb, bool bHalf, uint8 compression)
+	{
+		std::vector<uint8> out;
+		auto append = [&](const void* data, size_t size) { out.insert(out.end(), (const uint8*)data, (const uint8*)data + size); };
+		auto appendInt = [&](int32 value) { append(&value, 4); };
+		auto appendString = [&](const char* str) { append(str, strlen(str) + 1); };
+
+		appendInt(20000630);
+		appendInt(2);
+
+		appendString("channels"); appendString("chlist"); appendInt(3 * 18 + 1);
+		for (const char* name : { "B", "G", "R" })
+		{
+			appendString(name);
+			appendInt(bHalf ? 1 : 2);
+			appendInt(0);
+			appendInt(1);
+			appendInt(1);
+		}
+		out.push_back(0);
+		appendString("compression"); appendString("compression"); appendInt(1); out.push_back(compression);
+		appendString("dataWindow"); appendString("box2i"); appendInt(16);
+		appendInt(0); appendInt(0); appendInt((int32)width - 1); appendInt((int32)height - 1);
+		appendString("lineOrder"); appendString("lineOrder"); appendInt(1); out.push_back(0);
+		out.push_back(0);
+
+		const size_t offsetTable = out.size();
+		out.resize(out.size() + 8 * height);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			std::vector<uint8> line;
+			for (int32 c = 2; c >= 0; --c)
+			{
+				for (uint32 x = 0; x < width; ++x)
+				{
+					const float value = rgb[3 * (y * width + x) + c];
+					const uint16 half = floatToHalf(value);
+					const uint8* bytes = bHalf ? (const uint8*)&half : (const uint8*)&value;
+					line.insert(line.end(), bytes, bytes + (bHalf ? 2 : 4));
+				}
+			}
+			if (compression == 1)
+			{
+				// Undo the interleave and predictor, then emit literal runs.
+				std::vector<uint8> split(line.size());
+				const size_t half = (line.size() + 1) / 2;
+				for (size_t i = 0; i < line.size(); ++i)
+				{
+					split[(i & 1) ? half + i / 2 : i / 2] = line[i];
+				}
+				std::vector<uint8> deltas(split.size());
+				deltas[0] = split[0];
+				for (size_t i = 1; i < split.size(); ++i) deltas[i] = (uint8)(split[i] - split[i - 1] + 128);
+				std::vector<uint8> packed;
+				for (size_t i = 0; i < deltas.size(); i += 127)
+				{
+					const size_t count = std::min<size_t>(127, deltas.size() - i);
+					packed.push_back((uint8)(-(int8)count));
+					packed.insert(packed.end(), deltas.begin() + i, deltas.begin() + i + count);
+				}
+				line = packed;
+			}
+
+			const uint64 offset = out.size();
+			::memcpy(out.data() + offsetTable + 8 * y, &offset, 8);
+			appendInt((int32)y);
+			appendInt((int32)line.size());
+			append(line.data(), line.size());
+		}
+		return out;
+	}
+
+	TEST_CLASS(TestEnvironmentMap)
+	{
+	public:
+		TEST_METHOD(Directions)
+		{
+			Assert::IsTrue(nearlyEqual(vec3(1, 0, 0), cubeTexelToDirection(0, 0.5f, 0.5f), 1e-6f));
+			Assert::IsTrue(nearlyEqual(vec3(-1, 0, 0), cubeTexelToDirection(1, 0.5f, 0.5f), 1e-6f));
+			Assert::IsTrue(nearlyEqual(vec3(0, 1, 0), cubeTexelToDirection(2, 0.5f, 0.5f), 1e-6f));
+			Assert::IsTrue(nearlyEqual(vec3(0, -1, 0), cubeTexelToDirection(3, 0.5f, 0.5f), 1e-6f));
+			Assert::IsTrue(nearlyEqual(vec3(0, 0, 1), cubeTexelToDirection(4, 0.5f, 0.5f), 1e-6f));
+			Assert::IsTrue(nearlyEqual(vec3(0, 0, -1), cubeTexelToDirection(5, 0.5f, 0.5f), 1e-6f));
+			// Top row of side faces looks up.
+			Assert::IsTrue(cubeTexelToDirection(4, 0.5f, 0.0f).y > 0.5f);
+
+			Assert::IsTrue(nearlyEqual(vec3(0, 0, -1), equirectUVToDirection(0.5f, 0.5f), 1e-6f));
+			Assert::IsTrue(nearlyEqual(vec3(0, 1, 0), equirectUVToDirection(0.3f, 0.0f), 1e-6f));
+			Assert::IsTrue(nearlyEqual(vec3(1, 0, 0), equirectUVToDirection(0.75f, 0.5f), 1e-6f));
+
+			std::mt19937 rng(7);
+			std::uniform_real_distribution<float> dist(0.01f, 0.99f);
+			for (uint32 i = 0; i < 1000; ++i)
+			{
+				const uint32 face = i % 6;
+				const float u = dist(rng), v = dist(rng);
+				uint32 outFace;
+				float outU, outV;
+				directionToCubeTexel(cubeTexelToDirection(face, u, v), outFace, outU, outV);
+				Assert::AreEqual(face, outFace);
+				Assert::AreEqual(u, outU, 1e-5f);
+				Assert::AreEqual(v, outV, 1e-5f);
+
+				directionToEquirectUV(equirectUVToDirection(u, v), outU, outV);
+				Assert::AreEqual(u, outU, 1e-5f);
+				Assert::AreEqual(v, outV, 1e-5f);
+			}
+
+			for (uint32 faceSize : { 1u, 7u, 64u })
+			{
+				double sum = 0.0;
+				for (uint32 y = 0; y < faceSize; ++y)
+				{
+					for (uint32 x = 0; x < faceSize; ++x) sum += calcCubeTexelSolidAngle(x, y, faceSize);
+				}
+				Assert::AreEqual(4.0 * Cymath::PI / 6.0, sum, 1e-5);
+			}
+		}
+
+		TEST_METHOD(ConstantEnvironment)
+		{
+			const uint32 width = 256, height = 128;
+			std::vector<float> image = makeEquirect(width, height, constantRadiance);
+			const vec3 expected = constantRadiance(vec3(0.0f));
+
+			MipChain cube, irradiance, specular;
+			convertEquirectToCube(image.data(), width, height, 32, 2, cube);
+			generateCubeMips(cube);
+			Assert::AreEqual(6u, cube.getNumLevels());
+			prefilterIrradiance(cube, 8, irradiance);
+			prefilterSpecular(cube, 16, 5, 32, specular);
+			Assert::AreEqual(5u, specular.getNumLevels());
+
+			for (const MipChain* chain : { &cube, &irradiance, &specular })
+			{
+				for (uint32 mip = 0; mip < chain->getNumLevels(); ++mip)
+				{
+					for (uint32 face = 0; face < 6; ++face)
+					{
+						const MipChain::Level& level = chain->levels[mip];
+						for (uint32 y = 0; y < level.height; ++y)
+						{
+							for (uint32 x = 0; x < level.width; ++x)
+							{
+								Assert::IsTrue(nearlyEqual(expected, loadTexel(*chain, mip, face, x, y), 2e-3f));
+							}
+						}
+					}
+				}
+			}
+
+			// Luminance is constant, so the distribution is close to uniform over the sphere
+			// and the average of 1 / pdf is the area of the sphere.
+			EnvironmentLuminanceCDF cdf;
+			cdf.build(image.data(), width, height, 1024);
+			std::mt19937 rng(3);
+			std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+			const uint32 numSamples = 100000;
+			double sumInvPdf = 0.0;
+			for (uint32 i = 0; i < numSamples; ++i)
+			{
+				float pdf;
+				const vec3 dir = cdf.sample(dist(rng), dist(rng), pdf);
+				Assert::AreEqual(1.0f, dir.length(), 1e-4f);
+				Assert::AreEqual(pdf, cdf.pdf(dir), 0.01f * pdf);
+				sumInvPdf += 1.0 / pdf;
+				if (std::abs(dir.y) < 0.7f)
+				{
+					Assert::AreEqual(1.0f / (4.0f * Cymath::PI), pdf, 0.02f / (4.0f * Cymath::PI));
+				}
+			}
+			Assert::AreEqual(4.0 * Cymath::PI, sumInvPdf / numSamples, 0.01 * 4.0 * Cymath::PI);
+		}
+
+		TEST_METHOD(OrientationAndIrradiance)
+		{
+			const uint32 width = 512, height = 256;
+			std::vector<float> image = makeEquirect(width, height, linearRadiance);
+
+			MipChain cube, irradiance;
+			convertEquirectToCube(image.data(), width, height, 64, 2, cube);
+			for (uint32 face = 0; face < 6; ++face)
+			{
+				for (uint32 y = 0; y < 64; y += 7)
+				{
+					for (uint32 x = 0; x < 64; x += 7)
+					{
+						const vec3 dir = cubeTexelToDirection(face, (x + 0.5f) / 64, (y + 0.5f) / 64);
+						Assert::IsTrue(nearlyEqual(linearRadiance(dir), loadTexel(cube, 0, face, x, y), 0.01f));
+					}
+				}
+			}
+
+			// For L = a + b.n, irradiance / pi is a + (2/3) b.n exactly.
+			generateCubeMips(cube);
+			prefilterIrradiance(cube, 16, irradiance);
+			for (uint32 face = 0; face < 6; ++face)
+			{
+				for (uint32 y = 0; y < 16; y += 3)
+				{
+					for (uint32 x = 0; x < 16; x += 3)
+					{
+						const vec3 n = cubeTexelToDirection(face, (x + 0.5f) / 16, (y + 0.5f) / 16);
+						const vec3 expected = vec3(1.0f) + (2.0f / 3.0f) * (linearRadiance(n) - vec3(1.0f));
+						Assert::IsTrue(nearlyEqual(expected, loadTexel(irradiance, 0, face, x, y), 0.01f));
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(ParallelSameAsSerial)
+		{
+			ThreadPool threadPool(3);
+			const uint32 width = 300, height = 150;
+			std::vector<float> image = makeEquirect(width, height, sunAndSkyRadiance);
+
+			MipChain cube[2], irradiance[2], specular[2], halfCube[2];
+			EnvironmentLuminanceCDF cdf[2];
+			for (uint32 pass = 0; pass < 2; ++pass)
+			{
+				ThreadPool* pool = (pass == 0) ? nullptr : &threadPool;
+				convertEquirectToCube(image.data(), width, height, 32, 2, cube[pass], pool);
+				generateCubeMips(cube[pass], pool);
+				prefilterIrradiance(cube[pass], 8, irradiance[pass], pool);
+				prefilterSpecular(cube[pass], 16, 4, 16, specular[pass], pool);
+				convertCubeToHalf(cube[pass], halfCube[pass], pool);
+				cdf[pass].build(image.data(), width, height, 100, pool);
+			}
+			Assert::IsTrue(cube[0].data == cube[1].data);
+			Assert::IsTrue(irradiance[0].data == irradiance[1].data);
+			Assert::IsTrue(specular[0].data == specular[1].data);
+			Assert::IsTrue(halfCube[0].data == halfCube[1].data);
+			Assert::IsTrue(cdf[0].conditionalCdf == cdf[1].conditionalCdf);
+			Assert::IsTrue(cdf[0].marginalCdf == cdf[1].marginalCdf);
+
+			// 300 is reduced by blocks of 3.
+			Assert::AreEqual(100u, cdf[0].width);
+			Assert::AreEqual(50u, cdf[0].height);
+			Assert::IsTrue(halfCube[0].format == EPixelFormat::R16G16B16A16_FLOAT);
+			Assert::AreEqual(cube[0].levels[1].offset / 2, halfCube[0].levels[1].offset);
+		}
+
+		TEST_METHOD(ReadEXR)
+		{
+			const uint32 width = 7, height = 5;
+			std::vector<float> rgb(3 * width * height);
+			for (uint32 i = 0; i < rgb.size(); ++i) rgb[i] = 0.25f * (float)i - 3.0f;
+
+			for (bool bHalf : { true, false })
+			{
+				for (uint8 compression : { (uint8)0, (uint8)1 })
+				{
+					const std::vector<uint8> file = makeTestEXR(width, height, rgb, bHalf, compression);
+					HDRImageLoadData* image = HDRImageLoader::loadEXRFromMemory(file.data(), file.size(), true);
+					Assert::IsNotNull(image);
+					Assert::AreEqual(width, image->width);
+					Assert::AreEqual(height, image->height);
+					Assert::AreEqual(3u, image->numFileComponents);
+					for (uint32 y = 0; y < height; ++y)
+					{
+						for (uint32 x = 0; x < width; ++x)
+						{
+							// Flipped vertically
+							const float* p = &image->pixels[4 * ((height - 1 - y) * width + x)];
+							for (uint32 c = 0; c < 3; ++c)
+							{
+								Assert::AreEqual(rgb[3 * (y * width + x) + c], p[c]);
+							}
+							Assert::AreEqual(1.0f, p[3]);
+						}
+					}
+					delete image;
+
+					// Truncated
+					Assert::IsNull(HDRImageLoader::loadEXRFromMemory(file.data(), file.size() - 3));
+				}
+			}
+		}
+
+		TEST_METHOD(SamplingVarianceReduction)
+		{
+			// Irradiance at an upward normal: E = integral of L * max(0, n.l).
+			const uint32 width = 1024, height = 512;
+			std::vector<float> image = makeEquirect(width, height, sunAndSkyRadiance);
+			const vec3 n(0.0f, 1.0f, 0.0f);
+			auto radiance = [&](const vec3& dir)
+			{
+				float u, v;
+				directionToEquirectUV(dir, u, v);
+				const uint32 x = std::min((uint32)(u * width), width - 1), y = std::min((uint32)(v * height), height - 1);
+				return image[4 * (uint64(y) * width + x) + 1];
+			};
+
+			double reference = 0.0;
+			for (uint32 y = 0; y < height; ++y)
+			{
+				const float v = (y + 0.5f) / height;
+				const double solidAngle = (2.0 * Cymath::PI / width) * (Cymath::PI / height) * std::sin(Cymath::PI * v);
+				for (uint32 x = 0; x < width; ++x)
+				{
+					const vec3 dir = equirectUVToDirection((x + 0.5f) / width, v);
+					reference += image[4 * (uint64(y) * width + x) + 1] * std::max(0.0f, dot(n, dir)) * solidAngle;
+				}
+			}
+
+			HighFrequencyCounter counter;
+			counter.start();
+			EnvironmentLuminanceCDF cdf;
+			cdf.build(image.data(), width, height, width);
+			const float buildMs = counter.stopWithMilliseconds();
+
+			const uint32 numSamples = 256, numTrials = 200;
+			std::mt19937 rng(11);
+			std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+			double mean[2] = { 0.0, 0.0 }, variance[2] = { 0.0, 0.0 };
+			for (uint32 trial = 0; trial < numTrials; ++trial)
+			{
+				double estimate[2] = { 0.0, 0.0 };
+				for (uint32 i = 0; i < numSamples; ++i)
+				{
+					// Uniform sphere
+					const float z = 1.0f - 2.0f * dist(rng), phi = 2.0f * Cymath::PI * dist(rng);
+					const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+					const vec3 uniformDir(r * std::cos(phi), z, r * std::sin(phi));
+					estimate[0] += radiance(uniformDir) * std::max(0.0f, dot(n, uniformDir)) * (4.0f * Cymath::PI);
+
+					// Luminance
+					float pdf;
+					const vec3 dir = cdf.sample(dist(rng), dist(rng), pdf);
+					if (pdf > 0.0f)
+					{
+						estimate[1] += radiance(dir) * std::max(0.0f, dot(n, dir)) / pdf;
+					}
+				}
+				for (uint32 k = 0; k < 2; ++k)
+				{
+					estimate[k] /= numSamples;
+					mean[k] += estimate[k] / numTrials;
+					variance[k] += estimate[k] * estimate[k] / numTrials;
+				}
+			}
+			for (uint32 k = 0; k < 2; ++k) variance[k] -= mean[k] * mean[k];
+
+			Assert::AreEqual(reference, mean[1], 0.02 * reference);
+			Assert::AreEqual(reference, mean[0], 0.2 * reference);
+			Assert::IsTrue(variance[1] * 100.0 < variance[0]);
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"Irradiance %.3f: uniform %.3f (variance %.3f), luminance cdf %.3f (variance %.5f), %.1fx less variance, cdf build %.3f ms\n",
+				reference, mean[0], variance[0], mean[1], variance[1], variance[0] / variance[1], buildMs);
+			UnitLogger::WriteMessage(msg);
+		}
+
+		TEST_METHOD(BenchmarkConversion)
+		{
+			const uint32 width = 4096, height = 2048;
+			std::vector<float> image = makeEquirect(width, height, sunAndSkyRadiance);
+			ThreadPool threadPool(ThreadPool::getDefaultNumWorkers());
+			HighFrequencyCounter counter;
+			wchar_t msg[256];
+
+			MipChain cube[2];
+			float convertMs[2];
+			for (uint32 pass = 0; pass < 2; ++pass)
+			{
+				counter.start();
+				convertEquirectToCube(image.data(), width, height, 1024, 2, cube[pass], pass == 0 ? nullptr : &threadPool);
+				convertMs[pass] = counter.stopWithMilliseconds();
+			}
+			Assert::IsTrue(cube[0].data == cube[1].data);
+			const float megaTexels = 6.0f * 1024 * 1024 * 1e-6f;
+			swprintf_s(msg, L"Equirect %ux%u to 1024^2 cube: serial %.3f ms, parallel %.3f ms (%.1fx, %.1f MTexel/s, %u threads)\n",
+				width, height, convertMs[0], convertMs[1], convertMs[0] / convertMs[1], megaTexels / (1e-3f * convertMs[1]), threadPool.getNumThreads());
+			UnitLogger::WriteMessage(msg);
+
+			MipChain& floatCube = cube[1];
+			MipChain irradiance, specular, halfCube;
+			EnvironmentLuminanceCDF cdf;
+			float stageMs[5];
+			counter.start(); generateCubeMips(floatCube, &threadPool); stageMs[0] = counter.stopWithMilliseconds();
+			counter.start(); prefilterIrradiance(floatCube, 32, irradiance, &threadPool); stageMs[1] = counter.stopWithMilliseconds();
+			counter.start(); prefilterSpecular(floatCube, 128, 6, 64, specular, &threadPool); stageMs[2] = counter.stopWithMilliseconds();
+			counter.start(); convertCubeToHalf(floatCube, halfCube, &threadPool); stageMs[3] = counter.stopWithMilliseconds();
+			counter.start(); cdf.build(image.data(), width, height, 1024, &threadPool); stageMs[4] = counter.stopWithMilliseconds();
+			swprintf_s(msg, L"Mips %.3f ms, irradiance %.3f ms, specular %.3f ms, to half %.3f ms, cdf %.3f ms\n",
+				stageMs[0], stageMs[1], stageMs[2], stageMs[3], stageMs[4]);
+			UnitLogger::WriteMessage(msg);
+		}
+
+		TEST_METHOD(LoadWithCache)
+		{
+			const uint32 width = 64, height = 32;
+			std::vector<float> rgba = makeEquirect(width, height, sunAndSkyRadiance);
+			std::vector<float> rgb(3 * width * height);
+			for (uint32 i = 0; i < width * height; ++i)
+			{
+				for (uint32 c = 0; c < 3; ++c) rgb[3 * i + c] = rgba[4 * i + c];
+			}
+			const std::filesystem::path path = std::filesystem::temp_directory_path() / L"cyseal_test_environment.exr";
+			{
+				const std::vector<uint8> file = makeTestEXR(width, height, rgb, false, 0);
+				std::ofstream fs(path, std::ios::binary | std::ios::trunc);
+				fs.write(reinterpret_cast<const char*>(file.data()), file.size());
+			}
+
+			const EnvironmentMapDesc desc{ .radianceSize = 16, .irradianceSize = 4, .specularSize = 8, .specularNumLevels = 3, .specularNumSamples = 8, .cdfMaxWidth = 32 };
+			EnvironmentMap* envMaps[2];
+			for (uint32 pass = 0; pass < 2; ++pass)
+			{
+				envMaps[pass] = loadEnvironmentMap(path.wstring(), desc, nullptr, false);
+				Assert::IsNotNull(envMaps[pass]);
+			}
+			Assert::IsTrue(envMaps[0]->radiance.format == EPixelFormat::R16G16B16A16_FLOAT);
+			Assert::AreEqual(5u, envMaps[0]->radiance.getNumLevels());
+			Assert::AreEqual(3u, envMaps[0]->specular.getNumLevels());
+			Assert::AreEqual(32u, envMaps[0]->luminanceCDF.width);
+#if ENABLE_TEXTURE_CACHE
+			Assert::IsTrue(envMaps[1]->bFromCache);
+#endif
+			Assert::IsTrue(envMaps[0]->radiance.data == envMaps[1]->radiance.data);
+			Assert::IsTrue(envMaps[0]->irradiance.data == envMaps[1]->irradiance.data);
+			Assert::IsTrue(envMaps[0]->specular.data == envMaps[1]->specular.data);
+			Assert::IsTrue(envMaps[0]->luminanceCDF.conditionalCdf == envMaps[1]->luminanceCDF.conditionalCdf);
+			Assert::IsTrue(envMaps[0]->luminanceCDF.marginalCdf == envMaps[1]->luminanceCDF.marginalCdf);
+
+			delete envMaps[0];
+			delete envMaps[1];
+			std::filesystem::remove(path);
+		}
+	};
+}
@@ -3,10 +3,95 @@
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
 #include "loader/image_loader.h"
+#include "loader/mip_generator.h"
+#include "loader/texture_compressor.h"
 #include "util/resource_finder.h"
+#include "core/assertion.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
 
 namespace UnitTest
 {
+	// Binary PGM with maxval 255.
+	static std::wstring writeTestPGM(const wchar_t* name, uint32 width, uint32 height, const std::vector<uint8>& samples)
+	{
+		const std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+		std::ofstream fs(path, std::ios::binary | std::ios::trunc);
+		const std::string header = "P5\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+		fs.write(header.data(), header.size());
+		fs.write(reinterpret_cast<const char*>(samples.data()), samples.size());
+		return path.wstring();
+	}
+
+	// 16-bit grey PNG with stored (uncompressed) deflate blocks, as stb_image_write only writes 8-bit images.
+	static std::wstring writeTestPNG16(const wchar_t* name, uint32 width, uint32 height, const std::vector<uint16>& samples)
+	{
+		auto appendBE32 = [](std::vector<uint8>& out, uint32 x)
+		{
+			for (int32 shift = 24; shift >= 0; shift -= 8) out.push_back((uint8)(x >> shift));
+		};
+		auto crc32 = [](const uint8* data, size_t size)
+		{
+			uint32 crc = 0xffffffff;
+			for (size_t i = 0; i < size; ++i)
+			{
+				crc ^= data[i];
+				for (uint32 k = 0; k < 8; ++k) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+			}
+			return ~crc;
+		};
+		auto appendChunk = [&](std::vector<uint8>& out, const char* type, const std::vector<uint8>& payload)
+		{
+			appendBE32(out, (uint32)payload.size());
+			const size_t typeOffset = out.size();
+			out.insert(out.end(), type, type + 4);
+			out.insert(out.end(), payload.begin(), payload.end());
+			appendBE32(out, crc32(out.data() + typeOffset, out.size() - typeOffset));
+		};
+
+		// Each row is a filter byte (none) followed by big endian samples.
+		std::vector<uint8> raw;
+		for (uint32 y = 0; y < height; ++y)
+		{
+			raw.push_back(0);
+			for (uint32 x = 0; x < width; ++x)
+			{
+				raw.push_back((uint8)(samples[y * width + x] >> 8));
+				raw.push_back((uint8)(samples[y * width + x] & 0xff));
+			}
+		}
+		CHECK(raw.size() <= 0xffff);
+		uint32 adlerA = 1, adlerB = 0;
+		for (uint8 b : raw)
+		{
+			adlerA = (adlerA + b) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+		std::vector<uint8> zlib = { 0x78, 0x01, 0x01 };
+		const uint16 length = (uint16)raw.size();
+		zlib.insert(zlib.end(), { (uint8)(length & 0xff), (uint8)(length >> 8), (uint8)(~length & 0xff), (uint8)((uint16)~length >> 8) });
+		zlib.insert(zlib.end(), raw.begin(), raw.end());
+		appendBE32(zlib, (adlerB << 16) | adlerA);
+
+		std::vector<uint8> ihdr;
+		appendBE32(ihdr, width);
+		appendBE32(ihdr, height);
+		ihdr.insert(ihdr.end(), { 16, 0, 0, 0, 0 }); // 16-bit, greyscale, deflate, no filter, no interlace
+
+		std::vector<uint8> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+		appendChunk(png, "IHDR", ihdr);
+		appendChunk(png, "IDAT", zlib);
+		appendChunk(png, "IEND", {});
+
+		const std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+		std::ofstream fs(path, std::ios::binary | std::ios::trunc);
+		fs.write(reinterpret_cast<const char*>(png.data()), png.size());
+		return path.wstring();
+	}
+
 	TEST_CLASS(TestImageLoader)
 	{
 	public:
@@ -21,7 +106,7 @@ namespace UnitTest
 			ImageLoadData* imageData = loader.load(L"external/skybox_Footballfield/negx.jpg");
 
 			Assert::IsNotNull(imageData);
-			Assert::IsNotNull(imageData->buffer);
+			Assert::IsNotNull(imageData->getBuffer());
 			Assert::IsTrue(imageData->length > 0);
 			Assert::IsTrue(imageData->width > 0);
 			Assert::IsTrue(imageData->height > 0);
@@ -29,5 +114,101 @@ namespace UnitTest
 
 			delete imageData;
 		}
+
+		TEST_METHOD(NativeGrey)
+		{
+			const uint32 width = 5, height = 3;
+			std::vector<uint8> samples(width * height);
+			for (uint32 i = 0; i < width * height; ++i) samples[i] = (uint8)(i * 17);
+			const std::wstring path = writeTestPGM(L"cyseal_test_grey8.pgm", width, height, samples);
+
+			ImageLoader loader;
+			ImageLoadData* imageData = loader.load(path, false, false, ImageLoadOptions{ .channels = EImageChannels::Native });
+			Assert::IsNotNull(imageData);
+			Assert::AreEqual(1u, imageData->numComponents);
+			Assert::AreEqual(1u, imageData->numFileComponents);
+			Assert::AreEqual(1u, imageData->bytesPerComponent);
+			Assert::AreEqual((uint64)width, imageData->getRowPitch());
+			Assert::IsTrue(imageData->getPixelFormat() == EPixelFormat::R8_UNORM);
+			for (uint32 i = 0; i < width * height; ++i)
+			{
+				Assert::AreEqual(samples[i], imageData->getBuffer()[i]);
+			}
+			delete imageData;
+
+			// Default is still rgba8, with grey replicated.
+			imageData = loader.load(path, false, false);
+			Assert::AreEqual(4u, imageData->numComponents);
+			Assert::AreEqual(1u, imageData->numFileComponents);
+			Assert::IsTrue(imageData->getPixelFormat() == EPixelFormat::R8G8B8A8_UNORM);
+			Assert::AreEqual(samples[3], imageData->getBuffer()[4 * 3 + 1]);
+			Assert::AreEqual((uint8)255, imageData->getBuffer()[4 * 3 + 3]);
+			delete imageData;
+
+			// Forced to grey and alpha.
+			imageData = loader.load(path, false, false, ImageLoadOptions{ .channels = EImageChannels::RG });
+			Assert::IsTrue(imageData->getPixelFormat() == EPixelFormat::R8G8_UNORM);
+			Assert::AreEqual((uint64)(2 * width * height), imageData->getSlicePitch());
+			delete imageData;
+
+			std::filesystem::remove(path);
+		}
+
+		TEST_METHOD(Grey16Bit)
+		{
+			const uint32 width = 4, height = 4;
+			std::vector<uint16> samples(width * height);
+			for (uint32 i = 0; i < width * height; ++i) samples[i] = (uint16)(i * 4099 + 1);
+			const std::wstring path = writeTestPNG16(L"cyseal_test_grey16.png", width, height, samples);
+
+			ImageLoader loader;
+			ImageLoadData* imageData = loader.load(path, false, false, ImageLoadOptions{ .channels = EImageChannels::R, .bAllow16Bit = true });
+			Assert::IsNotNull(imageData);
+			Assert::AreEqual(2u, imageData->bytesPerComponent);
+			Assert::AreEqual((uint64)(2 * width), imageData->getRowPitch());
+			Assert::IsTrue(imageData->getPixelFormat() == EPixelFormat::R16_UNORM);
+			const uint16* texels = reinterpret_cast<const uint16*>(imageData->getBuffer());
+			for (uint32 i = 0; i < width * height; ++i)
+			{
+				Assert::AreEqual(samples[i], texels[i]);
+			}
+
+			// 16-bit mips stay 16-bit.
+			MipChain chain;
+			generateMipChain(imageData->getBuffer(), imageData->getPixelFormat(), width, height, 0, MipGeneratorDesc{ .filter = EMipFilter::Box }, chain);
+			Assert::IsTrue(chain.format == EPixelFormat::R16_UNORM);
+			Assert::AreEqual(3u, chain.getNumLevels());
+			Assert::AreEqual((uint64)4, chain.levels[1].rowPitch);
+			delete imageData;
+
+			// Converted to 8-bit unless allowed.
+			imageData = loader.load(path, false, false, ImageLoadOptions{ .channels = EImageChannels::R });
+			Assert::AreEqual(1u, imageData->bytesPerComponent);
+			Assert::AreEqual((uint8)(samples[5] >> 8), imageData->getBuffer()[5]);
+			delete imageData;
+
+			std::filesystem::remove(path);
+		}
+
+		TEST_METHOD(GreyMipsAndCompression)
+		{
+			ImageLoadData imageData;
+			imageData.allocate(16, 16, 1);
+			for (uint32 i = 0; i < 16 * 16; ++i) imageData.getBuffer()[i] = 90;
+			Assert::AreEqual(256u, imageData.length);
+
+			MipChain chain, compressed;
+			generateMipChain(imageData.getBuffer(), imageData.getPixelFormat(), 16, 16, 0, MipGeneratorDesc{}, chain);
+			Assert::IsTrue(chain.format == EPixelFormat::R8_UNORM);
+			Assert::AreEqual(5u, chain.getNumLevels());
+			Assert::AreEqual((uint8)90, chain.getLevelData(4)[0]);
+
+			compressMipChain(chain, EPixelFormat::BC4_UNORM, ETextureCompressionQuality::Normal, compressed);
+			// 16x16 is 16 blocks of 8 bytes, a quarter of rgba8.
+			Assert::AreEqual((uint64)128, compressed.levels[0].slicePitch);
+			std::vector<uint8> decoded(4 * 16 * 16);
+			decompressImage(compressed.getLevelData(0), 16, 16, EPixelFormat::BC4_UNORM, decoded.data());
+			Assert::AreEqual((uint8)90, decoded[4 * 37]);
+		}
 	};
 }
@@ -0,0 +1,330 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "loader/image_writer.h"
+#include "loader/image_loader.h"
+#include "loader/hdr_image_loader.h"
+#include "core/half_float.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <random>
+#include <memory>
+#include <cstring>
+
+namespace UnitTest
+{
+	static std::filesystem::path getImageWriterTestDirectory()
+	{
+		return std::filesystem::temp_directory_path() / L"cyseal_image_writer_test";
+	}
+
+	static std::vector<uint8> readFileBytes(const std::filesystem::path& path)
+	{
+		std::ifstream fs(path, std::ios::binary);
+		return std::vector<uint8>(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+	}
+
+	// Gradients with noise and flat areas, so that each PNG filter wins on some rows.
+	static std::vector<uint8> createTestRgba8(uint32 width, uint32 height, uint64 rowPitch, uint32 seed)
+	{
+		std::mt19937 rng(seed);
+		std::vector<uint8> pixels(rowPitch * height, 0xcd);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			uint8* row = pixels.data() + y * rowPitch;
+			for (uint32 x = 0; x < width; ++x)
+			{
+				const bool bFlat = ((x / 16) + (y / 16)) % 3 == 0;
+				row[4 * x + 0] = bFlat ? 40 : (uint8)(x * 255 / width);
+				row[4 * x + 1] = bFlat ? 40 : (uint8)(y * 255 / height);
+				row[4 * x + 2] = bFlat ? 200 : (uint8)((x + y + (rng() & 7)) & 0xff);
+				row[4 * x + 3] = (x % 7 == 0) ? 128 : 255;
+			}
+		}
+		return pixels;
+	}
+
+	static void assertSameRgba8(const ImageLoadData* loaded, const uint8* expected, uint32 width, uint32 height, uint64 rowPitch)
+	{
+		Assert::IsNotNull(loaded);
+		Assert::AreEqual(width, loaded->width);
+		Assert::AreEqual(height, loaded->height);
+		Assert::AreEqual(4u, loaded->numComponents);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			Assert::AreEqual(0, ::memcmp(loaded->getBuffer() + y * loaded->getRowPitch(), expected + y * rowPitch, width * 4));
+		}
+	}
+
+	TEST_CLASS(TestImageWriter)
+	{
+	public:
+		TEST_METHOD(PNGRoundTrip)
+		{
+			const uint32 width = 67, height = 45;
+			const uint64 rowPitch = width * 4 + 12;
+			const std::vector<uint8> pixels = createTestRgba8(width, height, rowPitch, 7);
+			const std::filesystem::path directory = getImageWriterTestDirectory();
+
+			ImageLoader loader;
+			const EImageCompression levels[] = { EImageCompression::None, EImageCompression::Fast, EImageCompression::Default, EImageCompression::Best };
+			std::vector<uint64> fileSizes;
+			for (EImageCompression compression : levels)
+			{
+				std::vector<uint8> file;
+				encodePNG(pixels.data(), width, height, rowPitch, compression, file);
+				const std::filesystem::path path = directory / (L"level" + std::to_wstring((uint32)compression) + L".png");
+				Assert::IsTrue(writeImageFile(path.wstring(), file));
+
+				std::unique_ptr<ImageLoadData> loaded(loader.load(path.wstring(), false, false));
+				assertSameRgba8(loaded.get(), pixels.data(), width, height, rowPitch);
+				fileSizes.push_back(file.size());
+			}
+			// Stored blocks are larger than anything compressed.
+			Assert::IsTrue(fileSizes[0] > fileSizes[1] && fileSizes[0] > fileSizes[2] && fileSizes[0] > fileSizes[3]);
+
+			// Default is byte identical to stb_image_write.
+			std::vector<uint8> file;
+			encodePNG(pixels.data(), width, height, rowPitch, EImageCompression::Default, file);
+			const std::filesystem::path stbPath = directory / L"stb.png";
+			Assert::IsTrue(ImageLoader::saveAsPng(stbPath.wstring(), const_cast<uint8*>(pixels.data()), width, height, rowPitch));
+			Assert::IsTrue(file == readFileBytes(stbPath));
+
+			std::error_code errorCode;
+			std::filesystem::remove_all(directory, errorCode);
+		}
+
+		TEST_METHOD(EXRRoundTrip)
+		{
+			// Height is not a multiple of ZIP blocks.
+			const uint32 width = 29, height = 37;
+			std::mt19937 rng(11);
+			std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+			std::vector<float> pixels(uint64(width) * height * 4);
+			for (uint64 i = 0; i < pixels.size(); ++i)
+			{
+				const float value = distribution(rng);
+				// Mix of HDR, LDR and tiny values, and smooth areas that compress.
+				pixels[i] = (i % 4 == 3) ? 1.0f : ((i / 4) % 5 == 0) ? 1000.0f * value : ((i / 4) % 5 == 1) ? 1e-5f * value : 0.25f;
+			}
+
+			for (bool bHalfFloat : { true, false })
+			{
+				for (EImageCompression compression : { EImageCompression::None, EImageCompression::Fast, EImageCompression::Best })
+				{
+					std::vector<uint8> file;
+					encodeEXR(pixels.data(), width, height, 0, compression, bHalfFloat, file);
+					std::unique_ptr<HDRImageLoadData> loaded(HDRImageLoader::loadEXRFromMemory(file.data(), file.size()));
+					Assert::IsNotNull(loaded.get());
+					Assert::AreEqual(width, loaded->width);
+					Assert::AreEqual(height, loaded->height);
+					Assert::AreEqual(4u, loaded->numFileComponents);
+					for (uint64 i = 0; i < pixels.size(); ++i)
+					{
+						const float expected = bHalfFloat ? halfToFloat(floatToHalf(pixels[i])) : pixels[i];
+						if (loaded->pixels[i] != expected)
+						{
+							Assert::AreEqual(expected, loaded->pixels[i]);
+						}
+					}
+				}
+			}
+
+			// Row pitch larger than a row.
+			const uint64 rowPitch = (width + 3) * 4 * sizeof(float);
+			std::vector<float> padded(rowPitch / sizeof(float) * height, -1.0f);
+			for (uint32 y = 0; y < height; ++y)
+			{
+				::memcpy(padded.data() + y * rowPitch / sizeof(float), pixels.data() + uint64(y) * width * 4, width * 4 * sizeof(float));
+			}
+			std::vector<uint8> tightFile, paddedFile;
+			encodeEXR(pixels.data(), width, height, 0, EImageCompression::Default, true, tightFile);
+			encodeEXR(padded.data(), width, height, rowPitch, EImageCompression::Default, true, paddedFile);
+			Assert::IsTrue(tightFile == paddedFile);
+		}
+
+		TEST_METHOD(AsyncWriterFutures)
+		{
+			const std::filesystem::path directory = getImageWriterTestDirectory() / L"async";
+			const uint32 width = 40, height = 24;
+			const uint32 numImages = 12;
+
+			std::vector<std::future<bool>> futures;
+			std::vector<std::vector<uint8>> expectedImages;
+			{
+				// More images than the queue holds, so that requests block on a full queue.
+				AsyncImageWriter writer(2, 2);
+				for (uint32 i = 0; i < numImages; ++i)
+				{
+					const std::wstring path = (directory / (L"image" + std::to_wstring(i))).wstring();
+					std::vector<uint8> pixels = createTestRgba8(width, height, width * 4, i);
+					expectedImages.push_back(pixels);
+					if (i % 3 == 2)
+					{
+						std::vector<float> hdrPixels(pixels.begin(), pixels.end());
+						futures.push_back(writer.writeEXR(path + L".exr", std::move(hdrPixels), width, height));
+					}
+					else
+					{
+						futures.push_back(writer.writePNG(path + L".png", std::move(pixels), width, height, (EImageCompression)(i % 4)));
+					}
+				}
+
+				// A file can't be a directory.
+				const std::filesystem::path blockingFile = directory / L"notADirectory";
+				std::filesystem::create_directories(directory);
+				std::ofstream(blockingFile) << "x";
+				std::future<bool> failed = writer.writePNG((blockingFile / L"image.png").wstring(), std::vector<uint8>(width * height * 4), width, height);
+
+				writer.flush();
+				for (uint32 i = 0; i < numImages; ++i)
+				{
+					Assert::IsTrue(futures[i].wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+				}
+				Assert::IsFalse(failed.get());
+				// Destructor writes whatever is queued after flush.
+				std::vector<uint8> lastPixels = expectedImages.back();
+				futures.push_back(writer.writePNG((directory / L"last.png").wstring(), std::move(lastPixels), width, height));
+			}
+			for (std::future<bool>& future : futures)
+			{
+				Assert::IsTrue(future.get());
+			}
+
+			ImageLoader loader;
+			HDRImageLoader hdrLoader;
+			for (uint32 i = 0; i < numImages; ++i)
+			{
+				const std::wstring path = (directory / (L"image" + std::to_wstring(i))).wstring();
+				if (i % 3 == 2)
+				{
+					std::unique_ptr<HDRImageLoadData> loaded(hdrLoader.load(path + L".exr", false, false));
+					Assert::IsNotNull(loaded.get());
+					for (uint64 j = 0; j < expectedImages[i].size(); ++j)
+					{
+						Assert::AreEqual((float)expectedImages[i][j], loaded->pixels[j]);
+					}
+				}
+				else
+				{
+					std::unique_ptr<ImageLoadData> loaded(loader.load(path + L".png", false, false));
+					assertSameRgba8(loaded.get(), expectedImages[i].data(), width, height, width * 4);
+				}
+			}
+			std::unique_ptr<ImageLoadData> last(loader.load((directory / L"last.png").wstring(), false, false));
+			assertSameRgba8(last.get(), expectedImages.back().data(), width, height, width * 4);
+
+			std::error_code errorCode;
+			std::filesystem::remove_all(directory, errorCode);
+		}
+
+		TEST_METHOD(BenchmarkSequence4K)
+		{
+			const uint32 width = 3840, height = 2160;
+			const uint32 numFrames = 8;
+			const std::filesystem::path directory = getImageWriterTestDirectory() / L"sequence";
+			std::filesystem::create_directories(directory);
+			const std::vector<uint8> baseFrame = createTestRgba8(width, height, width * 4, 3);
+			const double frameMB = (double)baseFrame.size() / (1024.0 * 1024.0);
+
+			// Frames differ a little, like a camera animation.
+			auto createFrame = [&](uint32 frame)
+			{
+				std::vector<uint8> pixels = baseFrame;
+				for (uint32 y = frame * 64; y < frame * 64 + 256; ++y)
+				{
+					::memset(pixels.data() + uint64(y) * width * 4, (int)(frame * 30), width * 4);
+				}
+				return pixels;
+			};
+			auto getFramePath = [&](const wchar_t* prefix, uint32 frame, const wchar_t* extension)
+			{
+				return (directory / (prefix + std::to_wstring(frame) + extension)).wstring();
+			};
+
+			wchar_t msg[512];
+			HighFrequencyCounter counter;
+
+			// Synchronous baseline, as render tests saved results before.
+			counter.start();
+			for (uint32 frame = 0; frame < 2; ++frame)
+			{
+				std::vector<uint8> pixels = createFrame(frame);
+				Assert::IsTrue(ImageLoader::saveAsPng(getFramePath(L"sync", frame, L".png"), pixels.data(), width, height));
+			}
+			const float syncMs = counter.stopWithMilliseconds() / 2.0f;
+
+			// Encoding cost of each level on the calling thread.
+			const wchar_t* levelNames[] = { L"None", L"Fast", L"Default", L"Best" };
+			for (uint32 level = 0; level < 4; ++level)
+			{
+				std::vector<uint8> file;
+				counter.start();
+				encodePNG(baseFrame.data(), width, height, 0, (EImageCompression)level, file);
+				const float encodeMs = counter.stopWithMilliseconds();
+				swprintf_s(msg, L"PNG %ls: encode %.1f ms (%.1f MB/s), %.2f MB -> %.2f MB\n",
+					levelNames[level], encodeMs, 1000.0 * frameMB / encodeMs, frameMB, file.size() / (1024.0 * 1024.0));
+				UnitLogger::WriteMessage(msg);
+			}
+
+			// The caller only waits while the queue is full.
+			const uint32 numWorkers = std::max(2u, ThreadPool::getDefaultNumWorkers());
+			for (EImageCompression compression : { EImageCompression::Fast, EImageCompression::Default })
+			{
+				float submitMs = 0.0f;
+				HighFrequencyCounter totalCounter;
+				totalCounter.start();
+				{
+					AsyncImageWriter writer(numWorkers, 4);
+					std::vector<std::future<bool>> futures;
+					for (uint32 frame = 0; frame < numFrames; ++frame)
+					{
+						std::vector<uint8> pixels = createFrame(frame);
+						counter.start();
+						futures.push_back(writer.writePNG(getFramePath(L"async", frame, L".png"), std::move(pixels), width, height, compression));
+						submitMs += counter.stopWithMilliseconds();
+					}
+					writer.flush();
+					for (std::future<bool>& future : futures)
+					{
+						Assert::IsTrue(future.get());
+					}
+				}
+				const float totalMs = totalCounter.stopWithMilliseconds();
+				swprintf_s(msg, L"%u frames of %ux%u, %u workers, %ls: sync saveAsPng %.1f ms/frame, async %.1f ms/frame (caller blocked %.1f ms/frame)\n",
+					numFrames, width, height, numWorkers, levelNames[(uint32)compression], syncMs, totalMs / numFrames, submitMs / numFrames);
+				UnitLogger::WriteMessage(msg);
+			}
+
+			// Half float EXR of HDR frames.
+			{
+				std::vector<float> hdrFrame(baseFrame.size());
+				for (uint64 i = 0; i < hdrFrame.size(); ++i) hdrFrame[i] = (float)baseFrame[i] * (4.0f / 255.0f);
+				HighFrequencyCounter totalCounter;
+				totalCounter.start();
+				{
+					AsyncImageWriter writer(numWorkers, 2);
+					for (uint32 frame = 0; frame < 2; ++frame)
+					{
+						std::vector<float> pixels = hdrFrame;
+						writer.writeEXR(getFramePath(L"async", frame, L".exr"), std::move(pixels), width, height, EImageCompression::Fast);
+					}
+				}
+				const float totalMs = totalCounter.stopWithMilliseconds();
+				const uint64 fileSize = std::filesystem::file_size(getFramePath(L"async", 0, L".exr"));
+				swprintf_s(msg, L"EXR half ZIP: %.1f ms/frame, %.2f MB\n", totalMs / 2, fileSize / (1024.0 * 1024.0));
+				UnitLogger::WriteMessage(msg);
+			}
+
+			std::error_code errorCode;
+			std::filesystem::remove_all(getImageWriterTestDirectory(), errorCode);
+		}
+	};
+}
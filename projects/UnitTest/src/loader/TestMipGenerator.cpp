@@ -0,0 +1,224 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "loader/mip_generator.h"
+#include "loader/image_loader.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <cmath>
+#include <filesystem>
+
+namespace UnitTest
+{
+	static std::vector<uint8> makeTestImage(uint32 width, uint32 height)
+	{
+		std::vector<uint8> image(4 * width * height);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			for (uint32 x = 0; x < width; ++x)
+			{
+				uint8* p = &image[4 * (y * width + x)];
+				p[0] = (uint8)((x * 37 + y * 91) & 255);
+				p[1] = (uint8)((x * 53 + y * 29 + 17) & 255);
+				p[2] = (uint8)((x * x * 11 + y * 7) & 255);
+				p[3] = (uint8)((255 - x * 13 - y * 19) & 255);
+			}
+		}
+		return image;
+	}
+
+	// Concentric rings with increasing frequency. Aliases badly if a mip filter is poor.
+	static std::vector<uint8> makeZonePlate(uint32 width, uint32 height)
+	{
+		std::vector<uint8> image(4 * width * height);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			for (uint32 x = 0; x < width; ++x)
+			{
+				const float dx = (float)x - 0.5f * width, dy = (float)y - 0.5f * height;
+				const float v = 0.5f + 0.5f * std::cos(0.002f * (dx * dx + dy * dy));
+				uint8* p = &image[4 * (y * width + x)];
+				p[0] = (uint8)(255.0f * v);
+				p[1] = (uint8)(255.0f * (1.0f - v));
+				p[2] = (uint8)((x ^ y) & 255);
+				p[3] = 255;
+			}
+		}
+		return image;
+	}
+
+	TEST_CLASS(TestMipGenerator)
+	{
+	public:
+		TEST_METHOD(MipLevelSizes)
+		{
+			Assert::AreEqual(1u, calcMipLevelCount(1, 1));
+			Assert::AreEqual(9u, calcMipLevelCount(256, 1));
+			Assert::AreEqual(9u, calcMipLevelCount(511, 300));
+			Assert::AreEqual(10u, calcMipLevelCount(300, 512));
+
+			std::vector<uint8> image = makeTestImage(37, 23);
+			MipChain chain;
+			generateMipChain(image.data(), 37, 23, 0, MipGeneratorDesc{}, chain);
+
+			const uint32 expected[][2] = { { 37, 23 }, { 18, 11 }, { 9, 5 }, { 4, 2 }, { 2, 1 }, { 1, 1 } };
+			Assert::AreEqual(6u, chain.getNumLevels());
+			for (uint32 mip = 0; mip < chain.getNumLevels(); ++mip)
+			{
+				Assert::AreEqual(expected[mip][0], chain.levels[mip].width);
+				Assert::AreEqual(expected[mip][1], chain.levels[mip].height);
+			}
+			const MipChain::Level& last = chain.levels.back();
+			Assert::AreEqual((size_t)(last.offset + last.slicePitch), chain.data.size());
+			Assert::IsTrue(0 == ::memcmp(image.data(), chain.getLevelData(0), image.size()));
+
+			MipGeneratorDesc desc{ .maxMipLevels = 3 };
+			generateMipChain(image.data(), 37, 23, 0, desc, chain);
+			Assert::AreEqual(3u, chain.getNumLevels());
+		}
+
+		TEST_METHOD(SRGBConversion)
+		{
+			for (uint32 code = 0; code < 256; ++code)
+			{
+				Assert::AreEqual((uint8)code, linearToSrgb8(srgb8ToLinear((uint8)code)));
+			}
+			for (uint32 i = 0; i <= 100000; ++i)
+			{
+				const double x = (double)i / 100000.0;
+				const double s = (x <= 0.0031308) ? (12.92 * x) : (1.055 * std::pow(x, 1.0 / 2.4) - 0.055);
+				const int32 expected = (int32)std::floor(s * 255.0 + 0.5);
+				Assert::IsTrue(std::abs(expected - (int32)linearToSrgb8((float)x)) <= 1);
+			}
+			Assert::AreEqual((uint8)0, linearToSrgb8(-1.0f));
+			Assert::AreEqual((uint8)255, linearToSrgb8(2.0f));
+		}
+
+		TEST_METHOD(GammaCorrectBox)
+		{
+			// Black and white checker averages to 0.5 in linear space, which is not 128 in sRGB.
+			const uint8 checker[16] = { 0,0,0,255, 255,255,255,255, 255,255,255,255, 0,0,0,255 };
+			MipChain chain;
+			MipGeneratorDesc desc{ .filter = EMipFilter::Box };
+			generateMipChain(checker, 2, 2, 0, desc, chain);
+			const uint8* mip1 = chain.getLevelData(1);
+			Assert::AreEqual((uint8)188, mip1[0]);
+			Assert::AreEqual((uint8)255, mip1[3]);
+
+			desc.bSRGB = false;
+			generateMipChain(checker, 2, 2, 0, desc, chain);
+			Assert::AreEqual((uint8)128, chain.getLevelData(1)[0]);
+		}
+
+		TEST_METHOD(ConstantImage)
+		{
+			// Weights are normalized, so a constant image stays constant for any size and filter.
+			const uint32 width = 37, height = 23;
+			std::vector<uint8> image(4 * width * height);
+			for (uint32 i = 0; i < width * height; ++i)
+			{
+				image[4 * i + 0] = 200; image[4 * i + 1] = 100; image[4 * i + 2] = 30; image[4 * i + 3] = 77;
+			}
+			for (EMipFilter filter : { EMipFilter::Box, EMipFilter::Kaiser, EMipFilter::Lanczos })
+			{
+				for (EMipAddressMode addressMode : { EMipAddressMode::Wrap, EMipAddressMode::Clamp })
+				{
+					MipChain chain;
+					generateMipChain(image.data(), width, height, 0, MipGeneratorDesc{ .filter = filter, .addressMode = addressMode }, chain);
+					for (size_t i = 0; i < chain.data.size(); ++i)
+					{
+						Assert::AreEqual(image[i % 4], chain.data[i]);
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(GoldenImages)
+		{
+			// 7x5 -> 3x2 -> 1x1 of makeTestImage(7, 5), wrap addressing.
+			// Generated by an independent double precision implementation. Float rounding may differ by 1.
+			const uint8 golden[3][28] = {
+				{ 119,91,21,231, 153,174,124,201, 154,98,122,171, 128,155,37,185, 142,147,140,155, 155,142,136,125, 143,139,110,178 },
+				{ 122,111,6,219, 157,173,123,194, 146,94,130,169, 133,165,26,187, 135,151,133,162, 157,114,140,137, 143,139,110,178 },
+				{ 122,111,4,220, 157,173,122,194, 146,94,130,169, 133,165,25,187, 136,151,133,162, 157,114,140,136, 143,139,110,178 },
+			};
+			const EMipFilter filters[3] = { EMipFilter::Box, EMipFilter::Kaiser, EMipFilter::Lanczos };
+
+			std::vector<uint8> image = makeTestImage(7, 5);
+			for (uint32 i = 0; i < 3; ++i)
+			{
+				MipChain chain;
+				generateMipChain(image.data(), 7, 5, 0, MipGeneratorDesc{ .filter = filters[i] }, chain);
+				Assert::AreEqual(3u, chain.getNumLevels());
+				Assert::AreEqual((size_t)28, chain.data.size() - chain.levels[1].offset);
+				const uint8* actual = chain.getLevelData(1);
+				for (uint32 j = 0; j < 28; ++j)
+				{
+					Assert::IsTrue(std::abs((int32)golden[i][j] - (int32)actual[j]) <= 1);
+				}
+			}
+		}
+
+		TEST_METHOD(ParallelSameAsSerial)
+		{
+			ThreadPool threadPool(3);
+			const uint32 width = 301, height = 203;
+			std::vector<uint8> image = makeZonePlate(width, height);
+			for (EMipFilter filter : { EMipFilter::Box, EMipFilter::Kaiser, EMipFilter::Lanczos })
+			{
+				MipChain serial, parallel;
+				generateMipChain(image.data(), width, height, 0, MipGeneratorDesc{ .filter = filter }, serial);
+				generateMipChain(image.data(), width, height, 0, MipGeneratorDesc{ .filter = filter }, parallel, &threadPool);
+				Assert::IsTrue(serial.data == parallel.data);
+			}
+		}
+
+		TEST_METHOD(BenchmarkDecodeAndMips)
+		{
+			const uint32 width = 2048, height = 1536;
+			std::vector<uint8> image = makeZonePlate(width, height);
+			const std::wstring filepath = (std::filesystem::temp_directory_path() / L"cyseal_mip_benchmark.png").wstring();
+			Assert::IsTrue(ImageLoader::saveAsPng(filepath, image.data(), width, height));
+
+			ThreadPool threadPool(ThreadPool::getDefaultNumWorkers());
+			ImageLoader loader;
+			HighFrequencyCounter counter;
+
+			counter.start();
+			ImageLoadData* imageBlob = loader.load(filepath, false, false);
+			const float decodeMs = counter.stopWithMilliseconds();
+			Assert::IsNotNull(imageBlob);
+
+			const float megaPixels = 1e-6f * width * height;
+			wchar_t msg[256];
+			swprintf_s(msg, L"%ux%u png decode: %.3f ms (%.1f MPix/s)\n", width, height, decodeMs, megaPixels / (0.001f * decodeMs));
+			UnitLogger::WriteMessage(msg);
+
+			const wchar_t* filterNames[] = { L"Box", L"Kaiser", L"Lanczos" };
+			for (EMipFilter filter : { EMipFilter::Box, EMipFilter::Kaiser, EMipFilter::Lanczos })
+			{
+				float elapsedMs[2];
+				for (uint32 pass = 0; pass < 2; ++pass)
+				{
+					MipChain chain;
+					counter.start();
+					generateMipChain(imageBlob->getBuffer(), width, height, imageBlob->getRowPitch(), MipGeneratorDesc{ .filter = filter }, chain, pass == 0 ? nullptr : &threadPool);
+					elapsedMs[pass] = counter.stopWithMilliseconds();
+				}
+				swprintf_s(msg, L"%s mips: serial %.3f ms (%.1f MPix/s), parallel %.3f ms (%.1f MPix/s, %u threads)\n",
+					filterNames[(uint32)filter],
+					elapsedMs[0], megaPixels / (0.001f * elapsedMs[0]),
+					elapsedMs[1], megaPixels / (0.001f * elapsedMs[1]),
+					threadPool.getNumThreads());
+				UnitLogger::WriteMessage(msg);
+			}
+
+			delete imageBlob;
+			std::filesystem::remove(filepath);
+		}
+	};
+}
@@ -0,0 +1,276 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "loader/texture_cache.h"
+#include "loader/mip_generator.h"
+#include "loader/texture_compressor.h"
+#include "loader/image_loader.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <cmath>
+#include <fstream>
+#include <filesystem>
+
+namespace UnitTest
+{
+	static std::vector<uint8> makeCacheTestImage(uint32 width, uint32 height, uint32 seed)
+	{
+		std::vector<uint8> image(4 * width * height);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			for (uint32 x = 0; x < width; ++x)
+			{
+				uint8* p = &image[4 * (y * width + x)];
+				p[0] = (uint8)(x * 3 + seed);
+				p[1] = (uint8)(y * 5 + seed * 7);
+				p[2] = (uint8)(128.0f + 127.0f * std::sin(0.05f * (x + y) + seed));
+				p[3] = 255;
+			}
+		}
+		return image;
+	}
+
+	static void writeBytes(const std::filesystem::path& path, const std::vector<uint8>& bytes)
+	{
+		std::ofstream fs(path, std::ios::binary | std::ios::trunc);
+		fs.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	}
+
+	static std::vector<uint8> readBytes(const std::filesystem::path& path)
+	{
+		std::ifstream fs(path, std::ios::binary);
+		return std::vector<uint8>(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+	}
+
+	// Each test uses its own directory under temp, removed at the end.
+	struct TempCacheDirectory
+	{
+		TempCacheDirectory(const wchar_t* name)
+		{
+			path = std::filesystem::temp_directory_path() / L"cyseal_texture_cache_test" / name;
+			std::filesystem::remove_all(path);
+			std::filesystem::create_directories(path);
+		}
+		~TempCacheDirectory()
+		{
+			std::filesystem::remove_all(path);
+		}
+		std::filesystem::path path;
+	};
+
+	TEST_CLASS(TestTextureCache)
+	{
+	public:
+		TEST_METHOD(StoreAndFind)
+		{
+			TempCacheDirectory tempDir(L"StoreAndFind");
+			const std::filesystem::path sourcePath = tempDir.path / L"source.bin";
+			writeBytes(sourcePath, { 1, 2, 3, 4, 5 });
+
+			std::vector<uint8> image = makeCacheTestImage(32, 16, 0);
+			MipChain chain;
+			generateMipChain(image.data(), 32, 16, 0, MipGeneratorDesc{}, chain);
+			MipChain compressed;
+			compressMipChain(chain, EPixelFormat::BC1_UNORM, ETextureCompressionQuality::Fast, compressed);
+
+			TextureCache cache((tempDir.path / L"cache").wstring());
+			const TextureCacheKey key{ .sourcePaths = { sourcePath.wstring() }, .settingsHash = 42 };
+			Assert::IsNull(cache.find(key));
+			Assert::IsTrue(cache.store(key, compressed));
+
+			TextureCacheEntry* entry = cache.find(key);
+			Assert::IsNotNull(entry);
+			Assert::IsTrue(entry->format == EPixelFormat::BC1_UNORM);
+			Assert::AreEqual(1u, entry->depth);
+			Assert::AreEqual(compressed.getNumLevels(), entry->getNumLevels());
+			for (uint32 mip = 0; mip < entry->getNumLevels(); ++mip)
+			{
+				const MipChain::Level& expected = compressed.levels[mip];
+				const MipChain::Level& actual = entry->levels[mip];
+				Assert::AreEqual(expected.width, actual.width);
+				Assert::AreEqual(expected.height, actual.height);
+				Assert::AreEqual(expected.rowPitch, actual.rowPitch);
+				Assert::AreEqual(expected.slicePitch, actual.slicePitch);
+				Assert::IsTrue(0 == ::memcmp(compressed.getLevelData(mip), entry->getLevelData(mip), (size_t)expected.slicePitch));
+			}
+			// Level data is in place in the mapping and aligned.
+			Assert::AreEqual((uint64)0, (uint64)(size_t)entry->getLevelData(0) % 256);
+			delete entry;
+
+			// Different settings are a different entry.
+			Assert::IsNull(cache.find(TextureCacheKey{ .sourcePaths = { sourcePath.wstring() }, .settingsHash = 43 }));
+		}
+
+		TEST_METHOD(Volume)
+		{
+			TempCacheDirectory tempDir(L"Volume");
+			std::vector<std::wstring> sourcePaths;
+			for (uint32 i = 0; i < 4; ++i)
+			{
+				const std::filesystem::path sourcePath = tempDir.path / (L"slice" + std::to_wstring(i) + L".bin");
+				writeBytes(sourcePath, { (uint8)i });
+				sourcePaths.push_back(sourcePath.wstring());
+			}
+
+			MipChain volume;
+			volume.levels.push_back(MipChain::Level{ 8, 8, 0, 32, 256 });
+			volume.data.resize(256 * 4);
+			for (size_t i = 0; i < volume.data.size(); ++i) volume.data[i] = (uint8)(i * 31);
+
+			TextureCache cache((tempDir.path / L"cache").wstring());
+			const TextureCacheKey key{ .sourcePaths = sourcePaths, .settingsHash = 7 };
+			Assert::IsTrue(cache.store(key, volume, 4));
+
+			TextureCacheEntry* entry = cache.find(key);
+			Assert::IsNotNull(entry);
+			Assert::AreEqual(4u, entry->depth);
+			Assert::IsTrue(0 == ::memcmp(volume.data.data(), entry->getLevelData(0), volume.data.size()));
+			delete entry;
+
+			// Sources are part of the key, including their order.
+			std::swap(sourcePaths[0], sourcePaths[1]);
+			Assert::IsNull(cache.find(TextureCacheKey{ .sourcePaths = sourcePaths, .settingsHash = 7 }));
+		}
+
+		TEST_METHOD(Invalidation)
+		{
+			TempCacheDirectory tempDir(L"Invalidation");
+			const std::filesystem::path sourcePath = tempDir.path / L"source.bin";
+			writeBytes(sourcePath, { 10, 20, 30, 40 });
+
+			MipChain chain;
+			std::vector<uint8> image = makeCacheTestImage(4, 4, 1);
+			generateMipChain(image.data(), 4, 4, 0, MipGeneratorDesc{}, chain);
+
+			TextureCache cache((tempDir.path / L"cache").wstring());
+			const TextureCacheKey key{ .sourcePaths = { sourcePath.wstring() }, .settingsHash = 1 };
+			Assert::IsTrue(cache.store(key, chain));
+
+			// Touched but same content, e.g., by a checkout. Content hash still matches.
+			const auto originalTime = std::filesystem::last_write_time(sourcePath);
+			std::filesystem::last_write_time(sourcePath, originalTime + std::chrono::hours(1));
+			TextureCacheEntry* entry = cache.find(key);
+			Assert::IsNotNull(entry);
+			delete entry;
+
+			// Same size, different content.
+			writeBytes(sourcePath, { 10, 20, 30, 41 });
+			std::filesystem::last_write_time(sourcePath, originalTime + std::chrono::hours(2));
+			Assert::IsNull(cache.find(key));
+
+			// Different size.
+			Assert::IsTrue(cache.store(key, chain));
+			writeBytes(sourcePath, { 10, 20, 30 });
+			Assert::IsNull(cache.find(key));
+
+			// Missing source.
+			std::filesystem::remove(sourcePath);
+			Assert::IsNull(cache.find(key));
+		}
+
+		TEST_METHOD(CorruptedFile)
+		{
+			TempCacheDirectory tempDir(L"CorruptedFile");
+			const std::filesystem::path sourcePath = tempDir.path / L"source.bin";
+			writeBytes(sourcePath, { 1 });
+
+			MipChain chain;
+			std::vector<uint8> image = makeCacheTestImage(16, 16, 2);
+			generateMipChain(image.data(), 16, 16, 0, MipGeneratorDesc{}, chain);
+
+			TextureCache cache((tempDir.path / L"cache").wstring());
+			const TextureCacheKey key{ .sourcePaths = { sourcePath.wstring() }, .settingsHash = 1 };
+			Assert::IsTrue(cache.store(key, chain));
+			const std::filesystem::path cachePath = cache.getCacheFilePath(key);
+			const std::vector<uint8> original = readBytes(cachePath);
+
+			// Truncated
+			writeBytes(cachePath, std::vector<uint8>(original.begin(), original.end() - 1));
+			Assert::IsNull(cache.find(key));
+
+			// Wrong version
+			std::vector<uint8> modified = original;
+			modified[4] ^= 0xff;
+			writeBytes(cachePath, modified);
+			Assert::IsNull(cache.find(key));
+
+			// Empty
+			writeBytes(cachePath, {});
+			Assert::IsNull(cache.find(key));
+
+			writeBytes(cachePath, original);
+			TextureCacheEntry* entry = cache.find(key);
+			Assert::IsNotNull(entry);
+			delete entry;
+		}
+
+		TEST_METHOD(BenchmarkColdWarm)
+		{
+			// Cold: decode png, generate mips, compress and write the cache. Warm: validate, map and read the cache.
+			TempCacheDirectory tempDir(L"BenchmarkColdWarm");
+			const uint32 numImages = 8, width = 1024, height = 1024;
+			std::vector<std::wstring> sourcePaths;
+			for (uint32 i = 0; i < numImages; ++i)
+			{
+				std::vector<uint8> image = makeCacheTestImage(width, height, i);
+				const std::wstring sourcePath = (tempDir.path / (L"image" + std::to_wstring(i) + L".png")).wstring();
+				Assert::IsTrue(ImageLoader::saveAsPng(sourcePath, image.data(), width, height));
+				sourcePaths.push_back(sourcePath);
+			}
+
+			ThreadPool threadPool(ThreadPool::getDefaultNumWorkers());
+			TextureCache cache((tempDir.path / L"cache").wstring());
+			HighFrequencyCounter counter;
+			std::vector<TextureCacheEntry*> entries(numImages, nullptr);
+			uint64 checksum[2] = { 0, 0 };
+
+			float elapsedMs[2];
+			for (uint32 pass = 0; pass < 2; ++pass)
+			{
+				counter.start();
+				threadPool.parallelFor(numImages, 1, [&](uint32 chunkIx, uint32 begin, uint32 end)
+					{
+						ImageLoader imageLoader;
+						for (uint32 i = begin; i < end; ++i)
+						{
+							const TextureCacheKey key{ .sourcePaths = { sourcePaths[i] }, .settingsHash = 0 };
+							entries[i] = cache.find(key);
+							if (entries[i] == nullptr)
+							{
+								ImageLoadData* imageBlob = imageLoader.load(sourcePaths[i], true, false);
+								MipChain mips, compressed;
+								generateMipChain(imageBlob->getBuffer(), width, height, imageBlob->getRowPitch(), MipGeneratorDesc{}, mips);
+								compressMipChain(mips, EPixelFormat::BC7_UNORM, ETextureCompressionQuality::Fast, compressed);
+								cache.store(key, compressed);
+								delete imageBlob;
+							}
+						}
+					});
+				for (uint32 i = 0; i < numImages; ++i)
+				{
+					if (entries[i] != nullptr)
+					{
+						// Touch all pages like an upload would.
+						const MipChain::Level& last = entries[i]->levels.back();
+						const uint64 totalBytes = last.offset + last.slicePitch;
+						checksum[pass] += hashTextureCacheBytes(entries[i]->getLevelData(0), totalBytes);
+						delete entries[i];
+						entries[i] = nullptr;
+					}
+				}
+				elapsedMs[pass] = counter.stopWithMilliseconds();
+			}
+			Assert::AreEqual((uint64)0, checksum[0]);
+			Assert::AreNotEqual((uint64)0, checksum[1]);
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"%u images of %ux%u: cold %.3f ms, warm %.3f ms (%.1fx, %u threads)\n",
+				numImages, width, height, elapsedMs[0], elapsedMs[1], elapsedMs[0] / elapsedMs[1], threadPool.getNumThreads());
+			UnitLogger::WriteMessage(msg);
+		}
+	};
+}
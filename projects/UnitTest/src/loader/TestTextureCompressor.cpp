@@ -0,0 +1,187 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "loader/texture_compressor.h"
+#include "loader/mip_generator.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <cmath>
+
+namespace UnitTest
+{
+	// Smooth gradients with a few hard edges, like a typical albedo map.
+	static std::vector<uint8> makeAlbedoImage(uint32 width, uint32 height)
+	{
+		std::vector<uint8> image(4 * width * height);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			for (uint32 x = 0; x < width; ++x)
+			{
+				const float u = (float)x / width, v = (float)y / height;
+				const bool bStripe = ((x / 24) + (y / 40)) % 3 == 0;
+				uint8* p = &image[4 * (y * width + x)];
+				p[0] = (uint8)(255.0f * (0.5f + 0.5f * std::sin(6.0f * u + 2.0f * v)));
+				p[1] = (uint8)(bStripe ? 40 : 200.0f * v);
+				p[2] = (uint8)(255.0f * u * v);
+				p[3] = (uint8)(255.0f * (0.5f + 0.5f * std::cos(4.0f * v)));
+			}
+		}
+		return image;
+	}
+
+	static float calcPSNR(const uint8* a, const uint8* b, uint32 numPixels, uint32 numChannels)
+	{
+		double sum = 0.0;
+		for (uint32 i = 0; i < numPixels; ++i)
+		{
+			for (uint32 c = 0; c < numChannels; ++c)
+			{
+				const double d = (double)a[4 * i + c] - (double)b[4 * i + c];
+				sum += d * d;
+			}
+		}
+		const double mse = sum / ((double)numPixels * numChannels);
+		return (mse == 0.0) ? 1000.0f : (float)(10.0 * std::log10(255.0 * 255.0 / mse));
+	}
+
+	static std::vector<uint8> compressAndDecompress(
+		const std::vector<uint8>& image, uint32 width, uint32 height,
+		EPixelFormat format, ETextureCompressionQuality quality)
+	{
+		std::vector<uint8> blocks(getPixelFormatRowBytes(format, width) * getPixelFormatNumRows(format, height));
+		compressImage(image.data(), width, height, 0, format, quality, blocks.data());
+		std::vector<uint8> decoded(4 * width * height);
+		decompressImage(blocks.data(), width, height, format, decoded.data());
+		return decoded;
+	}
+
+	TEST_CLASS(TestTextureCompressor)
+	{
+	public:
+		TEST_METHOD(FormatSelection)
+		{
+			Assert::IsTrue(EPixelFormat::BC7_UNORM == chooseCompressedFormat(ETextureUsage::Albedo, false, ETextureCompressionQuality::Normal));
+			Assert::IsTrue(EPixelFormat::BC1_UNORM == chooseCompressedFormat(ETextureUsage::Albedo, false, ETextureCompressionQuality::Fast));
+			Assert::IsTrue(EPixelFormat::BC3_UNORM == chooseCompressedFormat(ETextureUsage::Albedo, true, ETextureCompressionQuality::Fast));
+			Assert::IsTrue(EPixelFormat::BC5_UNORM == chooseCompressedFormat(ETextureUsage::Normal, false, ETextureCompressionQuality::High));
+			Assert::IsTrue(EPixelFormat::BC4_UNORM == chooseCompressedFormat(ETextureUsage::Mask, false, ETextureCompressionQuality::High));
+
+			// 13x7 has 4x2 blocks.
+			Assert::AreEqual((uint64)32, getPixelFormatRowBytes(EPixelFormat::BC1_UNORM, 13));
+			Assert::AreEqual((uint64)64, getPixelFormatRowBytes(EPixelFormat::BC7_UNORM, 13));
+			Assert::AreEqual(2u, getPixelFormatNumRows(EPixelFormat::BC7_UNORM, 7));
+			Assert::AreEqual(7u, getPixelFormatNumRows(EPixelFormat::R8G8B8A8_UNORM, 7));
+
+			MipChain chain;
+			chain.allocate(EPixelFormat::BC1_UNORM, 16, 8, 5);
+			// 16x8 (64), 8x4 (16), 4x2 (8), 2x1 (8), 1x1 (8)
+			Assert::AreEqual((size_t)104, chain.data.size());
+			Assert::AreEqual((uint64)96, chain.levels[4].offset);
+		}
+
+		TEST_METHOD(SolidColor)
+		{
+			// Exactly representable in each format: 565 for BC1, and odd values share the same p-bit in BC7.
+			const uint32 width = 8, height = 8;
+			std::vector<uint8> image(4 * width * height);
+			for (uint32 i = 0; i < width * height; ++i)
+			{
+				image[4 * i + 0] = 255; image[4 * i + 1] = 65; image[4 * i + 2] = 173; image[4 * i + 3] = 255;
+			}
+			for (ETextureCompressionQuality quality : { ETextureCompressionQuality::Fast, ETextureCompressionQuality::High })
+			{
+				for (EPixelFormat format : { EPixelFormat::BC1_UNORM, EPixelFormat::BC3_UNORM, EPixelFormat::BC7_UNORM })
+				{
+					std::vector<uint8> decoded = compressAndDecompress(image, width, height, format, quality);
+					Assert::IsTrue(decoded == image);
+				}
+				std::vector<uint8> decoded = compressAndDecompress(image, width, height, EPixelFormat::BC5_UNORM, quality);
+				for (uint32 i = 0; i < width * height; ++i)
+				{
+					Assert::AreEqual((uint8)255, decoded[4 * i + 0]);
+					Assert::AreEqual((uint8)65, decoded[4 * i + 1]);
+				}
+			}
+		}
+
+		TEST_METHOD(QualityThresholds)
+		{
+			const uint32 width = 64, height = 64;
+			std::vector<uint8> image = makeAlbedoImage(width, height);
+
+			struct Case { EPixelFormat format; uint32 numChannels; float minPSNR[3]; };
+			const Case cases[] = {
+				{ EPixelFormat::BC1_UNORM, 3, { 37.5f, 38.0f, 38.0f } },
+				{ EPixelFormat::BC3_UNORM, 4, { 39.0f, 39.5f, 39.5f } },
+				{ EPixelFormat::BC4_UNORM, 1, { 44.5f, 45.0f, 45.0f } },
+				{ EPixelFormat::BC5_UNORM, 2, { 47.5f, 48.0f, 48.0f } },
+				{ EPixelFormat::BC7_UNORM, 4, { 38.5f, 39.0f, 39.0f } },
+			};
+			for (const Case& c : cases)
+			{
+				for (uint32 q = 0; q < 3; ++q)
+				{
+					std::vector<uint8> decoded = compressAndDecompress(image, width, height, c.format, (ETextureCompressionQuality)q);
+					const float psnr = calcPSNR(image.data(), decoded.data(), width * height, c.numChannels);
+					Assert::IsTrue(psnr >= c.minPSNR[q]);
+				}
+			}
+		}
+
+		TEST_METHOD(ParallelSameAsSerial)
+		{
+			ThreadPool threadPool(3);
+			const uint32 width = 301, height = 203; // Partial blocks at the edges.
+			std::vector<uint8> image = makeAlbedoImage(width, height);
+			MipChain mips;
+			generateMipChain(image.data(), width, height, 0, MipGeneratorDesc{}, mips);
+			for (EPixelFormat format : { EPixelFormat::BC1_UNORM, EPixelFormat::BC3_UNORM, EPixelFormat::BC4_UNORM, EPixelFormat::BC5_UNORM, EPixelFormat::BC7_UNORM })
+			{
+				MipChain serial, parallel;
+				compressMipChain(mips, format, ETextureCompressionQuality::Normal, serial);
+				compressMipChain(mips, format, ETextureCompressionQuality::Normal, parallel, &threadPool);
+				Assert::AreEqual(mips.getNumLevels(), serial.getNumLevels());
+				Assert::IsTrue(serial.format == format);
+				Assert::IsTrue(serial.data == parallel.data);
+			}
+		}
+
+		TEST_METHOD(BenchmarkCompression)
+		{
+			const uint32 width = 2048, height = 2048;
+			std::vector<uint8> image = makeAlbedoImage(width, height);
+			std::vector<uint8> blocks(uint64(width) * height);
+			std::vector<uint8> decoded(4 * uint64(width) * height);
+
+			ThreadPool threadPool(ThreadPool::getDefaultNumWorkers());
+			HighFrequencyCounter counter;
+			const float megaPixels = 1e-6f * width * height;
+			const wchar_t* formatNames[] = { L"BC1", L"BC3", L"BC4", L"BC5", L"BC7" };
+			const EPixelFormat formats[] = { EPixelFormat::BC1_UNORM, EPixelFormat::BC3_UNORM, EPixelFormat::BC4_UNORM, EPixelFormat::BC5_UNORM, EPixelFormat::BC7_UNORM };
+			const wchar_t* qualityNames[] = { L"Fast", L"Normal", L"High" };
+			const uint32 numChannels[] = { 3, 4, 1, 2, 4 };
+
+			wchar_t msg[256];
+			for (uint32 f = 0; f < 5; ++f)
+			{
+				for (uint32 q = 0; q < 3; ++q)
+				{
+					counter.start();
+					compressImage(image.data(), width, height, 0, formats[f], (ETextureCompressionQuality)q, blocks.data(), &threadPool);
+					const float elapsedMs = counter.stopWithMilliseconds();
+
+					decompressImage(blocks.data(), width, height, formats[f], decoded.data());
+					const float psnr = calcPSNR(image.data(), decoded.data(), width * height, numChannels[f]);
+
+					swprintf_s(msg, L"%s %s: %.3f ms (%.1f MPix/s, %u threads), PSNR %.2f dB\n",
+						formatNames[f], qualityNames[q], elapsedMs, megaPixels / (0.001f * elapsedMs), threadPool.getNumThreads(), psnr);
+					UnitLogger::WriteMessage(msg);
+				}
+			}
+		}
+	};
+}
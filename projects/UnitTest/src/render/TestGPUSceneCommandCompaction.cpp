@@ -0,0 +1,335 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+#include "render/gpu_scene_command_compaction.h"
+
+#include <vector>
+#include <set>
+#include <map>
+#include <random>
+#include <cstring>
+
+namespace UnitTest
+{
+	// Only compared, never dereferenced.
+	static Texture* fakeTexture(uint32 n) { return reinterpret_cast<Texture*>((uintptr_t)(n + 1) * 16); }
+	static MaterialAsset* fakeMaterial(uint32 n) { return reinterpret_cast<MaterialAsset*>((uintptr_t)(n + 1) * 16); }
+
+	static Float4x4 fakeTransform(float value)
+	{
+		Float4x4 m;
+		m.m[0][0] = value;
+		m.m[3][1] = -value;
+		return m;
+	}
+
+	static GPUSceneAllocCommand makeAlloc(uint32 itemIx, uint32 tag, float transform)
+	{
+		GPUSceneAllocCommand cmd{};
+		cmd.sceneItemIndex = itemIx;
+		cmd.sceneItem.indexCount = tag;
+		cmd.sceneItem.localToWorld = fakeTransform(transform);
+		cmd.sceneItem.prevLocalToWorld = fakeTransform(transform);
+		cmd.sceneItem.flags = GPUSceneItem::FlagBits::IsValid;
+		return cmd;
+	}
+	static GPUSceneUpdateCommand makeUpdate(uint32 itemIx, float transform, float prevTransform, bool bPrevResident)
+	{
+		GPUSceneUpdateCommand cmd{};
+		cmd.sceneItemIndex = itemIx;
+		cmd.bPrevLocalToWorldResident = bPrevResident;
+		cmd.localToWorld = fakeTransform(transform);
+		cmd.prevLocalToWorld = fakeTransform(prevTransform);
+		return cmd;
+	}
+	static void addMaterial(GPUSceneCommandBuffer& batch, uint32 itemIx, uint32 tag)
+	{
+		GPUSceneMaterialCommand cmd{};
+		cmd.sceneItemIndex = itemIx;
+		cmd.materialData.materialID = tag;
+		batch.materialCommands.push_back(cmd);
+		batch.albedoTextures.push_back(GPUSceneMaterialTexture{ fakeTexture(tag % 5) });
+	}
+
+	// CPU model of what gpu_scene.hlsl, gpu_scene_material.hlsl and GPUScene do with commands.
+	struct FakeGPUScene
+	{
+		struct Item
+		{
+			bool     bValid = false;
+			uint32   tag = 0;
+			Float4x4 localToWorld;
+			Float4x4 prevLocalToWorld;
+		};
+		struct Material
+		{
+			bool     bHasSRV = false;
+			Texture* texture = nullptr;
+			uint32   tag = 0;
+		};
+		std::map<uint32, Item> items;
+		std::map<uint32, Material> materials;
+
+		void execute(const GPUSceneCommandBuffer& batch)
+		{
+			for (const auto& cmd : batch.evictCommands)
+			{
+				items[cmd.sceneItemIndex].bValid = false;
+			}
+			for (const auto& cmd : batch.allocCommands)
+			{
+				items[cmd.sceneItemIndex] = Item{ true, cmd.sceneItem.indexCount, cmd.sceneItem.localToWorld, cmd.sceneItem.prevLocalToWorld };
+			}
+			for (const auto& cmd : batch.updateCommands)
+			{
+				Item& item = items[cmd.sceneItemIndex];
+				item.prevLocalToWorld = cmd.bPrevLocalToWorldResident ? item.localToWorld : cmd.prevLocalToWorld;
+				item.localToWorld = cmd.localToWorld;
+			}
+			for (const auto& cmd : batch.evictMaterialCommands)
+			{
+				materials[cmd.sceneItemIndex].bHasSRV = false;
+			}
+			for (size_t i = 0; i < batch.materialCommands.size(); ++i)
+			{
+				const auto& cmd = batch.materialCommands[i];
+				materials[cmd.sceneItemIndex] = Material{ true, batch.albedoTextures[i].texture, cmd.materialData.materialID };
+			}
+		}
+
+		// Contents of invalid items and evicted materials are never read, so they are not compared.
+		void assertSameAs(const FakeGPUScene& other) const
+		{
+			std::set<uint32> indices;
+			for (const auto& kv : items) indices.insert(kv.first);
+			for (const auto& kv : other.items) indices.insert(kv.first);
+			for (uint32 ix : indices)
+			{
+				const Item a = findItem(ix);
+				const Item b = other.findItem(ix);
+				Assert::AreEqual(a.bValid, b.bValid);
+				if (a.bValid)
+				{
+					Assert::AreEqual(a.tag, b.tag);
+					Assert::AreEqual(0, memcmp(&a.localToWorld, &b.localToWorld, sizeof(Float4x4)));
+					Assert::AreEqual(0, memcmp(&a.prevLocalToWorld, &b.prevLocalToWorld, sizeof(Float4x4)));
+				}
+			}
+			indices.clear();
+			for (const auto& kv : materials) indices.insert(kv.first);
+			for (const auto& kv : other.materials) indices.insert(kv.first);
+			for (uint32 ix : indices)
+			{
+				const Material a = findMaterial(ix);
+				const Material b = other.findMaterial(ix);
+				Assert::AreEqual(a.bHasSRV, b.bHasSRV);
+				if (a.bHasSRV)
+				{
+					Assert::IsTrue(a.texture == b.texture);
+					Assert::AreEqual(a.tag, b.tag);
+				}
+			}
+		}
+
+		Item findItem(uint32 ix) const
+		{
+			auto it = items.find(ix);
+			return (it != items.end()) ? it->second : Item{};
+		}
+		Material findMaterial(uint32 ix) const
+		{
+			auto it = materials.find(ix);
+			return (it != materials.end()) ? it->second : Material{};
+		}
+	};
+
+	// Generates frames like Scene::createProxy() does: only allocated items are evicted or updated,
+	// and only free items are allocated. Items evicted in a frame can be allocated again in the same frame.
+	// prevLocalToWorld of an update is always the last uploaded localToWorld, like StaticMesh.
+	struct CommandGenerator
+	{
+		static const uint32 MAX_ITEMS = 64;
+
+		std::mt19937 rng;
+		std::vector<bool> allocated = std::vector<bool>(MAX_ITEMS, false);
+		std::vector<float> transforms = std::vector<float>(MAX_ITEMS, 0.0f);
+		uint32 nextTag = 1;
+
+		explicit CommandGenerator(uint32 seed) : rng(seed) {}
+
+		bool chance(float p) { return std::uniform_real_distribution<float>(0.0f, 1.0f)(rng) < p; }
+
+		GPUSceneCommandBuffer generateFrame()
+		{
+			GPUSceneCommandBuffer batch;
+			for (uint32 ix = 0; ix < MAX_ITEMS; ++ix)
+			{
+				if (allocated[ix] && chance(0.2f))
+				{
+					batch.evictCommands.push_back({ ix });
+					batch.evictMaterialCommands.push_back({ ix });
+					allocated[ix] = false;
+				}
+			}
+			for (uint32 ix = 0; ix < MAX_ITEMS; ++ix)
+			{
+				if (!allocated[ix] && chance(0.25f))
+				{
+					batch.allocCommands.push_back(makeAlloc(ix, nextTag, (float)nextTag));
+					transforms[ix] = (float)nextTag;
+					addMaterial(batch, ix, nextTag);
+					++nextTag;
+					allocated[ix] = true;
+				}
+			}
+			for (uint32 ix = 0; ix < MAX_ITEMS; ++ix)
+			{
+				if (allocated[ix] && chance(0.3f))
+				{
+					// Sometimes the same item is updated several times.
+					const uint32 numUpdates = chance(0.2f) ? 2 : 1;
+					for (uint32 n = 0; n < numUpdates; ++n)
+					{
+						const float newTransform = (float)(nextTag++);
+						batch.updateCommands.push_back(makeUpdate(ix, newTransform, transforms[ix], chance(0.5f)));
+						transforms[ix] = newTransform;
+						batch.evictMaterialCommands.push_back({ ix });
+						addMaterial(batch, ix, nextTag++);
+					}
+				}
+			}
+			for (uint32 i = 0; i < 6; ++i)
+			{
+				batch.dirtyMaterials.push_back(fakeMaterial(rng() % 4));
+			}
+			return batch;
+		}
+	};
+
+	template<typename T>
+	static void assertStrictlySorted(const std::vector<T>& commands)
+	{
+		for (size_t i = 1; i < commands.size(); ++i)
+		{
+			Assert::IsTrue(commands[i - 1].sceneItemIndex < commands[i].sceneItemIndex);
+		}
+	}
+
+	// Executing all batches == executing the first one, then the compacted rest.
+	static void assertSameEffect(const std::vector<GPUSceneCommandBuffer>& batches, const GPUSceneCommandBuffer& first, const GPUSceneCommandBuffer& compacted)
+	{
+		FakeGPUScene expected, actual;
+		for (const auto& batch : batches) expected.execute(batch);
+		actual.execute(first);
+		actual.execute(compacted);
+		expected.assertSameAs(actual);
+	}
+
+	TEST_CLASS(TestGPUSceneCommandCompaction)
+	{
+	public:
+		TEST_METHOD(AllocThenEvictCancels)
+		{
+			std::vector<GPUSceneCommandBuffer> batches(2);
+			batches[0].allocCommands.push_back(makeAlloc(7, 1, 1.0f));
+			addMaterial(batches[0], 7, 1);
+			batches[1].evictCommands.push_back({ 7 });
+			batches[1].evictMaterialCommands.push_back({ 7 });
+
+			GPUSceneCommandBuffer out;
+			compactGPUSceneCommands(batches.data(), 2, out);
+			Assert::IsTrue(out.allocCommands.empty());
+			Assert::IsTrue(out.evictCommands.empty());
+			Assert::IsTrue(out.materialCommands.empty());
+			// Resetting a material SRV is harmless, so it's kept.
+			Assert::AreEqual((size_t)1, out.evictMaterialCommands.size());
+		}
+
+		TEST_METHOD(EvictThenAllocKeepsAlloc)
+		{
+			GPUSceneCommandBuffer batch;
+			batch.evictCommands.push_back({ 3 });
+			batch.evictMaterialCommands.push_back({ 3 });
+			batch.allocCommands.push_back(makeAlloc(3, 5, 2.0f));
+			addMaterial(batch, 3, 5);
+
+			GPUSceneCommandBuffer out;
+			GPUSceneCommandStats stats;
+			compactGPUSceneCommands(&batch, 1, out, &stats);
+			Assert::IsTrue(out.evictCommands.empty());
+			Assert::IsTrue(out.evictMaterialCommands.empty());
+			Assert::AreEqual((size_t)1, out.allocCommands.size());
+			Assert::AreEqual((size_t)1, out.materialCommands.size());
+			Assert::AreEqual(4u, stats.numCommandsBefore);
+			Assert::AreEqual(2u, stats.numCommandsAfter);
+			Assert::AreEqual((uint64)(sizeof(GPUSceneEvictCommand) + sizeof(GPUSceneEvictMaterialCommand)), stats.getBytesSaved());
+		}
+
+		TEST_METHOD(LastUpdateWinsAndFoldsIntoAlloc)
+		{
+			std::vector<GPUSceneCommandBuffer> batches(2);
+			batches[0].updateCommands.push_back(makeUpdate(9, 1.0f, 0.0f, true));
+			batches[0].updateCommands.push_back(makeUpdate(9, 2.0f, 1.0f, true));
+			batches[0].allocCommands.push_back(makeAlloc(4, 1, 0.0f));
+			batches[1].updateCommands.push_back(makeUpdate(4, 3.0f, 3.5f, false));
+			batches[1].updateCommands.push_back(makeUpdate(9, 4.0f, 2.0f, true));
+
+			GPUSceneCommandBuffer out;
+			compactGPUSceneCommands(batches.data(), 2, out);
+			Assert::AreEqual((size_t)1, out.updateCommands.size());
+			Assert::AreEqual(9u, out.updateCommands[0].sceneItemIndex);
+			Assert::AreEqual(4.0f, out.updateCommands[0].localToWorld.m[0][0]);
+			// The gpu scene will not have 2.0 as localToWorld, so prevLocalToWorld should be uploaded.
+			Assert::IsFalse(out.updateCommands[0].bPrevLocalToWorldResident);
+			Assert::AreEqual(2.0f, out.updateCommands[0].prevLocalToWorld.m[0][0]);
+			Assert::AreEqual((size_t)1, out.allocCommands.size());
+			Assert::AreEqual(3.0f, out.allocCommands[0].sceneItem.localToWorld.m[0][0]);
+			Assert::AreEqual(3.5f, out.allocCommands[0].sceneItem.prevLocalToWorld.m[0][0]);
+		}
+
+		// Property test: compacted commands have the same effect as the original ones.
+		TEST_METHOD(RandomFramesSameEffect)
+		{
+			for (uint32 seed = 0; seed < 200; ++seed)
+			{
+				CommandGenerator generator(seed);
+				// Warm up so that some items are already resident.
+				GPUSceneCommandBuffer warmup = generator.generateFrame();
+
+				const uint32 numBatches = 1 + (seed % 4);
+				std::vector<GPUSceneCommandBuffer> batches(numBatches);
+				for (uint32 i = 0; i < numBatches; ++i)
+				{
+					batches[i] = generator.generateFrame();
+				}
+
+				GPUSceneCommandBuffer out;
+				GPUSceneCommandStats stats;
+				compactGPUSceneCommands(batches.data(), numBatches, out, &stats);
+
+				std::vector<GPUSceneCommandBuffer> allBatches = { warmup };
+				allBatches.insert(allBatches.end(), batches.begin(), batches.end());
+				assertSameEffect(allBatches, warmup, out);
+
+				assertStrictlySorted(out.evictCommands);
+				assertStrictlySorted(out.allocCommands);
+				assertStrictlySorted(out.updateCommands);
+				assertStrictlySorted(out.evictMaterialCommands);
+				assertStrictlySorted(out.materialCommands);
+				Assert::AreEqual(out.materialCommands.size(), out.albedoTextures.size());
+				Assert::IsTrue(stats.numCommandsAfter <= stats.numCommandsBefore);
+				Assert::IsTrue(stats.bytesAfter <= stats.bytesBefore);
+
+				std::set<MaterialAsset*> dirtySet;
+				for (const auto& batch : batches) dirtySet.insert(batch.dirtyMaterials.begin(), batch.dirtyMaterials.end());
+				Assert::AreEqual(dirtySet.size(), out.dirtyMaterials.size());
+
+				// Each frame is also equivalent on its own.
+				GPUSceneCommandBuffer single;
+				compactGPUSceneCommands(&batches[0], 1, single);
+				assertSameEffect({ warmup, batches[0] }, warmup, single);
+			}
+		}
+	};
+}
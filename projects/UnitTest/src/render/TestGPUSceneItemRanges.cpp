@@ -0,0 +1,197 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "test_scene_utils.h"
+#include "world/scene.h"
+#include "world/scene_proxy.h"
+#include "render/static_mesh.h"
+#include "render/gpu_scene_command_compaction.h"
+#include "render/gpu_scene_transform_packing.h"
+#include "material/material_database.h"
+#include "core/thread_pool.h"
+
+#include <vector>
+#include <set>
+#include <random>
+#include <algorithm>
+
+namespace UnitTest
+{
+	using namespace render_test;
+
+	TEST_CLASS(TestGPUSceneItemRanges)
+	{
+	public:
+		// Meshes are removed, added back and change LODs every frame, then all meshes are added back.
+		// Replays gpu scene commands on a CPU copy of the gpu scene to check that
+		// every mesh occupies a contiguous range and ranges never overlap.
+		TEST_METHOD(FragmentationUnderChurn)
+		{
+			MaterialShaderDatabase::get().compileMaterials(nullptr, true);
+			ThreadPool threadPool(3);
+			FakeMeshAssets assets(16);
+
+			Scene scene;
+			std::vector<SharedPtr<MaterialAsset>> materials;
+			std::vector<StaticMesh*> meshes;
+			const uint32 numMeshes = 2000;
+			const uint32 numChurnFrames = 200;
+			addTestMeshes(scene, assets, numMeshes, materials, meshes);
+
+			std::vector<bool> inScene(numMeshes, true);
+			std::vector<int32> itemOwners; // Mesh index for each gpu scene item, -1 if free.
+			uint32 span = 0, numAllocated = 0, numHoles = 0;
+
+			auto createProxyAndVerify = [&](ThreadPool* pool)
+			{
+				SceneProxy* proxy = scene.createProxy(pool);
+				for (const GPUSceneEvictCommand& cmd : proxy->gpuSceneEvictCommands)
+				{
+					Assert::IsTrue(cmd.sceneItemIndex < itemOwners.size() && itemOwners[cmd.sceneItemIndex] >= 0);
+					itemOwners[cmd.sceneItemIndex] = -1;
+				}
+				for (const GPUSceneAllocCommand& cmd : proxy->gpuSceneAllocCommands)
+				{
+					// An item evicted and reallocated in the same frame only has the alloc command after compaction.
+					// Overlapping live ranges are caught below, as the overwritten mesh would lose an item.
+					if (cmd.sceneItemIndex >= itemOwners.size()) itemOwners.resize(cmd.sceneItemIndex + 1, -1);
+					// Mesh i is at (i, 0, 0).
+					itemOwners[cmd.sceneItemIndex] = (int32)cmd.sceneItem.localToWorld.m[0][3];
+				}
+				span = (proxy->gpuSceneItemMaxValidIndex == 0xffffffff) ? 0 : (proxy->gpuSceneItemMaxValidIndex + 1);
+				delete proxy;
+
+				// [first, last] item and number of items per mesh.
+				std::vector<uint32> firstItem(numMeshes, 0xffffffff), lastItem(numMeshes, 0), numItems(numMeshes, 0);
+				numAllocated = numHoles = 0;
+				for (uint32 itemIx = 0; itemIx < (uint32)itemOwners.size(); ++itemIx)
+				{
+					const int32 owner = itemOwners[itemIx];
+					if (owner < 0)
+					{
+						if (itemIx < span && (itemIx == 0 || itemOwners[itemIx - 1] >= 0)) ++numHoles;
+						continue;
+					}
+					firstItem[owner] = std::min(firstItem[owner], itemIx);
+					lastItem[owner] = itemIx;
+					numItems[owner] += 1;
+					numAllocated += 1;
+				}
+				for (uint32 i = 0; i < numMeshes; ++i)
+				{
+					const uint32 expected = inScene[i] ? (uint32)meshes[i]->getSections(meshes[i]->getActiveLOD()).size() : 0;
+					Assert::AreEqual(expected, numItems[i]);
+					if (numItems[i] > 0)
+					{
+						Assert::AreEqual(numItems[i], lastItem[i] - firstItem[i] + 1);
+					}
+				}
+				Assert::IsTrue(numAllocated == 0 || itemOwners[span - 1] >= 0);
+			};
+
+			createProxyAndVerify(nullptr);
+			const uint32 initialSpan = span;
+
+			std::mt19937 rng(29);
+			uint32 maxHoles = 0;
+			for (uint32 frame = 0; frame < numChurnFrames; ++frame)
+			{
+				// At most one change per mesh per frame. A mesh can't be removed twice before createProxy().
+				std::set<uint32> touched;
+				for (uint32 n = 0; n < 100; ++n)
+				{
+					const uint32 i = rng() % numMeshes;
+					if (!touched.insert(i).second) continue;
+					if (rng() % 3 == 0)
+					{
+						if (inScene[i]) meshes[i]->setActiveLOD(1 - meshes[i]->getActiveLOD());
+					}
+					else if (inScene[i])
+					{
+						scene.removeStaticMesh(meshes[i]);
+						inScene[i] = false;
+					}
+					else
+					{
+						scene.addStaticMesh(meshes[i]);
+						inScene[i] = true;
+					}
+				}
+				createProxyAndVerify((frame % 2) ? &threadPool : nullptr);
+				// Holes are reused before the gpu scene grows.
+				Assert::IsTrue(span <= initialSpan);
+				maxHoles = std::max(maxHoles, numHoles);
+			}
+			const uint32 churnSpan = span, churnAllocated = numAllocated;
+
+			// Refill. Some ranges don't fit in the holes left by smaller ones, but most do.
+			for (uint32 i = 0; i < numMeshes; ++i)
+			{
+				if (!inScene[i])
+				{
+					scene.addStaticMesh(meshes[i]);
+					inScene[i] = true;
+				}
+			}
+			createProxyAndVerify(&threadPool);
+			Assert::IsTrue(span <= numAllocated + numAllocated / 8);
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"%u meshes, %u frames of churn: max holes %u, span %u for %u items. After refill: span %u for %u items\n",
+				numMeshes, numChurnFrames, maxHoles, churnSpan, churnAllocated, span, numAllocated);
+			UnitLogger::WriteMessage(msg);
+
+			destroyTestMeshes(scene, meshes);
+			MaterialShaderDatabase::get().destroyMaterials();
+		}
+
+		// Per-section commands vs. per-range commands that are actually uploaded.
+		TEST_METHOD(CommandCountReduction)
+		{
+			MaterialShaderDatabase::get().compileMaterials(nullptr, true);
+			FakeMeshAssets assets(16);
+
+			Scene scene;
+			std::vector<SharedPtr<MaterialAsset>> materials;
+			std::vector<StaticMesh*> meshes;
+			const uint32 numMeshes = 3000;
+			addTestMeshes(scene, assets, numMeshes, materials, meshes);
+			delete scene.createProxy();
+
+			// All meshes move.
+			for (uint32 i = 0; i < numMeshes; ++i) meshes[i]->setPosition(vec3((float)i, 1.0f, 0.0f));
+			SceneProxy* proxy = scene.createProxy();
+			std::vector<GPUScenePackedUpdateCommand> packedUpdateCommands;
+			std::vector<uint32> transformData;
+			packGPUSceneUpdateCommands(proxy->gpuSceneUpdateCommands, true, packedUpdateCommands, transformData);
+			const size_t numUpdateCommands = proxy->gpuSceneUpdateCommands.size();
+			Assert::AreEqual((size_t)(numMeshes * 2), numUpdateCommands);
+			Assert::AreEqual((size_t)numMeshes, packedUpdateCommands.size());
+			delete proxy;
+
+			// Every other mesh is removed. Meshes were allocated in order, so each evicted range is isolated.
+			for (uint32 i = 0; i < numMeshes; i += 2) scene.removeStaticMesh(meshes[i]);
+			proxy = scene.createProxy();
+			std::vector<GPUSceneEvictRangeCommand> evictRangeCommands;
+			coalesceGPUSceneEvictCommands(proxy->gpuSceneEvictCommands, evictRangeCommands);
+			const size_t numEvictCommands = proxy->gpuSceneEvictCommands.size();
+			Assert::AreEqual((size_t)(numMeshes / 2), evictRangeCommands.size());
+			uint32 numEvictedItems = 0;
+			for (const GPUSceneEvictRangeCommand& cmd : evictRangeCommands) numEvictedItems += cmd.numItems;
+			Assert::AreEqual(numEvictCommands, (size_t)numEvictedItems);
+			delete proxy;
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"%u meshes: update commands %zu -> %zu, evict commands %zu -> %zu\n",
+				numMeshes, numUpdateCommands, packedUpdateCommands.size(), numEvictCommands, evictRangeCommands.size());
+			UnitLogger::WriteMessage(msg);
+
+			for (uint32 i = 0; i < numMeshes; i += 2) scene.addStaticMesh(meshes[i]);
+			delete scene.createProxy();
+			destroyTestMeshes(scene, meshes);
+			MaterialShaderDatabase::get().destroyMaterials();
+		}
+	};
+}
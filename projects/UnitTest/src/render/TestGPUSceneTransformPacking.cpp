@@ -0,0 +1,254 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "render/gpu_scene_transform_packing.h"
+#include "geometry/transform.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace UnitTest
+{
+	static Float4x4 randomTransform(std::mt19937& rng, bool bUniformScale)
+	{
+		std::uniform_real_distribution<float> unorm(0.0f, 1.0f);
+		std::uniform_real_distribution<float> snorm(-1.0f, 1.0f);
+
+		vec3 axis(snorm(rng), snorm(rng), snorm(rng));
+		if (axis.length() < 0.01f) axis = vec3(0.0f, 1.0f, 0.0f);
+
+		Transform transform;
+		transform.setPosition(vec3(snorm(rng), snorm(rng), snorm(rng)) * 1000.0f);
+		transform.setRotation(normalize(axis), unorm(rng) * 360.0f);
+		if (bUniformScale)
+		{
+			transform.setScale(0.01f + unorm(rng) * 10.0f);
+		}
+		else
+		{
+			transform.setScale(vec3(0.01f + unorm(rng) * 10.0f, 0.01f + unorm(rng) * 10.0f, 0.01f + unorm(rng) * 10.0f));
+		}
+		return Float4x4(transform.getMatrix());
+	}
+
+	static float maxScaleOf(const Float4x4& M)
+	{
+		float maxScale = 0.0f;
+		for (uint32 i = 0; i < 3; ++i)
+		{
+			maxScale = std::max(maxScale, std::sqrt(M.m[i][0] * M.m[i][0] + M.m[i][1] * M.m[i][1] + M.m[i][2] * M.m[i][2]));
+		}
+		return maxScale;
+	}
+
+	// Max abs error of the upper 3x3, relative to the largest scale. Translation and the last row should be exact.
+	static float relativeError(const Float4x4& expected, const Float4x4& actual)
+	{
+		float maxError = 0.0f;
+		for (uint32 i = 0; i < 3; ++i)
+		{
+			for (uint32 j = 0; j < 3; ++j)
+			{
+				maxError = std::max(maxError, std::abs(expected.m[i][j] - actual.m[i][j]));
+			}
+			Assert::AreEqual(expected.m[i][3], actual.m[i][3]);
+		}
+		Assert::AreEqual(0, memcmp(expected.m[3], actual.m[3], sizeof(float) * 4));
+		return maxError / maxScaleOf(expected);
+	}
+
+	TEST_CLASS(TestGPUSceneTransformPacking)
+	{
+	public:
+		TEST_METHOD(AffineRoundTripIsExact)
+		{
+			std::mt19937 rng(7);
+			for (uint32 i = 0; i < 1000; ++i)
+			{
+				Float4x4 M = randomTransform(rng, false);
+				M.m[0][1] += 0.25f; // Shear is fine for affine.
+
+				uint32 data[GPU_SCENE_AFFINE_TRANSFORM_SIZE];
+				packAffineTransform(M, data);
+				const Float4x4 decoded = unpackAffineTransform(data);
+				Assert::AreEqual(0, memcmp(&M, &decoded, sizeof(Float4x4)));
+			}
+		}
+
+		TEST_METHOD(QuantizedRoundTripPrecision)
+		{
+			std::mt19937 rng(11);
+			float maxError = 0.0f;
+			for (uint32 i = 0; i < 10000; ++i)
+			{
+				Float4x4 M = randomTransform(rng, (i % 2) == 0);
+				if ((i % 5) == 0)
+				{
+					// Mirrored
+					for (uint32 j = 0; j < 3; ++j) M.m[1][j] = -M.m[1][j];
+				}
+
+				uint32 data[GPU_SCENE_QUANTIZED_TRANSFORM_SIZE];
+				Assert::IsTrue(packQuantizedTransform(M, data));
+				const float error = relativeError(M, unpackQuantizedTransform(data));
+				Assert::IsTrue(error <= GPU_SCENE_QUANTIZED_TRANSFORM_TOLERANCE);
+				maxError = std::max(maxError, error);
+			}
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"Quantized TRS max relative error: %e\n", maxError);
+			UnitLogger::WriteMessage(msg);
+		}
+
+		TEST_METHOD(ShearOrZeroScaleIsNotQuantized)
+		{
+			std::mt19937 rng(13);
+			Float4x4 sheared = randomTransform(rng, true);
+			sheared.m[0][1] += 0.5f * maxScaleOf(sheared);
+			Float4x4 zeroScale = randomTransform(rng, true);
+			for (uint32 j = 0; j < 3; ++j) zeroScale.m[2][j] = 0.0f;
+
+			uint32 data[GPU_SCENE_QUANTIZED_TRANSFORM_SIZE];
+			Assert::IsFalse(packQuantizedTransform(sheared, data));
+			Assert::IsFalse(packQuantizedTransform(zeroScale, data));
+
+			// Falls back to affine.
+			std::vector<GPUSceneUpdateCommand> commands(1);
+			commands[0].sceneItemIndex = 3;
+			commands[0].bPrevLocalToWorldResident = true;
+			commands[0].localToWorld = sheared;
+
+			std::vector<GPUScenePackedUpdateCommand> packedCommands;
+			std::vector<uint32> transformData;
+			packGPUSceneUpdateCommands(commands, true, packedCommands, transformData);
+			Assert::AreEqual((size_t)GPU_SCENE_AFFINE_TRANSFORM_SIZE, transformData.size());
+			Assert::AreEqual(0u, packedCommands[0].dataOffsetAndFlags & (uint32)EGPUScenePackedUpdateFlags::QuantizedLocalToWorld);
+		}
+
+		TEST_METHOD(UpdateCommandsRoundTrip)
+		{
+			std::mt19937 rng(17);
+			for (uint32 quantize = 0; quantize < 2; ++quantize)
+			{
+				std::vector<GPUSceneUpdateCommand> commands(1000);
+				std::vector<Float4x4> residents(commands.size());
+				for (uint32 i = 0; i < (uint32)commands.size(); ++i)
+				{
+					GPUSceneUpdateCommand& cmd = commands[i];
+					cmd.sceneItemIndex = i * 3;
+					cmd.bPrevLocalToWorldResident = (rng() % 2) == 0;
+					cmd.localToWorld = randomTransform(rng, false);
+					cmd.prevLocalToWorld = randomTransform(rng, false);
+					if ((i % 7) == 0) cmd.localToWorld.m[0][1] += 1.0f;
+					residents[i] = randomTransform(rng, true);
+				}
+
+				std::vector<GPUScenePackedUpdateCommand> packedCommands;
+				std::vector<uint32> transformData;
+				packGPUSceneUpdateCommands(commands, quantize != 0, packedCommands, transformData);
+				Assert::AreEqual(commands.size(), packedCommands.size());
+
+				for (uint32 i = 0; i < (uint32)commands.size(); ++i)
+				{
+					Float4x4 localToWorld, prevLocalToWorld;
+					unpackGPUSceneUpdateCommand(packedCommands[i], transformData.data(), residents[i], localToWorld, prevLocalToWorld);
+					Assert::AreEqual(commands[i].sceneItemIndex, packedCommands[i].sceneItemIndex);
+					Assert::AreEqual(1u, packedCommands[i].numItems);
+
+					const float tolerance = quantize ? GPU_SCENE_QUANTIZED_TRANSFORM_TOLERANCE : 0.0f;
+					Assert::IsTrue(relativeError(commands[i].localToWorld, localToWorld) <= tolerance);
+					if (commands[i].bPrevLocalToWorldResident)
+					{
+						Assert::AreEqual(0, memcmp(&residents[i], &prevLocalToWorld, sizeof(Float4x4)));
+					}
+					else
+					{
+						Assert::IsTrue(relativeError(commands[i].prevLocalToWorld, prevLocalToWorld) <= tolerance);
+					}
+				}
+			}
+		}
+
+		// Sections of a static mesh have consecutive item indices and the same transform.
+		TEST_METHOD(MergeConsecutiveItems)
+		{
+			std::mt19937 rng(23);
+			const Float4x4 A = randomTransform(rng, false);
+			const Float4x4 B = randomTransform(rng, false);
+
+			std::vector<GPUSceneUpdateCommand> commands(7);
+			const uint32 itemIndices[] = { 10, 11, 12, 13, 15, 16, 17 };
+			for (uint32 i = 0; i < 7; ++i)
+			{
+				commands[i].sceneItemIndex = itemIndices[i];
+				commands[i].bPrevLocalToWorldResident = (i != 6);
+				commands[i].localToWorld = (i < 3) ? A : B;
+				commands[i].prevLocalToWorld = A;
+			}
+
+			std::vector<GPUScenePackedUpdateCommand> packedCommands;
+			std::vector<uint32> transformData;
+			packGPUSceneUpdateCommands(commands, false, packedCommands, transformData);
+
+			// [10, 13) with A, 13 with B, [15, 17) with B, 17 with B and prevLocalToWorld.
+			Assert::AreEqual((size_t)4, packedCommands.size());
+			const uint32 expectedFirst[] = { 10, 13, 15, 17 };
+			const uint32 expectedCount[] = { 3, 1, 2, 1 };
+			for (uint32 i = 0; i < 4; ++i)
+			{
+				Assert::AreEqual(expectedFirst[i], packedCommands[i].sceneItemIndex);
+				Assert::AreEqual(expectedCount[i], packedCommands[i].numItems);
+			}
+			Assert::AreEqual((size_t)(GPU_SCENE_AFFINE_TRANSFORM_SIZE * 5), transformData.size());
+
+			Float4x4 localToWorld, prevLocalToWorld;
+			unpackGPUSceneUpdateCommand(packedCommands[0], transformData.data(), B, localToWorld, prevLocalToWorld);
+			Assert::AreEqual(0, memcmp(&A, &localToWorld, sizeof(Float4x4)));
+			Assert::AreEqual(0, memcmp(&B, &prevLocalToWorld, sizeof(Float4x4)));
+		}
+
+		// Every item moves every frame, like mesh splatting.
+		TEST_METHOD(UploadBytesPerFrame)
+		{
+			const uint32 numItems = 100000;
+			std::mt19937 rng(19);
+			std::vector<GPUSceneUpdateCommand> commands(numItems);
+			for (uint32 i = 0; i < numItems; ++i)
+			{
+				commands[i].sceneItemIndex = i;
+				commands[i].bPrevLocalToWorldResident = true;
+				commands[i].localToWorld = randomTransform(rng, true);
+				commands[i].prevLocalToWorld = randomTransform(rng, true);
+			}
+
+			// Previously uploaded as is: 16-byte header + 2 full matrices.
+			const uint64 fullBytes = (uint64)numItems * (16 + 2 * sizeof(Float4x4));
+
+			std::vector<GPUScenePackedUpdateCommand> packedCommands;
+			std::vector<uint32> transformData;
+			uint64 packedBytes[2];
+			float elapsedMs[2];
+			for (uint32 quantize = 0; quantize < 2; ++quantize)
+			{
+				HighFrequencyCounter counter;
+				counter.start();
+				packGPUSceneUpdateCommands(commands, quantize != 0, packedCommands, transformData);
+				elapsedMs[quantize] = counter.stopWithMilliseconds();
+				packedBytes[quantize] = packedCommands.size() * sizeof(GPUScenePackedUpdateCommand) + transformData.size() * sizeof(uint32);
+			}
+			Assert::IsTrue(packedBytes[1] < packedBytes[0]);
+			Assert::IsTrue(packedBytes[0] < fullBytes);
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"%u moving items: full %llu bytes, affine %llu bytes (%.2f ms), quantized %llu bytes (%.2f ms)\n",
+				numItems, fullBytes, packedBytes[0], elapsedMs[0], packedBytes[1], elapsedMs[1]);
+			UnitLogger::WriteMessage(msg);
+		}
+	};
+}
@@ -0,0 +1,298 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "util/image_metrics.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <limits>
+
+namespace UnitTest
+{
+	static std::vector<uint8> makeConstantRgba8(uint32 width, uint32 height, uint8 r, uint8 g, uint8 b, uint8 a = 255)
+	{
+		std::vector<uint8> image(4 * width * height);
+		for (uint32 i = 0; i < width * height; ++i)
+		{
+			image[4 * i + 0] = r; image[4 * i + 1] = g; image[4 * i + 2] = b; image[4 * i + 3] = a;
+		}
+		return image;
+	}
+
+	static std::vector<float> makeConstantRgba32f(uint32 width, uint32 height, float r, float g, float b)
+	{
+		std::vector<float> image(4 * width * height);
+		for (uint32 i = 0; i < width * height; ++i)
+		{
+			image[4 * i + 0] = r; image[4 * i + 1] = g; image[4 * i + 2] = b; image[4 * i + 3] = 1.0f;
+		}
+		return image;
+	}
+
+	// Smooth gradients and a few edges, similar to a render.
+	static std::vector<uint8> makeSceneRgba8(uint32 width, uint32 height)
+	{
+		std::vector<uint8> image(4 * width * height);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			for (uint32 x = 0; x < width; ++x)
+			{
+				uint8* p = &image[4 * (y * width + x)];
+				const bool bBox = (x / 37 + y / 29) % 3 == 0;
+				p[0] = (uint8)(255 * x / width);
+				p[1] = (uint8)(255 * y / height);
+				p[2] = bBox ? 220 : 40;
+				p[3] = 255;
+			}
+		}
+		return image;
+	}
+
+	static std::vector<uint8> addNoise(const std::vector<uint8>& image, int32 amplitude, uint32 seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<int32> dist(-amplitude, amplitude);
+		std::vector<uint8> noisy(image);
+		for (size_t i = 0; i < noisy.size(); ++i)
+		{
+			if ((i & 3) != 3) noisy[i] = (uint8)std::clamp((int32)noisy[i] + dist(rng), 0, 255);
+		}
+		return noisy;
+	}
+
+	TEST_CLASS(TestImageMetrics)
+	{
+	public:
+		TEST_METHOD(MSEKnownAnswer)
+		{
+			// Width is not a multiple of 4, and alpha differs but is ignored.
+			const uint32 width = 7, height = 5;
+			std::vector<uint8> reference = makeConstantRgba8(width, height, 0, 50, 100, 255);
+			std::vector<uint8> test = makeConstantRgba8(width, height, 10, 50, 100, 0);
+			std::vector<float> errorMap;
+			ImageErrorStats stats = computeMSE(MetricImage::rgba8(reference.data(), width, height), MetricImage::rgba8(test.data(), width, height), nullptr, &errorMap);
+
+			const float expected = (10.0f / 255.0f) * (10.0f / 255.0f);
+			Assert::AreEqual(expected, stats.mse.x, 1e-7f);
+			Assert::AreEqual(0.0f, stats.mse.y);
+			Assert::AreEqual(0.0f, stats.mse.z);
+			Assert::AreEqual(expected / 3.0f, stats.mseAverage, 1e-7f);
+			Assert::AreEqual(20.0f * std::log10(25.5f), stats.psnr.x, 1e-4f);
+			Assert::IsTrue(std::isinf(stats.psnr.y));
+			Assert::AreEqual(width * height, stats.numDifferentPixels);
+			Assert::AreEqual(10.0f / 255.0f, stats.maxAbsError, 1e-7f);
+			Assert::AreEqual((size_t)(width * height), errorMap.size());
+			for (float error : errorMap) Assert::AreEqual(expected / 3.0f, error, 1e-7f);
+
+			// Same values as rgba32f with padded rows, which takes the float path. Out of range values are clamped.
+			const uint32 rowPitch = 16 * width + 32;
+			std::vector<uint8> floatImage(rowPitch * height);
+			for (uint32 y = 0; y < height; ++y)
+			{
+				float* row = reinterpret_cast<float*>(floatImage.data() + y * rowPitch);
+				for (uint32 x = 0; x < width; ++x)
+				{
+					row[4 * x + 0] = 10.0f / 255.0f; row[4 * x + 1] = 50.0f / 255.0f; row[4 * x + 2] = 100.0f / 255.0f; row[4 * x + 3] = -5.0f;
+				}
+			}
+			const MetricImage floatView = MetricImage::rgba32f(reinterpret_cast<const float*>(floatImage.data()), width, height, rowPitch);
+			stats = computeMSE(MetricImage::rgba8(test.data(), width, height), floatView);
+			Assert::AreEqual(0.0f, stats.mseAverage, 1e-12f);
+
+			reinterpret_cast<float*>(floatImage.data() + 2 * rowPitch)[4 * 3 + 1] = 7.0f;
+			stats = computeMSE(floatView, MetricImage::rgba8(test.data(), width, height));
+			const float clampedError = (205.0f / 255.0f) * (205.0f / 255.0f) / (width * height);
+			Assert::AreEqual(clampedError, stats.mse.y, 1e-6f);
+			Assert::AreEqual(1u, stats.numDifferentPixels);
+
+			Assert::IsTrue(std::isinf(calcPSNR(0.0f)));
+			Assert::AreEqual(20.0f, calcPSNR(0.01f), 1e-5f);
+		}
+
+		TEST_METHOD(SSIMKnownAnswer)
+		{
+			const uint32 width = 61, height = 43;
+			std::vector<uint8> scene = makeSceneRgba8(width, height);
+			const MetricImage sceneView = MetricImage::rgba8(scene.data(), width, height);
+			std::vector<float> ssimMap;
+			Assert::AreEqual(1.0f, computeSSIM(sceneView, sceneView, nullptr, &ssimMap), 1e-5f);
+			for (float ssim : ssimMap) Assert::AreEqual(1.0f, ssim, 1e-4f);
+
+			// No variance, so SSIM is (2 mu_x mu_y + C1) / (mu_x^2 + mu_y^2 + C1).
+			std::vector<uint8> grey1 = makeConstantRgba8(width, height, 128, 128, 128);
+			std::vector<uint8> grey2 = makeConstantRgba8(width, height, 153, 153, 153);
+			const float a = 128.0f / 255.0f, b = 153.0f / 255.0f, C1 = 1e-4f;
+			const float expected = (2.0f * a * b + C1) / (a * a + b * b + C1);
+			Assert::AreEqual(expected, computeSSIM(MetricImage::rgba8(grey1.data(), width, height), MetricImage::rgba8(grey2.data(), width, height)), 1e-5f);
+
+			// Symmetric, and decreases with noise.
+			float previous = 1.0f;
+			for (int32 amplitude : { 4, 16, 64 })
+			{
+				std::vector<uint8> noisy = addNoise(scene, amplitude, 5);
+				const MetricImage noisyView = MetricImage::rgba8(noisy.data(), width, height);
+				const float ssim = computeSSIM(sceneView, noisyView);
+				Assert::AreEqual(ssim, computeSSIM(noisyView, sceneView), 1e-6f);
+				Assert::IsTrue(ssim < previous);
+				previous = ssim;
+			}
+			Assert::IsTrue(previous < 0.5f);
+		}
+
+		TEST_METHOD(FLIPKnownAnswer)
+		{
+			const uint32 width = 40, height = 30;
+			std::vector<uint8> scene = makeSceneRgba8(width, height);
+			const MetricImage sceneView = MetricImage::rgba8(scene.data(), width, height);
+			Assert::AreEqual(0.0f, computeFLIP(sceneView, sceneView));
+
+			// Constant images are not changed by filters and have no features,
+			// so FLIP is the remapped HyAB distance of the two colors.
+			std::vector<uint8> black = makeConstantRgba8(width, height, 0, 0, 0);
+			std::vector<uint8> white = makeConstantRgba8(width, height, 255, 255, 255);
+			std::vector<float> errorMap;
+			Assert::AreEqual(0.96738f, computeFLIP(MetricImage::rgba8(black.data(), width, height), MetricImage::rgba8(white.data(), width, height), FLIPParams{}, nullptr, &errorMap), 1e-4f);
+			for (float error : errorMap) Assert::AreEqual(0.96738f, error, 1e-4f);
+
+			std::vector<float> grey = makeConstantRgba32f(width, height, 0.5f, 0.5f, 0.5f);
+			std::vector<float> bluish = makeConstantRgba32f(width, height, 0.5f, 0.5f, 0.6f);
+			std::vector<float> warm = makeConstantRgba32f(width, height, 0.25f, 0.5f, 0.75f);
+			std::vector<float> cold = makeConstantRgba32f(width, height, 0.75f, 0.5f, 0.25f);
+			Assert::AreEqual(0.26316f, computeFLIP(MetricImage::rgba32f(grey.data(), width, height), MetricImage::rgba32f(bluish.data(), width, height)), 1e-4f);
+			Assert::AreEqual(0.94187f, computeFLIP(MetricImage::rgba32f(warm.data(), width, height), MetricImage::rgba32f(cold.data(), width, height)), 1e-4f);
+
+			// A vertical edge moved by one pixel is an error along the edge only.
+			std::vector<uint8> edge1 = makeConstantRgba8(width, height, 0, 0, 0);
+			std::vector<uint8> edge2 = makeConstantRgba8(width, height, 0, 0, 0);
+			for (uint32 y = 0; y < height; ++y)
+			{
+				for (uint32 x = 20; x < width; ++x) ::memset(&edge1[4 * (y * width + x)], 255, 3);
+				for (uint32 x = 21; x < width; ++x) ::memset(&edge2[4 * (y * width + x)], 255, 3);
+			}
+			const float edgeFLIP = computeFLIP(MetricImage::rgba8(edge1.data(), width, height), MetricImage::rgba8(edge2.data(), width, height), FLIPParams{}, nullptr, &errorMap);
+			Assert::IsTrue(edgeFLIP > 0.0f && edgeFLIP < 0.2f);
+			Assert::IsTrue(errorMap[15 * width + 20] > 0.5f);
+			Assert::IsTrue(errorMap[15 * width + 2] < 1e-3f);
+			Assert::IsTrue(errorMap[15 * width + 38] < 1e-3f);
+
+			// Symmetric, in [0, 1], and increases with noise.
+			float previous = 0.0f;
+			for (int32 amplitude : { 4, 16, 64 })
+			{
+				std::vector<uint8> noisy = addNoise(scene, amplitude, 9);
+				const MetricImage noisyView = MetricImage::rgba8(noisy.data(), width, height);
+				const float flip = computeFLIP(sceneView, noisyView, FLIPParams{}, nullptr, &errorMap);
+				Assert::AreEqual(flip, computeFLIP(noisyView, sceneView), 1e-6f);
+				Assert::IsTrue(flip > previous);
+				for (float error : errorMap) Assert::IsTrue(error >= 0.0f && error <= 1.0f);
+				previous = flip;
+			}
+		}
+
+		TEST_METHOD(Heatmap)
+		{
+			const float values[5] = { 0.0f, 1.0f, 2.0f, 0.5f, std::numeric_limits<float>::quiet_NaN() };
+			std::vector<uint8> heatmap;
+			generateHeatmap(values, 5, 1, 1.0f, heatmap);
+			Assert::AreEqual((size_t)20, heatmap.size());
+			const uint8 expected[5][3] = { { 0, 0, 4 }, { 252, 253, 191 }, { 252, 253, 191 }, { 181, 54, 122 }, { 0, 0, 4 } };
+			for (uint32 i = 0; i < 5; ++i)
+			{
+				for (uint32 c = 0; c < 3; ++c) Assert::AreEqual(expected[i][c], heatmap[4 * i + c]);
+				Assert::AreEqual((uint8)255, heatmap[4 * i + 3]);
+			}
+		}
+
+		TEST_METHOD(ParallelSameAsSerial)
+		{
+			ThreadPool threadPool(3);
+			const uint32 width = 203, height = 157;
+			std::vector<uint8> scene = makeSceneRgba8(width, height);
+			std::vector<uint8> noisy = addNoise(scene, 20, 3);
+			std::vector<float> noisyFloat(noisy.size());
+			for (size_t i = 0; i < noisy.size(); ++i) noisyFloat[i] = noisy[i] / 255.0f;
+			const MetricImage reference = MetricImage::rgba8(scene.data(), width, height);
+			const MetricImage test = MetricImage::rgba32f(noisyFloat.data(), width, height);
+
+			ImageErrorStats mse[2];
+			float ssim[2], flip[2];
+			std::vector<float> mseMap[2], ssimMap[2], flipMap[2];
+			std::vector<uint8> heatmap[2];
+			for (uint32 pass = 0; pass < 2; ++pass)
+			{
+				ThreadPool* pool = (pass == 0) ? nullptr : &threadPool;
+				mse[pass] = computeMSE(reference, test, pool, &mseMap[pass]);
+				ssim[pass] = computeSSIM(reference, test, pool, &ssimMap[pass]);
+				flip[pass] = computeFLIP(reference, test, FLIPParams{}, pool, &flipMap[pass]);
+				generateHeatmap(flipMap[pass].data(), width, height, 1.0f, heatmap[pass], pool);
+			}
+			Assert::IsTrue(mse[0].mse == mse[1].mse);
+			Assert::AreEqual(mse[0].numDifferentPixels, mse[1].numDifferentPixels);
+			Assert::AreEqual(ssim[0], ssim[1]);
+			Assert::AreEqual(flip[0], flip[1]);
+			Assert::IsTrue(mseMap[0] == mseMap[1]);
+			Assert::IsTrue(ssimMap[0] == ssimMap[1]);
+			Assert::IsTrue(flipMap[0] == flipMap[1]);
+			Assert::IsTrue(heatmap[0] == heatmap[1]);
+
+			// The float path agrees with the integer path.
+			const ImageErrorStats integerMSE = computeMSE(reference, MetricImage::rgba8(noisy.data(), width, height), &threadPool);
+			Assert::AreEqual(integerMSE.mseAverage, mse[0].mseAverage, 1e-6f * integerMSE.mseAverage);
+			Assert::AreEqual(integerMSE.numDifferentPixels, mse[0].numDifferentPixels);
+		}
+
+		TEST_METHOD(Benchmark4K)
+		{
+			const uint32 width = 3840, height = 2160;
+			std::vector<uint8> reference = makeSceneRgba8(width, height);
+			std::vector<uint8> test = addNoise(reference, 6, 1);
+			const MetricImage referenceView = MetricImage::rgba8(reference.data(), width, height);
+			const MetricImage testView = MetricImage::rgba8(test.data(), width, height);
+			ThreadPool threadPool(ThreadPool::getDefaultNumWorkers());
+			HighFrequencyCounter counter;
+
+			// Per-pixel float loop, as render tests used to compute MSE.
+			counter.start();
+			float errors[3] = { 0.0f, 0.0f, 0.0f };
+			for (uint32 i = 0; i < width * height; ++i)
+			{
+				for (uint32 c = 0; c < 3; ++c)
+				{
+					const float diff = std::abs(reference[4 * i + c] / 255.0f - test[4 * i + c] / 255.0f);
+					errors[c] += diff * diff;
+				}
+			}
+			const float scalarMs = counter.stopWithMilliseconds();
+
+			float serialMs[3], parallelMs[3];
+			ImageErrorStats stats[2];
+			float ssim[2], flip[2];
+			for (uint32 pass = 0; pass < 2; ++pass)
+			{
+				ThreadPool* pool = (pass == 0) ? nullptr : &threadPool;
+				float* timings = (pass == 0) ? serialMs : parallelMs;
+				counter.start(); stats[pass] = computeMSE(referenceView, testView, pool); timings[0] = counter.stopWithMilliseconds();
+				counter.start(); ssim[pass] = computeSSIM(referenceView, testView, pool); timings[1] = counter.stopWithMilliseconds();
+				counter.start(); flip[pass] = computeFLIP(referenceView, testView, FLIPParams{}, pool); timings[2] = counter.stopWithMilliseconds();
+			}
+			Assert::IsTrue(stats[0].mse == stats[1].mse);
+			Assert::AreEqual(ssim[0], ssim[1]);
+			Assert::AreEqual(flip[0], flip[1]);
+			Assert::AreEqual(errors[1] / (width * height), stats[0].mse.y, 1e-2f * stats[0].mse.y);
+
+			const float megaPixels = width * height * 1e-6f;
+			wchar_t msg[512];
+			swprintf_s(msg, L"%ux%u, %u threads. MSE: scalar loop %.2f ms, SIMD %.2f ms, parallel %.2f ms (%.0f MPixel/s). SSIM: %.2f ms, parallel %.2f ms. FLIP: %.2f ms, parallel %.2f ms (%.1f MPixel/s)\n",
+				width, height, threadPool.getNumThreads(), scalarMs, serialMs[0], parallelMs[0], megaPixels / (1e-3f * parallelMs[0]),
+				serialMs[1], parallelMs[1], serialMs[2], parallelMs[2], megaPixels / (1e-3f * parallelMs[2]));
+			UnitLogger::WriteMessage(msg);
+			swprintf_s(msg, L"PSNR %.2f dB, SSIM %.4f, FLIP %.4f\n", stats[0].psnrAverage, ssim[0], flip[0]);
+			UnitLogger::WriteMessage(msg);
+		}
+	};
+}
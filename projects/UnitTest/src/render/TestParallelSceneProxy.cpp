@@ -0,0 +1,234 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "test_scene_utils.h"
+#include "world/scene.h"
+#include "world/scene_proxy.h"
+#include "render/static_mesh.h"
+#include "material/material_database.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <set>
+
+namespace UnitTest
+{
+	using namespace render_test;
+
+	template<typename T>
+	static void assertSameItemIndices(const std::vector<T>& expected, const std::vector<T>& actual)
+	{
+		Assert::AreEqual(expected.size(), actual.size());
+		for (size_t i = 0; i < expected.size(); ++i)
+		{
+			Assert::AreEqual(expected[i].sceneItemIndex, actual[i].sceneItemIndex);
+		}
+	}
+
+	static void assertSameProxies(const SceneProxy* expected, const SceneProxy* actual)
+	{
+		assertSameItemIndices(expected->gpuSceneEvictCommands, actual->gpuSceneEvictCommands);
+		assertSameItemIndices(expected->gpuSceneAllocCommands, actual->gpuSceneAllocCommands);
+		assertSameItemIndices(expected->gpuSceneUpdateCommands, actual->gpuSceneUpdateCommands);
+		assertSameItemIndices(expected->gpuSceneEvictMaterialCommands, actual->gpuSceneEvictMaterialCommands);
+		assertSameItemIndices(expected->gpuSceneMaterialCommands, actual->gpuSceneMaterialCommands);
+		for (size_t i = 0; i < expected->gpuSceneAllocCommands.size(); ++i)
+		{
+			const GPUSceneItem& a = expected->gpuSceneAllocCommands[i].sceneItem;
+			const GPUSceneItem& b = actual->gpuSceneAllocCommands[i].sceneItem;
+			Assert::AreEqual(a.positionBufferOffset, b.positionBufferOffset);
+			Assert::AreEqual(a.indexCount, b.indexCount);
+			Assert::IsTrue(0 == memcmp(&a.localToWorld, &b.localToWorld, sizeof(Float4x4)));
+		}
+		for (size_t i = 0; i < expected->gpuSceneMaterialCommands.size(); ++i)
+		{
+			Assert::AreEqual(expected->gpuSceneMaterialCommands[i].materialData.pipelineKey, actual->gpuSceneMaterialCommands[i].materialData.pipelineKey);
+		}
+		Assert::AreEqual(expected->gpuSceneAlbedoTextures.size(), actual->gpuSceneAlbedoTextures.size());
+		Assert::AreEqual(expected->dirtyMaterials.size(), actual->dirtyMaterials.size());
+
+		Assert::AreEqual(expected->staticMeshes.size(), actual->staticMeshes.size());
+		for (size_t i = 0; i < expected->staticMeshes.size(); ++i)
+		{
+			Assert::AreEqual(expected->staticMeshes[i]->getSections().size(), actual->staticMeshes[i]->getSections().size());
+			Assert::IsTrue(expected->staticMeshes[i]->getLocalToWorld() == actual->staticMeshes[i]->getLocalToWorld());
+		}
+		Assert::AreEqual(expected->totalMeshSectionsLOD0, actual->totalMeshSectionsLOD0);
+		Assert::IsTrue(expected->sceneItemsPerPipeline == actual->sceneItemsPerPipeline);
+		Assert::AreEqual(expected->gpuSceneItemMinValidIndex, actual->gpuSceneItemMinValidIndex);
+		Assert::AreEqual(expected->gpuSceneItemMaxValidIndex, actual->gpuSceneItemMaxValidIndex);
+	}
+
+	TEST_CLASS(TestParallelSceneProxy)
+	{
+	public:
+		TEST_METHOD(SameAsSerial)
+		{
+			MaterialShaderDatabase::get().compileMaterials(nullptr, true);
+			ThreadPool threadPool(3);
+			FakeMeshAssets assets(16);
+
+			Scene serialScene, parallelScene;
+			std::vector<SharedPtr<MaterialAsset>> serialMaterials, parallelMaterials;
+			std::vector<StaticMesh*> serialMeshes, parallelMeshes;
+			const uint32 numMeshes = 3000;
+			addTestMeshes(serialScene, assets, numMeshes, serialMaterials, serialMeshes);
+			addTestMeshes(parallelScene, assets, numMeshes, parallelMaterials, parallelMeshes);
+
+			// Initial allocation.
+			{
+				SceneProxy* expected = serialScene.createProxy();
+				SceneProxy* actual = parallelScene.createProxy(&threadPool);
+				assertSameProxies(expected, actual);
+
+				std::set<uint32> itemIndices;
+				for (const GPUSceneAllocCommand& cmd : actual->gpuSceneAllocCommands) itemIndices.insert(cmd.sceneItemIndex);
+				Assert::AreEqual(actual->gpuSceneAllocCommands.size(), itemIndices.size());
+				Assert::AreEqual((size_t)(numMeshes * 2), itemIndices.size());
+
+				delete expected;
+				delete actual;
+			}
+
+			// Transform, LOD, material changes and removals in the same frame.
+			for (Scene* scene : { &serialScene, &parallelScene })
+			{
+				std::vector<StaticMesh*>& meshes = (scene == &serialScene) ? serialMeshes : parallelMeshes;
+				std::vector<SharedPtr<MaterialAsset>>& materials = (scene == &serialScene) ? serialMaterials : parallelMaterials;
+				for (uint32 i = 0; i < numMeshes; ++i)
+				{
+					if (i % 7 == 0) meshes[i]->setPosition(vec3(0.0f, (float)i, 0.0f));
+					if (i % 5 == 0) meshes[i]->setActiveLOD(1);
+					if (i % 11 == 0) scene->removeStaticMesh(meshes[i]);
+				}
+				// Removed and added again.
+				scene->addStaticMesh(meshes[0]);
+				materials[3]->setRoughness(0.5f);
+			}
+			for (uint32 frame = 0; frame < 3; ++frame)
+			{
+				SceneProxy* expected = serialScene.createProxy();
+				SceneProxy* actual = parallelScene.createProxy(&threadPool);
+				assertSameProxies(expected, actual);
+				if (frame == 0)
+				{
+					Assert::IsTrue(actual->gpuSceneEvictCommands.size() > 0);
+					Assert::IsTrue(actual->gpuSceneUpdateCommands.size() > 0);
+				}
+				delete expected;
+				delete actual;
+			}
+
+			destroyTestMeshes(serialScene, serialMeshes);
+			destroyTestMeshes(parallelScene, parallelMeshes);
+			MaterialShaderDatabase::get().destroyMaterials();
+		}
+
+		// A material is bound with the fallback texture until its albedo texture is ready, then recorded again.
+		// Same for min LOD changes.
+		TEST_METHOD(PendingAlbedoTextureIsBoundWhenReady)
+		{
+			MaterialShaderDatabase::get().compileMaterials(nullptr, true);
+			FakeMeshAssets assets(1);
+			Scene scene;
+			std::vector<SharedPtr<MaterialAsset>> materials;
+			std::vector<StaticMesh*> meshes;
+			addTestMeshes(scene, assets, 2, materials, meshes);
+
+			// Not created yet, like a texture whose render command did not run.
+			auto albedo = makeShared<TextureAsset>();
+			materials[0]->setAlbedoTexture(albedo);
+			// Allocation, then updates of materials that are dirty from the setup.
+			delete scene.createProxy();
+			delete scene.createProxy();
+			{
+				SceneProxy* proxy = scene.createProxy();
+				Assert::AreEqual((size_t)0, proxy->gpuSceneMaterialCommands.size());
+				delete proxy;
+			}
+
+			SharedPtr<Texture> texture = makeShared<FakeTexture>();
+			albedo->setGPUResource(texture);
+			{
+				// Only mesh 0 uses the texture.
+				SceneProxy* proxy = scene.createProxy();
+				Assert::AreEqual((size_t)1, proxy->gpuSceneMaterialCommands.size());
+				Assert::IsTrue(proxy->gpuSceneAlbedoTextures[0].texture == texture.get());
+				delete proxy;
+			}
+			{
+				SceneProxy* proxy = scene.createProxy();
+				Assert::AreEqual((size_t)0, proxy->gpuSceneMaterialCommands.size());
+				delete proxy;
+			}
+
+			// Streaming raises the min LOD when mips are evicted.
+			albedo->setMinLOD(2.0f);
+			{
+				SceneProxy* proxy = scene.createProxy();
+				Assert::AreEqual((size_t)1, proxy->gpuSceneMaterialCommands.size());
+				Assert::AreEqual(2.0f, proxy->gpuSceneAlbedoTextures[0].minLOD);
+				delete proxy;
+			}
+			{
+				SceneProxy* proxy = scene.createProxy();
+				Assert::AreEqual((size_t)0, proxy->gpuSceneMaterialCommands.size());
+				delete proxy;
+			}
+
+			destroyTestMeshes(scene, meshes);
+			MaterialShaderDatabase::get().destroyMaterials();
+		}
+
+		TEST_METHOD(Benchmark100kMeshes)
+		{
+			MaterialShaderDatabase::get().compileMaterials(nullptr, true);
+			ThreadPool threadPool(ThreadPool::getDefaultNumWorkers());
+			FakeMeshAssets assets(64);
+
+			const uint32 numMeshes = 100000;
+			const wchar_t* frameNames[] = { L"Initial allocation", L"All transforms dirty", L"Nothing dirty" };
+			float elapsedMs[2][3];
+
+			for (uint32 pass = 0; pass < 2; ++pass)
+			{
+				ThreadPool* pool = (pass == 0) ? nullptr : &threadPool;
+				Scene scene;
+				std::vector<SharedPtr<MaterialAsset>> materials;
+				std::vector<StaticMesh*> meshes;
+				addTestMeshes(scene, assets, numMeshes, materials, meshes);
+
+				HighFrequencyCounter counter;
+				for (uint32 frame = 0; frame < 3; ++frame)
+				{
+					if (frame == 1)
+					{
+						for (uint32 i = 0; i < numMeshes; ++i) meshes[i]->setPosition(vec3(0.0f, (float)i, 0.0f));
+					}
+					if (frame == 2)
+					{
+						// Dirty transforms need two frames to settle.
+						delete scene.createProxy(pool);
+					}
+					counter.start();
+					SceneProxy* proxy = scene.createProxy(pool);
+					elapsedMs[pass][frame] = counter.stopWithMilliseconds();
+					delete proxy;
+				}
+				destroyTestMeshes(scene, meshes);
+			}
+
+			for (uint32 frame = 0; frame < 3; ++frame)
+			{
+				wchar_t msg[256];
+				swprintf_s(msg, L"%u meshes, %s: serial %.2f ms, parallel %.2f ms (%u threads)\n",
+					numMeshes, frameNames[frame], elapsedMs[0][frame], elapsedMs[1][frame], threadPool.getNumThreads());
+				UnitLogger::WriteMessage(msg);
+			}
+			MaterialShaderDatabase::get().destroyMaterials();
+		}
+	};
+}
@@ -0,0 +1,153 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "render/render_thread.h"
+#include "render/renderer.h"
+#include "world/scene_proxy.h"
+#include "core/high_freq_counter.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace UnitTest
+{
+	// Busy loop that stands in for CPU work of a frame.
+	static void spinFor(float milliseconds)
+	{
+		auto start = std::chrono::steady_clock::now();
+		while (std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() < milliseconds)
+		{
+		}
+	}
+
+	// Headless renderer without any RHI. Counts its own frames.
+	class CpuOnlyRenderer : public Renderer
+	{
+	public:
+		virtual void initialize(RenderDevice* renderDevice) override {}
+		virtual void destroy() override {}
+		virtual void render(const SceneProxy* scene, const Camera* camera, const RendererOptions& renderOptions) override
+		{
+			spinFor(renderMilliseconds);
+			// Frames are rendered one by one in submission order,
+			// so the previous frame should be completed exactly when this one starts.
+			if (renderThread != nullptr && renderThread->getNumCompletedFrames() != numRenderedFrames)
+			{
+				numOutOfOrderFrames += 1;
+			}
+			numRenderedFrames += 1;
+			if (scene != nullptr) numScenesSeen += 1;
+		}
+		virtual void recreateSceneTextures(uint32 sceneWidth, uint32 sceneHeight) override {}
+
+		float renderMilliseconds = 0.0f;
+		const RenderThread* renderThread = nullptr; // Optional, to validate frame order.
+		// Only touched by the render thread
+		uint64 numRenderedFrames = 0;
+		uint64 numOutOfOrderFrames = 0;
+		uint32 numScenesSeen = 0;
+	};
+
+	static RenderFrameSnapshot makeFrame(SceneProxy* sceneProxy = nullptr)
+	{
+		RenderFrameSnapshot frame;
+		frame.sceneProxy = sceneProxy;
+		return frame;
+	}
+
+	TEST_CLASS(TestRenderThread)
+	{
+	public:
+		TEST_METHOD(FrameOrderAndSync)
+		{
+			CpuOnlyRenderer renderer;
+			renderer.renderMilliseconds = 0.2f;
+			RenderThread renderThread;
+			renderer.renderThread = &renderThread;
+			renderThread.start(&renderer, 2);
+
+			const uint32 numFrames = 50;
+			for (uint32 i = 0; i < numFrames; ++i)
+			{
+				uint64 frameNumber = renderThread.submit(makeFrame(new SceneProxy));
+				Assert::AreEqual((uint64)(i + 1), frameNumber);
+
+				// Queue depth is bounded.
+				const uint64 pending = renderThread.getNumSubmittedFrames() - renderThread.getNumCompletedFrames();
+				Assert::IsTrue(pending <= 2);
+
+				if (i == 10)
+				{
+					renderThread.waitForFrame(frameNumber);
+					Assert::IsTrue(renderThread.getNumCompletedFrames() >= frameNumber);
+				}
+			}
+			renderThread.flush();
+			Assert::AreEqual((uint64)numFrames, renderThread.getNumCompletedFrames());
+			renderThread.stop();
+
+			Assert::AreEqual((uint64)numFrames, renderer.numRenderedFrames);
+			Assert::AreEqual((uint64)0, renderer.numOutOfOrderFrames);
+			Assert::AreEqual(numFrames, renderer.numScenesSeen);
+		}
+
+		TEST_METHOD(StopRendersPendingFrames)
+		{
+			CpuOnlyRenderer renderer;
+			renderer.renderMilliseconds = 1.0f;
+			RenderThread renderThread;
+			renderThread.start(&renderer, 4);
+			for (uint32 i = 0; i < 4; ++i)
+			{
+				renderThread.submit(makeFrame());
+			}
+			renderThread.stop();
+			Assert::AreEqual((uint64)4, renderer.numRenderedFrames);
+			Assert::IsFalse(renderThread.isRunning());
+		}
+
+		// Main thread work and render work per frame are simulated with busy loops.
+		TEST_METHOD(PipeliningBenchmark)
+		{
+			const uint32 numFrames = 60;
+			const float mainMs = 2.0f;
+			const float renderMs = 2.0f;
+
+			CpuOnlyRenderer renderer;
+			renderer.renderMilliseconds = renderMs;
+
+			HighFrequencyCounter counter;
+			counter.start();
+			for (uint32 i = 0; i < numFrames; ++i)
+			{
+				spinFor(mainMs);
+				RenderFrameSnapshot frame = makeFrame();
+				renderer.render(frame.sceneProxy, &frame.camera, frame.rendererOptions);
+			}
+			const float lockstepMs = counter.stopWithMilliseconds();
+
+			renderer.numRenderedFrames = 0;
+			RenderThread renderThread;
+			renderThread.start(&renderer, 2);
+			counter.start();
+			for (uint32 i = 0; i < numFrames; ++i)
+			{
+				spinFor(mainMs);
+				renderThread.submit(makeFrame());
+			}
+			renderThread.flush();
+			const float pipelinedMs = counter.stopWithMilliseconds();
+			renderThread.stop();
+			Assert::AreEqual((uint64)numFrames, renderer.numRenderedFrames);
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"%u frames (main %.1f ms + render %.1f ms): lockstep %.1f fps, render thread %.1f fps (%u hardware threads)\n",
+				numFrames, mainMs, renderMs,
+				1000.0f * numFrames / lockstepMs, 1000.0f * numFrames / pipelinedMs,
+				std::thread::hardware_concurrency());
+			UnitLogger::WriteMessage(msg);
+		}
+	};
+}
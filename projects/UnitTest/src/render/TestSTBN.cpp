@@ -1,11 +1,21 @@
 #include "pch.h"
 #include "CppUnitTest.h"
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
 
 #include "core/vec3.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
 #include "loader/image_loader.h"
+#include "loader/mip_generator.h"
+#include "loader/texture_cache.h"
 #include "util/resource_finder.h"
 
+#include <vector>
+#include <memory>
+#include <filesystem>
+#include <cstring>
+
 #define STBN_DIR            L"external/NVidiaSTBNUnzippedAssets/STBN/"
 #define STBN_WIDTH          128
 #define STBN_HEIGHT         128
@@ -17,6 +27,20 @@ static std::wstring STBN_FILEPATH(size_t ix)
 	return buf;
 }
 
+static std::vector<std::wstring> findSTBNSlices()
+{
+	ResourceFinder::get().addBaseDirectory(L"../");
+	ResourceFinder::get().addBaseDirectory(L"../../");
+	ResourceFinder::get().addBaseDirectory(L"../../external/");
+
+	std::vector<std::wstring> filepaths(STBN_SLICES);
+	for (size_t ix = 0; ix < STBN_SLICES; ++ix)
+	{
+		filepaths[ix] = ResourceFinder::get().find(STBN_FILEPATH(ix));
+	}
+	return filepaths;
+}
+
 namespace UnitTest
 {
 	TEST_CLASS(TestSTBN)
@@ -46,7 +70,7 @@ namespace UnitTest
 				uint32 pixelBytes = (uint32)(blob->getRowPitch() / (blob->width * blob->numComponents));
 				Assert::AreEqual(pixelBytes, 1u);
 
-				uint8* ptr = blob->buffer;
+				uint8* ptr = blob->getBuffer();
 				for (uint32 y = 0; y < STBN_HEIGHT; ++y)
 				{
 					for (uint32 x = 0; x < STBN_WIDTH; ++x)
@@ -75,5 +99,93 @@ namespace UnitTest
 			swprintf_s(msg, L"numFail = %u", numFail);
 			Assert::AreEqual(numFail, 0u, msg);
 		}
+
+		TEST_METHOD(CachedVolumeMatchesSlices)
+		{
+			const std::vector<std::wstring> filepaths = findSTBNSlices();
+			for (const std::wstring& filepath : filepaths)
+			{
+				Assert::AreNotEqual(filepath.size(), (size_t)0);
+			}
+
+			ThreadPool threadPool(3);
+			std::unique_ptr<MipChain> volume(decodeVolumeSlices(filepaths, &threadPool));
+			Assert::IsNotNull(volume.get());
+			Assert::AreEqual((uint32)STBN_WIDTH, volume->levels[0].width);
+			Assert::AreEqual((uint32)STBN_HEIGHT, volume->levels[0].height);
+			std::unique_ptr<MipChain> serialVolume(decodeVolumeSlices(filepaths));
+			Assert::IsTrue(volume->data == serialVolume->data);
+
+			const std::filesystem::path cacheDir = std::filesystem::temp_directory_path() / L"cyseal_test_stbn_cache";
+			const TextureCache cache(cacheDir.wstring());
+			const TextureCacheKey key{ .sourcePaths = filepaths, .settingsHash = 0 };
+			Assert::IsTrue(cache.store(key, *volume, STBN_SLICES));
+
+			// Each slice of the cache entry has the same checksum as its PNG decoded alone.
+			{
+				std::unique_ptr<TextureCacheEntry> entry(cache.find(key));
+				Assert::IsNotNull(entry.get());
+				Assert::IsTrue(entry->format == EPixelFormat::R8G8B8A8_UNORM);
+				Assert::AreEqual((uint32)STBN_SLICES, entry->depth);
+				const uint64 slicePitch = entry->levels[0].slicePitch;
+
+				ImageLoader loader;
+				for (uint32 slice = 0; slice < STBN_SLICES; ++slice)
+				{
+					std::unique_ptr<ImageLoadData> blob(loader.load(filepaths[slice], false, false));
+					Assert::AreEqual(blob->getSlicePitch(), slicePitch);
+					Assert::AreEqual(
+						hashTextureCacheBytes(blob->getBuffer(), blob->getSlicePitch()),
+						hashTextureCacheBytes(entry->getSliceData(0, slice), slicePitch));
+				}
+			}
+			std::filesystem::remove_all(cacheDir);
+		}
+
+		TEST_METHOD(BenchmarkStartup)
+		{
+			const std::vector<std::wstring> filepaths = findSTBNSlices();
+			const std::filesystem::path cacheDir = std::filesystem::temp_directory_path() / L"cyseal_bench_stbn_cache";
+			HighFrequencyCounter counter;
+
+			// Same as startup before caching: one slice after another.
+			counter.start();
+			{
+				ImageLoader loader;
+				std::vector<uint8> data(uint64(STBN_WIDTH) * STBN_HEIGHT * 4 * STBN_SLICES);
+				for (uint32 slice = 0; slice < STBN_SLICES; ++slice)
+				{
+					std::unique_ptr<ImageLoadData> blob(loader.load(filepaths[slice]));
+					::memcpy(data.data() + slice * blob->getSlicePitch(), blob->getBuffer(), blob->getSlicePitch());
+				}
+			}
+			const float serialMs = counter.stopWithMilliseconds();
+
+			ThreadPool threadPool(ThreadPool::getDefaultNumWorkers());
+			counter.start();
+			std::unique_ptr<MipChain> volume(decodeVolumeSlices(filepaths, &threadPool));
+			const float parallelMs = counter.stopWithMilliseconds();
+			Assert::IsNotNull(volume.get());
+			const TextureCache cache(cacheDir.wstring());
+			const TextureCacheKey key{ .sourcePaths = filepaths, .settingsHash = 0 };
+			Assert::IsTrue(cache.store(key, *volume, STBN_SLICES));
+
+			// Touch all data, as the upload would.
+			counter.start();
+			uint64 checksum = 0;
+			{
+				std::unique_ptr<TextureCacheEntry> entry(cache.find(key));
+				Assert::IsNotNull(entry.get());
+				checksum = hashTextureCacheBytes(entry->getLevelData(0), entry->levels[0].slicePitch * entry->depth);
+			}
+			const float cachedMs = counter.stopWithMilliseconds();
+			Assert::AreEqual(hashTextureCacheBytes(volume->data.data(), volume->data.size()), checksum);
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"STBN %ux%ux%u: serial PNG decode %.3f ms, parallel decode %.3f ms (%u threads), texture cache %.3f ms\n",
+				STBN_WIDTH, STBN_HEIGHT, STBN_SLICES, serialMs, parallelMs, threadPool.getNumThreads(), cachedMs);
+			UnitLogger::WriteMessage(msg);
+			std::filesystem::remove_all(cacheDir);
+		}
 	};
 }
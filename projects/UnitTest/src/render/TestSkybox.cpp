@@ -170,7 +170,7 @@ private:
 				for (uint32 i = 0; i < 6; ++i)
 				{
 					texture->uploadData(&commandList,
-						skyboxBlobs[i]->buffer,
+						skyboxBlobs[i]->getBuffer(),
 						skyboxBlobs[i]->getRowPitch(),
 						skyboxBlobs[i]->getSlicePitch(),
 						i);
@@ -0,0 +1,223 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "test_scene_utils.h"
+#include "world/scene.h"
+#include "world/scene_proxy.h"
+#include "render/static_mesh.h"
+#include "render/static_mesh_draw_buckets.h"
+#include "memory/frame_allocator.h"
+#include "material/material_database.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <set>
+#include <random>
+#include <algorithm>
+
+namespace UnitTest
+{
+	using namespace render_test;
+
+	// Draws with the same sort key might be in any order.
+	static void assertSameDrawBuckets(const StaticMeshDrawBuckets& expected, const StaticMeshDrawBuckets& actual)
+	{
+		Assert::AreEqual(expected.getNumBuckets(), actual.getNumBuckets());
+		for (uint32 bucket = 0; bucket < expected.getNumBuckets(); ++bucket)
+		{
+			const std::vector<StaticMeshDrawKey>& a = expected.getDraws(bucket);
+			const std::vector<StaticMeshDrawKey>& b = actual.getDraws(bucket);
+			Assert::AreEqual(a.size(), b.size());
+
+			std::vector<std::pair<uint64, uint32>> drawsA, drawsB;
+			for (size_t i = 0; i < a.size(); ++i)
+			{
+				Assert::IsTrue(i == 0 || b[i - 1].sortKey <= b[i].sortKey);
+				Assert::IsTrue(expected.getSection(a[i].sceneItemIndex) == actual.getSection(a[i].sceneItemIndex));
+				drawsA.emplace_back(a[i].sortKey, a[i].sceneItemIndex);
+				drawsB.emplace_back(b[i].sortKey, b[i].sceneItemIndex);
+			}
+			std::sort(drawsA.begin(), drawsA.end());
+			std::sort(drawsB.begin(), drawsB.end());
+			Assert::IsTrue(drawsA == drawsB);
+		}
+	}
+
+	TEST_CLASS(TestStaticMeshDrawBuckets)
+	{
+	public:
+		TEST_METHOD(RadixSort)
+		{
+			std::mt19937_64 rng(7);
+			std::vector<StaticMeshDrawKey> keys, expected, scratch;
+			for (uint32 numKeys : { 0u, 1u, 2u, 100u, 10000u })
+			{
+				for (uint32 keyType : { 0u, 1u, 2u })
+				{
+					keys.clear();
+					for (uint32 i = 0; i < numKeys; ++i)
+					{
+						// Random keys, a few distinct keys, and keys that differ only in a few bytes.
+						uint64 key = rng();
+						if (keyType == 1) key = makeStaticMeshDrawSortKey((uint32)(key % 4), 0, 0, (uint32)(key % 3));
+						if (keyType == 2) key &= 0x00ff00000000ff00ull;
+						keys.emplace_back(StaticMeshDrawKey{ key, i, 0 });
+					}
+					expected = keys;
+					std::stable_sort(expected.begin(), expected.end(),
+						[](const StaticMeshDrawKey& a, const StaticMeshDrawKey& b) { return a.sortKey < b.sortKey; });
+					radixSortStaticMeshDrawKeys(keys, scratch);
+
+					Assert::AreEqual(expected.size(), keys.size());
+					for (size_t i = 0; i < keys.size(); ++i)
+					{
+						Assert::AreEqual(expected[i].sortKey, keys[i].sortKey);
+						Assert::AreEqual(expected[i].sceneItemIndex, keys[i].sceneItemIndex);
+					}
+				}
+			}
+		}
+
+		// Meshes are removed, added back and change LODs every frame.
+		TEST_METHOD(SameAsRebuild)
+		{
+			MaterialShaderDatabase::get().compileMaterials(nullptr, true);
+			ThreadPool threadPool(3);
+			FakeMeshAssets assets(256);
+
+			Scene scene;
+			std::vector<SharedPtr<MaterialAsset>> materials;
+			std::vector<StaticMesh*> meshes;
+			const uint32 numMeshes = 2000;
+			addTestMeshes(scene, assets, numMeshes, materials, meshes);
+
+			StaticMeshDrawBuckets incremental;
+			LinearAllocator allocator;
+			std::vector<bool> inScene(numMeshes, true);
+			std::mt19937 rng(17);
+			for (uint32 frame = 0; frame < 40; ++frame)
+			{
+				if (frame == 20)
+				{
+					// Moves sections to another pipeline.
+					materials[3]->setDoubleSided(false);
+				}
+				else if (frame == 30)
+				{
+					// Transform only.
+					for (uint32 i = 0; i < numMeshes; ++i) meshes[i]->setPosition(vec3((float)i, (float)frame, 0.0f));
+				}
+				else if (frame > 0)
+				{
+					std::set<uint32> touched;
+					for (uint32 n = 0; n < 50; ++n)
+					{
+						const uint32 i = rng() % numMeshes;
+						if (!touched.insert(i).second) continue;
+						const uint32 change = rng() % 3;
+						if (change == 0 && inScene[i])
+						{
+							meshes[i]->setActiveLOD(1 - meshes[i]->getActiveLOD());
+						}
+						else if (change == 1 && inScene[i])
+						{
+							scene.removeStaticMesh(meshes[i]);
+							inScene[i] = false;
+						}
+						else if (!inScene[i])
+						{
+							scene.addStaticMesh(meshes[i]);
+							inScene[i] = true;
+						}
+					}
+				}
+
+				SceneProxy* proxy = scene.createProxy((frame % 2) ? &threadPool : nullptr);
+				incremental.update(proxy, &allocator);
+				StaticMeshDrawBuckets expected;
+				expected.rebuild(proxy, &allocator);
+				assertSameDrawBuckets(expected, incremental);
+				if (frame == 30)
+				{
+					Assert::AreEqual(0u, incremental.getNumChangedItems());
+					Assert::AreEqual(0u, incremental.getNumSortedBuckets());
+				}
+				delete proxy;
+				allocator.reset();
+			}
+
+			for (uint32 i = 0; i < numMeshes; ++i)
+			{
+				if (!inScene[i]) scene.addStaticMesh(meshes[i]);
+			}
+			delete scene.createProxy();
+			destroyTestMeshes(scene, meshes);
+			MaterialShaderDatabase::get().destroyMaterials();
+		}
+
+		TEST_METHOD(Benchmark100kSections)
+		{
+			MaterialShaderDatabase::get().compileMaterials(nullptr, true);
+			ThreadPool threadPool(ThreadPool::getDefaultNumWorkers());
+			FakeMeshAssets assets(1024);
+
+			Scene scene;
+			std::vector<SharedPtr<MaterialAsset>> materials;
+			std::vector<StaticMesh*> meshes;
+			// 2 sections per mesh on average.
+			const uint32 numMeshes = 50000;
+			addTestMeshes(scene, assets, numMeshes, materials, meshes);
+
+			// Dirty transforms need two frames to settle.
+			StaticMeshDrawBuckets incremental, rebuilt;
+			LinearAllocator allocator;
+			uint32 numSections = 0;
+			for (uint32 frame = 0; frame < 2; ++frame)
+			{
+				SceneProxy* proxy = scene.createProxy(&threadPool);
+				incremental.update(proxy, &allocator);
+				numSections = proxy->totalMeshSectionsLOD0;
+				delete proxy;
+			}
+
+			const wchar_t* frameNames[] = { L"1% of meshes change LOD", L"Nothing changed" };
+			float elapsedMs[2][2];
+			uint32 numChangedItems[2];
+			HighFrequencyCounter counter;
+			for (uint32 frame = 0; frame < 2; ++frame)
+			{
+				if (frame == 0)
+				{
+					for (uint32 i = 0; i < numMeshes; i += 100) meshes[i]->setActiveLOD(1);
+				}
+				SceneProxy* proxy = scene.createProxy(&threadPool);
+
+				counter.start();
+				incremental.update(proxy, &allocator);
+				elapsedMs[frame][0] = counter.stopWithMilliseconds();
+				numChangedItems[frame] = incremental.getNumChangedItems();
+
+				counter.start();
+				rebuilt.rebuild(proxy, &allocator);
+				elapsedMs[frame][1] = counter.stopWithMilliseconds();
+
+				assertSameDrawBuckets(rebuilt, incremental);
+				delete proxy;
+			}
+
+			for (uint32 frame = 0; frame < 2; ++frame)
+			{
+				wchar_t msg[256];
+				swprintf_s(msg, L"%u sections, %s: update %.3f ms (%u items changed), rebuild %.3f ms\n",
+					numSections, frameNames[frame], elapsedMs[frame][0], numChangedItems[frame], elapsedMs[frame][1]);
+				UnitLogger::WriteMessage(msg);
+			}
+
+			destroyTestMeshes(scene, meshes);
+			MaterialShaderDatabase::get().destroyMaterials();
+		}
+	};
+}
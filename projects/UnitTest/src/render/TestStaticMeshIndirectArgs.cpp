@@ -0,0 +1,239 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "test_scene_utils.h"
+#include "world/scene.h"
+#include "world/scene_proxy.h"
+#include "render/static_mesh.h"
+#include "render/static_mesh_draw_buckets.h"
+#include "render/static_mesh_indirect_args.h"
+#include "rhi/pipeline_state.h"
+#include "material/material_database.h"
+#include "core/thread_pool.h"
+#include "core/high_freq_counter.h"
+
+#include <vector>
+#include <cstring>
+
+namespace UnitTest
+{
+	using namespace render_test;
+
+	// Layout of D3D12 for the static mesh command signature, plus padding at the end of each command.
+	class FakeIndirectCommandGenerator : public IndirectCommandGenerator
+	{
+	public:
+		static constexpr uint32 kByteStride = 80; // 72 bytes of arguments
+		static constexpr uint32 kPaddingBytes = 8;
+
+		virtual void initialize(const CommandSignatureDesc& desc, uint32 inMaxCommandCount) override { resizeMaxCommandCount(inMaxCommandCount); }
+		virtual void resizeMaxCommandCount(uint32 newMaxCount) override { memblock.resize((size_t)kByteStride * newMaxCount, 0xcd); }
+
+		virtual void beginCommand(uint32 commandIx) override
+		{
+			CHECK(commandIx < getMaxCommandCount());
+			IndirectCommandGenerator::beginCommand(cursor, memblock.data() + (size_t)kByteStride * commandIx);
+		}
+
+		virtual void writeConstant32(IndirectCommandCursor& inCursor, uint32 constant) const override { write(inCursor, constant); }
+		virtual void writeVertexBufferView(IndirectCommandCursor& inCursor, VertexBuffer* vbuffer) const override
+		{
+			write(inCursor, vbuffer->getBufferOffsetInBytes());
+			write(inCursor, vbuffer->getBufferSizeInBytes());
+			write(inCursor, vbuffer->getBufferStrideInBytes());
+		}
+		virtual void writeIndexBufferView(IndirectCommandCursor& inCursor, IndexBuffer* ibuffer) const override
+		{
+			write(inCursor, ibuffer->getBufferOffsetInBytes());
+			write(inCursor, ibuffer->getBufferSizeInBytes());
+			write(inCursor, (uint32)ibuffer->getIndexFormat());
+		}
+		virtual void writeDrawArguments(IndirectCommandCursor& inCursor, uint32, uint32, uint32, uint32) const override { CHECK_NO_ENTRY(); }
+		virtual void writeDrawIndexedArguments(
+			IndirectCommandCursor& inCursor,
+			uint32 indexCountPerInstance,
+			uint32 instanceCount,
+			uint32 startIndexLocation,
+			int32  baseVertexLocation,
+			uint32 startInstanceLocation) const override
+		{
+			write(inCursor, indexCountPerInstance);
+			write(inCursor, instanceCount);
+			write(inCursor, startIndexLocation);
+			write(inCursor, baseVertexLocation);
+			write(inCursor, startInstanceLocation);
+		}
+		virtual void writeDispatchArguments(IndirectCommandCursor& inCursor, uint32, uint32, uint32) const override { CHECK_NO_ENTRY(); }
+		virtual void writeConstantBufferView(IndirectCommandCursor& inCursor, ConstantBufferView* view) const override { CHECK_NO_ENTRY(); }
+		virtual void writeShaderResourceView(IndirectCommandCursor& inCursor, ShaderResourceView* view) const override { CHECK_NO_ENTRY(); }
+		virtual void writeUnorderedAccessView(IndirectCommandCursor& inCursor, UnorderedAccessView* view) const override { CHECK_NO_ENTRY(); }
+		virtual void writeDispatchRaysArguments(IndirectCommandCursor& inCursor, const DispatchRaysDesc& desc) const override { CHECK_NO_ENTRY(); }
+		virtual void writeDispatchMeshArguments(IndirectCommandCursor& inCursor, uint32, uint32, uint32) const override { CHECK_NO_ENTRY(); }
+
+		virtual void endCommand(IndirectCommandCursor& inCursor) const override
+		{
+			::memset(inCursor.writePtr, 0, kPaddingBytes);
+			inCursor.writePtr = nullptr;
+		}
+
+		virtual uint32 getMaxCommandCount() const override { return (uint32)(memblock.size() / kByteStride); }
+		virtual uint32 getCommandByteStride() const override { return kByteStride; }
+		virtual const uint8* getCommandData() const override { return memblock.data(); }
+		virtual void copyToBuffer(RenderCommandList* commandList, uint32 numCommands, Buffer* destBuffer, uint64 destOffset) override { CHECK_NO_ENTRY(); }
+
+	private:
+		template<typename T>
+		static void write(IndirectCommandCursor& inCursor, T value)
+		{
+			CHECK(inCursor.writePtr != nullptr);
+			::memcpy(inCursor.writePtr, &value, sizeof(T));
+			inCursor.writePtr += sizeof(T);
+		}
+
+		std::vector<uint8> memblock;
+	};
+
+	// The serial loop that was used before the cursor API, with the stateful API of the generator.
+	static uint32 writeWithStatefulAPI(IndirectCommandGenerator& generator, const StaticMeshDrawBuckets& drawBuckets, const std::vector<StaticMeshDrawKey>& draws)
+	{
+		generator.resizeMaxCommandCount((uint32)draws.size());
+		uint32 indirectCommandID = 0;
+		for (const StaticMeshDrawKey& draw : draws)
+		{
+			const StaticMeshSection* section = drawBuckets.getSection(draw.sceneItemIndex);
+			IndexBuffer* indexBuffer = section->indexBuffer->getGPUResource().get();
+			if (indexBuffer->getIndexCount() == 0)
+			{
+				continue;
+			}
+
+			generator.beginCommand(indirectCommandID);
+			generator.writeConstant32(draw.sceneItemIndex);
+			generator.writeVertexBufferView(section->positionBuffer->getGPUResource().get());
+			generator.writeVertexBufferView(section->nonPositionBuffer->getGPUResource().get());
+			generator.writeIndexBufferView(indexBuffer);
+			generator.writeDrawIndexedArguments(indexBuffer->getIndexCount(), 1, 0, 0, 0);
+			generator.endCommand();
+
+			++indirectCommandID;
+		}
+		return indirectCommandID;
+	}
+
+	TEST_CLASS(TestStaticMeshIndirectArgs)
+	{
+	public:
+		TEST_METHOD(SameAsStatefulAPI)
+		{
+			MaterialShaderDatabase::get().compileMaterials(nullptr, true);
+			ThreadPool threadPool(3);
+			FakeMeshAssets assets(64);
+			// Sections without indices are skipped.
+			for (uint32 i = 0; i < 64; i += 5)
+			{
+				assets.indexBuffers[i] = makeShared<IndexBufferAsset>(makeShared<FakeIndexBuffer>(i * 512, 0));
+			}
+
+			Scene scene;
+			std::vector<SharedPtr<MaterialAsset>> materials;
+			std::vector<StaticMesh*> meshes;
+			addTestMeshes(scene, assets, 6000, materials, meshes);
+			SceneProxy* proxy = scene.createProxy();
+			StaticMeshDrawBuckets drawBuckets;
+			LinearAllocator allocator;
+			drawBuckets.rebuild(proxy, &allocator);
+
+			FakeIndirectCommandGenerator generator;
+			const uint32 byteStride = generator.getCommandByteStride();
+			uint32 numParallelBuckets = 0;
+			for (uint32 bucket = 0; bucket < drawBuckets.getNumBuckets(); ++bucket)
+			{
+				const std::vector<StaticMeshDrawKey>& draws = drawBuckets.getDraws(bucket);
+				const uint32 numExpected = writeWithStatefulAPI(generator, drawBuckets, draws);
+				Assert::IsTrue(draws.empty() || numExpected < (uint32)draws.size());
+				if (draws.size() > STATIC_MESH_INDIRECT_ARGS_GRAIN_SIZE)
+				{
+					++numParallelBuckets;
+				}
+
+				for (ThreadPool* pool : { (ThreadPool*)nullptr, &threadPool })
+				{
+					std::vector<uint8> actual(byteStride * draws.size() + 1, 0xab);
+					const uint32 numActual = writeStaticMeshIndirectCommands(&generator, drawBuckets, draws, actual.data(), pool);
+					Assert::AreEqual(numExpected, numActual);
+					Assert::IsTrue(0 == ::memcmp(generator.getCommandData(), actual.data(), byteStride * numActual));
+					// Nothing is written past the last command.
+					Assert::AreEqual((uint8)0xab, actual[byteStride * numActual]);
+				}
+
+				// First command: object id, position VBV (address, size, stride)
+				if (numExpected > 0)
+				{
+					const uint8* command = generator.getCommandData();
+					uint32 objectID;
+					uint64 positionAddress;
+					::memcpy(&objectID, command, sizeof(uint32));
+					::memcpy(&positionAddress, command + 4, sizeof(uint64));
+					const StaticMeshSection* section = drawBuckets.getSection(objectID);
+					Assert::IsTrue(section != nullptr);
+					Assert::AreEqual(section->positionBuffer->getGPUResource()->getBufferOffsetInBytes(), positionAddress);
+				}
+			}
+			Assert::IsTrue(numParallelBuckets > 0);
+
+			delete proxy;
+			destroyTestMeshes(scene, meshes);
+			MaterialShaderDatabase::get().destroyMaterials();
+		}
+
+		TEST_METHOD(Benchmark100kDraws)
+		{
+			MaterialShaderDatabase::get().compileMaterials(nullptr, true);
+			ThreadPool threadPool(ThreadPool::getDefaultNumWorkers());
+			FakeMeshAssets assets(1024);
+
+			Scene scene;
+			std::vector<SharedPtr<MaterialAsset>> materials;
+			std::vector<StaticMesh*> meshes;
+			// 2 sections per mesh on average.
+			addTestMeshes(scene, assets, 50000, materials, meshes);
+			SceneProxy* proxy = scene.createProxy();
+			StaticMeshDrawBuckets drawBuckets;
+			LinearAllocator allocator;
+			drawBuckets.rebuild(proxy, &allocator);
+
+			FakeIndirectCommandGenerator generator;
+			const uint32 byteStride = generator.getCommandByteStride();
+			uint32 numDraws = 0;
+			float elapsedMs[2] = { 0.0f, 0.0f };
+			HighFrequencyCounter counter;
+			for (uint32 bucket = 0; bucket < drawBuckets.getNumBuckets(); ++bucket)
+			{
+				const std::vector<StaticMeshDrawKey>& draws = drawBuckets.getDraws(bucket);
+				std::vector<uint8> commands(byteStride * draws.size());
+				numDraws += (uint32)draws.size();
+
+				for (uint32 pass = 0; pass < 2; ++pass)
+				{
+					counter.start();
+					writeStaticMeshIndirectCommands(&generator, drawBuckets, draws, commands.data(), pass == 0 ? nullptr : &threadPool);
+					elapsedMs[pass] += counter.stopWithMilliseconds();
+				}
+			}
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"%u draws: serial %.3f ms (%.1f M/s), parallel %.3f ms (%.1f M/s, %u threads)\n",
+				numDraws,
+				elapsedMs[0], 0.001f * numDraws / elapsedMs[0],
+				elapsedMs[1], 0.001f * numDraws / elapsedMs[1],
+				threadPool.getNumThreads());
+			UnitLogger::WriteMessage(msg);
+
+			delete proxy;
+			destroyTestMeshes(scene, meshes);
+			MaterialShaderDatabase::get().destroyMaterials();
+		}
+	};
+}
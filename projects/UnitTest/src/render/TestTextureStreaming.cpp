@@ -0,0 +1,428 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "render/texture_streaming.h"
+#include "world/camera.h"
+
+#include <vector>
+#include <map>
+#include <chrono>
+#include <thread>
+
+#define TEST_TEXTURE_SIZE      1024u
+#define TEST_TEXTURE_NUM_MIPS  11
+#define TEST_SCREEN_HEIGHT     1080
+
+namespace UnitTest
+{
+	static uint8 getTestMipPattern(uint32 mipLevel)
+	{
+		return (uint8)(mipLevel * 7 + 1);
+	}
+
+	// Fills mips with a pattern that SimulatedTextureMemory verifies.
+	class TestMipSource : public ITextureMipSource
+	{
+	public:
+		TestMipSource(uint32 inSize, uint32 inDelayMs = 0) : size(inSize), delayMs(inDelayMs) {}
+
+		virtual bool readMip(uint32 mipLevel, std::vector<uint8>& outData) override
+		{
+			if (delayMs > 0)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+			}
+			const uint32 mipSize = std::max(1u, size >> mipLevel);
+			outData.assign(uint64(mipSize) * mipSize * 4, getTestMipPattern(mipLevel));
+			return true;
+		}
+
+	private:
+		uint32 size;
+		uint32 delayMs;
+	};
+
+	// Stands in for GPU memory. Checks the order of residency changes.
+	class SimulatedTextureMemory : public ITextureStreamingBackend
+	{
+	public:
+		struct Residency
+		{
+			uint32 firstMip = 0xffffffff;
+			uint64 bytes = 0;
+			std::vector<uint64> mipBytes = std::vector<uint64>(32, 0);
+		};
+
+		virtual void makeMipResident(SlotHandle texture, uint32 mipLevel, const uint8* data, uint64 size) override
+		{
+			Residency& residency = textures[getKey(texture)];
+			if (residency.firstMip != 0xffffffff)
+			{
+				Assert::AreEqual(residency.firstMip - 1, mipLevel, L"Mips should be made resident from coarse to fine");
+			}
+			Assert::AreEqual(getTestMipPattern(mipLevel), data[0]);
+			Assert::AreEqual(getTestMipPattern(mipLevel), data[size - 1]);
+			residency.firstMip = mipLevel;
+			residency.bytes += size;
+			residency.mipBytes[mipLevel] = size;
+			totalBytes += size;
+			peakBytes = std::max(peakBytes, totalBytes);
+		}
+		virtual void evictMip(SlotHandle texture, uint32 mipLevel) override
+		{
+			auto it = textures.find(getKey(texture));
+			Assert::IsTrue(it != textures.end());
+			Assert::AreEqual(it->second.firstMip, mipLevel, L"Mips should be evicted from fine to coarse");
+			it->second.firstMip += 1;
+			it->second.bytes -= it->second.mipBytes[mipLevel];
+			totalBytes -= it->second.mipBytes[mipLevel];
+		}
+		virtual void releaseTexture(SlotHandle texture) override
+		{
+			auto it = textures.find(getKey(texture));
+			Assert::IsTrue(it != textures.end());
+			totalBytes -= it->second.bytes;
+			textures.erase(it);
+		}
+
+		uint32 getFirstMip(SlotHandle texture) const { return textures.at(getKey(texture)).firstMip; }
+
+		std::map<uint64, Residency> textures;
+		uint64 totalBytes = 0;
+		uint64 peakBytes = 0;
+
+	private:
+		static uint64 getKey(SlotHandle handle) { return (uint64(handle.generation) << 32) | handle.index; }
+	};
+
+	// Recorded fly-through of a corridor of textured boxes.
+	struct CameraKeyframe
+	{
+		uint32 frame;
+		vec3   position;
+		vec3   target;
+	};
+	static const CameraKeyframe cameraPath[] = {
+		{   0, vec3(0.0f, 0.0f,   10.0f), vec3(0.0f, 0.0f,    0.0f) },
+		{  60, vec3(0.0f, 0.0f, -100.0f), vec3(0.0f, 0.0f, -110.0f) },
+		{  90, vec3(0.0f, 0.0f, -130.0f), vec3(6.0f, 0.0f, -130.0f) },
+		{ 120, vec3(0.0f, 0.0f, -230.0f), vec3(0.0f, 0.0f, -240.0f) },
+		{ 150, vec3(0.0f, 0.0f, -230.0f), vec3(0.0f, 0.0f,    0.0f) },
+		{ 200, vec3(0.0f, 0.0f,  -40.0f), vec3(0.0f, 0.0f,    0.0f) },
+	};
+	static const uint32 cameraPathLength = 200;
+
+	static TextureStreamingView getCameraPathView(uint32 frame)
+	{
+		uint32 key = 0;
+		while (key + 2 < _countof(cameraPath) && cameraPath[key + 1].frame <= frame)
+		{
+			++key;
+		}
+		const CameraKeyframe& k0 = cameraPath[key];
+		const CameraKeyframe& k1 = cameraPath[key + 1];
+		const float t = std::min(1.0f, (float)(frame - k0.frame) / (float)(k1.frame - k0.frame));
+
+		Camera camera;
+		camera.perspective(60.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+		camera.lookAt(k0.position + t * (k1.position - k0.position), k0.target + t * (k1.target - k0.target), vec3(0.0f, 1.0f, 0.0f));
+		return TextureStreamingView::fromCamera(camera, TEST_SCREEN_HEIGHT);
+	}
+
+	struct CorridorScene
+	{
+		static constexpr uint32 numBoxes = 24;
+
+		CorridorScene(TextureStreamingManager& streaming, uint32 sourceDelayMs = 0)
+		{
+			for (uint32 i = 0; i < numBoxes; ++i)
+			{
+				SlotHandle texture = streaming.registerTexture(
+					makeShared<TestMipSource>(TEST_TEXTURE_SIZE, sourceDelayMs),
+					EPixelFormat::R8G8B8A8_UNORM, TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, TEST_TEXTURE_NUM_MIPS);
+				Assert::IsTrue(texture.isValid());
+				// Boxes on both sides, 4 world units per UV.
+				const vec3 center((i % 2) ? 6.0f : -6.0f, 0.0f, -10.0f * (float)i);
+				streaming.addUsage(texture, AABB::fromCenterAndHalfSize(center, vec3(2.0f)), 4.0f);
+				textures.push_back(texture);
+			}
+		}
+
+		std::vector<SlotHandle> textures;
+	};
+
+	static uint64 getFullTextureBytes()
+	{
+		uint64 bytes = 0;
+		for (uint32 mip = 0; mip < TEST_TEXTURE_NUM_MIPS; ++mip)
+		{
+			const uint64 size = std::max(1u, TEST_TEXTURE_SIZE >> mip);
+			bytes += size * size * 4;
+		}
+		return bytes;
+	}
+
+	// Flies the camera path and returns resident first mips of all textures per frame.
+	// @param sourceDelayMs  Time to read a mip.
+	// @param frameTimeMs    Time between updates. Loads complete while the frame renders.
+	static std::vector<uint32> runCameraPath(const TextureStreamingDesc& desc, bool bFlushEveryFrame, uint32 sourceDelayMs = 0, uint32 frameTimeMs = 0)
+	{
+		SimulatedTextureMemory memory;
+		std::vector<uint32> history;
+		uint32 totalLoads = 0, totalEvictions = 0;
+		{
+			TextureStreamingManager streaming(desc, &memory);
+			CorridorScene scene(streaming, sourceDelayMs);
+
+			for (uint32 frame = 0; frame < cameraPathLength; ++frame)
+			{
+				streaming.update(getCameraPathView(frame));
+				if (bFlushEveryFrame)
+				{
+					streaming.flush();
+				}
+				if (frameTimeMs > 0)
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(frameTimeMs));
+				}
+
+				const TextureStreamingStats& stats = streaming.getStats();
+				totalLoads += stats.numLoadsIssued;
+				totalEvictions += stats.numMipsEvicted;
+				Assert::IsTrue(stats.residentBytes + stats.loadingBytes <= desc.memoryBudget, L"Memory budget is exceeded");
+				Assert::AreEqual(memory.totalBytes, stats.residentBytes);
+				for (SlotHandle texture : scene.textures)
+				{
+					Assert::AreEqual(memory.getFirstMip(texture), streaming.getResidentFirstMip(texture));
+					history.push_back(streaming.getResidentFirstMip(texture));
+				}
+			}
+
+			// Camera stays still at the end of the path. Residency should settle.
+			uint32 numChanges = 0;
+			for (uint32 frame = 0; frame < 40; ++frame)
+			{
+				streaming.update(getCameraPathView(cameraPathLength));
+				streaming.flush();
+				if (frame >= 20)
+				{
+					numChanges += streaming.getStats().numLoadsIssued + streaming.getStats().numMipsEvicted;
+				}
+			}
+			Assert::AreEqual(0u, numChanges, L"Residency should not change for a still camera");
+			// Closest box to the final position (z = -40).
+			Assert::IsTrue(streaming.getResidentFirstMip(scene.textures[4]) <= streaming.getRequestedFirstMip(scene.textures[4]));
+		}
+		Assert::IsTrue(memory.textures.empty());
+		Assert::AreEqual(0ull, (unsigned long long)memory.totalBytes);
+
+		wchar_t msg[256];
+		swprintf_s(msg, L"%u workers%s: %u loads, %u mips evicted, peak %.2f MiB of %.2f MiB budget\n",
+			desc.numWorkers, bFlushEveryFrame ? L" (flush every frame)" : L"",
+			totalLoads, totalEvictions, (double)memory.peakBytes / (1024.0 * 1024.0), (double)desc.memoryBudget / (1024.0 * 1024.0));
+		UnitLogger::WriteMessage(msg);
+		return history;
+	}
+
+	TEST_CLASS(TestTextureStreaming)
+	{
+	public:
+		TEST_METHOD(MipLevelFromScreenCoverage)
+		{
+			Camera camera;
+			camera.perspective(60.0f, 1.0f, 0.1f, 1000.0f);
+			camera.lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+			const TextureStreamingView view = TextureStreamingView::fromCamera(camera, TEST_SCREEN_HEIGHT);
+
+			auto boxAt = [](float z) { return AABB::fromCenterAndHalfSize(vec3(0.0f, 0.0f, z), vec3(1.0f)); };
+			const float mip8 = calcStreamingMipLevel(view, boxAt(-9.0f), 1.0f, 1024);
+			const float mip16 = calcStreamingMipLevel(view, boxAt(-17.0f), 1.0f, 1024);
+			const float mip32 = calcStreamingMipLevel(view, boxAt(-33.0f), 1.0f, 1024);
+			Assert::AreEqual(1.0f, mip16 - mip8, 1e-4f);
+			Assert::AreEqual(1.0f, mip32 - mip16, 1e-4f);
+			// Texture of half the size or twice the UV density needs one mip less.
+			Assert::AreEqual(mip16 - 1.0f, calcStreamingMipLevel(view, boxAt(-17.0f), 1.0f, 512), 1e-4f);
+			Assert::AreEqual(mip16 - 1.0f, calcStreamingMipLevel(view, boxAt(-17.0f), 2.0f, 1024), 1e-4f);
+			Assert::AreEqual(0.0f, calcStreamingMipLevel(view, boxAt(0.5f), 1.0f, 1024));
+
+			// 4x4 quad
+			std::vector<vec3> positions = { vec3(0.0f, 0.0f, 0.0f), vec3(4.0f, 0.0f, 0.0f), vec3(4.0f, 4.0f, 0.0f), vec3(0.0f, 4.0f, 0.0f) };
+			std::vector<uint32> indices = { 0, 1, 2, 0, 2, 3 };
+			std::vector<vec2> texcoords = { vec2(0.0f, 0.0f), vec2(1.0f, 0.0f), vec2(1.0f, 1.0f), vec2(0.0f, 1.0f) };
+			Assert::AreEqual(4.0f, calcWorldUnitsPerUV(positions, texcoords, indices), 1e-4f);
+			for (vec2& uv : texcoords) uv = uv * 2.0f;
+			Assert::AreEqual(2.0f, calcWorldUnitsPerUV(positions, texcoords, indices), 1e-4f);
+		}
+
+		TEST_METHOD(LoadsRequestedMips)
+		{
+			SimulatedTextureMemory memory;
+			TextureStreamingDesc desc;
+			desc.numWorkers = 0;
+			desc.memoryBudget = 4 * getFullTextureBytes();
+			TextureStreamingManager streaming(desc, &memory);
+
+			SlotHandle texture = streaming.registerTexture(
+				makeShared<TestMipSource>(TEST_TEXTURE_SIZE), EPixelFormat::R8G8B8A8_UNORM,
+				TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, TEST_TEXTURE_NUM_MIPS);
+			// Mips of 64 and smaller are resident after registration.
+			Assert::AreEqual(4u, streaming.getResidentFirstMip(texture));
+			Assert::AreEqual(4u, memory.getFirstMip(texture));
+
+			// Not used yet, so nothing is loaded.
+			streaming.update(getCameraPathView(0));
+			Assert::AreEqual(0u, streaming.getStats().numLoadsIssued);
+
+			SlotHandle usage = streaming.addUsage(texture, AABB::fromCenterAndHalfSize(vec3(0.0f, 0.0f, 5.0f), vec3(2.0f)), 4.0f);
+			for (uint32 i = 0; i < 8; ++i)
+			{
+				streaming.update(getCameraPathView(0));
+			}
+			Assert::AreEqual(0u, streaming.getRequestedFirstMip(texture));
+			Assert::AreEqual(0u, streaming.getResidentFirstMip(texture));
+			Assert::AreEqual(getFullTextureBytes(), memory.totalBytes);
+
+			// Moving away requests coarser mips, but resident mips stay as there is no memory pressure.
+			streaming.updateUsage(usage, AABB::fromCenterAndHalfSize(vec3(0.0f, 0.0f, -200.0f), vec3(2.0f)));
+			streaming.update(getCameraPathView(0));
+			Assert::IsTrue(streaming.getRequestedFirstMip(texture) > 3u);
+			Assert::AreEqual(0u, streaming.getResidentFirstMip(texture));
+
+			// Shrinking the budget evicts down to the tail.
+			streaming.setMemoryBudget(0);
+			Assert::AreEqual(4u, streaming.getResidentFirstMip(texture));
+			Assert::AreEqual(streaming.getStats().residentBytes, memory.totalBytes);
+
+			streaming.unregisterTexture(texture);
+			Assert::AreEqual(0u, streaming.getNumTextures());
+			Assert::AreEqual(0ull, (unsigned long long)memory.totalBytes);
+		}
+
+		TEST_METHOD(EvictsLeastNeededFirst)
+		{
+			SimulatedTextureMemory memory;
+			TextureStreamingDesc desc;
+			desc.numWorkers = 0;
+			// Two full textures and a bit.
+			desc.memoryBudget = 2 * getFullTextureBytes() + getFullTextureBytes() / 4;
+			TextureStreamingManager streaming(desc, &memory);
+
+			SlotHandle textures[3];
+			for (uint32 i = 0; i < 3; ++i)
+			{
+				textures[i] = streaming.registerTexture(
+					makeShared<TestMipSource>(TEST_TEXTURE_SIZE), EPixelFormat::R8G8B8A8_UNORM,
+					TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, TEST_TEXTURE_NUM_MIPS);
+				streaming.addUsage(textures[i], AABB::fromCenterAndHalfSize(vec3(0.0f, 0.0f, -100.0f * i), vec3(2.0f)), 4.0f);
+			}
+
+			Camera camera;
+			camera.perspective(60.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+			auto lookAtBox = [&](uint32 boxIx)
+			{
+				const float z = -100.0f * boxIx;
+				camera.lookAt(vec3(0.0f, 0.0f, z + 3.0f), vec3(0.0f, 0.0f, z), vec3(0.0f, 1.0f, 0.0f));
+				for (uint32 i = 0; i < 16; ++i)
+				{
+					streaming.update(TextureStreamingView::fromCamera(camera, TEST_SCREEN_HEIGHT));
+					Assert::IsTrue(memory.totalBytes <= desc.memoryBudget);
+				}
+			};
+
+			lookAtBox(0);
+			Assert::AreEqual(0u, streaming.getResidentFirstMip(textures[0]));
+			lookAtBox(1);
+			Assert::AreEqual(0u, streaming.getResidentFirstMip(textures[1]));
+			Assert::AreEqual(0u, streaming.getResidentFirstMip(textures[0]), L"Should stay while there is memory");
+			// Texture 0 is behind the camera and further away, so it gives its memory to texture 2.
+			lookAtBox(2);
+			Assert::AreEqual(0u, streaming.getResidentFirstMip(textures[2]));
+			Assert::AreEqual(0u, streaming.getResidentFirstMip(textures[1]));
+			Assert::IsTrue(streaming.getResidentFirstMip(textures[0]) > 0u);
+		}
+
+		TEST_METHOD(NoThrashingUnderPressure)
+		{
+			SimulatedTextureMemory memory;
+			TextureStreamingDesc desc;
+			desc.numWorkers = 0;
+			// Not enough for both textures at mip 0.
+			desc.memoryBudget = getFullTextureBytes() * 3 / 2;
+			TextureStreamingManager streaming(desc, &memory);
+
+			SlotHandle textures[2];
+			for (uint32 i = 0; i < 2; ++i)
+			{
+				textures[i] = streaming.registerTexture(
+					makeShared<TestMipSource>(TEST_TEXTURE_SIZE), EPixelFormat::R8G8B8A8_UNORM,
+					TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, TEST_TEXTURE_NUM_MIPS);
+				const float x = i ? 1.0f : -1.0f;
+				streaming.addUsage(textures[i], AABB::fromCenterAndHalfSize(vec3(x, 0.0f, 8.0f), vec3(0.5f)), 4.0f);
+			}
+
+			uint32 numChanges = 0;
+			for (uint32 frame = 0; frame < 60; ++frame)
+			{
+				streaming.update(getCameraPathView(0));
+				Assert::IsTrue(memory.totalBytes <= desc.memoryBudget);
+				if (frame >= 20)
+				{
+					numChanges += streaming.getStats().numLoadsIssued + streaming.getStats().numMipsEvicted;
+				}
+			}
+			Assert::AreEqual(0u, numChanges);
+			Assert::AreEqual(0u, streaming.getRequestedFirstMip(textures[0]));
+			Assert::IsTrue(streaming.getStats().numLoadsDeferred > 0);
+			// Equally needed textures end up at most one mip apart.
+			const int32 mip0 = (int32)streaming.getResidentFirstMip(textures[0]);
+			const int32 mip1 = (int32)streaming.getResidentFirstMip(textures[1]);
+			Assert::IsTrue(std::abs(mip0 - mip1) <= 1);
+		}
+
+		TEST_METHOD(RecordedCameraPath)
+		{
+			TextureStreamingDesc desc;
+			desc.numWorkers = 0;
+			desc.memoryBudget = 6 * getFullTextureBytes();
+			desc.maxLoadsInFlight = 4;
+			const std::vector<uint32> serialHistory = runCameraPath(desc, false);
+
+			// Workers read mips in any order, but residency is the same if loads complete by the next update.
+			desc.numWorkers = 3;
+			const std::vector<uint32> threadedHistory = runCameraPath(desc, true, 1);
+			Assert::IsTrue(serialHistory == threadedHistory);
+
+			// Without waiting, loads complete a frame or more later. Budget and settling are still checked.
+			runCameraPath(desc, false, 1, 2);
+		}
+
+		TEST_METHOD(UnregisterWhileLoading)
+		{
+			SimulatedTextureMemory memory;
+			TextureStreamingDesc desc;
+			desc.numWorkers = 2;
+			TextureStreamingManager streaming(desc, &memory);
+
+			SlotHandle texture = streaming.registerTexture(
+				makeShared<TestMipSource>(TEST_TEXTURE_SIZE, 20), EPixelFormat::R8G8B8A8_UNORM,
+				TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, TEST_TEXTURE_NUM_MIPS);
+			streaming.addUsage(texture, AABB::fromCenterAndHalfSize(vec3(0.0f, 0.0f, 5.0f), vec3(2.0f)), 4.0f);
+			streaming.update(getCameraPathView(0));
+			Assert::AreEqual(1u, streaming.getStats().numLoadsInFlight);
+
+			streaming.unregisterTexture(texture);
+			Assert::AreEqual(1u, streaming.getNumTextures(), L"Released when the load completes");
+			streaming.flush();
+			Assert::AreEqual(0u, streaming.getNumTextures());
+			Assert::IsTrue(memory.textures.empty());
+			Assert::AreEqual(0ull, (unsigned long long)streaming.getStats().residentBytes);
+			Assert::AreEqual(0ull, (unsigned long long)streaming.getStats().loadingBytes);
+
+			// Usages of the texture are ignored.
+			streaming.update(getCameraPathView(0));
+			Assert::AreEqual(0u, streaming.getStats().numLoadsIssued);
+		}
+	};
+}
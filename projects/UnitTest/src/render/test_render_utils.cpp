@@ -1,12 +1,23 @@
 #include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
 #include "test_render_utils.h"
 
 #include "loader/image_loader.h"
+#include "loader/image_writer.h"
+#include "util/image_metrics.h"
 #include "core/int_types.h"
 #include "core/assertion.h"
+#include "core/thread_pool.h"
 
 #include <filesystem>
 #include <string>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <future>
 
 static std::wstring getSolutionDirectory()
 {
@@ -31,6 +42,70 @@ static std::wstring getSolutionDirectory()
 	return solutionDir;
 }
 
+// Shared by all render tests, as image comparisons of a test run one at a time.
+static ThreadPool* getMetricsThreadPool()
+{
+	static ThreadPool threadPool(ThreadPool::getDefaultNumWorkers());
+	return &threadPool;
+}
+
+// Test results are compressed on worker threads while tests go on rendering.
+static std::unique_ptr<AsyncImageWriter> resultImageWriter;
+
+static AsyncImageWriter* getResultImageWriter()
+{
+	static std::once_flag onceFlag;
+	std::call_once(onceFlag, []() { resultImageWriter = std::make_unique<AsyncImageWriter>(2, 4); });
+	return resultImageWriter.get();
+}
+
+// Results of saveRgba8uiImage(), checked when the test module is unloaded.
+struct PendingResultImage
+{
+	std::wstring      filepath;
+	std::future<bool> result;
+};
+static std::vector<PendingResultImage> pendingResultImages;
+static std::mutex pendingResultImagesMutex;
+
+// Waits for queued results, logs failed writes and joins writer threads before the test module is unloaded.
+TEST_MODULE_CLEANUP(flushTestResultImages)
+{
+	for (PendingResultImage& pending : pendingResultImages)
+	{
+		if (!pending.result.get())
+		{
+			wchar_t msg[512];
+			swprintf_s(msg, L"Failed to write a test result: %ls\n", pending.filepath.c_str());
+			UnitLogger::WriteMessage(msg);
+		}
+	}
+	pendingResultImages.clear();
+	resultImageWriter.reset();
+}
+
+// Saves a FLIP heatmap next to the test results, e.g., TestSkybox/ref_flip.png for TestSkybox/ref.png.
+static void reportImageDifference(const wchar_t* refImagePath, const ImageLoadData* refData, const uint8* imageActual)
+{
+	const MetricImage reference = MetricImage::rgba8(refData->getBuffer(), refData->width, refData->height, refData->getRowPitch());
+	const MetricImage actual = MetricImage::rgba8(imageActual, refData->width, refData->height, refData->getRowPitch());
+
+	std::vector<float> errorMap;
+	const float meanFLIP = computeFLIP(reference, actual, FLIPParams{}, getMetricsThreadPool(), &errorMap);
+	const ImageErrorStats stats = computeMSE(reference, actual, getMetricsThreadPool());
+
+	std::vector<uint8> heatmap;
+	generateHeatmap(errorMap.data(), refData->width, refData->height, 1.0f, heatmap, getMetricsThreadPool());
+	std::filesystem::path heatmapPath(refImagePath);
+	heatmapPath.replace_filename(heatmapPath.stem().wstring() + L"_flip.png");
+	render_test::saveRgba8uiImage(heatmapPath.wstring().c_str(), heatmap.data(), refData->width, refData->height);
+
+	wchar_t msg[512];
+	swprintf_s(msg, L"%ls: %u different pixels, PSNR %.2f dB, mean FLIP %.5f (heatmap: %ls)\n",
+		refImagePath, stats.numDifferentPixels, stats.psnrAverage, meanFLIP, heatmapPath.wstring().c_str());
+	UnitLogger::WriteMessage(msg);
+}
+
 namespace render_test
 {
 	std::vector<uint8> rgba32f_to_rgba8ui(float* src, uint32 numPixels)
@@ -55,10 +130,10 @@ namespace render_test
 			std::wstring fullPath = solutionDir + L"tests/referenceImages/" + refImagePath;
 
 			ImageLoader loader;
-			ImageLoadData* refData = loader.load(fullPath, false, false);
+			std::unique_ptr<ImageLoadData> refData(loader.load(fullPath, false, false));
 			if (refData != nullptr)
 			{
-				uint8* p1 = reinterpret_cast<uint8*>(refData->buffer);
+				uint8* p1 = reinterpret_cast<uint8*>(refData->getBuffer());
 				uint8* p2 = imageActual;
 				int numDiffRows = 0;
 				for (uint32 y = 0; y < refData->height; ++y)
@@ -68,6 +143,10 @@ namespace render_test
 					p1 += refData->getRowPitch();
 					p2 += refData->getRowPitch();
 				}
+				if (numDiffRows > 0)
+				{
+					reportImageDifference(refImagePath, refData.get(), imageActual);
+				}
 				return numDiffRows;
 			}
 		}
@@ -82,12 +161,12 @@ namespace render_test
 			std::wstring fullPath = solutionDir + L"tests/referenceImages/" + refImagePath;
 
 			ImageLoader loader;
-			ImageLoadData* refData = loader.load(fullPath, false, false);
+			std::unique_ptr<ImageLoadData> refData(loader.load(fullPath, false, false));
 			if (refData != nullptr)
 			{
 				std::vector<uint8> rgba8 = rgba32f_to_rgba8ui(imageActual, refData->width * refData->height);
 
-				uint8* p1 = reinterpret_cast<uint8*>(refData->buffer);
+				uint8* p1 = reinterpret_cast<uint8*>(refData->getBuffer());
 				uint8* p2 = rgba8.data();
 				int numDiffRows = 0;
 				for (uint32 y = 0; y < refData->height; ++y)
@@ -97,6 +176,10 @@ namespace render_test
 					p1 += refData->getRowPitch();
 					p2 += refData->getRowPitch();
 				}
+				if (numDiffRows > 0)
+				{
+					reportImageDifference(refImagePath, refData.get(), rgba8.data());
+				}
 				return numDiffRows;
 			}
 		}
@@ -111,25 +194,12 @@ namespace render_test
 			std::wstring fullPath = solutionDir + L"tests/referenceImages/" + refImagePath;
 
 			ImageLoader loader;
-			ImageLoadData* refData = loader.load(fullPath, false, false);
+			std::unique_ptr<ImageLoadData> refData(loader.load(fullPath, false, false));
 			if (refData != nullptr)
 			{
-				uint8* p1 = reinterpret_cast<uint8*>(refData->buffer);
-				uint8* p2 = imageActual;
-				float errRed = 0.0f, errGreen = 0.0f, errBlue = 0.0f;
-				for (uint32 y = 0; y < refData->height; ++y)
-				{
-					for (uint32 x = 0; x < refData->width; ++x)
-					{
-						float r1 = (float)(p1[x * 4 + 0]) / 255.0f, g1 = (float)(p1[x * 4 + 1]) / 255.0f, b1 = (float)(p1[x * 4 + 2]) / 255.0f;
-						float r2 = (float)(p2[x * 4 + 0]) / 255.0f, g2 = (float)(p2[x * 4 + 1]) / 255.0f, b2 = (float)(p2[x * 4 + 2]) / 255.0f;
-						float rDiff = std::abs(r1 - r2), gDiff = std::abs(g1 - g2), bDiff = std::abs(b1 - b2);
-						errRed += rDiff * rDiff; errGreen += gDiff * gDiff; errBlue += bDiff * bDiff;
-					}
-					p1 += refData->getRowPitch();
-					p2 += refData->getRowPitch();
-				}
-				return vec3(errRed, errGreen, errBlue) / (float)(refData->width * refData->height);
+				const MetricImage reference = MetricImage::rgba8(refData->getBuffer(), refData->width, refData->height, refData->getRowPitch());
+				const MetricImage actual = MetricImage::rgba8(imageActual, refData->width, refData->height, refData->getRowPitch());
+				return computeMSE(reference, actual, getMetricsThreadPool()).mse;
 			}
 		}
 		return FLT_MAX;
@@ -141,9 +211,12 @@ namespace render_test
 		if (solutionDir.size() > 0)
 		{
 			std::wstring fullPath = solutionDir + L"intermediate/testResults/" + filepath;
-			int rowPitch = width * 4;
-			bool bRet = ImageLoader::saveAsPng(fullPath, rgba8Image, width, height, rowPitch);
-			return bRet;
+			std::vector<uint8> pixels(rgba8Image, rgba8Image + uint64(width) * height * 4);
+			std::future<bool> result = getResultImageWriter()->writePNG(fullPath, std::move(pixels), width, height, EImageCompression::Fast);
+
+			std::lock_guard<std::mutex> lock(pendingResultImagesMutex);
+			pendingResultImages.push_back(PendingResultImage{ fullPath, std::move(result) });
+			return true;
 		}
 		return false;
 	}
@@ -43,7 +43,8 @@ namespace render_test
 	vec3 computeMinSquareErrorRgba8ui(const wchar_t* refImagePath, uint8* imageActual);
 
 	/// <summary>
-	/// Save rgba8ui image as PNG.
+	/// Save rgba8ui image as PNG. The image is copied and written on a worker thread.
+	/// Write failures are reported when the test module is unloaded.
 	/// </summary>
 	/// <param name="filepath"></param>
 	/// <param name="rgba8Image"></param>
@@ -0,0 +1,46 @@
+#include "pch.h"
+#include "test_scene_utils.h"
+
+#include "world/scene_proxy.h"
+#include "world/material_asset.h"
+
+namespace render_test
+{
+	void addTestMeshes(Scene& scene, const FakeMeshAssets& assets, uint32 numMeshes,
+		std::vector<SharedPtr<MaterialAsset>>& outMaterials, std::vector<StaticMesh*>& outMeshes)
+	{
+		for (uint32 i = 0; i < 8; ++i)
+		{
+			auto material = makeShared<MaterialAsset>();
+			material->setDoubleSided(i % 2 == 1);
+			outMaterials.push_back(material);
+		}
+		const uint32 numBuffers = (uint32)assets.positionBuffers.size();
+		for (uint32 i = 0; i < numMeshes; ++i)
+		{
+			StaticMesh* mesh = new StaticMesh;
+			const uint32 numSections = 1 + (i % 3);
+			for (uint32 j = 0; j < numSections; ++j)
+			{
+				const uint32 bufferIx = (i + j) % numBuffers;
+				mesh->addSection(0,
+					assets.positionBuffers[bufferIx], assets.nonPositionBuffers[bufferIx], assets.indexBuffers[bufferIx],
+					outMaterials[(i + j) % outMaterials.size()], AABB());
+			}
+			mesh->addSection(1,
+				assets.positionBuffers[i % numBuffers], assets.nonPositionBuffers[i % numBuffers], assets.indexBuffers[i % numBuffers],
+				outMaterials[i % outMaterials.size()], AABB());
+			mesh->setPosition(vec3((float)i, 0.0f, 0.0f));
+			scene.addStaticMesh(mesh);
+			outMeshes.push_back(mesh);
+		}
+	}
+
+	void destroyTestMeshes(Scene& scene, std::vector<StaticMesh*>& meshes)
+	{
+		scene.clearStaticMeshes();
+		delete scene.createProxy();
+		for (StaticMesh* mesh : meshes) delete mesh;
+		meshes.clear();
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "world/scene.h"
+#include "render/static_mesh.h"
+#include "rhi/buffer.h"
+#include "rhi/texture.h"
+
+#include <vector>
+
+namespace render_test
+{
+	// CPU-only buffers, so that scene proxies can be built without a render device.
+	class FakeVertexBuffer : public VertexBuffer
+	{
+	public:
+		FakeVertexBuffer(uint64 inOffset, uint32 inCount) : offset(inOffset), count(inCount) {}
+		virtual void initialize(uint32 sizeInBytes, EBufferAccessFlags usageFlags) override {}
+		virtual void initializeWithinPool(VertexBufferPool* pool, uint64 offsetInPool, uint32 sizeInBytes) override {}
+		virtual void updateData(RenderCommandList* commandList, void* data, uint32 strideInBytes) override {}
+		virtual void setStrideInBytes(uint32 strideInBytes) override {}
+		virtual uint32 getVertexCount() const override { return count; }
+		virtual uint64 getBufferOffsetInBytes() const override { return offset; }
+		virtual uint32 getBufferSizeInBytes() const override { return count * 12; }
+		virtual uint32 getBufferStrideInBytes() const override { return 12; }
+		virtual uint64 internal_getGPUVirtualAddress() const override { return 0; }
+	private:
+		uint64 offset;
+		uint32 count;
+	};
+
+	class FakeIndexBuffer : public IndexBuffer
+	{
+	public:
+		FakeIndexBuffer(uint64 inOffset, uint32 inCount) : offset(inOffset), count(inCount) {}
+		virtual void initialize(uint32 sizeInBytes, EPixelFormat format, EBufferAccessFlags usageFlags) override {}
+		virtual void initializeWithinPool(IndexBufferPool* pool, uint64 offsetInPool, uint32 sizeInBytes) override {}
+		virtual void updateData(RenderCommandList* commandList, void* data, EPixelFormat format) override {}
+		virtual void setIndexFormat(EPixelFormat format) override {}
+		virtual uint32 getIndexCount() const override { return count; }
+		virtual EPixelFormat getIndexFormat() const override { return EPixelFormat::R32_UINT; }
+		virtual uint64 getBufferOffsetInBytes() const override { return offset; }
+		virtual uint32 getBufferSizeInBytes() const override { return count * 4; }
+		virtual uint64 internal_getGPUVirtualAddress() const override { return 0; }
+	private:
+		uint64 offset;
+		uint32 count;
+	};
+
+	class FakeTexture : public Texture
+	{
+	public:
+		virtual const TextureCreateParams& getCreateParams() const override { return createParams; }
+		virtual void uploadData(RenderCommandList* commandList, const void* buffer, uint64 rowPitch, uint64 slicePitch, uint32 subresourceIndex) override {}
+		virtual uint64 getRowPitch() const override { return 0; }
+	private:
+		TextureCreateParams createParams = TextureCreateParams::texture2D(EPixelFormat::R8G8B8A8_UNORM, ETextureAccessFlags::SRV, 1, 1);
+	};
+
+	struct FakeMeshAssets
+	{
+		FakeMeshAssets(uint32 numBuffers)
+		{
+			for (uint32 i = 0; i < numBuffers; ++i)
+			{
+				positionBuffers.push_back(makeShared<VertexBufferAsset>(makeShared<FakeVertexBuffer>(i * 1024, 64)));
+				nonPositionBuffers.push_back(makeShared<VertexBufferAsset>(makeShared<FakeVertexBuffer>(i * 2048, 64)));
+				indexBuffers.push_back(makeShared<IndexBufferAsset>(makeShared<FakeIndexBuffer>(i * 512, 96)));
+			}
+		}
+		std::vector<SharedPtr<VertexBufferAsset>> positionBuffers;
+		std::vector<SharedPtr<VertexBufferAsset>> nonPositionBuffers;
+		std::vector<SharedPtr<IndexBufferAsset>>  indexBuffers;
+	};
+
+	// Mesh i has (1 + i % 3) sections in LOD0 and one section in LOD1.
+	// Materials are not shared between scenes, as createProxy() clears their dirty flags.
+	void addTestMeshes(Scene& scene, const FakeMeshAssets& assets, uint32 numMeshes,
+		std::vector<SharedPtr<MaterialAsset>>& outMaterials, std::vector<StaticMesh*>& outMeshes);
+
+	void destroyTestMeshes(Scene& scene, std::vector<StaticMesh*>& meshes);
+}
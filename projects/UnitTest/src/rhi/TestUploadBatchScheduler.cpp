@@ -0,0 +1,479 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "rhi/upload_batch_scheduler.h"
+#include "rhi/gpu_resource.h"
+
+#include <vector>
+#include <map>
+#include <random>
+#include <cstring>
+
+namespace UnitTest
+{
+	// Plain CPU memory instead of upload heap buffers.
+	class MockStagingMemory : public UploadStagingMemory
+	{
+	public:
+		virtual uint8* createPage(uint32 pageIndex, uint64 size) override
+		{
+			Assert::IsTrue(pages.find(pageIndex) == pages.end());
+			pages[pageIndex] = std::vector<uint8>((size_t)size, 0xcd);
+			numCreated += 1;
+			return pages[pageIndex].data();
+		}
+		virtual void destroyPage(uint32 pageIndex) override
+		{
+			Assert::AreEqual((size_t)1, pages.erase(pageIndex));
+			numDestroyed += 1;
+		}
+
+		std::map<uint32, std::vector<uint8>> pages;
+		uint32 numCreated = 0;
+		uint32 numDestroyed = 0;
+	};
+
+	// The scheduler only compares destinations. Never dereferenced.
+	static GPUResource* fakeResource(uint32 id)
+	{
+		return reinterpret_cast<GPUResource*>(uintptr_t(id) * 256);
+	}
+
+	// Destinations in CPU memory. Textures keep tight rows per subresource.
+	struct MockDestinations
+	{
+		std::map<GPUResource*, std::vector<uint8>> buffers;
+		std::map<std::pair<GPUResource*, uint32>, std::vector<uint8>> subresources;
+		std::map<std::pair<GPUResource*, uint32>, uint64> rowBytes;
+
+		// Same as what UploadBatcher records.
+		void execute(const UploadBatch& batch, MockStagingMemory& memory)
+		{
+			for (const UploadCopy& copy : batch.copies)
+			{
+				const uint8* src = memory.pages.at(copy.page).data() + copy.pageOffset;
+				if (copy.destinationType == EUploadDestination::Buffer || copy.destinationType == EUploadDestination::PooledBuffer)
+				{
+					Assert::IsTrue(copy.pageOffset % UPLOAD_BUFFER_ALIGNMENT == 0);
+					std::vector<uint8>& dst = buffers.at(copy.destination);
+					Assert::IsTrue(copy.destinationOffset + copy.size <= dst.size());
+					::memcpy(dst.data() + copy.destinationOffset, src, (size_t)copy.size);
+				}
+				else
+				{
+					Assert::IsTrue(copy.pageOffset % UPLOAD_TEXTURE_PLACEMENT_ALIGNMENT == 0);
+					Assert::IsTrue(copy.rowPitch % UPLOAD_TEXTURE_ROW_PITCH_ALIGNMENT == 0);
+					const auto key = std::make_pair(copy.destination, copy.subresourceIndex);
+					std::vector<uint8>& dst = subresources.at(key);
+					const uint64 bytesPerRow = rowBytes.at(key);
+					const uint64 numRows = dst.size() / bytesPerRow;
+					for (uint64 row = 0; row < numRows; ++row)
+					{
+						::memcpy(dst.data() + row * bytesPerRow, src + row * copy.rowPitch, (size_t)bytesPerRow);
+					}
+				}
+			}
+		}
+	};
+
+	static std::vector<uint8> makeData(uint64 size, uint32 seed)
+	{
+		std::vector<uint8> data((size_t)size);
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			data[i] = (uint8)((i * 31 + seed * 17 + 7) & 0xff);
+		}
+		return data;
+	}
+
+	TEST_CLASS(TestUploadBatchScheduler)
+	{
+	public:
+		TEST_METHOD(PackAndMergeBuffers)
+		{
+			MockStagingMemory memory;
+			MockDestinations destinations;
+			UploadBatchScheduler scheduler;
+			scheduler.initialize(UploadBatchSchedulerDesc{ .pageSize = 64 * 1024, .maxPages = 2, .frameBudget = 64 * 1024 }, &memory);
+
+			GPUResource* vertexBuffer = fakeResource(1);
+			GPUResource* indexBuffer = fakeResource(2);
+			destinations.buffers[vertexBuffer].resize(64 * 64);
+			destinations.buffers[indexBuffer].resize(32 * 64);
+
+			// Meshes suballocated one after another, interleaving two buffers like a scene loader would.
+			std::vector<uint8> expectedVertices, expectedIndices;
+			WeakPtr<std::vector<uint8>> firstOwner;
+			UploadToken lastToken = UPLOAD_TOKEN_NONE;
+			for (uint32 mesh = 0; mesh < 64; ++mesh)
+			{
+				auto vertices = makeShared<std::vector<uint8>>(makeData(64, mesh));
+				auto indices = makeShared<std::vector<uint8>>(makeData(32, mesh + 1000));
+				expectedVertices.insert(expectedVertices.end(), vertices->begin(), vertices->end());
+				expectedIndices.insert(expectedIndices.end(), indices->begin(), indices->end());
+				if (mesh == 0)
+				{
+					firstOwner = vertices;
+				}
+				scheduler.enqueue(UploadRequest::buffer(vertexBuffer, mesh * 64, vertices->data(), 64, vertices));
+				lastToken = scheduler.enqueue(UploadRequest::buffer(indexBuffer, mesh * 32, indices->data(), 32, indices));
+			}
+			Assert::AreEqual(128ull, lastToken);
+			Assert::IsFalse(firstOwner.expired()); // Data is read when scheduled.
+
+			UploadBatch batch;
+			scheduler.buildBatch(batch);
+			Assert::IsTrue(firstOwner.expired());
+			Assert::AreEqual(128u, batch.numUploads);
+			Assert::AreEqual(64ull * 96, batch.numBytes);
+			Assert::AreEqual((size_t)1, memory.pages.size());
+			Assert::AreEqual((size_t)2, batch.buffers.size());
+			Assert::IsTrue(batch.textureSubresources.empty());
+			// Interleaved in the page, so nothing is merged. Copies are grouped by destination though.
+			Assert::AreEqual((size_t)128, batch.copies.size());
+			for (size_t i = 1; i < batch.copies.size(); ++i)
+			{
+				const UploadCopy& prev = batch.copies[i - 1];
+				const UploadCopy& curr = batch.copies[i];
+				Assert::IsTrue(prev.destination < curr.destination
+					|| (prev.destination == curr.destination && prev.destinationOffset + prev.size <= curr.destinationOffset));
+			}
+
+			destinations.execute(batch, memory);
+			Assert::IsTrue(destinations.buffers[vertexBuffer] == expectedVertices);
+			Assert::IsTrue(destinations.buffers[indexBuffer] == expectedIndices);
+
+			Assert::IsFalse(scheduler.isComplete(lastToken));
+			scheduler.endFrame(1);
+			Assert::IsFalse(scheduler.isComplete(1));
+			scheduler.retire(1);
+			Assert::IsTrue(scheduler.isComplete(lastToken));
+			Assert::AreEqual((size_t)0, scheduler.getNumPendingUploads());
+			Assert::AreEqual(0ull, scheduler.getPendingBytes());
+		}
+
+		TEST_METHOD(AdjacentCopiesMerge)
+		{
+			MockStagingMemory memory;
+			MockDestinations destinations;
+			UploadBatchScheduler scheduler;
+			scheduler.initialize(UploadBatchSchedulerDesc{ .pageSize = 4096, .maxPages = 1, .frameBudget = 4096 }, &memory);
+
+			GPUResource* buffer = fakeResource(1);
+			destinations.buffers[buffer].resize(1024);
+			std::vector<uint8> data = makeData(1024, 3);
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				scheduler.enqueue(UploadRequest::buffer(buffer, i * 64, data.data() + i * 64, 64));
+			}
+
+			UploadBatch batch;
+			scheduler.buildBatch(batch);
+			Assert::AreEqual(16u, batch.numUploads);
+			Assert::AreEqual((size_t)1, batch.copies.size());
+			Assert::AreEqual(1024ull, batch.copies[0].size);
+
+			destinations.execute(batch, memory);
+			Assert::IsTrue(destinations.buffers[buffer] == data);
+		}
+
+		TEST_METHOD(PooledBuffersAreBatchedSeparately)
+		{
+			MockStagingMemory memory;
+			MockDestinations destinations;
+			UploadBatchScheduler scheduler;
+			scheduler.initialize(UploadBatchSchedulerDesc{ .pageSize = 4096, .maxPages = 1, .frameBudget = 4096 }, &memory);
+
+			// Like MesoGeometryAssets::createFrom(): position, non-position, and index data of each mesh.
+			GPUResource* vertexPool = fakeResource(1);
+			GPUResource* indexPool = fakeResource(2);
+			GPUResource* buffer = fakeResource(3);
+			destinations.buffers[vertexPool].resize(1024);
+			destinations.buffers[indexPool].resize(256);
+			destinations.buffers[buffer].resize(64);
+
+			std::vector<uint8> vertices = makeData(1024, 5);
+			std::vector<uint8> indices = makeData(256, 6);
+			std::vector<uint8> data = makeData(64, 7);
+			for (uint32 mesh = 0; mesh < 4; ++mesh)
+			{
+				scheduler.enqueue(UploadRequest::pooledBuffer(vertexPool, mesh * 256, vertices.data() + mesh * 256, 128));
+				scheduler.enqueue(UploadRequest::pooledBuffer(vertexPool, mesh * 256 + 128, vertices.data() + mesh * 256 + 128, 128));
+				scheduler.enqueue(UploadRequest::pooledBuffer(indexPool, mesh * 64, indices.data() + mesh * 64, 64));
+			}
+			scheduler.enqueue(UploadRequest::buffer(buffer, 0, data.data(), 64));
+
+			UploadBatch batch;
+			scheduler.buildBatch(batch);
+			Assert::AreEqual(13u, batch.numUploads);
+			// Pools are not tracked by barrierAuto(), so they are listed apart from buffers.
+			Assert::AreEqual((size_t)1, batch.buffers.size());
+			Assert::IsTrue(batch.buffers[0] == buffer);
+			Assert::AreEqual((size_t)2, batch.pooledBuffers.size());
+			Assert::IsTrue(batch.pooledBuffers[0] == vertexPool);
+			Assert::IsTrue(batch.pooledBuffers[1] == indexPool);
+			// Position and non-position data of a mesh are adjacent in both the page and the pool.
+			uint32 numVertexCopies = 0;
+			for (const UploadCopy& copy : batch.copies)
+			{
+				if (copy.destination == vertexPool)
+				{
+					Assert::IsTrue(copy.destinationType == EUploadDestination::PooledBuffer);
+					Assert::AreEqual(256ull, copy.size);
+					numVertexCopies += 1;
+				}
+			}
+			Assert::AreEqual(4u, numVertexCopies);
+
+			destinations.execute(batch, memory);
+			Assert::IsTrue(destinations.buffers[vertexPool] == vertices);
+			Assert::IsTrue(destinations.buffers[indexPool] == indices);
+			Assert::IsTrue(destinations.buffers[buffer] == data);
+		}
+
+		TEST_METHOD(FrameBudgetAndBackPressure)
+		{
+			MockStagingMemory memory;
+			UploadBatchScheduler scheduler;
+			scheduler.initialize(UploadBatchSchedulerDesc{ .pageSize = 1024, .maxPages = 2, .frameBudget = 1536 }, &memory);
+
+			std::vector<uint8> data = makeData(512, 0);
+			UploadToken tokens[10];
+			for (uint32 i = 0; i < 10; ++i)
+			{
+				tokens[i] = scheduler.enqueue(UploadRequest::buffer(fakeResource(1 + i), 0, data.data(), 512));
+			}
+
+			UploadBatch batch;
+			scheduler.buildBatch(batch);
+			Assert::AreEqual(3u, batch.numUploads); // 1536 bytes
+			Assert::AreEqual(tokens[2], batch.lastToken);
+			Assert::AreEqual(2u, scheduler.getNumPages());
+			scheduler.endFrame(1);
+
+			// Both pages are in flight, so nothing is scheduled instead of waiting for the GPU.
+			scheduler.buildBatch(batch);
+			Assert::AreEqual(0u, batch.numUploads);
+			Assert::AreEqual(2u, scheduler.getNumPages());
+			scheduler.endFrame(2);
+			Assert::IsFalse(scheduler.isComplete(tokens[0]));
+
+			scheduler.retire(2);
+			Assert::IsTrue(scheduler.isComplete(tokens[2]));
+			Assert::IsFalse(scheduler.isComplete(tokens[3]));
+
+			// Pages are reused, not created.
+			uint32 numScheduled = 3;
+			uint64 fenceValue = 2;
+			while (scheduler.getNumPendingUploads() > 0)
+			{
+				scheduler.buildBatch(batch);
+				Assert::IsTrue(batch.numUploads > 0);
+				numScheduled += batch.numUploads;
+				scheduler.endFrame(++fenceValue);
+				scheduler.retire(fenceValue);
+			}
+			Assert::AreEqual(10u, numScheduled);
+			Assert::AreEqual(2u, memory.numCreated);
+			Assert::IsTrue(scheduler.isComplete(tokens[9]));
+		}
+
+		TEST_METHOD(DedicatedPageForLargeUpload)
+		{
+			MockStagingMemory memory;
+			MockDestinations destinations;
+			UploadBatchScheduler scheduler;
+			scheduler.initialize(UploadBatchSchedulerDesc{ .pageSize = 1024, .maxPages = 1, .frameBudget = 1024 }, &memory);
+
+			GPUResource* small = fakeResource(1);
+			GPUResource* large = fakeResource(2);
+			destinations.buffers[small].resize(256);
+			destinations.buffers[large].resize(4000);
+			std::vector<uint8> smallData = makeData(256, 1);
+			std::vector<uint8> largeData = makeData(4000, 2);
+
+			scheduler.enqueue(UploadRequest::buffer(small, 0, smallData.data(), 256));
+			UploadToken largeToken = scheduler.enqueue(UploadRequest::buffer(large, 0, largeData.data(), 4000));
+
+			// Over the budget, so the large upload waits for the next frame.
+			UploadBatch batch;
+			scheduler.buildBatch(batch);
+			Assert::AreEqual(1u, batch.numUploads);
+			destinations.execute(batch, memory);
+			scheduler.endFrame(1);
+			scheduler.retire(1);
+
+			// At least one upload per frame, even if it alone exceeds the budget and the page size.
+			scheduler.buildBatch(batch);
+			Assert::AreEqual(1u, batch.numUploads);
+			Assert::AreEqual(1u, scheduler.getNumDedicatedPages());
+			Assert::AreEqual(2u, scheduler.getNumPages()); // Does not count for maxPages.
+			destinations.execute(batch, memory);
+			scheduler.endFrame(2);
+			scheduler.retire(2);
+
+			Assert::IsTrue(scheduler.isComplete(largeToken));
+			Assert::AreEqual(0u, scheduler.getNumDedicatedPages());
+			Assert::AreEqual(1u, memory.numDestroyed);
+			Assert::IsTrue(destinations.buffers[small] == smallData);
+			Assert::IsTrue(destinations.buffers[large] == largeData);
+		}
+
+		// The owner of a destination can release it while its upload is pending, e.g., on a world switch.
+		TEST_METHOD(DestinationReleasedWhileUploadPending)
+		{
+			MockStagingMemory memory;
+			UploadBatchScheduler scheduler;
+			scheduler.initialize(UploadBatchSchedulerDesc{ .pageSize = 1024, .maxPages = 1, .frameBudget = 512 }, &memory);
+
+			SharedPtr<GPUResource> first = makeShared<GPUResource>();
+			SharedPtr<GPUResource> second = makeShared<GPUResource>();
+			WeakPtr<GPUResource> firstWeak = first;
+			WeakPtr<GPUResource> secondWeak = second;
+			std::vector<uint8> data = makeData(512, 3);
+
+			scheduler.enqueue(UploadRequest::buffer(first.get(), 0, data.data(), 512, nullptr, first));
+			UploadToken secondToken = scheduler.enqueue(UploadRequest::buffer(second.get(), 0, data.data(), 512, nullptr, second));
+			first.reset();
+			second.reset();
+
+			// The first upload is copied in this frame, and the second one is still in the queue.
+			UploadBatch batch;
+			scheduler.buildBatch(batch);
+			Assert::AreEqual(1u, batch.numUploads);
+			scheduler.endFrame(1);
+			Assert::IsFalse(firstWeak.expired());
+			Assert::IsFalse(secondWeak.expired());
+
+			// Released once the copy is complete on GPU, not when it's recorded.
+			scheduler.retire(1);
+			Assert::IsTrue(firstWeak.expired());
+			Assert::IsFalse(secondWeak.expired());
+
+			scheduler.buildBatch(batch);
+			Assert::AreEqual(1u, batch.numUploads);
+			scheduler.endFrame(2);
+			Assert::IsFalse(secondWeak.expired());
+			scheduler.retire(2);
+			Assert::IsTrue(scheduler.isComplete(secondToken));
+			Assert::IsTrue(secondWeak.expired());
+		}
+
+		TEST_METHOD(TextureRowRepacking)
+		{
+			MockStagingMemory memory;
+			MockDestinations destinations;
+			UploadBatchScheduler scheduler;
+			scheduler.initialize(UploadBatchSchedulerDesc{ .pageSize = 64 * 1024, .maxPages = 1, .frameBudget = 64 * 1024 }, &memory);
+
+			// 10x5 rgba8 with padded source rows, then a 5x2 mip with tight rows, then a buffer in between.
+			GPUResource* texture = fakeResource(1);
+			GPUResource* buffer = fakeResource(2);
+			const uint64 rowBytes0 = 40, srcPitch0 = 48;
+			const uint64 rowBytes1 = 20, srcPitch1 = 20;
+			std::vector<uint8> src0 = makeData(srcPitch0 * 5, 10);
+			std::vector<uint8> src1 = makeData(srcPitch1 * 2, 11);
+			std::vector<uint8> bufferData = makeData(100, 12);
+
+			destinations.subresources[{ texture, 0 }].resize(rowBytes0 * 5);
+			destinations.subresources[{ texture, 1 }].resize(rowBytes1 * 2);
+			destinations.rowBytes[{ texture, 0 }] = rowBytes0;
+			destinations.rowBytes[{ texture, 1 }] = rowBytes1;
+			destinations.buffers[buffer].resize(100);
+
+			UploadRequest request0 = UploadRequest::texture(texture, 0, src0.data(), rowBytes0, 5, srcPitch0);
+			Assert::AreEqual((uint64)UPLOAD_TEXTURE_ROW_PITCH_ALIGNMENT, request0.getStagingRowPitch());
+			Assert::AreEqual(256ull * 4 + 40, request0.getStagingSize());
+
+			scheduler.enqueue(std::move(request0));
+			scheduler.enqueue(UploadRequest::buffer(buffer, 0, bufferData.data(), 100));
+			scheduler.enqueue(UploadRequest::texture(texture, 1, src1.data(), rowBytes1, 2, srcPitch1));
+
+			UploadBatch batch;
+			scheduler.buildBatch(batch);
+			Assert::AreEqual(3u, batch.numUploads);
+			Assert::AreEqual((size_t)3, batch.copies.size());
+			Assert::AreEqual((size_t)1, batch.buffers.size());
+			Assert::AreEqual((size_t)2, batch.textureSubresources.size());
+			Assert::AreEqual(0u, batch.textureSubresources[0].subresourceIndex);
+			Assert::AreEqual(1u, batch.textureSubresources[1].subresourceIndex);
+
+			destinations.execute(batch, memory);
+			for (uint32 row = 0; row < 5; ++row)
+			{
+				Assert::AreEqual(0, ::memcmp(destinations.subresources[{ texture, 0 }].data() + row * rowBytes0, src0.data() + row * srcPitch0, rowBytes0));
+			}
+			Assert::IsTrue(destinations.subresources[{ texture, 1 }] == src1);
+			Assert::IsTrue(destinations.buffers[buffer] == bufferData);
+		}
+
+		TEST_METHOD(RandomUploadsCompleteInOrder)
+		{
+			MockStagingMemory memory;
+			MockDestinations destinations;
+			UploadBatchScheduler scheduler;
+			scheduler.initialize(UploadBatchSchedulerDesc{ .pageSize = 8192, .maxPages = 3, .frameBudget = 12000 }, &memory);
+
+			constexpr uint32 NUM_BUFFERS = 8;
+			constexpr uint64 BUFFER_SIZE = 16 * 1024;
+			std::vector<std::vector<uint8>> expected(NUM_BUFFERS);
+			for (uint32 i = 0; i < NUM_BUFFERS; ++i)
+			{
+				destinations.buffers[fakeResource(1 + i)].resize(BUFFER_SIZE);
+				expected[i].resize(BUFFER_SIZE, 0);
+			}
+
+			// Each buffer is filled front to back by uploads of random sizes, some larger than a page.
+			std::mt19937 rng(1234);
+			std::vector<uint64> cursors(NUM_BUFFERS, 0);
+			for (uint32 n = 0; n < 200; ++n)
+			{
+				const uint32 bufferIndex = rng() % NUM_BUFFERS;
+				const uint64 size = 16 * (1 + rng() % ((rng() % 8 == 0) ? 800 : 64));
+				if (cursors[bufferIndex] + size > BUFFER_SIZE)
+				{
+					continue;
+				}
+				auto data = makeShared<std::vector<uint8>>(makeData(size, n));
+				::memcpy(expected[bufferIndex].data() + cursors[bufferIndex], data->data(), (size_t)size);
+				scheduler.enqueue(UploadRequest::buffer(fakeResource(1 + bufferIndex), cursors[bufferIndex], data->data(), size, data));
+				cursors[bufferIndex] += size;
+			}
+			const UploadToken lastToken = scheduler.getLastToken();
+
+			// GPU completes frames two frames late.
+			UploadBatch batch;
+			UploadToken prevCompleted = UPLOAD_TOKEN_NONE;
+			uint64 fenceValue = 0;
+			uint32 numFrames = 0;
+			while (!scheduler.isComplete(lastToken))
+			{
+				scheduler.buildBatch(batch);
+				destinations.execute(batch, memory);
+				scheduler.endFrame(++fenceValue);
+				if (fenceValue > 2)
+				{
+					scheduler.retire(fenceValue - 2);
+				}
+				Assert::IsTrue(scheduler.getCompletedToken() >= prevCompleted);
+				prevCompleted = scheduler.getCompletedToken();
+				Assert::IsTrue(scheduler.getNumPages() - scheduler.getNumDedicatedPages() <= 3);
+
+				numFrames += 1;
+				Assert::IsTrue(numFrames < 1000);
+			}
+			wchar_t msg[256];
+			swprintf_s(msg, L"%llu uploads in %u frames, %u pages created\n", lastToken, numFrames, memory.numCreated);
+			UnitLogger::WriteMessage(msg);
+
+			for (uint32 i = 0; i < NUM_BUFFERS; ++i)
+			{
+				Assert::IsTrue(destinations.buffers[fakeResource(1 + i)] == expected[i]);
+			}
+			scheduler.destroy();
+			Assert::IsTrue(memory.pages.empty());
+		}
+	};
+}
@@ -0,0 +1,240 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using UnitLogger = Microsoft::VisualStudio::CppUnitTestFramework::Logger;
+
+#include "rhi/upload_ring_allocator.h"
+
+#include <vector>
+#include <deque>
+#include <random>
+#include <algorithm>
+
+namespace UnitTest
+{
+	// Simulated GPU timeline. Submitted frames complete in order, on demand.
+	class SimulatedUploadFence : public UploadRingFence
+	{
+	public:
+		virtual uint64 getCompletedValue() const override { return completedValue; }
+		virtual void waitForValue(uint64 value) override
+		{
+			Assert::IsTrue(value <= lastSubmittedValue); // Waiting for unsubmitted work would hang.
+			numWaits += 1;
+			completedValue = std::max(completedValue, value);
+		}
+
+		uint64 submit() { return ++lastSubmittedValue; }
+		void complete(uint64 value) { completedValue = std::max(completedValue, value); }
+
+		uint64 completedValue = 0;
+		uint64 lastSubmittedValue = 0;
+		uint32 numWaits = 0;
+	};
+
+	// Plain CPU memory instead of a mapped upload buffer.
+	struct MockUploadBuffer
+	{
+		explicit MockUploadBuffer(uint64 capacity) : memory((size_t)capacity, 0) {}
+		uint8* getMappedPointer() { return memory.data(); }
+		uint64 getCapacity() const { return memory.size(); }
+		std::vector<uint8> memory;
+	};
+
+	// Do [x0, x1) and [y0, y1) intersect?
+	static bool rangeOverlaps(uint64 x0, uint64 x1, uint64 y0, uint64 y1)
+	{
+		return x1 > y0 && y1 > x0;
+	}
+
+	TEST_CLASS(TestUploadRingAllocator)
+	{
+	public:
+		TEST_METHOD(AlignmentAndWrap)
+		{
+			MockUploadBuffer buffer(1024);
+			SimulatedUploadFence fence;
+			UploadRingAllocator ring;
+			ring.initialize(buffer.getMappedPointer(), buffer.getCapacity(), &fence);
+
+			UploadRingAllocation a = ring.allocate(100, 16);
+			UploadRingAllocation b = ring.allocate(100, 256);
+			Assert::AreEqual(0ull, a.offset);
+			Assert::AreEqual(256ull, b.offset);
+			Assert::IsTrue(b.cpuPtr == buffer.getMappedPointer() + 256);
+			Assert::AreEqual(356ull, ring.getUsedBytes());
+
+			ring.endFrame(fence.submit());
+			fence.complete(fence.lastSubmittedValue);
+
+			UploadRingAllocation c = ring.allocate(600, 16);
+			Assert::AreEqual(368ull, c.offset);
+
+			// Not enough space until the end, so skip to the beginning which is free now.
+			UploadRingAllocation d = ring.allocate(200, 16);
+			Assert::AreEqual(0ull, d.offset);
+			Assert::AreEqual(0u, fence.numWaits);
+			Assert::AreEqual(0ull, ring.getNumStalls());
+			Assert::AreEqual(1024ull - 356ull + 200ull, ring.getCurrentFrameBytes());
+		}
+
+		TEST_METHOD(ReclaimRetiredFrames)
+		{
+			MockUploadBuffer buffer(1024);
+			SimulatedUploadFence fence;
+			UploadRingAllocator ring;
+			ring.initialize(buffer.getMappedPointer(), buffer.getCapacity(), &fence);
+
+			// Three frames in flight, 256 bytes each.
+			uint64 frameFences[3];
+			for (uint32 i = 0; i < 3; ++i)
+			{
+				Assert::IsTrue(ring.allocate(256, 16).isValid());
+				frameFences[i] = fence.submit();
+				ring.endFrame(frameFences[i]);
+			}
+			Assert::AreEqual((size_t)3, ring.getNumPendingFrames());
+			Assert::AreEqual(768ull, ring.getUsedBytes());
+
+			fence.complete(frameFences[0]);
+			ring.retire();
+			Assert::AreEqual((size_t)2, ring.getNumPendingFrames());
+			Assert::AreEqual(512ull, ring.getUsedBytes());
+
+			// Empty frames don't occupy anything.
+			ring.endFrame(fence.submit());
+			Assert::AreEqual((size_t)2, ring.getNumPendingFrames());
+
+			fence.complete(fence.lastSubmittedValue);
+			ring.retire();
+			Assert::AreEqual(0ull, ring.getUsedBytes());
+			Assert::AreEqual(768ull, ring.getHighWaterMark());
+			Assert::AreEqual(0ull, ring.getNumStalls());
+		}
+
+		TEST_METHOD(StallWhenFull)
+		{
+			MockUploadBuffer buffer(1024);
+			SimulatedUploadFence fence;
+			UploadRingAllocator ring;
+			ring.initialize(buffer.getMappedPointer(), buffer.getCapacity(), &fence);
+
+			Assert::IsTrue(ring.allocate(512, 16).isValid());
+			const uint64 fence0 = fence.submit();
+			ring.endFrame(fence0);
+			Assert::IsTrue(ring.allocate(384, 16).isValid());
+			ring.endFrame(fence.submit());
+
+			// GPU has not finished anything. Wait only for the oldest frame.
+			UploadRingAllocation allocation = ring.allocate(256, 16);
+			Assert::IsTrue(allocation.isValid());
+			Assert::AreEqual(0ull, allocation.offset);
+			Assert::AreEqual(1ull, ring.getNumStalls());
+			Assert::AreEqual(fence0, fence.completedValue);
+		}
+
+		TEST_METHOD(FailWhenFrameExceedsCapacity)
+		{
+			MockUploadBuffer buffer(1024);
+			SimulatedUploadFence fence;
+			UploadRingAllocator ring;
+			ring.initialize(buffer.getMappedPointer(), buffer.getCapacity(), &fence);
+
+			Assert::IsFalse(ring.allocate(2048, 16).isValid());
+			Assert::IsTrue(ring.allocate(1000, 16).isValid());
+			// The current frame can't be reclaimed.
+			Assert::IsFalse(ring.allocate(100, 16).isValid());
+			Assert::AreEqual(2ull, ring.getNumFailedAllocations());
+			Assert::AreEqual(0ull, ring.getNumStalls());
+
+			// Whole capacity is available again once everything retires.
+			ring.endFrame(fence.submit());
+			fence.complete(fence.lastSubmittedValue);
+			Assert::IsTrue(ring.allocate(1024, 256).isValid());
+		}
+
+		// Random frames with GPU lagging behind by a random amount.
+		// Allocations must never overwrite memory that the GPU might still read.
+		TEST_METHOD(NoOverlapWithInFlightData)
+		{
+			const uint64 capacity = 40 * 1024;
+			MockUploadBuffer buffer(capacity);
+			SimulatedUploadFence fence;
+			UploadRingAllocator ring;
+			ring.initialize(buffer.getMappedPointer(), buffer.getCapacity(), &fence);
+
+			struct LiveRange
+			{
+				uint64 fenceValue; // UINT64_MAX for the current frame
+				uint64 begin;
+				uint64 end;
+				uint8  pattern;
+			};
+			std::deque<LiveRange> liveRanges;
+			std::mt19937 rng(23);
+
+			// Check the GPU would still see the data it was given.
+			auto verify = [&buffer](const LiveRange& range)
+			{
+				for (uint64 i = range.begin; i < range.end; ++i)
+				{
+					if (buffer.memory[(size_t)i] != range.pattern) return false;
+				}
+				return true;
+			};
+
+			for (uint32 frame = 0; frame < 2000; ++frame)
+			{
+				const uint32 numAllocs = rng() % 16;
+				for (uint32 i = 0; i < numAllocs; ++i)
+				{
+					const uint64 size = 1 + rng() % 2048;
+					const uint64 alignment = 1ull << (rng() % 9);
+					UploadRingAllocation allocation = ring.allocate(size, alignment);
+					Assert::IsTrue(allocation.isValid());
+					Assert::AreEqual(0ull, allocation.offset % alignment);
+					Assert::IsTrue(allocation.offset + size <= capacity);
+
+					// Drop ranges the GPU has finished with.
+					while (!liveRanges.empty() && liveRanges.front().fenceValue <= fence.completedValue)
+					{
+						liveRanges.pop_front();
+					}
+					for (const LiveRange& range : liveRanges)
+					{
+						Assert::IsFalse(rangeOverlaps(allocation.offset, allocation.offset + size, range.begin, range.end));
+					}
+
+					const uint8 pattern = (uint8)(1 + rng() % 255);
+					std::fill(allocation.cpuPtr, allocation.cpuPtr + size, pattern);
+					liveRanges.push_back(LiveRange{ ~0ull, allocation.offset, allocation.offset + size, pattern });
+				}
+
+				const uint64 fenceValue = fence.submit();
+				ring.endFrame(fenceValue);
+				for (LiveRange& range : liveRanges)
+				{
+					if (range.fenceValue == ~0ull) range.fenceValue = fenceValue;
+					Assert::IsTrue(verify(range));
+				}
+
+				// GPU is 0 ~ 3 frames behind.
+				const uint64 lag = rng() % 4;
+				if (fence.lastSubmittedValue > lag)
+				{
+					fence.complete(fence.lastSubmittedValue - lag);
+				}
+				ring.retire();
+				Assert::IsTrue(ring.getUsedBytes() <= capacity);
+			}
+
+			Assert::IsTrue(ring.getHighWaterMark() <= capacity);
+			Assert::AreEqual(0ull, ring.getNumFailedAllocations());
+
+			wchar_t msg[256];
+			swprintf_s(msg, L"High-water mark: %llu / %llu bytes, stalls: %llu\n",
+				ring.getHighWaterMark(), capacity, ring.getNumStalls());
+			UnitLogger::WriteMessage(msg);
+		}
+	};
+}
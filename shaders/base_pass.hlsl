@@ -153,7 +153,7 @@ PixelOutput mainPS(Interpolants interpolants)
 
 	// Material properties
 	Texture2D albedoTex = albedoTextures[NonUniformResourceIndex(material.albedoTextureIndex)];
-	float3 albedo = albedoTex.SampleLevel(albedoSampler, interpolants.texcoord, 0.0).rgb;
+	float3 albedo = albedoTex.Sample(albedoSampler, interpolants.texcoord).rgb;
 	albedo *= material.albedoMultiplier.rgb;
 
 	// Direct lighting
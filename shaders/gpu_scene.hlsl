@@ -12,28 +12,34 @@ struct GPUSceneAllocCommand
 	uint         _pad2;
 	GPUSceneItem sceneItem;
 };
-struct GPUSceneEvictCommand
+// Items [firstItemIndex, firstItemIndex + numItems)
+struct GPUSceneEvictRangeCommand
 {
-	uint         sceneItemIndex;
+	uint         firstItemIndex;
+	uint         numItems;
 };
-struct GPUSceneUpdateCommand
+// See gpu_scene_transform_packing.h
+struct GPUScenePackedUpdateCommand
 {
 	uint         sceneItemIndex;
-	uint         _pad0;
-	uint         _pad1;
-	uint         _pad2;
-	float4x4     localToWorld;
-	float4x4     prevLocalToWorld;
+	uint         numItems;
+	uint         dataOffsetAndFlags;
 };
 
+#define AFFINE_TRANSFORM_SIZE                     12
+#define QUANTIZED_TRANSFORM_SIZE                  8
+#define UPDATE_FLAG_QUANTIZED_LOCAL_TO_WORLD      (1 << 0)
+#define UPDATE_FLAG_HAS_PREV_LOCAL_TO_WORLD       (1 << 1)
+#define UPDATE_FLAG_QUANTIZED_PREV_LOCAL_TO_WORLD (1 << 2)
+
 #if !defined(COMMAND_TYPE)
 	#error COMMAND_TYPE was not defined
 #elif COMMAND_TYPE == COMMAND_TYPE_EVICT
-	#define COMMAND_STRUCT GPUSceneEvictCommand
+	#define COMMAND_STRUCT GPUSceneEvictRangeCommand
 #elif COMMAND_TYPE == COMMAND_TYPE_ALLOC
 	#define COMMAND_STRUCT GPUSceneAllocCommand
 #elif COMMAND_TYPE == COMMAND_TYPE_UPDATE
-	#define COMMAND_STRUCT GPUSceneUpdateCommand
+	#define COMMAND_STRUCT GPUScenePackedUpdateCommand
 #endif
 
 // ------------------------------------------------------------------------
@@ -49,6 +55,62 @@ ConstantBuffer<PushConstants>    pushConstants;
 
 RWStructuredBuffer<GPUSceneItem> gpuSceneBuffer;
 StructuredBuffer<COMMAND_STRUCT> commandBuffer;
+#if COMMAND_TYPE == COMMAND_TYPE_UPDATE
+ByteAddressBuffer                transformData;
+#endif
+
+// ------------------------------------------------------------------------
+// Transform decoding
+
+#if COMMAND_TYPE == COMMAND_TYPE_UPDATE
+// Rows are the first 3 rows of Float4x4 in C++, which is the transpose of localToWorld.
+float4x4 makeLocalToWorld(float4 row0, float4 row1, float4 row2)
+{
+	return transpose(float4x4(row0, row1, row2, float4(0, 0, 0, 1)));
+}
+
+float4x4 loadAffineTransform(uint offset)
+{
+	float4 row0 = asfloat(transformData.Load4((offset + 0) * 4));
+	float4 row1 = asfloat(transformData.Load4((offset + 4) * 4));
+	float4 row2 = asfloat(transformData.Load4((offset + 8) * 4));
+	return makeLocalToWorld(row0, row1, row2);
+}
+
+float dequantizeQuaternionComponent(uint x)
+{
+	return ((float)x / 65535.0 * 2.0 - 1.0) * 0.70710678;
+}
+
+float4x4 loadQuantizedTransform(uint offset)
+{
+	float3 translation = asfloat(transformData.Load3((offset + 0) * 4));
+	float3 scale = asfloat(transformData.Load3((offset + 3) * 4));
+	uint2 packedRotation = transformData.Load2((offset + 6) * 4);
+
+	// Smallest three
+	uint largest = packedRotation.y >> 16;
+	float3 smallest = float3(
+		dequantizeQuaternionComponent(packedRotation.x & 0xffff),
+		dequantizeQuaternionComponent(packedRotation.x >> 16),
+		dequantizeQuaternionComponent(packedRotation.y & 0xffff));
+	float w = sqrt(max(0.0, 1.0 - dot(smallest, smallest)));
+	float4 q;
+	if (largest == 0) q = float4(w, smallest.x, smallest.y, smallest.z);
+	else if (largest == 1) q = float4(smallest.x, w, smallest.y, smallest.z);
+	else if (largest == 2) q = float4(smallest.x, smallest.y, w, smallest.z);
+	else q = float4(smallest.x, smallest.y, smallest.z, w);
+
+	float3 R0 = float3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y - q.w * q.z), 2.0 * (q.x * q.z + q.w * q.y));
+	float3 R1 = float3(2.0 * (q.x * q.y + q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z - q.w * q.x));
+	float3 R2 = float3(2.0 * (q.x * q.z - q.w * q.y), 2.0 * (q.y * q.z + q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+
+	return makeLocalToWorld(
+		float4(scale.x * R0, translation.x),
+		float4(scale.y * R1, translation.y),
+		float4(scale.z * R2, translation.z));
+}
+#endif
 
 // ------------------------------------------------------------------------
 // Compute shader
@@ -63,20 +125,56 @@ void mainCS(uint3 tid: SV_DispatchThreadID)
     }
 
 #if COMMAND_TYPE == COMMAND_TYPE_EVICT
-	GPUSceneEvictCommand cmd = commandBuffer.Load(commandID);
-	GPUSceneItem item = gpuSceneBuffer[cmd.sceneItemIndex];
-	item.flags = item.flags & (~GPU_SCENE_ITEM_FLAG_BIT_IS_VALID);
-	gpuSceneBuffer[cmd.sceneItemIndex] = item;
+	// One command per mesh, covering all of its sections.
+	GPUSceneEvictRangeCommand cmd = commandBuffer.Load(commandID);
+	for (uint i = 0; i < cmd.numItems; ++i)
+	{
+		uint itemIndex = cmd.firstItemIndex + i;
+		GPUSceneItem item = gpuSceneBuffer[itemIndex];
+		item.flags = item.flags & (~GPU_SCENE_ITEM_FLAG_BIT_IS_VALID);
+		gpuSceneBuffer[itemIndex] = item;
+	}
 	
 #elif COMMAND_TYPE == COMMAND_TYPE_ALLOC
 	GPUSceneAllocCommand cmd = commandBuffer.Load(commandID);
     gpuSceneBuffer[cmd.sceneItemIndex] = cmd.sceneItem;
 	
 #elif COMMAND_TYPE == COMMAND_TYPE_UPDATE
-	GPUSceneUpdateCommand cmd = commandBuffer.Load(commandID);
-	GPUSceneItem item = gpuSceneBuffer[cmd.sceneItemIndex];
-	item.localToWorld = cmd.localToWorld;
-	item.prevLocalToWorld = cmd.prevLocalToWorld;
-    gpuSceneBuffer[cmd.sceneItemIndex] = item;
+	GPUScenePackedUpdateCommand cmd = commandBuffer.Load(commandID);
+	uint flags = cmd.dataOffsetAndFlags & 7;
+	uint offset = cmd.dataOffsetAndFlags >> 3;
+
+	// Decode once for the whole range.
+	float4x4 localToWorld;
+	if (flags & UPDATE_FLAG_QUANTIZED_LOCAL_TO_WORLD)
+	{
+		localToWorld = loadQuantizedTransform(offset);
+		offset += QUANTIZED_TRANSFORM_SIZE;
+	}
+	else
+	{
+		localToWorld = loadAffineTransform(offset);
+		offset += AFFINE_TRANSFORM_SIZE;
+	}
+	bool bHasPrevLocalToWorld = (flags & UPDATE_FLAG_HAS_PREV_LOCAL_TO_WORLD) != 0;
+	float4x4 uploadedPrevLocalToWorld = localToWorld;
+	if (bHasPrevLocalToWorld && (flags & UPDATE_FLAG_QUANTIZED_PREV_LOCAL_TO_WORLD))
+	{
+		uploadedPrevLocalToWorld = loadQuantizedTransform(offset);
+	}
+	else if (bHasPrevLocalToWorld)
+	{
+		uploadedPrevLocalToWorld = loadAffineTransform(offset);
+	}
+
+	for (uint i = 0; i < cmd.numItems; ++i)
+	{
+		uint itemIndex = cmd.sceneItemIndex + i;
+		GPUSceneItem item = gpuSceneBuffer[itemIndex];
+		// Reuse localToWorld in the gpu scene buffer if prevLocalToWorld was not uploaded.
+		item.prevLocalToWorld = bHasPrevLocalToWorld ? uploadedPrevLocalToWorld : item.localToWorld;
+		item.localToWorld = localToWorld;
+		gpuSceneBuffer[itemIndex] = item;
+	}
 #endif
 }